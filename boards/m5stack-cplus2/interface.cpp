@@ -1,6 +1,21 @@
+#include "core/input_events.h"
 #include "core/powerSave.h"
 #include <interface.h>
 
+/***************************************************************************************
+** Function name: readKeys()
+** Description:   the three buttons, low when pressed. The top one is both Prev and Esc, the
+**                Stick has no other button to leave a menu with
+***************************************************************************************/
+static uint16_t readKeys() {
+    uint16_t keys = 0;
+    // the same button goes back and exits
+    if (digitalRead(UP_BTN) == LOW) keys |= INPUT_KEY_BIT(INPUT_KEY_PREV) | INPUT_KEY_BIT(INPUT_KEY_ESC);
+    if (digitalRead(SEL_BTN) == LOW) keys |= INPUT_KEY_BIT(INPUT_KEY_SEL);
+    if (digitalRead(DW_BTN) == LOW) keys |= INPUT_KEY_BIT(INPUT_KEY_NEXT);
+    return keys;
+}
+
 /***************************************************************************************
 ** Function name: _setup_gpio()
 ** Location: main.cpp
@@ -10,6 +25,8 @@ void _setup_gpio() {
     pinMode(UP_BTN, INPUT); // Sets the power btn as an INPUT
     pinMode(SEL_BTN, INPUT);
     pinMode(DW_BTN, INPUT);
+    static const uint8_t keyPins[] = {UP_BTN, SEL_BTN, DW_BTN};
+    inputUseKeyReader(readKeys, keyPins, sizeof(keyPins));
     pinMode(4, OUTPUT);    // Keeps the Stick alive after take off the USB cable
     digitalWrite(4, HIGH); // Keeps the Stick alive after take off the USB cable
     gpio_pulldown_dis(GPIO_NUM_36);
@@ -51,29 +68,6 @@ void _setBrightness(uint8_t brightval) {
     }
 }
 
-/*********************************************************************
-** Function: InputHandler
-** Handles the variables PrevPress, NextPress, SelPress, AnyKeyPress and EscPress
-**********************************************************************/
-void InputHandler(void) {
-    static unsigned long tm = 0;
-    if (millis() - tm < 200 && !LongPress) return;
-
-    bool upPressed = (digitalRead(UP_BTN) == LOW);
-    bool selPressed = (digitalRead(SEL_BTN) == LOW);
-    bool dwPressed = (digitalRead(DW_BTN) == LOW);
-
-    bool anyPressed = upPressed || selPressed || dwPressed;
-    if (anyPressed) tm = millis();
-    if (anyPressed && wakeUpScreen()) return;
-
-    AnyKeyPress = anyPressed;
-    PrevPress = upPressed;
-    EscPress = upPressed;
-    NextPress = dwPressed;
-    SelPress = selPressed;
-}
-
 /*********************************************************************
 ** Function: powerOff
 ** location: mykeyboard.cpp
@@ -1,3 +1,4 @@
+#include "core/input_events.h"
 #include "core/powerSave.h"
 #include <bq27220.h>
 #include <globals.h>
@@ -11,6 +12,21 @@
 // Charger chip
 
 XPowersPPM PPM;
+/***************************************************************************************
+** Function name: readKeys()
+** Description:   the six buttons, low when pressed, a key each; Up and Down also turn the page
+***************************************************************************************/
+static uint16_t readKeys() {
+    uint16_t keys = 0;
+    if (!digitalRead(L_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_PREV);
+    if (!digitalRead(R_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_NEXT);
+    if (!digitalRead(UP_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_UP) | INPUT_KEY_BIT(INPUT_KEY_PREV_PAGE);
+    if (!digitalRead(DW_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_DOWN) | INPUT_KEY_BIT(INPUT_KEY_NEXT_PAGE);
+    if (!digitalRead(SEL_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_SEL);
+    if (!digitalRead(ESC_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_ESC);
+    return keys;
+}
+
 /***************************************************************************************
 ** Function name: _setup_gpio()
 ** Location: main.cpp
@@ -30,6 +46,8 @@ void _setup_gpio() {
     pinMode(R_BTN, INPUT);
     pinMode(L_BTN, INPUT);
     pinMode(ESC_BTN, INPUT);
+    static const uint8_t keyPins[] = {UP_BTN, SEL_BTN, DW_BTN, R_BTN, L_BTN, ESC_BTN};
+    inputUseKeyReader(readKeys, keyPins, sizeof(keyPins));
 
     pinMode(CC1101_SS_PIN, OUTPUT);
     pinMode(NRF24_SS_PIN, OUTPUT);
@@ -113,44 +131,6 @@ void _setBrightness(uint8_t brightval) {
     }
 }
 
-/*********************************************************************
-** Function: InputHandler
-** Handles the variables PrevPress, NextPress, SelPress, AnyKeyPress and EscPress
-**********************************************************************/
-void InputHandler(void) {
-    static unsigned long tm = 0;
-    if (millis() - tm < 200 && !LongPress) return;
-    bool _u = digitalRead(UP_BTN);
-    bool _d = digitalRead(DW_BTN);
-    bool _l = digitalRead(L_BTN);
-    bool _r = digitalRead(R_BTN);
-    bool _s = digitalRead(SEL_BTN);
-    bool _e = digitalRead(ESC_BTN);
-
-    if (!_s || !_u || !_d || !_r || !_l || !_e) {
-        tm = millis();
-        if (!wakeUpScreen()) AnyKeyPress = true;
-        else return;
-    }
-    if (!_l) { PrevPress = true; }
-    if (!_r) { NextPress = true; }
-    if (!_u) {
-        UpPress = true;
-        PrevPagePress = true;
-    }
-    if (!_d) {
-        DownPress = true;
-        NextPagePress = true;
-    }
-    if (!_s) { SelPress = true; }
-
-    if (!_e) {
-        EscPress = true;
-        // NextPress = false;
-        // PrevPress = false;
-    }
-}
-
 /*********************************************************************
 ** Function: powerOff
 ** location: mykeyboard.cpp
@@ -1,5 +1,24 @@
+#include "core/input_events.h"
 #include "core/powerSave.h"
 
+/***************************************************************************************
+** Function name: readKeys()
+** Description:   the five buttons, low when pressed. Left and Right together are Esc, there is
+**                no button of its own for it. Up and Down also turn the page
+***************************************************************************************/
+static uint16_t readKeys() {
+    uint16_t keys = 0;
+    bool _l = !digitalRead(L_BTN);
+    bool _r = !digitalRead(R_BTN);
+    if (_l && _r) keys |= INPUT_KEY_BIT(INPUT_KEY_ESC);
+    else if (_l) keys |= INPUT_KEY_BIT(INPUT_KEY_PREV);
+    else if (_r) keys |= INPUT_KEY_BIT(INPUT_KEY_NEXT);
+    if (!digitalRead(UP_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_UP) | INPUT_KEY_BIT(INPUT_KEY_PREV_PAGE);
+    if (!digitalRead(DW_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_DOWN) | INPUT_KEY_BIT(INPUT_KEY_NEXT_PAGE);
+    if (!digitalRead(SEL_BTN)) keys |= INPUT_KEY_BIT(INPUT_KEY_SEL);
+    return keys;
+}
+
 /***************************************************************************************
 ** Function name: _setup_gpio()
 ** Location: main.cpp
@@ -20,6 +39,8 @@ void _setup_gpio() {
     pinMode(DW_BTN, INPUT);
     pinMode(R_BTN, INPUT);
     pinMode(L_BTN, INPUT);
+    static const uint8_t keyPins[] = {UP_BTN, SEL_BTN, DW_BTN, R_BTN, L_BTN};
+    inputUseKeyReader(readKeys, keyPins, sizeof(keyPins));
 
     pinMode(CC1101_SS_PIN, OUTPUT);
     pinMode(NRF24_SS_PIN, OUTPUT);
@@ -86,42 +107,6 @@ void _setBrightness(uint8_t brightval) {
     }
 }
 
-/*********************************************************************
-** Function: InputHandler
-** Handles the variables PrevPress, NextPress, SelPress, AnyKeyPress and EscPress
-**********************************************************************/
-void InputHandler(void) {
-    static unsigned long tm = 0;
-    if (millis() - tm < 200 && !LongPress) return;
-    bool _u = digitalRead(UP_BTN);
-    bool _d = digitalRead(DW_BTN);
-    bool _l = digitalRead(L_BTN);
-    bool _r = digitalRead(R_BTN);
-    bool _s = digitalRead(SEL_BTN);
-
-    if (!_s || !_u || !_d || !_r || !_l) {
-        tm = millis();
-        if (!wakeUpScreen()) AnyKeyPress = true;
-        else return;
-    }
-    if (!_l) { PrevPress = true; }
-    if (!_r) { NextPress = true; }
-    if (!_u) {
-        UpPress = true;
-        PrevPagePress = true;
-    }
-    if (!_d) {
-        DownPress = true;
-        NextPagePress = true;
-    }
-    if (!_s) { SelPress = true; }
-    if (!_l && !_r) {
-        EscPress = true;
-        NextPress = false;
-        PrevPress = false;
-    }
-}
-
 /*********************************************************************
 ** Function: powerOff
 ** location: mykeyboard.cpp
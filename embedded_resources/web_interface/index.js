@@ -325,23 +325,19 @@ function syncScrolling() {
   lineNumbers.scrollTop = textarea.scrollTop;
 }
 
-function renderFileRow(fileList) {
-  $("table.explorer tbody").innerHTML = "";
-  fileList.split("\n").sort((a, b) => {
-    let [aFirst, ...aRest] = a.split(':');
-    let [bFirst, ...bRest] = b.split(':');
-
-    if (aFirst !== bFirst) {
-      return bFirst.localeCompare(aFirst);
-    }
+// Same wording as humanReadableSize() on the device
+function humanReadableSize(bytes) {
+  if (bytes < 1024) return bytes + " B";
+  if (bytes < 1024 * 1024) return (bytes / 1024).toFixed(2) + " kB";
+  if (bytes < 1024 * 1024 * 1024) return (bytes / 1024 / 1024).toFixed(2) + " MB";
+  return (bytes / 1024 / 1024 / 1024).toFixed(2) + " GB";
+}
 
-    let aRestStr = aRest.join(':').toLowerCase();
-    let bRestStr = bRest.join(':').toLowerCase();
-    return aRestStr.localeCompare(bRestStr);
-  }).forEach((line) => {
+// listing: {path, entries: [[type, name, bytes], ...]}, already sorted by the device
+function renderFileRow(listing) {
+  $("table.explorer tbody").innerHTML = "";
+  [["pa", "", 0], ...listing.entries].forEach(([type, name, size]) => {
     let e;
-    let [type, name, size] = line.split(":");
-    if (size === undefined) return;
     let dPath = ((currentPath.endsWith("/") ? currentPath : currentPath + "/") + name).replace(/\/\//g, "/");
     if (type === "pa") {
       if (dPath === "/") return;
@@ -357,7 +353,7 @@ function renderFileRow(fileList) {
       e.querySelector(".col-name").classList.add("act-edit-file");
       e.querySelector(".col-name").textContent = name;
       e.querySelector(".col-name").setAttribute("title", name);
-      e.querySelector(".col-size").textContent = size;
+      e.querySelector(".col-size").textContent = humanReadableSize(size);
       e.querySelector(".col-action").classList.add("type-file");
 
       let downloadUrl = `/file?fs=${currentDrive}&name=${encodeURIComponent(dPath)}&action=download`;
@@ -423,9 +419,10 @@ async function fetchFiles(drive, path) {
   $(".current-path").textContent = drive + ":/" + path;
   let req = await requestGet("/listfiles", {
     fs: drive,
-    folder: path
+    folder: path,
+    format: "json"
   });
-  renderFileRow(req);
+  renderFileRow(JSON.parse(req));
   btnRefreshFolder.classList.remove("reloading");
 }
 
@@ -477,6 +474,10 @@ async function openNavigator() {
 
 let SCREEN_NAVIGATING = false;
 async function runNavigation(direction) {
+  if (screenSocketOpen()) { // the device pushes the new screen by itself
+    SCREEN_SOCKET.send(`nav ${direction.toLowerCase()}`);
+    return;
+  }
   if (SCREEN_NAVIGATING) return;
   SCREEN_NAVIGATING = true;
   try {
@@ -493,16 +494,22 @@ async function runNavigation(direction) {
 
 const btnForceReload = $("#force-reload");
 let SCREEN_RELOAD = false;
-async function reloadScreen() {
+let SCREEN_SEQ = 0; // last draw command received, the device only sends what came after it
+async function reloadScreen(full = false) {
   if (SCREEN_RELOAD) return;
   SCREEN_RELOAD = true;
   btnForceReload.classList.add("reloading");
   try {
-    let binResponse = await fetch((IS_DEV ? "/bruce" : "") + "/getscreen");
+    if (full) SCREEN_SEQ = 0;
+    let binResponse = await fetch((IS_DEV ? "/bruce" : "") + "/getscreen?since=" + SCREEN_SEQ);
     let arrayBuffer = await binResponse.arrayBuffer();
-    let screenData = new Uint8Array(arrayBuffer);
-    await renderTFT(screenData);
+    let screen = decodeScreenStream(new Uint8Array(arrayBuffer));
+    SCREEN_SEQ = screen.seq;
+    let render = SCREEN_RENDERING.then(() => renderTFT(screen.records, screen.full));
+    SCREEN_RENDERING = render.catch(() => { });
+    await render;
   } catch (error) {
+    SCREEN_SEQ = 0;
     console.error("Failed to reload screen:", error);
     alert("Failed to reload screen: " + error.message);
   } finally {
@@ -526,7 +533,7 @@ async function taskReloader() {
   }
 
 
-  await reloadScreen();
+  if (!screenSocketOpen()) await reloadScreen();
   setTimeout(taskReloader, timer);
   // better use setTimeout instead of setInterval to avoid overlapping calls
 }
@@ -538,15 +545,122 @@ async function autoReloadScreen() {
     AUTO_RELOAD_SCREEN = null;
   }
 
-  if (timer > 0) taskReloader();
+  if (timer > 0) {
+    connectScreenSocket();
+    taskReloader();
+  } else if (SCREEN_SOCKET) {
+    SCREEN_SOCKET.close();
+  }
+}
+
+/// SCREEN SOCKET
+// The device pushes what it draws over /ws/screen, polling /getscreen stays as the fallback
+let SCREEN_SOCKET = null;
+let SCREEN_RENDERING = Promise.resolve(); // renders run one after the other
+const screenSocketOpen = () => SCREEN_SOCKET !== null && SCREEN_SOCKET.readyState === WebSocket.OPEN;
+function connectScreenSocket() {
+  if (SCREEN_SOCKET || !("WebSocket" in window)) return;
+  let scheme = location.protocol === "https:" ? "wss" : "ws";
+  let socket = new WebSocket(`${scheme}://${location.host}${IS_DEV ? "/bruce" : ""}/ws/screen`);
+  socket.binaryType = "arraybuffer";
+  SCREEN_SOCKET = socket;
+  socket.onmessage = (e) => {
+    if (!$(".dialog.navigator:not(.hidden)")) {
+      socket.close();
+      return;
+    }
+    let screen = decodeScreenStream(new Uint8Array(e.data));
+    SCREEN_RENDERING = SCREEN_RENDERING.then(() => renderTFT(screen.records, screen.full)).catch(console.error);
+  };
+  socket.onclose = () => {
+    if (SCREEN_SOCKET === socket) SCREEN_SOCKET = null;
+  };
 }
 
 /// TFT RENDER
+// Field layout of each record of the compact stream, see src/core/tftLogger/screen_stream.cpp
+// i = int16 (zigzag varint), c = colour, b = byte, x = not sent, s = length prefixed string
+const SCREEN_STREAM_LAYOUT = {
+  0: "c", 1: "iiiic", 2: "iiiic", 3: "iiiiic", 4: "iiiiic", 5: "iiic", 6: "iiic",
+  7: "iiiiiic", 8: "iiiiiic", 9: "iiiic", 10: "iiiic", 11: "iiiic", 12: "iiiiiicc",
+  13: "iiiiicc", 14: "iiiccs", 15: "iiiccs", 16: "iiiccs", 17: "iiiccs", 18: "iiiibxs",
+  20: "iiic", 21: "iiic", 99: "iib"
+};
+
+// Turns the /getscreen?since=N stream back into the 0xAA records renderTFT draws
+function decodeScreenStream(data) {
+  // firmware without the compact stream ignores since and sends the whole log
+  if (data[0] !== 0xAB) return { full: true, seq: 0, records: data };
+
+  const full = (data[2] & 0x01) !== 0;
+  const seq = (data[3] | (data[4] << 8) | (data[5] << 16) | (data[6] << 24)) >>> 0;
+  const palette = [];
+  const out = [];
+  let pos = 7;
+  const varint = () => {
+    let value = 0, shift = 0, byte;
+    do {
+      byte = data[pos++];
+      value += (byte & 0x7F) * 2 ** shift;
+      shift += 7;
+    } while (byte & 0x80);
+    return value;
+  };
+
+  while (pos < data.length) {
+    let fn = data[pos++];
+    if (fn === 0xFE) { // record copied as is
+      let len = varint();
+      out.push(...data.subarray(pos, pos + len));
+      pos += len;
+      continue;
+    }
+    let layout = SCREEN_STREAM_LAYOUT[fn];
+    if (!layout) {
+      console.warn("Unknown screen record", fn);
+      break;
+    }
+    let record = [0xAA, 0, fn];
+    for (let field of layout) {
+      let value;
+      if (field === 'i') {
+        let z = varint();
+        value = (z >>> 1) ^ -(z & 1);
+      } else if (field === 'c') {
+        let z = varint();
+        if (z & 1) {
+          value = z >>> 1;
+          if (palette.length < 64) palette.push(value);
+        } else {
+          value = palette[z >>> 1];
+        }
+      } else if (field === 'b') {
+        record.push(data[pos++]);
+        continue;
+      } else if (field === 's') {
+        let len = varint();
+        record.push(...data.subarray(pos, pos + len));
+        pos += len;
+        continue;
+      } else {
+        continue;
+      }
+      record.push((value >> 8) & 0xFF, value & 0xFF);
+    }
+    record[1] = record.length;
+    out.push(...record);
+  }
+  return { full, seq, records: Uint8Array.from(out) };
+}
+
 let loadingDrawn = false;
 const imageCache = {}; // global
-async function renderTFT(data) {
+// Mirror of the device screen, partial updates draw on it and it is then copied to the page
+const screenBuffer = document.createElement("canvas");
+async function renderTFT(data, full = true) {
   loadingDrawn = false;
-  const canvas = $("#navigator-screen");
+  const view = $("#navigator-screen");
+  const canvas = screenBuffer;
   const ctx = canvas.getContext("2d");
 
   const loadImage = async (url) => {
@@ -656,7 +770,7 @@ async function renderTFT(data) {
   }
 
   let offset = 0;
-  ctx.clearRect(0, 0, canvas.width, canvas.height);
+  if (full) ctx.clearRect(0, 0, canvas.width, canvas.height);
   while (offset < data.length) {
     ctx.beginPath();
     if (data[offset] !== 0xAA) {
@@ -817,6 +931,12 @@ async function renderTFT(data) {
         break;
     }
   }
+
+  if (view.width !== canvas.width || view.height !== canvas.height) {
+    view.width = canvas.width;
+    view.height = canvas.height;
+  }
+  view.getContext("2d").drawImage(canvas, 0, 0);
 }
 function drawCanvasLoading() {
   if (loadingDrawn || !showNavigating) return;
@@ -853,7 +973,7 @@ eConfigAutoReload.addEventListener("change", async (e) => {
 btnForceReload.addEventListener("click", async (e) => {
   e.preventDefault();
   drawCanvasLoading();
-  await reloadScreen();
+  await reloadScreen(true);
 });
 
 window.ondragenter = () => $(".upload-area").classList.remove("hidden");
@@ -126,7 +126,12 @@ def needs_rebuild():
         old = f.read().strip()
 
     print(old, compute_signature())
-    return compute_signature() != old
+    if compute_signature() != old:
+        return True
+
+    # The header must carry the signature it was generated with, cached bytecode is checked against it
+    with open(os.path.join(BJS_INTERPRETER_PATH, "mqjs_stdlib.h"), "r") as f:
+        return f"#define MQJS_STDLIB_SIGNATURE 0x{old[:8]}u\n" not in f.read()
 
 def write_build_stamp():
     with open(BUILD_SHA256, "w") as f:
@@ -196,6 +201,8 @@ def generate_headers():
             for line in INCLUDES:
                 f.write(f'#include "{line}.h"\n')
             f.write("\n")
+            # Build ID of cached script bytecode (bytecode_cache.h), which refers to this table
+            f.write(f"#define MQJS_STDLIB_SIGNATURE 0x{compute_signature()[:8]}u\n\n")
             f.write(result.stdout)
 
         with open(os.path.join(BUILD_DIR, "mquickjs_atom.h"), "w") as f:
@@ -24,6 +24,8 @@ public:
 
     virtual int available() = 0;
     virtual String readStringUntil(char terminator) = 0;
+    // Raw bytes, up to size of what already arrived, never waits
+    virtual size_t read(uint8_t *buf, size_t size) = 0;
     virtual ~SerialDevice() = default;
 };
 
@@ -7,6 +7,7 @@
 #include <VectorDisplay.h>
 #define BRUCE_TFT_DRIVER SerialDisplayClass
 #endif
+#include "core/tftLogger/screen_stream.h"
 enum tftFuncs : uint8_t { // DO NOT CHANGE THE ORDER, ADD NEW FUNCTIONS TO THE END!!!
     FILLSCREEN,           // 0
     DRAWRECT,             // 1
@@ -46,6 +47,7 @@ enum tftFuncs : uint8_t { // DO NOT CHANGE THE ORDER, ADD NEW FUNCTIONS TO THE E
 #define MAX_LOG_IMG_PATH 256
 #endif
 #define LOG_PACKET_HEADER 0xAA
+static_assert(MAX_LOG_ENTRIES <= SCREEN_INDEX_SLOTS, "screen log index is too small for the log");
 
 struct tftLog {
     uint8_t data[MAX_LOG_SIZE];
@@ -56,6 +58,14 @@ private:
     char (*images)[MAX_LOG_IMG_PATH] = nullptr;
     uint8_t logWriteIndex = 0;
     uint8_t logCount = 0;
+    // Every logged record gets a sequence number so /getscreen?since=N only sends what is new.
+    // Clients older than evictedSeq or resyncSeq get the whole log again.
+    ScreenLogIndex logIndex;
+    uint32_t logSeq[MAX_LOG_ENTRIES] = {};
+    uint32_t seqCounter = 0;
+    uint32_t evictedSeq = 0;
+    uint32_t resyncSeq = 0;
+    uint32_t lastScreenInfo = 0;
     bool isSleeping = false;
     bool logging = false;
     bool _logging = false;
@@ -98,6 +108,10 @@ public:
     void inline setSleepMode(bool mode) { isSleeping = mode; }
 
     void getBinLog(uint8_t *outBuffer, size_t &outSize);
+    // Compact stream (screen_stream.h) of the records logged after seq since, 0 = everything
+    void getBinLogSince(uint32_t since, uint8_t *outBuffer, size_t &outSize, size_t capacity);
+    // Seq of the last record logged, it moves whenever there is something new to send
+    uint32_t inline getLogSeq(void) const { return seqCounter; };
     bool removeLogEntriesInsideRect(int rx, int ry, int rw, int rh);
     void removeOverlappedImages(int x, int y, int center, int ms);
 
@@ -161,6 +175,9 @@ public:
 protected:
     bool isLogEqual(const tftLog &a, const tftLog &b);
     void pushLogIfUnique(const tftLog &l);
+    void markLogDeleted(int i);
+    uint8_t logFirstIndex() const { return logCount < MAX_LOG_ENTRIES ? 0 : logWriteIndex; }
+    uint32_t screenInfoKey();
     // void checkAndLog(tftFuncs f, std::initializer_list<int32_t> values);
     template <typename... Args> void checkAndLog(tftFuncs f, Args... args) {
         if (!logging) return;
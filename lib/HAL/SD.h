@@ -77,8 +77,18 @@ public:
     size_t sectorSize();
     uint64_t totalBytes();
     uint64_t usedBytes();
-    bool readRAW(uint8_t *buffer, uint32_t sector);
-    bool writeRAW(uint8_t *buffer, uint32_t sector);
+    // count consecutive sectors in one transfer
+    bool readRAW(uint8_t *buffer, uint32_t sector, uint32_t count = 1);
+    bool writeRAW(uint8_t *buffer, uint32_t sector, uint32_t count = 1);
+
+    // Entries of a folder straight from FatFs, size and FAT date << 16 | time included,
+    // so no file has to be opened for them
+    typedef void (*ListCallback)(void *ctx, const char *name, bool dir, uint64_t size, uint32_t mtime);
+    bool listDir(const char *path, ListCallback callback, void *ctx);
+    // Called with every path created, opened for writing, renamed or removed through SD
+    void onChange(void (*callback)(const char *path));
+    // A file of folder is open for writing through SD, its listed size may still change
+    bool writing(const char *folder);
 };
 
 } // namespace fs
@@ -17,6 +17,7 @@
 // limitations under the License.
 
 #include "sd_diskio2.h"
+#include "sd_vfs.h"
 #include "vfs_api.h"
 
 using namespace fs;
@@ -105,9 +106,13 @@ uint64_t SDFS::usedBytes() {
     return size;
 }
 
-bool SDFS::readRAW(uint8_t *buffer, uint32_t sector) { return sd_read_raw(_pdrv, buffer, sector); }
+bool SDFS::readRAW(uint8_t *buffer, uint32_t sector, uint32_t count) {
+    return sd_read_raw(_pdrv, buffer, sector, count);
+}
 
-bool SDFS::writeRAW(uint8_t *buffer, uint32_t sector) { return sd_write_raw(_pdrv, buffer, sector); }
+bool SDFS::writeRAW(uint8_t *buffer, uint32_t sector, uint32_t count) {
+    return sd_write_raw(_pdrv, buffer, sector, count);
+}
 
-SDFS SD = SDFS(FSImplPtr(new VFSImpl()));
+SDFS SD = SDFS(FSImplPtr(new SDVFSImpl()));
 #endif
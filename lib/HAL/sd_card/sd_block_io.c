@@ -0,0 +1,143 @@
+#include "sd_block_io.h"
+#include <string.h>
+
+#define SD_TOKEN_START_BLOCK 0xFE
+#define SD_TOKEN_TIMEOUT_MS 500
+
+unsigned short CRC16(const char *data, int length);
+
+static void sd_bus_transfer(sd_bus_t *bus, const uint8_t *tx, uint8_t *rx, size_t len) {
+  bus->start(bus->ctx, tx, rx, len);
+  if (bus->finish) {
+    bus->finish(bus->ctx);
+  }
+}
+
+static void sd_bus_finish(sd_bus_t *bus) {
+  if (bus->finish) {
+    bus->finish(bus->ctx);
+  }
+}
+
+bool sd_bus_wait(sd_bus_t *bus, uint32_t timeout_ms) {
+  uint8_t poll[SD_POLL_CHUNK];
+  // an idle card answers the first byte, only a busy one is worth polling in chunks
+  sd_bus_transfer(bus, NULL, poll, 1);
+  if (poll[0]) {
+    return true;
+  }
+  uint32_t start = bus->millis();
+  do {
+    sd_bus_transfer(bus, NULL, poll, SD_POLL_CHUNK);
+    if (poll[SD_POLL_CHUNK - 1]) {
+      return true;
+    }
+  } while (bus->millis() - start < timeout_ms);
+  return false;
+}
+
+// Polls for the start token of the next block; the bytes clocked in behind it are the start of
+// its data and land at the head of frame. Returns how many, -1 on error token or timeout.
+static int sd_bus_token(sd_bus_t *bus, uint8_t *frame, size_t frame_len) {
+  uint8_t poll[SD_POLL_CHUNK];
+  uint32_t start = bus->millis();
+  do {
+    sd_bus_transfer(bus, NULL, poll, SD_POLL_CHUNK);
+    for (int i = 0; i < SD_POLL_CHUNK; i++) {
+      if (poll[i] == 0xFF) {
+        continue;
+      }
+      if (poll[i] != SD_TOKEN_START_BLOCK) {
+        return -1;
+      }
+      size_t have = SD_POLL_CHUNK - i - 1;
+      if (have > frame_len) {
+        have = frame_len;
+      }
+      memcpy(frame, poll + i + 1, have);
+      return (int)have;
+    }
+  } while (bus->millis() - start < SD_TOKEN_TIMEOUT_MS);
+  return -1;
+}
+
+// Finds the token of a block and starts clocking in the rest of it, data then CRC, into frame
+static bool sd_bus_read_start(sd_bus_t *bus, uint8_t *frame, size_t len) {
+  int have = sd_bus_token(bus, frame, len + 2);
+  if (have < 0) {
+    return false;
+  }
+  bus->start(bus->ctx, NULL, frame + have, len + 2 - have);
+  return true;
+}
+
+int sd_bus_read_blocks(sd_bus_t *bus, uint8_t *buffer, size_t len, int count, bool crc) {
+  if (len > SD_BLOCK_SIZE || count <= 0) {
+    return 0;
+  }
+  int cur = 0;
+  if (!sd_bus_read_start(bus, bus->frame[cur], len)) {
+    return 0;
+  }
+  sd_bus_finish(bus);
+
+  for (int i = 0; i < count; i++) {
+    // the next block comes in while this one is checked
+    bool next = i + 1 < count && sd_bus_read_start(bus, bus->frame[cur ^ 1], len);
+
+    const uint8_t *frame = bus->frame[cur];
+    unsigned short got = (frame[len] << 8) | frame[len + 1];
+    bool good = !crc || got == CRC16((const char *)frame, len);
+    if (good) {
+      memcpy(buffer + i * len, frame, len);
+    }
+    if (next) {
+      sd_bus_finish(bus);
+    }
+    if (!good || !next) {
+      return good ? i + 1 : i;
+    }
+    cur ^= 1;
+  }
+  return count;
+}
+
+static void sd_bus_stage(uint8_t *frame, const uint8_t *block, uint8_t token, bool crc) {
+  frame[0] = token;
+  memcpy(frame + 1, block, SD_BLOCK_SIZE);
+  unsigned short sum = crc ? CRC16((const char *)block, SD_BLOCK_SIZE) : 0xFFFF;
+  frame[SD_BLOCK_SIZE + 1] = sum >> 8;
+  frame[SD_BLOCK_SIZE + 2] = sum & 0xFF;
+}
+
+uint8_t sd_bus_write_blocks(sd_bus_t *bus, const uint8_t *buffer, int count, uint8_t token, bool crc,
+                            int *written) {
+  int cur = 0;
+  *written = 0;
+  if (count <= 0) {
+    return 0;
+  }
+  sd_bus_stage(bus->frame[cur], buffer, token, crc);
+
+  for (int i = 0; i < count; i++) {
+    // waits out the programming of the previous block, the first one covers the command
+    if (!sd_bus_wait(bus, SD_TOKEN_TIMEOUT_MS)) {
+      return 0;
+    }
+    bus->start(bus->ctx, bus->frame[cur], NULL, SD_FRAME_SIZE);
+    if (i + 1 < count) {
+      sd_bus_stage(bus->frame[cur ^ 1], buffer + (i + 1) * SD_BLOCK_SIZE, token, crc);
+    }
+    sd_bus_finish(bus);
+
+    uint8_t resp;
+    sd_bus_transfer(bus, NULL, &resp, 1);
+    resp &= 0x1F;
+    if (resp != 0x05) {
+      return resp;
+    }
+    (*written)++;
+    cur ^= 1;
+  }
+  return 0x05;
+}
@@ -0,0 +1,51 @@
+#ifndef _SD_BLOCK_IO_H_
+#define _SD_BLOCK_IO_H_
+
+// Data phase of the SPI mode block commands (CMD17/18 reads, CMD24/25 writes).
+// Every block moves in bulk transfers: start tokens and busy are polled a chunk at a time,
+// the data of a read comes in with the bytes that followed its token, and a write leaves as
+// one token + data + CRC frame. Frames are staged in two internal buffers, the next one is
+// copied and checksummed while the card is still programming the last, and the bus may
+// return from start before the bytes are out so a queued (DMA) transfer overlaps that work.
+// No Arduino dependencies, so the sequencing can be run against a simulated card on the host.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SD_BLOCK_SIZE 512
+#define SD_POLL_CHUNK 16 // bytes clocked per poll of a start token or of busy
+#define SD_FRAME_SIZE (SD_BLOCK_SIZE + 3) // token, data, CRC
+
+typedef struct {
+  void *ctx;
+  // Clocks len bytes out of tx (0xFF when NULL) and keeps what comes back in rx (dropped when NULL).
+  // May return before the bytes are out; a transfer is done once finish returns.
+  void (*start)(void *ctx, const uint8_t *tx, uint8_t *rx, size_t len);
+  void (*finish)(void *ctx); // NULL when start blocks
+  uint32_t (*millis)(void);
+  uint8_t frame[2][SD_FRAME_SIZE]; // staging, one block on the wire while the other is checked
+} sd_bus_t;
+
+// Waits until the card releases busy (DO held low) for up to timeout_ms
+bool sd_bus_wait(sd_bus_t *bus, uint32_t timeout_ms);
+
+// After a read command was accepted: reads count blocks of len bytes into buffer.
+// Returns the blocks received with a valid CRC, stops at the first error token, timeout or bad CRC
+int sd_bus_read_blocks(sd_bus_t *bus, uint8_t *buffer, size_t len, int count, bool crc);
+
+// After a write command was accepted: sends count 512 byte blocks behind token (0xFE single,
+// 0xFC multiple). Returns the data response of the last block sent (0x05 accepted, 0 on
+// timeout) and sets *written to the number of blocks the card accepted
+uint8_t sd_bus_write_blocks(sd_bus_t *bus, const uint8_t *buffer, int count, uint8_t token, bool crc,
+                            int *written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SD_BLOCK_IO_H_ */
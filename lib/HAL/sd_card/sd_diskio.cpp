@@ -16,6 +16,7 @@
 #define ARDUINO_CORE_BUILD
 
 #include "sd_diskio2.h"
+#include "sd_block_io.h"
 #include "esp_system.h"
 #include "esp32-hal-periman.h"
 
@@ -28,7 +29,6 @@ extern "C" {
 //#include "esp_vfs.h"
 #include "esp_vfs_fat.h"
 char CRC7(const char *data, int length);
-unsigned short CRC16(const char *data, int length);
 }
 
 typedef enum {
@@ -64,6 +64,7 @@ typedef struct {
   unsigned long sectors;
   bool supports_crc;
   int status;
+  sd_bus_t bus;
 } ardu_sdcard_t;
 
 static ardu_sdcard_t *s_cards[FF_VOLUMES] = {NULL};
@@ -97,18 +98,26 @@ const char *fferr2str[] = {
  * SD SPI
  * */
 
-bool sdWait(uint8_t pdrv, int timeout) {
-  char resp;
-  uint32_t start = millis();
+// SPIClass only has blocking transfers, the data goes through the peripheral FIFO in bulk
+static void sdBusStart(void *ctx, const uint8_t *tx, uint8_t *rx, size_t len) {
+  SPIClass *spi = (SPIClass *)ctx;
+  if (rx) {
+    spi->transferBytes(tx, rx, len);
+  } else {
+    spi->writeBytes(tx, len);
+  }
+}
 
-  do {
-    resp = s_cards[pdrv]->spi->transfer(0xFF);
-  } while (resp == 0x00 && (millis() - start) < (unsigned int)timeout);
+static uint32_t sdBusMillis() {
+  return millis();
+}
 
-  if (!resp) {
+bool sdWait(uint8_t pdrv, int timeout) {
+  bool ready = sd_bus_wait(&s_cards[pdrv]->bus, timeout);
+  if (!ready) {
     log_w("Wait Failed");
   }
-  return (resp > 0x00);
+  return ready;
 }
 
 void sdStop(uint8_t pdrv) {
@@ -204,35 +213,14 @@ char sdCommand(uint8_t pdrv, char cmd, unsigned int arg, unsigned int *resp) {
 }
 
 bool sdReadBytes(uint8_t pdrv, char *buffer, int length) {
-  char token;
-  unsigned short crc;
   ardu_sdcard_t *card = s_cards[pdrv];
-
-  uint32_t start = millis();
-  do {
-    token = card->spi->transfer(0xFF);
-  } while (token == 0xFF && (millis() - start) < 500);
-
-  if (token != 0xFE) {
-    return false;
-  }
-
-  card->spi->transferBytes(NULL, (uint8_t *)buffer, length);
-  crc = card->spi->transfer16(0xFFFF);
-  return (!card->supports_crc || crc == CRC16(buffer, length));
+  return sd_bus_read_blocks(&card->bus, (uint8_t *)buffer, length, 1, card->supports_crc) == 1;
 }
 
 char sdWriteBytes(uint8_t pdrv, const char *buffer, char token) {
   ardu_sdcard_t *card = s_cards[pdrv];
-  unsigned short crc = (card->supports_crc) ? CRC16(buffer, 512) : 0xFFFF;
-  if (!sdWait(pdrv, 500)) {
-    return 0;
-  }
-
-  card->spi->write(token);
-  card->spi->writeBytes((uint8_t *)buffer, 512);
-  card->spi->write16(crc);
-  return (card->spi->transfer(0xFF) & 0x1F);
+  int written;
+  return sd_bus_write_blocks(&card->bus, (const uint8_t *)buffer, 1, token, card->supports_crc, &written);
 }
 
 /*
@@ -274,16 +262,16 @@ bool sdReadSectors(uint8_t pdrv, char *buffer, unsigned long long sector, int co
     }
 
     if (!sdCommand(pdrv, READ_BLOCK_MULTIPLE, (s_cards[pdrv]->type == CARD_SDHC) ? sector : sector << 9, NULL)) {
-      do {
-        if (!sdReadBytes(pdrv, buffer, 512)) {
-          f++;
-          break;
-        }
-
-        sector++;
-        buffer += 512;
+      int got = sd_bus_read_blocks(&s_cards[pdrv]->bus, (uint8_t *)buffer, 512, count, s_cards[pdrv]->supports_crc);
+      sector += got;
+      buffer += got * 512;
+      count -= got;
+      if (got) {
         f = 0;
-      } while (--count);
+      }
+      if (count) {
+        f++;
+      }
 
       if (sdCommand(pdrv, STOP_TRANSMISSION, 0, NULL)) {
         log_e("command failed");
@@ -349,15 +337,18 @@ bool sdWriteSectors(uint8_t pdrv, const char *buffer, unsigned long long sector,
     }
 
     if (!sdCommand(pdrv, WRITE_BLOCK_MULTIPLE, (card->type == CARD_SDHC) ? currentSector : currentSector << 9, NULL)) {
-      do {
-        token = sdWriteBytes(pdrv, currentBuffer, 0xFC);
-        if (token != 0x05) {
-          f++;
-          break;
-        }
-        currentBuffer += 512;
+      int written;
+      token = sd_bus_write_blocks(
+        &card->bus, (const uint8_t *)currentBuffer, currentCount, 0xFC, card->supports_crc, &written
+      );
+      currentBuffer += written * 512;
+      currentCount -= written;
+      if (written) {
         f = 0;
-      } while (--currentCount);
+      }
+      if (token != 0x05) {
+        f++;
+      }
 
       if (!sdWait(pdrv, 500)) {
         break;
@@ -654,12 +645,13 @@ DRESULT ff_sd_ioctl(uint8_t pdrv, uint8_t cmd, void *buff) {
   return RES_PARERR;
 }
 
-bool sd_read_raw(uint8_t pdrv, uint8_t *buffer, DWORD sector) {
-  return ff_sd_read(pdrv, buffer, sector, 1) == ESP_OK;
+// count > 1 goes out as a single CMD18/CMD25 transfer
+bool sd_read_raw(uint8_t pdrv, uint8_t *buffer, DWORD sector, uint32_t count) {
+  return ff_sd_read(pdrv, buffer, sector, count) == ESP_OK;
 }
 
-bool sd_write_raw(uint8_t pdrv, uint8_t *buffer, DWORD sector) {
-  return ff_sd_write(pdrv, buffer, sector, 1) == ESP_OK;
+bool sd_write_raw(uint8_t pdrv, uint8_t *buffer, DWORD sector, uint32_t count) {
+  return ff_sd_write(pdrv, buffer, sector, count) == ESP_OK;
 }
 
 /*
@@ -707,6 +699,11 @@ uint8_t sdcard_init(uint8_t cs, SPIClass *spi, int hz) {
   card->type = CARD_NONE;
   card->status = STA_NOINIT;
 
+  card->bus.ctx = spi;
+  card->bus.start = &sdBusStart;
+  card->bus.finish = NULL;
+  card->bus.millis = &sdBusMillis;
+
   pinMode(card->ssPin, OUTPUT);
   digitalWrite(card->ssPin, HIGH);
   perimanSetPinBusExtraType(card->ssPin, "SD_SS");
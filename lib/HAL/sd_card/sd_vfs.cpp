@@ -0,0 +1,90 @@
+#include "../SD.h"
+#if !defined(USE_SD_MMC) || defined(SOC_SDMMC_HOST_SUPPORTED)
+#include "ff.h"
+#include "sd_vfs.h"
+
+using namespace fs;
+
+static std::string parentFolder(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash || slash == path) return "/";
+    return std::string(path, slash - path);
+}
+
+FileImplPtr SDVFSImpl::open(const char *path, const char *mode, const bool create) {
+    // anything but a plain read may create or resize the file
+    bool write = mode && (mode[0] != 'r' || strchr(mode, '+'));
+    if (write) changed(path);
+    FileImplPtr file = VFSImpl::open(path, mode, create);
+    if (write && file && path) {
+        std::lock_guard<std::mutex> lock(_writersLock);
+        pruneWriters();
+        _writers.push_back({file, parentFolder(path)});
+    }
+    return file;
+}
+
+bool SDVFSImpl::writing(const char *folder) {
+    std::string key = folder && folder[0] ? folder : "/";
+    if (key.size() > 1 && key.back() == '/') key.pop_back();
+    std::lock_guard<std::mutex> lock(_writersLock);
+    pruneWriters();
+    for (const Writer &writer : _writers) {
+        if (writer.folder == key) return true;
+    }
+    return false;
+}
+
+void SDVFSImpl::pruneWriters() {
+    for (size_t i = _writers.size(); i-- > 0;) {
+        FileImplPtr file = _writers[i].file.lock();
+        // a closed File may stay around (a global, a member) with its FileImpl
+        if (!file || !*file) _writers.erase(_writers.begin() + i);
+    }
+}
+
+bool SDVFSImpl::rename(const char *pathFrom, const char *pathTo) {
+    bool ok = VFSImpl::rename(pathFrom, pathTo);
+    changed(pathFrom);
+    changed(pathTo);
+    return ok;
+}
+
+bool SDVFSImpl::remove(const char *path) {
+    bool ok = VFSImpl::remove(path);
+    changed(path);
+    return ok;
+}
+
+bool SDVFSImpl::mkdir(const char *path) {
+    bool ok = VFSImpl::mkdir(path);
+    changed(path);
+    return ok;
+}
+
+bool SDVFSImpl::rmdir(const char *path) {
+    bool ok = VFSImpl::rmdir(path);
+    changed(path);
+    return ok;
+}
+
+void SDFS::onChange(void (*callback)(const char *path)) {
+    static_cast<SDVFSImpl *>(_impl.get())->onChange(callback);
+}
+
+bool SDFS::writing(const char *folder) { return static_cast<SDVFSImpl *>(_impl.get())->writing(folder); }
+
+bool SDFS::listDir(const char *path, ListCallback callback, void *ctx) {
+    if (_pdrv == 0xFF || !path) { return false; }
+    String fatPath = String((char)('0' + _pdrv)) + ":" + (path[0] == '/' ? "" : "/") + path;
+    FF_DIR dir;
+    FILINFO info;
+    if (f_opendir(&dir, fatPath.c_str()) != FR_OK) { return false; }
+    while (f_readdir(&dir, &info) == FR_OK && info.fname[0]) {
+        uint32_t mtime = ((uint32_t)info.fdate << 16) | info.ftime;
+        callback(ctx, info.fname, info.fattrib & AM_DIR, info.fsize, mtime);
+    }
+    f_closedir(&dir);
+    return true;
+}
+#endif
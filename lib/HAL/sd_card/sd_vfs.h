@@ -0,0 +1,42 @@
+#ifndef __SD_VFS_H__
+#define __SD_VFS_H__
+
+#include "vfs_api.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// VFS of the SD card that reports every path it changes, so callers can drop what they cached
+class SDVFSImpl : public VFSImpl {
+public:
+    void onChange(void (*callback)(const char *path)) { _onChange = callback; }
+
+    FileImplPtr open(const char *path, const char *mode, const bool create) override;
+    bool rename(const char *pathFrom, const char *pathTo) override;
+    bool remove(const char *path) override;
+    bool mkdir(const char *path) override;
+    bool rmdir(const char *path) override;
+
+    // A file of folder is open for writing, so the size it lists may still change
+    bool writing(const char *folder);
+
+private:
+    void changed(const char *path) {
+        if (_onChange && path) _onChange(path);
+    }
+
+    void pruneWriters(); // with _writersLock held
+
+    void (*_onChange)(const char *path) = nullptr;
+
+    // Files opened for writing, dropped once closed
+    struct Writer {
+        std::weak_ptr<FileImpl> file;
+        std::string folder;
+    };
+    std::mutex _writersLock;
+    std::vector<Writer> _writers;
+};
+
+#endif
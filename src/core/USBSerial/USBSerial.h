@@ -18,6 +18,11 @@ public:
     void flush() override { out->flush(); }
     int available() override { return out->available(); }
     size_t write(uint8_t *str, size_t size) override { return out->write(str, size); }
+    size_t read(uint8_t *buf, size_t size) override {
+        int n = out->available();
+        if (n <= 0) return 0;
+        return out->readBytes(buf, size < (size_t)n ? size : n);
+    }
     void setSerialOutput(Stream *in) { out = in; }
     Stream *getSerialOutput() { return out; }
     USBSerial(Stream *in = &Serial) { out = in; }
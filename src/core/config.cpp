@@ -1,6 +1,261 @@
 #include "config.h"
+#include "config_store.h"
+#include "core/crc32.h"
 #include "mifare_keys_manager.h"
 #include "sd_functions.h"
+#include <esp_system.h>
+#include <globals.h>
+
+#define CONFIG_SNAPSHOT_PATH "/bruce.bin"
+#define CONFIG_FLUSH_QUIET_MS 1000
+#define CONFIG_FLUSH_MAX_DELAY_MS 5000
+#define CONFIG_FLUSH_TASK_STACK_SIZE 6144
+#define CONFIG_JSON_STAMP 0 // record with the size and CRC32 of the JSON file last written or read
+
+// LittleFS or SD for ConfigStore
+class FsConfigStorage : public ConfigStorage {
+public:
+    FsConfigStorage(FS &fs) : _fs(fs) {}
+
+    bool read(const char *path, std::string &data) override {
+        if (!_fs.exists(path)) return false;
+        File file = _fs.open(path, FILE_READ);
+        if (!file) return false;
+        data.resize(file.size());
+        bool ok = file.read((uint8_t *)&data[0], data.size()) == data.size();
+        file.close();
+        return ok;
+    }
+    bool write(const char *path, const uint8_t *data, size_t len) override {
+        File file = _fs.open(path, FILE_WRITE);
+        if (!file) return false;
+        bool ok = file.write(data, len) == len;
+        file.close();
+        return ok;
+    }
+    bool rename(const char *from, const char *to) override {
+        if (_fs.rename(from, to)) return true;
+        // FAT does not rename over a file
+        _fs.remove(to);
+        return _fs.rename(from, to);
+    }
+    bool remove(const char *path) override { return !_fs.exists(path) || _fs.remove(path); }
+
+private:
+    FS &_fs;
+};
+
+static FsConfigStorage configStorage(LittleFS);
+static ConfigStore configStore(configStorage, CONFIG_SNAPSHOT_PATH);
+static std::string configJsonStamp; // of the JSON file as it is on flash
+static ConfigDebounce configDebounce(CONFIG_FLUSH_QUIET_MS, CONFIG_FLUSH_MAX_DELAY_MS);
+static portMUX_TYPE configDebounceMux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t configFlushMutex = NULL; // one flush at a time
+static SemaphoreHandle_t configQueueMutex = NULL; // for configQueued and configQueuedJson
+static ConfigRecords configQueued;                 // the fields as last handed to the flush task, no stamp
+static String configQueuedJson;                    // JSON not written yet, empty when the file is current
+static TaskHandle_t configFlushTaskHandle = NULL;
+static bool configFlushStopped = false; // by a factory reset, until the restart
+
+static void putConfigValue(std::string &out, const String &value) {
+    size_t len = min<size_t>(value.length(), CONFIG_RECORD_MAX_SIZE);
+    out += (char)len;
+    out += (char)(len >> 8);
+    out.append(value.c_str(), len);
+}
+
+static void putConfigValue(std::string &out, const BruceConfig::QrCodeEntry &value) {
+    putConfigValue(out, value.menuName);
+    putConfigValue(out, value.content);
+}
+
+template <class T> static void putConfigValue(std::string &out, const T &value) {
+    out.append((const char *)&value, sizeof(value));
+}
+
+template <class T> static void putConfigValue(std::string &out, const std::vector<T> &values) {
+    for (const auto &value : values) putConfigValue(out, value);
+}
+
+template <class T> static void putConfigValue(std::string &out, const std::set<T> &values) {
+    for (const auto &value : values) putConfigValue(out, value);
+}
+
+static void putConfigValue(std::string &out, const std::map<String, String> &values) {
+    for (const auto &pair : values) {
+        putConfigValue(out, pair.first);
+        putConfigValue(out, pair.second);
+    }
+}
+
+static bool getConfigValue(const char *&p, const char *end, String &value) {
+    if (end - p < 2) return false;
+    size_t len = (uint8_t)p[0] | (uint8_t)p[1] << 8;
+    p += 2;
+    if ((size_t)(end - p) < len) return false;
+    value = "";
+    value.concat(p, len);
+    p += len;
+    return true;
+}
+
+static bool getConfigValue(const char *&p, const char *end, BruceConfig::QrCodeEntry &value) {
+    return getConfigValue(p, end, value.menuName) && getConfigValue(p, end, value.content);
+}
+
+template <class T> static bool getConfigValue(const char *&p, const char *end, T &value) {
+    if ((size_t)(end - p) < sizeof(value)) return false;
+    memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return true;
+}
+
+template <class T> static bool getConfigValue(const char *&p, const char *end, std::vector<T> &values) {
+    while (p < end) {
+        T value;
+        if (!getConfigValue(p, end, value)) return false;
+        values.push_back(value);
+    }
+    return true;
+}
+
+template <class T> static bool getConfigValue(const char *&p, const char *end, std::set<T> &values) {
+    while (p < end) {
+        T value;
+        if (!getConfigValue(p, end, value)) return false;
+        values.insert(value);
+    }
+    return true;
+}
+
+static bool getConfigValue(const char *&p, const char *end, std::map<String, String> &values) {
+    while (p < end) {
+        String key, value;
+        if (!getConfigValue(p, end, key) || !getConfigValue(p, end, value)) return false;
+        values[key] = value;
+    }
+    return true;
+}
+
+// Encodes each field into its record
+struct ConfigRecordWriter {
+    ConfigRecords &records;
+    template <class T> void operator()(uint8_t id, const T &field) { putConfigValue(records[id], field); }
+};
+
+// Decodes the records into their fields, a field without a valid record keeps its value
+struct ConfigRecordReader {
+    const ConfigRecords &records;
+    template <class T> void operator()(uint8_t id, T &field) {
+        auto it = records.find(id);
+        if (it == records.end()) return;
+        const char *p = it->second.data();
+        const char *end = p + it->second.size();
+        T value{};
+        if (getConfigValue(p, end, value) && p == end) field = value;
+    }
+};
+
+// The fields in the snapshot, an id is never given to another field
+template <class Config, class Visitor> static void visitConfigFields(Config &c, Visitor &v) {
+    v(1, c.priColor);
+    v(2, c.secColor);
+    v(3, c.bgColor);
+    v(4, c.themePath);
+    v(5, c.theme.fs);
+    v(6, c.dimmerSet);
+    v(7, c.bright);
+    v(8, c.automaticTimeUpdateViaNTP);
+    v(9, c.tmz);
+    v(10, c.dst);
+    v(11, c.clock24hr);
+    v(12, c.soundEnabled);
+    v(13, c.soundVolume);
+    v(14, c.wifiAtStartup);
+    v(15, c.instantBoot);
+#ifdef HAS_RGB_LED
+    v(16, c.ledBright);
+    v(17, c.ledColor);
+    v(18, c.ledBlinkEnabled);
+    v(19, c.ledEffect);
+    v(20, c.ledEffectSpeed);
+    v(21, c.ledEffectDirection);
+#endif
+    v(22, c.webUI.user);
+    v(23, c.webUI.pwd);
+    v(24, c.webUISessions);
+    v(25, c.wifiAp.ssid);
+    v(26, c.wifiAp.pwd);
+    v(27, c.wifiMAC);
+    v(28, c.wifi);
+    v(29, c.evilWifiNames);
+    v(30, c.evilPortalEndpoints.getCredsEndpoint);
+    v(31, c.evilPortalEndpoints.setSsidEndpoint);
+    v(32, c.evilPortalEndpoints.showEndpoints);
+    v(33, c.evilPortalEndpoints.allowSetSsid);
+    v(34, c.evilPortalEndpoints.allowGetCreds);
+    v(35, c.evilPortalPasswordMode);
+    v(36, c.startupApp);
+    v(37, c.startupAppJSInterpreterFile);
+    v(38, c.wigleBasicToken);
+    v(39, c.devMode);
+    v(40, c.colorInverted);
+    v(41, c.badUSBBLEKeyboardLayout);
+    v(42, c.badUSBBLEKeyDelay);
+    v(43, c.badUSBBLEShowOutput);
+    v(44, c.disabledMenus);
+    v(45, c.qrCodes);
+}
+
+static std::string jsonStamp(const uint8_t *data, size_t len) {
+    uint32_t stamp[2] = {(uint32_t)len, crc32Update(0, data, len)};
+    return std::string((const char *)stamp, sizeof(stamp));
+}
+
+// Writes through a temporary file, so power lost on the way leaves the old file or the new one
+static bool writeConfigJson(FS &fs, const char *path, const String &json) {
+    FsConfigStorage storage(fs);
+    String tmp = String(path) + ".tmp";
+    return storage.write(tmp.c_str(), (const uint8_t *)json.c_str(), json.length()) &&
+           storage.rename(tmp.c_str(), path);
+}
+
+static void loadConfigSnapshot(BruceConfig &config, ConfigRecords &records) {
+    ConfigRecordReader reader{records};
+    visitConfigFields(config, reader);
+    configJsonStamp = records[CONFIG_JSON_STAMP];
+    config.validateConfig();
+    MifareKeysManager::ensureLoaded(config.mifareKeys);
+    log_i("Using config from snapshot");
+}
+
+static void configFlushTask(void *parameter) {
+    while (true) {
+        portENTER_CRITICAL(&configDebounceMux);
+        bool pending = configDebounce.pending();
+        uint32_t wait = configDebounce.wait(millis());
+        portEXIT_CRITICAL(&configDebounceMux);
+
+        // saveFile() notifies, to start waiting or to wait longer
+        if (!pending) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        else if (wait > 0) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+        else bruceConfig.flush();
+    }
+}
+
+// ESP.restart() writes what is pending first
+static void configShutdownHandler() { bruceConfig.flush(); }
+
+static void startConfigFlushTask() {
+    if (configFlushTaskHandle != NULL) return;
+    configFlushMutex = xSemaphoreCreateMutex();
+    configQueueMutex = xSemaphoreCreateMutex();
+    if (configFlushMutex == NULL || configQueueMutex == NULL) return;
+    xTaskCreate(
+        configFlushTask, "configFlush", CONFIG_FLUSH_TASK_STACK_SIZE, NULL, 1, &configFlushTaskHandle
+    );
+    esp_register_shutdown_handler(configShutdownHandler);
+}
 
 JsonDocument BruceConfig::toJson() const {
     JsonDocument jsonDoc;
@@ -82,6 +337,7 @@ JsonDocument BruceConfig::toJson() const {
 }
 
 void BruceConfig::fromFile(bool checkFS) {
+    startConfigFlushTask();
     FS *fs;
     if (checkFS) {
         if (!getFsStorage(fs)) {
@@ -93,25 +349,38 @@ void BruceConfig::fromFile(bool checkFS) {
         else return;
     }
 
-    if (!fs->exists(filepath)) {
-        log_i("Config file not found. Creating default config");
-        return saveFile();
+    // The snapshot, unless the JSON file was edited since it was written
+    std::string json;
+    bool jsonFound = FsConfigStorage(*fs).read(filepath, json);
+    std::string stamp = jsonStamp((const uint8_t *)json.data(), json.size());
+    ConfigRecords records;
+    bool snapshotFound = configStore.load(records);
+    if (snapshotFound) {
+        if (configQueueMutex != NULL) xSemaphoreTake(configQueueMutex, portMAX_DELAY);
+        configQueued = records;
+        configQueued.erase(CONFIG_JSON_STAMP);
+        if (configQueueMutex != NULL) xSemaphoreGive(configQueueMutex);
+    }
+    if (snapshotFound && (!jsonFound || records[CONFIG_JSON_STAMP] == stamp)) {
+        return loadConfigSnapshot(*this, records);
     }
 
-    File file;
-    file = fs->open(filepath, FILE_READ);
-    if (!file) {
-        log_i("Config file not found. Using default values");
-        return;
+    if (!jsonFound) {
+        log_i("Config file not found. Creating default config");
+        return saveFile();
     }
 
     // Deserialize the JSON document
     JsonDocument jsonDoc;
-    if (deserializeJson(jsonDoc, file)) {
+    if (deserializeJson(jsonDoc, json)) {
+        if (snapshotFound) {
+            log_i("Failed to read config file, using the snapshot");
+            return loadConfigSnapshot(*this, records);
+        }
         Serial.println("Failed to read config file, using default configuration");
         return;
     }
-    file.close();
+    configJsonStamp = stamp;
 
     JsonObject setting = jsonDoc.as<JsonObject>();
     int count = 0;
@@ -404,7 +673,9 @@ void BruceConfig::fromFile(bool checkFS) {
     }
 
     validateConfig();
-    if (count > 0) saveFile();
+    if (count > 0) log_i("%d settings missing from the config file, using defaults", count);
+    // also when nothing is missing, so the snapshot follows the file
+    saveFile();
 
     // Load MIFARE keys (loading via manager)
     MifareKeysManager::ensureLoaded(mifareKeys);
@@ -412,29 +683,68 @@ void BruceConfig::fromFile(bool checkFS) {
     log_i("Using config from file");
 }
 
+// The fields are encoded here, by the task that changed them, and only written by the flush task
 void BruceConfig::saveFile() {
-    FS *fs = &LittleFS;
-    JsonDocument jsonDoc = toJson();
-
-    // Open file for writing
-    File file = fs->open(filepath, FILE_WRITE);
-    if (!file) {
-        log_e("Failed to open config file");
-        file.close();
-        return;
-    };
-
-    // Serialize JSON to file
-    serializeJsonPretty(jsonDoc, Serial);
-    if (serializeJsonPretty(jsonDoc, file) < 5) log_e("Failed to write config file");
-    else log_i("config file written successfully");
+    ConfigRecords records;
+    ConfigRecordWriter writer{records};
+    visitConfigFields(*this, writer);
+
+    if (configQueueMutex != NULL) xSemaphoreTake(configQueueMutex, portMAX_DELAY);
+    bool changed = records != configQueued;
+    String json;
+    if (changed) {
+        serializeJsonPretty(toJson(), json);
+        configQueued = std::move(records);
+        configQueuedJson = json;
+    }
+    portENTER_CRITICAL(&configDebounceMux);
+    configDebounce.touch(millis());
+    portEXIT_CRITICAL(&configDebounceMux);
+    if (configQueueMutex != NULL) xSemaphoreGive(configQueueMutex);
+
+    // The SD card may share its SPI bus with the display or a radio: copied here, not in the background
+    if (changed && setupSdCard() && !writeConfigJson(SD, filepath, json)) {
+        log_e("Failed to copy config to SD");
+    }
 
-    file.close();
+    if (configFlushTaskHandle != NULL) xTaskNotifyGive(configFlushTaskHandle);
+    else flush();
+}
+
+void BruceConfig::flush() {
+    if (configFlushMutex != NULL) xSemaphoreTake(configFlushMutex, portMAX_DELAY);
+    if (configQueueMutex != NULL) xSemaphoreTake(configQueueMutex, portMAX_DELAY);
+    portENTER_CRITICAL(&configDebounceMux);
+    bool pending = configDebounce.pending() && !configFlushStopped;
+    configDebounce.clear();
+    portEXIT_CRITICAL(&configDebounceMux);
+    ConfigRecords records;
+    String json;
+    if (pending) {
+        records = configQueued;
+        json = std::move(configQueuedJson);
+        configQueuedJson = "";
+    }
+    if (configQueueMutex != NULL) xSemaphoreGive(configQueueMutex);
 
-    if (setupSdCard()) copyToFs(LittleFS, SD, filepath, false);
+    if (pending) {
+        if (json.length() > 0) {
+            if (!writeConfigJson(LittleFS, filepath, json)) log_e("Failed to write config file");
+            else configJsonStamp = jsonStamp((const uint8_t *)json.c_str(), json.length());
+        }
+        records[CONFIG_JSON_STAMP] = configJsonStamp;
+        if (!configStore.save(records)) log_e("Failed to write config snapshot");
+        else log_i("config written, generation %lu", (unsigned long)configStore.generation());
+    }
+    if (configFlushMutex != NULL) xSemaphoreGive(configFlushMutex);
 }
 
 void BruceConfig::factoryReset() {
+    if (configFlushMutex != NULL) xSemaphoreTake(configFlushMutex, portMAX_DELAY);
+    configFlushStopped = true;
+    configStore.remove();
+    if (configFlushMutex != NULL) xSemaphoreGive(configFlushMutex);
+
     FS *fs = &LittleFS;
     fs->rename(String(filepath), "/bak." + String(filepath).substring(1));
     if (setupSdCard()) SD.rename(String(filepath), "/bak." + String(filepath).substring(1));
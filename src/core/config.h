@@ -105,7 +105,10 @@ public:
     /////////////////////////////////////////////////////////////////////////////////////
     // Operations
     /////////////////////////////////////////////////////////////////////////////////////
+    // Queues a write of the settings, flush() does it once they stop changing for a second
     void saveFile();
+    // Writes queued changes now
+    void flush();
     void fromFile(bool checkFS = true);
     void factoryReset();
     void validateConfig();
@@ -0,0 +1,124 @@
+#include "config_store.h"
+#include "core/crc32.h"
+#include <string.h>
+
+static const char kMagic[4] = {'B', 'C', 'S', '1'};
+static const size_t kHeaderSize = 12; // magic, generation, length
+static const size_t kRecordHeaderSize = 3;
+
+static void putU32(std::string &out, uint32_t v) {
+    out += (char)v;
+    out += (char)(v >> 8);
+    out += (char)(v >> 16);
+    out += (char)(v >> 24);
+}
+
+static uint32_t getU32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+ConfigStore::ConfigStore(ConfigStorage &storage, const char *path)
+    : _storage(storage), _path(path), _tmpPath(std::string(path) + ".tmp") {}
+
+bool ConfigStore::parse(const std::string &data, uint32_t &generation, ConfigRecords &records) const {
+    const uint8_t *p = (const uint8_t *)data.data();
+    if (data.size() < kHeaderSize + 4 || memcmp(p, kMagic, sizeof(kMagic)) != 0) return false;
+    uint32_t len = getU32(p + 8);
+    if (len != data.size() - kHeaderSize - 4) return false;
+    if (crc32Update(0, p + 4, 8 + len) != getU32(p + kHeaderSize + len)) return false;
+
+    generation = getU32(p + 4);
+    records.clear();
+    for (size_t pos = kHeaderSize; pos < kHeaderSize + len;) {
+        if (kHeaderSize + len - pos < kRecordHeaderSize) return false;
+        uint8_t id = p[pos];
+        size_t size = p[pos + 1] | p[pos + 2] << 8;
+        pos += kRecordHeaderSize;
+        if (kHeaderSize + len - pos < size) return false;
+        records[id].assign((const char *)p + pos, size);
+        pos += size;
+    }
+    return true;
+}
+
+bool ConfigStore::load(ConfigRecords &records) {
+    std::string data;
+    ConfigRecords tmpRecords;
+    uint32_t generation = 0, tmpGeneration = 0;
+    bool found = _storage.read(_path.c_str(), data) && parse(data, generation, _records);
+    bool tmpFound = _storage.read(_tmpPath.c_str(), data) && parse(data, tmpGeneration, tmpRecords);
+    if (!found && !tmpFound) {
+        _records.clear();
+        _generation = 0;
+        return false;
+    }
+
+    if (tmpFound && (!found || tmpGeneration > generation)) {
+        // the rename did not happen: finish it, or a torn write of the next snapshot to the temporary
+        // file would leave only the one before
+        _records.swap(tmpRecords);
+        generation = tmpGeneration;
+        _storage.rename(_tmpPath.c_str(), _path.c_str());
+    }
+    _generation = generation;
+    records = _records;
+    return true;
+}
+
+size_t ConfigStore::changes(const ConfigRecords &records) const {
+    size_t count = 0;
+    for (const auto &record : records) {
+        auto it = _records.find(record.first);
+        if (it == _records.end() || it->second != record.second) count++;
+    }
+    for (const auto &record : _records) {
+        if (records.find(record.first) == records.end()) count++;
+    }
+    return count;
+}
+
+bool ConfigStore::save(const ConfigRecords &records) {
+    if (changes(records) == 0) return true;
+
+    std::string data(kMagic, sizeof(kMagic));
+    putU32(data, _generation + 1);
+    putU32(data, 0); // length, once known
+    for (const auto &record : records) {
+        if (record.second.size() > CONFIG_RECORD_MAX_SIZE) return false;
+        data += (char)record.first;
+        data += (char)record.second.size();
+        data += (char)(record.second.size() >> 8);
+        data += record.second;
+    }
+    uint32_t len = data.size() - kHeaderSize;
+    for (int i = 0; i < 4; i++) data[8 + i] = (char)(len >> (8 * i));
+    putU32(data, crc32Update(0, (const uint8_t *)data.data() + 4, 8 + len));
+
+    if (!_storage.write(_tmpPath.c_str(), (const uint8_t *)data.data(), data.size())) return false;
+    if (!_storage.rename(_tmpPath.c_str(), _path.c_str())) return false;
+    _records = records;
+    _generation++;
+    return true;
+}
+
+void ConfigStore::remove() {
+    _storage.remove(_path.c_str());
+    _storage.remove(_tmpPath.c_str());
+    _records.clear();
+    _generation = 0;
+}
+
+void ConfigDebounce::touch(uint32_t now) {
+    if (!_pending) _first = now;
+    _last = now;
+    _pending = true;
+}
+
+uint32_t ConfigDebounce::wait(uint32_t now) const {
+    if (!_pending) return 0;
+    uint32_t quiet = now - _last;
+    uint32_t waited = now - _first;
+    if (quiet >= _quietMs || waited >= _maxDelayMs) return 0;
+    uint32_t left = _quietMs - quiet;
+    return left < _maxDelayMs - waited ? left : _maxDelayMs - waited;
+}
@@ -0,0 +1,83 @@
+#ifndef __CONFIG_STORE_H__
+#define __CONFIG_STORE_H__
+
+// Binary snapshot of the settings, loaded at boot instead of parsing the JSON file, which stays the
+// format to read, edit and export.
+// Snapshot: magic "BCS1", generation (u32 LE), payload length (u32 LE), payload, CRC32 (LE) of the
+// generation, length and payload. The payload holds one record per field: id (u8), length (u16 LE),
+// value. Records of ids the firmware does not know are skipped, so fields can come and go.
+// A snapshot is written whole to "<path>.tmp", which is then renamed over <path>. Power lost while
+// writing leaves the previous snapshot; on a filesystem that can't rename over a file, power lost
+// between removing <path> and the rename leaves the new one in "<path>.tmp". load() takes the valid
+// one with the higher generation.
+// No Arduino dependencies, so power loss can be simulated at every write on the host.
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#define CONFIG_RECORD_MAX_SIZE 0xFFFF
+
+// Encoded value of each field, by id
+typedef std::map<uint8_t, std::string> ConfigRecords;
+
+// Files of the snapshot
+class ConfigStorage {
+public:
+    virtual ~ConfigStorage() = default;
+    // Whole file, false when it does not exist or can't be read
+    virtual bool read(const char *path, std::string &data) = 0;
+    // Creates or truncates path with data
+    virtual bool write(const char *path, const uint8_t *data, size_t len) = 0;
+    // Moves from to to, replacing it
+    virtual bool rename(const char *from, const char *to) = 0;
+    virtual bool remove(const char *path) = 0;
+};
+
+class ConfigStore {
+public:
+    ConfigStore(ConfigStorage &storage, const char *path);
+
+    // Records of the latest snapshot, false when there is none
+    bool load(ConfigRecords &records);
+    // Fields whose record differs from the snapshot
+    size_t changes(const ConfigRecords &records) const;
+    // Writes records as the new snapshot when any of them changed, false on a write error
+    bool save(const ConfigRecords &records);
+    // Deletes the snapshot, the next save() writes every field
+    void remove();
+    const ConfigRecords &records() const { return _records; }
+    uint32_t generation() const { return _generation; }
+
+private:
+    bool parse(const std::string &data, uint32_t &generation, ConfigRecords &records) const;
+
+    ConfigStorage &_storage;
+    std::string _path;
+    std::string _tmpPath;
+    ConfigRecords _records; // as in the snapshot on flash
+    uint32_t _generation = 0;
+};
+
+// When to write: quietMs after the last change, so a burst of them is written once, but at most
+// maxDelayMs after the first one
+class ConfigDebounce {
+public:
+    ConfigDebounce(uint32_t quietMs, uint32_t maxDelayMs) : _quietMs(quietMs), _maxDelayMs(maxDelayMs) {}
+
+    void touch(uint32_t now);
+    bool pending() const { return _pending; }
+    // Milliseconds until the write is due, 0 when it is
+    uint32_t wait(uint32_t now) const;
+    void clear() { _pending = false; }
+
+private:
+    uint32_t _quietMs;
+    uint32_t _maxDelayMs;
+    uint32_t _first = 0;
+    uint32_t _last = 0;
+    bool _pending = false;
+};
+
+#endif
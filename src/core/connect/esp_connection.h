@@ -1,6 +1,7 @@
 #ifndef __ESP_CONNECTION_H__
 #define __ESP_CONNECTION_H__
 
+#include <deque>
 #include <esp_now.h>
 #include <globals.h>
 #include <vector>
@@ -35,12 +36,12 @@ public:
 
         // Constructor to initialize defaults
         Message()
-            : dataSize(0), totalBytes(0), bytesSent(0), isFile(false), done(false), ping(false), pong(false) {
-        }
+            : filename(), filepath(), data(), dataSize(0), totalBytes(0), bytesSent(0), isFile(false),
+              done(false), ping(false), pong(false) {}
     };
 
     EspConnection();
-    ~EspConnection();
+    virtual ~EspConnection();
 
     static void setInstance(EspConnection *conn) { instance = conn; }
 
@@ -52,7 +53,7 @@ protected:
     Status sendStatus;
     uint8_t dstAddress[6];
     uint8_t broadcastAddress[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-    std::vector<Message> recvQueue;
+    std::deque<Message> recvQueue;
 
     bool beginSend();
     bool beginEspnow();
@@ -65,15 +66,15 @@ protected:
     void sendPing();
     void sendPong(const uint8_t *mac);
 
-    bool setupPeer(const uint8_t *mac);
+    static bool setupPeer(const uint8_t *mac);
     void appendPeerToList(const uint8_t *mac);
     void setDstAddress(const uint8_t *address) { memcpy(dstAddress, address, 6); }
 
     String macToString(const uint8_t *mac);
     void printMessage(Message message);
 
-    void onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
-    void onDataRecv(const uint8_t *mac, const uint8_t *incomingData, int len);
+    virtual void onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
+    virtual void onDataRecv(const uint8_t *mac, const uint8_t *incomingData, int len);
 
 private:
     static EspConnection *instance;
@@ -0,0 +1,385 @@
+#include "esp_transfer.h"
+#include "core/crc32.h"
+#include <stdio.h>
+#include <string.h>
+
+static const uint8_t kMagic[2] = {'B', 0xF5};
+#define OFFER_SIZE (5 + ESP_TRANSFER_NAME_SIZE + ESP_TRANSFER_PATH_SIZE)
+
+static void putU32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t getU32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint32_t clampWindow(uint32_t window) {
+    if (window == 0) return 1;
+    return window > ESP_TRANSFER_MAX_WINDOW ? ESP_TRANSFER_MAX_WINDOW : window;
+}
+
+bool isEspTransferPacket(const uint8_t *data, size_t len) {
+    return len >= ESP_TRANSFER_HEADER_SIZE && len <= ESP_TRANSFER_PACKET_SIZE && data[0] == kMagic[0] &&
+           data[1] == kMagic[1] && data[2] >= ESP_TRANSFER_OFFER && data[2] <= ESP_TRANSFER_ABORT;
+}
+
+bool EspTransferRing::push(const uint8_t *mac, const uint8_t *data, size_t len) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (len == 0 || len > ESP_TRANSFER_PACKET_SIZE) return false;
+    if (head - _tail.load(std::memory_order_acquire) == ESP_TRANSFER_RING_SLOTS) return false;
+
+    Slot &s = _slots[head % ESP_TRANSFER_RING_SLOTS];
+    s.len = len;
+    memcpy(s.mac, mac, sizeof(s.mac));
+    memcpy(s.data, data, len);
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+size_t EspTransferRing::pop(uint8_t *mac, uint8_t *buf) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return 0;
+
+    Slot &s = _slots[tail % ESP_TRANSFER_RING_SLOTS];
+    size_t len = s.len;
+    memcpy(mac, s.mac, sizeof(s.mac));
+    memcpy(buf, s.data, len);
+    _tail.store(tail + 1, std::memory_order_release);
+    return len;
+}
+
+bool EspTransferEndpoint::receive(uint8_t &type, uint32_t &seq, size_t &len) {
+    while (true) {
+        size_t n = _link.receive(_packet);
+        if (n == 0) return false;
+        if (!isEspTransferPacket(_packet, n)) continue;
+        if (!_anySession && _packet[3] != _session) continue;
+
+        type = _packet[2];
+        seq = getU32(_packet + 4);
+        len = n - ESP_TRANSFER_HEADER_SIZE;
+        _lastHeard = _link.millis();
+        return true;
+    }
+}
+
+bool EspTransferEndpoint::send(uint8_t type, uint32_t seq, const uint8_t *payload, size_t len) {
+    uint8_t tx[ESP_TRANSFER_PACKET_SIZE];
+    tx[0] = kMagic[0];
+    tx[1] = kMagic[1];
+    tx[2] = type;
+    tx[3] = _session;
+    putU32(tx + 4, seq);
+    if (len) memcpy(tx + ESP_TRANSFER_HEADER_SIZE, payload, len);
+    if (!_link.send(tx, ESP_TRANSFER_HEADER_SIZE + len)) return false;
+    _packetsSent++;
+    return true;
+}
+
+void EspTransferEndpoint::fail(const char *error) {
+    _state = ESP_TRANSFER_FAILED;
+    _error = error;
+}
+
+bool EspTransferEndpoint::peerSilent() { return _link.millis() - _lastHeard > _config.timeoutMs; }
+
+void EspTransferEndpoint::abort() {
+    if (_state == ESP_TRANSFER_SUCCEEDED || _state == ESP_TRANSFER_FAILED) return;
+    if (!_anySession) send(ESP_TRANSFER_ABORT, 0);
+    fail("aborted");
+}
+
+EspTransferSender::EspTransferSender(
+    EspTransferLink &link, TransferSource &source, uint32_t size, const char *name, const char *path,
+    uint8_t session, const EspTransferConfig &config
+)
+    : EspTransferEndpoint(link, config), _source(source), _size(size) {
+    _session = session;
+    snprintf(_name, sizeof(_name), "%s", name);
+    snprintf(_path, sizeof(_path), "%s", path);
+    _frames = (size + ESP_TRANSFER_CHUNK - 1) / ESP_TRANSFER_CHUNK;
+    _window = clampWindow(config.window);
+}
+
+EspTransferState EspTransferSender::poll() {
+    if (_state == ESP_TRANSFER_SUCCEEDED || _state == ESP_TRANSFER_FAILED) return _state;
+    uint32_t now = _link.millis();
+    if (!_started) {
+        _started = true;
+        _lastHeard = now;
+        sendOffer();
+    }
+
+    uint8_t type;
+    uint32_t seq;
+    size_t len;
+    const uint8_t *payload = _packet + ESP_TRANSFER_HEADER_SIZE;
+    while (receive(type, seq, len)) {
+        switch (type) {
+            case ESP_TRANSFER_ACCEPT:
+                if (_state == ESP_TRANSFER_WAITING && len >= 1) {
+                    if (payload[0] && payload[0] < _window) _window = payload[0];
+                    _state = ESP_TRANSFER_RUNNING;
+                }
+                break;
+            case ESP_TRANSFER_SACK:
+                if (_state == ESP_TRANSFER_RUNNING && len >= 4) ack(seq, getU32(payload));
+                break;
+            case ESP_TRANSFER_DONE:
+                if (_state == ESP_TRANSFER_RUNNING && seq == _frames && len >= 1) {
+                    if (payload[0] == 0) _state = ESP_TRANSFER_SUCCEEDED;
+                    else fail("receiver rejected the file");
+                    return _state;
+                }
+                break;
+            case ESP_TRANSFER_ABORT: fail("aborted by receiver"); return _state;
+        }
+    }
+
+    if (_state == ESP_TRANSFER_WAITING) {
+        if (now - _lastOffer > _config.retryMs) sendOffer();
+    } else {
+        while (_next <= _frames && _next < _base + _window) {
+            if (!fill(_next)) return _state;
+            _next++;
+        }
+        for (uint32_t seq = _base; seq < _next; seq++) {
+            Slot &s = slot(seq);
+            if (s.acked) continue;
+            bool expired = false;
+            if (s.sent) {
+                expired = now - s.sentAt > _config.retryMs;
+                // one sent after it arrived first, it was lost
+                bool overtaken = (int32_t)(s.order - _ackedOrder) < 0;
+                if (!expired && !overtaken) continue;
+            }
+            bool resend = s.sent;
+            if (!transmit(seq, s)) break; // the link is full, go on next poll
+            if (resend) _resent++;
+            if (expired) _timeouts++;
+        }
+    }
+    if (peerSilent()) fail(_state == ESP_TRANSFER_WAITING ? "no receiver" : "receiver stopped answering");
+    return _state;
+}
+
+uint32_t EspTransferSender::acked() const {
+    uint64_t bytes = (uint64_t)_base * ESP_TRANSFER_CHUNK;
+    return bytes < _size ? bytes : _size;
+}
+
+bool EspTransferSender::fill(uint32_t seq) {
+    Slot &s = slot(seq);
+    s.sent = false;
+    s.acked = false;
+    if (seq == _frames) {
+        putU32(s.data, _size);
+        putU32(s.data + 4, _crc);
+        s.len = 8;
+        return true;
+    }
+
+    uint32_t pos = seq * ESP_TRANSFER_CHUNK;
+    size_t len = _size - pos < ESP_TRANSFER_CHUNK ? _size - pos : ESP_TRANSFER_CHUNK;
+    if (_source.readAt(pos, s.data, len) != len) {
+        send(ESP_TRANSFER_ABORT, 0);
+        fail("read error");
+        return false;
+    }
+    // frames are filled once and in order, the CRC follows them
+    _crc = crc32Update(_crc, s.data, len);
+    s.len = len;
+    return true;
+}
+
+bool EspTransferSender::transmit(uint32_t seq, Slot &s) {
+    uint8_t type = seq == _frames ? ESP_TRANSFER_END : ESP_TRANSFER_DATA;
+    if (!send(type, seq, s.data, s.len)) return false;
+    s.sent = true;
+    s.sentAt = _link.millis();
+    s.order = ++_order;
+    return true;
+}
+
+void EspTransferSender::ack(uint32_t next, uint32_t bitmap) {
+    // END is acknowledged by DONE only
+    uint32_t end = _next < _frames ? _next : _frames;
+    for (uint32_t i = 0; _base + i < end; i++) {
+        uint32_t seq = _base + i;
+        bool got = seq < next || (seq > next && seq - next - 1 < 32 && (bitmap >> (seq - next - 1) & 1));
+        Slot &s = slot(seq);
+        if (!got || s.acked || !s.sent) continue;
+        s.acked = true;
+        if ((int32_t)(s.order - _ackedOrder) > 0) _ackedOrder = s.order;
+    }
+    while (_base < end && slot(_base).acked) _base++;
+}
+
+void EspTransferSender::sendOffer() {
+    uint8_t offer[OFFER_SIZE];
+    putU32(offer, _size);
+    offer[4] = _window;
+    memcpy(offer + 5, _name, ESP_TRANSFER_NAME_SIZE);
+    memcpy(offer + 5 + ESP_TRANSFER_NAME_SIZE, _path, ESP_TRANSFER_PATH_SIZE);
+    send(ESP_TRANSFER_OFFER, 0, offer, sizeof(offer));
+    _lastOffer = _link.millis();
+}
+
+EspTransferReceiver::EspTransferReceiver(EspTransferLink &link, const EspTransferConfig &config)
+    : EspTransferEndpoint(link, config) {
+    _anySession = true;
+    _window = clampWindow(config.window);
+    memset(&_offer, 0, sizeof(_offer));
+    for (Slot &s : _slots) s.present = false;
+}
+
+EspTransferState EspTransferReceiver::poll() {
+    uint32_t now = _link.millis();
+    if (!_started) {
+        _started = true;
+        _lastHeard = now;
+    }
+
+    uint8_t type;
+    uint32_t seq;
+    size_t len;
+    const uint8_t *payload = _packet + ESP_TRANSFER_HEADER_SIZE;
+    while (receive(type, seq, len)) {
+        if (_state == ESP_TRANSFER_WAITING) {
+            if (type != ESP_TRANSFER_OFFER || len < OFFER_SIZE) continue;
+            _session = _packet[3];
+            _anySession = false;
+            _offer.size = getU32(payload);
+            if (payload[4] && payload[4] < _window) _window = payload[4];
+            memcpy(_offer.name, payload + 5, ESP_TRANSFER_NAME_SIZE);
+            memcpy(_offer.path, payload + 5 + ESP_TRANSFER_NAME_SIZE, ESP_TRANSFER_PATH_SIZE);
+            _offer.name[ESP_TRANSFER_NAME_SIZE - 1] = '\0';
+            _offer.path[ESP_TRANSFER_PATH_SIZE - 1] = '\0';
+            _state = ESP_TRANSFER_OFFERED;
+            return _state; // the rest waits for accept()
+        }
+
+        switch (type) {
+            case ESP_TRANSFER_OFFER:
+                // our ACCEPT was lost
+                if (_state == ESP_TRANSFER_RUNNING) sendAccept();
+                break;
+            case ESP_TRANSFER_DATA:
+                if (_state == ESP_TRANSFER_RUNNING) data(seq, payload, len);
+                break;
+            case ESP_TRANSFER_END: end(seq, payload, len); break;
+            case ESP_TRANSFER_ABORT:
+                if (_state == ESP_TRANSFER_RUNNING || _state == ESP_TRANSFER_OFFERED) {
+                    fail("aborted by sender");
+                }
+                break;
+        }
+    }
+    if (_state != ESP_TRANSFER_RUNNING) return _state;
+
+    if (_sinceAck && now - _lastAck > _config.retryMs / 4) sack();
+    if (peerSilent()) fail("sender stopped answering");
+    return _state;
+}
+
+void EspTransferReceiver::accept(TransferSink &sink) {
+    if (_state != ESP_TRANSFER_OFFERED) return;
+    _sink = &sink;
+    _state = ESP_TRANSFER_RUNNING;
+    _lastHeard = _lastAck = _link.millis();
+    sendAccept();
+}
+
+void EspTransferReceiver::reject() {
+    if (_state != ESP_TRANSFER_OFFERED) return;
+    send(ESP_TRANSFER_ABORT, 0);
+    fail("rejected");
+}
+
+void EspTransferReceiver::data(uint32_t seq, const uint8_t *payload, size_t len) {
+    if (seq < _expected) {
+        // a resend of what we have, our SACK was lost
+        sack();
+        return;
+    }
+    if (seq - _expected >= _window || len == 0 || len > ESP_TRANSFER_CHUNK) return;
+
+    Slot &s = slot(seq);
+    if (!s.present) {
+        memcpy(s.data, payload, len);
+        s.len = len;
+        s.present = true;
+    }
+    if (seq != _expected) {
+        // tell the sender about the gap right away
+        sack();
+        return;
+    }
+
+    uint32_t first = _expected;
+    while (slot(_expected).present) {
+        Slot &f = slot(_expected);
+        if (!_sink->append(f.data, f.len)) {
+            send(ESP_TRANSFER_ABORT, 0);
+            fail("write error");
+            return;
+        }
+        _crc = crc32Update(_crc, f.data, f.len);
+        _received += f.len;
+        f.present = false;
+        _expected++;
+        _sinceAck++;
+    }
+    if (_expected - first > 1 || _sinceAck >= (_window + 3) / 4) sack();
+}
+
+void EspTransferReceiver::end(uint32_t seq, const uint8_t *payload, size_t len) {
+    uint8_t status = 0;
+    if (_state == ESP_TRANSFER_SUCCEEDED) {
+        send(ESP_TRANSFER_DONE, seq, &status, 1);
+        return;
+    }
+    if (_state != ESP_TRANSFER_RUNNING || len < 8) return;
+    if (seq != _expected) {
+        sack();
+        return;
+    }
+
+    if (getU32(payload) != _received || getU32(payload + 4) != _crc) {
+        status = 1;
+        send(ESP_TRANSFER_DONE, seq, &status, 1);
+        fail("CRC mismatch");
+        return;
+    }
+    send(ESP_TRANSFER_DONE, seq, &status, 1);
+    _state = ESP_TRANSFER_SUCCEEDED;
+}
+
+void EspTransferReceiver::sack() {
+    uint32_t bitmap = 0;
+    for (uint32_t i = 0; i + 1 < _window && i < 32; i++) {
+        if (slot(_expected + 1 + i).present) bitmap |= 1u << i;
+    }
+    uint8_t payload[4];
+    putU32(payload, bitmap);
+    send(ESP_TRANSFER_SACK, _expected, payload, sizeof(payload));
+    _sinceAck = 0;
+    _lastAck = _link.millis();
+}
+
+void EspTransferReceiver::sendAccept() {
+    uint8_t window = _window;
+    send(ESP_TRANSFER_ACCEPT, 0, &window, 1);
+}
+
+void EspTransferReceiver::linger(uint32_t ms) {
+    uint32_t start = _link.millis();
+    while (_state == ESP_TRANSFER_SUCCEEDED && _link.millis() - start < ms) {
+        poll();
+        _link.idle();
+    }
+}
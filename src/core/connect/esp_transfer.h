@@ -0,0 +1,213 @@
+#ifndef __ESP_TRANSFER_H__
+#define __ESP_TRANSFER_H__
+
+// File transfer between two devices over ESP-NOW (Connect > Send File / Recv File).
+// Packets: magic "B\xF5", type, session, seq (u32 LE), payload; the packet is one datagram, so the
+// link checks its integrity. A packet of another session is ignored.
+// The sender repeats OFFER {size u32, window u8, name, path} until the receiver answers ACCEPT
+// {window u8}. It then sends DATA frames of ESP_TRANSFER_CHUNK bytes numbered from 0, and END {size
+// u32, crc32 u32 of the file} as the next number, at most window of them unacknowledged. Frames are
+// acknowledged selectively: SACK {seq: next frame in order, bitmap u32 of the 32 frames after it}.
+// The receiver keeps frames that arrive after a gap in a ring and writes them once it is filled.
+// The sender resends a frame when one sent after it was acknowledged first, or when it has not
+// been acknowledged for retryMs. END is answered with DONE {status u8}, either side can ABORT.
+// Packets arrive on the Wi-Fi task, which only copies them into an EspTransferRing; the endpoints
+// run on the task doing the transfer.
+// No Arduino dependencies, so loss and latency can be simulated on the host.
+
+#include "core/serial_commands/file_transfer.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESP_TRANSFER_PACKET_SIZE 250 // ESP_NOW_MAX_DATA_LEN
+#define ESP_TRANSFER_HEADER_SIZE 8
+#define ESP_TRANSFER_CHUNK (ESP_TRANSFER_PACKET_SIZE - ESP_TRANSFER_HEADER_SIZE)
+#define ESP_TRANSFER_MAX_WINDOW 32 // bits in a SACK
+#define ESP_TRANSFER_RING_SLOTS 16
+#define ESP_TRANSFER_NAME_SIZE 64
+#define ESP_TRANSFER_PATH_SIZE 128
+
+enum EspTransferType : uint8_t {
+    ESP_TRANSFER_OFFER = 1,
+    ESP_TRANSFER_ACCEPT,
+    ESP_TRANSFER_DATA,
+    ESP_TRANSFER_SACK,
+    ESP_TRANSFER_END,
+    ESP_TRANSFER_DONE,
+    ESP_TRANSFER_ABORT,
+};
+
+enum EspTransferState {
+    ESP_TRANSFER_WAITING, // receiver: for an offer, sender: for it to be accepted
+    ESP_TRANSFER_OFFERED, // receiver: offer() is waiting for accept() or reject()
+    ESP_TRANSFER_RUNNING,
+    ESP_TRANSFER_SUCCEEDED,
+    ESP_TRANSFER_FAILED,
+};
+
+// True for packets of this protocol, anything else is left to the caller
+bool isEspTransferPacket(const uint8_t *data, size_t len);
+
+// Packets from the Wi-Fi task to the transfer task, one producer and one consumer, no locks
+class EspTransferRing {
+public:
+    // false when full, the packet is dropped and resent by the protocol
+    bool push(const uint8_t *mac, const uint8_t *data, size_t len);
+    // Size of the oldest packet, copied to buf (ESP_TRANSFER_PACKET_SIZE) with its source, 0 if none
+    size_t pop(uint8_t *mac, uint8_t *buf);
+
+private:
+    struct Slot {
+        uint8_t len;
+        uint8_t mac[6];
+        uint8_t data[ESP_TRANSFER_PACKET_SIZE];
+    };
+    Slot _slots[ESP_TRANSFER_RING_SLOTS];
+    std::atomic<uint32_t> _head{0}; // next to push
+    std::atomic<uint32_t> _tail{0}; // next to pop
+};
+
+// Packets to and from the peer
+class EspTransferLink {
+public:
+    virtual ~EspTransferLink() = default;
+    // Queues a packet, false when it could not be (try again later)
+    virtual bool send(const uint8_t *data, size_t len) = 0;
+    // Size of the next packet, copied to buf (ESP_TRANSFER_PACKET_SIZE), 0 if none; never blocks
+    virtual size_t receive(uint8_t *buf) = 0;
+    virtual uint32_t millis() = 0;
+    // Called between polls
+    virtual void idle() {}
+};
+
+struct EspTransferConfig {
+    uint32_t retryMs = 100;    // resend a frame not acknowledged after this long
+    uint32_t timeoutMs = 5000; // give up after this long without a packet from the peer
+    uint8_t window = 16;       // frames in flight, the smaller of both sides is used
+};
+
+struct EspTransferStats {
+    uint32_t packetsSent;
+    uint32_t resent;   // frames sent again
+    uint32_t timeouts; // of them, because their timer expired
+};
+
+struct EspTransferOffer {
+    uint32_t size;
+    char name[ESP_TRANSFER_NAME_SIZE];
+    char path[ESP_TRANSFER_PATH_SIZE];
+};
+
+class EspTransferEndpoint {
+public:
+    EspTransferEndpoint(EspTransferLink &link, const EspTransferConfig &config)
+        : _link(link), _config(config) {}
+    virtual ~EspTransferEndpoint() = default;
+
+    // Handles what arrived and sends what is due, never blocks
+    virtual EspTransferState poll() = 0;
+    void abort();
+
+    EspTransferState state() const { return _state; }
+    const char *error() const { return _error; }
+    EspTransferStats stats() const { return {_packetsSent, _resent, _timeouts}; }
+
+protected:
+    // Next packet of this session, header fields out, payload in _packet + ESP_TRANSFER_HEADER_SIZE
+    bool receive(uint8_t &type, uint32_t &seq, size_t &len);
+    bool send(uint8_t type, uint32_t seq, const uint8_t *payload = nullptr, size_t len = 0);
+    void fail(const char *error);
+    bool peerSilent();
+
+    EspTransferLink &_link;
+    EspTransferConfig _config;
+    EspTransferState _state = ESP_TRANSFER_WAITING;
+    const char *_error = nullptr;
+    uint8_t _session = 0;
+    bool _anySession = false; // a receiver takes the session of the first offer
+    bool _started = false;
+    uint32_t _lastHeard = 0;
+    uint32_t _packetsSent = 0;
+    uint32_t _resent = 0;
+    uint32_t _timeouts = 0;
+    uint8_t _packet[ESP_TRANSFER_PACKET_SIZE];
+};
+
+// Sends size bytes of source, as name in path on the receiver; session tells transfers apart
+class EspTransferSender : public EspTransferEndpoint {
+public:
+    EspTransferSender(
+        EspTransferLink &link, TransferSource &source, uint32_t size, const char *name, const char *path,
+        uint8_t session, const EspTransferConfig &config = {}
+    );
+    EspTransferState poll() override;
+    // Bytes the receiver has
+    uint32_t acked() const;
+
+private:
+    struct Slot {
+        uint32_t sentAt;
+        uint32_t order; // of the last transmission, to spot frames overtaken by later ones
+        uint16_t len;
+        bool sent;
+        bool acked;
+        uint8_t data[ESP_TRANSFER_CHUNK];
+    };
+    Slot &slot(uint32_t seq) { return _slots[seq % ESP_TRANSFER_MAX_WINDOW]; }
+    bool fill(uint32_t seq);
+    bool transmit(uint32_t seq, Slot &s);
+    void ack(uint32_t next, uint32_t bitmap);
+    void sendOffer();
+
+    TransferSource &_source;
+    uint32_t _size;
+    char _name[ESP_TRANSFER_NAME_SIZE];
+    char _path[ESP_TRANSFER_PATH_SIZE];
+    uint32_t _frames;    // DATA frames, END is number _frames
+    uint32_t _base = 0;  // first unacknowledged frame
+    uint32_t _next = 0;  // next frame to fill
+    uint32_t _window;
+    uint32_t _crc = 0;
+    uint32_t _order = 0;
+    uint32_t _ackedOrder = 0; // latest transmission acknowledged
+    uint32_t _lastOffer = 0;
+    Slot _slots[ESP_TRANSFER_MAX_WINDOW];
+};
+
+// Waits for an offer, then receives the file into the sink given to accept()
+class EspTransferReceiver : public EspTransferEndpoint {
+public:
+    EspTransferReceiver(EspTransferLink &link, const EspTransferConfig &config = {});
+    EspTransferState poll() override;
+    const EspTransferOffer &offer() const { return _offer; }
+    void accept(TransferSink &sink);
+    void reject();
+    uint32_t received() const { return _received; }
+    // Answers a repeated END for ms after success, in case DONE was lost
+    void linger(uint32_t ms);
+
+private:
+    struct Slot {
+        uint16_t len;
+        bool present;
+        uint8_t data[ESP_TRANSFER_CHUNK];
+    };
+    Slot &slot(uint32_t seq) { return _slots[seq % ESP_TRANSFER_MAX_WINDOW]; }
+    void data(uint32_t seq, const uint8_t *payload, size_t len);
+    void end(uint32_t seq, const uint8_t *payload, size_t len);
+    void sack();
+    void sendAccept();
+
+    TransferSink *_sink = nullptr;
+    EspTransferOffer _offer;
+    uint32_t _received = 0;
+    uint32_t _crc = 0;
+    uint32_t _expected = 0; // next frame in order
+    uint32_t _window;
+    uint32_t _sinceAck = 0;
+    uint32_t _lastAck = 0;
+    Slot _slots[ESP_TRANSFER_MAX_WINDOW];
+};
+
+#endif
@@ -1,8 +1,46 @@
 #include "file_sharing.h"
 #include "core/display.h"
+#include "core/serial_commands/file_transfer_fs.h"
 #include <SD.h>
+
+// ESP-NOW side of the transfer: the Wi-Fi task fills the ring, the menu task polls the protocol
+class FileSharing::EspNowLink : public EspTransferLink {
+public:
+    EspTransferRing ring;
+
+    EspNowLink(const uint8_t *peer, bool known) : _known(known) { memcpy(_peer, peer, sizeof(_peer)); }
+
+    bool send(const uint8_t *data, size_t len) override { return esp_now_send(_peer, data, len) == ESP_OK; }
+
+    size_t receive(uint8_t *buf) override {
+        uint8_t mac[6];
+        size_t len;
+        while ((len = ring.pop(mac, buf)) > 0) {
+            // Sent to broadcast or waiting for a sender, the first to answer is the peer
+            if (!_known && setupPeer(mac)) {
+                memcpy(_peer, mac, sizeof(_peer));
+                _known = true;
+            }
+            if (memcmp(mac, _peer, sizeof(_peer)) == 0) return len;
+        }
+        return 0;
+    }
+
+    uint32_t millis() override { return ::millis(); }
+    void idle() override { vTaskDelay(1); }
+
+private:
+    uint8_t _peer[6];
+    bool _known;
+};
+
 FileSharing::FileSharing() {}
 
+FileSharing::~FileSharing() {
+    esp_now_unregister_recv_cb();
+    delete transferLink;
+}
+
 void FileSharing::sendFile() {
     drawMainBorderWithTitle("SEND FILE");
 
@@ -15,45 +53,50 @@ void FileSharing::sendFile() {
         return;
     }
 
-    Message message = createFileMessage(file);
-
-    esp_err_t response;
-    sendStatus = STARTED;
+    String path = String(file.path());
+    FileTransferSource source(file);
+    EspTransferSender *sender = nullptr;
+    transferLink = new (std::nothrow) EspNowLink(dstAddress, memcmp(dstAddress, broadcastAddress, 6) != 0);
+    if (transferLink) {
+        sender = new (std::nothrow) EspTransferSender(
+            *transferLink,
+            source,
+            file.size(),
+            file.name(),
+            path.substring(0, path.lastIndexOf("/")).c_str(),
+            esp_random()
+        );
+    }
+    if (!sender) {
+        displayError("Not enough memory");
+        file.close();
+        delay(1000);
+        return;
+    }
 
     drawMainBorderWithTitle("SEND FILE");
     padprintln("");
     padprintln("Sending...");
 
-    delay(100);
-
-    while (file.available()) {
-        if (check(EscPress)) sendStatus = ABORTED;
-
-        if (sendStatus == ABORTED || sendStatus == FAILED) {
-            message.done = true;
-            message.dataSize = 0;
-            esp_now_send(dstAddress, (uint8_t *)&message, sizeof(message));
-            displayError("Error sending file");
-            break;
-        }
-
-        size_t bytesRead = file.readBytes(message.data, ESP_DATA_SIZE);
-        message.dataSize = bytesRead;
-        message.bytesSent = min(message.bytesSent + bytesRead, message.totalBytes);
-        message.done = message.bytesSent == message.totalBytes;
-
-        response = esp_now_send(dstAddress, (uint8_t *)&message, sizeof(message));
-        if (response != ESP_OK) {
-            Serial.printf("Send file response: %s\n", esp_err_to_name(response));
-            sendStatus = FAILED;
+    EspTransferState state;
+    uint32_t lastDraw = 0;
+    while ((state = sender->poll()) == ESP_TRANSFER_WAITING || state == ESP_TRANSFER_RUNNING) {
+        if (check(EscPress)) sender->abort();
+        if (millis() - lastDraw > 100) {
+            progressHandler(sender->acked(), file.size(), "Sending...");
+            lastDraw = millis();
         }
-
-        progressHandler(file.position(), file.size(), "Sending...");
-        delay(100);
+        transferLink->idle();
     }
 
-    if (message.bytesSent == message.totalBytes) displaySuccess("File sent");
+    if (state == ESP_TRANSFER_SUCCEEDED) {
+        displaySuccess("File sent");
+    } else {
+        Serial.printf("Send file: %s\n", sender->error());
+        displayError("Error sending file");
+    }
 
+    delete sender;
     file.close();
     delay(1000);
 }
@@ -64,43 +107,62 @@ void FileSharing::receiveFile() {
     padprintln("Waiting...");
 
     recvFileName = "";
-    recvQueue = {};
     recvStatus = CONNECTING;
 
     if (!beginEspnow()) return;
 
-    delay(100);
-
-    while (1) {
-        if (check(EscPress)) recvStatus = ABORTED;
+    EspTransferReceiver *receiver = nullptr;
+    transferLink = new (std::nothrow) EspNowLink(broadcastAddress, false);
+    if (transferLink) receiver = new (std::nothrow) EspTransferReceiver(*transferLink);
+    if (!receiver) {
+        displayError("Not enough memory");
+        delay(1000);
+        return;
+    }
 
-        if (recvStatus == ABORTED || recvStatus == FAILED) {
-            displayError("Error receiving file");
-            break;
-        }
-        if (recvStatus == SUCCESS) {
-            displaySuccess("File received");
-            break;
+    FS *fs = nullptr;
+    File file;
+    FileTransferSink sink(file);
+    EspTransferState state;
+    uint32_t lastDraw = 0;
+    while ((state = receiver->poll()) != ESP_TRANSFER_SUCCEEDED && state != ESP_TRANSFER_FAILED) {
+        if (check(EscPress)) {
+            recvStatus = ABORTED;
+            receiver->abort();
         }
 
-        if (!recvQueue.empty()) {
-            Message recvFileMessage = recvQueue.front();
-            recvQueue.erase(recvQueue.begin());
-
-            progressHandler(recvFileMessage.bytesSent, recvFileMessage.totalBytes, "Receiving...");
-
-            if (!appendToFile(recvFileMessage)) {
-                recvStatus = FAILED;
-                Serial.println("Failed appending to file");
-            }
-            if (recvFileMessage.done) {
-                Serial.println("Recv done");
-                recvStatus = recvFileMessage.bytesSent == recvFileMessage.totalBytes ? SUCCESS : FAILED;
+        if (state == ESP_TRANSFER_OFFERED) {
+            // The file stays open for the whole transfer
+            const EspTransferOffer &offer = receiver->offer();
+            if (getFsStorage(fs)) {
+                createFilename(fs, offer.name, offer.path);
+                file = fs->open(recvFileName, FILE_WRITE);
             }
+            if (file) receiver->accept(sink);
+            else receiver->reject();
+        }
+
+        if (state == ESP_TRANSFER_RUNNING && millis() - lastDraw > 100) {
+            progressHandler(receiver->received(), receiver->offer().size, "Receiving...");
+            lastDraw = millis();
         }
+        transferLink->idle();
+    }
 
-        delay(100);
+    if (state == ESP_TRANSFER_SUCCEEDED) receiver->linger(500);
+    bool created = file;
+    if (created) file.close();
+    if (state == ESP_TRANSFER_SUCCEEDED) {
+        recvStatus = SUCCESS;
+        displaySuccess("File received");
+    } else {
+        // an incomplete or corrupt file is of no use
+        if (created) fs->remove(recvFileName);
+        if (recvStatus != ABORTED) recvStatus = FAILED;
+        Serial.printf("Receive file: %s\n", receiver->error());
+        displayError("Error receiving file");
     }
+    delete receiver;
 
     delay(1000);
 
@@ -133,25 +195,7 @@ File FileSharing::selectFile() {
     return file;
 }
 
-bool FileSharing::appendToFile(FileSharing::Message fileMessage) {
-    FS *fs;
-    if (!getFsStorage(fs)) return false;
-
-    if (recvFileName == "") createFilename(fs, fileMessage);
-
-    File file = (*fs).open(recvFileName, FILE_APPEND);
-    if (!file) return false;
-
-    file.write((const uint8_t *)fileMessage.data, fileMessage.dataSize);
-    file.close();
-
-    return true;
-}
-
-void FileSharing::createFilename(FS *fs, FileSharing::Message fileMessage) {
-    String messageFilename = String(fileMessage.filename);
-    String messageFilepath = String(fileMessage.filepath);
-
+void FileSharing::createFilename(FS *fs, String messageFilename, String messageFilepath) {
     String filename = messageFilename.substring(0, messageFilename.lastIndexOf("."));
     String ext = messageFilename.substring(messageFilename.lastIndexOf("."));
 
@@ -173,3 +217,14 @@ void FileSharing::createFilename(FS *fs, FileSharing::Message fileMessage) {
 
     recvFileName = messageFilepath + "/" + filename + ext;
 }
+
+void FileSharing::onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
+    // transfer packets are acknowledged by the protocol, not one log line each
+    if (transferLink) return;
+    EspConnection::onDataSent(mac_addr, status);
+}
+
+void FileSharing::onDataRecv(const uint8_t *mac, const uint8_t *incomingData, int len) {
+    if (!isEspTransferPacket(incomingData, len)) return EspConnection::onDataRecv(mac, incomingData, len);
+    if (transferLink) transferLink->ring.push(mac, incomingData, len);
+}
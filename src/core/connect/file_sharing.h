@@ -2,6 +2,7 @@
 #define __ESP_FILE_SHARING_H__
 
 #include "esp_connection.h"
+#include "esp_transfer.h"
 
 class FileSharing : public EspConnection {
 public:
@@ -9,6 +10,7 @@ public:
     // Constructor
     /////////////////////////////////////////////////////////////////////////////////////
     FileSharing();
+    ~FileSharing() override;
 
     /////////////////////////////////////////////////////////////////////////////////////
     // Operations
@@ -16,15 +18,21 @@ public:
     void sendFile();
     void receiveFile();
 
+protected:
+    void onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) override;
+    void onDataRecv(const uint8_t *mac, const uint8_t *incomingData, int len) override;
+
 private:
+    class EspNowLink;
+
     String recvFileName;
+    EspNowLink *transferLink = nullptr; // set for the transfer, packets reach it from the Wi-Fi task
 
     /////////////////////////////////////////////////////////////////////////////////////
     // Helpers
     /////////////////////////////////////////////////////////////////////////////////////
     File selectFile();
-    bool appendToFile(Message fileMessage);
-    void createFilename(FS *fs, Message fileMessage);
+    void createFilename(FS *fs, String messageFilename, String messageFilepath);
 };
 
 #endif
@@ -87,7 +87,7 @@ void EspSerialCmd::receiveCommands() {
 
         if (!recvQueue.empty()) {
             recvMessage = recvQueue.front();
-            recvQueue.erase(recvQueue.begin());
+            recvQueue.pop_front();
 
             recvCommand = recvMessage.data;
             Serial.println(recvCommand);
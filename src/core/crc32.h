@@ -0,0 +1,14 @@
+#ifndef __CRC32_H__
+#define __CRC32_H__
+
+// CRC-32 of IEEE 802.3 (zlib, PNG, Ethernet) for the file formats and transfer protocols of the
+// firmware: serial and ESP-NOW transfers, the config store and snapshot, GPS tracks.
+// No Arduino dependencies, so the code using it builds on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Continues crc over data; start from 0. crc32Update(crc32Update(0, a), b) is the CRC of a then b.
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif
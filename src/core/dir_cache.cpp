@@ -0,0 +1,214 @@
+#include "dir_cache.h"
+#include <algorithm>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DIR_WRITER_CHUNK 1024
+
+void DirListing::add(const char *name, bool dir, uint64_t size, uint32_t mtime) {
+    Entry e;
+    e.name = _names.size();
+    e.mtime = mtime;
+    e.size = dir ? 0 : size;
+    e.dir = dir;
+    _entries.push_back(e);
+    _names.insert(_names.end(), name, name + strlen(name) + 1);
+}
+
+void DirListing::sort() {
+    const char *names = _names.data();
+    std::sort(_entries.begin(), _entries.end(), [names](const Entry &a, const Entry &b) {
+        if (a.dir != b.dir) return a.dir > b.dir;
+        const unsigned char *pa = (const unsigned char *)names + a.name;
+        const unsigned char *pb = (const unsigned char *)names + b.name;
+        while (*pa && toupper(*pa) == toupper(*pb)) {
+            ++pa;
+            ++pb;
+        }
+        return toupper(*pa) < toupper(*pb);
+    });
+}
+
+DirListingWriter::DirListingWriter(DirListingPtr listing, const std::string &path, bool json)
+    : _listing(listing), _json(json) {
+    _pending.reserve(DIR_WRITER_CHUNK + 600);
+    if (!_json) {
+        _pending = "pa:" + path + ":0\n";
+        return;
+    }
+    _pending = "{\"path\":\"";
+    for (char c : path) {
+        if (c == '"' || c == '\\') _pending += '\\';
+        _pending += c;
+    }
+    _pending += "\",\"entries\":[";
+}
+
+static void appendJsonString(std::string &out, const char *s) {
+    out += '"';
+    for (; *s; ++s) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Same wording as humanReadableSize() in the web interface
+static void appendHumanSize(std::string &out, uint64_t bytes) {
+    char text[32];
+    if (bytes < 1024) snprintf(text, sizeof(text), "%llu B", (unsigned long long)bytes);
+    else if (bytes < 1024 * 1024) snprintf(text, sizeof(text), "%.2f kB", bytes / 1024.0);
+    else if (bytes < 1024 * 1024 * 1024) snprintf(text, sizeof(text), "%.2f MB", bytes / 1024.0 / 1024.0);
+    else snprintf(text, sizeof(text), "%.2f GB", bytes / 1024.0 / 1024.0 / 1024.0);
+    out += text;
+}
+
+void DirListingWriter::refill() {
+    const size_t count = _listing ? _listing->size() : 0;
+    while (_pending.size() < DIR_WRITER_CHUNK && _next < count) {
+        const DirListing::Entry &e = (*_listing)[_next];
+        const char *name = _listing->name(_next);
+        if (_json) {
+            if (_next) _pending += ',';
+            _pending += e.dir ? "[\"Fo\"," : "[\"Fi\",";
+            appendJsonString(_pending, name);
+            _pending += ',';
+            _pending += std::to_string(e.size);
+            _pending += ']';
+        } else {
+            _pending += e.dir ? "Fo:" : "Fi:";
+            _pending += name;
+            _pending += ':';
+            if (e.dir) _pending += '0';
+            else appendHumanSize(_pending, e.size);
+            _pending += '\n';
+        }
+        _next++;
+    }
+    if (_next == count && !_done) {
+        if (_json) _pending += "]}";
+        _done = true;
+    }
+}
+
+size_t DirListingWriter::read(uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (_sent == _pending.size()) {
+            _pending.clear();
+            _sent = 0;
+            refill();
+            if (_pending.empty()) break;
+        }
+        size_t n = std::min(maxLen - written, _pending.size() - _sent);
+        memcpy(buffer + written, _pending.data() + _sent, n);
+        _sent += n;
+        written += n;
+    }
+    return written;
+}
+
+std::string DirCache::key(const std::string &path) {
+    std::string k = "/";
+    for (char c : path) {
+        if (c == '/' && k.back() == '/') continue;
+        k += toupper((unsigned char)c); // FAT names ignore case
+    }
+    if (k.size() > 1 && k.back() == '/') k.pop_back();
+    return k;
+}
+
+void DirCache::setBudget(size_t entries) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _budget = entries;
+    while (_entries > _budget && !_slots.empty()) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < _slots.size(); ++i) {
+            if (_slots[i].lastUse < _slots[oldest].lastUse) oldest = i;
+        }
+        drop(oldest);
+    }
+}
+
+DirListingPtr DirCache::find(const std::string &path) {
+    std::string k = key(path);
+    std::lock_guard<std::mutex> guard(_lock);
+    for (Slot &s : _slots) {
+        if (s.key == k) {
+            s.lastUse = ++_clock;
+            _hits++;
+            return s.listing;
+        }
+    }
+    _misses++;
+    return nullptr;
+}
+
+uint32_t DirCache::generation() {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _generation;
+}
+
+DirListingPtr DirCache::store(const std::string &path, DirListing &&listing, uint32_t generation) {
+    listing.sort();
+    DirListingPtr shared = std::make_shared<const DirListing>(std::move(listing));
+    std::string k = key(path);
+
+    std::lock_guard<std::mutex> guard(_lock);
+    // a write landed while the card was being read, the listing may already be stale
+    if (generation != _generation || shared->size() > _budget) return shared;
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        if (_slots[i].key == k) {
+            drop(i);
+            break;
+        }
+    }
+    while (!_slots.empty() && (_slots.size() >= DIR_CACHE_MAX_DIRS || _entries + shared->size() > _budget)) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < _slots.size(); ++i) {
+            if (_slots[i].lastUse < _slots[oldest].lastUse) oldest = i;
+        }
+        drop(oldest);
+    }
+    _slots.push_back({k, shared, ++_clock});
+    _entries += shared->size();
+    return shared;
+}
+
+void DirCache::changed(const char *path) {
+    std::string k = key(path);
+    size_t slash = k.rfind('/');
+    std::string parent = slash ? k.substr(0, slash) : "/";
+
+    std::lock_guard<std::mutex> guard(_lock);
+    _generation++;
+    for (size_t i = _slots.size(); i-- > 0;) {
+        const std::string &s = _slots[i].key;
+        // the folder holding path, and path itself with everything below it if it was a folder
+        bool below =
+            k == "/" || (s.size() > k.size() && s.compare(0, k.size(), k) == 0 && s[k.size()] == '/');
+        if (s == parent || s == k || below) drop(i);
+    }
+}
+
+void DirCache::clear() {
+    std::lock_guard<std::mutex> guard(_lock);
+    _generation++;
+    _slots.clear();
+    _entries = 0;
+}
+
+void DirCache::drop(size_t i) {
+    _entries -= _slots[i].listing->size();
+    _slots.erase(_slots.begin() + i);
+}
@@ -0,0 +1,105 @@
+#ifndef __DIR_CACHE_H__
+#define __DIR_CACHE_H__
+
+// Folder listings of the SD card kept in RAM, so opening a big folder again costs no card access.
+// A listing holds name, size, mtime and the folder flag of every entry, sorted the way the file
+// browser shows them: folders first, then by name ignoring case.
+// The SD driver reports each path it creates, opens for writing, renames or removes, and the
+// listings that path belongs to are dropped; anything writing behind its back (USB mass storage,
+// a remount) clears the lot. Listings are handed out shared, so a reader keeps its copy even if
+// it is dropped meanwhile, and the cache is bounded by a total entry budget, least recent first.
+// No Arduino dependencies, so it can be benchmarked against a fake file system on the host.
+
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define DIR_CACHE_MAX_DIRS 16
+#define DIR_CACHE_PSRAM_BUDGET 32768 // entries, ~24 B each plus the name
+#define DIR_CACHE_HEAP_BUDGET 2048
+
+class DirListing {
+public:
+    struct Entry {
+        uint32_t name;  // offset in the name pool
+        uint32_t mtime; // FAT date << 16 | FAT time, 0 when unknown
+        uint64_t size;
+        bool dir;
+    };
+
+    void add(const char *name, bool dir, uint64_t size, uint32_t mtime);
+    void sort();
+
+    size_t size() const { return _entries.size(); }
+    const Entry &operator[](size_t i) const { return _entries[i]; }
+    const char *name(size_t i) const { return _names.data() + _entries[i].name; }
+
+private:
+    std::vector<Entry> _entries;
+    std::vector<char> _names; // NUL terminated, back to back
+};
+
+typedef std::shared_ptr<const DirListing> DirListingPtr;
+
+// Streams a listing as JSON: {"path":"/x","entries":[["Fo","name",0],["Fi","name",size],...]}
+// or in the line format of /listfiles: "pa:/x:0", then "Fo:name:0" / "Fi:name:12.00 kB" per entry.
+// Entries are cut at whatever buffer size the caller asks for.
+class DirListingWriter {
+public:
+    DirListingWriter(DirListingPtr listing, const std::string &path, bool json);
+    // Fills up to maxLen bytes, 0 once everything was written
+    size_t read(uint8_t *buffer, size_t maxLen);
+
+private:
+    void refill();
+
+    DirListingPtr _listing;
+    std::string _pending;
+    size_t _sent = 0; // bytes of _pending already handed out
+    size_t _next = 0; // entry
+    bool _done = false;
+    bool _json;
+};
+
+class DirCache {
+public:
+    void setBudget(size_t entries);
+
+    // Listing of path, nullptr when it is not cached
+    DirListingPtr find(const std::string &path);
+    // Sorts a listing read from the card and keeps it unless the card changed since generation
+    // was taken (before reading it), or it is bigger than the whole budget
+    DirListingPtr store(const std::string &path, DirListing &&listing, uint32_t generation);
+    uint32_t generation();
+
+    // Something at path was created, written, renamed or removed
+    void changed(const char *path);
+    void clear();
+
+    uint32_t hits() const { return _hits; }
+    uint32_t misses() const { return _misses; }
+
+private:
+    struct Slot {
+        std::string key;
+        DirListingPtr listing;
+        uint32_t lastUse;
+    };
+
+    static std::string key(const std::string &path);
+    void drop(size_t i);
+
+    std::mutex _lock;
+    std::vector<Slot> _slots;
+    size_t _budget = DIR_CACHE_HEAP_BUDGET;
+    size_t _entries = 0;
+    uint32_t _clock = 0;
+    uint32_t _generation = 0;
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+};
+
+#endif
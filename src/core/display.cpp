@@ -1,4 +1,7 @@
 #include "display.h"
+#include "core/image_atlas.h"
+#include "core/input_events.h"
+#include "core/menu_rows.h"
 #include "core/wifi/webInterface.h" // for server
 #include "core/wifi/wg.h"           //for isConnectedWireguard to print wireguard lock
 #include "mykeyboard.h"
@@ -270,7 +273,7 @@ void displayError(String txt, bool waitKeyPress) {
     return;
 #endif
     delay(200);
-    while (waitKeyPress && !check(AnyKeyPress)) vTaskDelay(10 / portTICK_PERIOD_MS);
+    while (waitKeyPress && !check(AnyKeyPress)) inputIdle(100);
 }
 
 void displayWarning(String txt, bool waitKeyPress) {
@@ -280,7 +283,7 @@ void displayWarning(String txt, bool waitKeyPress) {
     return;
 #endif
     delay(200);
-    while (waitKeyPress && !check(AnyKeyPress)) vTaskDelay(10 / portTICK_PERIOD_MS);
+    while (waitKeyPress && !check(AnyKeyPress)) inputIdle(100);
 }
 
 void displayInfo(String txt, bool waitKeyPress) {
@@ -292,7 +295,7 @@ void displayInfo(String txt, bool waitKeyPress) {
 #endif
 
     delay(200);
-    while (waitKeyPress && !check(AnyKeyPress)) vTaskDelay(10 / portTICK_PERIOD_MS);
+    while (waitKeyPress && !check(AnyKeyPress)) inputIdle(100);
 }
 
 void displaySuccess(String txt, bool waitKeyPress) {
@@ -303,7 +306,7 @@ void displaySuccess(String txt, bool waitKeyPress) {
     return;
 #endif
     delay(200);
-    while (waitKeyPress && !check(AnyKeyPress)) vTaskDelay(10 / portTICK_PERIOD_MS);
+    while (waitKeyPress && !check(AnyKeyPress)) inputIdle(100);
 }
 
 void displayTextLine(String txt, bool waitKeyPress) {
@@ -314,7 +317,7 @@ void displayTextLine(String txt, bool waitKeyPress) {
     return;
 #endif
     delay(200);
-    while (waitKeyPress && !check(AnyKeyPress)) vTaskDelay(10 / portTICK_PERIOD_MS);
+    while (waitKeyPress && !check(AnyKeyPress)) inputIdle(100);
 }
 
 void setPadCursor(int16_t padx, int16_t pady) {
@@ -461,6 +464,11 @@ void padprintln(double n, int digits, int16_t padx) {
     tft.println(n, digits);
 }
 
+static MenuRows menuRows; // what drawOptions has on screen
+
+// Anything drawn over the list (popups, the long-press arc) makes the retained rows stale
+static void invalidateMenuRows() { menuRows.invalidate(); }
+
 /*********************************************************************
 **  Function: loopOptions
 **  Where you choose among the options in menu
@@ -495,6 +503,7 @@ int loopOptions(
             if (devModeCounter >= 5 && !bruceConfig.devMode) {
                 bruceConfig.setDevMode(true);
                 displayInfo("Dev Mode Enabled", true);
+                invalidateMenuRows();
             }
             if (millis() - _clock_bat_timer > 30000) {
                 _clock_bat_timer = millis();
@@ -513,7 +522,8 @@ int loopOptions(
             if (options[index].hover)
                 renderedByLambda = options[index].hover(options[index].hoverPointer, true);
 
-            if (!renderedByLambda) {
+            if (renderedByLambda) invalidateMenuRows();
+            else {
                 if (menuType == MENU_TYPE_SUBMENU) drawSubmenu(index, options, subText);
                 else
                     coord = drawOptions(
@@ -560,7 +570,8 @@ int loopOptions(
 #ifndef HAS_ENCODER // T-Embed doesn't need it
             LongPress = true;
             while (PrevPress && menuType != MENU_TYPE_MAIN) {
-                if (millis() - _tmp > 200)
+                if (millis() - _tmp > 200) {
+                    invalidateMenuRows(); // the arc is drawn over the list
                     tft.drawArc(
                         tftWidth / 2,
                         tftHeight / 2,
@@ -571,6 +582,7 @@ int loopOptions(
                         getColorVariation(bruceConfig.priColor),
                         bruceConfig.bgColor
                     );
+                }
                 vTaskDelay(10 / portTICK_RATE_MS);
             }
             tft.drawArc(
@@ -598,7 +610,8 @@ int loopOptions(
             }
             redraw = true;
         }
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        // woken by the keys; the scrolling label of a regular menu moves every 10ms
+        inputIdle(menuType == MENU_TYPE_REGULAR ? 10 : 50);
 
         /* Select and run function
         forceMenuOption is set by a SerialCommand to force a selection within the menu
@@ -639,6 +652,8 @@ void progressHandler(int progress, size_t total, String message) {
 /***************************************************************************************
 ** Function name: drawOptions
 ** Description:   Função para desenhar e mostrar as opçoes de contexto
+**                Visible rows are retained: a redraw only repaints rows whose label,
+**                cursor or selected state changed, so a cursor move costs two rows
 ***************************************************************************************/
 Opt_Coord drawOptions(
     int index, std::vector<Option> &options, uint16_t fgcolor, uint16_t selcolor, uint16_t bgcolor,
@@ -666,39 +681,38 @@ Opt_Coord drawOptions(
             fgcolor
         );
     }
+    menuRows.begin(menuSize, optionsTopY, fgcolor, selcolor, bgcolor, firstRender);
 
-    tft.setTextColor(fgcolor, bgcolor);
     tft.setTextSize(FM);
-    tft.setCursor(tftWidth * 0.10 + 5, tftHeight / 2 - menuSize * (FM * 8 + 4) / 2);
+    const int rowX = tftWidth * 0.10 + 5;
+    const int rowChars = (tftWidth * 0.8 - 10) / (LW * FM) - 1;
 
-    int i = 0;
     int init = 0;
-    int cont = 1;
-    menuSize = options.size();
     if (index >= MAX_MENU_SIZE) init = index - MAX_MENU_SIZE + 1;
-    for (i = 0; i < menuSize; i++) {
-        if (i >= init) {
-            if (options[i].selected) tft.setTextColor(selcolor, bgcolor); // if selected, change Text color
-            else tft.setTextColor(fgcolor, bgcolor);
-
-            String text = "";
-            if (i == index) {
-                text += ">";
-                coord.x = tftWidth * 0.10 + 5 + FM * LW;
-                coord.y = tft.getCursorY() + 4;
-                coord.size = (tftWidth * 0.8 - 10) / (LW * FM) - 1;
-                coord.fgcolor = fgcolor;
-                coord.bgcolor = bgcolor;
-            } else text += " ";
-            text += String(options[i].label) + "              ";
-            tft.setCursor(tftWidth * 0.10 + 5, tft.getCursorY() + 4);
-            tft.println(text.substring(0, (tftWidth * 0.8 - 10) / (LW * FM) - 1));
-            cont++;
+    for (int row = 0; row < menuSize && init + row < (int)options.size(); row++) {
+        const Option &opt = options[init + row];
+        const bool cursor = init + row == index;
+        const int rowY = optionsTopY + 5 + row * (FM * 8 + 4) + 4;
+
+        if (cursor) {
+            coord.x = rowX + FM * LW;
+            coord.y = rowY;
+            coord.size = rowChars;
+            coord.fgcolor = fgcolor;
+            coord.bgcolor = bgcolor;
         }
-        if (cont > MAX_MENU_SIZE) goto Exit;
+
+        if (!menuRows.update(row, opt.label.c_str(), cursor, opt.selected)) continue;
+
+        if (opt.selected) tft.setTextColor(selcolor, bgcolor); // if selected, change Text color
+        else tft.setTextColor(fgcolor, bgcolor);
+
+        String text = cursor ? ">" : " ";
+        text += opt.label + "              ";
+        tft.setCursor(rowX, rowY);
+        tft.print(text.substring(0, rowChars));
     }
-Exit:
-    if (options.size() > MAX_MENU_SIZE) menuSize = MAX_MENU_SIZE;
+    tft.setTextColor(fgcolor, bgcolor);
 #if defined(HAS_TOUCH)
     TouchFooter();
 #endif
@@ -1523,6 +1537,80 @@ uint16_t getColorVariation(uint16_t color, int delta, int direction) {
     return compl_color;
 }
 
+// Decoded images kept in RAM (see image_atlas.h), so redrawing a theme icon is one pushImage
+static ImageAtlas *imgAtlas = nullptr;
+
+struct ImageStamp {
+    String key; // filesystem + path
+    uint32_t generation = IMAGE_ATLAS_UNTRACKED;
+    bool stamped = false; // size and mtime read from the file
+    uint32_t size = 0;
+    uint32_t mtime = 0;
+};
+
+static ImageAtlas *imageAtlas() {
+    if (!imgAtlas) {
+        imgAtlas =
+            new (std::nothrow) ImageAtlas(psramFound() ? IMAGE_ATLAS_PSRAM_BUDGET : IMAGE_ATLAS_HEAP_BUDGET);
+    }
+    return imgAtlas;
+}
+
+// Before the file is opened: the SD driver reports every write to sdDirCache, so an image checked
+// at its generation is still current. LittleFS has no such hook, its images are checked every draw.
+static void imageKey(FS &fs, const String &filename, ImageStamp &stamp) {
+    stamp.key = (&fs == &SD ? "sd:" : "fs:") + filename;
+    stamp.generation = &fs == &SD ? sdDirCache.generation() : IMAGE_ATLAS_UNTRACKED;
+}
+
+static void imageStamp(File &file, ImageStamp &stamp) {
+    stamp.size = file.size();
+    stamp.mtime = (uint32_t)file.getLastWrite();
+    stamp.stamped = true;
+}
+
+static bool imageStamp(FS &fs, const String &filename, ImageStamp &stamp) {
+    File file = fs.open(filename, FILE_READ);
+    if (!file) return false;
+    imageStamp(file, stamp);
+    file.close();
+    return true;
+}
+
+// Atlas bitmaps hold the bytes in the order pushImage() sends them without swapping
+static void pushAtlasImage(int x, int y, uint16_t w, uint16_t h, const uint16_t *pixels) {
+    bool oldSwapBytes = tft.getSwapBytes();
+    tft.setSwapBytes(false);
+    tft.drawPixel(0, 0, 0); // shared TFT_Spi devices struggle to work, need call a line first sometimes
+    tft.pushImage(x, y, w, h, (uint16_t *)pixels);
+    tft.setSwapBytes(oldSwapBytes);
+}
+
+static bool drawFromAtlas(const ImageStamp &stamp, int x, int y, bool center) {
+    ImageAtlas *atlas = imageAtlas();
+    if (!atlas) return false;
+    const ImageAtlasEntry *e = stamp.stamped
+                                   ? atlas->find(stamp.key.c_str(), stamp.size, stamp.mtime, stamp.generation)
+                                   : atlas->find(stamp.key.c_str(), stamp.generation);
+    if (!e) return false;
+    if (center) {
+        x = x + (tftWidth - e->width) / 2;
+        y = y + (tftHeight - e->height) / 2;
+    }
+    pushAtlasImage(x, y, e->width, e->height, e->pixels);
+    return true;
+}
+
+static uint16_t *reserveAtlasImage(const ImageStamp &stamp, uint16_t w, uint16_t h) {
+    ImageAtlas *atlas = imageAtlas();
+    return atlas ? atlas->reserve(stamp.key.c_str(), stamp.size, stamp.mtime, stamp.generation, w, h)
+                 : nullptr;
+}
+
+static void commitAtlasImage(uint16_t *pixels, bool ok) {
+    if (imgAtlas) imgAtlas->commit(pixels, ok);
+}
+
 // Draw BITMAP files
 // These read 16- and 32-bit types from the SD card file.
 // BMP data is stored little-endian, Arduino is little-endian too.
@@ -1548,6 +1636,10 @@ bool drawBmp(FS &fs, String filename, int x, int y, bool center) {
     uint32_t startTime = millis();
 
     File bmpFS;
+    ImageStamp stamp;
+
+    imageKey(fs, filename, stamp);
+    if (drawFromAtlas(stamp, x, y, center)) return true;
 
     // Open requested file on SD card
     bmpFS = fs.open(filename, "r");
@@ -1557,9 +1649,16 @@ bool drawBmp(FS &fs, String filename, int x, int y, bool center) {
         goto ERROR;
     }
 
+    imageStamp(bmpFS, stamp);
+    if (drawFromAtlas(stamp, x, y, center)) {
+        bmpFS.close();
+        return true;
+    }
+
     uint32_t seekOffset;
     uint16_t w, h, row, col;
     uint8_t r, g, b;
+    uint16_t *cached;
 
     if (read16(bmpFS) == 0x4D42) {
         read32(bmpFS);
@@ -1582,6 +1681,7 @@ bool drawBmp(FS &fs, String filename, int x, int y, bool center) {
 
             uint16_t padding = (4 - ((w * 3) & 3)) & 3;
             uint8_t lineBuffer[w * 3 + padding];
+            cached = reserveAtlasImage(stamp, w, h);
 
             for (row = 0; row < h; row++) {
 
@@ -1595,6 +1695,12 @@ bool drawBmp(FS &fs, String filename, int x, int y, bool center) {
                     r = *bptr++;
                     *tptr++ = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
                 }
+                if (cached) {
+                    // Stored unswapped, bottom-up rows land in place
+                    uint16_t *dst = cached + (h - 1 - row) * w;
+                    tptr = (uint16_t *)lineBuffer;
+                    for (uint16_t col = 0; col < w; col++) dst[col] = (tptr[col] << 8) | (tptr[col] >> 8);
+                }
 
                 // Push the pixel row to screen, pushImage will crop the line if needed
                 // y is decremented as the BMP image is drawn bottom up
@@ -1604,6 +1710,7 @@ bool drawBmp(FS &fs, String filename, int x, int y, bool center) {
                 tft.pushImage(x, y--, w, 1, (uint16_t *)lineBuffer);
             }
             tft.setSwapBytes(oldSwapBytes);
+            commitAtlasImage(cached, true);
             Serial.print("BMP Loaded in ");
             Serial.print(millis() - startTime);
             Serial.println(" ms");
@@ -1652,6 +1759,8 @@ bool drawImg(FS &fs, String filename, int x, int y, bool center, int playDuratio
 PNG *png = nullptr;
 // Optional pointer to write decoded lines into a cached BIN file
 static File *pngBinOut = nullptr;
+// Optional atlas bitmap the decoded lines are copied into
+static uint16_t *pngAtlasOut = nullptr;
 static bool pngCacheOnly = false;
 // Optionally use heap capabilities on ESP32 to pick the best memory region for the decoder
 #if defined(ESP32)
@@ -1694,6 +1803,9 @@ int PNGDraw(PNGDRAW *pDraw) {
         tft.pushImage(xpos, ypos + pDraw->y, pDraw->iWidth, 1, usPixels);
     }
     if (pngBinOut) { pngBinOut->write((uint8_t *)usPixels, pDraw->iWidth * sizeof(uint16_t)); }
+    if (pngAtlasOut) {
+        memcpy(pngAtlasOut + pDraw->y * pDraw->iWidth, usPixels, pDraw->iWidth * sizeof(uint16_t));
+    }
     return 1;
 }
 
@@ -1720,7 +1832,11 @@ static bool ensureTmpDir(FS &fs, const String &binPath) {
 }
 
 // Render a previously cached BIN (RGB565 LE with 2-byte width/height header)
-static bool drawPngBin(FS &fs, const String &binPath, int x, int y, bool center) {
+// With a stamp the bitmap is also loaded into the atlas and pushed in one go; draw = false only
+// loads it
+static bool drawPngBin(
+    FS &fs, const String &binPath, int x, int y, bool center, const ImageStamp *stamp, bool draw = true
+) {
     File f = fs.open(binPath, FILE_READ);
     if (!f) return false;
 
@@ -1736,11 +1852,25 @@ static bool drawPngBin(FS &fs, const String &binPath, int x, int y, bool center)
         y = y + (tftHeight - h) / 2;
     }
 
-    if (x >= tft.width() || y >= tft.height()) {
+    if (draw && (x >= tft.width() || y >= tft.height())) {
         f.close();
         return false;
     }
 
+    uint16_t *cached = stamp ? reserveAtlasImage(*stamp, w, h) : nullptr;
+    if (cached) {
+        size_t bytes = (size_t)w * h * sizeof(uint16_t);
+        bool ok = f.read((uint8_t *)cached, bytes) == bytes;
+        f.close();
+        if (ok && draw) pushAtlasImage(x, y, w, h, cached);
+        commitAtlasImage(cached, ok);
+        return ok;
+    }
+    if (!draw) {
+        f.close();
+        return true;
+    }
+
     std::unique_ptr<uint16_t[]> line(new (std::nothrow) uint16_t[w]);
     if (!line) {
         f.close();
@@ -1765,10 +1895,20 @@ bool drawPNG(FS &fs, String filename, int x, int y, bool center) {
     _fs = &fs;
     uint32_t dt = millis();
 
+    ImageStamp stamp;
+    imageKey(fs, filename, stamp);
+    if (!pngCacheOnly && drawFromAtlas(stamp, x, y, center)) return true;
+    bool stamped = imageStamp(fs, filename, stamp);
+    if (stamped && !pngCacheOnly && drawFromAtlas(stamp, x, y, center)) return true;
+
     String binPath = buildPngBinPath(filename);
     if (fs.exists(binPath)) {
-        if (pngCacheOnly) return true; // cache already ready
-        if (drawPngBin(fs, binPath, x, y, center)) return true;
+        // Cache already ready: when preparing, warm the atlas from it as well
+        if (pngCacheOnly) {
+            if (stamped) drawPngBin(fs, binPath, 0, 0, false, &stamp, false);
+            return true;
+        }
+        if (drawPngBin(fs, binPath, x, y, center, stamped ? &stamp : nullptr)) return true;
         fs.remove(binPath); // stale cache, fall back to decode
     }
 
@@ -1820,8 +1960,11 @@ bool drawPNG(FS &fs, String filename, int x, int y, bool center) {
         if (png->getWidth() > MAX_IMAGE_WIDTH) {
             Serial.println("Image too wide for allocated line buffer size!");
         } else {
+            if (stamped) pngAtlasOut = reserveAtlasImage(stamp, png->getWidth(), png->getHeight());
             rc = png->decode(NULL, 0);
             png->close();
+            commitAtlasImage(pngAtlasOut, rc == PNG_SUCCESS);
+            pngAtlasOut = nullptr;
         }
 
         if (pngBinOut) {
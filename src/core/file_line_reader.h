@@ -0,0 +1,19 @@
+#ifndef __FILE_LINE_READER_H__
+#define __FILE_LINE_READER_H__
+
+#include "line_reader.h"
+#include <FS.h>
+
+// LineReader over an open fs::File, read in blocks of the buffer size
+class FileLineReader : public LineReader {
+public:
+    FileLineReader(File &file, char *buffer, size_t size) : LineReader(readFile, &file, buffer, size) {}
+
+private:
+    static size_t readFile(void *ctx, uint8_t *buffer, size_t len) {
+        size_t got = static_cast<File *>(ctx)->read(buffer, len);
+        return got <= len ? got : 0; // (size_t)-1 on a closed file
+    }
+};
+
+#endif
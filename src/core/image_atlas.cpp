@@ -0,0 +1,146 @@
+#include "image_atlas.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(ESP_PLATFORM)
+#include "esp_heap_caps.h"
+#endif
+
+static uint16_t *allocPixels(size_t bytes) {
+#if defined(ESP_PLATFORM)
+    uint16_t *buf = (uint16_t *)heap_caps_malloc(bytes, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (!buf) buf = (uint16_t *)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    return buf;
+#else
+    return (uint16_t *)malloc(bytes);
+#endif
+}
+
+static void freePixels(uint16_t *buf) {
+#if defined(ESP_PLATFORM)
+    heap_caps_free(buf);
+#else
+    free(buf);
+#endif
+}
+
+ImageAtlasEntry *ImageAtlas::lookup(const char *path) {
+    for (ImageAtlasEntry &e : _entries) {
+        if (e.path[0] && strcmp(e.path, path) == 0) return &e;
+    }
+    return nullptr;
+}
+
+const ImageAtlasEntry *ImageAtlas::find(const char *path, uint32_t generation) {
+    if (generation == IMAGE_ATLAS_UNTRACKED) return nullptr;
+    ImageAtlasEntry *e = lookup(path);
+    if (!e || !e->ready || e->checkedAt != generation) return nullptr;
+    _hits++;
+    e->lastUse = ++_clock;
+    return e;
+}
+
+const ImageAtlasEntry *
+ImageAtlas::find(const char *path, uint32_t sourceSize, uint32_t sourceMtime, uint32_t generation) {
+    ImageAtlasEntry *e = lookup(path);
+    if (e && e->ready && (e->sourceSize != sourceSize || e->sourceMtime != sourceMtime)) {
+        release(*e);
+        e = nullptr;
+    }
+    if (!e || !e->ready) {
+        _misses++;
+        return nullptr;
+    }
+    _hits++;
+    _checks++;
+    e->checkedAt = generation;
+    e->lastUse = ++_clock;
+    return e;
+}
+
+uint16_t *ImageAtlas::reserve(
+    const char *path, uint32_t sourceSize, uint32_t sourceMtime, uint32_t generation, uint16_t w, uint16_t h
+) {
+    const size_t bytes = (size_t)w * h * sizeof(uint16_t);
+    if (!bytes || bytes > _budget || strlen(path) >= IMAGE_ATLAS_PATH_LEN) return nullptr;
+
+    if (ImageAtlasEntry *old = lookup(path)) release(*old);
+    while (_used + bytes > _budget) {
+        if (!evictOne()) return nullptr;
+    }
+
+    ImageAtlasEntry *slot = nullptr;
+    for (ImageAtlasEntry &e : _entries) {
+        if (!e.path[0]) {
+            slot = &e;
+            break;
+        }
+    }
+    if (!slot) {
+        if (!evictOne()) return nullptr;
+        return reserve(path, sourceSize, sourceMtime, generation, w, h);
+    }
+
+    uint16_t *pixels = allocPixels(bytes);
+    // Heap may be fragmented even though the budget allows it: give older images back and retry
+    while (!pixels && evictOne()) pixels = allocPixels(bytes);
+    if (!pixels) return nullptr;
+
+    strcpy(slot->path, path);
+    slot->sourceSize = sourceSize;
+    slot->sourceMtime = sourceMtime;
+    slot->checkedAt = generation;
+    slot->width = w;
+    slot->height = h;
+    slot->pixels = pixels;
+    slot->lastUse = ++_clock;
+    slot->ready = false;
+    _used += bytes;
+    return pixels;
+}
+
+void ImageAtlas::commit(const uint16_t *pixels, bool ok) {
+    if (!pixels) return;
+    for (ImageAtlasEntry &e : _entries) {
+        if (e.path[0] && e.pixels == pixels) {
+            if (ok) e.ready = true;
+            else release(e);
+            return;
+        }
+    }
+}
+
+void ImageAtlas::erase(const char *path) {
+    if (ImageAtlasEntry *e = lookup(path)) release(*e);
+}
+
+void ImageAtlas::clear() {
+    for (ImageAtlasEntry &e : _entries) {
+        if (e.path[0]) release(e);
+    }
+}
+
+size_t ImageAtlas::count() const {
+    size_t n = 0;
+    for (const ImageAtlasEntry &e : _entries) n += e.path[0] != 0;
+    return n;
+}
+
+void ImageAtlas::release(ImageAtlasEntry &e) {
+    if (e.pixels) {
+        freePixels(e.pixels);
+        _used -= (size_t)e.width * e.height * sizeof(uint16_t);
+    }
+    memset(&e, 0, sizeof(e));
+}
+
+bool ImageAtlas::evictOne() {
+    // Least recently drawn complete image; one still being decoded is never taken away
+    ImageAtlasEntry *victim = nullptr;
+    for (ImageAtlasEntry &e : _entries) {
+        if (e.path[0] && e.ready && (!victim || e.lastUse < victim->lastUse)) victim = &e;
+    }
+    if (!victim) return false;
+    release(*victim);
+    _evictions++;
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef __IMAGE_ATLAS_H__
+#define __IMAGE_ATLAS_H__
+
+// Decoded RGB565 images kept in RAM for the theme menu icons.
+// Entries are keyed by path plus the source file's size and mtime, so an edited image is
+// decoded again. Each entry also remembers the generation of the file system (a counter the
+// caller bumps on every write) at which that stamp was last checked: while the generation is
+// the same, an image is found by path alone without opening the file. The atlas is bounded by
+// a byte budget and evicts the least recently drawn image first. Pixel buffers go to PSRAM
+// when there is one.
+// No Arduino dependencies, so the eviction policy can be exercised on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IMAGE_ATLAS_MAX_ENTRIES 24
+#define IMAGE_ATLAS_PATH_LEN 96
+#define IMAGE_ATLAS_PSRAM_BUDGET (1536 * 1024)
+#define IMAGE_ATLAS_HEAP_BUDGET (32 * 1024) // small icons only, keep internal RAM for Wi-Fi
+#define IMAGE_ATLAS_UNTRACKED 0xFFFFFFFFu     // generation of a file system whose writes are not seen
+
+struct ImageAtlasEntry {
+    char path[IMAGE_ATLAS_PATH_LEN]; // empty = free slot
+    uint32_t sourceSize;
+    uint32_t sourceMtime;
+    uint16_t width;
+    uint16_t height;
+    uint16_t *pixels; // width * height, in the order pushImage() takes them
+    uint32_t checkedAt; // generation at which size and mtime matched the file
+    uint32_t lastUse;
+    bool ready; // false while the image is still being decoded into pixels
+};
+
+class ImageAtlas {
+public:
+    explicit ImageAtlas(size_t budgetBytes) : _budget(budgetBytes) {}
+    ~ImageAtlas() { clear(); }
+    ImageAtlas(const ImageAtlas &) = delete;
+    ImageAtlas &operator=(const ImageAtlas &) = delete;
+
+    // Complete image for path if its stamp was checked at this generation, else nullptr and the
+    // caller reads the stamp. Taken before the file is looked at, so a write meanwhile is noticed.
+    const ImageAtlasEntry *find(const char *path, uint32_t generation);
+    // Complete image for the key, or nullptr. A stale entry for the path is dropped, a current one
+    // is marked checked at generation.
+    const ImageAtlasEntry *
+    find(const char *path, uint32_t sourceSize, uint32_t sourceMtime, uint32_t generation);
+    // Reserves a w x h bitmap for the caller to decode into, evicting older images to fit.
+    // nullptr if the image is larger than the whole budget or memory is short.
+    uint16_t *reserve(
+        const char *path, uint32_t sourceSize, uint32_t sourceMtime, uint32_t generation, uint16_t w,
+        uint16_t h
+    );
+    // Marks the reserved image complete, or drops it if decoding failed
+    void commit(const uint16_t *pixels, bool ok);
+    void erase(const char *path);
+    void clear();
+
+    size_t budget() const { return _budget; }
+    size_t used() const { return _used; }
+    size_t count() const;
+    uint32_t hits() const { return _hits; }
+    uint32_t checks() const { return _checks; } // hits that needed the file's stamp
+    uint32_t misses() const { return _misses; }
+    uint32_t evictions() const { return _evictions; }
+
+private:
+    ImageAtlasEntry *lookup(const char *path);
+    void release(ImageAtlasEntry &e);
+    bool evictOne();
+
+    ImageAtlasEntry _entries[IMAGE_ATLAS_MAX_ENTRIES] = {};
+    size_t _budget;
+    size_t _used = 0;
+    uint32_t _clock = 0;
+    uint32_t _hits = 0;
+    uint32_t _checks = 0;
+    uint32_t _misses = 0;
+    uint32_t _evictions = 0;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "input_debounce.h"
+
+// now is at or past t, across the wrap of millis()
+static bool reached(uint32_t now, uint32_t t) { return (int32_t)(now - t) >= 0; }
+
+// Within debounceMs of its last change. Compared that way, and not with reached(), a key left alone
+// for longer than half the range of millis() does not look like it changed in the future
+bool InputDebouncer::bouncing(uint8_t key, uint32_t now) const {
+    uint32_t left = _stableAt[key] - now;
+    return (_changed & INPUT_KEY_BIT(key)) && left != 0 && left <= _config.debounceMs;
+}
+
+size_t InputDebouncer::update(uint16_t pressed, uint32_t now, InputEvent *out) {
+    size_t count = 0;
+    _raw = pressed;
+    for (uint8_t key = 0; key < INPUT_KEY_COUNT; key++) {
+        uint16_t bit = INPUT_KEY_BIT(key);
+        bool raw = pressed & bit;
+        bool held = _held & bit;
+
+        if (raw != held) {
+            if (bouncing(key, now)) continue;
+            _held ^= bit;
+            _changed |= bit;
+            _stableAt[key] = now + _config.debounceMs;
+            _repeatAt[key] = now + _config.repeatDelayMs;
+            out[count++] = {now, (InputKey)key, raw ? INPUT_PRESS : INPUT_RELEASE};
+        } else if (held && reached(now, _repeatAt[key])) {
+            _repeatAt[key] += _config.repeatMs;
+            // polled late, don't make up for the repeats missed
+            if (reached(now, _repeatAt[key])) _repeatAt[key] = now + _config.repeatMs;
+            out[count++] = {now, (InputKey)key, INPUT_REPEAT};
+        }
+    }
+    return count;
+}
+
+uint32_t InputDebouncer::nextDeadline(uint32_t now) const {
+    uint32_t next = INPUT_NO_DEADLINE;
+    for (uint8_t key = 0; key < INPUT_KEY_COUNT; key++) {
+        uint16_t bit = INPUT_KEY_BIT(key);
+        uint32_t at;
+        if ((_raw & bit) != (_held & bit)) at = bouncing(key, now) ? _stableAt[key] : now;
+        else if (_held & bit) at = _repeatAt[key];
+        else continue;
+        uint32_t wait = reached(now, at) ? 0 : at - now;
+        if (wait < next) next = wait;
+    }
+    return next;
+}
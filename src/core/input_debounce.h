@@ -0,0 +1,70 @@
+#ifndef __INPUT_DEBOUNCE_H__
+#define __INPUT_DEBOUNCE_H__
+
+// Debounce and auto-repeat of the navigation keys, in one place for the boards that report the raw
+// state of their buttons (inputUseKeyReader in input_events.h).
+// A change of a key is taken at once when the key has been stable for debounceMs, so a press costs no
+// latency; the bounces after it are ignored until then, and the state at the end of that window is
+// taken too, so a tap shorter than the window still gives a press and a release. A key held for
+// repeatDelayMs repeats every repeatMs.
+// No Arduino dependencies, so recorded input traces can be replayed on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One per Press flag of globals.h
+enum InputKey : uint8_t {
+    INPUT_KEY_PREV,
+    INPUT_KEY_NEXT,
+    INPUT_KEY_UP,
+    INPUT_KEY_DOWN,
+    INPUT_KEY_SEL,
+    INPUT_KEY_ESC,
+    INPUT_KEY_NEXT_PAGE,
+    INPUT_KEY_PREV_PAGE,
+    INPUT_KEY_COUNT,
+};
+
+#define INPUT_KEY_BIT(key) ((uint16_t)(1u << (key)))
+
+enum InputEventType : uint8_t { INPUT_PRESS, INPUT_RELEASE, INPUT_REPEAT };
+
+struct InputEvent {
+    uint32_t time; // millis() when it was taken
+    InputKey key;
+    InputEventType type;
+};
+
+struct InputDebounceConfig {
+    uint32_t debounceMs = 20;
+    uint32_t repeatDelayMs = 200;
+    uint32_t repeatMs = 200;
+};
+
+class InputDebouncer {
+public:
+    InputDebouncer(const InputDebounceConfig &config = {}) : _config(config) {}
+
+    // Raw state of the keys at now, a bit per InputKey. Writes the events it causes to out, which has
+    // room for INPUT_KEY_COUNT, and returns how many
+    size_t update(uint16_t pressed, uint32_t now, InputEvent *out);
+    // Milliseconds until update() has an event to give with the same raw state: the end of a bounce
+    // window or a repeat. INPUT_NO_DEADLINE when there is none
+    uint32_t nextDeadline(uint32_t now) const;
+    // Keys down, debounced
+    uint16_t held() const { return _held; }
+
+private:
+    bool bouncing(uint8_t key, uint32_t now) const;
+
+    InputDebounceConfig _config;
+    uint16_t _raw = 0;
+    uint16_t _held = 0;
+    uint16_t _changed = 0; // keys with a _stableAt
+    uint32_t _stableAt[INPUT_KEY_COUNT] = {}; // end of the bounce window of each key
+    uint32_t _repeatAt[INPUT_KEY_COUNT] = {};
+};
+
+#define INPUT_NO_DEADLINE 0xFFFFFFFFu
+
+#endif
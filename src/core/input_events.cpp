@@ -0,0 +1,147 @@
+#include "input_events.h"
+#include "core/display.h" // wakeUpScreen
+#include <globals.h>
+
+static InputDebouncer inputDebouncer;
+static InputKeyReader inputKeyReader = NULL;
+static uint32_t inputPollMs = INPUT_POLL_MS;
+static QueueHandle_t inputQueue = NULL;
+static SemaphoreHandle_t inputSignal = NULL; // given on every event, for inputIdle
+static uint16_t inputSeenFlags = 0;          // Press flags already queued
+static bool inputSeenAnyKey = false;
+static uint16_t inputSwallowed = 0; // keys whose press woke the screen, ignored until released
+
+// By InputKey
+static volatile bool *const inputFlags[INPUT_KEY_COUNT] = {
+    &PrevPress, &NextPress, &UpPress, &DownPress, &SelPress, &EscPress, &NextPagePress, &PrevPagePress,
+};
+
+static void IRAM_ATTR inputPinISR() {
+    if (xHandle == NULL) return;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(xHandle, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+void inputBegin() {
+    if (inputQueue != NULL) return;
+    inputQueue = xQueueCreate(INPUT_EVENT_QUEUE_SIZE, sizeof(InputEvent));
+    inputSignal = xSemaphoreCreateBinary();
+}
+
+void inputUseKeyReader(InputKeyReader read, const uint8_t *pins, size_t count) {
+    inputKeyReader = read;
+    for (size_t i = 0; i < count; i++) attachInterrupt(digitalPinToInterrupt(pins[i]), inputPinISR, CHANGE);
+    if (count > 0) inputPollMs = INPUT_KEY_READER_POLL_MS;
+}
+
+// For the boards with a key reader, which leave InputHandler out: the input task, and the modules
+// that poll the keys in a loop of their own, still call it
+void __attribute__((weak)) InputHandler(void) {}
+
+static void inputQueueEvent(const InputEvent &event) {
+    if (inputQueue == NULL) return;
+    if (xQueueSend(inputQueue, &event, 0) != pdTRUE) {
+        // nobody is taking them, keep the latest
+        InputEvent oldest;
+        xQueueReceive(inputQueue, &oldest, 0);
+        xQueueSend(inputQueue, &event, 0);
+    }
+    xSemaphoreGive(inputSignal);
+}
+
+// Events of the key reader, and the Press flags they stand for. Returns the flags it set
+static uint16_t inputReadKeys() {
+    InputEvent events[INPUT_KEY_COUNT];
+    size_t count = inputDebouncer.update(inputKeyReader(), millis(), events);
+    uint16_t raised = 0;
+    bool wakeChecked = false, woke = false;
+    for (size_t i = 0; i < count; i++) {
+        const InputEvent &event = events[i];
+        uint16_t bit = INPUT_KEY_BIT(event.key);
+        if (event.type == INPUT_RELEASE) {
+            if (inputSwallowed & bit) {
+                inputSwallowed &= ~bit;
+                continue;
+            }
+            // a tap leaves its flag for check(), only the long press of loopOptions waits for the release
+            if (LongPress) *inputFlags[event.key] = false;
+        } else {
+            if (inputSwallowed & bit) continue;
+            if (!wakeChecked) {
+                woke = wakeUpScreen();
+                wakeChecked = true;
+            }
+            if (woke) {
+                inputSwallowed |= bit;
+                continue;
+            }
+            *inputFlags[event.key] = true;
+            raised |= bit;
+        }
+        inputQueueEvent(event);
+    }
+
+    // the input task clears the flags every 75ms, set them back while loopOptions waits for a long press
+    if (LongPress) {
+        uint16_t held = inputDebouncer.held() & ~inputSwallowed;
+        for (uint8_t key = 0; key < INPUT_KEY_COUNT; key++) {
+            if (held & INPUT_KEY_BIT(key)) *inputFlags[key] = true;
+        }
+        raised |= held;
+    }
+    if (raised) AnyKeyPress = true;
+    return raised;
+}
+
+void inputPoll() {
+    uint16_t raised = inputKeyReader ? inputReadKeys() : 0;
+
+    uint16_t flags = 0;
+    for (uint8_t key = 0; key < INPUT_KEY_COUNT; key++) {
+        if (*inputFlags[key]) flags |= INPUT_KEY_BIT(key);
+    }
+    uint16_t pressed = flags & ~inputSeenFlags & ~raised;
+    for (uint8_t key = 0; key < INPUT_KEY_COUNT; key++) {
+        if (pressed & INPUT_KEY_BIT(key)) inputQueueEvent({(uint32_t)millis(), (InputKey)key, INPUT_PRESS});
+    }
+    inputSeenFlags = flags;
+
+    // keyboards raise AnyKeyPress alone for the keys that are not navigation
+    if (AnyKeyPress && !inputSeenAnyKey && inputSignal != NULL) xSemaphoreGive(inputSignal);
+    inputSeenAnyKey = AnyKeyPress;
+}
+
+void inputTaskWait() {
+    uint32_t wait = inputPollMs;
+    if (inputKeyReader) {
+        uint32_t deadline = inputDebouncer.nextDeadline(millis());
+        if (deadline < wait) wait = deadline;
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+}
+
+void inputNotify() {
+    if (xHandle != NULL) xTaskNotifyGive(xHandle);
+}
+
+bool inputWait(InputEvent &event, uint32_t timeoutMs) {
+    if (inputQueue == NULL) {
+        vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+        return false;
+    }
+    return xQueueReceive(inputQueue, &event, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+void inputFlush() {
+    if (inputQueue != NULL) xQueueReset(inputQueue);
+}
+
+void inputIdle(uint32_t timeoutMs) {
+#ifdef USE_TFT_eSPI_TOUCH
+    // check() reads the touch screen in the caller's task, keep polling it
+    if (timeoutMs > INPUT_POLL_MS) timeoutMs = INPUT_POLL_MS;
+#endif
+    if (inputSignal == NULL) vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+    else xSemaphoreTake(inputSignal, pdMS_TO_TICKS(timeoutMs));
+}
@@ -0,0 +1,40 @@
+#ifndef __INPUT_EVENTS_H__
+#define __INPUT_EVENTS_H__
+
+// Queue of the navigation key events, timestamped. Boards whose buttons are plain GPIOs give the state
+// of their keys to inputUseKeyReader: the input task then sleeps until a pin interrupt, debounces the
+// keys with input_debounce.h and queues press, release and repeat events. The Press flags stay what
+// the menus read, as a view of those events; the flags set by the other boards' InputHandler, the
+// touch screen or remote navigation are queued as presses, so every input ends up in the queue.
+
+#include "input_debounce.h"
+#include <Arduino.h>
+
+#define INPUT_EVENT_QUEUE_SIZE 32
+#define INPUT_POLL_MS 10            // InputHandler of the boards without a key reader
+#define INPUT_KEY_READER_POLL_MS 50 // the pins wake the task, this is for the rest of its loop
+
+// Raw state of the keys, a bit per InputKey (INPUT_KEY_BIT)
+typedef uint16_t (*InputKeyReader)();
+
+// Creates the queue, before the input task starts
+void inputBegin();
+// Reads the keys with read, woken by a CHANGE interrupt on pins. Called from _setup_gpio, such a board
+// need not define InputHandler
+void inputUseKeyReader(InputKeyReader read, const uint8_t *pins, size_t count);
+// Reads the keys and queues the events, then queues the Press flags raised since the last call.
+// Called by the input task after InputHandler
+void inputPoll();
+// Blocks the input task until a pin changes, a key is due an event or the next poll
+void inputTaskWait();
+// Wakes the input task, for a Press flag set by another task to be queued without waiting
+void inputNotify();
+
+// Takes the next event, false when none came within timeoutMs. The queue keeps the latest
+// INPUT_EVENT_QUEUE_SIZE events while nobody takes them, inputFlush() first to wait for a new one
+bool inputWait(InputEvent &event, uint32_t timeoutMs);
+void inputFlush();
+// Sleeps until an event is queued, at most timeoutMs. For the loops that poll the Press flags
+void inputIdle(uint32_t timeoutMs);
+
+#endif
@@ -0,0 +1,128 @@
+#include "line_reader.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+TextSlice TextSlice::trim() const {
+    size_t a = 0, b = len;
+    while (a < b && isspace((unsigned char)data[a])) a++;
+    while (b > a && isspace((unsigned char)data[b - 1])) b--;
+    return TextSlice(data + a, b - a);
+}
+
+TextSlice TextSlice::sub(size_t from, size_t n) const {
+    if (from > len) from = len;
+    if (n > len - from) n = len - from;
+    return TextSlice(data + from, n);
+}
+
+int TextSlice::indexOf(char c, size_t from) const {
+    for (size_t i = from; i < len; i++) {
+        if (data[i] == c) return (int)i;
+    }
+    return -1;
+}
+
+bool TextSlice::equals(const char *s) const { return strlen(s) == len && memcmp(data, s, len) == 0; }
+
+bool TextSlice::equalsIgnoreCase(const char *s) const {
+    if (strlen(s) != len) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (tolower((unsigned char)data[i]) != tolower((unsigned char)s[i])) return false;
+    }
+    return true;
+}
+
+bool TextSlice::startsWith(const char *prefix) const {
+    size_t n = strlen(prefix);
+    return n <= len && memcmp(data, prefix, n) == 0;
+}
+
+bool TextSlice::split(char sep, TextSlice &key, TextSlice &value) const {
+    int at = indexOf(sep);
+    if (at < 0) return false;
+    key = sub(0, at).trim();
+    value = sub(at + 1).trim();
+    return true;
+}
+
+bool TextSlice::toULong(unsigned long &out, int base) const {
+    TextSlice s = trim();
+    if (base == 16 && s.len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) s = s.sub(2);
+    if (s.empty()) return false;
+    unsigned long v = 0;
+    for (size_t i = 0; i < s.len; i++) {
+        int c = tolower((unsigned char)s[i]);
+        int d = isdigit(c) ? c - '0' : (c >= 'a' && c <= 'z' ? c - 'a' + 10 : base);
+        if (d >= base) return false;
+        v = v * base + d;
+    }
+    out = v;
+    return true;
+}
+
+bool TextSlice::toLong(long &out, int base) const {
+    TextSlice s = trim();
+    bool negative = !s.empty() && s[0] == '-';
+    if (!s.empty() && (s[0] == '-' || s[0] == '+')) s = s.sub(1);
+    unsigned long v;
+    if (!s.toULong(v, base)) return false;
+    out = negative ? -(long)v : (long)v;
+    return true;
+}
+
+bool TextSlice::toFloat(float &out) const {
+    char text[32];
+    TextSlice s = trim();
+    if (s.empty() || s.len >= sizeof(text)) return false;
+    s.copy(text, sizeof(text));
+    char *end;
+    out = strtof(text, &end);
+    return *end == '\0';
+}
+
+size_t TextSlice::copy(char *out, size_t cap) const {
+    if (!cap) return 0;
+    size_t n = len < cap - 1 ? len : cap - 1;
+    memcpy(out, data, n);
+    out[n] = '\0';
+    return n;
+}
+
+bool LineReader::next(TextSlice &line) {
+    while (true) {
+        char *nl = (char *)memchr(_buf + _scanned, '\n', _end - _scanned);
+        if (nl || (_eof && _start < _end)) {
+            size_t stop = nl ? nl - _buf : _end;
+            size_t n = stop - _start;
+            if (n && _buf[_start + n - 1] == '\r') n--;
+            line = TextSlice(_buf + _start, n);
+            _start = _scanned = nl ? stop + 1 : _end;
+            _partial = false;
+            _lines++;
+            return true;
+        }
+        if (_eof) return false;
+        _scanned = _end;
+
+        if (_start) { // keep the unfinished line at the front
+            memmove(_buf, _buf + _start, _end - _start);
+            _end -= _start;
+            _scanned -= _start;
+            _start = 0;
+        }
+        if (_end == _size) {
+            // longer than the buffer: hand out what fits, up to the last blank if there is one
+            size_t cut = _size;
+            while (cut > 1 && _buf[cut - 1] != ' ' && _buf[cut - 1] != '\t') cut--;
+            if (cut <= 1) cut = _size;
+            line = TextSlice(_buf, cut);
+            _start = cut;
+            _partial = true;
+            return true;
+        }
+        size_t got = _read(_ctx, (uint8_t *)_buf + _end, _size - _end);
+        if (got == 0) _eof = true;
+        _end += got;
+    }
+}
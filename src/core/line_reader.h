@@ -0,0 +1,70 @@
+#ifndef __LINE_READER_H__
+#define __LINE_READER_H__
+
+// Buffered line reader for the line oriented text files (keys, scripts, chat log, configs).
+// The source is read in blocks into a caller supplied buffer and lines come back as slices
+// into it, valid until the next call; nothing is allocated per line and the file is not read
+// one byte at a time. "\r\n" endings are stripped. A line longer than the buffer comes in
+// pieces cut after the last blank, so words and numbers are never split, with partial() set
+// on every piece but the last.
+// No Arduino dependencies, so it can be benchmarked against String parsing on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct TextSlice {
+    const char *data = nullptr;
+    size_t len = 0;
+
+    TextSlice() = default;
+    TextSlice(const char *d, size_t n) : data(d), len(n) {}
+
+    bool empty() const { return len == 0; }
+    char operator[](size_t i) const { return data[i]; }
+
+    TextSlice trim() const;
+    TextSlice sub(size_t from, size_t n = (size_t)-1) const;
+    int indexOf(char c, size_t from = 0) const;
+    bool equals(const char *s) const;
+    bool equalsIgnoreCase(const char *s) const;
+    bool startsWith(const char *prefix) const;
+
+    // "key: value", "key=value": both sides trimmed, false if sep is missing
+    bool split(char sep, TextSlice &key, TextSlice &value) const;
+    // The whole (trimmed) slice must be the number; base 16 takes an optional 0x
+    bool toLong(long &out, int base = 10) const;
+    bool toULong(unsigned long &out, int base = 10) const;
+    bool toFloat(float &out) const;
+    // Copies into out as a C string, truncated to cap - 1; returns the length copied
+    size_t copy(char *out, size_t cap) const;
+};
+
+class LineReader {
+public:
+    // Reads up to len bytes, 0 at the end of the source
+    typedef size_t (*ReadFn)(void *ctx, uint8_t *buffer, size_t len);
+
+    LineReader(ReadFn read, void *ctx, char *buffer, size_t size)
+        : _read(read), _ctx(ctx), _buf(buffer), _size(size) {}
+
+    // Next line or piece of a long line, false once the source is exhausted
+    bool next(TextSlice &line);
+    // The slice last returned was cut at the buffer size, the line goes on in the next one
+    bool partial() const { return _partial; }
+    // Lines completed so far, the current one included
+    uint32_t lineNumber() const { return _lines; }
+
+private:
+    ReadFn _read;
+    void *_ctx;
+    char *_buf;
+    size_t _size;
+    size_t _start = 0;   // first byte not handed out
+    size_t _end = 0;     // end of the bytes read
+    size_t _scanned = 0; // no '\n' in [_start, _scanned)
+    uint32_t _lines = 0;
+    bool _eof = false;
+    bool _partial = false;
+};
+
+#endif
@@ -2,16 +2,27 @@
 
 #include "massStorage.h"
 #include "core/display.h"
+#include "msc_free_space.h"
+#include "sd_functions.h"
 #include <USB.h>
 #if defined(SOC_USB_OTG_SUPPORTED)
 bool MassStorage::shouldStop = false;
 int32_t MassStorage::status = -1;
 
+static MscFreeSpace mscFreeSpace;
+static uint32_t mscSectorSize = 0;
+static uint8_t *mscFatBefore = nullptr; // FAT sectors a write is about to replace
+static uint32_t mscFatBeforeSize = 0;
+
 MassStorage::MassStorage() { setup(); }
 
 MassStorage::~MassStorage() {
     msc.end();
     USB.~ESPUSB();
+    free(mscFatBefore);
+    mscFatBefore = nullptr;
+    mscFatBeforeSize = 0;
+    sdDirCache.clear(); // the host wrote the card behind FatFs' back
 
     // Hack to make USB back to flash mode
     USB.enableDFU();
@@ -61,6 +72,8 @@ void MassStorage::beginUsb() {
 void MassStorage::setupUsbCallback() {
     uint32_t secSize = SD.sectorSize();
     uint32_t numSectors = SD.numSectors();
+    mscSectorSize = secSize;
+    setupFreeSpace();
 
     msc.vendorID("ESP32");
     msc.productID("BRUCE");
@@ -74,6 +87,18 @@ void MassStorage::setupUsbCallback() {
     msc.begin(numSectors, secSize);
 }
 
+void MassStorage::setupFreeSpace() {
+    // Walks the FAT once, the writes keep it current from here on
+    uint64_t freeBytes = SD.totalBytes() - SD.usedBytes();
+    uint8_t boot[512] = {};
+    uint32_t bootLba = 0;
+    if (SD.readRAW(boot, 0)) {
+        bootLba = MscFreeSpace::bootSectorLba(boot);
+        if (bootLba && !SD.readRAW(boot, bootLba)) memset(boot, 0, sizeof(boot));
+    }
+    mscFreeSpace.begin(boot, bootLba, freeBytes);
+}
+
 void MassStorage::setupUsbEvent() {
     USB.onEvent([](void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
         if (event_base == ARDUINO_USB_EVENTS) { status = event_id; }
@@ -86,38 +111,51 @@ void MassStorage::displayMessage(String message) {
     padprintln(message);
 }
 
-int32_t usbWriteCallback(uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize) {
-    // Verify freespace
-    uint64_t freeSpace = SD.totalBytes() - SD.usedBytes();
-    if (bufsize > freeSpace) {
-        return -1; // no space available
+// Keeps the FAT sectors of [lba, lba + count) as they are before the host overwrites them
+static bool readFatBefore(uint32_t lba, uint32_t count, uint32_t &first, uint32_t &n) {
+    if (!mscFreeSpace.fatOverlap(lba, count, first, n)) return false;
+    uint32_t bytes = n * mscSectorSize;
+    if (bytes > mscFatBeforeSize) {
+        uint8_t *grown = static_cast<uint8_t *>(realloc(mscFatBefore, bytes));
+        if (!grown) return false;
+        mscFatBefore = grown;
+        mscFatBeforeSize = bytes;
     }
+    return SD.readRAW(mscFatBefore, first, n);
+}
 
+int32_t usbWriteCallback(uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize) {
     // Verify sector size
-    const uint32_t secSize = SD.sectorSize();
+    const uint32_t secSize = mscSectorSize;
     if (secSize == 0) return -1; // disk error
+    const uint32_t count = bufsize / secSize;
+
+    // Verify freespace, FAT and directory updates always pass so a full card can be cleaned up
+    if (!mscFreeSpace.isMetadata(lba) && bufsize > mscFreeSpace.freeBytes()) {
+        return -1; // no space available
+    }
+
+    uint32_t fatFirst = 0, fatCount = 0;
+    bool fatWrite = readFatBefore(lba, count, fatFirst, fatCount);
 
-    // Write blocs
-    for (uint32_t x = 0; x < bufsize / secSize; ++x) {
-        uint8_t blkBuffer[secSize];
-        memcpy(blkBuffer, buffer + secSize * x, secSize);
-        if (!SD.writeRAW(blkBuffer, lba + x)) {
-            return -1; // write error
-        }
+    // Write blocs straight from the USB buffer, one multi-block transfer
+    if (!SD.writeRAW(buffer, lba, count)) {
+        return -1; // write error
+    }
+    if (fatWrite) {
+        mscFreeSpace.apply(fatFirst, fatCount, mscFatBefore, buffer + (fatFirst - lba) * secSize);
     }
     return bufsize;
 }
 
 int32_t usbReadCallback(uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize) {
     // Verify sector size
-    const uint32_t secSize = SD.sectorSize();
+    const uint32_t secSize = mscSectorSize;
     if (secSize == 0) return -1; // disk error
 
-    // Read blocs
-    for (uint32_t x = 0; x < bufsize / secSize; ++x) {
-        if (!SD.readRAW(reinterpret_cast<uint8_t *>(buffer) + (x * secSize), lba + x)) {
-            return -1; // read error
-        }
+    // Read blocs, one multi-block transfer
+    if (!SD.readRAW(reinterpret_cast<uint8_t *>(buffer), lba, bufsize / secSize)) {
+        return -1; // read error
     }
     return bufsize;
 }
@@ -40,6 +40,7 @@ private:
     /////////////////////////////////////////////////////////////////////////////////////
     void beginUsb(void);
     void setupUsbCallback(void);
+    void setupFreeSpace(void);
     void setupUsbEvent(void);
 };
 
@@ -229,7 +229,11 @@ void ConfigMenu::advancedMenu() {
 void ConfigMenu::powerMenu() {
     while (true) {
         std::vector<Option> localOptions = {
-            {"Deep Sleep", goToDeepSleep          },
+            {"Deep Sleep",
+             []() {
+                 bruceConfig.flush(); // deep sleep ends in a reset
+                 goToDeepSleep();
+             }                                    },
             {"Sleep",      setSleepMode           },
             {"Restart",    []() { ESP.restart(); }},
             {"Power Off",
@@ -238,7 +242,10 @@ void ConfigMenu::powerMenu() {
                  drawMainBorder(true);
                  int8_t choice = displayMessage("Power Off Device?", "No", nullptr, "Yes", TFT_RED);
 
-                 if (choice == 1) { powerOff(); }
+                 if (choice == 1) {
+                     bruceConfig.flush();
+                     powerOff();
+                 }
              }                                    },
             {"Back",       []() {}                },
         };
@@ -0,0 +1,27 @@
+#include "menu_rows.h"
+
+bool MenuRows::begin(size_t rows, int32_t top, uint16_t fg, uint16_t sel, uint16_t bg, bool force) {
+    if (!force && _rows.size() == rows && _top == top && _colors[0] == fg && _colors[1] == sel &&
+        _colors[2] == bg) {
+        return false;
+    }
+    _rows.assign(rows, Row{"", false, false, false});
+    _top = top;
+    _colors[0] = fg;
+    _colors[1] = sel;
+    _colors[2] = bg;
+    return true;
+}
+
+bool MenuRows::update(size_t row, const char *label, bool cursor, bool selected) {
+    if (row >= _rows.size()) return true;
+    Row &drawn = _rows[row];
+    if (drawn.drawn && drawn.cursor == cursor && drawn.selected == selected && drawn.label == label) {
+        return false;
+    }
+    drawn.label = label;
+    drawn.cursor = cursor;
+    drawn.selected = selected;
+    drawn.drawn = true;
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef __MENU_ROWS_H__
+#define __MENU_ROWS_H__
+
+// The rows drawOptions has on screen, so a redraw only repaints the rows whose label, cursor or
+// selected state changed: a cursor move inside the window costs two rows, a scroll all of them.
+// Anything drawn over the list (popups, the long-press arc) has to invalidate() it.
+// No Arduino dependencies, so the pixels a menu pushes per step can be counted on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class MenuRows {
+public:
+    // Starts a redraw of rows rows from top in these colors. Returns true when nothing on screen can be
+    // reused (force, first use, other geometry or colors): every row is then painted.
+    bool begin(size_t rows, int32_t top, uint16_t fg, uint16_t sel, uint16_t bg, bool force);
+    // What row shows now; true when that differs from what is on screen and the row has to be painted
+    bool update(size_t row, const char *label, bool cursor, bool selected);
+    void invalidate() { _rows.clear(); }
+
+private:
+    struct Row {
+        std::string label;
+        bool cursor;
+        bool selected;
+        bool drawn;
+    };
+    std::vector<Row> _rows; // empty = unknown
+    int32_t _top = 0;
+    uint16_t _colors[3] = {0, 0, 0};
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "mifare_keys_manager.h"
+#include "file_line_reader.h"
 #include "sd_functions.h"
 
 /**
@@ -136,18 +137,22 @@ void MifareKeysManager::loadFromFile(std::set<String> &keys) {
     keys.clear();
     int loaded = 0, skipped = 0;
 
-    while (file.available()) {
-        String line = file.readStringUntil('\n');
-        line.trim();
+    char buffer[256];
+    FileLineReader reader(file, buffer, sizeof(buffer));
+    TextSlice line;
+    while (reader.next(line)) {
+        line = line.trim();
 
-        if (line.length() == 0 || line.startsWith("//")) continue;
+        if (line.empty() || line.startsWith("//")) continue;
 
-        line.toUpperCase();
-        if (isValidHexKey(line)) {
-            keys.insert(line);
+        char key[13];
+        line.copy(key, sizeof(key));
+        for (char *c = key; *c; ++c) *c = toupper((unsigned char)*c);
+        if (line.len == 12 && isValidHexKey(key)) {
+            keys.insert(key);
             loaded++;
         } else {
-            log_w("Invalid key skipped: %s", line.c_str());
+            log_w("Invalid key skipped: %.*s", (int)line.len, line.data);
             skipped++;
         }
     }
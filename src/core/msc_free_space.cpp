@@ -0,0 +1,80 @@
+#include "msc_free_space.h"
+#include <string.h>
+
+#define MSC_SECTOR 512
+
+static inline uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static inline uint32_t rd32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint32_t MscFreeSpace::bootSectorLba(const uint8_t *sector0) {
+    // A boot sector starts with a jump and declares 512 byte sectors, an MBR does neither
+    bool boot = (sector0[0] == 0xEB || sector0[0] == 0xE9) && rd16(sector0 + 11) == MSC_SECTOR;
+    if (boot || sector0[510] != 0x55 || sector0[511] != 0xAA) return 0;
+    return rd32(sector0 + 446 + 8);
+}
+
+void MscFreeSpace::begin(const uint8_t *bootSector, uint32_t bootLba, uint64_t freeBytes) {
+    *this = MscFreeSpace();
+    _freeClusters = freeBytes / _clusterBytes;
+
+    const uint8_t *b = bootSector;
+    const uint32_t perCluster = b[13];
+    const uint32_t reserved = rd16(b + 14);
+    const uint32_t fats = b[16];
+    const uint32_t rootSectors = (rd16(b + 17) * 32 + MSC_SECTOR - 1) / MSC_SECTOR;
+    const uint32_t fatSize = rd16(b + 22) ? rd16(b + 22) : rd32(b + 36);
+    const uint32_t total = rd16(b + 19) ? rd16(b + 19) : rd32(b + 32);
+    // exFAT zeroes the whole BPB, anything else that is not FAT fails here too
+    if (rd16(b + 11) != MSC_SECTOR || !perCluster || !reserved || !fats || !fatSize) return;
+    const uint32_t meta = reserved + fats * fatSize + rootSectors;
+    if (total <= meta) return;
+
+    _dataStart = bootLba + meta;
+    _clusters = (total - meta) / perCluster;
+    _clusterBytes = perCluster * MSC_SECTOR;
+    _freeClusters = freeBytes / _clusterBytes;
+    if (_clusters < 4085) return; // FAT12 entries straddle sectors, left alone
+    _entryBytes = _clusters < 65525 ? 2 : 4;
+    _fatStart = bootLba + reserved;
+    _fatSectors = fatSize;
+}
+
+bool MscFreeSpace::fatOverlap(uint32_t lba, uint32_t count, uint32_t &first, uint32_t &n) const {
+    if (!_fatSectors) return false;
+    uint32_t end = lba + count;
+    uint32_t fatEnd = _fatStart + _fatSectors;
+    first = lba > _fatStart ? lba : _fatStart;
+    uint32_t last = end < fatEnd ? end : fatEnd;
+    if (first >= last) return false;
+    n = last - first;
+    return true;
+}
+
+uint32_t MscFreeSpace::freeEntries(uint32_t sector, const uint8_t *data) const {
+    const uint32_t perSector = MSC_SECTOR / _entryBytes;
+    uint32_t index = (sector - _fatStart) * perSector;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < perSector; ++i, ++index) {
+        // entries 0 and 1 are reserved, the tail of the last FAT sector maps no cluster
+        if (index < 2 || index >= _clusters + 2) continue;
+        const uint8_t *e = data + i * _entryBytes;
+        uint32_t v = _entryBytes == 2 ? rd16(e) : rd32(e) & 0x0FFFFFFF;
+        count += v == 0;
+    }
+    return count;
+}
+
+void MscFreeSpace::apply(uint32_t first, uint32_t n, const uint8_t *before, const uint8_t *after) {
+    if (!_fatSectors) return;
+    int64_t freed = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint8_t *old = before + i * MSC_SECTOR;
+        const uint8_t *cur = after + i * MSC_SECTOR;
+        if (memcmp(old, cur, MSC_SECTOR) == 0) continue;
+        freed += (int64_t)freeEntries(first + i, cur) - freeEntries(first + i, old);
+    }
+    int64_t total = (int64_t)_freeClusters + freed;
+    _freeClusters = total < 0 ? 0 : (total > _clusters ? _clusters : (uint32_t)total);
+}
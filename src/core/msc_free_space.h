@@ -0,0 +1,43 @@
+#ifndef __MSC_FREE_SPACE_H__
+#define __MSC_FREE_SPACE_H__
+
+// Free space of the SD card while the USB host owns it as a mass storage device.
+// The host edits the FAT itself, so what FatFs counted at mount goes stale with the first copy.
+// Writes that land in the first FAT are compared with the sectors they replace, and the free
+// cluster count follows the entries going from free to used and back.
+// FAT16 and FAT32 are followed; on FAT12/exFAT the figure stays at its value at mount.
+// No Arduino dependencies, so it can be checked against FAT images on the host.
+
+#include <stdint.h>
+
+class MscFreeSpace {
+public:
+    // Sector holding the boot sector: 0 for a superfloppy, else the first MBR partition
+    static uint32_t bootSectorLba(const uint8_t *sector0);
+
+    // bootSector is the 512 bytes at bootLba, freeBytes the count FatFs had at mount
+    void begin(const uint8_t *bootSector, uint32_t bootLba, uint64_t freeBytes);
+
+    uint64_t freeBytes() const { return (uint64_t)_freeClusters * _clusterBytes; }
+    // Boot sector, FATs and the FAT16 root directory: never refused for lack of space,
+    // or the host could not delete anything from a full card
+    bool isMetadata(uint32_t lba) const { return lba < _dataStart; }
+
+    // Part of [lba, lba + count) that falls in the first FAT, false when there is none
+    bool fatOverlap(uint32_t lba, uint32_t count, uint32_t &first, uint32_t &n) const;
+    // before/after hold the n sectors from first as they are on the card and as the host writes them
+    void apply(uint32_t first, uint32_t n, const uint8_t *before, const uint8_t *after);
+
+private:
+    uint32_t freeEntries(uint32_t sector, const uint8_t *data) const;
+
+    uint32_t _fatStart = 0;
+    uint32_t _fatSectors = 0; // 0 = not followed
+    uint32_t _dataStart = 0;
+    uint32_t _clusters = 0;
+    uint32_t _clusterBytes = 512;
+    uint32_t _freeClusters = 0;
+    uint8_t _entryBytes = 0; // 2 for FAT16, 4 for FAT32
+};
+
+#endif
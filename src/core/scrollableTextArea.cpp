@@ -47,7 +47,7 @@ void ScrollableTextArea::scrollUp() {
 }
 
 void ScrollableTextArea::scrollDown() {
-    if (firstVisibleLine + _maxVisibleLines <= linesBuffer.size()) {
+    if (hasLine(firstVisibleLine + _maxVisibleLines - 1)) {
         if (firstVisibleLine == 0) firstVisibleLine++;
         firstVisibleLine++;
         _redraw = true;
@@ -55,21 +55,39 @@ void ScrollableTextArea::scrollDown() {
 }
 
 void ScrollableTextArea::scrollToLine(size_t lineNumber) {
-    if (linesBuffer.empty()) return; // Ensure there's content to scroll
+    size_t maxLines = getMaxLines();
+    if (maxLines == 0) return; // Ensure there's content to scroll
 
-    if (lineNumber > linesBuffer.size() - _maxVisibleLines) {
-        firstVisibleLine =
-            (linesBuffer.size() > _maxVisibleLines) ? linesBuffer.size() - _maxVisibleLines : 0;
+    if (lineNumber > maxLines - _maxVisibleLines) {
+        firstVisibleLine = (maxLines > _maxVisibleLines) ? maxLines - _maxVisibleLines : 0;
     } else {
         firstVisibleLine = lineNumber;
     }
 }
 
 String ScrollableTextArea::getLine(size_t lineNumber) {
-    return linesBuffer[(lineNumber >= linesBuffer.size()) ? linesBuffer.size() : lineNumber];
+    const char *line = lineAt(lineNumber);
+    return line ? String(line) : String();
 }
 
-size_t ScrollableTextArea::getMaxLines() { return linesBuffer.size(); }
+// A paged file has to be wrapped to its end to be counted
+size_t ScrollableTextArea::getMaxLines() { return _pager.active() ? _pager.rowCount() : linesBuffer.size(); }
+
+bool ScrollableTextArea::hasLine(size_t lineNumber) {
+    return _pager.active() ? _pager.hasRow(lineNumber) : lineNumber < linesBuffer.size();
+}
+
+const char *ScrollableTextArea::lineAt(size_t lineNumber) {
+    if (_pager.active()) return _pager.row(lineNumber);
+    return lineNumber < linesBuffer.size() ? linesBuffer[lineNumber].c_str() : nullptr;
+}
+
+size_t ScrollableTextArea::readFile(void *ctx, uint32_t offset, uint8_t *buffer, size_t len) {
+    File *file = static_cast<File *>(ctx);
+    if (file->position() != offset && !file->seek(offset)) return 0;
+    size_t got = file->read(buffer, len);
+    return got <= len ? got : 0; // (size_t)-1 on a closed file
+}
 
 void ScrollableTextArea::show(bool force) {
     draw(force);
@@ -94,8 +112,12 @@ void ScrollableTextArea::update(bool force) {
 }
 
 void ScrollableTextArea::fromFile(File file) {
-    linesBuffer.clear();
-    while (file.available()) addLine(file.readStringUntil('\n'));
+    clear();
+    _file = file;
+    // a few screens of rows in memory, the file is read again around wherever the user scrolls to
+    _pager.begin(
+        readFile, &_file, _file.size(), _maxCharactersPerLine, _indentWrappedLines, 4 * _maxVisibleLines
+    );
 
     draw(true);
     delay(100);
@@ -105,6 +127,8 @@ void ScrollableTextArea::fromFile(File file) {
 void ScrollableTextArea::clear() {
     firstVisibleLine = 0;
     linesBuffer.clear();
+    _pager.end();
+    _file = File();
 }
 
 void ScrollableTextArea::fromString(const String &text) {
@@ -176,15 +200,16 @@ void ScrollableTextArea::draw(bool force) {
 
     int32_t tmpHeight = _height;
     // if there is text below
-    if (linesBuffer.size() - firstVisibleLine >= _maxVisibleLines) {
+    if (hasLine(firstVisibleLine + _maxVisibleLines - 1)) {
         _scrollBuffer.drawString("...", 0 + _startX, _startY + _height - _pixelsPerLine);
         tmpHeight -= _pixelsPerLine;
         lines++;
     }
 
     size_t idx{firstVisibleLine};
-    while (yOffset < tmpHeight && lines < _maxVisibleLines && idx < linesBuffer.size()) {
-        _scrollBuffer.drawString(linesBuffer[idx], 0 + _startX, _startY + yOffset);
+    const char *line;
+    while (yOffset < tmpHeight && lines < _maxVisibleLines && (line = lineAt(idx))) {
+        _scrollBuffer.drawString(line, 0 + _startX, _startY + yOffset);
         yOffset += _pixelsPerLine;
         lines++;
         idx++;
@@ -1,4 +1,5 @@
 #include "display.h"
+#include "text_pager.h"
 
 class ScrollableTextArea {
 public:
@@ -26,6 +27,7 @@ public:
 
     void fromString(const String &text);
 
+    // Pages through the file as it is scrolled instead of loading it; the area keeps it open
     void fromFile(File file);
 
     void draw(bool force = false);
@@ -49,8 +51,14 @@ private:
     size_t _maxVisibleLines;
     uint16_t _maxCharactersPerLine;
     bool _indentWrappedLines;
+    File _file;
+    TextPager _pager; // the lines of _file when fromFile was used, linesBuffer stays empty
 
     void setup();
 
+    bool hasLine(size_t lineNumber);
+    const char *lineAt(size_t lineNumber);
+    static size_t readFile(void *ctx, uint32_t offset, uint8_t *buffer, size_t len);
+
     void update(bool force = false);
 };
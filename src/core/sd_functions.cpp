@@ -2,6 +2,7 @@
 #include "display.h" // using displayRedStripe as error msg
 #include "modules/badusb_ble/ducky_typer.h"
 #include "modules/bjs_interpreter/interpreter.h"
+#include "modules/gps/gps_tracker.h"
 #include "modules/gps/wigle.h"
 #include "modules/ir/TV-B-Gone.h"
 #include "modules/ir/custom_ir.h"
@@ -23,6 +24,7 @@
 // SPIClass sdcardSPI;
 String fileToCopy;
 std::vector<FileList> fileList;
+DirCache sdDirCache;
 
 /***************************************************************************************
 ** Function name: setupSdCard
@@ -96,6 +98,9 @@ bool setupSdCard() {
     } else {
         Serial.println("SDCARD mounted successfully");
         sdcardMounted = true;
+        sdDirCache.clear(); // may be another card
+        sdDirCache.setBudget(psramFound() ? DIR_CACHE_PSRAM_BUDGET : DIR_CACHE_HEAP_BUDGET);
+        SD.onChange([](const char *path) { sdDirCache.changed(path); });
         return true;
     }
 }
@@ -106,6 +111,7 @@ bool setupSdCard() {
 ***************************************************************************************/
 void closeSdCard() {
     SD.end();
+    sdDirCache.clear();
     Serial.println("SD Card Unmounted...");
     sdcardMounted = false;
 }
@@ -488,45 +494,71 @@ bool checkExt(String ext, String pattern) {
     return ext == lastExt;
 }
 
+/***************************************************************************************
+** Function name: listDirectory
+** Description:   sorted files/folders of a folder, SD listings come from sdDirCache
+***************************************************************************************/
+static void addListingEntry(void *ctx, const char *name, bool dir, uint64_t size, uint32_t mtime) {
+    static_cast<DirListing *>(ctx)->add(name, dir, size, mtime);
+}
+
+DirListingPtr listDirectory(FS &fs, const String &folder) {
+    if (&fs == &SD) {
+        DirListingPtr cached = sdDirCache.find(folder.c_str());
+        if (cached) return cached;
+        // taken before reading, a write meanwhile keeps this listing out of the cache
+        uint32_t generation = sdDirCache.generation();
+        bool writing = SD.writing(folder.c_str());
+        DirListing listing;
+        if (!SD.listDir(folder.c_str(), addListingEntry, &listing)) return nullptr;
+        // nothing tells when a capture or log still being written grows, list it fresh until it is closed
+        if (writing || SD.writing(folder.c_str())) {
+            listing.sort();
+            return std::make_shared<const DirListing>(std::move(listing));
+        }
+        return sdDirCache.store(folder.c_str(), std::move(listing), generation);
+    }
+
+    File root = fs.open(folder);
+    if (!root || !root.isDirectory()) return nullptr;
+    DirListing listing;
+    while (true) {
+        File entry = root.openNextFile();
+        if (!entry) break;
+        listing.add(entry.name(), entry.isDirectory(), entry.isDirectory() ? 0 : entry.size(), 0);
+        entry.close();
+    }
+    root.close();
+    listing.sort();
+    return std::make_shared<const DirListing>(std::move(listing));
+}
+
 /***************************************************************************************
 ** Function name: readFs
 ** Description:   read files/folders from a folder
 ***************************************************************************************/
-void readFs(FS fs, String folder, String allowed_ext) {
-    int allFilesCount = 0;
+void readFs(FS &fs, String folder, String allowed_ext) {
     fileList.clear();
     FileList object;
 
-    File root = fs.open(folder);
-    if (!root || !root.isDirectory()) { return; }
-
-    while (true) {
-        bool isDir;
-        String fullPath = root.getNextFileName(&isDir);
-        String nameOnly = fullPath.substring(fullPath.lastIndexOf("/") + 1);
-        if (fullPath == "") { break; }
-        // Serial.printf("Path: %s (isDir: %d)\n", fullPath.c_str(), isDir);
+    // Folders/files come sorted
+    DirListingPtr listing = listDirectory(fs, folder);
+    if (!listing) { return; }
 
-        if (isDir) {
-            object.filename = nameOnly;
-            object.folder = true;
-            object.operation = false;
-            fileList.push_back(object);
-        } else {
+    fileList.reserve(listing->size() + 1);
+    for (size_t i = 0; i < listing->size(); i++) {
+        String nameOnly = listing->name(i);
+        bool isDir = (*listing)[i].dir;
+        if (!isDir) {
             int dotIndex = nameOnly.lastIndexOf(".");
             String ext = dotIndex >= 0 ? nameOnly.substring(dotIndex + 1) : "";
-            if (allowed_ext == "*" || checkExt(ext, allowed_ext)) {
-                object.filename = nameOnly;
-                object.folder = false;
-                object.operation = false;
-                fileList.push_back(object);
-            }
+            if (allowed_ext != "*" && !checkExt(ext, allowed_ext)) continue;
         }
+        object.filename = nameOnly;
+        object.folder = isDir;
+        object.operation = false;
+        fileList.push_back(object);
     }
-    root.close();
-
-    // Sort folders/files
-    std::sort(fileList.begin(), fileList.end(), sortList);
 
     Serial.println("Files listed with: " + String(fileList.size()) + " files/folders found");
 
@@ -755,6 +787,11 @@ String loopSD(FS &fs, bool filePicker, String allowed_ext, String rootPath) {
                                                              delay(200);
                                                              txSubFile(&fs, filepath);
                                                          }});
+                    if (filepath.endsWith(".bgt"))
+                        options.insert(options.begin(), {"GPX Export", [&]() {
+                                                             delay(200);
+                                                             exportGpsTrackMenu(fs, filepath);
+                                                         }});
                     if (filepath.endsWith(".csv")) {
                         options.insert(options.begin(), {"Wigle Upload", [&]() {
                                                              delay(200);
@@ -886,10 +923,9 @@ void viewFile(FS fs, String filepath) {
 
     ScrollableTextArea area = ScrollableTextArea("VIEW FILE");
     area.fromFile(file);
-
-    file.close();
-
     area.show();
+
+    file.close(); // the area reads it while it is shown
 }
 
 /*********************************************************************
@@ -1,6 +1,7 @@
 #ifndef __SD_FUNCTIONS_H__
 #define __SD_FUNCTIONS_H__
 
+#include "dir_cache.h"
 #include <FS.h>
 #include <LittleFS.h>
 #include <SD.h>
@@ -14,6 +15,8 @@ struct FileList {
 
 // extern SPIClass sdcardSPI;
 
+extern DirCache sdDirCache;
+
 bool setupSdCard();
 
 void closeSdCard();
@@ -42,7 +45,10 @@ String md5File(FS &fs, String filepath);
 
 String crc32File(FS &fs, String filepath);
 
-void readFs(FS fs, String folder, String allowed_ext = "*");
+// Sorted entries of folder, cached when fs is the SD card; nullptr if it can't be opened
+DirListingPtr listDirectory(FS &fs, const String &folder);
+
+void readFs(FS &fs, String folder, String allowed_ext = "*");
 
 bool sortList(const FileList &a, const FileList &b);
 
@@ -0,0 +1,339 @@
+#include "file_transfer.h"
+#include "core/crc32.h"
+#include <string.h>
+
+static const uint8_t kSync[2] = {'B', 0xF7};
+
+static void putU32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t getU32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+size_t transferEncode(uint8_t type, uint32_t seq, const uint8_t *payload, uint16_t len, uint8_t *out) {
+    out[0] = kSync[0];
+    out[1] = kSync[1];
+    out[2] = type;
+    putU32(out + 3, seq);
+    out[7] = len;
+    out[8] = len >> 8;
+    if (len) memcpy(out + 9, payload, len);
+    putU32(out + 9 + len, crc32Update(0, out + 2, 7 + len));
+    return TRANSFER_FRAME_OVERHEAD + len;
+}
+
+bool TransferDecoder::feed(uint8_t b) {
+    if (!_sync) {
+        _sync = _last == kSync[0] && b == kSync[1];
+        _last = b;
+        _pos = 0;
+        return false;
+    }
+
+    if (_pos < sizeof(_header)) {
+        _header[_pos++] = b;
+        if (_pos == sizeof(_header)) {
+            _frame.type = _header[0];
+            _frame.seq = getU32(_header + 1);
+            _frame.len = _header[5] | _header[6] << 8;
+            if (_frame.type < TRANSFER_READY || _frame.type > TRANSFER_ABORT ||
+                _frame.len > TRANSFER_MAX_PAYLOAD) {
+                _sync = false;
+                _last = b;
+            }
+        }
+        return false;
+    }
+
+    size_t body = _pos - sizeof(_header);
+    _pos++;
+    if (body < _frame.len) {
+        _frame.payload[body] = b;
+        return false;
+    }
+    _crc[body - _frame.len] = b;
+    if (body - _frame.len < 3) return false;
+
+    _sync = false;
+    _last = 0;
+    uint32_t crc = crc32Update(0, _header, sizeof(_header));
+    crc = crc32Update(crc, _frame.payload, _frame.len);
+    if (crc == getU32(_crc)) return true;
+    _crcErrors++;
+    return false;
+}
+
+bool TransferEndpoint::receive() {
+    while (true) {
+        if (_rxPos == _rxLen) {
+            _rxLen = _link.read(_rx, sizeof(_rx));
+            _rxPos = 0;
+            uint32_t now = _link.millis();
+            if (_rxLen == 0) {
+                // a frame never pauses this long, its length was corrupt
+                if (_decoder.busy() && now - _lastByte > _config.retryMs / 4) _decoder.reset();
+                return false;
+            }
+            _lastByte = now;
+        }
+        while (_rxPos < _rxLen) {
+            if (_decoder.feed(_rx[_rxPos++])) {
+                _lastHeard = _lastByte;
+                return true;
+            }
+        }
+    }
+}
+
+void TransferEndpoint::send(uint8_t type, uint32_t seq, const uint8_t *payload, uint16_t len) {
+    _link.write(_tx, transferEncode(type, seq, payload, len, _tx));
+    _framesSent++;
+}
+
+void TransferEndpoint::fail(const char *error) {
+    _state = TRANSFER_FAILED;
+    _error = error;
+}
+
+bool TransferEndpoint::peerSilent() { return _link.millis() - _lastHeard > _config.timeoutMs; }
+
+bool TransferEndpoint::run() {
+    while (poll() == TRANSFER_RUNNING) _link.idle();
+    return _state == TRANSFER_SUCCEEDED;
+}
+
+void TransferEndpoint::abort() {
+    if (_state != TRANSFER_RUNNING) return;
+    send(TRANSFER_ABORT, 0);
+    fail("aborted");
+}
+
+TransferStats TransferEndpoint::stats() const {
+    return {_framesSent, _resent, _decoder.crcErrors(), _timeouts};
+}
+
+TransferState TransferSender::poll() {
+    if (_state != TRANSFER_RUNNING) return _state;
+    uint32_t now = _link.millis();
+    if (!_started) {
+        _started = true;
+        _lastHeard = now;
+        _lastProgress = now;
+    }
+
+    while (receive()) {
+        const TransferFrame &f = _decoder.frame();
+        switch (f.type) {
+            case TRANSFER_READY:
+                if (!ready(f)) return _state;
+                break;
+            case TRANSFER_ACK:
+                if (_ready && f.seq > _base && f.seq <= _frames + 1) {
+                    _base = f.seq;
+                    if (_next < _base) _next = _base;
+                    _lastProgress = now;
+                }
+                break;
+            case TRANSFER_NAK:
+                // frames before seq arrived, resend from there
+                if (_ready && f.seq >= _base && f.seq < _next) {
+                    _base = f.seq;
+                    _resent += _next - f.seq;
+                    _next = f.seq;
+                    _lastProgress = now;
+                }
+                break;
+            case TRANSFER_DONE:
+                if (_ready && _next > _frames) {
+                    if (f.len >= 1 && f.payload[0] == 0) _state = TRANSFER_SUCCEEDED;
+                    else fail("receiver rejected the file");
+                    return _state;
+                }
+                break;
+            case TRANSFER_ABORT: fail("aborted by receiver"); return _state;
+        }
+    }
+
+    if (_ready) {
+        if (now - _lastProgress > _config.retryMs) {
+            _timeouts++;
+            _resent += _next - _base;
+            _next = _base;
+            _lastProgress = now;
+        }
+        while (_next <= _frames && _next < _base + _config.window) {
+            if (!sendFrame(_next)) return _state;
+            _next++;
+        }
+    }
+    if (peerSilent()) fail(_ready ? "receiver stopped answering" : "receiver not ready");
+    return _state;
+}
+
+bool TransferSender::ready(const TransferFrame &f) {
+    if (f.len < 7) return true;
+    uint32_t offset = getU32(f.payload);
+    uint16_t chunk = f.payload[4] | f.payload[5] << 8;
+    uint8_t window = f.payload[6];
+    if (offset > _size || chunk == 0 || chunk > TRANSFER_MAX_PAYLOAD || window == 0) {
+        send(TRANSFER_ABORT, 0);
+        fail("bad resume offset");
+        return false;
+    }
+
+    // A repeated READY means the receiver has nothing yet, start over
+    if (!_ready || offset != _offset || chunk != _config.chunk) {
+        _offset = offset;
+        _config.chunk = chunk;
+        _frames = (_size - offset + chunk - 1) / chunk;
+        _crc = 0;
+        _crcUpTo = 0;
+        for (uint32_t pos = 0; pos < offset;) {
+            size_t n = offset - pos < sizeof(_buf) ? offset - pos : sizeof(_buf);
+            if (_source.readAt(pos, _buf, n) != n) {
+                send(TRANSFER_ABORT, 0);
+                fail("read error");
+                return false;
+            }
+            _crc = crc32Update(_crc, _buf, n);
+            pos += n;
+        }
+    }
+    _config.window = window;
+    _ready = true;
+    _resent += _next;
+    _base = 0;
+    _next = 0;
+    _lastProgress = _link.millis();
+    return true;
+}
+
+bool TransferSender::sendFrame(uint32_t seq) {
+    if (seq == _frames) {
+        uint8_t end[8];
+        putU32(end, _size);
+        putU32(end + 4, _crc);
+        send(TRANSFER_END, seq, end, sizeof(end));
+        return true;
+    }
+
+    uint32_t pos = _offset + seq * _config.chunk;
+    size_t len = _size - pos < _config.chunk ? _size - pos : _config.chunk;
+    if (_source.readAt(pos, _buf, len) != len) {
+        send(TRANSFER_ABORT, 0);
+        fail("read error");
+        return false;
+    }
+    // frames are first sent in order, the CRC follows them
+    if (seq == _crcUpTo) {
+        _crc = crc32Update(_crc, _buf, len);
+        _crcUpTo++;
+    }
+    send(TRANSFER_DATA, seq, _buf, len);
+    return true;
+}
+
+TransferState TransferReceiver::poll() {
+    uint32_t now = _link.millis();
+    if (!_started) {
+        _started = true;
+        _lastHeard = now;
+    }
+
+    while (receive()) {
+        const TransferFrame &f = _decoder.frame();
+        if (f.type == TRANSFER_END) end(f);
+        else if (_state != TRANSFER_RUNNING) continue;
+        else if (f.type == TRANSFER_DATA) data(f);
+        else if (f.type == TRANSFER_ABORT) fail("aborted by sender");
+    }
+    if (_state != TRANSFER_RUNNING) return _state;
+
+    // Nothing for a while: announce again, or ask for what is missing
+    if (!_announced || now - _lastSent > _config.retryMs) {
+        if (_announced) _timeouts++;
+        if (_gotData) {
+            send(TRANSFER_NAK, _expected);
+        } else {
+            uint8_t ready[7];
+            putU32(ready, _received);
+            ready[4] = _config.chunk;
+            ready[5] = _config.chunk >> 8;
+            ready[6] = _config.window;
+            send(TRANSFER_READY, 0, ready, sizeof(ready));
+        }
+        _announced = true;
+        _lastSent = now;
+    }
+    if (peerSilent()) fail("sender stopped answering");
+    return _state;
+}
+
+void TransferReceiver::data(const TransferFrame &f) {
+    _gotData = true;
+    if (f.seq == _expected && f.len > 0 && f.len <= _config.chunk) {
+        if (!_sink.append(f.payload, f.len)) {
+            send(TRANSFER_ABORT, 0);
+            fail("write error");
+            return;
+        }
+        _crc = crc32Update(_crc, f.payload, f.len);
+        _received += f.len;
+        _expected++;
+        _nakSent = false;
+        if (++_sinceAck >= (_config.window + 1u) / 2) ack();
+    } else if (f.seq > _expected) {
+        if (!_nakSent) {
+            send(TRANSFER_NAK, _expected);
+            _nakSent = true;
+            _lastSent = _link.millis();
+        }
+    } else if (_link.millis() - _lastSent > _config.retryMs / 4) {
+        // a resend of what we have, our ACK was lost
+        ack();
+    }
+}
+
+void TransferReceiver::end(const TransferFrame &f) {
+    uint8_t status = 0;
+    if (_state == TRANSFER_SUCCEEDED) {
+        send(TRANSFER_DONE, f.seq, &status, 1);
+        return;
+    }
+    if (f.seq != _expected || f.len < 8) {
+        if (f.seq > _expected && !_nakSent) {
+            send(TRANSFER_NAK, _expected);
+            _nakSent = true;
+            _lastSent = _link.millis();
+        }
+        return;
+    }
+
+    if (getU32(f.payload) != _received || getU32(f.payload + 4) != _crc) {
+        status = 1;
+        send(TRANSFER_DONE, f.seq, &status, 1);
+        fail("CRC mismatch");
+        return;
+    }
+    send(TRANSFER_DONE, f.seq, &status, 1);
+    _state = TRANSFER_SUCCEEDED;
+}
+
+void TransferReceiver::ack() {
+    send(TRANSFER_ACK, _expected);
+    _sinceAck = 0;
+    _lastSent = _link.millis();
+}
+
+void TransferReceiver::linger(uint32_t ms) {
+    uint32_t start = _link.millis();
+    while (_state == TRANSFER_SUCCEEDED && _link.millis() - start < ms) {
+        poll();
+        _link.idle();
+    }
+}
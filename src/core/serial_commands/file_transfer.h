@@ -0,0 +1,207 @@
+#ifndef __FILE_TRANSFER_H__
+#define __FILE_TRANSFER_H__
+
+// Binary file transfer over the serial CLI (storage upload / storage download).
+// Frames: sync "B\xF7", type, seq (u32 LE), payload length (u16 LE), payload, CRC32 (LE) of everything
+// from type to the end of the payload. A corrupt frame is dropped and the decoder hunts for the next
+// sync bytes, so log lines on the same port are skipped too.
+// The receiver opens with READY {offset u32, chunk u16, window u8}: offset is what it already has of
+// the file, so an interrupted transfer resumes there, chunk and window are used by both sides. The
+// sender streams DATA frames numbered from 0 and then END {size u32, crc32 u32} as the last number,
+// at most window of them unacknowledged (go-back-N). The CRC is of the whole file, resumed part
+// included. The receiver takes frames in order only, acknowledges every window / 2 with ACK {next
+// seq} and asks for a resend with NAK {next seq} when it sees a gap; lost frames and acks are
+// recovered by a timeout on both sides. END is answered with DONE {status u8}, either side can give
+// up with ABORT.
+// No Arduino dependencies, both ends run on the host in a loopback test.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRANSFER_MAX_PAYLOAD 1024
+#define TRANSFER_FRAME_OVERHEAD 13
+#define TRANSFER_DEFAULT_WINDOW 8
+
+enum TransferFrameType : uint8_t {
+    TRANSFER_READY = 1,
+    TRANSFER_DATA,
+    TRANSFER_ACK,
+    TRANSFER_NAK,
+    TRANSFER_END,
+    TRANSFER_DONE,
+    TRANSFER_ABORT,
+};
+
+enum TransferState { TRANSFER_RUNNING, TRANSFER_SUCCEEDED, TRANSFER_FAILED };
+
+struct TransferFrame {
+    uint8_t type;
+    uint32_t seq;
+    uint16_t len;
+    uint8_t payload[TRANSFER_MAX_PAYLOAD];
+};
+
+// Writes the frame to out (TRANSFER_FRAME_OVERHEAD + len bytes), returns its size
+size_t transferEncode(uint8_t type, uint32_t seq, const uint8_t *payload, uint16_t len, uint8_t *out);
+
+class TransferDecoder {
+public:
+    // Consumes one byte, true when it completed a valid frame, available in frame() until the next call
+    bool feed(uint8_t b);
+    const TransferFrame &frame() const { return _frame; }
+    uint32_t crcErrors() const { return _crcErrors; }
+    // In the middle of a frame
+    bool busy() const { return _sync; }
+    // Drops the frame in progress, e.g. one whose corrupt length waits for bytes that never come
+    void reset() {
+        _sync = false;
+        _last = 0;
+    }
+
+private:
+    TransferFrame _frame;
+    uint8_t _header[7];
+    size_t _pos = 0; // bytes of the current frame after the sync
+    bool _sync = false;
+    uint8_t _last = 0;
+    uint8_t _crc[4];
+    uint32_t _crcErrors = 0;
+};
+
+// Byte link and clock of a transfer
+class TransferLink {
+public:
+    virtual ~TransferLink() = default;
+    // Never blocks, returns what is available
+    virtual size_t read(uint8_t *buf, size_t len) = 0;
+    virtual void write(const uint8_t *buf, size_t len) = 0;
+    virtual uint32_t millis() = 0;
+    // Called when poll() had nothing to do
+    virtual void idle() {}
+};
+
+struct TransferConfig {
+    uint32_t retryMs = 1000;    // resend after this long without progress
+    uint32_t timeoutMs = 10000; // give up after this long without a valid frame from the peer
+    // Asked for by the receiver
+    uint16_t chunk = TRANSFER_MAX_PAYLOAD;
+    uint8_t window = TRANSFER_DEFAULT_WINDOW;
+};
+
+struct TransferStats {
+    uint32_t framesSent;
+    uint32_t resent;
+    uint32_t crcErrors;
+    uint32_t timeouts;
+};
+
+class TransferEndpoint {
+public:
+    TransferEndpoint(TransferLink &link, const TransferConfig &config) : _link(link), _config(config) {}
+    virtual ~TransferEndpoint() = default;
+
+    // Handles what arrived and sends what is due, never blocks
+    virtual TransferState poll() = 0;
+    // Polls until the transfer ends
+    bool run();
+    void abort();
+
+    TransferState state() const { return _state; }
+    const char *error() const { return _error; }
+    TransferStats stats() const;
+
+protected:
+    bool receive(); // next valid frame in _decoder.frame(), false when there is none
+    void send(uint8_t type, uint32_t seq, const uint8_t *payload = nullptr, uint16_t len = 0);
+    void fail(const char *error);
+    bool peerSilent();
+
+    TransferLink &_link;
+    TransferConfig _config;
+    TransferDecoder _decoder;
+    TransferState _state = TRANSFER_RUNNING;
+    const char *_error = nullptr;
+    uint32_t _lastHeard = 0;
+    uint32_t _lastByte = 0;
+    uint32_t _framesSent = 0;
+    uint32_t _resent = 0;
+    uint32_t _timeouts = 0;
+    bool _started = false;
+
+private:
+    uint8_t _rx[64];
+    size_t _rxLen = 0;
+    size_t _rxPos = 0;
+    uint8_t _tx[TRANSFER_MAX_PAYLOAD + TRANSFER_FRAME_OVERHEAD];
+};
+
+class TransferSource {
+public:
+    virtual ~TransferSource() = default;
+    virtual size_t readAt(uint32_t offset, uint8_t *buf, size_t len) = 0;
+};
+
+// Sends size bytes of source, from where the receiver asks
+class TransferSender : public TransferEndpoint {
+public:
+    TransferSender(
+        TransferLink &link, TransferSource &source, uint32_t size, const TransferConfig &config = {}
+    )
+        : TransferEndpoint(link, config), _source(source), _size(size) {}
+    TransferState poll() override;
+    uint32_t offset() const { return _offset; }
+
+private:
+    bool ready(const TransferFrame &f);
+    bool sendFrame(uint32_t seq);
+
+    TransferSource &_source;
+    uint32_t _size;
+    uint32_t _offset = 0;
+    uint32_t _frames = 0;  // DATA frames, END is number _frames
+    uint32_t _base = 0;    // first unacknowledged frame
+    uint32_t _next = 0;    // next frame to send
+    uint32_t _crcUpTo = 0; // frames already in _crc
+    uint32_t _crc = 0;
+    uint32_t _lastProgress = 0;
+    bool _ready = false;
+    uint8_t _buf[TRANSFER_MAX_PAYLOAD];
+};
+
+class TransferSink {
+public:
+    virtual ~TransferSink() = default;
+    virtual bool append(const uint8_t *data, size_t len) = 0;
+};
+
+// Receives a file into sink, which already holds the first offset bytes, whose CRC32 is prefixCrc
+class TransferReceiver : public TransferEndpoint {
+public:
+    TransferReceiver(
+        TransferLink &link, TransferSink &sink, uint32_t offset, uint32_t prefixCrc,
+        const TransferConfig &config = {}
+    )
+        : TransferEndpoint(link, config), _sink(sink), _received(offset), _crc(prefixCrc) {}
+    TransferState poll() override;
+    // Bytes of the file received so far, where a failed transfer resumes
+    uint32_t received() const { return _received; }
+    // Answers a repeated END for ms after success, in case DONE was lost
+    void linger(uint32_t ms);
+
+private:
+    void data(const TransferFrame &f);
+    void end(const TransferFrame &f);
+    void ack();
+
+    TransferSink &_sink;
+    uint32_t _received;
+    uint32_t _crc;
+    uint32_t _expected = 0;
+    uint32_t _sinceAck = 0;
+    uint32_t _lastSent = 0;
+    bool _announced = false;
+    bool _nakSent = false;
+    bool _gotData = false;
+};
+
+#endif
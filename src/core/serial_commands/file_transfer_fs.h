@@ -0,0 +1,30 @@
+#ifndef __FILE_TRANSFER_FS_H__
+#define __FILE_TRANSFER_FS_H__
+
+// File transfer ends backed by an open file, for the serial and ESP-NOW transfers
+
+#include "file_transfer.h"
+#include <FS.h>
+
+class FileTransferSource : public TransferSource {
+public:
+    FileTransferSource(File &file) : _file(file) {}
+    size_t readAt(uint32_t offset, uint8_t *buf, size_t len) override {
+        if (_file.position() != offset && !_file.seek(offset)) return 0;
+        return _file.read(buf, len);
+    }
+
+private:
+    File &_file;
+};
+
+class FileTransferSink : public TransferSink {
+public:
+    FileTransferSink(File &file) : _file(file) {}
+    bool append(const uint8_t *data, size_t len) override { return _file.write(data, len) == len; }
+
+private:
+    File &_file;
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <globals.h>
 
 uint32_t poweroffCallback(cmd *c) {
+    bruceConfig.flush();
     powerOff();
     esp_deep_sleep_start(); // only wake up via hardware reset
     return true;
@@ -197,6 +197,7 @@ uint32_t rfSendCallback(cmd *c) {
     if (!initRfModule("tx")) return false;
 
     RCSwitch_send(data_int, bits, pulse, protocol, repeat);
+    deinitRfModule();
 
     return true;
 }
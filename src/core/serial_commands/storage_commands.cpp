@@ -1,5 +1,7 @@
 #include "storage_commands.h"
+#include "core/crc32.h"
 #include "core/sd_functions.h"
+#include "file_transfer_fs.h"
 #include "helpers.h"
 #include <globals.h>
 
@@ -136,7 +138,7 @@ uint32_t writeCallback(cmd *c) {
     Argument arg = cmd.getArgument("filepath");
     Argument sizeArg = cmd.getArgument("size");
     String filepath = arg.getValue();
-    String sizeStr = arg.getValue();
+    String sizeStr = sizeArg.getValue();
     filepath.trim();
     int fileSize = sizeStr.toInt();
 
@@ -162,6 +164,127 @@ uint32_t writeCallback(cmd *c) {
     serialDevice->println("File written: " + filepath);
     return true;
 }
+
+// Binary transfers (file_transfer.h) run on the CLI task, nothing else reads the port meanwhile
+class SerialTransferLink : public TransferLink {
+public:
+    size_t read(uint8_t *buf, size_t len) override { return serialDevice->read(buf, len); }
+    void write(const uint8_t *buf, size_t len) override { serialDevice->write((uint8_t *)buf, len); }
+    uint32_t millis() override { return ::millis(); }
+    void idle() override { delay(1); }
+};
+
+uint32_t uploadCallback(cmd *c) {
+    Command cmd(c);
+
+    Argument arg = cmd.getArgument("filepath");
+    Argument chunkArg = cmd.getArgument("chunk");
+    String filepath = arg.getValue();
+    filepath.trim();
+    int chunk = chunkArg.getValue().toInt();
+
+    if (filepath.length() == 0) return false;
+
+    if (!filepath.startsWith("/")) filepath = "/" + filepath;
+
+    FS *fs;
+    if (!getFsStorage(fs)) return false;
+
+    // An interrupted upload is kept in .part and resumed from its end
+    String partPath = filepath + ".part";
+    uint32_t offset = 0;
+    uint32_t crc = 0;
+    File part = fs->open(partPath, FILE_READ);
+    if (part) {
+        uint8_t buf[256];
+        size_t n;
+        while ((n = part.read(buf, sizeof(buf))) > 0) {
+            crc = crc32Update(crc, buf, n);
+            offset += n;
+        }
+        part.close();
+    }
+    part = fs->open(partPath, FILE_APPEND, true);
+    if (!part) {
+        serialDevice->println("Error opening " + partPath);
+        return false;
+    }
+
+    TransferConfig config;
+    if (chunk > 0 && chunk <= TRANSFER_MAX_PAYLOAD) config.chunk = chunk;
+    SerialTransferLink link;
+    FileTransferSink sink(part);
+    TransferReceiver *receiver = new (std::nothrow) TransferReceiver(link, sink, offset, crc, config);
+    if (!receiver) {
+        part.close();
+        return false;
+    }
+
+    serialDevice->printf("Receiving %s from byte %u\n", filepath.c_str(), (unsigned)offset);
+    bool ok = receiver->run();
+    receiver->linger(500);
+    part.close();
+    String error = ok ? "" : receiver->error();
+    uint32_t received = receiver->received();
+    delete receiver;
+
+    if (!ok) {
+        // a corrupt .part would fail every resume
+        if (error == "CRC mismatch") fs->remove(partPath);
+        serialDevice->printf("Upload failed: %s, %u bytes kept\n", error.c_str(), (unsigned)received);
+        return false;
+    }
+    if (fs->exists(filepath)) fs->remove(filepath);
+    if (!fs->rename(partPath, filepath)) {
+        serialDevice->println("Error renaming " + partPath);
+        return false;
+    }
+    serialDevice->println("File received: " + filepath);
+    return true;
+}
+
+uint32_t downloadCallback(cmd *c) {
+    Command cmd(c);
+
+    Argument arg = cmd.getArgument("filepath");
+    String filepath = arg.getValue();
+    filepath.trim();
+
+    if (filepath.length() == 0) return false;
+
+    if (!filepath.startsWith("/")) filepath = "/" + filepath;
+
+    FS *fs;
+    if (!getFsStorage(fs) || !(*fs).exists(filepath)) return false;
+
+    File file = fs->open(filepath, FILE_READ);
+    if (!file) return false;
+    if (file.isDirectory()) {
+        file.close();
+        return false;
+    }
+
+    SerialTransferLink link;
+    FileTransferSource source(file);
+    TransferSender *sender = new (std::nothrow) TransferSender(link, source, file.size());
+    if (!sender) {
+        file.close();
+        return false;
+    }
+
+    serialDevice->printf("Sending %s, %u bytes\n", filepath.c_str(), (unsigned)file.size());
+    bool ok = sender->run();
+    file.close();
+    String error = ok ? "" : sender->error();
+    delete sender;
+
+    if (!ok) {
+        serialDevice->println("Download failed: " + error);
+        return false;
+    }
+    serialDevice->println("File sent: " + filepath);
+    return true;
+}
 #endif
 uint32_t renameCallback(cmd *c) {
     Command cmd(c);
@@ -403,6 +526,13 @@ void createStorageCommand(SimpleCLI *cli) {
     Command cmdWrite = cmd.addCommand("write", writeCallback);
     cmdWrite.addPosArg("filepath");
     cmdWrite.addPosArg("size", "0");
+
+    Command cmdUpload = cmd.addCommand("upload", uploadCallback);
+    cmdUpload.addPosArg("filepath");
+    cmdUpload.addPosArg("chunk", "0");
+
+    Command cmdDownload = cmd.addCommand("download", downloadCallback);
+    cmdDownload.addPosArg("filepath");
 #endif
     Command cmdRename = cmd.addCommand("rename", renameCallback);
     cmdRename.addPosArg("filepath");
@@ -1,4 +1,5 @@
 #include "util_commands.h"
+#include "core/input_events.h"
 #include "core/main_menu.h"
 #include "core/sd_functions.h"
 #include "core/utils.h" // to return optionsJSON
@@ -275,6 +276,7 @@ uint32_t navCallback(cmd *c) {
             AnyKeyPress = true;
             SerialCmdPress = true;
             *var = true;
+            inputNotify();
             if (!LongPress) vTaskDelay(190 / portTICK_PERIOD_MS);
         }
         vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -0,0 +1,138 @@
+#include "text_pager.h"
+#include <string.h>
+
+void TextPager::begin(
+    ReadFn read, void *ctx, uint32_t size, uint16_t maxChars, bool indent, size_t windowRows
+) {
+    end();
+    _read = read;
+    _ctx = ctx;
+    _size = size;
+    _indent = indent;
+    // a continuation row has to hold more than its indent
+    _maxChars = maxChars < (indent ? 2 : 1) ? (indent ? 2 : 1) : maxChars;
+    _windowRows = windowRows ? windowRows : 1;
+    _window.assign(_windowRows * (_maxChars + 1), '\0');
+    _scratch.assign(_maxChars + 1, '\0');
+    _block.resize(TEXT_PAGER_BLOCK);
+    _checkpoints.push_back({0, false});
+}
+
+void TextPager::end() {
+    _read = nullptr;
+    _ctx = nullptr;
+    _size = 0;
+    _blockOffset = 0;
+    _blockLen = 0;
+    std::vector<Cursor>().swap(_checkpoints);
+    std::vector<char>().swap(_window);
+    std::vector<char>().swap(_scratch);
+    std::vector<uint8_t>().swap(_block);
+    _stride = TEXT_PAGER_FIRST_STRIDE;
+    _rowsSeen = 0;
+    _complete = false;
+    _windowRows = 0;
+    _windowFirst = 0;
+    _windowCount = 0;
+}
+
+int TextPager::byteAt(uint32_t offset) {
+    if (offset >= _size) return -1;
+    if (offset - _blockOffset >= _blockLen || offset < _blockOffset) {
+        _blockOffset = offset - offset % TEXT_PAGER_BLOCK;
+        _blockLen = _read(_ctx, _blockOffset, _block.data(), TEXT_PAGER_BLOCK);
+        if (offset - _blockOffset >= _blockLen) return -1;
+    }
+    return _block[offset - _blockOffset];
+}
+
+// "\r" is dropped in front of a line break and at the end of the file
+bool TextPager::isLineEnd(uint32_t offset) {
+    int c = byteAt(offset);
+    return c == '\n' || c < 0;
+}
+
+bool TextPager::wrapRow(Cursor &at, char *out) {
+    if (at.offset >= _size) return false;
+    size_t n = 0;
+    if (at.continuation && _indent) out[n++] = ' ';
+
+    uint32_t p = at.offset;
+    int c;
+    while (n < _maxChars && (c = byteAt(p)) >= 0 && c != '\n') {
+        if (c == '\r' && isLineEnd(p + 1)) break;
+        out[n++] = c;
+        p++;
+    }
+    out[n] = '\0';
+
+    // a row ending right at the line break does not leave an empty continuation row behind
+    c = byteAt(p);
+    if (c == '\r' && isLineEnd(p + 1)) c = byteAt(++p);
+    if (c == '\n') at = {p + 1, false};
+    else at = {p, c >= 0};
+    return true;
+}
+
+void TextPager::noteRow(size_t r, const Cursor &at) {
+    if (r != _checkpoints.size() * _stride) return;
+    if (_checkpoints.size() == TEXT_PAGER_MAX_CHECKPOINTS) {
+        for (size_t i = 0; i < TEXT_PAGER_MAX_CHECKPOINTS / 2; i++) _checkpoints[i] = _checkpoints[2 * i];
+        _checkpoints.resize(TEXT_PAGER_MAX_CHECKPOINTS / 2);
+        _stride *= 2;
+    }
+    _checkpoints.push_back(at);
+}
+
+void TextPager::wrapRows(size_t first, size_t last, char *dst, size_t &written) {
+    written = 0;
+    size_t idx = first / _stride;
+    if (idx >= _checkpoints.size()) idx = _checkpoints.size() - 1;
+    size_t r = idx * _stride;
+    Cursor at = _checkpoints[idx];
+
+    for (; r < last; r++) {
+        noteRow(r, at);
+        char *out = dst && r >= first ? dst + written * (_maxChars + 1) : _scratch.data();
+        if (!wrapRow(at, out)) {
+            _complete = true;
+            _rowsSeen = r;
+            return;
+        }
+        if (r >= _rowsSeen) _rowsSeen = r + 1;
+        if (dst && r >= first) written++;
+    }
+}
+
+const char *TextPager::row(size_t r) {
+    if (!_read || (_complete && r >= _rowsSeen)) return nullptr;
+    if (r < _windowFirst || r >= _windowFirst + _windowCount) {
+        // keep some rows above it too, scrolling back up should not reload straight away
+        _windowFirst = r > _windowRows / 4 ? r - _windowRows / 4 : 0;
+        wrapRows(_windowFirst, _windowFirst + _windowRows, _window.data(), _windowCount);
+        if (r >= _windowFirst + _windowCount) return nullptr;
+    }
+    return _window.data() + (r - _windowFirst) * (_maxChars + 1);
+}
+
+bool TextPager::hasRow(size_t r) {
+    if (!_read) return false;
+    if (r >= _rowsSeen && !_complete) {
+        size_t unused;
+        wrapRows(_rowsSeen, r + 1, nullptr, unused);
+    }
+    return r < _rowsSeen;
+}
+
+size_t TextPager::rowCount() {
+    if (_read && !_complete) {
+        size_t unused;
+        wrapRows(_rowsSeen, (size_t)-1, nullptr, unused);
+    }
+    return _rowsSeen;
+}
+
+size_t TextPager::memoryUsed() const {
+    return sizeof(*this) + _checkpoints.capacity() * sizeof(Cursor) + _window.capacity() +
+           _scratch.capacity() + _block.capacity();
+}
@@ -0,0 +1,77 @@
+#ifndef __TEXT_PAGER_H__
+#define __TEXT_PAGER_H__
+
+// Wrapped rows of a text file read on demand, for viewing files of any size.
+// Rows are wrapped like ScrollableTextArea::addLine does: maxChars per row, continuation
+// rows optionally indented by a space, "\r\n" endings dropped. Only a window of rows is kept
+// in memory; the file position of every stride-th row is remembered as rows are first
+// reached, so any row is found again by seeking to the checkpoint before it and wrapping
+// at most stride rows. The checkpoint table is capped, the stride doubles when it fills.
+// Memory is the window plus the capped table, whatever the file size.
+// No Arduino dependencies, so paging and wrapping can be measured on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define TEXT_PAGER_MAX_CHECKPOINTS 1024
+#define TEXT_PAGER_FIRST_STRIDE 16 // rows between checkpoints until the table fills
+#define TEXT_PAGER_BLOCK 512
+
+class TextPager {
+public:
+    // Reads up to len bytes at offset, returns the count read (0 past the end)
+    typedef size_t (*ReadFn)(void *ctx, uint32_t offset, uint8_t *buffer, size_t len);
+
+    void begin(ReadFn read, void *ctx, uint32_t size, uint16_t maxChars, bool indent, size_t windowRows);
+    void end();
+    bool active() const { return _read != nullptr; }
+
+    // Text of row r, nullptr past the last row. Valid until the window moves to another row.
+    const char *row(size_t r);
+    // Whether row r exists, wraps the file up to it if needed
+    bool hasRow(size_t r);
+    // Wraps the whole file to count its rows
+    size_t rowCount();
+
+    size_t rowsSeen() const { return _rowsSeen; }
+    uint32_t stride() const { return _stride; }
+    size_t memoryUsed() const;
+
+private:
+    struct Cursor {
+        uint32_t offset;   // first byte of the row's text
+        bool continuation; // the row carries on a wrapped line
+    };
+
+    int byteAt(uint32_t offset);
+    bool isLineEnd(uint32_t offset);
+    bool wrapRow(Cursor &at, char *out);
+    void noteRow(size_t r, const Cursor &at);
+    // Wraps from the checkpoint before first up to row last (exclusive), or to the end of the file,
+    // copying rows from first on into dst when it is given
+    void wrapRows(size_t first, size_t last, char *dst, size_t &written);
+
+    ReadFn _read = nullptr;
+    void *_ctx = nullptr;
+    uint32_t _size = 0;
+    uint16_t _maxChars = 0;
+    bool _indent = false;
+
+    std::vector<uint8_t> _block; // TEXT_PAGER_BLOCK bytes, kept off the stack of the caller
+    uint32_t _blockOffset = 0;
+    size_t _blockLen = 0;
+
+    std::vector<Cursor> _checkpoints; // row i * _stride starts at _checkpoints[i]
+    uint32_t _stride = TEXT_PAGER_FIRST_STRIDE;
+    size_t _rowsSeen = 0; // rows known to exist
+    bool _complete = false;
+
+    std::vector<char> _window; // _windowRows rows of _maxChars + 1 bytes
+    size_t _windowRows = 0;
+    size_t _windowFirst = 0;
+    size_t _windowCount = 0;    // rows loaded, fewer at the end of the file
+    std::vector<char> _scratch; // rows wrapped only to move past them
+};
+
+#endif
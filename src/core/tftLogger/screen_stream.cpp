@@ -0,0 +1,153 @@
+#include "screen_stream.h"
+#include <string.h>
+
+// Field layout of each legacy record after AA SS FN, same order as the WebUI keysMap:
+// i = int16 (zigzag varint), c = colour, b = byte, x = byte dropped from the stream,
+// s = trailing string (length prefixed)
+static const char *recordLayout(uint8_t fn) {
+    switch (fn) {
+        case 0: return "c";         // FILLSCREEN
+        case 1:                     // DRAWRECT
+        case 2: return "iiiic";     // FILLRECT
+        case 3:                     // DRAWROUNDRECT
+        case 4: return "iiiiic";    // FILLROUNDRECT
+        case 5:                     // DRAWCIRCLE
+        case 6: return "iiic";      // FILLCIRCLE
+        case 7:                     // DRAWTRIAGLE
+        case 8: return "iiiiiic";   // FILLTRIANGLE
+        case 9:                     // DRAWELIPSE
+        case 10: return "iiiic";    // FILLELIPSE
+        case 11: return "iiiic";    // DRAWLINE
+        case 12: return "iiiiiicc"; // DRAWARC
+        case 13: return "iiiiicc";  // DRAWWIDELINE
+        case 14:                    // DRAWCENTRESTRING
+        case 15:                    // DRAWRIGHTSTRING
+        case 16:                    // DRAWSTRING
+        case 17: return "iiiccs";   // PRINT
+        case 18: return "iiiibxs";  // DRAWIMAGE, x = image slot, the path follows
+        case 20:                    // DRAWFASTVLINE
+        case 21: return "iiic";     // DRAWFASTHLINE
+        case 99: return "iib";      // SCREEN_INFO
+        default: return nullptr;
+    }
+}
+
+uint32_t screenLogHash(const uint8_t *record, uint8_t size) {
+    uint32_t h = 2166136261u;
+    for (uint8_t i = 0; i < size; ++i) h = (h ^ record[i]) * 16777619u;
+    return h;
+}
+
+void ScreenLogIndex::clear() {
+    memset(_head, SCREEN_INDEX_NONE, sizeof(_head));
+    memset(_next, SCREEN_INDEX_NONE, sizeof(_next));
+    memset(_used, 0, sizeof(_used));
+}
+
+void ScreenLogIndex::insert(uint8_t slot, uint32_t hash) {
+    if (slot >= SCREEN_INDEX_SLOTS) return;
+    if (_used[slot]) remove(slot);
+    uint8_t &head = _head[hash % SCREEN_INDEX_BUCKETS];
+    _hash[slot] = hash;
+    _next[slot] = head;
+    _used[slot] = true;
+    head = slot;
+}
+
+void ScreenLogIndex::remove(uint8_t slot) {
+    if (slot >= SCREEN_INDEX_SLOTS || !_used[slot]) return;
+    uint8_t *link = &_head[_hash[slot] % SCREEN_INDEX_BUCKETS];
+    while (*link != SCREEN_INDEX_NONE && *link != slot) link = &_next[*link];
+    if (*link == slot) *link = _next[slot];
+    _next[slot] = SCREEN_INDEX_NONE;
+    _used[slot] = false;
+}
+
+void screenStreamHeader(uint8_t *out, uint8_t flags, uint32_t seq) {
+    out[0] = SCREEN_STREAM_MAGIC;
+    out[1] = SCREEN_STREAM_VERSION;
+    out[2] = flags;
+    out[3] = seq & 0xFF;
+    out[4] = (seq >> 8) & 0xFF;
+    out[5] = (seq >> 16) & 0xFF;
+    out[6] = (seq >> 24) & 0xFF;
+}
+
+// Writes a varint, false if it does not fit
+static bool putVarint(uint8_t *out, size_t cap, size_t &pos, uint32_t v) {
+    do {
+        if (pos >= cap) return false;
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        out[pos++] = v ? (b | 0x80) : b;
+    } while (v);
+    return true;
+}
+
+static bool putBytes(uint8_t *out, size_t cap, size_t &pos, const void *data, size_t len) {
+    if (pos + len > cap) return false;
+    memcpy(out + pos, data, len);
+    pos += len;
+    return true;
+}
+
+size_t screenStreamEncode(
+    const uint8_t *record, ScreenPalette &palette, uint8_t *out, size_t cap, const char *text, size_t textLen
+) {
+    const uint8_t size = record[1];
+    const uint8_t fn = record[2];
+    const char *layout = recordLayout(fn);
+    size_t pos = 0;
+
+    if (!layout) {
+        if (!putBytes(out, cap, pos, "\xFE", 1) || !putVarint(out, cap, pos, size)) return 0;
+        return putBytes(out, cap, pos, record, size) ? pos : 0;
+    }
+
+    if (!putBytes(out, cap, pos, &fn, 1)) return 0;
+    uint8_t in = 3;
+    uint8_t dropped = 0;
+    for (const char *f = layout; *f; ++f) {
+        switch (*f) {
+            case 'i':
+            case 'c': {
+                uint16_t v = in + 1 < size ? (record[in] << 8) | record[in + 1] : 0;
+                in += 2;
+                if (*f == 'i') {
+                    int16_t s = (int16_t)v;
+                    if (!putVarint(out, cap, pos, ((uint32_t)s << 1) ^ (uint32_t)(s >> 15))) return 0;
+                    break;
+                }
+                // palette index << 1, or the colour << 1 | 1 which also enters the palette
+                uint8_t idx = 0;
+                while (idx < palette.count && palette.colors[idx] != v) idx++;
+                if (idx < palette.count) {
+                    if (!putVarint(out, cap, pos, (uint32_t)idx << 1)) return 0;
+                } else {
+                    if (!putVarint(out, cap, pos, ((uint32_t)v << 1) | 1)) return 0;
+                    if (palette.count < SCREEN_PALETTE_SIZE) palette.colors[palette.count++] = v;
+                }
+                break;
+            }
+            case 'b': {
+                uint8_t b = in < size ? record[in] : 0;
+                if (!putBytes(out, cap, pos, &b, 1)) return 0;
+                in++;
+                break;
+            }
+            case 'x':
+                in++;
+                dropped++;
+                break;
+            case 's': {
+                const char *s = text ? text : (const char *)record + in;
+                size_t len = text ? textLen : (in < size ? size - in : 0);
+                // keeps the rebuilt legacy record within its one byte size
+                if (len > 255u - (in - dropped)) len = 255u - (in - dropped);
+                if (!putVarint(out, cap, pos, len) || !putBytes(out, cap, pos, s, len)) return 0;
+                break;
+            }
+        }
+    }
+    return pos;
+}
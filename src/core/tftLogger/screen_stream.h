@@ -0,0 +1,66 @@
+#ifndef __SCREEN_STREAM_H__
+#define __SCREEN_STREAM_H__
+
+// Display independent parts of the WebUI screen mirror.
+// ScreenLogIndex hashes the logged draw records so tft_logger finds duplicates without
+// scanning the ring, and screenStreamEncode() writes the compact form served by
+// /getscreen?since=N:
+//   header: AB, version, flags, seq (u32 LE) of the last record included
+//   record: function id, then its fields in the order of the legacy record. Coordinates are
+//           zigzag varints, colours refer to a palette built up along the response, strings
+//           and image paths are length prefixed.
+// No Arduino dependencies, so the encoder can be replayed against recorded traces on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCREEN_STREAM_MAGIC 0xAB
+#define SCREEN_STREAM_VERSION 1
+#define SCREEN_STREAM_HEADER 7
+#define SCREEN_STREAM_FULL 0x01 // the client clears the canvas before drawing
+#define SCREEN_STREAM_RAW 0xFE  // record without a known layout, copied as is
+#define SCREEN_PALETTE_SIZE 64
+
+#define SCREEN_INDEX_SLOTS 64
+#define SCREEN_INDEX_BUCKETS 128
+#define SCREEN_INDEX_NONE 0xFF
+
+// FNV-1a over the whole record, header included
+uint32_t screenLogHash(const uint8_t *record, uint8_t size);
+
+class ScreenLogIndex {
+public:
+    ScreenLogIndex() { clear(); }
+
+    void clear();
+    void insert(uint8_t slot, uint32_t hash);
+    void remove(uint8_t slot);
+    // Slots whose hash shares the bucket, the records still have to be compared
+    uint8_t first(uint32_t hash) const { return _head[hash % SCREEN_INDEX_BUCKETS]; }
+    uint8_t next(uint8_t slot) const { return _next[slot]; }
+    uint32_t hashOf(uint8_t slot) const { return _hash[slot]; }
+
+private:
+    uint8_t _head[SCREEN_INDEX_BUCKETS];
+    uint8_t _next[SCREEN_INDEX_SLOTS];
+    uint32_t _hash[SCREEN_INDEX_SLOTS];
+    bool _used[SCREEN_INDEX_SLOTS];
+};
+
+struct ScreenPalette {
+    uint16_t colors[SCREEN_PALETTE_SIZE];
+    uint8_t count = 0;
+};
+
+void screenStreamHeader(uint8_t *out, uint8_t flags, uint32_t seq);
+inline uint32_t screenStreamSeq(const uint8_t *header) {
+    return header[3] | (header[4] << 8) | (header[5] << 16) | ((uint32_t)header[6] << 24);
+}
+// Encodes one legacy record (AA size fn fields...). text replaces the trailing string when the
+// record only carries a reference to it (image paths). Returns 0 if it does not fit in cap.
+size_t screenStreamEncode(
+    const uint8_t *record, ScreenPalette &palette, uint8_t *out, size_t cap, const char *text = nullptr,
+    size_t textLen = 0
+);
+
+#endif
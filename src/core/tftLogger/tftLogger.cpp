@@ -22,15 +22,30 @@ void tft_logger::clearLog() {
     if (images) memset(images, 0, MAX_LOG_IMAGES * MAX_LOG_IMG_PATH);
     logWriteIndex = 0;
     logCount = 0;
+    logIndex.clear();
+    memset(logSeq, 0, sizeof(logSeq));
+    // a seq no record carries, every client that has not seen it starts over
+    resyncSeq = ++seqCounter;
 }
 
 void tft_logger::addLogEntry(const uint8_t *buffer, uint8_t size) {
     if (!log) return;
+    if (logCount == MAX_LOG_ENTRIES) {
+        logIndex.remove(logWriteIndex);
+        if (log[logWriteIndex].data[0] == LOG_PACKET_HEADER) evictedSeq = logSeq[logWriteIndex];
+    }
     memcpy(log[logWriteIndex].data, buffer, size);
+    logIndex.insert(logWriteIndex, screenLogHash(buffer, size));
+    logSeq[logWriteIndex] = ++seqCounter;
     logWriteIndex = (logWriteIndex + 1) % MAX_LOG_ENTRIES;
     if (logCount < MAX_LOG_ENTRIES) ++logCount;
 }
 
+void tft_logger::markLogDeleted(int i) {
+    log[i].data[0] = 0;
+    logIndex.remove(i);
+}
+
 void tft_logger::logWriteHeader(uint8_t *buffer, uint8_t &pos, tftFuncs fn) {
     buffer[pos++] = LOG_PACKET_HEADER;
     buffer[pos++] = 0; // placeholder size
@@ -166,7 +181,7 @@ void tft_logger::getBinLog(uint8_t *outBuffer, size_t &outSize) {
     outSize += pos;
 
     if (!log) return;
-    for (int i = 0; i < logCount; i++) {
+    for (int n = 0, i = logFirstIndex(); n < logCount; n++, i = (i + 1) % MAX_LOG_ENTRIES) {
         if (log[i].data[0] != LOG_PACKET_HEADER) continue;
         uint8_t *entry = log[i].data;
         uint8_t fn = entry[2];
@@ -195,6 +210,69 @@ void tft_logger::getBinLog(uint8_t *outBuffer, size_t &outSize) {
     }
 }
 
+uint32_t tft_logger::screenInfoKey() {
+    uint8_t rot = 0;
+#if defined(HAS_SCREEN)
+    rot = getRotation();
+#endif
+    return ((uint32_t)(width() & 0xFFF) << 20) | ((uint32_t)(height() & 0xFFF) << 8) | rot;
+}
+
+void tft_logger::getBinLogSince(uint32_t since, uint8_t *outBuffer, size_t &outSize, size_t capacity) {
+    outSize = 0;
+    if (capacity < SCREEN_STREAM_HEADER) return;
+
+    uint32_t info = screenInfoKey();
+    if (info != lastScreenInfo) {
+        lastScreenInfo = info;
+        resyncSeq = ++seqCounter;
+    }
+    const bool full = since == 0 || since > seqCounter || since < evictedSeq || since < resyncSeq;
+    uint32_t seq = full ? resyncSeq : since;
+    ScreenPalette palette;
+    outSize = SCREEN_STREAM_HEADER;
+
+    if (full) {
+        uint8_t buffer[16];
+        uint8_t pos = 0;
+        logWriteHeader(buffer, pos, SCREEN_INFO);
+        writeUint16(buffer, pos, width());
+        writeUint16(buffer, pos, height());
+        buffer[pos++] = info & 0xFF;
+        buffer[1] = pos;
+        outSize += screenStreamEncode(buffer, palette, outBuffer + outSize, capacity - outSize);
+    }
+
+    bool complete = true;
+    if (log) {
+        for (int n = 0, i = logFirstIndex(); n < logCount; n++, i = (i + 1) % MAX_LOG_ENTRIES) {
+            if (logSeq[i] <= since && !full) continue;
+            const uint8_t *entry = log[i].data;
+            if (entry[0] == LOG_PACKET_HEADER) {
+                size_t len;
+                if (entry[2] == DRAWIMAGE) {
+                    if (!images) continue;
+                    const char *imgPath = images[entry[12]];
+                    len = screenStreamEncode(
+                        entry, palette, outBuffer + outSize, capacity - outSize, imgPath, strlen(imgPath)
+                    );
+                } else {
+                    len = screenStreamEncode(entry, palette, outBuffer + outSize, capacity - outSize);
+                }
+                // out of room, the client asks again from the last record it got
+                if (!len) {
+                    complete = false;
+                    break;
+                }
+                outSize += len;
+            }
+            if (logSeq[i] > seq) seq = logSeq[i];
+        }
+    }
+    if (complete) seq = seqCounter;
+    screenStreamHeader(outBuffer, full ? SCREEN_STREAM_FULL : 0, seq);
+}
+
 void tft_logger::restoreLogger() {
     if (_logging) logging = true;
 }
@@ -208,14 +286,13 @@ bool tft_logger::isLogEqual(const tftLog &a, const tftLog &b) {
 
 void tft_logger::pushLogIfUnique(const tftLog &l) {
     if (!log) return;
-    for (int i = 0; i < logCount; i++) {
-        if (isLogEqual(log[i], l)) {
+    uint32_t hash = screenLogHash(l.data, l.data[1]);
+    for (uint8_t i = logIndex.first(hash); i != SCREEN_INDEX_NONE; i = logIndex.next(i)) {
+        if (logIndex.hashOf(i) == hash && isLogEqual(log[i], l)) {
             return; // Entry already exists
         }
     }
-    memcpy(log[logWriteIndex].data, l.data, l.data[1]);
-    logWriteIndex = (logWriteIndex + 1) % MAX_LOG_ENTRIES;
-    if (logCount < MAX_LOG_ENTRIES) ++logCount;
+    addLogEntry(l.data, l.data[1]);
     if (async_serial && asyncSerialQueue) { xQueueSend(asyncSerialQueue, &l, 0); }
 }
 
@@ -233,7 +310,7 @@ bool tft_logger::removeLogEntriesInsideRect(int rx, int ry, int rw, int rh) {
         int px = (data[3] << 8) | data[4];
         int py = (data[5] << 8) | data[6];
         if (px >= rx1 && px < rx2 && py >= ry1 && py < ry2) {
-            data[0] = 0; // Mark as deleted
+            markLogDeleted(i);
             r = true;
         }
     }
@@ -252,7 +329,7 @@ void tft_logger::removeOverlappedImages(int x, int y, int center, int ms) {
         int pcenter = (data[7] << 8) | data[8];
         int pms = (data[9] << 8) | data[10];
         if (px == x && py == y && pcenter == center && pms == ms) {
-            data[0] = 0; // Mark as deleted
+            markLogDeleted(i);
         }
     }
 }
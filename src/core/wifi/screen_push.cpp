@@ -0,0 +1,86 @@
+#include "screen_push.h"
+#include "core/tftLogger/screen_stream.h"
+
+void ScreenPushClient::reset() { *this = ScreenPushClient(); }
+
+ScreenPushClient::Action ScreenPushClient::poll(uint32_t nowMs, uint32_t logSeq, bool canSend) {
+    if (logSeq == _sent && !_resync) {
+        _dirty = false;
+        return PUSH_NONE;
+    }
+    if (!_dirty) {
+        _dirty = true;
+        _dirtyAt = nowMs;
+    }
+    // a new client is drawn right away, changes wait for the rest of their burst
+    if (_sent && nowMs - _dirtyAt < SCREEN_PUSH_FRAME_MS) return PUSH_NONE;
+
+    if (!canSend) {
+        if (!_blocked) {
+            _blocked = true;
+            _blockedAt = nowMs;
+        }
+        if (!_resync && nowMs - _blockedAt >= SCREEN_PUSH_RESYNC_MS) {
+            _resync = true;
+            _resyncs++;
+        }
+        return PUSH_NONE;
+    }
+    _blocked = false;
+    return _resync ? PUSH_FULL : PUSH_DELTA;
+}
+
+void ScreenPushClient::sent(uint32_t seq) {
+    _sent = seq;
+    _resync = false;
+    _dirty = false;
+    _batches++;
+}
+
+void ScreenPushHub::connect(uint32_t client) {
+    disconnect(client);
+    for (Viewer &v : _viewers) {
+        if (!v.id) {
+            v.id = client;
+            v.push.reset();
+            return;
+        }
+    }
+    _link.close(client); // the page falls back to polling /getscreen
+}
+
+void ScreenPushHub::disconnect(uint32_t client) {
+    for (Viewer &v : _viewers) {
+        if (v.id == client) v.id = 0;
+    }
+}
+
+void ScreenPushHub::tick(uint8_t *buf, size_t cap) {
+    uint32_t now = _link.millis();
+    uint32_t seq = _link.logSeq();
+    for (Viewer &v : _viewers) {
+        if (!v.id) continue;
+        if (!_link.connected(v.id)) {
+            v.id = 0;
+            continue;
+        }
+        if (v.push.poll(now, seq, _link.canSend(v.id)) == ScreenPushClient::PUSH_NONE) continue;
+        size_t size = _link.logSince(v.push.since(), buf, cap);
+        if (size < SCREEN_STREAM_HEADER) continue;
+        _link.send(v.id, buf, size);
+        v.push.sent(screenStreamSeq(buf));
+    }
+}
+
+size_t ScreenPushHub::viewers() const {
+    size_t n = 0;
+    for (const Viewer &v : _viewers) n += v.id != 0;
+    return n;
+}
+
+const ScreenPushClient *ScreenPushHub::viewer(uint32_t client) const {
+    for (const Viewer &v : _viewers) {
+        if (client && v.id == client) return &v.push;
+    }
+    return nullptr;
+}
@@ -0,0 +1,89 @@
+#ifndef __SCREEN_PUSH_H__
+#define __SCREEN_PUSH_H__
+
+// When a WebSocket viewer of the screen mirror gets its next batch.
+// Draw commands logged in a burst (a whole menu being redrawn) are coalesced into one message
+// sent a frame interval after the first of them. While the socket send queue is full nothing is
+// queued behind it; if the client stays blocked longer than the resync timeout it gets a full
+// screen once it drains instead of the deltas it fell behind on.
+// ScreenPushHub keeps the viewers of /ws/screen and pushes each its batches through a
+// ScreenPushLink, the socket and screen log as the web interface provides them.
+// No Arduino dependencies, so the policy can be driven against a fake socket on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCREEN_PUSH_MAX_CLIENTS 4
+#define SCREEN_PUSH_TICK_MS 10
+#define SCREEN_PUSH_FRAME_MS 40
+#define SCREEN_PUSH_RESYNC_MS 500
+
+class ScreenPushClient {
+public:
+    enum Action : uint8_t { PUSH_NONE, PUSH_DELTA, PUSH_FULL };
+
+    // New connection, the first batch is a full screen
+    void reset();
+    // logSeq is the logger's last seq, canSend whether the socket has room for another message
+    Action poll(uint32_t nowMs, uint32_t logSeq, bool canSend);
+    // seq to pass to getBinLogSince(), 0 when the client needs everything
+    uint32_t since() const { return _resync ? 0 : _sent; }
+    // seq from the header of the batch handed to the socket
+    void sent(uint32_t seq);
+
+    uint32_t batches() const { return _batches; }
+    uint32_t resyncs() const { return _resyncs; }
+
+private:
+    uint32_t _sent = 0;
+    uint32_t _dirtyAt = 0;
+    uint32_t _blockedAt = 0;
+    uint32_t _batches = 0;
+    uint32_t _resyncs = 0;
+    bool _dirty = false;
+    bool _blocked = false;
+    bool _resync = true;
+};
+
+// The viewers' socket, the screen log and the clock
+class ScreenPushLink {
+public:
+    virtual ~ScreenPushLink() = default;
+    // Whether the viewer is still connected
+    virtual bool connected(uint32_t client) = 0;
+    // Whether the viewer's send queue has room for another message
+    virtual bool canSend(uint32_t client) = 0;
+    // Queues a binary message to the viewer
+    virtual void send(uint32_t client, const uint8_t *data, size_t len) = 0;
+    virtual void close(uint32_t client) = 0;
+    // Last seq of the screen log
+    virtual uint32_t logSeq() = 0;
+    // The log after since in the compact stream format (getBinLogSince), its size
+    virtual size_t logSince(uint32_t since, uint8_t *buf, size_t cap) = 0;
+    virtual uint32_t millis() = 0;
+};
+
+class ScreenPushHub {
+public:
+    explicit ScreenPushHub(ScreenPushLink &link) : _link(link) {}
+
+    // A viewer connected; closed when all SCREEN_PUSH_MAX_CLIENTS slots are taken
+    void connect(uint32_t client);
+    void disconnect(uint32_t client);
+    // Pushes a batch to every viewer due one, buf of cap bytes holds it meanwhile
+    void tick(uint8_t *buf, size_t cap);
+
+    size_t viewers() const;
+    const ScreenPushClient *viewer(uint32_t client) const;
+
+private:
+    struct Viewer {
+        uint32_t id; // 0 = free slot
+        ScreenPushClient push;
+    };
+
+    ScreenPushLink &_link;
+    Viewer _viewers[SCREEN_PUSH_MAX_CLIENTS] = {};
+};
+
+#endif
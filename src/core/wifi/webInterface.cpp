@@ -1,12 +1,14 @@
 #include "webInterface.h"
-#include "core/display.h"    // using displayRedStripe as error msg
-#include "core/mykeyboard.h" // using keyboard when calling rename
+#include "core/display.h"      // using displayRedStripe as error msg
+#include "core/input_events.h" // inputNotify
+#include "core/mykeyboard.h"   // using keyboard when calling rename
 #include "core/passwords.h"
 #include "core/sd_functions.h" // using sd functions called to rename and manage sd files
 #include "core/serialcmds.h"
 #include "core/settings.h"
 #include "core/utils.h"
 #include "core/wifi/wifi_common.h" // using common wifisetup
+#include "screen_push.h"
 #include "esp_task_wdt.h"
 #include "webFiles.h"
 #include <MD5Builder.h>
@@ -24,10 +26,13 @@ const int default_webserverporthttp = 80;
 IPAddress AP_GATEWAY(172, 0, 0, 1); // Gateway
 
 AsyncWebServer *server = nullptr; // initialise webserver
+AsyncWebSocket *screenSocket = nullptr; // pushes the screen mirror to the navigator
 const char *host = "bruce";
 String uploadFolder = "";
 static bool mdnsRunning = false;
 
+static void stopScreenPush();
+
 // Generate random token
 String generateToken(int length = 24) {
     String token = "";
@@ -43,6 +48,7 @@ String generateToken(int length = 24) {
 void stopWebUi() {
     tft.setLogging(false);
     isWebUIActive = false;
+    stopScreenPush();
     server->end();
     server->~AsyncWebServer();
     free(server);
@@ -90,45 +96,22 @@ String humanReadableSize(uint64_t bytes) {
 
 /**********************************************************************
 **  Function: listFiles
-**  list all of the files, if ishtml=true, return html rather than simple text
+**  streams the sorted listing of a folder, as JSON when json=true,
+**  else in the pa:/Fo:/Fi: line format
 **********************************************************************/
-String listFiles(FS &fs, String folder) {
-    // log_i("Listfiles Start");
-    String returnText = "pa:" + folder + ":0\n";
-    // Serial.println("Listing files stored on SD");
-
+AsyncWebServerResponse *listFiles(AsyncWebServerRequest *request, FS &fs, String folder, bool json) {
     _webFS = fs;
-
-    File root = fs.open(folder);
     uploadFolder = folder;
 
-    while (true) {
-        bool isDir;
-        String fullPath = root.getNextFileName(&isDir);
-        String nameOnly = fullPath.substring(fullPath.lastIndexOf("/") + 1);
-        if (fullPath == "") { break; }
-        // Serial.printf("Path: %s (isDir: %d)\n", fullPath.c_str(), isDir);
-
-        if (esp_get_free_heap_size() > (String("Fo:" + nameOnly + ":0\n").length()) + 1024) {
-            if (isDir) {
-                // Serial.printf("Directory: %s\n", fullPath.c_str());
-                returnText += "Fo:" + nameOnly + ":0\n";
-            } else {
-                // For files, we need to get the size, so we open the file briefly
-                // Serial.printf("Opening file for size check: %s\n", fullPath.c_str());
-                File file = fs.open(fullPath);
-                // Serial.printf("File size: %llu bytes\n", file.size());
-                if (file) {
-                    returnText += "Fi:" + nameOnly + ":" + humanReadableSize(file.size()) + "\n";
-                    file.close();
-                }
-            }
-        } else break;
-        esp_task_wdt_reset();
-    }
-    root.close();
-    // log_i("ListFiles End");
-    return returnText;
+    // SD listings come from sdDirCache, no file is opened for its size
+    DirListingPtr listing = listDirectory(fs, folder);
+    auto writer = std::make_shared<DirListingWriter>(listing, folder.c_str(), json);
+    return request->beginChunkedResponse(
+        json ? "application/json" : "text/plain",
+        [writer](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return writer->read(buffer, maxLen);
+        }
+    );
 }
 
 /**********************************************************************
@@ -136,7 +119,7 @@ String listFiles(FS &fs, String folder) {
 ** used by server->on functions to discern whether a user has the correct
 ** httpapitoken OR is authenticated by username and password
 **********************************************************************/
-bool checkUserWebAuth(AsyncWebServerRequest *request, bool onFailureReturnLoginPage = false) {
+static bool hasWebUISession(AsyncWebServerRequest *request) {
     if (request->hasHeader("Cookie")) {
         const AsyncWebHeader *cookie = request->getHeader("Cookie");
         String c = cookie->value();
@@ -149,6 +132,11 @@ bool checkUserWebAuth(AsyncWebServerRequest *request, bool onFailureReturnLoginP
             if (bruceConfig.isValidWebUISession(token)) { return true; }
         }
     }
+    return false;
+}
+
+bool checkUserWebAuth(AsyncWebServerRequest *request, bool onFailureReturnLoginPage = false) {
+    if (hasWebUISession(request)) return true;
     if (onFailureReturnLoginPage) {
         serveWebUIFile(request, "login.html", "text/html", true, login_html, login_html_size);
     } else {
@@ -157,6 +145,175 @@ bool checkUserWebAuth(AsyncWebServerRequest *request, bool onFailureReturnLoginP
     return false;
 }
 
+/**********************************************************************
+**  Function: navCommandButton / holdNavButton
+**  "nav <button> [ms]" sent by the WebUI navigator, through /cm or the
+**  screen socket
+**********************************************************************/
+static volatile bool *navCommandButton(const String &cmnd) {
+    volatile bool *var = &SelPress;
+    if (cmnd.startsWith("nav sel")) var = &SelPress;
+    if (cmnd.startsWith("nav esc")) var = &EscPress;
+    if (cmnd.startsWith("nav up")) var = &UpPress;
+    if (cmnd.startsWith("nav down")) var = &DownPress;
+    if (cmnd.startsWith("nav next")) var = &NextPress;
+    if (cmnd.startsWith("nav prev")) var = &PrevPress;
+    return var;
+}
+
+static int navCommandTime(const String &cmnd) {
+    if (cmnd.endsWith("0")) return cmnd.substring(cmnd.lastIndexOf(' ')).toInt();
+    return 10;
+}
+
+// keepHolding, when given, cuts the hold short once it turns false
+static void holdNavButton(volatile bool *var, int time, const volatile bool *keepHolding = nullptr) {
+    auto tmp = millis() + time;
+    while (tmp > millis() && (!keepHolding || *keepHolding)) {
+        AnyKeyPress = true;
+        SerialCmdPress = true;
+        *var = true;
+        inputNotify();
+        if (!LongPress) vTaskDelay(pdMS_TO_TICKS(190));
+        else vTaskDelay(pdMS_TO_TICKS(50));
+    }
+}
+
+/**********************************************************************
+**  Screen socket
+**  /ws/screen pushes what tft_logger logs to the WebUI navigator as it is
+**  drawn and takes the navigator buttons. Socket events only queue work:
+**  screenPushTaskFunc runs the viewers' ScreenPushHub, screenNavTaskFunc
+**  holds the buttons, so a long press doesn't stall the mirror.
+**********************************************************************/
+struct ScreenSocketEvent {
+    enum Type : uint8_t { CONNECT, DISCONNECT, NAV } type;
+    uint32_t client;
+    volatile bool *button;
+    int time;
+};
+static QueueHandle_t screenSocketEvents = NULL;
+static QueueHandle_t screenNavEvents = NULL;
+static TaskHandle_t screenPushTask = NULL;
+static TaskHandle_t screenNavTask = NULL;
+static SemaphoreHandle_t screenTaskExited = NULL; // given by each of the two tasks as it ends
+static volatile bool screenPushRunning = false;
+
+static void onScreenSocketEvent(
+    AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len
+) {
+    ScreenSocketEvent ev = {ScreenSocketEvent::CONNECT, client->id(), nullptr, 0};
+    if (type == WS_EVT_CONNECT) {
+        if (!hasWebUISession(static_cast<AsyncWebServerRequest *>(arg))) {
+            client->close();
+            return;
+        }
+    } else if (type == WS_EVT_DISCONNECT) {
+        ev.type = ScreenSocketEvent::DISCONNECT;
+    } else if (type == WS_EVT_DATA) {
+        // "nav up", "nav sel 1000"... each in a single text frame
+        AwsFrameInfo *info = static_cast<AwsFrameInfo *>(arg);
+        char text[33];
+        if (!info->final || info->index || info->len != len || info->opcode != WS_TEXT) return;
+        if (len >= sizeof(text)) return;
+        memcpy(text, data, len);
+        text[len] = '\0';
+        String cmnd = text;
+        if (!cmnd.startsWith("nav")) return;
+        ev.type = ScreenSocketEvent::NAV;
+        ev.button = navCommandButton(cmnd);
+        ev.time = navCommandTime(cmnd);
+    } else {
+        return;
+    }
+    QueueHandle_t queue = ev.type == ScreenSocketEvent::NAV ? screenNavEvents : screenSocketEvents;
+    if (queue) xQueueSend(queue, &ev, 0);
+}
+
+static void screenNavTaskFunc(void *pv) {
+    while (screenPushRunning) {
+        ScreenSocketEvent ev;
+        if (!xQueueReceive(screenNavEvents, &ev, pdMS_TO_TICKS(100))) continue;
+        holdNavButton(ev.button, ev.time, &screenPushRunning);
+    }
+    xSemaphoreGive(screenTaskExited);
+    vTaskDelete(NULL);
+}
+
+// ScreenPushHub's view of /ws/screen and tft_logger
+class ScreenSocketLink : public ScreenPushLink {
+public:
+    bool connected(uint32_t client) override { return screenSocket->client(client) != nullptr; }
+    bool canSend(uint32_t client) override {
+        AsyncWebSocketClient *c = screenSocket->client(client);
+        return c && !c->queueIsFull();
+    }
+    void send(uint32_t client, const uint8_t *data, size_t len) override {
+        if (AsyncWebSocketClient *c = screenSocket->client(client)) c->binary((const char *)data, len);
+    }
+    void close(uint32_t client) override {
+        if (AsyncWebSocketClient *c = screenSocket->client(client)) c->close();
+    }
+    uint32_t logSeq() override { return tft.getLogSeq(); }
+    size_t logSince(uint32_t since, uint8_t *buf, size_t cap) override {
+        size_t size = 0;
+        tft.getBinLogSince(since, buf, size, cap);
+        return size;
+    }
+    uint32_t millis() override { return ::millis(); }
+};
+
+static void screenPushTaskFunc(void *pv) {
+    ScreenSocketLink link;
+    ScreenPushHub hub(link);
+    size_t bufSize = MAX_LOG_ENTRIES * MAX_LOG_SIZE;
+    uint8_t *buf = nullptr;
+    if (psramFound()) buf = static_cast<uint8_t *>(ps_malloc(bufSize));
+    if (!buf) buf = static_cast<uint8_t *>(malloc(bufSize));
+    if (!buf) log_e("screen push: failed to allocate %u bytes", (unsigned)bufSize);
+
+    while (screenPushRunning && buf) {
+        ScreenSocketEvent ev;
+        while (xQueueReceive(screenSocketEvents, &ev, 0)) {
+            if (ev.type == ScreenSocketEvent::CONNECT) hub.connect(ev.client);
+            else hub.disconnect(ev.client);
+        }
+        hub.tick(buf, bufSize);
+        screenSocket->cleanupClients();
+        vTaskDelay(pdMS_TO_TICKS(SCREEN_PUSH_TICK_MS));
+    }
+    if (buf) free(buf);
+    xSemaphoreGive(screenTaskExited);
+    vTaskDelete(NULL);
+}
+
+static void startScreenPush() {
+    if (!screenSocketEvents) {
+        screenSocketEvents = xQueueCreate(8, sizeof(ScreenSocketEvent));
+        screenNavEvents = xQueueCreate(8, sizeof(ScreenSocketEvent));
+        screenTaskExited = xSemaphoreCreateCounting(2, 0);
+    }
+    xQueueReset(screenSocketEvents);
+    xQueueReset(screenNavEvents);
+    screenSocket = new AsyncWebSocket("/ws/screen");
+    screenSocket->onEvent(onScreenSocketEvent);
+    server->addHandler(screenSocket);
+    screenPushRunning = true;
+    screenPushTask = screenNavTask = NULL;
+    xTaskCreate(screenPushTaskFunc, "screen_push", 4096, NULL, 1, &screenPushTask);
+    xTaskCreate(screenNavTaskFunc, "screen_nav", 2048, NULL, 1, &screenNavTask);
+}
+
+static void stopScreenPush() {
+    screenPushRunning = false;
+    // the push task uses the socket until it ends, the nav task lets go of a held button within 200ms
+    if (screenPushTask) xSemaphoreTake(screenTaskExited, portMAX_DELAY);
+    if (screenNavTask) xSemaphoreTake(screenTaskExited, portMAX_DELAY);
+    screenPushTask = screenNavTask = NULL;
+    if (screenSocket) screenSocket->closeAll();
+    screenSocket = nullptr; // owned by the server, freed with its handlers
+}
+
 /**********************************************************************
 **  Function: createDirRecursive
 ** Create folders recursivelly
@@ -473,7 +630,13 @@ void configureWebServer() {
             }
 
             size_t binSize = 0;
-            tft.getBinLog(screenBinBuffer, binSize);
+            // ?since=N: compact stream with only what was drawn after seq N, 0 asks for everything
+            if (request->hasArg("since")) {
+                uint32_t since = strtoul(request->arg("since").c_str(), nullptr, 10);
+                tft.getBinLogSince(since, screenBinBuffer, binSize, screenBinBufferSize);
+            } else {
+                tft.getBinLog(screenBinBuffer, binSize);
+            }
             if (binSize > screenBinBufferSize) {
                 request->send(500, "text/plain", "Screen buffer overflow");
                 return;
@@ -482,6 +645,8 @@ void configureWebServer() {
         }
     });
 
+    startScreenPush();
+
     // Rename file or folder
     server->on("/rename", HTTP_POST, [](AsyncWebServerRequest *request) {
         if (checkUserWebAuth(request)) {
@@ -511,25 +676,8 @@ void configureWebServer() {
         if (request->hasArg("cmnd")) {
             String cmnd = request->arg("cmnd");
             if (cmnd.startsWith("nav")) {
-                volatile bool *var = &SelPress;
-                if (cmnd.startsWith("nav sel")) var = &SelPress;
-                if (cmnd.startsWith("nav esc")) var = &EscPress;
-                if (cmnd.startsWith("nav up")) var = &UpPress;
-                if (cmnd.startsWith("nav down")) var = &DownPress;
-                if (cmnd.startsWith("nav next")) var = &NextPress;
-                if (cmnd.startsWith("nav prev")) var = &PrevPress;
                 request->send(200, "text/plain", "command " + cmnd + " success");
-                int time;
-                if (cmnd.endsWith("0")) time = cmnd.substring(cmnd.lastIndexOf(' ')).toInt();
-                else time = 10;
-                auto tmp = millis() + time;
-                while (tmp > millis()) {
-                    AnyKeyPress = true;
-                    SerialCmdPress = true;
-                    *var = true;
-                    if (!LongPress) vTaskDelay(pdMS_TO_TICKS(190));
-                    else vTaskDelay(pdMS_TO_TICKS(50));
-                }
+                holdNavButton(navCommandButton(cmnd), navCommandTime(cmnd));
             } else {
                 if (parseSerialCommand(cmnd, false)) {
                     request->send(200, "text/plain", "command " + cmnd + " queued");
@@ -552,10 +700,11 @@ void configureWebServer() {
         if (checkUserWebAuth(request)) {
             String folder = "/";
             if (request->hasArg("folder")) { folder = request->arg("folder"); }
+            bool json = request->arg("format") == "json";
             if (strcmp(request->arg("fs").c_str(), "SD") == 0) {
-                request->send(200, "text/plain", listFiles(SD, folder));
+                request->send(listFiles(request, SD, folder, json));
             } else {
-                request->send(200, "text/plain", listFiles(LittleFS, folder));
+                request->send(listFiles(request, LittleFS, folder, json));
             }
         }
     });
@@ -11,7 +11,7 @@ extern AsyncWebServer *server; // used to check if the webserver is running
 
 // function defaults
 String humanReadableSize(uint64_t bytes);
-String listFiles(FS &fs, String folder);
+AsyncWebServerResponse *listFiles(AsyncWebServerRequest *request, FS &fs, String folder, bool json);
 String readLineFromFile(File myFile);
 
 void loopOptionsWebUi();
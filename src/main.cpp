@@ -1,6 +1,7 @@
 #include "core/main_menu.h"
 #include <globals.h>
 
+#include "core/input_events.h"
 #include "core/powerSave.h"
 #include "core/serial_commands/cli.h"
 #include "core/utils.h"
@@ -83,7 +84,8 @@ void __attribute__((weak)) taskInputHandler(void *parameter) {
 #endif
             timer = millis();
         }
-        vTaskDelay(pdMS_TO_TICKS(10));
+        inputPoll();
+        inputTaskWait();
     }
 }
 // Public Globals Variables
@@ -470,6 +472,7 @@ void setup() {
 
     // #ifndef USE_TFT_eSPI_TOUCH
     // This task keeps running all the time, will never stop
+    inputBegin();
     xTaskCreate(
         taskInputHandler,              // Task function
         "InputHandler",                // Task Name
@@ -517,6 +520,8 @@ void loop() {
         vTaskDelete(serialcmdsTaskHandle); // stop serial commands while in interpreter
         vTaskDelay(pdMS_TO_TICKS(10));
         interpreter_state = 2;
+        // wake the timers of the script so runtime.main callbacks start now
+        if (interpreterTaskHandler != NULL) { xTaskNotifyGive(interpreterTaskHandler); }
         Serial.println("Entering interpreter...");
         while (interpreter_state > 0) { vTaskDelay(pdMS_TO_TICKS(500)); }
         Serial.println("Exiting interpreter...");
@@ -1,5 +1,6 @@
 #include "ducky_typer.h"
 #include "core/display.h"
+#include "core/file_line_reader.h"
 #include "core/mykeyboard.h"
 #include "core/sd_functions.h"
 #include "core/utils.h"
@@ -367,16 +368,21 @@ void key_input(FS fs, String bad_script, HIDInterface *_hid) {
 
     uint32_t startMillisBADUSBBLE = millis();
 
-    while (payloadFile.available()) {
+    char lineBuffer[512];
+    FileLineReader payloadReader(payloadFile, lineBuffer, sizeof(lineBuffer));
+    TextSlice lineSlice;
+    bool lineDone = true;
+    // the reader strips CRLF endings, a line longer than the buffer comes in pieces
+    while (payloadReader.next(lineSlice)) {
+        if (lineDone) lineContent = "";
+        lineContent.concat(lineSlice.data, lineSlice.len);
+        lineDone = !payloadReader.partial();
+        if (!lineDone) continue;
 
         previousMillis = millis(); // resets DimScreen
         if (check(SelPress)) {
             if (!handlePauseResume()) { goto EXIT; }
         }
-        // CRLF is a combination of two control characters: the "Carriage Return" represented by
-        // the character "\r" and the "Line Feed" represented by the character "\n".
-        lineContent = payloadFile.readStringUntil('\n');
-        if (lineContent.endsWith("\r")) lineContent.remove(lineContent.length() - 1);
 
         if (lineContent.length() == 0) continue; // skip empty lines
 
@@ -0,0 +1,60 @@
+#ifndef __BJS_BYTECODE_CACHE_H__
+#define __BJS_BYTECODE_CACHE_H__
+
+// Compiled scripts kept beside their source ("game.js" -> "game.jsc"), so a script is only parsed
+// the first time it runs. The file is this header followed by the mquickjs bytecode as written by
+// JS_PrepareBytecode (JSBytecodeHeader, then the data). It is used only when the source length and
+// hash and the interpreter build match; the build ID is the signature of the generated stdlib
+// (MQJS_STDLIB_SIGNATURE), which the bytecode refers to. mquickjs checks its own bytecode version.
+// Plain C, shared by the interpreter and the host precompiler (tools/bjs_precompile).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define BJS_CACHE_MAGIC "BJSC"
+#define BJS_CACHE_VERSION 1
+#define BJS_CACHE_SUFFIX "c"
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t buildId;
+    uint32_t sourceLen;
+    uint64_t sourceHash;
+    uint32_t bytecodeLen; // bytes after this header
+    uint32_t reserved;
+} BjsCacheHeader;
+
+// FNV-1a, 64 bit
+static inline uint64_t bjsCacheHash(const char *source, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)source[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static inline void bjsCacheFillHeader(
+    BjsCacheHeader *hdr, uint32_t buildId, const char *source, size_t len, uint32_t bytecodeLen
+) {
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, BJS_CACHE_MAGIC, 4);
+    hdr->version = BJS_CACHE_VERSION;
+    hdr->buildId = buildId;
+    hdr->sourceLen = (uint32_t)len;
+    hdr->sourceHash = bjsCacheHash(source, len);
+    hdr->bytecodeLen = bytecodeLen;
+}
+
+// fileSize is the size of the whole cache file
+static inline int bjsCacheMatches(
+    const BjsCacheHeader *hdr, size_t fileSize, uint32_t buildId, const char *source, size_t len
+) {
+    return memcmp(hdr->magic, BJS_CACHE_MAGIC, 4) == 0 && hdr->version == BJS_CACHE_VERSION &&
+           hdr->buildId == buildId && hdr->sourceLen == len && hdr->bytecodeLen &&
+           fileSize == sizeof(*hdr) + hdr->bytecodeLen && hdr->sourceHash == bjsCacheHash(source, len);
+}
+
+#endif
@@ -273,7 +273,7 @@ native_dialogCreateTextViewerGetVisibleText(JSContext *ctx, JSValue *this_val, i
     String visibleText;
     visibleText.reserve(area->getMaxVisibleTextLength());
     for (size_t i = area->firstVisibleLine; i < area->lastVisibleLine - 1; i++)
-        visibleText += area->linesBuffer[i];
+        visibleText += area->getLine(i);
     return JS_NewString(ctx, visibleText.c_str());
 }
 
@@ -2,9 +2,11 @@
 #include "display_js.h"
 
 #include "core/settings.h"
+#include "draw_batch.h"
 #include "helpers_js.h"
 #include "stdio.h"
 #include "user_classes_js.h"
+#include <vector>
 
 JSValue native_color(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
     int r = 0, g = 0, b = 0;
@@ -721,6 +723,61 @@ JSValue native_pushSprite(JSContext *ctx, JSValue *this_val, int argc, JSValue *
     return JS_UNDEFINED;
 }
 
+// Commands of the current batch, copied out of the script heap: reading strings may move it
+static std::vector<int32_t> batchCommands;
+
+template <class Target, class ResourceFn>
+static DrawBatchResult run_batch(Target *target, size_t len, ResourceFn resource) {
+    return runDrawBatch(*target, target->width(), target->height(), batchCommands.data(), len, resource);
+}
+
+JSValue native_drawBatch(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
+    if (argc < 1 || JS_GetClassID(ctx, argv[0]) != JS_CLASS_INT32_ARRAY) {
+        return JS_ThrowTypeError(ctx, "%s: Expected Int32Array of commands", "drawBatch");
+    }
+    size_t bytes = 0;
+    const int32_t *data = (const int32_t *)JS_GetTypedArrayBuffer(ctx, &bytes, argv[0]);
+    size_t len = data ? bytes / sizeof(int32_t) : 0;
+    if (argc > 1 && JS_IsNumber(ctx, argv[1])) {
+        int count = 0;
+        JS_ToInt32(ctx, &count, argv[1]);
+        if (count >= 0 && (size_t)count < len) len = count;
+    }
+    batchCommands.assign(data, data + len);
+
+    JSValue resources = argc > 2 ? argv[2] : JS_UNDEFINED;
+    JSCStringBuf sb;
+    auto resource = [&](int32_t index, DrawBatchResource &out) {
+        out.data = NULL;
+        out.len = 0;
+        if (index < 0 || !JS_IsObject(ctx, resources)) return false;
+        JSValue v = JS_GetPropertyUint32(ctx, resources, index);
+        if (JS_IsString(ctx, v)) {
+            out.data = (const uint8_t *)JS_ToCStringLen(ctx, &out.len, v, &sb);
+        } else if (JS_IsTypedArray(ctx, v)) {
+            out.data = (const uint8_t *)JS_GetTypedArrayBuffer(ctx, &out.len, v);
+        }
+        return out.data != NULL;
+    };
+
+#if defined(HAS_SCREEN)
+    DisplayTarget target = get_display_target(ctx, this_val);
+    DrawBatchResult res = target.isSprite ? run_batch(target.sprite, len, resource)
+                                          : run_batch(target.display, len, resource);
+#else
+    DrawBatchResult res = run_batch(get_display(ctx, this_val), len, resource);
+#endif
+    if (res.error) return JS_ThrowTypeError(ctx, "drawBatch: %s at %ld", res.error, res.errorAt);
+    if (res.dirty.empty()) return JS_NULL;
+
+    JSValue obj = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, obj, "x", JS_NewInt32(ctx, res.dirty.x));
+    JS_SetPropertyStr(ctx, obj, "y", JS_NewInt32(ctx, res.dirty.y));
+    JS_SetPropertyStr(ctx, obj, "width", JS_NewInt32(ctx, res.dirty.w));
+    JS_SetPropertyStr(ctx, obj, "height", JS_NewInt32(ctx, res.dirty.h));
+    return obj;
+}
+
 JSValue native_createSprite(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
 #if defined(HAS_SCREEN)
     int16_t width = tft.width();
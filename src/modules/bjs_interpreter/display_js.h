@@ -47,6 +47,7 @@ JSValue native_gifOpen(JSContext *ctx, JSValue *this_val, int argc, JSValue *arg
 JSValue native_deleteSprite(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv);
 JSValue native_pushSprite(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv);
 JSValue native_createSprite(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv);
+JSValue native_drawBatch(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv);
 
 JSValue native_getRotation(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv);
 JSValue native_getBrightness(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv);
@@ -0,0 +1,229 @@
+#ifndef __DRAW_BATCH_H__
+#define __DRAW_BATCH_H__
+
+// Drawing commands recorded by a script in an Int32Array and run with one native call per frame
+// (display.drawBatch / sprite.drawBatch), instead of one call per primitive.
+// Each command is its opcode followed by a fixed number of arguments (drawBatchArgs). Text and
+// bitmaps refer by index to an array of strings / byte arrays given along with the commands.
+// A CLIP command limits the following ones to a rectangle: fills and lines along an axis are cut to
+// it, other shapes are skipped when they are entirely outside and otherwise drawn whole, clipped by
+// the display only. The result holds the area the batch drew on, clip or not, so a script can
+// redraw only that.
+// Text extents are estimated for the built-in font from the size and alignment set in the batch.
+// No Arduino dependencies, the target is any display or sprite class, so it can be benchmarked on
+// the host against a framebuffer.
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum DrawBatchOp {
+    DRAW_BATCH_FILL = 1,         // color
+    DRAW_BATCH_PIXEL,            // x, y, color
+    DRAW_BATCH_LINE,             // x0, y0, x1, y1, color
+    DRAW_BATCH_HLINE,            // x, y, w, color
+    DRAW_BATCH_VLINE,            // x, y, h, color
+    DRAW_BATCH_RECT,             // x, y, w, h, color
+    DRAW_BATCH_FILL_RECT,        // x, y, w, h, color
+    DRAW_BATCH_ROUND_RECT,       // x, y, w, h, r, color
+    DRAW_BATCH_FILL_ROUND_RECT,  // x, y, w, h, r, color
+    DRAW_BATCH_CIRCLE,           // x, y, r, color
+    DRAW_BATCH_FILL_CIRCLE,      // x, y, r, color
+    DRAW_BATCH_FILL_TRIANGLE,    // x0, y0, x1, y1, x2, y2, color
+    DRAW_BATCH_XBITMAP,          // x, y, w, h, color, bg (-1: transparent), bitmap index
+    DRAW_BATCH_TEXT_COLOR,       // color, bg (-1: transparent)
+    DRAW_BATCH_TEXT_SIZE,        // size
+    DRAW_BATCH_TEXT_ALIGN,       // align (0 left, 1 center, 2 right), baseline (0 top ... 3 alphabetic)
+    DRAW_BATCH_TEXT,             // x, y, string index
+    DRAW_BATCH_CLIP,             // x, y, w, h; w or h <= 0 removes the clip
+    DRAW_BATCH_OP_COUNT
+};
+
+static inline int drawBatchArgs(int32_t op) {
+    static const uint8_t args[] = {0, 1, 3, 5, 4, 4, 5, 5, 6, 6, 4, 4, 7, 7, 2, 1, 2, 3, 4};
+    return op > 0 && op < DRAW_BATCH_OP_COUNT ? args[op] : -1;
+}
+
+struct DrawBatchRect {
+    int32_t x, y, w, h;
+
+    bool empty() const { return w <= 0 || h <= 0; }
+    DrawBatchRect intersect(const DrawBatchRect &o) const {
+        int32_t x0 = x > o.x ? x : o.x, y0 = y > o.y ? y : o.y;
+        int32_t x1 = x + w < o.x + o.w ? x + w : o.x + o.w;
+        int32_t y1 = y + h < o.y + o.h ? y + h : o.y + o.h;
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+    void add(const DrawBatchRect &o) {
+        if (o.empty()) return;
+        if (empty()) {
+            *this = o;
+            return;
+        }
+        int32_t x1 = x + w > o.x + o.w ? x + w : o.x + o.w;
+        int32_t y1 = y + h > o.y + o.h ? y + h : o.y + o.h;
+        x = x < o.x ? x : o.x;
+        y = y < o.y ? y : o.y;
+        w = x1 - x;
+        h = y1 - y;
+    }
+};
+
+struct DrawBatchResource {
+    const uint8_t *data;
+    size_t len;
+};
+
+struct DrawBatchResult {
+    size_t drawn;        // commands that reached the target
+    size_t culled;       // commands entirely outside the clip
+    DrawBatchRect dirty; // bounds of what was drawn, empty if nothing
+    long errorAt;        // offset of the first bad command, -1 if none
+    const char *error;
+};
+
+// Runs cmds[0..len) on target, which is width x height. resource(index, out) fills out and returns
+// true for a valid string (NUL terminated) or bitmap; it is called right before the item is drawn.
+// Stops at the first bad command, everything before it is drawn.
+template <class Target, class ResourceFn>
+DrawBatchResult runDrawBatch(
+    Target &target, int32_t width, int32_t height, const int32_t *cmds, size_t len, ResourceFn resource
+) {
+    DrawBatchResult res = {0, 0, {0, 0, 0, 0}, -1, nullptr};
+    const DrawBatchRect screen = {0, 0, width, height};
+    DrawBatchRect clip = screen;
+    int32_t textSize = 1, align = 0, baseline = 0;
+
+    size_t i = 0;
+    while (i < len) {
+        const int32_t op = cmds[i];
+        const int n = drawBatchArgs(op);
+        if (n < 0 || i + 1 + n > len) {
+            res.errorAt = (long)i;
+            res.error = n < 0 ? "unknown command" : "truncated command";
+            return res;
+        }
+        const int32_t *a = cmds + i + 1;
+        i += 1 + n;
+
+        DrawBatchRect box = {0, 0, 0, 0};
+        switch (op) {
+            case DRAW_BATCH_TEXT_COLOR:
+                if (a[1] >= 0) target.setTextColor(a[0], a[1]);
+                else target.setTextColor(a[0]);
+                continue;
+            case DRAW_BATCH_TEXT_SIZE:
+                textSize = a[0] > 0 ? a[0] : 1;
+                target.setTextSize(textSize);
+                continue;
+            case DRAW_BATCH_TEXT_ALIGN:
+                align = a[0];
+                baseline = a[1];
+                target.setTextDatum(align + baseline * 3);
+                continue;
+            case DRAW_BATCH_CLIP:
+                clip = a[2] > 0 && a[3] > 0 ? screen.intersect({a[0], a[1], a[2], a[3]}) : screen;
+                continue;
+
+            // Fills are cut to the clip exactly
+            case DRAW_BATCH_FILL:
+            case DRAW_BATCH_FILL_RECT:
+            case DRAW_BATCH_HLINE:
+            case DRAW_BATCH_VLINE:
+            case DRAW_BATCH_PIXEL: {
+                int32_t color = a[n - 1];
+                if (op == DRAW_BATCH_FILL) box = screen;
+                else if (op == DRAW_BATCH_FILL_RECT) box = {a[0], a[1], a[2], a[3]};
+                else if (op == DRAW_BATCH_HLINE) box = {a[0], a[1], a[2], 1};
+                else if (op == DRAW_BATCH_VLINE) box = {a[0], a[1], 1, a[2]};
+                else box = {a[0], a[1], 1, 1};
+                box = box.intersect(clip);
+                if (box.empty()) {
+                    res.culled++;
+                    continue;
+                }
+                if (op == DRAW_BATCH_FILL && box.w == width && box.h == height) target.fillScreen(color);
+                else if (op == DRAW_BATCH_PIXEL) target.drawPixel(box.x, box.y, color);
+                else if (op == DRAW_BATCH_VLINE) target.drawFastVLine(box.x, box.y, box.h, color);
+                else target.fillRect(box.x, box.y, box.w, box.h, color);
+                res.drawn++;
+                res.dirty.add(box);
+                continue;
+            }
+
+            case DRAW_BATCH_LINE:
+            case DRAW_BATCH_FILL_TRIANGLE: {
+                int points = op == DRAW_BATCH_LINE ? 2 : 3;
+                int32_t x0 = a[0], y0 = a[1], x1 = a[0], y1 = a[1];
+                for (int p = 1; p < points; p++) {
+                    if (a[2 * p] < x0) x0 = a[2 * p];
+                    if (a[2 * p] > x1) x1 = a[2 * p];
+                    if (a[2 * p + 1] < y0) y0 = a[2 * p + 1];
+                    if (a[2 * p + 1] > y1) y1 = a[2 * p + 1];
+                }
+                box = {x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+                break;
+            }
+            case DRAW_BATCH_RECT:
+            case DRAW_BATCH_ROUND_RECT:
+            case DRAW_BATCH_FILL_ROUND_RECT:
+            case DRAW_BATCH_XBITMAP: box = {a[0], a[1], a[2], a[3]}; break;
+            case DRAW_BATCH_CIRCLE:
+            case DRAW_BATCH_FILL_CIRCLE: box = {a[0] - a[2], a[1] - a[2], 2 * a[2] + 1, 2 * a[2] + 1}; break;
+            case DRAW_BATCH_TEXT: {
+                DrawBatchResource str;
+                if (!resource(a[2], str) || !str.data) {
+                    res.errorAt = (long)(i - 1 - n);
+                    res.error = "text is not a string";
+                    return res;
+                }
+                // built-in font: 6x8 pixels per character at size 1
+                int32_t tw = (int32_t)str.len * 6 * textSize, th = 8 * textSize;
+                int32_t bl = baseline > 2 ? 2 : baseline;
+                box = {a[0] - tw * align / 2, a[1] - th * bl / 2, tw, th};
+                if (box.intersect(clip).empty()) {
+                    res.culled++;
+                    continue;
+                }
+                box = box.intersect(screen);
+                target.drawString((const char *)str.data, a[0], a[1]);
+                res.drawn++;
+                res.dirty.add(box);
+                continue;
+            }
+        }
+
+        if (box.intersect(clip).empty()) {
+            res.culled++;
+            continue;
+        }
+        box = box.intersect(screen); // drawn whole, partly outside the clip or not
+        switch (op) {
+            case DRAW_BATCH_LINE: target.drawLine(a[0], a[1], a[2], a[3], a[4]); break;
+            case DRAW_BATCH_FILL_TRIANGLE:
+                target.fillTriangle(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+                break;
+            case DRAW_BATCH_RECT: target.drawRect(a[0], a[1], a[2], a[3], a[4]); break;
+            case DRAW_BATCH_ROUND_RECT: target.drawRoundRect(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+            case DRAW_BATCH_FILL_ROUND_RECT: target.fillRoundRect(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+            case DRAW_BATCH_CIRCLE: target.drawCircle(a[0], a[1], a[2], a[3]); break;
+            case DRAW_BATCH_FILL_CIRCLE: target.fillCircle(a[0], a[1], a[2], a[3]); break;
+            case DRAW_BATCH_XBITMAP: {
+                DrawBatchResource bmp;
+                if (!resource(a[6], bmp) || !bmp.data || bmp.len != (size_t)((a[2] + 7) / 8) * a[3]) {
+                    res.errorAt = (long)(i - 1 - n);
+                    res.error = "bitmap size mismatch";
+                    return res;
+                }
+                uint8_t *bits = (uint8_t *)bmp.data;
+                if (a[5] >= 0) target.drawXBitmap(a[0], a[1], bits, a[2], a[3], a[4], a[5]);
+                else target.drawXBitmap(a[0], a[1], bits, a[2], a[3], a[4]);
+                break;
+            }
+        }
+        res.drawn++;
+        res.dirty.add(box);
+    }
+    return res;
+}
+
+#endif
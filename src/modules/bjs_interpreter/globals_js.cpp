@@ -1,7 +1,10 @@
 #if !defined(LITE_VERSION) && !defined(DISABLE_INTERPRETER)
 #include "globals_js.h"
+#include "timer_queue.h"
 #include "user_classes_js.h"
 #include <chrono>
+#include <deque>
+#include <new>
 
 JSValue js_gc(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
     JS_GC(ctx);
@@ -24,20 +27,12 @@ JSValue js_load(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
 }
 
 /* timers */
-typedef struct {
-    bool allocated;
-    JSGCRef func;
-    int64_t timeout;     /* next due time in ms */
-    int32_t interval_ms; /* period for intervals */
-    bool repeat;
-    bool main;
-} JSTimer;
-
-#define MAX_TIMERS 16
-
-typedef struct {
-    JSTimer timers[MAX_TIMERS];
-} JSTimerContextState;
+// Deadlines in a TimerQueue, the callbacks by timer id. JS_AddGCRef links the ref by its address,
+// the deque keeps them in place as it grows.
+struct JSTimerContextState {
+    TimerQueue queue;
+    std::deque<JSGCRef> funcs;
+};
 
 static const char *kTimersStateProp = "__bruce_timers_state";
 
@@ -52,7 +47,7 @@ static JSTimerContextState *get_timer_state(JSContext *ctx, bool create) {
 
     if (!create) return NULL;
 
-    JSTimerContextState *state = (JSTimerContextState *)calloc(1, sizeof(JSTimerContextState));
+    JSTimerContextState *state = new (std::nothrow) JSTimerContextState();
     if (!state) return NULL;
 
     if (!JS_IsObject(ctx, holder)) { holder = JS_NewObjectClassUser(ctx, JS_CLASS_TIMERS_STATE); }
@@ -61,16 +56,17 @@ static JSTimerContextState *get_timer_state(JSContext *ctx, bool create) {
     return state;
 }
 
+static void free_timer_state(JSContext *ctx, JSTimerContextState *state) {
+    for (size_t i = 0; i < state->queue.slots(); i++) {
+        if (state->queue.active(i)) JS_DeleteGCRef(ctx, &state->funcs[i]);
+    }
+    delete state;
+}
+
 void native_timers_state_finalizer(JSContext *ctx, void *opaque) {
     JSTimerContextState *state = (JSTimerContextState *)opaque;
     if (!state) return;
-    for (int i = 0; i < MAX_TIMERS; i++) {
-        if (state->timers[i].allocated) {
-            JS_DeleteGCRef(ctx, &state->timers[i].func);
-            state->timers[i].allocated = false;
-        }
-    }
-    free(state);
+    free_timer_state(ctx, state);
 }
 
 void js_timers_init(JSContext *ctx) { (void)get_timer_state(ctx, true); }
@@ -83,115 +79,58 @@ void js_timers_deinit(JSContext *ctx) {
     JSTimerContextState *state = (JSTimerContextState *)JS_GetOpaque(ctx, holder);
     if (!state) return;
 
-    for (int i = 0; i < MAX_TIMERS; i++) {
-        if (state->timers[i].allocated) {
-            JS_DeleteGCRef(ctx, &state->timers[i].func);
-            state->timers[i].allocated = false;
-        }
-    }
-
     JS_SetOpaque(ctx, holder, NULL);
-    free(state);
+    free_timer_state(ctx, state);
 
     JS_SetPropertyStr(ctx, global, kTimersStateProp, JS_UNDEFINED);
 }
 
-int js_add_main_timer(JSContext *ctx, JSValue func) {
-    JSTimer *th;
-    int i;
-    JSValue *pfunc;
-
-    if (!JS_IsFunction(ctx, func)) return -1;
-
+static int add_timer(JSContext *ctx, JSValue func, int32_t delayMs, bool repeat, bool main) {
     JSTimerContextState *state = get_timer_state(ctx, true);
     if (!state) return -1;
 
-    for (i = 0; i < MAX_TIMERS; i++) {
-        th = &state->timers[i];
-        if (!th->allocated) {
-            pfunc = JS_AddGCRef(ctx, &th->func);
-            *pfunc = func;
-            th->timeout = millis();
-            th->interval_ms = 0;
-            th->repeat = false;
-            th->main = true;
-            th->allocated = true;
-            return i;
-        }
-    }
+    int id = state->queue.add((int64_t)millis() + delayMs, delayMs, repeat, main);
+    if ((size_t)id >= state->funcs.size()) state->funcs.emplace_back();
+    JSValue *pfunc = JS_AddGCRef(ctx, &state->funcs[id]);
+    *pfunc = func;
+    return id;
+}
 
-    return -1;
+int js_add_main_timer(JSContext *ctx, JSValue func) {
+    if (!JS_IsFunction(ctx, func)) return -1;
+    return add_timer(ctx, func, 0, false, true);
 }
 
 JSValue js_setTimeout(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
-    JSTimer *th;
-    int delay, i;
-    JSValue *pfunc;
+    int delay;
 
     if (!JS_IsFunction(ctx, argv[0])) return JS_ThrowTypeError(ctx, "not a function");
     if (JS_ToInt32(ctx, &delay, argv[1])) return JS_EXCEPTION;
 
-    JSTimerContextState *state = get_timer_state(ctx, true);
-    if (!state) return JS_ThrowInternalError(ctx, "out of memory");
-
-    for (i = 0; i < MAX_TIMERS; i++) {
-        th = &state->timers[i];
-        if (!th->allocated) {
-            pfunc = JS_AddGCRef(ctx, &th->func);
-            *pfunc = argv[0];
-            th->timeout = millis() + delay;
-            th->interval_ms = 0;
-            th->repeat = false;
-            th->main = false;
-            th->allocated = true;
-            return JS_NewInt32(ctx, i);
-        }
-    }
-    return JS_ThrowInternalError(ctx, "too many timers");
+    int id = add_timer(ctx, argv[0], delay, false, false);
+    if (id < 0) return JS_ThrowInternalError(ctx, "out of memory");
+    return JS_NewInt32(ctx, id);
 }
 
 JSValue js_setInterval(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
-    JSTimer *th;
-    int delay, i;
-    JSValue *pfunc;
+    int delay;
 
     if (!JS_IsFunction(ctx, argv[0])) return JS_ThrowTypeError(ctx, "not a function");
     if (JS_ToInt32(ctx, &delay, argv[1])) return JS_EXCEPTION;
 
-    JSTimerContextState *state = get_timer_state(ctx, true);
-    if (!state) return JS_ThrowInternalError(ctx, "out of memory");
-
-    for (i = 0; i < MAX_TIMERS; i++) {
-        th = &state->timers[i];
-        if (!th->allocated) {
-            pfunc = JS_AddGCRef(ctx, &th->func);
-            *pfunc = argv[0];
-            th->timeout = millis() + delay;
-            th->interval_ms = delay;
-            th->repeat = true;
-            th->main = false;
-            th->allocated = true;
-            return JS_NewInt32(ctx, i);
-        }
-    }
-    return JS_ThrowInternalError(ctx, "too many timers");
+    int id = add_timer(ctx, argv[0], delay, true, false);
+    if (id < 0) return JS_ThrowInternalError(ctx, "out of memory");
+    return JS_NewInt32(ctx, id);
 }
 
 JSValue js_clearTimeout(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
     int timer_id;
-    JSTimer *th;
 
     if (JS_ToInt32(ctx, &timer_id, argv[0])) return JS_EXCEPTION;
-    if (timer_id >= 0 && timer_id < MAX_TIMERS) {
-        JSTimerContextState *state = get_timer_state(ctx, false);
-        if (!state) return JS_UNDEFINED;
-
-        th = &state->timers[timer_id];
-        if (th->allocated) {
-            JS_DeleteGCRef(ctx, &th->func);
-            th->allocated = false;
-        }
-    }
+    JSTimerContextState *state = get_timer_state(ctx, false);
+    if (!state) return JS_UNDEFINED;
+
+    if (state->queue.remove(timer_id)) JS_DeleteGCRef(ctx, &state->funcs[timer_id]);
     return JS_UNDEFINED;
 }
 
@@ -199,66 +138,50 @@ JSValue js_clearInterval(JSContext *ctx, JSValue *this_val, int argc, JSValue *a
     return js_clearTimeout(ctx, this_val, argc, argv);
 }
 
+// Fires due timers until none is left. Between them the task sleeps until the next deadline, at most
+// a second; main.cpp notifies it when the script comes to the foreground so main timers run at once.
 void run_timers(JSContext *ctx) {
-    int64_t min_delay;
-    int64_t delayMs;
-    int64_t cur_time;
-    bool has_timer;
-    int i;
-    JSTimer *th;
-    struct timespec ts;
-
     JSTimerContextState *state = get_timer_state(ctx, false);
     if (!state) return;
 
     while (true) {
-        min_delay = 1000;
-        cur_time = millis();
-        has_timer = false;
-        for (i = 0; i < MAX_TIMERS; i++) {
-            th = &state->timers[i];
-            if (th->allocated) {
-                if (th->main && interpreter_state != 2) { continue; }
-                if (th->main && interpreter_state == 2) { interpreter_state = 3; }
-                has_timer = true;
-                delayMs = th->timeout - cur_time;
-                if (delayMs <= 0) {
-                    JSValue ret;
-                    /* the timer expired */
-                    if (JS_StackCheck(ctx, 2)) goto fail;
-                    JS_PushArg(ctx, th->func.val); /* func name */
-                    JS_PushArg(ctx, JS_NULL);      /* this */
-
-                    if (!th->repeat && !th->main) {
-                        JS_DeleteGCRef(ctx, &th->func);
-                        th->allocated = false;
-                    } else {
-                        // Reschedule before calling so callbacks can clearInterval safely.
-                        // Keep cadence by advancing from the previous due time.
-                        th->timeout = th->timeout + (int64_t)th->interval_ms;
-                    }
-
-                    ret = JS_Call(ctx, 0);
-                    if (JS_IsException(ret)) {
-                    fail:
-                        log_e("Error in run_timers");
-                        JSValue obj = JS_GetException(ctx);
-                        JS_PrintValueF(ctx, obj, JS_DUMP_LONG);
-                        return;
-                    }
-
-                    if (th->main) { interpreter_state = 0; }
-
-                    // If interval callback threw, state may still be allocated; keep going.
-                    min_delay = 0;
-                    break;
-                } else if (delayMs < min_delay) {
-                    min_delay = delayMs;
-                }
+        int id = -1;
+        bool freed = false;
+        bool main = interpreter_state == 2 && !state->queue.mains().empty();
+        if (main) {
+            id = state->queue.mains().front();
+            interpreter_state = 3;
+        } else {
+            id = state->queue.takeDue(millis(), freed);
+        }
+
+        if (id >= 0) {
+            JSValue ret;
+            if (JS_StackCheck(ctx, 2)) goto fail;
+            JS_PushArg(ctx, state->funcs[id].val); /* func name */
+            JS_PushArg(ctx, JS_NULL);              /* this */
+
+            // Intervals are already rescheduled, callbacks can clear themselves safely
+            if (freed) JS_DeleteGCRef(ctx, &state->funcs[id]);
+
+            ret = JS_Call(ctx, 0);
+            if (JS_IsException(ret)) {
+            fail:
+                log_e("Error in run_timers");
+                JSValue obj = JS_GetException(ctx);
+                JS_PrintValueF(ctx, obj, JS_DUMP_LONG);
+                return;
             }
+
+            if (main) { interpreter_state = 0; }
+            continue;
         }
-        if (!has_timer) break;
-        if (min_delay > 0) { delay(min_delay); }
+
+        int next = state->queue.next();
+        if (next < 0) break;
+        int64_t wait = state->queue.due(next) - (int64_t)millis();
+        if (wait > 1000) wait = 1000;
+        if (wait > 0) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
     }
 }
 
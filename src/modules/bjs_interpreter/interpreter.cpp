@@ -8,15 +8,79 @@ extern "C" {
 #include "mqjs_stdlib.h"
 }
 
+#include "bytecode_cache.h"
 #include "display_js.h"
 #include "globals_js.h"
 
 char *script = NULL;
 char *scriptDirpath = NULL;
 char *scriptName = NULL;
+FS *scriptFs = NULL; // where the bytecode cache goes, NULL for scripts not read from a file
 
 TaskHandle_t interpreterTaskHandler = NULL;
 
+static String bytecodeCachePath() { return String(scriptDirpath) + "/" + scriptName + BJS_CACHE_SUFFIX; }
+
+// Bytecode of the script from its cache file, NULL if there is none or it does not match the script
+static uint8_t *loadCachedBytecode(const char *source, size_t sourceLen, size_t *bytecodeLen) {
+    File file = scriptFs->open(bytecodeCachePath(), FILE_READ);
+    if (!file) return NULL;
+
+    BjsCacheHeader hdr;
+    uint8_t *bytecode = NULL;
+    if (file.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+        bjsCacheMatches(&hdr, file.size(), MQJS_STDLIB_SIGNATURE, source, sourceLen)) {
+        bytecode = (uint8_t *)(psramFound() ? ps_malloc(hdr.bytecodeLen) : malloc(hdr.bytecodeLen));
+        if (bytecode && (file.read(bytecode, hdr.bytecodeLen) != hdr.bytecodeLen ||
+                         !JS_IsBytecode(bytecode, hdr.bytecodeLen))) {
+            free(bytecode);
+            bytecode = NULL;
+        }
+        *bytecodeLen = hdr.bytecodeLen;
+    }
+    file.close();
+    return bytecode;
+}
+
+// Compiles the script in a context of its own and saves the bytecode beside it. NULL when it does
+// not compile, running the source then reports the error as usual.
+static uint8_t *compileToCache(const char *source, size_t sourceLen, size_t memSize, size_t *bytecodeLen) {
+    uint8_t *mem = (uint8_t *)(psramFound() ? ps_malloc(memSize) : malloc(memSize));
+    if (!mem) return NULL;
+    JSContext *ctx = JS_NewContext(mem, memSize, &js_stdlib);
+    JS_SetLogFunc(ctx, js_log_func);
+
+    uint8_t *bytecode = NULL;
+    JSValue code = JS_Parse(ctx, source, sourceLen, scriptName, 0);
+    if (!JS_IsException(code)) {
+        JSBytecodeHeader hdr;
+        const uint8_t *data;
+        uint32_t dataLen;
+        JS_PrepareBytecode(ctx, &hdr, &data, &dataLen, code);
+
+        *bytecodeLen = sizeof(hdr) + dataLen;
+        bytecode = (uint8_t *)(psramFound() ? ps_malloc(*bytecodeLen) : malloc(*bytecodeLen));
+        if (bytecode) {
+            memcpy(bytecode, &hdr, sizeof(hdr));
+            memcpy(bytecode + sizeof(hdr), data, dataLen);
+        }
+    }
+    JS_FreeContext(ctx);
+    free(mem);
+    if (!bytecode) return NULL;
+
+    BjsCacheHeader cacheHdr;
+    bjsCacheFillHeader(&cacheHdr, MQJS_STDLIB_SIGNATURE, source, sourceLen, *bytecodeLen);
+    File file = scriptFs->open(bytecodeCachePath(), FILE_WRITE);
+    if (file) {
+        bool saved = file.write((uint8_t *)&cacheHdr, sizeof(cacheHdr)) == sizeof(cacheHdr) &&
+                     file.write(bytecode, *bytecodeLen) == *bytecodeLen;
+        file.close();
+        if (!saved) scriptFs->remove(bytecodeCachePath()); // full card, do not leave half a cache
+    }
+    return bytecode;
+}
+
 void interpreterHandler(void *pvParameters) {
     printMemoryUsage("init interpreter");
     if (script == NULL) { return; }
@@ -30,6 +94,17 @@ void interpreterHandler(void *pvParameters) {
     bool psramAvailable = psramFound();
 
     size_t mem_size = psramAvailable ? 65536 : 32768;
+    size_t scriptSize = strlen(script);
+    log_d("Script length: %zu\n", scriptSize);
+
+    // Compiled before the context below is created, the two never need memory at the same time
+    size_t bytecodeLen = 0;
+    uint8_t *bytecode = NULL;
+    if (scriptFs) {
+        bytecode = loadCachedBytecode(script, scriptSize, &bytecodeLen);
+        if (!bytecode) bytecode = compileToCache(script, scriptSize, mem_size, &bytecodeLen);
+    }
+
     uint8_t *mem_buf = psramAvailable ? (uint8_t *)ps_malloc(mem_size) : (uint8_t *)malloc(mem_size);
     JSContext *ctx = JS_NewContext(mem_buf, mem_size, &js_stdlib);
     JS_SetLogFunc(ctx, js_log_func);
@@ -58,10 +133,13 @@ void interpreterHandler(void *pvParameters) {
 
     printMemoryUsage("context created");
 
-    size_t scriptSize = strlen(script);
-    log_d("Script length: %zu\n", scriptSize);
-
-    JSValue val = JS_Eval(ctx, (const char *)script, scriptSize, scriptName, 0);
+    JSValue val;
+    // the bytecode runs in place, it is freed with the context
+    if (bytecode && JS_RelocateBytecode(ctx, bytecode, bytecodeLen) == 0) {
+        val = JS_Run(ctx, JS_LoadBytecode(ctx, bytecode));
+    } else {
+        val = JS_Eval(ctx, (const char *)script, scriptSize, scriptName, 0);
+    }
 
     run_timers(ctx);
 
@@ -75,10 +153,13 @@ void interpreterHandler(void *pvParameters) {
     scriptDirpath = NULL;
     free((char *)scriptName);
     scriptName = NULL;
+    delete scriptFs;
+    scriptFs = NULL;
 
     js_timers_deinit(ctx);
     JS_FreeContext(ctx);
     free(mem_buf);
+    free(bytecode);
 
     printMemoryUsage("deinit interpreter");
 
@@ -129,6 +210,7 @@ bool run_bjs_script_headless(char *code) {
     if (script == NULL) { return false; }
     scriptDirpath = strdup("/scripts");
     scriptName = strdup("index.js");
+    scriptFs = NULL;
 
     returnToMenu = true;
     interpreter_state = 1;
@@ -143,6 +225,7 @@ bool run_bjs_script_headless(FS fs, String filename) {
     int slash = filename.lastIndexOf('/');
     scriptName = strdup(filename.c_str() + slash + 1);
     scriptDirpath = strndup(filename.c_str(), slash);
+    scriptFs = new FS(fs);
     returnToMenu = true;
     interpreter_state = 1;
     startInterpreterTask();
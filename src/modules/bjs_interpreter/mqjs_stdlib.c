@@ -567,6 +567,26 @@ static const JSPropDef js_display[] = {
     JS_CFUNC_DEF("width", 0, native_width),
     JS_CFUNC_DEF("height", 0, native_height),
     JS_CFUNC_DEF("createSprite", 2, native_createSprite),
+    JS_CFUNC_DEF("drawBatch", 3, native_drawBatch),
+    /* opcodes of drawBatch, see draw_batch.h */
+    JS_PROP_DOUBLE_DEF("BATCH_FILL", 1, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_PIXEL", 2, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_LINE", 3, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_HLINE", 4, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_VLINE", 5, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_RECT", 6, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_FILL_RECT", 7, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_ROUND_RECT", 8, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_FILL_ROUND_RECT", 9, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_CIRCLE", 10, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_FILL_CIRCLE", 11, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_FILL_TRIANGLE", 12, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_XBITMAP", 13, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_TEXT_COLOR", 14, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_TEXT_SIZE", 15, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_TEXT_ALIGN", 16, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_TEXT", 17, 0 ),
+    JS_PROP_DOUBLE_DEF("BATCH_CLIP", 18, 0 ),
     JS_CFUNC_DEF("getRotation", 0, native_getRotation),
     JS_CFUNC_DEF("getBrightness", 0, native_getBrightness),
     JS_CFUNC_DEF("setBrightness", 2, native_setBrightness),
@@ -624,6 +644,7 @@ static const JSPropDef js_sprite_proto[] = {
     JS_CFUNC_DEF("getBrightness", 0, native_getBrightness),
     JS_CFUNC_DEF("setBrightness", 2, native_setBrightness),
     JS_CFUNC_DEF("restoreBrightness", 0, native_restoreBrightness),
+    JS_CFUNC_DEF("drawBatch", 3, native_drawBatch),
     JS_CFUNC_DEF("pushSprite", 0, native_pushSprite),
     JS_CFUNC_DEF("deleteSprite", 0, native_deleteSprite),
     JS_PROP_END,
@@ -18,6 +18,8 @@
 #include "subghz_js.h"
 #include "wifi_js.h"
 
+#define MQJS_STDLIB_SIGNATURE 0x1f7994c8u
+
 /* this file is automatically generated - do not edit */
 
 #include "mquickjs_priv.h"
@@ -0,0 +1,106 @@
+#include "timer_queue.h"
+#include <algorithm>
+
+int TimerQueue::add(int64_t due, int32_t interval, bool repeat, bool main) {
+    int id;
+    if (_free.empty()) {
+        id = _timers.size();
+        _timers.push_back({});
+    } else {
+        id = _free.top();
+        _free.pop();
+    }
+
+    Timer &t = _timers[id];
+    t.due = due;
+    t.seq = _seq++;
+    t.interval = interval;
+    t.repeat = repeat;
+    t.main = main;
+    t.active = true;
+    if (main) {
+        _mains.push_back(id);
+    } else {
+        _heap.push_back(id);
+        siftUp(_heap.size() - 1);
+    }
+    return id;
+}
+
+bool TimerQueue::remove(int id) {
+    if (!active(id)) return false;
+    if (_timers[id].main) _mains.erase(std::find(_mains.begin(), _mains.end(), id));
+    else removeAt(_timers[id].pos);
+    release(id);
+    return true;
+}
+
+int TimerQueue::takeDue(int64_t now, bool &freed) {
+    if (_heap.empty()) return -1;
+    int id = _heap[0];
+    Timer &t = _timers[id];
+    if (t.due > now) return -1;
+
+    freed = !t.repeat;
+    if (freed) {
+        removeAt(0);
+        release(id);
+        return id;
+    }
+    int64_t next = t.due + t.interval;
+    if (next <= now && t.interval > 0) next += ((now - next) / t.interval + 1) * t.interval;
+    t.due = next;
+    t.seq = _seq++; // an interval of 0 goes behind whatever else is due
+    siftDown(0);
+    return id;
+}
+
+bool TimerQueue::before(int a, int b) const {
+    const Timer &ta = _timers[a], &tb = _timers[b];
+    // seq wraps after 2^32 schedules, compared as a difference
+    return ta.due != tb.due ? ta.due < tb.due : (int32_t)(ta.seq - tb.seq) < 0;
+}
+
+void TimerQueue::place(size_t pos, int id) {
+    _heap[pos] = id;
+    _timers[id].pos = pos;
+}
+
+void TimerQueue::siftUp(size_t pos) {
+    int id = _heap[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!before(id, _heap[parent])) break;
+        place(pos, _heap[parent]);
+        pos = parent;
+    }
+    place(pos, id);
+}
+
+void TimerQueue::siftDown(size_t pos) {
+    int id = _heap[pos];
+    size_t n = _heap.size();
+    while (true) {
+        size_t child = 2 * pos + 1;
+        if (child >= n) break;
+        if (child + 1 < n && before(_heap[child + 1], _heap[child])) child++;
+        if (!before(_heap[child], id)) break;
+        place(pos, _heap[child]);
+        pos = child;
+    }
+    place(pos, id);
+}
+
+void TimerQueue::removeAt(size_t pos) {
+    int last = _heap.back();
+    _heap.pop_back();
+    if (pos == _heap.size()) return;
+    place(pos, last);
+    siftDown(pos);
+    siftUp(_timers[last].pos);
+}
+
+void TimerQueue::release(int id) {
+    _timers[id].active = false;
+    _free.push(id);
+}
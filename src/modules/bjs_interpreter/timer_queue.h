@@ -0,0 +1,63 @@
+#ifndef __TIMER_QUEUE_H__
+#define __TIMER_QUEUE_H__
+
+// Deadlines of the script timers (setTimeout, setInterval, runtime.main) in a binary min-heap,
+// so finding and dispatching the next one is O(log n) whatever the number of timers.
+// Ids index a table that grows as needed, the lowest free id is handed out first. Timers due at
+// the same time fire in the order they were scheduled. An interval is rescheduled from its
+// previous due time, not from when it ran, so it keeps its phase; periods missed while the
+// script was busy are skipped rather than fired in a burst.
+// Main timers are only kept in the table, they fire on foreground changes, not on a deadline.
+// No Arduino dependencies, so ordering and dispatch cost can be tested on the host.
+
+#include <functional>
+#include <queue>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class TimerQueue {
+public:
+    int add(int64_t due, int32_t interval, bool repeat, bool main = false);
+    // false if id is not a timer
+    bool remove(int id);
+
+    bool active(int id) const { return id >= 0 && (size_t)id < _timers.size() && _timers[id].active; }
+    // Ids below slots() may be active
+    size_t slots() const { return _timers.size(); }
+    size_t count() const { return _heap.size() + _mains.size(); }
+    const std::vector<int> &mains() const { return _mains; }
+
+    // The earliest timer that is not a main one, -1 when there is none
+    int next() const { return _heap.empty() ? -1 : _heap[0]; }
+    int64_t due(int id) const { return _timers[id].due; }
+    // Takes the earliest timer if it is due at now: an interval moves to its next period after now,
+    // a timeout is removed and freed is set. -1 when nothing is due.
+    int takeDue(int64_t now, bool &freed);
+
+private:
+    struct Timer {
+        int64_t due;
+        uint32_t seq; // scheduling order, breaks ties between equal due times
+        int32_t interval;
+        uint32_t pos; // index in _heap
+        bool repeat;
+        bool main;
+        bool active;
+    };
+
+    bool before(int a, int b) const;
+    void place(size_t pos, int id);
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+    void removeAt(size_t pos);
+    void release(int id);
+
+    std::vector<Timer> _timers;
+    std::vector<int> _heap;
+    std::vector<int> _mains;
+    std::priority_queue<int, std::vector<int>, std::greater<int>> _free;
+    uint32_t _seq = 0;
+};
+
+#endif
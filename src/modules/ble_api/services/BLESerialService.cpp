@@ -38,6 +38,21 @@ int BLESerialService::available() {
     return serial_char->getValue().size();
 }
 
+size_t BLESerialService::read(uint8_t *buf, size_t size) {
+    // A written value can be longer than the caller's buffer, the rest is kept for the next reads
+    if (_rxPos >= _rxValue.size()) {
+        if (!newValue) return 0;
+        newValue = false;
+        _rxValue = serial_char->getValue();
+        _rxPos = 0;
+    }
+
+    size_t n = _rxValue.size() - _rxPos < size ? _rxValue.size() - _rxPos : size;
+    memcpy(buf, _rxValue.data() + _rxPos, n);
+    _rxPos += n;
+    return n;
+}
+
 size_t BLESerialService::println(const String &s) {
     String toSend = s + "\r\n";
     serial_char->notify(toSend);
@@ -94,8 +109,12 @@ size_t BLESerialService::println(const int n, int format) {
 size_t BLESerialService::println() { return println(""); }
 
 size_t BLESerialService::write(uint8_t *str, size_t size) {
-    serial_char->notify(str, size);
-    vTaskDelay(pdMS_TO_TICKS(10));
+    // A notification carries at most MTU - 3 bytes, the stack cuts longer ones
+    size_t chunk = mtu > 3 ? mtu - 3 : 20;
+    for (size_t pos = 0; pos < size; pos += chunk) {
+        serial_char->notify(str + pos, size - pos < chunk ? size - pos : chunk);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
     return size;
 }
 
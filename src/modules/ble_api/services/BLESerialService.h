@@ -11,6 +11,8 @@ class BLESerialCallbacks;
 class BLESerialService : public BruceBLEService, public SerialDevice {
     NimBLECharacteristic *serial_char = nullptr;
     BLESerialCallbacks *callbacks = nullptr;
+    std::string _rxValue; // last value read() took, consumed from _rxPos
+    size_t _rxPos = 0;
 
 public:
     BLESerialService();
@@ -29,6 +31,7 @@ public:
     void flush() override {}
     String readStringUntil(char terminator) override;
     int available() override;
+    size_t read(uint8_t *buf, size_t size) override;
     void setMTU(uint16_t mtu);
 };
 #endif
@@ -0,0 +1,308 @@
+#include "gps_track.h"
+#include "core/crc32.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static const char kMagic[4] = {'B', 'G', 'T', '1'};
+static const size_t kChunkHeaderSize = 4; // count, length
+// past this the storage is gone, drop the points instead of growing without end
+static const size_t kPayloadLimit = 4 * GPS_TRACK_CHUNK_SIZE;
+static const double kMetersPerDegree = 111194.93; // on a 6371 km sphere
+
+static const char kGpxHeader[] =
+    "<?xml version=\"1.0\" encoding=\"ISO-8859-1\" standalone=\"yes\"?>\n"
+    "<?xml-stylesheet type=\"text/xsl\" href=\"details.xsl\"?>\n"
+    "<gpx\n"
+    "  version=\"1.1\"\n"
+    "  creator=\"Bruce Firmware\"\n"
+    "  xmlns=\"http://www.topografix.com/GPX/1/1\"\n"
+    "  xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n"
+    "  xsi:schemaLocation=\"http://www.topografix.com/GPX/1/1 http://www.topografix.com/GPX/1/1/gpx.xsd\"\n"
+    ">\n"
+    "  <metadata>\n"
+    "    <name>Bruce GPS Tracker</name>\n"
+    "    <desc>GPS Tracker using Bruce Firmware</desc>\n"
+    "    <link href=\"https://bruce.computer\">\n"
+    "      <text>Bruce Website</text>\n"
+    "    </link>\n"
+    "  </metadata>\n"
+    "  <trk>\n"
+    "    <name>Bruce Route</name>\n"
+    "    <desc>GPS route captured by Bruce firmware</desc>\n"
+    "    <trkseg>\n";
+
+static const char kGpxFooter[] = "    </trkseg>\n"
+                                 "  </trk>\n"
+                                 "</gpx>\n";
+
+double gpsTrackDegrees(int64_t billionths) {
+    uint64_t raw = billionths < 0 ? -(uint64_t)billionths : billionths;
+    double ret = (uint16_t)(raw / 1000000000) + (uint32_t)(raw % 1000000000) / 1000000000.0;
+    return billionths < 0 ? -ret : ret;
+}
+
+int64_t gpsTrackTime(int year, int month, int day, int hour, int minute, int second, int centisecond) {
+    // days from 1970-01-01 of the proleptic Gregorian calendar, counted from March so leap days come last
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = era * 146097 + dayOfEra - 719468;
+    return ((days * 24 + hour) * 60 + minute) * 60000 + second * 1000 + centisecond * 10;
+}
+
+static void putVarint(std::string &out, int64_t v) {
+    uint64_t zigzag = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    while (zigzag >= 0x80) {
+        out += (char)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    out += (char)zigzag;
+}
+
+static bool getVarint(const std::string &in, size_t &pos, int64_t &v) {
+    uint64_t zigzag = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) return false;
+        uint8_t b = in[pos++];
+        zigzag |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            v = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// a - b without overflow
+static int64_t delta(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }
+
+static int64_t undelta(int64_t b, int64_t d) { return (int64_t)((uint64_t)b + (uint64_t)d); }
+
+static void putU32(std::string &out, uint32_t v) {
+    out += (char)v;
+    out += (char)(v >> 8);
+    out += (char)(v >> 16);
+    out += (char)(v >> 24);
+}
+
+bool GpsTrackLog::add(const GpsTrackPoint &point, uint32_t now) {
+    if (_payload.size() >= kPayloadLimit) {
+        _payload.clear();
+        _count = 0;
+    }
+    if (_count == 0) {
+        _firstAt = now;
+        _last = GpsTrackPoint();
+    }
+    putVarint(_payload, delta(point.time, _last.time));
+    putVarint(_payload, delta(point.lat, _last.lat));
+    putVarint(_payload, delta(point.lng, _last.lng));
+    putVarint(_payload, (int64_t)point.alt - _last.alt);
+    putVarint(_payload, (int64_t)point.hdop - _last.hdop);
+    putVarint(_payload, (int64_t)point.sat - _last.sat);
+    _last = point;
+    _count++;
+
+    if (_payload.size() >= GPS_TRACK_CHUNK_SIZE || now - _firstAt >= GPS_TRACK_FLUSH_MS) return flush();
+    return true;
+}
+
+bool GpsTrackLog::flush() {
+    if (_count == 0) return true;
+
+    std::string data;
+    if (!_started) data.assign(kMagic, sizeof(kMagic));
+    size_t start = data.size();
+    data += (char)_count;
+    data += (char)(_count >> 8);
+    data += (char)_payload.size();
+    data += (char)(_payload.size() >> 8);
+    data += _payload;
+    putU32(data, crc32Update(0, (const uint8_t *)data.data() + start, data.size() - start));
+
+    if (!_sink.append((const uint8_t *)data.data(), data.size())) return false;
+    _started = true;
+    _payload.clear();
+    _count = 0;
+    return true;
+}
+
+size_t GpsTrackReader::readFully(uint8_t *data, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        size_t n = _source.read(data + got, len - got);
+        if (n == 0) break;
+        got += n;
+    }
+    return got;
+}
+
+bool GpsTrackReader::readChunk() {
+    uint8_t header[kChunkHeaderSize];
+    size_t got = readFully(header, sizeof(header));
+    while (got == sizeof(header) && memcmp(header, kMagic, sizeof(kMagic)) == 0) {
+        _magicRead = true;
+        got = readFully(header, sizeof(header));
+    }
+    if (got == 0) return false;
+    if (got < sizeof(header) || !_magicRead) {
+        _damaged = true;
+        return false;
+    }
+
+    uint16_t count = header[0] | header[1] << 8;
+    size_t len = header[2] | header[3] << 8;
+    _payload.resize(len);
+    uint8_t crc[4];
+    if (readFully((uint8_t *)&_payload[0], len) != len || readFully(crc, sizeof(crc)) != sizeof(crc)) {
+        _damaged = true;
+        return false;
+    }
+    uint32_t expected = crc[0] | (uint32_t)crc[1] << 8 | (uint32_t)crc[2] << 16 | (uint32_t)crc[3] << 24;
+    uint32_t actual = crc32Update(0, header, sizeof(header));
+    actual = crc32Update(actual, (const uint8_t *)_payload.data(), len);
+    if (count == 0 || actual != expected) {
+        _damaged = true;
+        return false;
+    }
+
+    _pos = 0;
+    _left = count;
+    _last = GpsTrackPoint();
+    return true;
+}
+
+bool GpsTrackReader::next(GpsTrackPoint &point) {
+    if (_done) return false;
+    if (_left == 0 && !readChunk()) {
+        _done = true;
+        return false;
+    }
+
+    int64_t d[6];
+    for (int i = 0; i < 6; i++) {
+        if (!getVarint(_payload, _pos, d[i])) {
+            _damaged = _done = true;
+            return false;
+        }
+    }
+    _last.time = undelta(_last.time, d[0]);
+    _last.lat = undelta(_last.lat, d[1]);
+    _last.lng = undelta(_last.lng, d[2]);
+    _last.alt = (int32_t)(_last.alt + d[3]);
+    _last.hdop = (int32_t)(_last.hdop + d[4]);
+    _last.sat = (uint32_t)(_last.sat + d[5]);
+    _left--;
+    point = _last;
+    return true;
+}
+
+static bool writePoint(GpsTrackOutput &out, const GpsTrackPoint &point) {
+    char buf[256];
+    int len = snprintf(
+        buf,
+        sizeof(buf),
+        "      <trkpt lat=\"%f\" lon=\"%f\">\n"
+        "        <sym>Waypoint</sym>\n"
+        "        <ele>%f</ele>\n"
+        "        <hdop>%f</hdop>\n"
+        "        <sat>%lu</sat>\n"
+        "      </trkpt>\n",
+        gpsTrackDegrees(point.lat),
+        gpsTrackDegrees(point.lng),
+        point.alt / 100.0,
+        point.hdop / 100.0,
+        (unsigned long)point.sat
+    );
+    return len > 0 && (size_t)len < sizeof(buf) && out.write(buf, len);
+}
+
+// Meters from p to the segment a-b, on the plane tangent at a
+static double segmentDistance(const GpsTrackPoint &p, const GpsTrackPoint &a, const GpsTrackPoint &b) {
+    double k = cos(gpsTrackDegrees(a.lat) * M_PI / 180) * kMetersPerDegree;
+    double dlngB = delta(b.lng, a.lng) / 1e9, dlngP = delta(p.lng, a.lng) / 1e9;
+    // across the antimeridian
+    if (dlngB > 180) dlngB -= 360;
+    else if (dlngB < -180) dlngB += 360;
+    if (dlngP > 180) dlngP -= 360;
+    else if (dlngP < -180) dlngP += 360;
+
+    double bx = dlngB * k, by = delta(b.lat, a.lat) / 1e9 * kMetersPerDegree;
+    double px = dlngP * k, py = delta(p.lat, a.lat) / 1e9 * kMetersPerDegree;
+    double len2 = bx * bx + by * by;
+    double t = len2 > 0 ? (px * bx + py * by) / len2 : 0;
+    if (t < 0) t = 0;
+    else if (t > 1) t = 1;
+    double dx = px - t * bx, dy = py - t * by;
+    return sqrt(dx * dx + dy * dy);
+}
+
+// Douglas-Peucker: marks in keep the points of window to write
+static void simplify(const std::vector<GpsTrackPoint> &window, std::vector<bool> &keep, double tolerance) {
+    keep.assign(window.size(), false);
+    keep.front() = true;
+    keep.back() = true;
+    std::vector<std::pair<size_t, size_t>> spans = {
+        {0, window.size() - 1}
+    };
+    while (!spans.empty()) {
+        size_t first = spans.back().first, last = spans.back().second;
+        spans.pop_back();
+        double farthest = 0;
+        size_t index = first;
+        for (size_t i = first + 1; i < last; i++) {
+            double d = segmentDistance(window[i], window[first], window[last]);
+            if (d > farthest) {
+                farthest = d;
+                index = i;
+            }
+        }
+        if (farthest <= tolerance) continue;
+        keep[index] = true;
+        spans.push_back({first, index});
+        spans.push_back({index, last});
+    }
+}
+
+long gpsTrackExportGpx(GpsTrackReader &reader, GpsTrackOutput &out, double toleranceMeters) {
+    if (!out.write(kGpxHeader, sizeof(kGpxHeader) - 1)) return -1;
+
+    long written = 0;
+    GpsTrackPoint point;
+    if (toleranceMeters <= 0) {
+        while (reader.next(point)) {
+            if (!writePoint(out, point)) return -1;
+            written++;
+        }
+    } else {
+        std::vector<GpsTrackPoint> window;
+        std::vector<bool> keep;
+        window.reserve(GPS_TRACK_SIMPLIFY_WINDOW);
+        bool more = true;
+        while (more) {
+            more = reader.next(point);
+            if (more) window.push_back(point);
+            if (more && window.size() < GPS_TRACK_SIMPLIFY_WINDOW) continue;
+            if (window.empty()) break;
+
+            simplify(window, keep, toleranceMeters);
+            // the last point is kept, it starts the next window and is written with it
+            size_t end = more ? window.size() - 1 : window.size();
+            for (size_t i = 0; i < end; i++) {
+                if (!keep[i]) continue;
+                if (!writePoint(out, window[i])) return -1;
+                written++;
+            }
+            GpsTrackPoint last = window.back();
+            window.clear();
+            if (more) window.push_back(last);
+        }
+    }
+
+    if (!out.write(kGpxFooter, sizeof(kGpxFooter) - 1)) return -1;
+    return written;
+}
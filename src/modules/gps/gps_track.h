@@ -0,0 +1,106 @@
+#ifndef __GPS_TRACK_H__
+#define __GPS_TRACK_H__
+
+// Binary track log of the GPS tracker, exported to GPX when asked for.
+// File: magic "BGT1", then chunks, one per flush: point count (u16 LE), payload length (u16 LE),
+// payload, CRC32 (LE) of the count, length and payload. The payload holds the fields of each point as
+// zigzag varints, each the difference from the point before in the chunk (from 0 for the first), so a
+// chunk reads on its own. Reading stops at the first chunk that is torn or fails its CRC, which loses
+// at most the last flush on power loss. A magic between chunks starts another session in the same
+// file.
+// No Arduino dependencies, so a recorded NMEA trace can go through the log and the export on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#define GPS_TRACK_CHUNK_SIZE 2048     // payload bytes buffered before a flush
+#define GPS_TRACK_FLUSH_MS 30000      // at most this long in RAM
+#define GPS_TRACK_SIMPLIFY_WINDOW 256 // points simplified together by the export
+
+// Fixed point, in the units TinyGPS++ parses, so the export prints what the fix gave
+struct GpsTrackPoint {
+    int64_t time = 0; // ms since the Unix epoch, 0 when the date is not known yet
+    int64_t lat = 0;  // billionths of a degree
+    int64_t lng = 0;
+    int32_t alt = 0;  // cm
+    int32_t hdop = 0; // hundredths
+    uint32_t sat = 0;
+};
+
+// Degrees as TinyGPSLocation::lat() computes them from its raw value
+double gpsTrackDegrees(int64_t billionths);
+// ms since the Unix epoch of a UTC date and time, as the GPS gives them
+int64_t gpsTrackTime(int year, int month, int day, int hour, int minute, int second, int centisecond);
+
+// Where the chunks go, one call per flush
+class GpsTrackSink {
+public:
+    virtual ~GpsTrackSink() = default;
+    virtual bool append(const uint8_t *data, size_t len) = 0;
+};
+
+class GpsTrackLog {
+public:
+    GpsTrackLog(GpsTrackSink &sink) : _sink(sink) {}
+
+    // Buffers point, then flushes when the chunk is full or GPS_TRACK_FLUSH_MS passed since the first
+    // point buffered. False when a flush failed, the points stay buffered for the next one
+    bool add(const GpsTrackPoint &point, uint32_t now);
+    bool flush();
+    size_t buffered() const { return _count; }
+
+private:
+    GpsTrackSink &_sink;
+    std::string _payload;
+    GpsTrackPoint _last;
+    uint16_t _count = 0;
+    uint32_t _firstAt = 0;
+    bool _started = false; // magic written
+};
+
+// Where the chunks come from, read in order
+class GpsTrackSource {
+public:
+    virtual ~GpsTrackSource() = default;
+    // Up to len bytes, 0 at the end
+    virtual size_t read(uint8_t *data, size_t len) = 0;
+};
+
+class GpsTrackReader {
+public:
+    GpsTrackReader(GpsTrackSource &source) : _source(source) {}
+
+    // Next point, false at the end of the track or its first damaged chunk
+    bool next(GpsTrackPoint &point);
+    // The track stopped at a damaged chunk
+    bool damaged() const { return _damaged; }
+
+private:
+    bool readChunk();
+    size_t readFully(uint8_t *data, size_t len);
+
+    GpsTrackSource &_source;
+    std::string _payload;
+    size_t _pos = 0;
+    uint16_t _left = 0; // points left in the chunk
+    GpsTrackPoint _last;
+    bool _magicRead = false; // it is a track
+    bool _done = false;
+    bool _damaged = false;
+};
+
+// Where the GPX goes
+class GpsTrackOutput {
+public:
+    virtual ~GpsTrackOutput() = default;
+    virtual bool write(const char *data, size_t len) = 0;
+};
+
+// Writes the points of reader to out as the GPX the tracker used to write. With toleranceMeters > 0,
+// drops the points within that distance of the line through their neighbours (Douglas-Peucker, over
+// windows of GPS_TRACK_SIMPLIFY_WINDOW points so memory stays bounded). Returns the points written,
+// -1 when out failed
+long gpsTrackExportGpx(GpsTrackReader &reader, GpsTrackOutput &out, double toleranceMeters = 0);
+
+#endif
@@ -17,7 +17,7 @@
 GPSTracker::GPSTracker() { setup(); }
 
 GPSTracker::~GPSTracker() {
-    add_final_file_data();
+    finish_track();
     if (gpsConnected) end();
     ioExpander.turnPinOnOff(IO_EXP_GPS, LOW);
 #ifdef USE_BOOST
@@ -155,85 +155,142 @@ void GPSTracker::create_filename() {
         gps.time.minute() % 100,
         gps.time.second() % 100
     );
-    filename = String(timestamp) + "_gps_tracker.gpx";
+    filename = String(timestamp) + "_gps_tracker.bgt";
 }
 
-void GPSTracker::add_initial_file_data(File file) {
-    file.println("<?xml version=\"1.0\" encoding=\"ISO-8859-1\" standalone=\"yes\"?>");
-    file.println("<?xml-stylesheet type=\"text/xsl\" href=\"details.xsl\"?>");
-    file.println("<gpx");
-    file.println("  version=\"1.1\"");
-    file.println("  creator=\"Bruce Firmware\"");
-    file.println("  xmlns=\"http://www.topografix.com/GPX/1/1\"");
-    file.println("  xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"");
-    file.println(
-        "  xsi:schemaLocation=\"http://www.topografix.com/GPX/1/1 http://www.topografix.com/GPX/1/1/gpx.xsd\""
+int64_t GPSTracker::fix_time() {
+    if (!gps.date.isValid() || !gps.time.isValid() || gps.date.year() < CURRENT_YEAR) return 0;
+    return gpsTrackTime(
+        gps.date.year(),
+        gps.date.month(),
+        gps.date.day(),
+        gps.time.hour(),
+        gps.time.minute(),
+        gps.time.second(),
+        gps.time.centisecond()
     );
-    file.println(">");
-    file.println("  <metadata>");
-    file.println("    <name>Bruce GPS Tracker</name>");
-    file.println("    <desc>GPS Tracker using Bruce Firmware</desc>");
-    file.println("    <link href=\"https://bruce.computer\">");
-    file.println("      <text>Bruce Website</text>");
-    file.println("    </link>");
-    file.println("  </metadata>");
-    file.println("  <trk>");
-    file.println("    <name>Bruce Route</name>");
-    file.println("    <desc>GPS route captured by Bruce firmware</desc>");
-    file.println("    <trkseg>");
 }
 
-void GPSTracker::add_final_file_data() {
-    FS *fs;
-    if (!getFsStorage(fs)) return;
-    if (filename == "" || !(*fs).exists("/BruceGPS/" + filename)) return;
-
-    File file = (*fs).open("/BruceGPS/" + filename, FILE_APPEND);
-
-    if (!file) return;
-    file.println("    </trkseg>");
-    file.println("  </trk>");
-    file.println("</gpx>");
+// Flushes the track log and writes its GPX, as the tracker used to leave it
+void GPSTracker::finish_track() {
+    trackLog.flush();
+    if (trackFile.path == "") return;
+    exportGpsTrack(*trackFile.fs, trackFile.path);
+}
 
-    file.close();
+static int64_t raw_billionths(const RawDegrees &raw) {
+    int64_t billionths = (int64_t)raw.deg * 1000000000 + raw.billionths;
+    return raw.negative ? -billionths : billionths;
 }
 
 void GPSTracker::add_coord() {
-    FS *fs;
-    if (!getFsStorage(fs)) {
-        padprintln("Storage setup error");
-        returnToMenu = true;
-        return;
-    }
-
-    if (filename == "") create_filename();
+    if (trackFile.path == "") {
+        FS *fs;
+        if (!getFsStorage(fs)) {
+            padprintln("Storage setup error");
+            returnToMenu = true;
+            return;
+        }
 
-    if (!(*fs).exists("/BruceGPS")) (*fs).mkdir("/BruceGPS");
+        if (filename == "") create_filename();
 
-    bool is_new_file = false;
-    if (!(*fs).exists("/BruceGPS/" + filename)) is_new_file = true;
-    File file = (*fs).open("/BruceGPS/" + filename, is_new_file ? FILE_WRITE : FILE_APPEND);
+        if (!(*fs).exists("/BruceGPS")) (*fs).mkdir("/BruceGPS");
+        trackFile.fs = fs;
+        trackFile.path = "/BruceGPS/" + filename;
+    }
 
-    if (!file) {
+    // buffered, written every GPS_TRACK_FLUSH_MS or GPS_TRACK_CHUNK_SIZE bytes
+    GpsTrackPoint point;
+    point.time = fix_time();
+    point.lat = raw_billionths(gps.location.rawLat());
+    point.lng = raw_billionths(gps.location.rawLng());
+    point.alt = gps.altitude.value();
+    point.hdop = gps.hdop.value();
+    point.sat = gps.satellites.value();
+    if (!trackLog.add(point, millis())) {
         padprintln("Failed to open file for writing");
         returnToMenu = true;
         return;
     }
 
-    if (is_new_file) add_initial_file_data(file);
-
-    file.printf("      <trkpt lat=\"%f\" lon=\"%f\">\n", gps.location.lat(), gps.location.lng());
-    file.println("        <sym>Waypoint</sym>");
-    file.printf("        <ele>%f</ele>\n", gps.altitude.meters());
-    file.printf("        <hdop>%f</hdop>\n", gps.hdop.hdop());
-    file.printf("        <sat>%ld</sat>\n", gps.satellites.value());
-    file.println("      </trkpt>");
-
     gpsCoordCount++;
 
+    padprintf(2, "Coord: %.6f, %.6f\n", gps.location.lat(), gps.location.lng());
+}
+
+bool GpsTrackFile::append(const uint8_t *data, size_t len) {
+    if (fs == nullptr) return false;
+    File file = (*fs).open(path, FILE_APPEND);
+    if (!file) return false;
+    bool written = file.write(data, len) == len;
     file.close();
+    return written;
+}
 
-    padprintf(2, "Coord: %.6f, %.6f\n", gps.location.lat(), gps.location.lng());
+// The track log, read from a file
+class GpsTrackFileSource : public GpsTrackSource {
+public:
+    GpsTrackFileSource(File &file) : _file(file) {}
+    size_t read(uint8_t *data, size_t len) override { return _file.read(data, len); }
+
+private:
+    File &_file;
+};
+
+class GpsTrackFileOutput : public GpsTrackOutput {
+public:
+    GpsTrackFileOutput(File &file) : _file(file) {}
+    bool write(const char *data, size_t len) override {
+        return _file.write((const uint8_t *)data, len) == len;
+    }
+
+private:
+    File &_file;
+};
+
+String exportGpsTrack(FS &fs, const String &path, double toleranceMeters) {
+    String gpxPath = path.substring(0, path.lastIndexOf('.'));
+    if (toleranceMeters > 0) gpxPath += "_" + String((int)toleranceMeters) + "m";
+    gpxPath += ".gpx";
+
+    File in = fs.open(path, FILE_READ);
+    if (!in) return "";
+    File out = fs.open(gpxPath, FILE_WRITE);
+    if (!out) {
+        in.close();
+        return "";
+    }
+
+    GpsTrackFileSource source(in);
+    GpsTrackFileOutput output(out);
+    GpsTrackReader reader(source);
+    long points = gpsTrackExportGpx(reader, output, toleranceMeters);
+    in.close();
+    out.close();
+
+    if (points < 0) {
+        fs.remove(gpxPath);
+        return "";
+    }
+    if (reader.damaged()) log_w("%s: track cut at a damaged chunk, %ld points", path.c_str(), points);
+    return gpxPath;
+}
+
+void exportGpsTrackMenu(FS &fs, const String &path) {
+    double tolerance = -1;
+    std::vector<Option> toleranceOptions = {
+        {"Every point",  [&]() { tolerance = 0; } },
+        {"Simplify 2m",  [&]() { tolerance = 2; } },
+        {"Simplify 5m",  [&]() { tolerance = 5; } },
+        {"Simplify 10m", [&]() { tolerance = 10; }},
+    };
+    loopOptions(toleranceOptions);
+    if (tolerance < 0) return;
+
+    displayTextLine("Exporting...");
+    String gpxPath = exportGpsTrack(fs, path, tolerance);
+    if (gpxPath == "") displayError("GPX export failed", true);
+    else displaySuccess(gpxPath.substring(gpxPath.lastIndexOf('/') + 1), true);
 }
 
 void GPSTracker::releasePins() {
@@ -9,9 +9,25 @@
 #ifndef __GPS_TRACKER_H__
 #define __GPS_TRACKER_H__
 
+#include "gps_track.h"
 #include <TinyGPS++.h>
 #include <globals.h>
 
+// Appends the chunks of a track log to path, opening it for each flush
+class GpsTrackFile : public GpsTrackSink {
+public:
+    FS *fs = nullptr;
+    String path = "";
+
+    bool append(const uint8_t *data, size_t len) override;
+};
+
+// Writes the GPX of the track log at path next to it, simplified to toleranceMeters when above 0.
+// Returns the path of the GPX, "" on error
+String exportGpsTrack(FS &fs, const String &path, double toleranceMeters = 0);
+// "GPX Export" of the file browser: asks the simplification, then exports
+void exportGpsTrackMenu(FS &fs, const String &path);
+
 class GPSTracker {
 public:
     /////////////////////////////////////////////////////////////////////////////////////
@@ -37,6 +53,8 @@ private:
     HardwareSerial GPSserial = HardwareSerial(2);
     int gpsCoordCount = 0;
     bool rxPinReleased = false;
+    GpsTrackFile trackFile;
+    GpsTrackLog trackLog{trackFile};
 
     /////////////////////////////////////////////////////////////////////////////////////
     // Setup
@@ -57,9 +75,9 @@ private:
     /////////////////////////////////////////////////////////////////////////////////////
     void set_position(void);
     void add_coord(void);
-    void add_initial_file_data(File file);
-    void add_final_file_data(void);
+    void finish_track(void);
     void create_filename(void);
+    int64_t fix_time(void);
 };
 
 #endif // GPS_TRACKER_H
@@ -5,6 +5,7 @@
 #include "core/sd_functions.h"
 #include "core/settings.h"
 #include "core/type_convertion.h"
+#include "ir_index.h"
 #include "ir_utils.h"
 #include <IRutils.h>
 
@@ -16,13 +17,6 @@ uint32_t swap32(uint32_t value) {
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Custom IR
 
-static std::vector<IRCode *> codes;
-
-void resetCodesArray() {
-    for (auto code : codes) { delete code; }
-    codes.clear();
-}
-
 static std::vector<IRCode *> recent_ircodes;
 
 void addToRecentCodes(IRCode *ircode) {
@@ -70,11 +64,83 @@ void selectRecentIrMenu() {
     return;
 }
 
+// Loads "<file>.idx" if it matches the file, otherwise indexes the text in one pass and keeps the
+// result next to it on SD
+static bool loadIrIndex(FS *fs, const String &filepath, File &src, IrIndex &index) {
+    const uint32_t size = src.size();
+    const uint32_t mtime = (uint32_t)src.getLastWrite();
+    const String indexPath = filepath + IR_INDEX_EXT;
+
+    File idx = fs->open(indexPath, FILE_READ);
+    if (idx) {
+        IrIndexHeader hdr;
+        bool ok = idx.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) && index.accept(hdr, size, mtime) &&
+                  idx.size() == sizeof(hdr) + hdr.entryCount * sizeof(IrIndexEntry) + hdr.poolSize;
+        if (ok) {
+            size_t bytes = hdr.entryCount * sizeof(IrIndexEntry);
+            ok = idx.read((uint8_t *)index.entryBuffer(), bytes) == bytes &&
+                 idx.read((uint8_t *)index.poolBuffer(), hdr.poolSize) == hdr.poolSize && index.loaded();
+        }
+        idx.close();
+        if (ok) return true;
+    }
+
+    IrIndexBuilder builder;
+    builder.begin(&index);
+    char chunk[512];
+    src.seek(0);
+    while (src.available()) {
+        int got = src.read((uint8_t *)chunk, sizeof(chunk));
+        if (got <= 0) break;
+        builder.feed(chunk, got);
+    }
+    if (!builder.finish()) return false;
+    Serial.printf("Indexed %d IR signals\n", (int)index.size());
+
+    if (fs == &SD && index.size() > 1) {
+        IrIndexHeader hdr = index.header(size, mtime);
+        idx = fs->open(indexPath, FILE_WRITE);
+        if (idx) {
+            idx.write((const uint8_t *)&hdr, sizeof(hdr));
+            idx.write((const uint8_t *)index.entries(), index.size() * sizeof(IrIndexEntry));
+            idx.write((const uint8_t *)index.pool(), index.poolSize());
+            idx.close();
+        }
+    }
+    return true;
+}
+
+// Fills code from an index entry, the data:/value:/state: text is read from its file span
+static void
+irCodeFromIndex(const IrIndex &index, size_t i, File &file, const String &filename, IRCode &code) {
+    const IrIndexEntry &e = index[i];
+    code.name = index.str(e.name);
+    code.type = index.str(e.type);
+    code.protocol = index.str(e.protocol);
+    code.address = index.str(e.address);
+    code.command = index.str(e.command);
+    code.frequency = e.frequency;
+    code.bits = e.bits;
+    code.filepath = code.name + " " + filename;
+
+    code.data = "";
+    if (!e.dataLength || !file.seek(e.dataOffset)) return;
+    code.data.reserve(e.dataLength);
+    char chunk[257];
+    uint32_t left = e.dataLength;
+    while (left) {
+        int got = file.read((uint8_t *)chunk, left < 256 ? left : 256);
+        if (got <= 0) break;
+        chunk[got] = '\0';
+        code.data += chunk;
+        left -= got;
+    }
+}
+
 bool txIrFile(FS *fs, String filepath, bool hideDefaultUI) {
     // SPAM all codes of the file
 
     int total_codes = 0;
-    String line;
 
     File databaseFile = fs->open(filepath, FILE_READ);
 
@@ -89,107 +155,38 @@ bool txIrFile(FS *fs, String filepath, bool hideDefaultUI) {
     }
     Serial.println("Opened database file.");
 
+    IrIndex index;
+    if (!loadIrIndex(fs, filepath, databaseFile, index)) {
+        Serial.println("Failed to index database file.");
+        displayError("Fail to read file");
+        delay(2000);
+        databaseFile.close();
+        return false;
+    }
+
     bool endingEarly = false;
     int codes_sent = 0;
-    uint16_t frequency = 0;
-    String rawData = "";
-    String protocol = "";
-    String address = "";
-    String command = "";
-    String value = "";
-    uint8_t bits = 32;
-
-    databaseFile.seek(0); // comes back to first position
+    const String filename = filepath.substring(1 + filepath.lastIndexOf("/"));
 
     // count the number of codes to replay
-    while (databaseFile.available()) {
-        line = databaseFile.readStringUntil('\n');
-        if (line.startsWith("type:")) total_codes++;
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (*index.str(index[i].type)) total_codes++;
     }
 
     Serial.printf("\nStarted SPAM all codes with: %d codes", total_codes);
-    // comes back to first position, beggining of the file
-    databaseFile.seek(0);
-    while (databaseFile.available()) {
+    for (size_t i = 0; i < index.size(); ++i) {
+        const char *type = index.str(index[i].type);
+        if (!*type) continue;
+
         if (!hideDefaultUI) { progressHandler(codes_sent, total_codes); }
-        line = databaseFile.readStringUntil('\n');
-        if (line.endsWith("\r")) line.remove(line.length() - 1);
-
-        if (line.startsWith("type:")) {
-            codes_sent++;
-            String type = line.substring(5);
-            type.trim();
-            Serial.println("Type: " + type);
-            if (type == "raw") {
-                Serial.println("RAW code");
-                while (databaseFile.available()) {
-                    line = databaseFile.readStringUntil('\n');
-                    if (line.endsWith("\r")) line.remove(line.length() - 1);
-
-                    if (line.startsWith("frequency:")) {
-                        line = line.substring(10);
-                        line.trim();
-                        frequency = line.toInt();
-                        Serial.printf("Frequency: %d\n", frequency);
-                    } else if (line.startsWith("data:")) {
-                        rawData = line.substring(5);
-                        rawData.trim();
-                        Serial.println("RawData: " + rawData);
-                    } else if ((frequency != 0 && rawData != "") || line.startsWith("#")) {
-                        IRCode code;
-                        code.type = "raw";
-                        code.data = rawData;
-                        code.frequency = frequency;
-                        sendIRCommand(&code, hideDefaultUI);
-
-                        rawData = "";
-                        frequency = 0;
-                        type = "";
-                        line = "";
-                        break;
-                    }
-                }
-            } else if (type == "parsed") {
-                Serial.println("PARSED");
-                while (databaseFile.available()) {
-                    line = databaseFile.readStringUntil('\n');
-                    if (line.endsWith("\r")) line.remove(line.length() - 1);
-
-                    if (line.startsWith("protocol:")) {
-                        protocol = line.substring(9);
-                        protocol.trim();
-                        Serial.println("Protocol: " + protocol);
-                    } else if (line.startsWith("address:")) {
-                        address = line.substring(8);
-                        address.trim();
-                        Serial.println("Address: " + address);
-                    } else if (line.startsWith("command:")) {
-                        command = line.substring(8);
-                        command.trim();
-                        Serial.println("Command: " + command);
-                    } else if (line.startsWith("value:") || line.startsWith("state:")) {
-                        value = line.substring(6);
-                        value.trim();
-                        Serial.println("Value: " + value);
-                    } else if (line.startsWith("bits:")) {
-                        bits = line.substring(strlen("bits:")).toInt();
-                        Serial.println("bits: " + bits);
-                    } else if (line.indexOf("#") != -1) { // TODO: also detect EOF
-                        IRCode code(protocol, address, command, value, bits);
-                        sendIRCommand(&code, hideDefaultUI);
-
-                        protocol = "";
-                        address = "";
-                        command = "";
-                        value = "";
-                        bits = 32;
-                        type = "";
-                        line = "";
-                        break;
-                    }
-                }
-            }
+        codes_sent++;
+        Serial.printf("Type: %s\n", type);
+        if (strcmp(type, "raw") == 0 || strcmp(type, "parsed") == 0) {
+            IRCode code;
+            irCodeFromIndex(index, i, databaseFile, filename, code);
+            sendIRCommand(&code, hideDefaultUI);
         }
+
         // if user is pushing (holding down) TRIGGER button, stop transmission early
         if (check(SelPress)) // Pause TV-B-Gone
         {
@@ -206,19 +203,17 @@ bool txIrFile(FS *fs, String filepath, bool hideDefaultUI) {
             if (endingEarly) break; // Cancels  custom IR Spam
             if (!hideDefaultUI) { displayTextLine("Running, Wait"); }
         }
-    } // end while file has lines to process
+    }
     databaseFile.close();
     Serial.println("closed");
     Serial.println("EXTRA finished");
 
-    resetCodesArray();
     digitalWrite(bruceConfigPins.irTx, LED_OFF);
     return true;
 }
 
 void otherIRcodes() {
     checkIrTxPin();
-    resetCodesArray();
     String filepath;
     FS *fs = NULL;
 
@@ -635,8 +630,6 @@ void sendRawCommand(uint16_t frequency, String rawData, bool hideDefaultUI) {
 
 bool chooseCmdIrFile(FS *fs, String filepath) {
     checkIrTxPin();
-    resetCodesArray();
-    int total_codes = 0;
     File databaseFile;
 
     returnToMenu = true;
@@ -650,57 +643,30 @@ bool chooseCmdIrFile(FS *fs, String filepath) {
     }
     Serial.println("Opened IR file.");
 
+    IrIndex index;
+    if (!loadIrIndex(fs, filepath, databaseFile, index)) {
+        Serial.println("Failed to index IR file.");
+        databaseFile.close();
+        return false;
+    }
+
     setup_ir_pin(bruceConfigPins.irTx, OUTPUT);
 
     // Mode to choose and send command by command (limitted to 100 commands)
-    String line;
-    String txt;
-    codes.push_back(new IRCode());
-
-    while (databaseFile.available() && total_codes < 100) {
-        line = databaseFile.readStringUntil('\n');
-        txt = line.substring(line.indexOf(":") + 1);
-        txt.trim();
-
-        if (line.startsWith("name:")) {
-            if (codes[total_codes]->name != "") {
-                total_codes++;
-                codes.push_back(new IRCode());
-            }
-            // save signal name
-            codes[total_codes]->name = txt;
-            codes[total_codes]->filepath = txt + " " + filepath.substring(1 + filepath.lastIndexOf("/"));
-        }
-
-        if (line.startsWith("type:")) codes[total_codes]->type = txt;
-        if (line.startsWith("protocol:")) codes[total_codes]->protocol = txt;
-        if (line.startsWith("address:")) codes[total_codes]->address = txt;
-        if (line.startsWith("frequency:")) codes[total_codes]->frequency = txt.toInt();
-        if (line.startsWith("bits:")) codes[total_codes]->bits = txt.toInt();
-        if (line.startsWith("command:")) codes[total_codes]->command = txt;
-        if (line.startsWith("data:") || line.startsWith("value:") || line.startsWith("state:")) {
-            codes[total_codes]->data = txt;
-        }
-
-        if (line.startsWith("#") && total_codes < codes.size() && codes[total_codes]->name != "") {
-            total_codes++;
-            codes.push_back(new IRCode());
-        }
-    }
-
+    // Names come from the index, the code itself is only read when its button is pressed
+    const String filename = filepath.substring(1 + filepath.lastIndexOf("/"));
     options = {};
-    for (auto code : codes) {
-        if (code->name != "") {
-            options.push_back({code->name.c_str(), [code]() {
-                               sendIRCommand(code);
-                               addToRecentCodes(code);
+    for (size_t i = 0; i < index.size() && i < 100; ++i) {
+        options.push_back({index.str(index[i].name), [&index, i, &databaseFile, &filename]() {
+                               IRCode code;
+                               irCodeFromIndex(index, i, databaseFile, filename, code);
+                               sendIRCommand(&code);
+                               addToRecentCodes(&code);
                            }});
-        }
     }
 
     bool exit = false;
     options.push_back({"Main Menu", [&]() { exit = true; }});
-    databaseFile.close();
 
 #ifdef USE_BOOST /// DISABLE 5V OUTPUT
     PPM.disableOTG();
@@ -713,6 +679,6 @@ bool chooseCmdIrFile(FS *fs, String filepath) {
         if (check(EscPress) || exit) break;
     }
     options.clear();
-    resetCodesArray();
+    databaseFile.close();
     return true;
 }
@@ -0,0 +1,214 @@
+#include "ir_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Same set as String::trim()
+static inline bool isTrimmed(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+IrIndexHeader IrIndex::header(uint32_t sourceSize, uint32_t sourceMtime) const {
+    IrIndexHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = IR_INDEX_MAGIC;
+    hdr.version = IR_INDEX_VERSION;
+    hdr.entryCount = _entries.size();
+    hdr.poolSize = _pool.size();
+    hdr.sourceSize = sourceSize;
+    hdr.sourceMtime = sourceMtime;
+    return hdr;
+}
+
+bool IrIndex::accept(const IrIndexHeader &hdr, uint32_t sourceSize, uint32_t sourceMtime) {
+    clear();
+    if (hdr.magic != IR_INDEX_MAGIC || hdr.version != IR_INDEX_VERSION) return false;
+    if (hdr.sourceSize != sourceSize || (hdr.sourceMtime && hdr.sourceMtime != sourceMtime)) return false;
+    if (hdr.poolSize == 0 || hdr.poolSize > IR_INDEX_MAX_POOL) return false;
+    // every signal ends somewhere in the source, anything bigger is garbage
+    if (hdr.entryCount > sourceSize / 4) return false;
+    _entries.resize(hdr.entryCount);
+    _pool.resize(hdr.poolSize);
+    return true;
+}
+
+bool IrIndex::loaded() {
+    bool ok = !_pool.empty() && _pool[0] == '\0' && _pool.back() == '\0';
+    for (size_t i = 0; ok && i < _entries.size(); ++i) {
+        const IrIndexEntry &e = _entries[i];
+        ok = e.name < _pool.size() && e.type < _pool.size() && e.protocol < _pool.size() &&
+             e.address < _pool.size() && e.command < _pool.size();
+    }
+    if (!ok) clear();
+    return ok;
+}
+
+void IrIndex::clear() {
+    _entries.clear();
+    _pool.clear();
+}
+
+void IrIndexBuilder::begin(IrIndex *index) {
+    _index = index;
+    _index->clear();
+    _index->_pool.push_back('\0');
+    _interned.clear();
+    _interned[std::string()] = 0;
+    _overflow = false;
+    memset(&_entry, 0, sizeof(_entry));
+    _entry.bits = 32;
+    _pos = 0;
+    startLine();
+}
+
+void IrIndexBuilder::startLine() {
+    _state = ST_KEY;
+    _field = F_NONE;
+    _lineStart = true;
+    _keyLen = 0;
+    _valueLen = 0;
+}
+
+void IrIndexBuilder::feed(const char *data, size_t len) {
+    for (size_t i = 0; i < len; ++i, ++_pos) {
+        const char c = data[i];
+        if (c == '\n') {
+            endLine();
+            startLine();
+            continue;
+        }
+        const bool first = _lineStart;
+        _lineStart = false;
+        switch (_state) {
+            case ST_KEY:
+                if (first && c == '#') {
+                    _field = F_COMMENT;
+                    _state = ST_SKIP;
+                } else if (c == ':') {
+                    endKey();
+                } else if (_keyLen < sizeof(_key)) {
+                    _key[_keyLen++] = c;
+                } else {
+                    _state = ST_SKIP; // no known key is this long
+                }
+                break;
+            case ST_VALUE:
+                if (_valueLen < sizeof(_value) - 1) _value[_valueLen++] = c;
+                break;
+            case ST_SPAN:
+                if (!isTrimmed(c)) {
+                    if (!_spanText) _spanStart = _pos;
+                    _spanText = true;
+                    _spanEnd = _pos + 1;
+                }
+                break;
+            case ST_SKIP: break;
+        }
+    }
+}
+
+bool IrIndexBuilder::finish() {
+    if (!_lineStart) endLine();
+    startLine();
+    closeEntry();
+    if (_overflow) _index->clear();
+    return !_overflow;
+}
+
+void IrIndexBuilder::endKey() {
+    struct KeyName {
+        const char *name;
+        Field field;
+    };
+    static const KeyName keys[] = {
+        {"name",      F_NAME     },
+        {"type",      F_TYPE     },
+        {"protocol",  F_PROTOCOL },
+        {"address",   F_ADDRESS  },
+        {"command",   F_COMMAND  },
+        {"frequency", F_FREQUENCY},
+        {"bits",      F_BITS     },
+        {"data",      F_DATA     },
+        {"value",     F_DATA     },
+        {"state",     F_DATA     },
+    };
+
+    _field = F_NONE;
+    for (const KeyName &k : keys) {
+        if (strlen(k.name) == _keyLen && memcmp(k.name, _key, _keyLen) == 0) {
+            _field = k.field;
+            break;
+        }
+    }
+    if (_field == F_DATA) {
+        _spanText = false;
+        _state = ST_SPAN;
+    } else {
+        _state = _field == F_NONE ? ST_SKIP : ST_VALUE;
+    }
+}
+
+void IrIndexBuilder::endLine() {
+    if (_state == ST_VALUE) applyValue();
+    if (_state == ST_SPAN) {
+        _entry.dataOffset = _spanText ? _spanStart : 0;
+        _entry.dataLength = _spanText ? _spanEnd - _spanStart : 0;
+    }
+    if (_field == F_COMMENT) closeEntry();
+}
+
+void IrIndexBuilder::applyValue() {
+    const char *v = _value;
+    size_t len = _valueLen;
+    while (len && isTrimmed(*v)) {
+        v++;
+        len--;
+    }
+    while (len && isTrimmed(v[len - 1])) len--;
+
+    switch (_field) {
+        case F_NAME:
+            // A second name starts the next signal
+            if (_entry.name) closeEntry();
+            _entry.name = intern(v, len);
+            break;
+        case F_TYPE: _entry.type = intern(v, len); break;
+        case F_PROTOCOL: _entry.protocol = intern(v, len); break;
+        case F_ADDRESS: _entry.address = intern(v, len); break;
+        case F_COMMAND: _entry.command = intern(v, len); break;
+        case F_FREQUENCY:
+        case F_BITS: {
+            // String::toInt(): atol(), truncated to the field
+            char num[IR_INDEX_STRING_LEN];
+            memcpy(num, v, len);
+            num[len] = '\0';
+            long n = atol(num);
+            if (_field == F_FREQUENCY) _entry.frequency = (uint16_t)n;
+            else _entry.bits = (uint8_t)n;
+            break;
+        }
+        default: break;
+    }
+}
+
+void IrIndexBuilder::closeEntry() {
+    // Fields seen before the first name belong to it, unnamed signals are never listed
+    if (!_entry.name) return;
+    _index->_entries.push_back(_entry);
+    memset(&_entry, 0, sizeof(_entry));
+    _entry.bits = 32;
+}
+
+uint16_t IrIndexBuilder::intern(const char *s, size_t len) {
+    std::string key(s, len);
+    auto it = _interned.find(key);
+    if (it != _interned.end()) return it->second;
+
+    std::vector<char> &pool = _index->_pool;
+    if (pool.size() + len + 1 > IR_INDEX_MAX_POOL) {
+        _overflow = true;
+        return 0;
+    }
+    uint16_t off = pool.size();
+    pool.insert(pool.end(), s, s + len);
+    pool.push_back('\0');
+    _interned.emplace(std::move(key), off);
+    return off;
+}
@@ -0,0 +1,138 @@
+#ifndef __IR_INDEX_H__
+#define __IR_INDEX_H__
+
+// Binary index for Flipper .ir files.
+// One pass over the text collects every signal's name, type, protocol, address/command, bits and
+// frequency into fixed records plus a string pool, and remembers where its data:/value:/state:
+// text lives in the file. The index is written next to the .ir file, so opening a remote is one
+// read of the index and only the data span of the pressed button is read from the text.
+// No Arduino dependencies, so it can be built and checked against sd_files/infrared on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define IR_INDEX_MAGIC 0x58495249 // "IRIX"
+#define IR_INDEX_VERSION 1
+#define IR_INDEX_EXT ".idx"
+#define IR_INDEX_STRING_LEN 64 // longer names/protocols/addresses are cut
+#define IR_INDEX_MAX_POOL 0xFFFF
+
+// Layout is also the on-disk index record, keep it padding free
+struct IrIndexEntry {
+    uint32_t dataOffset; // first byte of the trimmed data:/value:/state: text
+    uint32_t dataLength; // 0 if the signal has none
+    uint16_t name;       // string pool offsets, 0 is the empty string
+    uint16_t type;
+    uint16_t protocol;
+    uint16_t address;
+    uint16_t command;
+    uint16_t frequency;
+    uint8_t bits;
+    uint8_t reserved[3];
+};
+static_assert(sizeof(IrIndexEntry) == 24, "IrIndexEntry is stored as is in the index");
+
+// Followed by entryCount records and poolSize bytes of zero terminated strings
+struct IrIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t entryCount;
+    uint32_t poolSize;
+    uint32_t sourceSize;  // the index is stale if the .ir size or mtime changed
+    uint32_t sourceMtime; // 0 if built offline: only the size is checked
+};
+
+class IrIndex {
+public:
+    IrIndex() = default;
+
+    size_t size() const { return _entries.size(); }
+    const IrIndexEntry &operator[](size_t i) const { return _entries[i]; }
+    const char *str(uint16_t off) const { return off < _pool.size() ? &_pool[off] : ""; }
+
+    // Header of the stored form
+    IrIndexHeader header(uint32_t sourceSize, uint32_t sourceMtime) const;
+    const IrIndexEntry *entries() const { return _entries.data(); }
+    const char *pool() const { return _pool.data(); }
+    size_t poolSize() const { return _pool.size(); }
+
+    // Checks a stored header against the .ir file and sizes the tables for load()
+    bool accept(const IrIndexHeader &hdr, uint32_t sourceSize, uint32_t sourceMtime);
+    IrIndexEntry *entryBuffer() { return _entries.data(); }
+    char *poolBuffer() { return _pool.data(); }
+    // Validates the pool after entryBuffer()/poolBuffer() were read
+    bool loaded();
+
+    void clear();
+
+private:
+    friend class IrIndexBuilder;
+
+    std::vector<IrIndexEntry> _entries;
+    std::vector<char> _pool;
+};
+
+// Streaming .ir tokenizer filling an IrIndex. Signals are split the way the remote menu always did:
+// a new name: or a '#' line closes the current signal, keys are matched at the start of a line.
+// Not built on LineReader: the index needs the file offset of every data span, and raw data: lines
+// run to 3 kB, so with any stack sized buffer they would come in pieces to be stitched back anyway.
+class IrIndexBuilder {
+public:
+    IrIndexBuilder() = default;
+
+    void begin(IrIndex *index);
+    // offset of data[0] in the file is tracked internally, feed the file sequentially
+    void feed(const char *data, size_t len);
+    // Flushes the last line and signal. False if the string pool overflowed.
+    bool finish();
+
+    uint32_t bytesParsed() const { return _pos; }
+
+private:
+    enum State : uint8_t { ST_KEY, ST_VALUE, ST_SPAN, ST_SKIP };
+    enum Field : uint8_t {
+        F_NONE,
+        F_NAME,
+        F_TYPE,
+        F_PROTOCOL,
+        F_ADDRESS,
+        F_COMMAND,
+        F_FREQUENCY,
+        F_BITS,
+        F_DATA,
+        F_COMMENT,
+    };
+
+    void startLine();
+    void endKey();
+    void endLine();
+    void applyValue();
+    void closeEntry();
+    uint16_t intern(const char *s, size_t len);
+
+    IrIndex *_index = nullptr;
+    std::unordered_map<std::string, uint16_t> _interned;
+    bool _overflow = false;
+
+    IrIndexEntry _entry;
+    uint32_t _pos = 0;
+
+    State _state = ST_KEY;
+    Field _field = F_NONE;
+    bool _lineStart = true;
+    char _key[12];
+    uint8_t _keyLen = 0;
+    char _value[IR_INDEX_STRING_LEN];
+    uint8_t _valueLen = 0;
+
+    // data span being collected, trimmed as it goes
+    uint32_t _spanStart = 0;
+    uint32_t _spanEnd = 0;
+    bool _spanText = false;
+};
+
+#endif
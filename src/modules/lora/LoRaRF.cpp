@@ -3,6 +3,7 @@
 #include "WString.h"
 #include "core/config.h"
 #include "core/configPins.h"
+#include "core/file_line_reader.h"
 #include <Arduino.h>
 #include <FS.h>
 #include <LittleFS.h>
@@ -247,9 +248,15 @@ void render() {
 void loadMessages() {
     messages.clear();
     File file = LittleFS.open("/chats.txt", "r");
-    while (file.available()) {
-        String line = file.readStringUntil('\n');
-        messages.push_back(line);
+    char buffer[256];
+    FileLineReader reader(file, buffer, sizeof(buffer));
+    TextSlice line;
+    String message;
+    while (file && reader.next(line)) {
+        message.concat(line.data, line.len);
+        if (reader.partial()) continue;
+        messages.push_back(message);
+        message = "";
     }
     file.close();
     if (messages.size() > maxMessages) {
@@ -1,5 +1,6 @@
 #include "audio.h"
 #include "core/mykeyboard.h"
+#include "read_ahead_buffer.h"
 
 #if defined(HAS_NS4168_SPKR)
 #include "AudioFileSourceFunction.h"
@@ -23,11 +24,150 @@ static const uint32_t AUDIO_TASK_STACK_SIZE = 16384; // 16KB - increased for com
 static const UBaseType_t AUDIO_TASK_PRIORITY = 1;
 static const BaseType_t AUDIO_TASK_CORE = 1; // Core 1
 
+// Read-ahead configuration
+static const size_t AUDIO_BUFFER_PSRAM = 256 * 1024; // ~1.5 s of CD quality WAV
+static const size_t AUDIO_BUFFER_HEAP = 32 * 1024;   // halved until it fits, down to the minimum
+static const size_t AUDIO_BUFFER_MIN = 8 * 1024;
+static const size_t AUDIO_BUFFER_CHUNK = 8 * 1024; // card read size, whole multi-sector transfers
+static const uint32_t AUDIO_FILLER_STACK_SIZE = 4096;
+static const UBaseType_t AUDIO_FILLER_PRIORITY = AUDIO_TASK_PRIORITY + 1; // refill before decoding more
+static const uint32_t AUDIO_READ_TIMEOUT_MS = 2000;
+
+// ===== READ-AHEAD SOURCE =====
+// Keeps a ring buffer ahead of the decoder from a filler task of its own, so the card is read in
+// large bursts and a card access from the UI or another task does not stall playback.
+// Owns the wrapped source; without memory for the buffer it just reads through to it.
+class AudioFileSourceReadAhead : public AudioFileSource {
+public:
+    AudioFileSourceReadAhead(AudioFileSource *in) : _in(in) {
+        size_t capacity = psramFound() ? AUDIO_BUFFER_PSRAM : AUDIO_BUFFER_HEAP;
+        _ring = (uint8_t *)heap_caps_malloc(capacity, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        for (; !_ring && capacity >= AUDIO_BUFFER_MIN; capacity /= 2) {
+            _ring = (uint8_t *)heap_caps_malloc(capacity, MALLOC_CAP_8BIT);
+            if (_ring) break;
+        }
+        if (!_ring) {
+            Serial.println("WARNING: No memory for the audio buffer, reading the file directly");
+            return;
+        }
+
+        _buffer = new ReadAheadBuffer(readSource, _in, _in->getSize(), _ring, capacity, AUDIO_BUFFER_CHUNK);
+        _fillerExited = xSemaphoreCreateBinary();
+        BaseType_t result = !_fillerExited ? pdFAIL : xTaskCreatePinnedToCore(
+            fillerTask,
+            "AudioFiller",
+            AUDIO_FILLER_STACK_SIZE,
+            this,
+            AUDIO_FILLER_PRIORITY,
+            &_filler,
+            AUDIO_TASK_CORE
+        );
+        if (result != pdPASS) {
+            Serial.println("WARNING: Failed to create audio filler task, reading the file directly");
+            if (_fillerExited) vSemaphoreDelete(_fillerExited);
+            _fillerExited = nullptr;
+            release();
+        }
+    }
+
+    ~AudioFileSourceReadAhead() override {
+        close();
+        delete _in;
+    }
+
+    uint32_t read(void *data, uint32_t len) override {
+        if (!_buffer) return _in->read(data, len);
+        return _buffer->read((uint8_t *)data, len, AUDIO_READ_TIMEOUT_MS);
+    }
+
+    uint32_t readNonBlock(void *data, uint32_t len) override {
+        if (!_buffer) return _in->readNonBlock(data, len);
+        return _buffer->readAvailable((uint8_t *)data, len);
+    }
+
+    bool seek(int32_t pos, int dir) override {
+        if (!_buffer) return _in->seek(pos, dir);
+        if (dir == SEEK_CUR) pos += _buffer->position();
+        else if (dir == SEEK_END) pos += _buffer->size();
+        return pos >= 0 && _buffer->seek(pos);
+    }
+
+    bool close() override {
+        release();
+        return _in->close();
+    }
+
+    bool isOpen() override { return _in->isOpen(); }
+    uint32_t getSize() override { return _buffer ? _buffer->size() : _in->getSize(); }
+    uint32_t getPos() override { return _buffer ? _buffer->position() : _in->getPos(); }
+
+    bool stats(ReadAheadBuffer::Stats &out) {
+        if (!_buffer) return false;
+        out = _buffer->stats();
+        return true;
+    }
+
+private:
+    // Runs on the filler task only, the decoder never touches _in while buffered
+    static size_t readSource(void *ctx, uint32_t offset, uint8_t *buffer, size_t len) {
+        AudioFileSource *in = static_cast<AudioFileSource *>(ctx);
+        if (in->getPos() != offset && !in->seek(offset, SEEK_SET)) return 0;
+        return in->read(buffer, len);
+    }
+
+    static void fillerTask(void *parameter) {
+        AudioFileSourceReadAhead *self = static_cast<AudioFileSourceReadAhead *>(parameter);
+        self->_buffer->runFiller();
+        // self may be gone as soon as this is given
+        xSemaphoreGive(self->_fillerExited);
+        vTaskDelete(NULL);
+    }
+
+    void release() {
+        if (!_buffer) return;
+        _buffer->stop();
+        if (_fillerExited) {
+            // a card read in flight writes into the ring, however slow the card it has to finish first
+            xSemaphoreTake(_fillerExited, portMAX_DELAY);
+            vSemaphoreDelete(_fillerExited);
+            _fillerExited = nullptr;
+
+            ReadAheadBuffer::Stats st = _buffer->stats();
+            log_d(
+                "Audio buffer: %u underruns (%u ms), %u card reads, lowest %u of %u bytes",
+                st.underruns,
+                st.stalledMs,
+                st.fills,
+                st.lowest,
+                st.capacity
+            );
+        }
+        delete _buffer;
+        _buffer = nullptr;
+        free(_ring);
+        _ring = nullptr;
+    }
+
+    AudioFileSource *_in;
+    uint8_t *_ring = nullptr;
+    ReadAheadBuffer *_buffer = nullptr;
+    TaskHandle_t _filler = nullptr;
+    SemaphoreHandle_t _fillerExited = nullptr; // given by the filler task as it ends
+};
+
+// MP3s are read through an ID3 parser layered on the read-ahead source, which does not delete it
+static void deleteSource(AudioFileSource *source, AudioFileSourceReadAhead *readAhead) {
+    bool layered = readAhead && readAhead != source;
+    delete source;
+    if (layered) delete readAhead;
+}
+
 // ===== ASYNC PLAYBACK STATE =====
 struct AudioPlayerState {
     // Playback objects
     AudioGenerator *generator;
     AudioFileSource *source;
+    AudioFileSourceReadAhead *readAhead; // source or under it, null for RTTTL strings
     AudioOutputI2S *output;
 
     // State management
@@ -54,10 +194,10 @@ struct AudioPlayerState {
     SemaphoreHandle_t mutex;
 
     AudioPlayerState()
-        : generator(nullptr), source(nullptr), output(nullptr), state(PLAYBACK_IDLE), mode(PLAYBACK_BLOCKING),
-          currentFile(""), stopRequested(false), pauseRequested(false), volumeChanged(false), newVolume(0),
-          currentGain(1.0f), startTime(0), pausedTime(0), totalPausedDuration(0), taskHandle(nullptr),
-          mutex(nullptr) {
+        : generator(nullptr), source(nullptr), readAhead(nullptr), output(nullptr), state(PLAYBACK_IDLE),
+          mode(PLAYBACK_BLOCKING), currentFile(""), stopRequested(false), pauseRequested(false),
+          volumeChanged(false), newVolume(0), currentGain(1.0f), startTime(0), pausedTime(0),
+          totalPausedDuration(0), taskHandle(nullptr), mutex(nullptr) {
         mutex = xSemaphoreCreateMutex();
     }
 
@@ -88,8 +228,9 @@ struct AudioPlayerState {
         }
         if (source) {
             source->close();
-            delete source;
+            deleteSource(source, readAhead);
             source = nullptr;
+            readAhead = nullptr;
         }
         if (output) {
             output->stop();
@@ -347,6 +488,8 @@ AudioPlaybackInfo getAudioPlaybackInfo() {
     info.position = 0;
     info.volume = bruceConfig.soundVolume;
     info.isAsyncMode = false;
+    info.bufferUnderruns = 0;
+    info.bufferFill = 0;
 
     if (!g_audioPlayer) return info;
 
@@ -356,6 +499,12 @@ AudioPlaybackInfo getAudioPlaybackInfo() {
         info.volume = bruceConfig.soundVolume;
         info.isAsyncMode = (g_audioPlayer->mode == PLAYBACK_ASYNC);
 
+        ReadAheadBuffer::Stats buffer;
+        if (g_audioPlayer->readAhead && g_audioPlayer->readAhead->stats(buffer)) {
+            info.bufferUnderruns = buffer.underruns;
+            info.bufferFill = buffer.level * 100 / buffer.capacity;
+        }
+
         // Calculate position
         if (g_audioPlayer->state == PLAYBACK_PLAYING) {
             info.position = millis() - g_audioPlayer->startTime - g_audioPlayer->totalPausedDuration;
@@ -387,14 +536,15 @@ void setAudioPlaybackVolume(uint8_t volume) {
 
 // ===== HELPER: Start async playback task =====
 static bool startAsyncPlayback(
-    AudioGenerator *generator, AudioFileSource *source, AudioOutputI2S *output, const String &filename
+    AudioGenerator *generator, AudioFileSource *source, AudioOutputI2S *output, const String &filename,
+    AudioFileSourceReadAhead *readAhead = nullptr
 ) {
     initAudioPlayer();
 
     if (!g_audioPlayer->lock(pdMS_TO_TICKS(1000))) {
         Serial.println("ERROR: Could not acquire lock for async playback");
         delete generator;
-        delete source;
+        deleteSource(source, readAhead);
         delete output;
         _setup_codec_speaker(false);
         return false;
@@ -403,6 +553,7 @@ static bool startAsyncPlayback(
     // Set up state
     g_audioPlayer->generator = generator;
     g_audioPlayer->source = source;
+    g_audioPlayer->readAhead = readAhead;
     g_audioPlayer->output = output;
     g_audioPlayer->state = PLAYBACK_PLAYING;
     g_audioPlayer->mode = PLAYBACK_ASYNC;
@@ -458,7 +609,9 @@ bool playAudioFile(FS *fs, String filepath, PlaybackMode mode) {
 
     _setup_codec_speaker(true);
 
-    AudioFileSource *source = new AudioFileSourceFS(*fs, filepath.c_str());
+    AudioFileSourceReadAhead *readAhead =
+        new AudioFileSourceReadAhead(new AudioFileSourceFS(*fs, filepath.c_str()));
+    AudioFileSource *source = readAhead;
     if (!source) {
         Serial.println("ERROR: Failed to create audio source");
         _setup_codec_speaker(false);
@@ -467,7 +620,7 @@ bool playAudioFile(FS *fs, String filepath, PlaybackMode mode) {
 
     AudioOutputI2S *audioout = createConfiguredAudioOutput();
     if (!audioout) {
-        delete source;
+        deleteSource(source, readAhead);
         _setup_codec_speaker(false);
         return false;
     }
@@ -488,7 +641,7 @@ bool playAudioFile(FS *fs, String filepath, PlaybackMode mode) {
 
     if (!generator) {
         Serial.println("ERROR: Unsupported audio format");
-        delete source;
+        deleteSource(source, readAhead);
         delete audioout;
         _setup_codec_speaker(false);
         return false;
@@ -497,7 +650,7 @@ bool playAudioFile(FS *fs, String filepath, PlaybackMode mode) {
     if (!generator->begin(source, audioout)) {
         Serial.println("ERROR: Failed to begin audio playback");
         delete generator;
-        delete source;
+        deleteSource(source, readAhead);
         delete audioout;
         _setup_codec_speaker(false);
         return false;
@@ -516,7 +669,7 @@ bool playAudioFile(FS *fs, String filepath, PlaybackMode mode) {
         Serial.println("Stop audio");
 
         delete generator;
-        delete source;
+        deleteSource(source, readAhead);
         delete audioout;
 
         _setup_codec_speaker(false);
@@ -525,7 +678,7 @@ bool playAudioFile(FS *fs, String filepath, PlaybackMode mode) {
 
     // === ASYNC MODE ===
     Serial.println("Start audio (async)");
-    return startAsyncPlayback(generator, source, audioout, filepath);
+    return startAsyncPlayback(generator, source, audioout, filepath, readAhead);
 }
 
 bool playAudioRTTTLString(String song, PlaybackMode mode) {
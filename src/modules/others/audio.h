@@ -24,6 +24,8 @@ struct AudioPlaybackInfo {
     unsigned long position; // Current position in ms
     uint8_t volume;
     bool isAsyncMode;
+    uint32_t bufferUnderruns; // Times the read-ahead buffer ran dry while playing a file
+    uint8_t bufferFill;       // Read-ahead buffer level in percent
 };
 
 // Existing functions
@@ -0,0 +1,131 @@
+#include "read_ahead_buffer.h"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+ReadAheadBuffer::ReadAheadBuffer(
+    ReadFn read, void *ctx, uint32_t size, uint8_t *ring, size_t capacity, size_t chunk, size_t lowWater,
+    size_t highWater
+)
+    : _read(read), _ctx(ctx), _size(size), _ring(ring), _capacity(capacity),
+      _chunk(std::min(chunk, capacity)), _low(lowWater ? lowWater : capacity / 2),
+      _high(highWater && highWater < capacity ? highWater : capacity), _end(size), _lowest(capacity) {}
+
+void ReadAheadBuffer::runFiller() {
+    std::unique_lock<std::mutex> lk(_lock);
+    while (!_stopped) {
+        if (_level <= _low) _filling = true;
+        if (_filling && (_level >= _high || _level == _capacity || _fillPos >= _end)) {
+            _filling = false;
+            if (!_primed) {
+                _primed = true;
+                _lowest = _level;
+            }
+        }
+        if (!_filling) {
+            _changed.wait(lk);
+            continue;
+        }
+
+        // the reader never touches the free part of the ring, so the source is read without the lock
+        size_t tail = (_head + _level) % _capacity;
+        size_t n = std::min({_chunk, _capacity - _level, _capacity - tail, (size_t)(_end - _fillPos)});
+        uint32_t at = _fillPos;
+        uint32_t seeks = _seekCount;
+        lk.unlock();
+        size_t got = _read(_ctx, at, _ring + tail, n);
+        lk.lock();
+
+        if (seeks != _seekCount) continue;
+        _fills++;
+        if (got == 0 || got > n) {
+            _end = _fillPos; // nothing more to come, let the reader finish what is buffered
+        } else {
+            _level += got;
+            _fillPos += got;
+        }
+        _changed.notify_all();
+    }
+}
+
+void ReadAheadBuffer::stop() {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stopped = true;
+    _changed.notify_all();
+}
+
+size_t ReadAheadBuffer::take(uint8_t *buffer, size_t len) {
+    size_t done = 0;
+    while (done < len && _level) {
+        size_t n = std::min({len - done, _level, _capacity - _head});
+        memcpy(buffer + done, _ring + _head, n);
+        _head = (_head + n) % _capacity;
+        _level -= n;
+        _readPos += n;
+        done += n;
+    }
+    if (_primed && _fillPos < _end && _level < _lowest) _lowest = _level; // not the drain at the end
+    if (!_filling && _level <= _low) _changed.notify_all();
+    return done;
+}
+
+size_t ReadAheadBuffer::read(uint8_t *buffer, size_t len, uint32_t timeoutMs) {
+    std::unique_lock<std::mutex> lk(_lock);
+    size_t done = 0;
+    while (done < len) {
+        if (_level == 0) {
+            if (_readPos >= _end || _stopped) break;
+            bool underrun = _primed;
+            auto start = std::chrono::steady_clock::now();
+            bool ready = _changed.wait_for(lk, std::chrono::milliseconds(timeoutMs), [this] {
+                return _level || _readPos >= _end || _stopped;
+            });
+            if (underrun) {
+                _underruns++;
+                auto waited = std::chrono::steady_clock::now() - start;
+                _stalledMs += std::chrono::duration_cast<std::chrono::milliseconds>(waited).count();
+            }
+            if (!ready) break;
+            continue;
+        }
+        done += take(buffer + done, len - done);
+    }
+    return done;
+}
+
+size_t ReadAheadBuffer::readAvailable(uint8_t *buffer, size_t len) {
+    std::lock_guard<std::mutex> guard(_lock);
+    return take(buffer, len);
+}
+
+bool ReadAheadBuffer::seek(uint32_t position) {
+    std::lock_guard<std::mutex> guard(_lock);
+    if (position > _size) return false;
+    if (position >= _readPos && position - _readPos <= _level) {
+        size_t skip = position - _readPos;
+        _head = (_head + skip) % _capacity;
+        _level -= skip;
+        _readPos = position;
+    } else {
+        // refilling from elsewhere is not an underrun of the playback
+        _head = 0;
+        _level = 0;
+        _readPos = _fillPos = position;
+        _end = _size;
+        _seekCount++;
+        _filling = true;
+        _primed = false;
+    }
+    _changed.notify_all();
+    return true;
+}
+
+uint32_t ReadAheadBuffer::position() {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _readPos;
+}
+
+ReadAheadBuffer::Stats ReadAheadBuffer::stats() {
+    std::lock_guard<std::mutex> guard(_lock);
+    return {_underruns, _stalledMs, _fills, _level, _lowest, _capacity};
+}
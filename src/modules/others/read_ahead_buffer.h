@@ -0,0 +1,81 @@
+#ifndef __READ_AHEAD_BUFFER_H__
+#define __READ_AHEAD_BUFFER_H__
+
+// Ring buffer kept ahead of a sequential reader (audio decoders) by a filler thread of its own,
+// so slow or contended card reads land in the buffer instead of stalling the reader.
+// The filler sleeps until the level drops to the low watermark, then reads chunk after chunk
+// until the high watermark: the card sees a few long bursts rather than a small read per
+// decoder call. Seeks inside the buffered data just skip ahead, others restart the filler.
+// Underruns (the reader waiting on an empty buffer after the first fill) are counted for
+// diagnostics, together with the time spent waiting and the lowest level reached.
+// No Arduino dependencies, so it can be driven by a fake source with latency spikes on the host.
+
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+class ReadAheadBuffer {
+public:
+    // Reads up to len bytes at offset, 0 at the end of the source or on an error
+    typedef size_t (*ReadFn)(void *ctx, uint32_t offset, uint8_t *buffer, size_t len);
+
+    struct Stats {
+        uint32_t underruns;
+        uint32_t stalledMs; // reader time spent waiting after the first fill
+        uint32_t fills;     // source reads
+        size_t level;
+        size_t lowest; // lowest level once playing, capacity until then
+        size_t capacity;
+    };
+
+    // ring is capacity bytes owned by the caller; watermarks default to half and all of it
+    ReadAheadBuffer(
+        ReadFn read, void *ctx, uint32_t size, uint8_t *ring, size_t capacity, size_t chunk,
+        size_t lowWater = 0, size_t highWater = 0
+    );
+
+    // Filler side: reads until stop(), to be run by a task or thread of its own
+    void runFiller();
+    void stop();
+
+    // Waits until len bytes, the end of the source or timeoutMs without data; returns the count read
+    size_t read(uint8_t *buffer, size_t len, uint32_t timeoutMs);
+    // Only what is buffered already
+    size_t readAvailable(uint8_t *buffer, size_t len);
+    bool seek(uint32_t position);
+
+    uint32_t position();
+    uint32_t size() const { return _size; }
+    Stats stats();
+
+private:
+    size_t take(uint8_t *buffer, size_t len);
+
+    ReadFn _read;
+    void *_ctx;
+    uint32_t _size;
+    uint8_t *_ring;
+    size_t _capacity;
+    size_t _chunk;
+    size_t _low, _high;
+
+    std::mutex _lock;
+    std::condition_variable _changed;
+    size_t _head = 0;  // first buffered byte
+    size_t _level = 0; // bytes buffered
+    uint32_t _readPos = 0;
+    uint32_t _fillPos = 0;
+    uint32_t _end;           // _size, or where the source stopped giving data
+    uint32_t _seekCount = 0; // a read in flight from before a seek is dropped
+    bool _filling = true;
+    bool _primed = false; // first fill done, waiting from now on is an underrun
+    bool _stopped = false;
+
+    uint32_t _underruns = 0;
+    uint32_t _stalledMs = 0;
+    uint32_t _fills = 0;
+    size_t _lowest;
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include "rf_decoder.h"
+#include "protocols/Ansonic.h"
+#include "protocols/Came.h"
+#include "protocols/Chamberlain.h"
+#include "protocols/Holtek.h"
+#include "protocols/Linear.h"
+#include "protocols/NiceFlo.h"
+#include <string.h>
+
+static RfPulseWindow makeWindow(int duration) {
+    RfPulseWindow w;
+    w.high = duration > 0;
+    w.gap = false;
+    uint32_t width = duration < 0 ? (uint32_t)(-duration) : (uint32_t)duration;
+    w.nominal = width;
+    if (width < 50) {
+        // Placeholder pulses (e.g. Linear's 1us stop) only constrain the level
+        w.min = 0;
+        w.max = UINT32_MAX;
+        w.nominal = 0;
+    } else if (!w.high && width >= RF_DECODER_GAP_US) {
+        // Inter-frame gaps vary a lot between remotes, but an unbounded gap would take any other
+        // protocol's pilot for this one's
+        w.min = width / 2;
+        w.max = width * 2;
+        w.gap = true;
+    } else {
+        uint32_t tol = width * RF_DECODER_TOLERANCE_PCT / 100;
+        if (tol < RF_DECODER_MIN_TOLERANCE) tol = RF_DECODER_MIN_TOLERANCE;
+        w.min = width > tol ? width - tol : 0;
+        w.max = width + tol;
+    }
+    return w;
+}
+
+static bool compilePattern(const std::vector<int> &src, RfPulsePattern &out) {
+    out.len = 0;
+    if (src.size() > RF_DECODER_MAX_SEQ) return false;
+    for (int d : src) out.pulse[out.len++] = makeWindow(d);
+    return true;
+}
+
+static inline bool matches(const RfPulseWindow &w, uint32_t width, bool high) {
+    return w.high == high && width >= w.min && width <= w.max;
+}
+
+// Distance from the nominal width in per mille, summed to rank the protocols that complete together
+static inline uint32_t deviation(const RfPulseWindow &w, uint32_t width) {
+    if (w.nominal == 0) return 0;
+    uint32_t diff = width > w.nominal ? width - w.nominal : w.nominal - width;
+    return (uint32_t)((uint64_t)diff * 1000 / w.nominal);
+}
+
+static inline bool isPlaceholder(const RfPulseWindow &w) { return w.min == 0 && w.max == UINT32_MAX; }
+
+// True if the stop pattern is nothing but placeholders and gaps, i.e. already covered by a merged gap
+static bool stopIsGapOnly(const RfPulsePattern &stop) {
+    for (uint8_t i = 0; i < stop.len; ++i) {
+        if (!stop.pulse[i].gap && !isPlaceholder(stop.pulse[i])) return false;
+    }
+    return true;
+}
+
+bool rfCompileProtocol(const c_rf_protocol &proto, const char *name, uint8_t bits, RfCompiledProtocol &out) {
+    auto zero = proto.transposition_table.find('0');
+    auto one = proto.transposition_table.find('1');
+    if (zero == proto.transposition_table.end() || one == proto.transposition_table.end()) return false;
+    if (zero->second.empty() || zero->second.size() != one->second.size()) return false;
+    if (bits == 0 || bits > 64) return false;
+
+    memset(&out, 0, sizeof(out));
+    out.name = name;
+    out.bits = bits;
+    if (!compilePattern(proto.pilot_period, out.pilot) || !compilePattern(zero->second, out.bit[0]) ||
+        !compilePattern(one->second, out.bit[1]) || !compilePattern(proto.stop_bit, out.stop)) {
+        return false;
+    }
+
+    uint32_t te = UINT32_MAX;
+    for (int b = 0; b < 2; ++b) {
+        for (int d : (b ? one->second : zero->second)) {
+            uint32_t width = d < 0 ? -d : d;
+            if (width >= 50 && width < te) te = width;
+        }
+    }
+    out.te = te == UINT32_MAX ? 0 : te;
+    return true;
+}
+
+bool RfPulseDecoder::addProtocol(const RfCompiledProtocol &proto) {
+    if (_count >= RF_DECODER_MAX_PROTOCOLS) return false;
+    _protocols[_count] = proto;
+    restart(_protocols[_count], _machines[_count]);
+    _count++;
+    return true;
+}
+
+void RfPulseDecoder::addDefaultProtocols() {
+    // Descriptions are only needed while compiling, the std::map storage is freed afterwards
+    RfCompiledProtocol compiled;
+    if (rfCompileProtocol(protocol_came(), "Came", 12, compiled)) addProtocol(compiled);
+    if (rfCompileProtocol(protocol_nice_flo(), "Nice Flo", 12, compiled)) addProtocol(compiled);
+    if (rfCompileProtocol(protocol_ansonic(), "Ansonic", 12, compiled)) addProtocol(compiled);
+    if (rfCompileProtocol(protocol_holtek(), "Holtek", 12, compiled)) addProtocol(compiled);
+    if (rfCompileProtocol(protocol_chamberlain(), "Chamberlain", 12, compiled)) addProtocol(compiled);
+    if (rfCompileProtocol(protocol_linear(), "Linear", 12, compiled)) addProtocol(compiled);
+}
+
+void RfPulseDecoder::reset() {
+    for (size_t i = 0; i < _count; ++i) restart(_protocols[i], _machines[i]);
+}
+
+void RfPulseDecoder::restart(const RfCompiledProtocol &p, Machine &m) {
+    m.stage = p.pilot.len ? STAGE_PILOT : STAGE_BITS;
+    m.pos = 0;
+    m.bitCount = 0;
+    m.bitMask = 3;
+    m.code = 0;
+    m.deviation = 0;
+    m.bitDeviation[0] = m.bitDeviation[1] = 0;
+    m.pulses = 0;
+}
+
+bool RfPulseDecoder::step(const RfCompiledProtocol &p, Machine &m, uint32_t width, bool high) {
+    // A mismatch restarts the machine and gives the same pulse one more try as a frame start
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool fresh = m.pos == 0 && m.bitCount == 0 && m.stage == (p.pilot.len ? STAGE_PILOT : STAGE_BITS);
+
+        if (m.stage == STAGE_PILOT) {
+            const RfPulseWindow &w = p.pilot.pulse[m.pos];
+            // Silence before the first frame of a capture leads into the pilot too, scored as the longest gap
+            bool silence = m.pos == 0 && w.gap && !high && width > w.max;
+            if (silence || matches(w, width, high)) {
+                m.deviation += silence ? deviation(w, w.max) : deviation(w, width);
+                m.pulses++;
+                if (++m.pos == p.pilot.len) {
+                    m.stage = STAGE_BITS;
+                    m.pos = 0;
+                    m.bitMask = 3;
+                }
+                return false;
+            }
+        } else if (m.stage == STAGE_BITS) {
+            const uint8_t len = p.bit[0].len;
+            uint8_t mask = 0;
+            for (uint8_t b = 0; b < 2; ++b) {
+                if ((m.bitMask & (1 << b)) && matches(p.bit[b].pulse[m.pos], width, high)) {
+                    mask |= 1 << b;
+                    m.bitDeviation[b] += deviation(p.bit[b].pulse[m.pos], width);
+                }
+            }
+            // The trailing low of the last bit usually merges into the inter-frame gap
+            bool mergedGap = false;
+            if (!mask && m.pos == len - 1 && m.bitCount == p.bits - 1 && !high && m.bitMask != 3 &&
+                width >= RF_DECODER_GAP_US && !p.bit[0].pulse[m.pos].high && !p.bit[1].pulse[m.pos].high) {
+                mask = m.bitMask;
+                mergedGap = true;
+            }
+            if (mask) {
+                m.bitMask = mask;
+                if (!mergedGap) m.pulses++;
+                if (++m.pos < len) return false;
+                if (mask == 3) {
+                    restart(p, m); // both patterns fit, timing too loose to tell
+                    return false;
+                }
+                m.code = (m.code << 1) | (mask == 2 ? 1 : 0);
+                m.deviation += m.bitDeviation[mask == 2 ? 1 : 0];
+                m.bitDeviation[0] = m.bitDeviation[1] = 0;
+                m.bitCount++;
+                m.pos = 0;
+                m.bitMask = 3;
+                if (m.bitCount < p.bits) return false;
+                if (p.stop.len == 0 || (mergedGap && stopIsGapOnly(p.stop))) return true;
+                m.stage = STAGE_STOP;
+                return false;
+            }
+        } else {
+            // Placeholder pulses may be absent from the capture altogether
+            while (m.pos < p.stop.len - 1 && isPlaceholder(p.stop.pulse[m.pos]) &&
+                   p.stop.pulse[m.pos].high != high) {
+                m.pos++;
+            }
+            if (matches(p.stop.pulse[m.pos], width, high)) {
+                m.deviation += deviation(p.stop.pulse[m.pos], width);
+                m.pulses++;
+                if (++m.pos == p.stop.len) return true;
+                return false;
+            }
+        }
+
+        if (fresh) return false; // already tried as a frame start
+        restart(p, m);
+    }
+    return false;
+}
+
+bool RfPulseDecoder::feed(int32_t duration, RfDecodeResult &result) {
+    if (duration == 0) return false;
+    const bool high = duration > 0;
+    const uint32_t width = high ? (uint32_t)duration : (uint32_t)(-duration);
+    bool found = false;
+    uint32_t bestDeviation = 0;
+    uint16_t bestPulses = 1;
+    for (size_t i = 0; i < _count; ++i) {
+        Machine &m = _machines[i];
+        if (!step(_protocols[i], m, width, high)) continue;
+        // Lowest mean deviation, compared without dividing
+        uint16_t pulses = m.pulses ? m.pulses : 1;
+        if (!found || (uint64_t)m.deviation * bestPulses < (uint64_t)bestDeviation * pulses) {
+            result.name = _protocols[i].name;
+            result.code = m.code;
+            result.bits = _protocols[i].bits;
+            result.te = _protocols[i].te;
+            bestDeviation = m.deviation;
+            bestPulses = pulses;
+            found = true;
+        }
+        restart(_protocols[i], m);
+    }
+    return found;
+}
+
+bool RfPulseDecoder::decode(const int32_t *durations, size_t count, RfDecodeResult &result) {
+    reset();
+    for (size_t i = 0; i < count; ++i) {
+        if (feed(durations[i], result)) return true;
+    }
+    return false;
+}
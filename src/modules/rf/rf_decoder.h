@@ -0,0 +1,89 @@
+#ifndef __RF_DECODER_H__
+#define __RF_DECODER_H__
+
+// Streaming decoder for the fixed-code protocols in protocols/*.h.
+// Each protocol description is compiled once into flat min/max timing windows;
+// after that feed() runs every protocol's state machine on one pulse with no heap use.
+// No Arduino dependencies, so it can be built and fed recorded captures on the host.
+
+#include "protocols/protocol.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define RF_DECODER_MAX_PROTOCOLS 8
+#define RF_DECODER_MAX_SEQ 4      // pulses per pilot/bit/stop pattern
+#define RF_DECODER_TOLERANCE_PCT 25
+#define RF_DECODER_MIN_TOLERANCE 100 // us
+#define RF_DECODER_GAP_US 5000       // longer lows are gaps, matched from half to twice their width
+
+struct RfPulseWindow {
+    uint32_t min;
+    uint32_t max;
+    uint32_t nominal; // width of the description, 0 for placeholders
+    bool high;        // sign of the pulse: true = carrier on
+    bool gap;
+};
+
+struct RfPulsePattern {
+    RfPulseWindow pulse[RF_DECODER_MAX_SEQ];
+    uint8_t len;
+};
+
+struct RfCompiledProtocol {
+    const char *name;
+    RfPulsePattern pilot;
+    RfPulsePattern bit[2];
+    RfPulsePattern stop;
+    uint8_t bits; // code length in bits
+    uint16_t te;  // shortest nominal pulse, reported with the result
+};
+
+struct RfDecodeResult {
+    const char *name;
+    uint64_t code;
+    uint8_t bits;
+    uint16_t te;
+};
+
+// Converts a transposition-table description. Returns false if the protocol has no tables.
+bool rfCompileProtocol(const c_rf_protocol &proto, const char *name, uint8_t bits, RfCompiledProtocol &out);
+
+class RfPulseDecoder {
+public:
+    RfPulseDecoder() = default;
+
+    bool addProtocol(const RfCompiledProtocol &proto);
+    // Registers the built-in protocols (12-bit codes, as used by the bruteforcer)
+    void addDefaultProtocols();
+    size_t protocolCount() const { return _count; }
+
+    // duration in us, positive = high, negative = low. Returns true when a code completed.
+    // When several protocols complete on the same pulse, the one closest to its nominal timings wins.
+    bool feed(int32_t duration, RfDecodeResult &result);
+    // Feeds a whole capture, stops at the first decoded code
+    bool decode(const int32_t *durations, size_t count, RfDecodeResult &result);
+    void reset();
+
+private:
+    enum Stage : uint8_t { STAGE_PILOT, STAGE_BITS, STAGE_STOP };
+
+    struct Machine {
+        Stage stage;
+        uint8_t pos;      // index inside the current pattern
+        uint8_t bitCount; // bits shifted in so far
+        uint8_t bitMask;  // candidate bit values for the current bit (bit0 = '0', bit1 = '1')
+        uint64_t code;
+        uint32_t deviation;       // sum of the per-mille deviations of the matched pulses
+        uint32_t bitDeviation[2]; // of the current bit, by candidate value
+        uint16_t pulses;          // matched pulses
+    };
+
+    bool step(const RfCompiledProtocol &p, Machine &m, uint32_t width, bool high);
+    void restart(const RfCompiledProtocol &p, Machine &m);
+
+    RfCompiledProtocol _protocols[RF_DECODER_MAX_PROTOCOLS];
+    Machine _machines[RF_DECODER_MAX_PROTOCOLS];
+    size_t _count = 0;
+};
+
+#endif
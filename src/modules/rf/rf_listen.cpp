@@ -1,6 +1,7 @@
 #include "rf_listen.h"
 
 #include "../others/audio.h"
+#include "rf_decoder.h"
 
 volatile unsigned long lastMicros = 0;
 volatile unsigned long pulseMicros = 0;
@@ -8,11 +9,27 @@ volatile float ___frequency = 0;
 volatile unsigned long pulseDuration = 0;
 volatile bool newPulse = false;
 
+// Signed edge-to-edge durations (+high/-low) for the protocol decoder, drained by the UI loop
+#define LISTEN_PULSE_RING 256
+volatile int32_t listenPulses[LISTEN_PULSE_RING];
+volatile uint16_t listenPulseHead = 0;
+volatile uint16_t listenPulseTail = 0;
+volatile unsigned long lastEdgeMicros = 0;
+
 void IRAM_ATTR onPulse() {
     static bool wasHigh = false;
     unsigned long now = micros();
+    bool level = digitalRead(bruceConfigPins.CC1101_bus.io0);
+
+    uint32_t edge = now - lastEdgeMicros;
+    lastEdgeMicros = now;
+    uint16_t next = (listenPulseHead + 1) % LISTEN_PULSE_RING;
+    if (next != listenPulseTail) { // drop on overflow, the decoder resyncs on the next frame
+        listenPulses[listenPulseHead] = level ? -(int32_t)edge : (int32_t)edge;
+        listenPulseHead = next;
+    }
 
-    if (digitalRead(bruceConfigPins.CC1101_bus.io0)) {
+    if (level) {
         pulseDuration = now - lastMicros;
         ___frequency = 1000000.0 / pulseDuration;
         newPulse = true;
@@ -60,6 +77,11 @@ void rf_listen() {
     ELECHOUSE_cc1101.setRxBW(58);
     ELECHOUSE_cc1101.setModulation(2);
     ELECHOUSE_cc1101.setDcFilterOff(true);
+    RfPulseDecoder decoder;
+    decoder.addDefaultProtocols();
+    RfDecodeResult known;
+    listenPulseHead = listenPulseTail = 0;
+    lastEdgeMicros = micros();
     attachInterrupt(digitalPinToInterrupt(bruceConfigPins.CC1101_bus.io0), onPulse, CHANGE);
     displayRedStripe("Listening...", getComplementaryColor2(bruceConfig.priColor), bruceConfig.priColor);
 
@@ -72,7 +94,22 @@ void rf_listen() {
         displayRedStripe(
             "Waiting for a pulse", getComplementaryColor2(bruceConfig.priColor), bruceConfig.priColor
         );
-        if (newPulse) {
+        bool knownFound = false;
+        while (listenPulseTail != listenPulseHead) {
+            int32_t duration = listenPulses[listenPulseTail];
+            listenPulseTail = (listenPulseTail + 1) % LISTEN_PULSE_RING;
+            if (decoder.feed(duration, known)) knownFound = true;
+        }
+        if (knownFound) {
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%llX", (unsigned long long)known.code);
+            String text = String(known.name) + " 0x" + hex;
+            Serial.println("Decoded " + text + " (" + String(known.bits) + " bits)");
+            displayRedStripe(text, getComplementaryColor2(bruceConfig.priColor), bruceConfig.priColor);
+            lastPulseTime = millis();
+            pulseActive = true;
+            newPulse = false;
+        } else if (newPulse) {
             newPulse = false;
             lastPulseTime = millis();
             pulseActive = true;
@@ -4,14 +4,20 @@
 #include "core/type_convertion.h"
 #include "rf_send.h"
 #include <globals.h>
+#include <new>
 #include <sstream>
 
 RFScan::RFScan() { setup(); }
 
-RFScan::~RFScan() { deinitRfModule(); }
+RFScan::~RFScan() {
+    delete sweep;
+    deinitRfModule();
+}
 
 void RFScan::setup() {
     if (!initRfModule("rx", bruceConfigPins.rfFreq)) { return; }
+    sweepRange = -1; // the module was re-initialised, plan again before the next fast scan
+    if (decoder.protocolCount() == 0) decoder.addDefaultProtocols();
 
     RCSwitch_Enable_Receive(rcswitch);
 
@@ -84,16 +90,26 @@ void RFScan::init_freqs() {
 }
 
 bool RFScan::fast_scan() {
-
-    if (idx < range_limits[bruceConfigPins.rfScanRange][0] ||
-        idx > range_limits[bruceConfigPins.rfScanRange][1]) {
-        idx = range_limits[bruceConfigPins.rfScanRange][0];
+    const int first = range_limits[bruceConfigPins.rfScanRange][0];
+    const int last = range_limits[bruceConfigPins.rfScanRange][1];
+
+    if (idx < first || idx > last) { idx = first; }
+    if (!sweep) sweep = new (std::nothrow) RfSweepEngine();
+    if (sweep && sweepRange != bruceConfigPins.rfScanRange) {
+        sweepRadio.begin();
+        sweep->begin(&sweepRadio, &subghz_frequency_list[first], last - first + 1);
+        sweepRange = bruceConfigPins.rfScanRange;
     }
     float checkFrequency = subghz_frequency_list[idx];
-    setMHZ(checkFrequency);
-    tft.drawPixel(0, 0, 0); // To make sure CC1101 shared with TFT works properly
-    vTaskDelay(5 / portTICK_PERIOD_MS);
-    rssi = ELECHOUSE_cc1101.getRssi();
+    if (sweep) {
+        // cached calibration per band and an RSSI wait sized from the data rate, no fixed 5ms delay
+        rssi = sweep->measure(idx - first);
+    } else {
+        setMHZ(checkFrequency);
+        tft.drawPixel(0, 0, 0); // To make sure CC1101 shared with TFT works properly
+        vTaskDelay(5 / portTICK_PERIOD_MS);
+        rssi = ELECHOUSE_cc1101.getRssi();
+    }
     if (rssi > rssiThreshold) {
         _freqs[_try].freq = checkFrequency;
         _freqs[_try].rssi = rssi;
@@ -106,6 +122,8 @@ bool RFScan::fast_scan() {
 
             bruceConfigPins.setRfFreq(_freqs[max_index].freq, 2); // change to fixed frequency
             frequency = _freqs[max_index].freq;
+            sweepRadio.end();
+            sweepRange = -1;
             setMHZ(frequency);
             Serial.println("Frequency Found: " + String(frequency));
             rcswitch.resetAvailable();
@@ -157,8 +175,12 @@ void RFScan::read_raw() {
     std::vector<int> indexed_durations;
     uint64_t result = 0;
     uint8_t repetition = 0;
+    RfDecodeResult known;
+    bool knownFound = false;
 
     received.te = 0;
+    received.decoded = "";
+    decoder.reset();
     for (transitions = 0; transitions < RCSWITCH_RAW_MAX_CHANGES; transitions++) {
         if (raw[transitions] == 0) break;
         if (transitions > 0) _data += " ";
@@ -168,6 +190,7 @@ void RFScan::read_raw() {
         if (duration < -5000 && repetition < 2) { repetition += 1; }
         _data += String(duration);
         if (received.te == 0 && duration > 0) received.te = duration;
+        if (!decoded && !knownFound) knownFound = decoder.feed(duration, known);
 
         if (!decoded && repetition == 1 && duration >= -5000) {
             int index = find_pulse_index(indexed_durations, duration);
@@ -181,6 +204,12 @@ void RFScan::read_raw() {
 
     received.data = _data;
     received.filepath = "signal_" + String(signals);
+    if (knownFound) {
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%llX", (unsigned long long)known.code);
+        received.decoded = String(known.name) + " " + String(known.bits) + "bit 0x" + hex;
+        Serial.println("Decoded " + received.decoded);
+    }
     received.frequency = long(frequency * 1000000);
 
     // if there is a value decoded by RCSwitch, show it
@@ -332,6 +361,7 @@ void RFScan::reset_signals() {
     received.key = 0;
     received.preset = "";
     received.protocol = "";
+    received.decoded = "";
     signals = 0;
 }
 
@@ -440,6 +470,7 @@ void display_signal_data(RfCodes received) {
 
     if (received.protocol == "RAW") padprintln("CRC: " + String(hexString));
     else padprintln("Key: " + String(hexString));
+    if (received.decoded != "") padprintln("Decoded: " + received.decoded);
 
     // if (bruceConfigPins.rfModule == CC1101_SPI_MODULE) {
     //     int rssi = ELECHOUSE_cc1101.getRssi();
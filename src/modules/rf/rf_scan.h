@@ -1,6 +1,7 @@
 #ifndef __RF_SCAN_H__
 #define __RF_SCAN_H__
 
+#include "rf_decoder.h"
 #include "rf_utils.h"
 #include "structs.h"
 #include <RCSwitch.h>
@@ -35,6 +36,10 @@ public:
 
 private:
     RCSwitch rcswitch = RCSwitch();
+    RfPulseDecoder decoder;
+    RfSweepEngine *sweep = nullptr; // fast scan hops, allocated on first use
+    CC1101SweepRadio sweepRadio;
+    int sweepRange = -1; // range the sweep was planned for
     RfCodes received;
     String title = "RF Scan Copy";
     bool restartScan = false;
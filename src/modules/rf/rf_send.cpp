@@ -1,8 +1,12 @@
 #include "rf_send.h"
 #include "core/type_convertion.h"
 #include "rf_utils.h"
+#include "sub_parser.h"
 #include <RCSwitch.h>
 
+#define SUB_TX_MAX_TIMINGS 2048 // RAW timings buffered per send without PSRAM
+#define SUB_TX_MAX_TIMINGS_PSRAM 32768
+
 void sendCustomRF() {
     // interactive menu part only
     FS *fs = NULL;
@@ -35,137 +39,306 @@ void sendCustomRF() {
     }
 }
 
-bool txSubFile(FS *fs, String filepath, bool hideDefaultUI) {
-    struct RfCodes selected_code;
-    File databaseFile;
-    String line;
-    String txt;
+// Radio settings derived from a Flipper preset name
+struct RfTxPreset {
+    byte modulation = 2; // possible values for CC1101: 0 = 2-FSK, 1 =GFSK, 2=ASK, 3 = 4-FSK, 4 = MSK
+    float deviation = 1.58;
+    float rxBW = 270.83; // Receive bandwidth
+    float dataRate = 10; // Data Rate
+    int rcswitchProtocol = 1;
+};
+
+// State shared with the parser callback while a .sub file is transmitted
+struct SubTxContext {
+    SubParser parser;
+    File file;
+    const char *mem = nullptr; // whole file, when the SD card can't stay up during TX
+    size_t memLen = 0;
+    const SubCode *replay = nullptr; // indexed code being replayed from its file span
+    std::vector<SubCode> *record = nullptr;
+
+    RfCodes code; // reused between codes, keeps the String buffers
+    RfTxPreset preset;
+    uint32_t frequency = 0;
+    uint8_t presetId = SUB_NO_STRING;
+    bool radioOn = false;
+    bool hideDefaultUI = false;
+    bool aborted = false;
     int sent = 0;
+    int total = 0;
+};
+
+static bool rfPresetFromName(const String &preset, RfTxPreset &cfg);
+static bool rfBeginTx(uint32_t frequency, const RfTxPreset &cfg);
+static void rfTransmit(RfCodes &rfcode, const RfTxPreset &cfg, bool hideDefaultUI);
+
+static size_t subRead(SubTxContext &tx, uint32_t offset, char *buf, size_t len) {
+    if (tx.mem) {
+        if (offset >= tx.memLen) return 0;
+        if (len > tx.memLen - offset) len = tx.memLen - offset;
+        memcpy(buf, tx.mem + offset, len);
+        return len;
+    }
+    if (!tx.file.seek(offset)) return 0;
+    return tx.file.read((uint8_t *)buf, len);
+}
+
+// Joins the values of a code's data lines ("RAW_Data: 1 -2", "Data_RAW: 01 02") into one string
+static void subReadValues(SubTxContext &tx, const SubCode &code, String &out) {
+    out = "";
+    out.reserve(code.length);
+    char buf[128];
+    bool inValue = false;
+    uint32_t done = 0;
+    while (done < code.length) {
+        size_t want = code.length - done < sizeof(buf) ? code.length - done : sizeof(buf);
+        size_t got = subRead(tx, code.offset + done, buf, want);
+        if (!got) break;
+        size_t start = 0;
+        for (size_t i = 0; i < got; ++i) {
+            char c = buf[i];
+            if (inValue && (c == '\n' || c == '\r')) {
+                out.concat(buf + start, i - start);
+                inValue = false;
+            } else if (!inValue && c == ':') {
+                inValue = true;
+                start = i + 1;
+                out += ' ';
+            }
+        }
+        if (inValue) {
+            out.concat(buf + start, got - start);
+            start = 0;
+        }
+        done += got;
+    }
+    out.trim();
+}
+
+static bool subSelectRadio(SubTxContext &tx, const SubCode &code) {
+    if (tx.radioOn && tx.frequency == code.frequency && tx.presetId == code.preset) return true;
+    // Re-init only when the frequency or preset actually changes
+    if (tx.radioOn) deinitRfModule();
+    tx.radioOn = false;
+    if (!rfPresetFromName(String(tx.parser.string(code.preset)), tx.preset)) return false;
+    if (!rfBeginTx(code.frequency, tx.preset)) return false;
+    tx.radioOn = true;
+    tx.frequency = code.frequency;
+    tx.presetId = code.preset;
+    return true;
+}
+
+static void onSubCode(void *ctx, const SubCode &parsed, int *timings, size_t count, bool partial) {
+    SubTxContext &tx = *(SubTxContext *)ctx;
+    if (tx.aborted) return;
+    const SubCode &code = tx.replay ? *tx.replay : parsed;
+    if (!partial && tx.record) tx.record->push_back(parsed);
 
+    if (!code.frequency || code.preset == SUB_NO_STRING || code.protocol == SUB_NO_STRING) {
+        Serial.println("Skipping code without Frequency/Preset/Protocol");
+        return;
+    }
+    if (!subSelectRadio(tx, code)) {
+        tx.aborted = true;
+        return;
+    }
+
+    tx.code.frequency = code.frequency;
+    tx.code.preset = tx.parser.string(code.preset);
+    tx.code.protocol = tx.parser.string(code.protocol);
+    tx.code.te = code.te;
+    if (code.type == SUB_CODE_RAW) {
+        if (count) RCSwitch_RAW_send(timings);
+        if (partial) return;
+        tx.code.data = "";
+    } else if (code.type == SUB_CODE_KEY) {
+        tx.code.key = code.key;
+        tx.code.Bit = code.bits;
+        rfTransmit(tx.code, tx.preset, true);
+    } else {
+        tx.code.Bit = code.bits;
+        subReadValues(tx, code, tx.code.data);
+        rfTransmit(tx.code, tx.preset, true);
+    }
+
+    tx.sent++;
+    if (!tx.hideDefaultUI) {
+        if (tx.total) displayTextLine("Sent " + String(tx.sent) + "/" + String(tx.total));
+        else displayTextLine("Sent " + String(tx.sent));
+    }
+    if (check(EscPress)) tx.aborted = true;
+}
+
+static bool
+loadSubIndex(FS *fs, const String &path, File &src, SubIndexHeader &hdr, std::vector<SubCode> &codes) {
+    File idx = fs->open(path, FILE_READ);
+    if (!idx) return false;
+    bool ok = idx.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == SUB_INDEX_MAGIC &&
+              hdr.version == SUB_INDEX_VERSION && hdr.stringCount <= SUB_MAX_STRINGS &&
+              hdr.sourceSize == src.size() && hdr.sourceMtime == (uint32_t)src.getLastWrite() &&
+              idx.size() == sizeof(hdr) + hdr.codeCount * sizeof(SubCode);
+    if (ok) {
+        codes.resize(hdr.codeCount);
+        size_t bytes = hdr.codeCount * sizeof(SubCode);
+        ok = idx.read((uint8_t *)codes.data(), bytes) == bytes;
+    }
+    idx.close();
+    if (!ok) codes.clear();
+    return ok;
+}
+
+static void
+saveSubIndex(FS *fs, const String &path, File &src, const SubParser &parser, std::vector<SubCode> &codes) {
+    SubIndexHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = SUB_INDEX_MAGIC;
+    hdr.version = SUB_INDEX_VERSION;
+    hdr.stringCount = parser.stringCount();
+    hdr.codeCount = codes.size();
+    hdr.sourceSize = src.size();
+    hdr.sourceMtime = (uint32_t)src.getLastWrite();
+    for (uint8_t i = 0; i < hdr.stringCount; ++i) {
+        strncpy(hdr.strings[i], parser.string(i), SUB_STRING_LEN - 1);
+    }
+
+    File idx = fs->open(path, FILE_WRITE);
+    if (!idx) return;
+    idx.write((const uint8_t *)&hdr, sizeof(hdr));
+    idx.write((const uint8_t *)codes.data(), codes.size() * sizeof(SubCode));
+    idx.close();
+}
+
+bool txSubFile(FS *fs, String filepath, bool hideDefaultUI) {
     if (!fs) return false;
 
-    databaseFile = fs->open(filepath, FILE_READ);
+    SubTxContext tx;
+    tx.hideDefaultUI = hideDefaultUI;
+    tx.file = fs->open(filepath, FILE_READ);
 
     if (!hideDefaultUI) { drawMainBorder(); }
 
-    if (!databaseFile) {
+    if (!tx.file) {
         Serial.println("Failed to open database file.");
         displayError("Fail to open file", true);
         return false;
     }
     Serial.println("Opened sub file.");
-    selected_code.filepath = filepath.substring(1 + filepath.lastIndexOf("/"));
-
-    std::vector<int> bitList;
-    std::vector<int> bitRawList;
-    std::vector<uint64_t> keyList;
-    std::vector<String> rawDataList;
-
-    if (!databaseFile) Serial.println("Fail opening file");
-    // Store the code(s) in the signal
-    while (databaseFile.available()) {
-        line = databaseFile.readStringUntil('\n');
-        txt = line.substring(line.indexOf(":") + 1);
-        if (txt.endsWith("\r")) txt.remove(txt.length() - 1);
-        txt.trim();
-        if (line.startsWith("Protocol:")) selected_code.protocol = txt;
-        if (line.startsWith("Preset:")) selected_code.preset = txt;
-        if (line.startsWith("Frequency:")) selected_code.frequency = txt.toInt();
-        if (line.startsWith("TE:")) selected_code.te = txt.toInt();
-        if (line.startsWith("Bit:")) bitList.push_back(txt.toInt()); // selected_code.Bit = txt.toInt();
-        if (line.startsWith("Bit_RAW:"))
-            bitRawList.push_back(txt.toInt()); // selected_code.BitRAW = txt.toInt();
-        if (line.startsWith("Key:"))
-            keyList.push_back(
-                hexStringToDecimal(txt.c_str())
-            ); // selected_code.key = hexStringToDecimal(txt.c_str());
-        if (line.startsWith("RAW_Data:") || line.startsWith("Data_RAW:"))
-            rawDataList.push_back(txt); // selected_code.data = txt;
-        if (check(EscPress)) break;
+    tx.code.filepath = filepath.substring(1 + filepath.lastIndexOf("/"));
+
+    // Side-car index: code offsets, frequency and preset, so KEY codes need no parsing at all
+    // and RAW codes are replayed straight from their file span
+    const String indexPath = filepath + SUB_INDEX_EXT;
+    SubIndexHeader hdr;
+    std::vector<SubCode> codes;
+    bool indexed = loadSubIndex(fs, indexPath, tx.file, hdr, codes);
+
+    // Single-pinned modules may share a pin with the SD bus, which is shut down for TX
+    if (fs == &SD && bruceConfigPins.rfModule != CC1101_SPI_MODULE &&
+        bruceConfigPins.SDCARD_bus.checkConflict(bruceConfigPins.rfTx)) {
+        tx.file.close();
+        tx.mem = readBigFile(fs, filepath, false, &tx.memLen);
+        if (!tx.mem) {
+            displayError("Not enough memory", true);
+            return false;
+        }
     }
-    int total = bitList.size() + bitRawList.size() + keyList.size() + rawDataList.size() > 0 ? 1 : 0;
-    Serial.printf("Total signals found: %d\n", total);
-    databaseFile.close();
-
-    // If the signal is complete, send all of the code(s) that were found in it.
-    // TODO: try to minimize the overhead between codes.
-    if (selected_code.protocol != "" && selected_code.preset != "" && selected_code.frequency > 0) {
-        for (int bit : bitList) {
-            selected_code.Bit = bit;
-            sendRfCommand(selected_code, hideDefaultUI);
-            sent++;
-            if (!hideDefaultUI) {
-                if (check(EscPress)) break;
-                displayTextLine("Sent " + String(sent) + "/" + String(total));
-            }
+
+    size_t maxPulses = psramFound() ? SUB_TX_MAX_TIMINGS_PSRAM : SUB_TX_MAX_TIMINGS;
+    size_t timingCap = maxPulses;
+    if (indexed) {
+        // Whole RAW codes fit when possible, so they go out without read gaps
+        uint32_t longest = 0;
+        for (const SubCode &c : codes) {
+            if (c.type == SUB_CODE_RAW && c.pulses > longest) longest = c.pulses;
         }
-        for (int bitRaw : bitRawList) {
-            selected_code.Bit = bitRaw;
-            sendRfCommand(selected_code, hideDefaultUI);
-            sent++;
-            if (!hideDefaultUI) {
-                if (check(EscPress)) break;
-                displayTextLine("Sent " + String(sent) + "/" + String(total));
+        timingCap = longest + 1 < maxPulses ? longest + 1 : maxPulses;
+    }
+    size_t timingBytes = timingCap * sizeof(int);
+    int *timings = (int *)(psramFound() ? ps_malloc(timingBytes) : malloc(timingBytes));
+    if (!timings) {
+        Serial.println("Failed to allocate RAW timings buffer");
+        if (tx.mem) free((void *)tx.mem);
+        tx.file.close();
+        return false;
+    }
+    tx.parser.begin(onSubCode, &tx, timings, timingCap);
+
+    char chunk[512];
+    if (indexed) {
+        tx.parser.setStrings(hdr.strings, hdr.stringCount);
+        tx.total = codes.size();
+        Serial.printf("Total signals found: %d (indexed)\n", tx.total);
+        for (const SubCode &c : codes) {
+            if (tx.aborted) break;
+            if (c.type != SUB_CODE_RAW) {
+                onSubCode(&tx, c, nullptr, 0, false);
+                continue;
             }
-        }
-        for (uint64_t key : keyList) {
-            selected_code.key = key;
-            sendRfCommand(selected_code, hideDefaultUI);
-            sent++;
-            if (!hideDefaultUI) {
-                if (check(EscPress)) break;
-                displayTextLine("Sent " + String(sent) + "/" + String(total));
+            tx.replay = &c;
+            tx.parser.seek(c.offset);
+            for (uint32_t done = 0; done < c.length && !tx.aborted;) {
+                size_t want = c.length - done < sizeof(chunk) ? c.length - done : sizeof(chunk);
+                size_t got = subRead(tx, c.offset + done, chunk, want);
+                if (!got) break;
+                tx.parser.feed(chunk, got);
+                done += got;
             }
+            tx.parser.finish();
+            tx.replay = nullptr;
         }
-
-        // RAS_Data is considered one long signal, doesn't matter the number of lines it has
-        if (rawDataList.size() > 0) sent++;
-        for (String rawData : rawDataList) {
-            selected_code.data = rawData;
-            sendRfCommand(selected_code, hideDefaultUI);
-            // sent++;
-            if (check(EscPress)) break;
-            // displayTextLine("Sent " + String(sent) + "/" + String(total));
+    } else {
+        // Codes are transmitted while the file is still being read
+        tx.record = &codes;
+        for (uint32_t offset = 0; !tx.aborted;) {
+            size_t got = subRead(tx, offset, chunk, sizeof(chunk));
+            if (!got) break;
+            tx.parser.feed(chunk, got);
+            offset += got;
+        }
+        tx.parser.finish();
+        tx.record = nullptr;
+        Serial.printf("Total signals found: %d\n", (int)codes.size());
+        if (!tx.aborted && codes.size() > 1 && fs == &SD && !tx.mem) {
+            saveSubIndex(fs, indexPath, tx.file, tx.parser, codes);
         }
-        addToRecentCodes(selected_code);
     }
+    if (tx.radioOn) deinitRfModule();
 
-    Serial.printf("\nSent %d of %d signals\n", sent, total);
-    if (!hideDefaultUI) { displayTextLine("Sent " + String(sent) + "/" + String(total), true); }
+    if (tx.sent) {
+        // RAW timings were streamed, keep the text for the recent list if it is small
+        if (!codes.empty() && codes.back().type == SUB_CODE_RAW && codes.back().length <= 4096) {
+            subReadValues(tx, codes.back(), tx.code.data);
+        }
+        addToRecentCodes(tx.code);
+    }
 
-    // Clear the vectors from memory
-    bitList.clear();
-    bitRawList.clear();
-    keyList.clear();
-    rawDataList.clear();
-    bitList.shrink_to_fit();
-    bitRawList.shrink_to_fit();
-    keyList.shrink_to_fit();
-    rawDataList.shrink_to_fit();
+    free(timings);
+    if (tx.mem) free((void *)tx.mem);
+    tx.file.close();
 
-    delay(1000);
-    deinitRfModule();
+    Serial.printf("\nSent %d of %d signals\n", tx.sent, (int)codes.size());
+    if (!hideDefaultUI) { displayTextLine("Sent " + String(tx.sent) + "/" + String(codes.size()), true); }
     return true;
 }
 
 void sendRfCommand(struct RfCodes rfcode, bool hideDefaultUI) {
-    uint32_t frequency = rfcode.frequency;
-    String protocol = rfcode.protocol;
-    String preset = rfcode.preset;
-    String data = rfcode.data;
-    uint64_t key = rfcode.key;
-    byte modulation = 2; // possible values for CC1101: 0 = 2-FSK, 1 =GFSK, 2=ASK, 3 = 4-FSK, 4 = MSK
-    float deviation = 1.58;
-    float rxBW = 270.83; // Receive bandwidth
-    float dataRate = 10; // Data Rate
-                         /*
-                             Serial.println("sendRawRfCommand");
-                             Serial.println(data);
-                             Serial.println(frequency);
-                             Serial.println(preset);
-                             Serial.println(protocol);
-                           */
+    RfTxPreset cfg;
+    /*
+        Serial.println("sendRawRfCommand");
+        Serial.println(rfcode.data);
+        Serial.println(rfcode.frequency);
+        Serial.println(rfcode.preset);
+        Serial.println(rfcode.protocol);
+    */
+    if (!rfPresetFromName(rfcode.preset, cfg)) return;
+    if (!rfBeginTx(rfcode.frequency, cfg)) return;
+    rfTransmit(rfcode, cfg, hideDefaultUI);
+    // digitalWrite(bruceConfigPins.rfTx, LED_OFF);
+    deinitRfModule();
+}
 
+static bool rfPresetFromName(const String &preset, RfTxPreset &cfg) {
+    cfg = RfTxPreset();
     // Radio preset name (configures modulation, bandwidth, filters, etc.).
     /*  supported flipper presets:
         FuriHalSubGhzPresetIDLE, // < default configuration
@@ -178,61 +351,63 @@ void sendRfCommand(struct RfCodes rfcode, bool hideDefaultUI) {
         FuriHalSubGhzPresetCustom, //Custom Preset
     */
     // struct Protocol rcswitch_protocol;
-    int rcswitch_protocol_no = 1;
     if (preset == "FuriHalSubGhzPresetOok270Async") {
-        rcswitch_protocol_no = 1;
+        cfg.rcswitchProtocol = 1;
         //  pulseLength , syncFactor , zero , one, invertedSignal
         // rcswitch_protocol = { 350, {  1, 31 }, {  1,  3 }, {  3,  1 }, false };
-        modulation = 2;
-        rxBW = 270;
+        cfg.modulation = 2;
+        cfg.rxBW = 270;
     } else if (preset == "FuriHalSubGhzPresetOok650Async") {
-        rcswitch_protocol_no = 2;
+        cfg.rcswitchProtocol = 2;
         // rcswitch_protocol = { 650, {  1, 10 }, {  1,  2 }, {  2,  1 }, false };
-        modulation = 2;
-        rxBW = 650;
+        cfg.modulation = 2;
+        cfg.rxBW = 650;
     } else if (preset == "FuriHalSubGhzPreset2FSKDev238Async") {
-        modulation = 0;
-        deviation = 2.380371;
-        rxBW = 238;
+        cfg.modulation = 0;
+        cfg.deviation = 2.380371;
+        cfg.rxBW = 238;
     } else if (preset == "FuriHalSubGhzPreset2FSKDev476Async") {
-        modulation = 0;
-        deviation = 47.60742;
-        rxBW = 476;
+        cfg.modulation = 0;
+        cfg.deviation = 47.60742;
+        cfg.rxBW = 476;
     } else if (preset == "FuriHalSubGhzPresetMSK99_97KbAsync") {
-        modulation = 4;
-        deviation = 47.60742;
-        dataRate = 99.97;
+        cfg.modulation = 4;
+        cfg.deviation = 47.60742;
+        cfg.dataRate = 99.97;
     } else if (preset == "FuriHalSubGhzPresetGFSK9_99KbAsync") {
-        modulation = 1;
-        deviation = 19.042969;
-        dataRate = 9.996;
+        cfg.modulation = 1;
+        cfg.deviation = 19.042969;
+        cfg.dataRate = 9.996;
     } else {
         bool found = false;
         for (int p = 0; p < 30; p++) {
             if (preset == String(p)) {
-                rcswitch_protocol_no = preset.toInt();
+                cfg.rcswitchProtocol = preset.toInt();
                 found = true;
             }
         }
         if (!found) {
             Serial.print("unsupported preset: ");
             Serial.println(preset);
-            return;
+            return false;
         }
     }
+    return true;
+}
 
+static bool rfBeginTx(uint32_t frequency, const RfTxPreset &cfg) {
     // init transmitter
-    if (!initRfModule("", frequency / 1000000.0)) return;
+    if (!initRfModule("", frequency / 1000000.0)) return false;
     if (bruceConfigPins.rfModule == CC1101_SPI_MODULE) { // CC1101 in use
         // derived from
         // https://github.com/LSatan/SmartRC-CC1101-Driver-Lib/blob/master/examples/Rc-Switch%20examples%20cc1101/SendDemo_cc1101/SendDemo_cc1101.ino
-        ELECHOUSE_cc1101.setModulation(modulation);
-        if (deviation) ELECHOUSE_cc1101.setDeviation(deviation);
-        if (rxBW)
+        ELECHOUSE_cc1101.setModulation(cfg.modulation);
+        if (cfg.deviation) ELECHOUSE_cc1101.setDeviation(cfg.deviation);
+        if (cfg.rxBW)
             ELECHOUSE_cc1101.setRxBW(
-                rxBW
+                cfg.rxBW
             ); // Set the Receive Bandwidth in kHz. Value from 58.03 to 812.50. Default is 812.50 kHz.
-        if (dataRate) ELECHOUSE_cc1101.setDRate(dataRate);
+        if (cfg.dataRate) ELECHOUSE_cc1101.setDRate(cfg.dataRate);
         pinMode(bruceConfigPins.CC1101_bus.io0, OUTPUT);
         ELECHOUSE_cc1101.setPA(
             12
@@ -243,40 +418,32 @@ void sendRfCommand(struct RfCodes rfcode, bool hideDefaultUI) {
         ELECHOUSE_cc1101.SetTx();
     } else {
         // other single-pinned modules in use
-        if (modulation != 2) {
+        if (cfg.modulation != 2) {
             Serial.print("unsupported modulation: ");
-            Serial.println(modulation);
-            return;
+            Serial.println(cfg.modulation);
+            return false;
         }
         initRfModule("tx", frequency / 1000000.0);
     }
+    return true;
+}
+
+// Sends one code on an already configured transmitter
+static void rfTransmit(RfCodes &rfcode, const RfTxPreset &cfg, bool hideDefaultUI) {
+    const String &protocol = rfcode.protocol;
 
     if (protocol == "RAW") {
-        // count the number of elements of RAW_Data
-        int buff_size = 0;
-        int index = 0;
-        while (index >= 0) {
-            index = data.indexOf(' ', index + 1);
-            buff_size++;
+        // every timing is preceded by a space at most, so this bounds the count
+        const char *data = rfcode.data.c_str();
+        size_t buff_size = 1;
+        for (const char *p = data; *p; ++p) {
+            if (*p == ' ') buff_size++;
         }
         // alloc buffer for transmittimings
-        int *transmittimings =
-            (int *)calloc(sizeof(int), buff_size + 1); // should be smaller the data.length()
-        size_t transmittimings_idx = 0;
-
-        // split data into words, convert to int, and store them in transmittimings
-        int startIndex = 0;
-        index = 0;
-        for (transmittimings_idx = 0; transmittimings_idx < buff_size; transmittimings_idx++) {
-            index = data.indexOf(' ', startIndex);
-            if (index == -1) {
-                transmittimings[transmittimings_idx] = data.substring(startIndex).toInt();
-            } else {
-                transmittimings[transmittimings_idx] = data.substring(startIndex, index).toInt();
-            }
-            startIndex = index + 1;
-        }
-        transmittimings[transmittimings_idx] = 0; // termination
+        int *transmittimings = (int *)calloc(sizeof(int), buff_size + 1);
+        if (!transmittimings) return;
+        size_t count = subParseTimings(data, rfcode.data.length(), transmittimings, buff_size);
+        transmittimings[count] = 0; // termination
 
         // send rf command
         if (!hideDefaultUI) { displayTextLine("Sending.."); }
@@ -291,7 +458,6 @@ void sendRfCommand(struct RfCodes rfcode, bool hideDefaultUI) {
     }
 
     else if (protocol == "RcSwitch") {
-        data.replace(" ", ""); // remove spaces
         // uint64_t data_val = strtoul(data.c_str(), nullptr, 16);
         uint64_t data_val = rfcode.key;
         int bits = rfcode.Bit;
@@ -302,10 +468,10 @@ void sendRfCommand(struct RfCodes rfcode, bool hideDefaultUI) {
         Serial.println(data_val,16);
         Serial.println(bits);
         Serial.println(pulse);
-        Serial.println(rcswitch_protocol_no);
+        Serial.println(cfg.rcswitchProtocol);
         */
         if (!hideDefaultUI) { displayTextLine("Sending.."); }
-        RCSwitch_send(data_val, bits, pulse, rcswitch_protocol_no, repeat);
+        RCSwitch_send(data_val, bits, pulse, cfg.rcswitchProtocol, repeat);
     } else if (protocol.startsWith("Princeton")) {
         RCSwitch_send(rfcode.key, rfcode.Bit, 350, 1, 10);
     } else {
@@ -315,12 +481,7 @@ void sendRfCommand(struct RfCodes rfcode, bool hideDefaultUI) {
         // if(protocol.startsWith("CAME") || protocol.startsWith("HOLTEC" || NICE)) {
         RCSwitch_send(rfcode.key, rfcode.Bit, 270, 11, 10);
         //}
-
-        return;
     }
-
-    // digitalWrite(bruceConfigPins.rfTx, LED_OFF);
-    deinitRfModule();
 }
 
 void RCSwitch_send(uint64_t data, unsigned int bits, int pulse, int protocol, int repeat) {
@@ -349,8 +510,6 @@ void RCSwitch_send(uint64_t data, unsigned int bits, int pulse, int protocol, in
     */
 
     mySwitch.disableTransmit();
-
-    deinitRfModule();
 }
 
 // ported from https://github.com/sui77/rc-switch/blob/3a536a172ab752f3c7a58d831c5075ca24fd920b/RCSwitch.cpp
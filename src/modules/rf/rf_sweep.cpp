@@ -0,0 +1,170 @@
+#include "rf_sweep.h"
+
+uint32_t rfFreqToWord(uint32_t hz) {
+    // f = fXOSC / 2^16 * FREQ
+    return (uint32_t)((((uint64_t)hz << 16) + RF_SWEEP_XOSC_HZ / 2) / RF_SWEEP_XOSC_HZ);
+}
+
+uint32_t rfWordToHz(uint32_t word) {
+    return (uint32_t)(((uint64_t)word * RF_SWEEP_XOSC_HZ + (1u << 15)) >> 16);
+}
+
+bool rfChannelSpacingFor(uint32_t spacingHz, uint8_t &exponent, uint8_t &mantissa) {
+    // spacing = fXOSC / 2^18 * (256 + M) * 2^E, smallest exponent gives the finest steps
+    for (uint8_t e = 0; e < 4; ++e) {
+        uint64_t scaled = ((uint64_t)spacingHz << 18) >> e;
+        uint32_t total = (uint32_t)((scaled + RF_SWEEP_XOSC_HZ / 2) / RF_SWEEP_XOSC_HZ);
+        if (total < 256) return false;
+        if (total <= 511) {
+            exponent = e;
+            mantissa = (uint8_t)(total - 256);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t rfRssiSettleUs(float dataRateKbaud, float rxBandwidthKhz) {
+    // IDLE -> RX without calibration takes ~90us. RSSI is then updated every 8 * 2^FILTER_LENGTH / (2 * BW)
+    // (FILTER_LENGTH = 1 with the driver defaults); wait two updates or two symbols, whichever is longer.
+    uint32_t symbols = dataRateKbaud > 0 ? (uint32_t)(2000.0f / dataRateKbaud) : RF_SWEEP_MAX_SETTLE_US;
+    uint32_t filter = rxBandwidthKhz > 0 ? (uint32_t)(16000.0f / rxBandwidthKhz) : 0;
+    uint32_t us = 90 + (symbols > filter ? symbols : filter);
+    if (us < RF_SWEEP_MIN_SETTLE_US) us = RF_SWEEP_MIN_SETTLE_US;
+    if (us > RF_SWEEP_MAX_SETTLE_US) us = RF_SWEEP_MAX_SETTLE_US;
+    return us;
+}
+
+bool RfSweepEngine::prepare(RfSweepRadio *radio) {
+    _radio = radio;
+    _points = 0;
+    _stepping = false;
+    _currentBase = 0;
+    _samples = 0;
+    _calibrations = 0;
+    _baseWrites = 0;
+    if (!radio) return false;
+    _settleUs = rfRssiSettleUs(radio->dataRateKbaud(), radio->rxBandwidthKhz());
+    return true;
+}
+
+bool RfSweepEngine::begin(RfSweepRadio *radio, float startMhz, float endMhz, size_t points) {
+    if (!prepare(radio) || points == 0 || endMhz <= startMhz) return false;
+    if (points > RF_SWEEP_MAX_POINTS) points = RF_SWEEP_MAX_POINTS;
+
+    const double startHz = startMhz * 1000000.0;
+    const double stepHz = (endMhz - startMhz) * 1000000.0 / points;
+    uint8_t e = 0, m = 0;
+    _stepping = rfChannelSpacingFor((uint32_t)(stepHz + 0.5), e, m);
+    if (_stepping) {
+        _radio->setChannelSpacing(e, m);
+        // Channel offset in FREQ units is (256 + M) * 2^E / 4, kept x4 to stay integral
+        const uint32_t spacing4 = (256u + m) << e;
+        // Segments are re-based on the exact grid before the spacing quantization adds up to 1/8 step
+        const double spacingHz = (double)spacing4 * RF_SWEEP_XOSC_HZ / (1u << 18);
+        const double drift = spacingHz > stepHz ? spacingHz - stepHz : stepHz - spacingHz;
+        size_t segLen = 256;
+        if (drift * 8 * segLen > stepHz) segLen = (size_t)(stepHz / (drift * 8));
+        if (segLen < 1) segLen = 1;
+        for (size_t i = 0; i < points; ++i) {
+            size_t segStart = i - i % segLen;
+            uint8_t ch = i - segStart;
+            _base[i] = rfFreqToWord((uint32_t)(startHz + segStart * stepHz));
+            _channel[i] = ch;
+            _hz[i] = rfWordToHz(_base[i]) + (uint32_t)(((uint64_t)ch * spacing4 * RF_SWEEP_XOSC_HZ) >> 18);
+        }
+    } else {
+        // Steps finer than 25 kHz or wider than 405 kHz: one base frequency per point
+        for (size_t i = 0; i < points; ++i) {
+            _base[i] = rfFreqToWord((uint32_t)(startHz + i * stepHz));
+            _channel[i] = 0;
+            _hz[i] = rfWordToHz(_base[i]);
+        }
+    }
+    _points = points;
+    assignSlots();
+    return true;
+}
+
+bool RfSweepEngine::begin(RfSweepRadio *radio, const float *mhz, size_t count) {
+    if (!prepare(radio) || !mhz || count == 0) return false;
+    if (count > RF_SWEEP_MAX_POINTS) count = RF_SWEEP_MAX_POINTS;
+    for (size_t i = 0; i < count; ++i) {
+        _base[i] = rfFreqToWord((uint32_t)(mhz[i] * 1000000.0));
+        _channel[i] = 0;
+        _hz[i] = rfWordToHz(_base[i]);
+    }
+    _points = count;
+    assignSlots();
+    return true;
+}
+
+void RfSweepEngine::assignSlots() {
+    // Bands already calibrated by an earlier plan keep their slot and values
+    uint16_t lastBand = 0;
+    uint8_t lastSlot = 0;
+    for (size_t i = 0; i < _points; ++i) {
+        uint16_t band = (uint16_t)(_hz[i] / RF_SWEEP_CAL_BAND_HZ);
+        if (i && band == lastBand) {
+            _slot[i] = lastSlot;
+            continue;
+        }
+        int slot = -1;
+        for (int s = 0; s < RF_SWEEP_CAL_SLOTS && slot < 0; ++s) {
+            if (_cal[s].band == band) slot = s;
+        }
+        for (int s = 0; s < RF_SWEEP_CAL_SLOTS && slot < 0; ++s) {
+            if (_cal[s].band == 0) slot = s;
+        }
+        if (slot < 0) {
+            // More bands than slots: share round robin, calibrationFor() re-checks the tag
+            slot = _nextEvict;
+            _nextEvict = (_nextEvict + 1) % RF_SWEEP_CAL_SLOTS;
+        }
+        if (_cal[slot].band != band) {
+            _cal[slot].band = band;
+            _cal[slot].valid = false;
+        }
+        _slot[i] = slot;
+        lastBand = band;
+        lastSlot = slot;
+    }
+}
+
+void RfSweepEngine::invalidateCalibration() {
+    for (int s = 0; s < RF_SWEEP_CAL_SLOTS; ++s) _cal[s].valid = false;
+    _currentBase = 0;
+}
+
+const RfCalibration &RfSweepEngine::calibrationFor(size_t i) {
+    CalSlot &slot = _cal[_slot[i]];
+    uint16_t band = (uint16_t)(_hz[i] / RF_SWEEP_CAL_BAND_HZ);
+    if (!slot.valid || slot.band != band) {
+        _radio->calibrate(_channel[i], slot.cal);
+        slot.band = band;
+        slot.valid = true;
+        _calibrations++;
+    }
+    return slot.cal;
+}
+
+int RfSweepEngine::measure(size_t i) {
+    if (!_radio || i >= _points) return -127;
+    if (_base[i] != _currentBase) {
+        _radio->setBase(_base[i]);
+        _currentBase = _base[i];
+        _baseWrites++;
+    }
+    const RfCalibration &cal = calibrationFor(i);
+    _radio->tune(_channel[i], cal, _hz[i]);
+    _radio->delayUs(_settleUs);
+    _samples++;
+    return _radio->readRssi();
+}
+
+void RfSweepEngine::sweep(int *rssi) {
+    for (size_t i = 0; i < _points; ++i) {
+        int v = measure(i);
+        if (rssi) rssi[i] = v;
+    }
+}
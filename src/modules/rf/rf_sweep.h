@@ -0,0 +1,109 @@
+#ifndef __RF_SWEEP_H__
+#define __RF_SWEEP_H__
+
+// RSSI sweep scheduling for the CC1101.
+// Instead of setMHZ() + a fixed delay per sample, the sweep programs the base frequency once per
+// segment and steps CHANNR at a matching channel spacing. Synthesizer calibration (FSCAL3..1) is
+// done once per band and written back on every hop, and the RSSI wait is derived from the
+// configured data rate and RX filter bandwidth.
+// The radio sits behind RfSweepRadio, so scheduling can be checked on the host with a fake radio.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RF_SWEEP_XOSC_HZ 26000000UL
+#define RF_SWEEP_MAX_POINTS 480
+#define RF_SWEEP_CAL_SLOTS 128
+#define RF_SWEEP_CAL_BAND_HZ 1000000UL // calibration is shared inside one MHz
+#define RF_SWEEP_MIN_SETTLE_US 100
+#define RF_SWEEP_MAX_SETTLE_US 5000
+
+struct RfCalibration {
+    uint8_t fscal3;
+    uint8_t fscal2;
+    uint8_t fscal1;
+};
+
+class RfSweepRadio {
+public:
+    virtual ~RfSweepRadio() = default;
+
+    // Configured modem settings, used to size the RSSI settle time
+    virtual float dataRateKbaud() = 0;
+    virtual float rxBandwidthKhz() = 0;
+
+    // MDMCFG1.CHANSPC_E / MDMCFG0.CHANSPC_M
+    virtual void setChannelSpacing(uint8_t exponent, uint8_t mantissa) = 0;
+    // FREQ2..0 word, only called when the segment changes
+    virtual void setBase(uint32_t freqWord) = 0;
+    // Runs a full calibration on the channel and reads back the result
+    virtual void calibrate(uint8_t channel, RfCalibration &cal) = 0;
+    // Hops to the channel with a stored calibration and enters RX. hz is the resulting frequency.
+    virtual void tune(uint8_t channel, const RfCalibration &cal, uint32_t hz) = 0;
+    virtual int readRssi() = 0;
+    virtual void delayUs(uint32_t us) = 0;
+};
+
+// FREQ register word for a frequency, and back
+uint32_t rfFreqToWord(uint32_t hz);
+uint32_t rfWordToHz(uint32_t word);
+// Closest CHANSPC setting for a spacing, false if it is outside 25.4..405 kHz
+bool rfChannelSpacingFor(uint32_t spacingHz, uint8_t &exponent, uint8_t &mantissa);
+// PLL settling after SRX plus the time for RSSI to follow (two symbols or two filter updates)
+uint32_t rfRssiSettleUs(float dataRateKbaud, float rxBandwidthKhz);
+
+class RfSweepEngine {
+public:
+    RfSweepEngine() = default;
+
+    // Even spacing from startMhz, points samples of (end - start) / points each
+    bool begin(RfSweepRadio *radio, float startMhz, float endMhz, size_t points);
+    // Arbitrary frequency list, each entry gets its own base frequency
+    bool begin(RfSweepRadio *radio, const float *mhz, size_t count);
+
+    size_t points() const { return _points; }
+    float pointMhz(size_t i) const { return i < _points ? _hz[i] / 1000000.0f : 0; }
+    uint32_t settleUs() const { return _settleUs; }
+    bool channelStepping() const { return _stepping; }
+
+    // Tunes to point i and returns its RSSI in dBm
+    int measure(size_t i);
+    // Measures every point in order
+    void sweep(int *rssi);
+    // Forces fresh calibrations (temperature drift, re-init of the chip)
+    void invalidateCalibration();
+
+    uint32_t samples() const { return _samples; }
+    uint32_t calibrations() const { return _calibrations; }
+    uint32_t baseWrites() const { return _baseWrites; }
+
+private:
+    struct CalSlot {
+        uint16_t band; // frequency / RF_SWEEP_CAL_BAND_HZ, 0 = empty
+        bool valid;    // cal holds a calibration for band
+        RfCalibration cal;
+    };
+
+    bool prepare(RfSweepRadio *radio);
+    void assignSlots();
+    const RfCalibration &calibrationFor(size_t i);
+
+    RfSweepRadio *_radio = nullptr;
+    size_t _points = 0;
+    uint32_t _hz[RF_SWEEP_MAX_POINTS];
+    uint32_t _base[RF_SWEEP_MAX_POINTS];
+    uint8_t _channel[RF_SWEEP_MAX_POINTS];
+    uint8_t _slot[RF_SWEEP_MAX_POINTS];
+    bool _stepping = false;
+    uint32_t _settleUs = RF_SWEEP_MIN_SETTLE_US;
+    uint32_t _currentBase = 0; // 0 = unknown, forces a write
+
+    CalSlot _cal[RF_SWEEP_CAL_SLOTS] = {};
+    uint8_t _nextEvict = 0;
+
+    uint32_t _samples = 0;
+    uint32_t _calibrations = 0;
+    uint32_t _baseWrites = 0;
+};
+
+#endif
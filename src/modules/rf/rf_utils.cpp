@@ -240,45 +240,127 @@ void initCC1101once(SPIClass *SSPI) {
     return;
 }
 
+// Antenna switch of the T-Embed CC1101, only toggled when the band changes
+static void selectAntenna(float frequency) {
+#if defined(T_EMBED)
+    static uint8_t antenna =
+        200; // 0=(<300), 1=(350-468), 2=(>778), 200=start to settle at the fisrt time
+    bool change = true;
+#if !defined(T_EMBED_1101)
+    // there's one version of T-Embed (White whith orange wheel) that has CC1101
+    // which antenna has the same circuit as the new CC1101 version with different pinouts
+    // this device uses 17 for CS
+    if (bruceConfigPins.CC1101_bus.cs != 17) change = false;
+#endif
+
+    // SW1:1  SW0:0 --- 315MHz
+    // SW1:0  SW0:1 --- 868/915MHz
+    // SW1:1  SW0:1 --- 434MHz
+    if (frequency <= 350 && antenna != 0 && change) {
+        digitalWrite(CC1101_SW1_PIN, HIGH);
+        digitalWrite(CC1101_SW0_PIN, LOW);
+        antenna = 0;
+        vTaskDelay(10 / portTICK_PERIOD_MS); // time to settle the antenna signal
+    } else if (frequency > 350 && frequency < 468 && antenna != 1 && change) {
+        digitalWrite(CC1101_SW1_PIN, HIGH);
+        digitalWrite(CC1101_SW0_PIN, HIGH);
+        antenna = 1;
+        vTaskDelay(10 / portTICK_PERIOD_MS); // time to settle the antenna signal
+    } else if (frequency > 778 && antenna != 2 && change) {
+        digitalWrite(CC1101_SW1_PIN, LOW);
+        digitalWrite(CC1101_SW0_PIN, HIGH);
+        antenna = 2;
+        vTaskDelay(10 / portTICK_PERIOD_MS); // time to settle the antenna signal
+    }
+#endif
+}
+
 void setMHZ(float frequency) {
     if (frequency > 928 || frequency < 280) {
         frequency = 433.92;
         Serial.println("Frequency out of band");
     }
     if (bruceConfigPins.rfModule == CC1101_SPI_MODULE) {
-#if defined(T_EMBED)
-        static uint8_t antenna =
-            200; // 0=(<300), 1=(350-468), 2=(>778), 200=start to settle at the fisrt time
-        bool change = true;
-#if !defined(T_EMBED_1101)
-        // there's one version of T-Embed (White whith orange wheel) that has CC1101
-        // which antenna has the same circuit as the new CC1101 version with different pinouts
-        // this device uses 17 for CS
-        if (bruceConfigPins.CC1101_bus.cs != 17) change = false;
-#endif
+        selectAntenna(frequency);
+        ELECHOUSE_cc1101.setMHZ(frequency);
+    }
+}
 
-        // SW1:1  SW0:0 --- 315MHz
-        // SW1:0  SW0:1 --- 868/915MHz
-        // SW1:1  SW0:1 --- 434MHz
-        if (frequency <= 350 && antenna != 0 && change) {
-            digitalWrite(CC1101_SW1_PIN, HIGH);
-            digitalWrite(CC1101_SW0_PIN, LOW);
-            antenna = 0;
-            vTaskDelay(10 / portTICK_PERIOD_MS); // time to settle the antenna signal
-        } else if (frequency > 350 && frequency < 468 && antenna != 1 && change) {
-            digitalWrite(CC1101_SW1_PIN, HIGH);
-            digitalWrite(CC1101_SW0_PIN, HIGH);
-            antenna = 1;
-            vTaskDelay(10 / portTICK_PERIOD_MS); // time to settle the antenna signal
-        } else if (frequency > 778 && antenna != 2 && change) {
-            digitalWrite(CC1101_SW1_PIN, LOW);
-            digitalWrite(CC1101_SW0_PIN, HIGH);
-            antenna = 2;
-            vTaskDelay(10 / portTICK_PERIOD_MS); // time to settle the antenna signal
-        }
+void CC1101SweepRadio::begin() {
+#if TFT_MOSI > 0
+    _tftShared = bruceConfigPins.CC1101_bus.mosi == (gpio_num_t)TFT_MOSI;
 #endif
-        ELECHOUSE_cc1101.setMHZ(frequency);
+    uint8_t mcsm0 = ELECHOUSE_cc1101.SpiReadReg(CC1101_MCSM0);
+    // Keep the saved value unless the chip was re-initialised in between
+    if (!_active || (mcsm0 & 0x30)) _mcsm0 = mcsm0;
+    ELECHOUSE_cc1101.SpiStrobe(CC1101_SIDLE);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_MCSM0, mcsm0 & ~0x30); // FS_AUTOCAL = never
+    _active = true;
+}
+
+void CC1101SweepRadio::end() {
+    if (!_active) return;
+    ELECHOUSE_cc1101.SpiStrobe(CC1101_SIDLE);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_MCSM0, _mcsm0);
+    _active = false;
+}
+
+float CC1101SweepRadio::dataRateKbaud() {
+    uint8_t mdmcfg4 = ELECHOUSE_cc1101.SpiReadReg(CC1101_MDMCFG4);
+    uint8_t mdmcfg3 = ELECHOUSE_cc1101.SpiReadReg(CC1101_MDMCFG3);
+    // R = (256 + DRATE_M) * 2^DRATE_E / 2^28 * fXOSC
+    return (256.0f + mdmcfg3) * (1UL << (mdmcfg4 & 0x0F)) * (RF_SWEEP_XOSC_HZ / 1000.0f) / 268435456.0f;
+}
+
+float CC1101SweepRadio::rxBandwidthKhz() {
+    uint8_t mdmcfg4 = ELECHOUSE_cc1101.SpiReadReg(CC1101_MDMCFG4);
+    // BW = fXOSC / (8 * (4 + CHANBW_M) * 2^CHANBW_E)
+    return (RF_SWEEP_XOSC_HZ / 1000.0f) / (8.0f * (4 + ((mdmcfg4 >> 4) & 0x03)) * (1 << (mdmcfg4 >> 6)));
+}
+
+void CC1101SweepRadio::setChannelSpacing(uint8_t exponent, uint8_t mantissa) {
+    uint8_t mdmcfg1 = ELECHOUSE_cc1101.SpiReadReg(CC1101_MDMCFG1);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_MDMCFG1, (mdmcfg1 & ~0x03) | (exponent & 0x03));
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_MDMCFG0, mantissa);
+}
+
+void CC1101SweepRadio::setBase(uint32_t freqWord) {
+    // Frequency registers may only change in IDLE
+    ELECHOUSE_cc1101.SpiStrobe(CC1101_SIDLE);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_FREQ2, (freqWord >> 16) & 0xFF);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_FREQ1, (freqWord >> 8) & 0xFF);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_FREQ0, freqWord & 0xFF);
+}
+
+void CC1101SweepRadio::calibrate(uint8_t channel, RfCalibration &cal) {
+    ELECHOUSE_cc1101.SpiStrobe(CC1101_SIDLE);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_CHANNR, channel);
+    ELECHOUSE_cc1101.SpiStrobe(CC1101_SCAL);
+    // ~720us at 26MHz, MARCSTATE goes back to IDLE (0x01) when done
+    uint32_t start = micros();
+    while ((ELECHOUSE_cc1101.SpiReadStatus(CC1101_MARCSTATE) & 0x1F) != 0x01 && micros() - start < 2000) {
+        delayMicroseconds(50);
     }
+    cal.fscal3 = ELECHOUSE_cc1101.SpiReadReg(CC1101_FSCAL3);
+    cal.fscal2 = ELECHOUSE_cc1101.SpiReadReg(CC1101_FSCAL2);
+    cal.fscal1 = ELECHOUSE_cc1101.SpiReadReg(CC1101_FSCAL1);
+}
+
+void CC1101SweepRadio::tune(uint8_t channel, const RfCalibration &cal, uint32_t hz) {
+    selectAntenna(hz / 1000000.0f);
+    ELECHOUSE_cc1101.SpiStrobe(CC1101_SIDLE);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_CHANNR, channel);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_FSCAL3, cal.fscal3);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_FSCAL2, cal.fscal2);
+    ELECHOUSE_cc1101.SpiWriteReg(CC1101_FSCAL1, cal.fscal1);
+    ELECHOUSE_cc1101.SpiStrobe(CC1101_SRX);
+    if (_tftShared) tft.drawPixel(0, 0, 0);
+}
+
+int CC1101SweepRadio::readRssi() {
+    int rssi = ELECHOUSE_cc1101.getRssi();
+    if (_tftShared) tft.drawPixel(0, 0, 0);
+    return rssi;
 }
 
 int find_pulse_index(const std::vector<int> &indexed_durations, int duration) {
@@ -1,6 +1,7 @@
 #ifndef __RF_UTILS_H__
 #define __RF_UTILS_H__
 
+#include "rf_sweep.h"
 #include "structs.h"
 #include <ELECHOUSE_CC1101_SRC_DRV.h>
 // ESP-IDF 5.5 based framework determines the channels autommatically
@@ -23,6 +24,28 @@ void deinitRfModule();
 void initCC1101once(SPIClass *SSPI);
 
 void setMHZ(float frequency);
+
+// RfSweepRadio on the ELECHOUSE driver. begin() turns off FS_AUTOCAL so hops reuse the cached
+// FSCAL values instead of recalibrating on every IDLE->RX; end() restores MCSM0.
+class CC1101SweepRadio : public RfSweepRadio {
+public:
+    void begin();
+    void end();
+
+    float dataRateKbaud() override;
+    float rxBandwidthKhz() override;
+    void setChannelSpacing(uint8_t exponent, uint8_t mantissa) override;
+    void setBase(uint32_t freqWord) override;
+    void calibrate(uint8_t channel, RfCalibration &cal) override;
+    void tune(uint8_t channel, const RfCalibration &cal, uint32_t hz) override;
+    int readRssi() override;
+    void delayUs(uint32_t us) override { delayMicroseconds(us); }
+
+private:
+    uint8_t _mcsm0 = 0;
+    bool _active = false;
+    bool _tftShared = false; // T-Embed: CC1101 on the TFT bus needs a TFT access after each transfer
+};
 int find_pulse_index(const std::vector<int> &indexed_durations, int duration);
 uint64_t crc64_ecma(const std::vector<int> &data);
 
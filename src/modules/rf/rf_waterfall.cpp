@@ -1,4 +1,5 @@
 #include "rf_waterfall.h"
+#include <new>
 #ifndef TFT_MOSI
 #define TFT_MOSI -1
 #endif
@@ -72,6 +73,16 @@ void rf_waterfall_run() {
     int current_line = display_top;
     initRfModule("rx", f_start);
 
+    RfSweepEngine *sweep = new (std::nothrow) RfSweepEngine();
+    if (!sweep) {
+        displayError("Not enough memory", true);
+        deinitRfModule();
+        return;
+    }
+    CC1101SweepRadio radio;
+    radio.begin();
+    float plan_start = 0, plan_end = 0;
+
     float max_freq = f_start;
     int max_rssi = -100;
     unsigned long lastMaxUpdate = millis();
@@ -102,6 +113,13 @@ void rf_waterfall_run() {
         }
 
         f_freq_step = (f_end - f_start) / screen_width;
+        if (plan_start != f_start || plan_end != f_end) {
+            // Only re-planned when the range changes, calibrations of known bands are kept
+            sweep->begin(&radio, f_start, f_end, screen_width);
+            plan_start = f_start;
+            plan_end = f_end;
+        }
+        const int points = sweep->points();
 
         float temp_max_freq = f_start;
         int temp_max_rssi = -100;
@@ -116,17 +134,9 @@ void rf_waterfall_run() {
         else step = 0.001;
 
         for (int i = 0; i < screen_width; ++i) {
-            float f_freq = f_start + i * f_freq_step;
-            setMHZ(f_freq);
-            // To make sure CC1101 shared with TFT works properly on T-Embed
-            if (bruceConfigPins.CC1101_bus.mosi == TFT_MOSI) {
-                tft.drawPixel(0, 0, 0);
-                delayMicroseconds(150); // T-Embed case, need more time to process
-            } else delayMicroseconds(100);
-
-            int i_rssi = ELECHOUSE_cc1101.getRssi();
-            // To make sure CC1101 shared with TFT works properly on T-Embed
-            if (bruceConfigPins.CC1101_bus.mosi == TFT_MOSI) tft.drawPixel(0, 0, 0);
+            float f_freq = i < points ? sweep->pointMhz(i) : f_start + i * f_freq_step;
+            // hops by channel number with cached calibration, waits only as long as RSSI needs
+            int i_rssi = i < points ? sweep->measure(i) : -100;
             if (i_rssi > temp_max_rssi) {
                 temp_max_rssi = i_rssi;
                 temp_max_freq = f_freq;
@@ -160,14 +170,14 @@ void rf_waterfall_run() {
                 switch (selected_item) {
                     case 0: f_start += step; break;
                     case 1: f_end += step; break;
-                    case 2: return;
+                    case 2: goto done;
                 }
                 delay(100);
             } else if (check(DownPress) || check(PrevPress)) {
                 switch (selected_item) {
                     case 0: f_start -= step; break;
                     case 1: f_end -= step; break;
-                    case 2: return;
+                    case 2: goto done;
                 }
                 if (EscPress) EscPress = false; // Reset for StickCs
                 delay(100);
@@ -208,6 +218,9 @@ void rf_waterfall_run() {
     }
 
     returnToMenu = true;
+done:
+    radio.end();
+    delete sweep;
     deinitRfModule();
     delay(10);
 }
@@ -33,6 +33,7 @@ struct RfCodes {
     String filepath = "";
     int Bit = 0;
     int BitRAW = 0;
+    String decoded = ""; // known protocol recognised in a RAW capture, display only
 };
 
 struct FreqFound {
@@ -0,0 +1,296 @@
+#include "sub_parser.h"
+#include <string.h>
+
+static const int32_t TIMING_LIMIT = 100000000; // us, longer values are clamped
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static uint32_t parseDecimal(const char *s, size_t len) {
+    uint32_t v = 0;
+    size_t i = 0;
+    while (i < len && (s[i] == ' ' || s[i] == '\t')) i++;
+    for (; i < len && isDigit(s[i]); ++i) v = v * 10 + (s[i] - '0');
+    return v;
+}
+
+static uint64_t parseHexKey(const char *s, size_t len) {
+    // "00 00 00 00 00 95 D5 D4", separators are ignored
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; ++i) {
+        int h = hexValue(s[i]);
+        if (h >= 0) v = (v << 4) | (uint64_t)h;
+    }
+    return v;
+}
+
+size_t subParseTimings(const char *text, size_t len, int *out, size_t cap) {
+    size_t n = 0;
+    size_t i = 0;
+    while (i < len && n < cap) {
+        while (i < len && !isDigit(text[i]) && text[i] != '-') i++;
+        bool neg = false;
+        if (i < len && text[i] == '-') {
+            neg = true;
+            i++;
+        }
+        int32_t v = 0;
+        bool digits = false;
+        for (; i < len && isDigit(text[i]); ++i) {
+            if (v < TIMING_LIMIT) v = v * 10 + (text[i] - '0');
+            digits = true;
+        }
+        if (digits && v) out[n++] = neg ? -v : v;
+    }
+    return n;
+}
+
+void SubParser::begin(SubCodeFn onCode, void *ctx, int *timings, size_t timingCap) {
+    _onCode = onCode;
+    _ctx = ctx;
+    _timings = timingCap >= 2 ? timings : nullptr;
+    _timingCap = _timings ? timingCap : 0;
+    _frequency = 0;
+    _te = 0;
+    _bits = 0;
+    _bitsRaw = 0;
+    _protocol = SUB_NO_STRING;
+    _preset = SUB_NO_STRING;
+    _codes = 0;
+    _stringCount = 0;
+    seek(0);
+}
+
+void SubParser::seek(uint32_t offset) {
+    _pos = offset;
+    _codeOpen = false;
+    _timingFill = 0;
+    _lastField = F_NONE;
+    startLine(offset);
+}
+
+void SubParser::setStrings(const char (*strings)[SUB_STRING_LEN], uint8_t count) {
+    if (count > SUB_MAX_STRINGS) count = SUB_MAX_STRINGS;
+    memcpy(_strings, strings, count * SUB_STRING_LEN);
+    for (uint8_t i = 0; i < count; ++i) _strings[i][SUB_STRING_LEN - 1] = '\0';
+    _stringCount = count;
+}
+
+void SubParser::startLine(uint32_t at) {
+    _state = ST_KEY;
+    _field = F_NONE;
+    _keyLen = 0;
+    _valueLen = 0;
+    _lineStart = at;
+}
+
+void SubParser::feed(const char *data, size_t len) {
+    for (size_t i = 0; i < len; ++i, ++_pos) {
+        const char c = data[i];
+        if (c == '\n') {
+            if (_state == ST_RAW) pushTiming();
+            endLine(_pos + 1);
+            startLine(_pos + 1);
+            continue;
+        }
+        switch (_state) {
+            case ST_KEY:
+                if (c == ':') {
+                    endKey();
+                } else if (_keyLen < sizeof(_key)) {
+                    _key[_keyLen++] = c;
+                } else {
+                    _state = ST_SKIP; // no known key is this long
+                }
+                break;
+            case ST_VALUE:
+                if (_valueLen < sizeof(_value) - 1) _value[_valueLen++] = c;
+                break;
+            case ST_RAW:
+                if (isDigit(c)) {
+                    if (_num < TIMING_LIMIT) _num = _num * 10 + (c - '0');
+                    _numDigits = true;
+                } else {
+                    pushTiming();
+                    if (c == '-') _numNeg = true;
+                }
+                break;
+            case ST_SKIP: break;
+        }
+    }
+}
+
+void SubParser::finish() {
+    if (_state == ST_RAW) pushTiming();
+    if (_pos != _lineStart) endLine(_pos);
+    startLine(_pos);
+    closeCode();
+}
+
+void SubParser::endKey() {
+    struct KeyName {
+        const char *name;
+        Field field;
+    };
+    static const KeyName keys[] = {
+        {"Filetype",  F_FILETYPE },
+        {"Frequency", F_FREQUENCY},
+        {"Preset",    F_PRESET   },
+        {"Protocol",  F_PROTOCOL },
+        {"TE",        F_TE       },
+        {"Bit",       F_BIT      },
+        {"Bit_RAW",   F_BIT_RAW  },
+        {"Key",       F_KEY      },
+        {"RAW_Data",  F_RAW_DATA },
+        {"Data_RAW",  F_DATA_RAW },
+    };
+
+    _field = F_NONE;
+    for (const KeyName &k : keys) {
+        if (strlen(k.name) == _keyLen && memcmp(k.name, _key, _keyLen) == 0) {
+            _field = k.field;
+            break;
+        }
+    }
+
+    switch (_field) {
+        case F_RAW_DATA:
+            // Consecutive RAW_Data lines are one signal
+            if (!(_codeOpen && _code.type == SUB_CODE_RAW && _lastField == F_RAW_DATA)) {
+                openCode(SUB_CODE_RAW);
+            }
+            _num = 0;
+            _numNeg = false;
+            _numDigits = false;
+            _state = ST_RAW;
+            break;
+        case F_DATA_RAW:
+            if (!(_codeOpen && _code.type == SUB_CODE_BINRAW && _lastField == F_DATA_RAW)) {
+                openCode(SUB_CODE_BINRAW);
+            }
+            _state = ST_SKIP; // sent from the file span, only the extent is needed here
+            break;
+        case F_KEY:
+            openCode(SUB_CODE_KEY);
+            _state = ST_VALUE;
+            break;
+        case F_FILETYPE:
+        case F_FREQUENCY:
+        case F_PRESET:
+        case F_PROTOCOL:
+            // A new header starts: whatever was open is complete
+            closeCode();
+            _state = ST_VALUE;
+            break;
+        case F_TE:
+        case F_BIT:
+        case F_BIT_RAW: _state = ST_VALUE; break;
+        default: _state = ST_SKIP; break;
+    }
+}
+
+void SubParser::endLine(uint32_t end) {
+    if (_state == ST_VALUE) applyValue();
+    if (_codeOpen && (_field == F_KEY || _field == F_RAW_DATA || _field == F_DATA_RAW)) {
+        _code.length = end - _code.offset;
+    }
+    _lastField = _field;
+}
+
+void SubParser::applyValue() {
+    // trim like String::trim(), "\r" included
+    const char *v = _value;
+    size_t len = _valueLen;
+    while (len && (*v == ' ' || *v == '\t' || *v == '\r')) {
+        v++;
+        len--;
+    }
+    while (len && (v[len - 1] == ' ' || v[len - 1] == '\t' || v[len - 1] == '\r')) len--;
+
+    switch (_field) {
+        case F_FREQUENCY: _frequency = parseDecimal(v, len); break;
+        case F_PRESET: _preset = internString(v, len); break;
+        case F_PROTOCOL: _protocol = internString(v, len); break;
+        case F_TE:
+            _te = (uint16_t)parseDecimal(v, len);
+            // Flipper writes TE after Key, it belongs to the open code
+            if (_codeOpen) _code.te = _te;
+            break;
+        case F_BIT:
+            _bits = (uint16_t)parseDecimal(v, len);
+            if (_codeOpen && _code.type == SUB_CODE_KEY && !_code.bits) _code.bits = _bits;
+            break;
+        case F_BIT_RAW:
+            _bitsRaw = (uint16_t)parseDecimal(v, len);
+            if (_codeOpen && _code.type == SUB_CODE_BINRAW && !_code.bits) _code.bits = _bitsRaw;
+            break;
+        case F_KEY:
+            if (_codeOpen) _code.key = parseHexKey(v, len);
+            break;
+        default: break;
+    }
+}
+
+uint8_t SubParser::internString(const char *s, size_t len) {
+    if (len >= SUB_STRING_LEN) len = SUB_STRING_LEN - 1;
+    for (uint8_t i = 0; i < _stringCount; ++i) {
+        if (strlen(_strings[i]) == len && memcmp(_strings[i], s, len) == 0) return i;
+    }
+    if (_stringCount >= SUB_MAX_STRINGS) return SUB_NO_STRING;
+    memcpy(_strings[_stringCount], s, len);
+    _strings[_stringCount][len] = '\0';
+    return _stringCount++;
+}
+
+void SubParser::openCode(uint8_t type) {
+    closeCode();
+    memset(&_code, 0, sizeof(_code));
+    _code.type = type;
+    _code.offset = _lineStart;
+    _code.frequency = _frequency;
+    _code.te = _te;
+    _code.bits = type == SUB_CODE_KEY ? _bits : type == SUB_CODE_BINRAW ? _bitsRaw : 0;
+    _code.protocol = _protocol;
+    _code.preset = _preset;
+    _codeOpen = true;
+    _timingFill = 0;
+}
+
+void SubParser::closeCode() {
+    if (!_codeOpen) return;
+    _codeOpen = false;
+    _codes++;
+    if (_code.type == SUB_CODE_RAW && _timings) {
+        flushTimings(false);
+    } else if (_onCode) {
+        _onCode(_ctx, _code, nullptr, 0, false);
+    }
+}
+
+void SubParser::pushTiming() {
+    if (!_numDigits) {
+        _numNeg = false;
+        return;
+    }
+    int32_t v = _numNeg ? -_num : _num;
+    _num = 0;
+    _numNeg = false;
+    _numDigits = false;
+    if (!v || !_codeOpen) return;
+    _code.pulses++;
+    if (!_timings) return;
+    _timings[_timingFill++] = v;
+    if (_timingFill == _timingCap - 1) flushTimings(true);
+}
+
+void SubParser::flushTimings(bool partial) {
+    _timings[_timingFill] = 0;
+    if (_onCode) _onCode(_ctx, _code, _timings, _timingFill, partial);
+    _timingFill = 0;
+}
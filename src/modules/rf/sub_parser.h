@@ -0,0 +1,147 @@
+#ifndef __SUB_PARSER_H__
+#define __SUB_PARSER_H__
+
+// Streaming tokenizer for Flipper .sub files.
+// Bytes are fed in arbitrary chunks; RAW_Data values are converted straight into a caller
+// supplied timing buffer and Key/Bit/TE/Preset fields into fixed fields, so parsing needs
+// no heap and no line buffer. Each completed code is reported through a callback together
+// with its file span, which is also what the binary side-car index stores.
+// No Arduino dependencies, so it can be run against .sub fixtures on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SUB_MAX_STRINGS 8 // distinct Protocol/Preset names per file
+#define SUB_STRING_LEN 48
+#define SUB_NO_STRING 0xFF
+
+#define SUB_INDEX_MAGIC 0x58425553 // "SUBX"
+#define SUB_INDEX_VERSION 1
+#define SUB_INDEX_EXT ".idx"
+
+enum SubCodeType : uint8_t {
+    SUB_CODE_KEY,    // Key: + Bit:, sent through RCSwitch
+    SUB_CODE_RAW,    // consecutive RAW_Data: lines, signed us timings
+    SUB_CODE_BINRAW, // Data_RAW: hex line with its Bit_RAW:
+};
+
+// Layout is also the on-disk index record, keep it padding free
+struct SubCode {
+    uint64_t key;
+    uint32_t offset;    // first byte of the code's first line
+    uint32_t length;    // bytes up to the end of its last line
+    uint32_t frequency; // Hz
+    uint32_t pulses;    // RAW timings (zeros skipped)
+    uint16_t te;
+    uint16_t bits; // Bit: or Bit_RAW:
+    uint8_t type;
+    uint8_t protocol; // index into the string table, SUB_NO_STRING if absent
+    uint8_t preset;
+    uint8_t reserved;
+};
+static_assert(sizeof(SubCode) == 32, "SubCode is stored as is in the index");
+
+struct SubIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t stringCount;
+    uint32_t codeCount;
+    uint32_t sourceSize;  // the index is stale if the .sub size or mtime changed
+    uint32_t sourceMtime;
+    uint32_t reserved;
+    char strings[SUB_MAX_STRINGS][SUB_STRING_LEN];
+};
+
+// partial is set when the timing buffer filled up before the code ended: more calls follow
+// for the same code. timings is zero terminated (RCSwitch_RAW_send style) and may be edited.
+typedef void (*SubCodeFn)(void *ctx, const SubCode &code, int *timings, size_t count, bool partial);
+
+// Parses a plain "123 -456 ..." list, returns the number of timings stored (zeros skipped)
+size_t subParseTimings(const char *text, size_t len, int *out, size_t cap);
+
+class SubParser {
+public:
+    SubParser() = default;
+
+    // timings may be null to only index the file; timingCap includes the terminator slot
+    void begin(SubCodeFn onCode, void *ctx, int *timings = nullptr, size_t timingCap = 0);
+    // offset of data[0] in the file is tracked internally, feed the file sequentially
+    void feed(const char *data, size_t len);
+    // Flushes the last line and the open code
+    void finish();
+
+    // Restarts at a file offset with a known string table, used to replay an indexed span
+    void seek(uint32_t offset);
+
+    size_t codeCount() const { return _codes; }
+    uint32_t bytesParsed() const { return _pos; }
+    uint8_t stringCount() const { return _stringCount; }
+    const char *string(uint8_t idx) const { return idx < _stringCount ? _strings[idx] : ""; }
+    // Preloads the table from an index so code string ids stay valid
+    void setStrings(const char (*strings)[SUB_STRING_LEN], uint8_t count);
+
+private:
+    enum State : uint8_t { ST_KEY, ST_VALUE, ST_RAW, ST_SKIP };
+    enum Field : uint8_t {
+        F_NONE,
+        F_FILETYPE,
+        F_FREQUENCY,
+        F_PRESET,
+        F_PROTOCOL,
+        F_TE,
+        F_BIT,
+        F_BIT_RAW,
+        F_KEY,
+        F_RAW_DATA,
+        F_DATA_RAW,
+    };
+
+    void startLine(uint32_t at);
+    void endKey();
+    void endLine(uint32_t end);
+    void applyValue();
+    void openCode(uint8_t type);
+    void closeCode();
+    void pushTiming();
+    void flushTimings(bool partial);
+    uint8_t internString(const char *s, size_t len);
+
+    SubCodeFn _onCode = nullptr;
+    void *_ctx = nullptr;
+    int *_timings = nullptr;
+    size_t _timingCap = 0;
+    size_t _timingFill = 0;
+
+    State _state = ST_KEY;
+    Field _field = F_NONE;
+    Field _lastField = F_NONE;
+    char _key[16];
+    uint8_t _keyLen = 0;
+    char _value[SUB_STRING_LEN];
+    uint8_t _valueLen = 0;
+
+    // RAW number being parsed
+    int32_t _num = 0;
+    bool _numNeg = false;
+    bool _numDigits = false;
+
+    uint32_t _pos = 0;       // file offset of the next byte
+    uint32_t _lineStart = 0; // file offset of the current line
+
+    // header fields in effect for the codes that follow
+    uint32_t _frequency = 0;
+    uint16_t _te = 0;
+    uint16_t _bits = 0;
+    uint16_t _bitsRaw = 0;
+    uint8_t _protocol = SUB_NO_STRING;
+    uint8_t _preset = SUB_NO_STRING;
+
+    SubCode _code;
+    bool _codeOpen = false;
+    size_t _codes = 0;
+
+    char _strings[SUB_MAX_STRINGS][SUB_STRING_LEN];
+    uint8_t _stringCount = 0;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "beacon_table.h"
+#include <string.h>
+
+static const size_t NOT_FOUND = (size_t)-1;
+static const size_t EVICT_WINDOW = 8; // slots inspected when picking an eviction victim
+
+uint64_t BeaconTable::macToKey(const uint8_t *mac) {
+    uint64_t key = 0;
+    for (int i = 0; i < 6; ++i) { key = (key << 8) | (uint64_t)mac[i]; }
+    return key;
+}
+
+void BeaconTable::keyToMac(uint64_t key, uint8_t *mac) {
+    for (int i = 5; i >= 0; --i) {
+        mac[i] = key & 0xFF;
+        key >>= 8;
+    }
+}
+
+bool BeaconTable::init(BeaconEntry *storage, size_t capacity) {
+    _slots = nullptr;
+    _count = 0;
+    _evictions = 0;
+    if (!storage || capacity < 2) return false;
+    size_t cap = 1;
+    uint8_t bits = 0;
+    while ((cap << 1) <= capacity) {
+        cap <<= 1;
+        bits++;
+    }
+    _slots = storage;
+    _mask = cap - 1;
+    _shift = 64 - bits;
+    _maxLoad = cap - cap / 8; // keep probe chains short
+    clear();
+    return true;
+}
+
+size_t BeaconTable::home(uint64_t key) const {
+    // Fibonacci hashing spreads the vendor-prefix heavy BSSIDs evenly
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> _shift) & _mask;
+}
+
+size_t BeaconTable::lookup(uint64_t key) const {
+    if (!_slots) return NOT_FOUND;
+    size_t idx = home(key);
+    for (size_t n = 0; n <= _mask; ++n) {
+        const BeaconEntry &e = _slots[idx];
+        if (!(e.flags & BEACON_FLAG_USED)) return NOT_FOUND;
+        if (e.key == key) return idx;
+        idx = (idx + 1) & _mask;
+    }
+    return NOT_FOUND;
+}
+
+BeaconEntry *BeaconTable::find(uint64_t key) {
+    size_t idx = lookup(key);
+    return idx == NOT_FOUND ? nullptr : &_slots[idx];
+}
+
+const BeaconEntry *BeaconTable::find(uint64_t key) const {
+    size_t idx = lookup(key);
+    return idx == NOT_FOUND ? nullptr : &_slots[idx];
+}
+
+BeaconEntry *BeaconTable::upsert(uint64_t key, uint32_t now) {
+    if (!_slots) return nullptr;
+    BeaconEntry *existing = find(key);
+    if (existing) return existing;
+    if (_count >= _maxLoad && !evictOne(home(key))) return nullptr;
+
+    size_t idx = home(key);
+    while (_slots[idx].flags & BEACON_FLAG_USED) idx = (idx + 1) & _mask;
+    BeaconEntry &e = _slots[idx];
+    e.key = key;
+    e.lastSeen = now;
+    e.channel = 0;
+    e.flags = BEACON_FLAG_USED;
+    e.ssid[0] = '\0';
+    _count++;
+    return &e;
+}
+
+bool BeaconTable::evictOne(size_t start) {
+    // Approximate LRU: oldest unpinned entry near the insertion point, else the oldest overall
+    size_t victim = NOT_FOUND;
+    for (size_t n = 0, idx = start; n <= _mask; ++n, idx = (idx + 1) & _mask) {
+        const BeaconEntry &e = _slots[idx];
+        if (!(e.flags & BEACON_FLAG_USED) || (e.flags & BEACON_FLAGS_PINNED)) continue;
+        if (victim == NOT_FOUND || (int32_t)(e.lastSeen - _slots[victim].lastSeen) < 0) victim = idx;
+        if (n >= EVICT_WINDOW && victim != NOT_FOUND) break;
+    }
+    if (victim == NOT_FOUND) return false;
+    removeAt(victim);
+    _evictions++;
+    return true;
+}
+
+void BeaconTable::removeAt(size_t idx) {
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    size_t hole = idx;
+    size_t next = (idx + 1) & _mask;
+    while (_slots[next].flags & BEACON_FLAG_USED) {
+        size_t want = home(_slots[next].key);
+        // Move the entry into the hole if its home is not between hole and next (cyclically)
+        if (((next - want) & _mask) >= ((next - hole) & _mask)) {
+            _slots[hole] = _slots[next];
+            hole = next;
+        }
+        next = (next + 1) & _mask;
+    }
+    _slots[hole].flags = 0;
+    _count--;
+}
+
+bool BeaconTable::erase(uint64_t key) {
+    size_t idx = lookup(key);
+    if (idx == NOT_FOUND) return false;
+    removeAt(idx);
+    return true;
+}
+
+void BeaconTable::clear() {
+    if (!_slots) return;
+    memset(_slots, 0, (_mask + 1) * sizeof(BeaconEntry));
+    _count = 0;
+}
+
+void BeaconTable::clearFlags(uint8_t mask) {
+    if (!_slots) return;
+    mask &= ~BEACON_FLAG_USED;
+    for (size_t i = 0; i <= _mask; ++i) _slots[i].flags &= ~mask;
+}
+
+size_t BeaconTable::expire(uint32_t now, uint32_t maxAge) {
+    if (!_slots) return 0;
+    size_t removed = 0;
+    size_t i = 0;
+    while (i <= _mask) {
+        BeaconEntry &e = _slots[i];
+        if ((e.flags & BEACON_FLAG_USED) && (now - e.lastSeen) > maxAge) {
+            if (e.flags & BEACON_FLAGS_PINNED) {
+                e.flags &= ~BEACON_FLAG_SEEN;
+            } else {
+                // removeAt may shift a later entry into slot i, so re-check it
+                removeAt(i);
+                removed++;
+                continue;
+            }
+        }
+        ++i;
+    }
+    return removed;
+}
@@ -0,0 +1,73 @@
+#pragma once
+// Fixed-capacity open-addressing table of access points keyed by the 48-bit BSSID.
+// Storage is handed in once (PSRAM on the device) and never reallocated, so lookups
+// from the promiscuous callback do not touch the heap. Not thread-safe by itself.
+#include <stddef.h>
+#include <stdint.h>
+
+#define BEACON_SSID_MAX 32
+
+enum BeaconFlags : uint8_t {
+    BEACON_FLAG_USED = 0x01,      // slot occupied
+    BEACON_FLAG_SEEN = 0x02,      // a beacon frame was received from this BSSID
+    BEACON_FLAG_HS_READY = 0x04,  // handshake file exists, beacons should be saved
+    BEACON_FLAG_HS_BEACON = 0x08, // beacon already appended to the handshake file
+};
+
+// Flags that keep an entry alive past the stale timeout
+#define BEACON_FLAGS_PINNED (BEACON_FLAG_HS_READY | BEACON_FLAG_HS_BEACON)
+
+struct BeaconEntry {
+    uint64_t key;      // BSSID packed big-endian into the low 48 bits
+    uint32_t lastSeen; // millis() of the last beacon
+    uint8_t channel;
+    uint8_t flags;
+    char ssid[BEACON_SSID_MAX + 1];
+};
+
+class BeaconTable {
+public:
+    static uint64_t macToKey(const uint8_t *mac);
+    static void keyToMac(uint64_t key, uint8_t *mac);
+
+    // capacity is rounded down to a power of two; storage must hold that many entries
+    bool init(BeaconEntry *storage, size_t capacity);
+    bool ready() const { return _slots != nullptr; }
+
+    BeaconEntry *find(uint64_t key);
+    const BeaconEntry *find(uint64_t key) const;
+    // Returns the existing entry or a fresh one; evicts the least recently seen
+    // entry of the probe window when the table is at its load limit
+    BeaconEntry *upsert(uint64_t key, uint32_t now);
+    bool erase(uint64_t key);
+    void clear();
+    void clearFlags(uint8_t mask);
+
+    // Drops entries not seen for maxAge ms. Pinned entries only lose BEACON_FLAG_SEEN
+    size_t expire(uint32_t now, uint32_t maxAge);
+
+    size_t size() const { return _count; }
+    size_t capacity() const { return _mask + 1; }
+    size_t evictions() const { return _evictions; }
+    static size_t bytesFor(size_t capacity) { return capacity * sizeof(BeaconEntry); }
+
+    template <typename F> void forEach(F fn) const {
+        if (!_slots) return;
+        for (size_t i = 0; i <= _mask; ++i) {
+            if (_slots[i].flags & BEACON_FLAG_USED) fn(_slots[i]);
+        }
+    }
+
+private:
+    size_t home(uint64_t key) const;
+    size_t lookup(uint64_t key) const;
+    void removeAt(size_t idx);
+    bool evictOne(size_t start);
+
+    BeaconEntry *_slots = nullptr;
+    size_t _mask = 0;
+    size_t _count = 0;
+    size_t _maxLoad = 0;
+    size_t _evictions = 0;
+    uint8_t _shift = 0;
+};
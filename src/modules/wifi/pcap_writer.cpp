@@ -0,0 +1,279 @@
+#include "pcap_writer.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(ESP_PLATFORM)
+#include "esp_heap_caps.h"
+#endif
+
+static void putLe16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void putLe32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static size_t pad4(size_t len) { return (4 - (len & 3)) & 3; }
+
+static uint8_t *allocStaging(size_t size) {
+#if defined(ESP_PLATFORM)
+    uint8_t *buf = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (!buf) buf = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    return buf;
+#else
+    return (uint8_t *)malloc(size);
+#endif
+}
+
+static void freeStaging(uint8_t *buf) {
+#if defined(ESP_PLATFORM)
+    heap_caps_free(buf);
+#else
+    free(buf);
+#endif
+}
+
+void pcapFillHeader(uint8_t *out, uint32_t snaplen, uint32_t network) {
+    putLe32(out, 0xa1b2c3d4); // magic
+    putLe16(out + 4, 2);      // version major
+    putLe16(out + 6, 4);      // version minor
+    putLe32(out + 8, 0);      // thiszone
+    putLe32(out + 12, 0);     // sigfigs
+    putLe32(out + 16, snaplen);
+    putLe32(out + 20, network);
+}
+
+uint16_t wifiChannelToFreq(uint8_t channel) {
+    if (channel == 14) return 2484;
+    if (channel >= 1 && channel <= 13) return 2407 + 5 * channel;
+    return 5000 + 5 * channel;
+}
+
+/* ---------- StagedWriter ---------- */
+
+StagedWriter::~StagedWriter() {
+    end();
+    release();
+}
+
+bool StagedWriter::begin(PcapSinkFn sink, void *ctx, size_t stagingSize) {
+    end();
+    stagingSize -= stagingSize % PCAP_WRITE_ALIGN;
+    if (stagingSize < PCAP_WRITE_ALIGN) stagingSize = PCAP_WRITE_ALIGN;
+    if (_buf && _cap != stagingSize) release();
+    if (!_buf) {
+        _buf = allocStaging(stagingSize);
+        if (!_buf) return false;
+        _cap = stagingSize;
+    }
+    _sink = sink;
+    _ctx = ctx;
+    _fill = 0;
+    _offset = 0;
+    _records = 0;
+    _sinkWrites = 0;
+    _failedWrites = 0;
+    return _sink != nullptr;
+}
+
+void StagedWriter::end() {
+    if (_sink) flush();
+    _sink = nullptr;
+    _ctx = nullptr;
+    _fill = 0;
+}
+
+void StagedWriter::release() {
+    if (_buf) freeStaging(_buf);
+    _buf = nullptr;
+    _cap = 0;
+    _fill = 0;
+}
+
+bool StagedWriter::emit(size_t len) {
+    if (len == 0) return true;
+    size_t written = _sink(_ctx, _buf, len);
+    _sinkWrites++;
+    if (written != len) _failedWrites++;
+    // Whatever the sink accepted is gone, keep the rest staged
+    if (written > len) written = len;
+    _offset += written;
+    if (written < _fill) memmove(_buf, _buf + written, _fill - written);
+    _fill -= written;
+    return written == len;
+}
+
+bool StagedWriter::append(const uint8_t *data, size_t len) {
+    if (!_sink) return false;
+    while (len > 0) {
+        size_t room = _cap - _fill;
+        size_t chunk = len < room ? len : room;
+        memcpy(_buf + _fill, data, chunk);
+        _fill += chunk;
+        data += chunk;
+        len -= chunk;
+        // A short write still makes room; only a sink that takes nothing stops the record
+        if (_fill == _cap) flushAligned();
+        if (_fill == _cap) return false;
+    }
+    return true;
+}
+
+bool StagedWriter::appendZeros(size_t len) {
+    static const uint8_t zeros[4] = {0, 0, 0, 0};
+    while (len > 0) {
+        size_t chunk = len < sizeof(zeros) ? len : sizeof(zeros);
+        if (!append(zeros, chunk)) return false;
+        len -= chunk;
+    }
+    return true;
+}
+
+bool StagedWriter::flushAligned() {
+    if (!_sink || _fill == 0) return true;
+    // Keep the file offset on a sector boundary after this write
+    size_t misalign = (size_t)(_offset % PCAP_WRITE_ALIGN);
+    if (_fill + misalign < PCAP_WRITE_ALIGN) return true;
+    size_t len = ((_fill + misalign) / PCAP_WRITE_ALIGN) * PCAP_WRITE_ALIGN - misalign;
+    return emit(len);
+}
+
+bool StagedWriter::flush() {
+    if (!_sink) return true;
+    return emit(_fill);
+}
+
+/* ---------- classic pcap ---------- */
+
+bool PcapBatchWriter::writeHeader(uint32_t snaplen, uint32_t network) {
+    uint8_t hdr[PCAP_HEADER_SIZE];
+    pcapFillHeader(hdr, snaplen, network);
+    return append(hdr, sizeof(hdr));
+}
+
+bool PcapBatchWriter::writeRecord(
+    uint32_t ts_sec, uint32_t ts_usec, uint32_t orig_len, const uint8_t *data, uint32_t len
+) {
+    uint8_t hdr[PCAP_RECORD_HEADER_SIZE];
+    putLe32(hdr, ts_sec);
+    putLe32(hdr + 4, ts_usec);
+    putLe32(hdr + 8, len);
+    putLe32(hdr + 12, orig_len);
+    if (!append(hdr, sizeof(hdr)) || !append(data, len)) return false;
+    countRecord();
+    return true;
+}
+
+/* ---------- pcapng ---------- */
+
+bool PcapngBatchWriter::begin(PcapSinkFn sink, void *ctx, size_t stagingSize) {
+    memset(_ifaceByChannel, 0xFF, sizeof(_ifaceByChannel));
+    _interfaces = 0;
+    return StagedWriter::begin(sink, ctx, stagingSize);
+}
+
+bool PcapngBatchWriter::writeOption(uint16_t code, const void *data, uint16_t len) {
+    uint8_t hdr[4];
+    putLe16(hdr, code);
+    putLe16(hdr + 2, len);
+    return append(hdr, sizeof(hdr)) && append((const uint8_t *)data, len) && appendZeros(pad4(len));
+}
+
+bool PcapngBatchWriter::writeSectionHeader(const char *application) {
+    size_t appLen = application ? strlen(application) : 0;
+    if (appLen > 255) appLen = 255;
+    size_t optLen = appLen ? 4 + appLen + pad4(appLen) : 0;
+    optLen += 4; // opt_endofopt
+    uint32_t total = 28 + optLen;
+
+    uint8_t hdr[24];
+    putLe32(hdr, PCAPNG_BLOCK_SHB);
+    putLe32(hdr + 4, total);
+    putLe32(hdr + 8, PCAPNG_BYTE_ORDER_MAGIC);
+    putLe16(hdr + 12, 1); // major
+    putLe16(hdr + 14, 0); // minor
+    memset(hdr + 16, 0xFF, 8); // section length unknown
+    if (!append(hdr, sizeof(hdr))) return false;
+    if (appLen && !writeOption(4, application, appLen)) return false; // shb_userappl
+    uint8_t tail[8];
+    putLe32(tail, 0); // opt_endofopt
+    putLe32(tail + 4, total);
+    return append(tail, sizeof(tail));
+}
+
+int PcapngBatchWriter::interfaceFor(uint8_t channel) {
+    if (_ifaceByChannel[channel] != 0xFF) return _ifaceByChannel[channel];
+    if (_interfaces >= PCAPNG_MAX_INTERFACES) return -1;
+
+    char name[16];
+    size_t nameLen = 0;
+    const char prefix[] = "wlan-ch";
+    memcpy(name, prefix, sizeof(prefix) - 1);
+    nameLen = sizeof(prefix) - 1;
+    char digits[4];
+    int n = 0;
+    uint8_t v = channel;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n) name[nameLen++] = digits[--n];
+
+    uint32_t total = 20 + 4 + nameLen + pad4(nameLen) + 4;
+    uint8_t hdr[16];
+    putLe32(hdr, PCAPNG_BLOCK_IDB);
+    putLe32(hdr + 4, total);
+    putLe16(hdr + 8, PCAP_LINKTYPE_RADIOTAP);
+    putLe16(hdr + 10, 0);
+    putLe32(hdr + 12, PCAP_DEFAULT_SNAPLEN + PCAPNG_RADIOTAP_LEN);
+    if (!append(hdr, sizeof(hdr)) || !writeOption(2, name, nameLen)) return -1; // if_name
+    uint8_t tail[8];
+    putLe32(tail, 0);
+    putLe32(tail + 4, total);
+    if (!append(tail, sizeof(tail))) return -1;
+
+    _ifaceByChannel[channel] = _interfaces;
+    return _interfaces++;
+}
+
+bool PcapngBatchWriter::writePacket(
+    uint64_t ts_usec, uint8_t channel, int8_t rssi, uint32_t orig_len, const uint8_t *data, uint32_t len
+) {
+    int iface = interfaceFor(channel);
+    if (iface < 0) return false;
+
+    uint32_t capLen = PCAPNG_RADIOTAP_LEN + len;
+    uint32_t total = 28 + capLen + pad4(capLen) + 4;
+    uint8_t hdr[28 + PCAPNG_RADIOTAP_LEN];
+    putLe32(hdr, PCAPNG_BLOCK_EPB);
+    putLe32(hdr + 4, total);
+    putLe32(hdr + 8, (uint32_t)iface);
+    putLe32(hdr + 12, (uint32_t)(ts_usec >> 32));
+    putLe32(hdr + 16, (uint32_t)ts_usec);
+    putLe32(hdr + 20, capLen);
+    putLe32(hdr + 24, PCAPNG_RADIOTAP_LEN + orig_len);
+
+    // radiotap: flags, channel (freq + band flags), dBm antenna signal
+    uint8_t *rt = hdr + 28;
+    uint16_t freq = wifiChannelToFreq(channel);
+    rt[0] = 0; // version
+    rt[1] = 0; // pad
+    putLe16(rt + 2, PCAPNG_RADIOTAP_LEN);
+    putLe32(rt + 4, (1u << 1) | (1u << 3) | (1u << 5));
+    rt[8] = 0; // flags: no FCS
+    rt[9] = 0; // align channel to 2 bytes
+    putLe16(rt + 10, freq);
+    putLe16(rt + 12, freq < 3000 ? 0x0080 : 0x0100);
+    rt[14] = (uint8_t)rssi;
+
+    if (!append(hdr, sizeof(hdr)) || !append(data, len) || !appendZeros(pad4(capLen))) return false;
+    uint8_t tail[4];
+    putLe32(tail, total);
+    if (!append(tail, sizeof(tail))) return false;
+    countRecord();
+    return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+// Batched capture writers (classic pcap and pcapng). Records are staged in RAM and
+// handed to the sink in sector-aligned chunks so the SD card sees few, large writes.
+// No Arduino dependencies: the sink is a plain callback so it runs on the host too.
+#include <stddef.h>
+#include <stdint.h>
+
+#define PCAP_HEADER_SIZE 24
+#define PCAP_RECORD_HEADER_SIZE 16
+#define PCAP_DEFAULT_SNAPLEN 2500
+#define PCAP_LINKTYPE_IEEE802_11 105
+#define PCAP_LINKTYPE_RADIOTAP 127
+#define PCAP_WRITE_ALIGN 512
+
+#define PCAPNG_BLOCK_SHB 0x0A0D0D0A
+#define PCAPNG_BLOCK_IDB 0x00000001
+#define PCAPNG_BLOCK_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_MAX_INTERFACES 64
+#define PCAPNG_RADIOTAP_LEN 15
+
+// Returns number of bytes actually written
+typedef size_t (*PcapSinkFn)(void *ctx, const uint8_t *data, size_t len);
+
+// Fills the 24-byte global header
+void pcapFillHeader(
+    uint8_t *out, uint32_t snaplen = PCAP_DEFAULT_SNAPLEN, uint32_t network = PCAP_LINKTYPE_IEEE802_11
+);
+// MHz for an 802.11 channel number (2.4 and 5 GHz bands)
+uint16_t wifiChannelToFreq(uint8_t channel);
+
+// RAM staging buffer in front of a sink
+class StagedWriter {
+public:
+    StagedWriter() = default;
+    ~StagedWriter();
+    StagedWriter(const StagedWriter &) = delete;
+    StagedWriter &operator=(const StagedWriter &) = delete;
+
+    // Allocates the staging buffer (rounded down to PCAP_WRITE_ALIGN) if not already done
+    bool begin(PcapSinkFn sink, void *ctx, size_t stagingSize);
+    // Flushes everything and detaches the sink; the staging buffer is kept for reuse
+    void end();
+    // Releases the staging buffer
+    void release();
+
+    // Pushes out whole sectors only, keeping later writes aligned to the file offset
+    bool flushAligned();
+    // Pushes out everything staged
+    bool flush();
+
+    bool active() const { return _sink != nullptr; }
+    size_t pending() const { return _fill; }
+    uint32_t records() const { return _records; }
+    uint32_t sinkWrites() const { return _sinkWrites; }
+    uint32_t failedWrites() const { return _failedWrites; }
+    uint64_t bytesWritten() const { return _offset; }
+
+protected:
+    bool append(const uint8_t *data, size_t len);
+    bool appendZeros(size_t len);
+    void countRecord() { _records++; }
+
+private:
+    bool emit(size_t len);
+
+    PcapSinkFn _sink = nullptr;
+    void *_ctx = nullptr;
+    uint8_t *_buf = nullptr;
+    size_t _cap = 0;
+    size_t _fill = 0;
+    uint64_t _offset = 0;
+    uint32_t _records = 0;
+    uint32_t _sinkWrites = 0;
+    uint32_t _failedWrites = 0;
+};
+
+class PcapBatchWriter : public StagedWriter {
+public:
+    bool writeHeader(uint32_t snaplen = PCAP_DEFAULT_SNAPLEN, uint32_t network = PCAP_LINKTYPE_IEEE802_11);
+    bool writeRecord(uint32_t ts_sec, uint32_t ts_usec, uint32_t orig_len, const uint8_t *data, uint32_t len);
+};
+
+// pcapng with one Interface Description Block per WiFi channel. Frames are written
+// with a radiotap header carrying channel frequency and RSSI, which is how
+// Wireshark and the hcx/aircrack tools expect per-packet radio metadata.
+class PcapngBatchWriter : public StagedWriter {
+public:
+    bool begin(PcapSinkFn sink, void *ctx, size_t stagingSize);
+
+    bool writeSectionHeader(const char *application = nullptr);
+    // ts_usec is a 64-bit microsecond timestamp; the channel's IDB is emitted on first use
+    bool writePacket(
+        uint64_t ts_usec, uint8_t channel, int8_t rssi, uint32_t orig_len, const uint8_t *data, uint32_t len
+    );
+
+    uint8_t interfaceCount() const { return _interfaces; }
+
+private:
+    int interfaceFor(uint8_t channel);
+    bool writeOption(uint16_t code, const void *data, uint16_t len);
+
+    uint8_t _ifaceByChannel[256];
+    uint8_t _interfaces = 0;
+};
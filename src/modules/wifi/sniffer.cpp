@@ -39,6 +39,9 @@
 #include <SPI.h>
 #include <SdFat.h>
 #endif
+#include "modules/wifi/beacon_table.h"
+#include "modules/wifi/pcap_writer.h"
+#include "modules/wifi/sniffer_buffers.h"
 #include "modules/wifi/wifi_atks.h" // to use deauth frames and cmds
 
 //===== SETTINGS =====//
@@ -73,31 +76,36 @@ SnifferMode currentMode = SnifferMode::HandshakesOnly;
 bool sdDetected = false;
 FS *activeFs = &LittleFS;
 SemaphoreHandle_t fileMutex = nullptr;
-QueueHandle_t snifferQueue = nullptr;
 TaskHandle_t snifferWriterHandle = nullptr;
 StaticSemaphore_t fileMutexBuffer;
 SemaphoreHandle_t handshakeMutex = nullptr;
 StaticSemaphore_t handshakeMutexBuffer;
 std::set<BeaconList> registeredBeacons;
 std::set<String> SavedHS; // Saves the MAC of beacon HS detected in the session
-String filename = "/BrucePCAP/" + (String)FILENAME + ".pcap";
-String deauthFilename = "/BrucePCAP/deauth_0.pcap";
+String filename = "/BrucePCAP/" + (String)FILENAME + ".pcapng";
+String deauthFilename = "/BrucePCAP/deauth_0.pcapng";
 int deauthFileIndex = 0;
 int rawFileIndex = 0;
-std::map<uint64_t, String> beaconSsidCache;
-const size_t MAX_CAPTURE_SSID_LEN = 32;
-const size_t SNIFFER_QUEUE_DEPTH = 48;
-std::set<uint64_t> handshakeReadyBssids;
-portMUX_TYPE handshakeReadyMux = portMUX_INITIALIZER_UNLOCKED;
-std::set<uint64_t> handshakeBeaconLogged;
-
-// --- New globals for beacon last-seen tracking & cleanup ---
-std::map<uint64_t, uint32_t> beaconLastSeen; // key = macToKey(mac) -> last seen millis()
-const uint32_t BEACON_TIMEOUT_MS = 120000;   // 2 minutes
+const size_t MAX_CAPTURE_SSID_LEN = BEACON_SSID_MAX;
+const size_t SNIFFER_RING_DEPTH = 64;           // descriptors in flight, power of two
+const size_t SNIFFER_SLOTS_PSRAM = 64;          // packet slabs when PSRAM is available
+const size_t SNIFFER_SLOTS_INTERNAL = 16;       // packet slabs on internal RAM only
+const size_t SNIFFER_SLOT_PAYLOAD = PCAP_DEFAULT_SNAPLEN;
+const size_t SNIFFER_STAGING_PSRAM = 32 * 1024; // pcap batch buffer
+const size_t SNIFFER_STAGING_INTERNAL = 8 * 1024;
+volatile uint32_t sniffer_dropped = 0; // frames lost to a full pool/ring
+
+// Beacon/SSID/handshake-state tracking, shared by the callback, writer task and UI
+const size_t BEACON_TABLE_PSRAM = 4096;    // entries, power of two
+const size_t BEACON_TABLE_INTERNAL = 512;  // ~24KB
+const uint32_t BEACON_TIMEOUT_MS = 120000; // 2 minutes
+BeaconTable beaconTable;
+BeaconEntry *beaconTableStorage = nullptr;
+portMUX_TYPE beaconTableMux = portMUX_INITIALIZER_UNLOCKED;
 unsigned long lastBeaconCleanup = 0;
 
 struct SnifferQueueItem {
-    wifi_promiscuous_pkt_t *packet = nullptr;
+    uint16_t slot = PacketSlabPool<SNIFFER_RING_DEPTH>::INVALID_SLOT;
     uint32_t ts_sec = 0;
     uint32_t ts_usec = 0;
     uint16_t raw_len = 0;
@@ -112,6 +120,18 @@ struct SnifferQueueItem {
     char ssid[MAX_CAPTURE_SSID_LEN + 1] = {0};
 };
 
+static_assert(SNIFFER_SLOTS_PSRAM <= SNIFFER_RING_DEPTH, "sniffer ring must cover every slab");
+
+// Each slab slot holds a wifi_promiscuous_pkt_t: rx_ctrl followed by the payload
+const size_t SNIFFER_SLOT_SIZE = sizeof(wifi_pkt_rx_ctrl_t) + SNIFFER_SLOT_PAYLOAD;
+SpscRing<SnifferQueueItem, SNIFFER_RING_DEPTH> snifferRing;
+PacketSlabPool<SNIFFER_RING_DEPTH> packetPool;
+uint8_t *packetPoolStorage = nullptr;
+// Raw and deauth captures are pcapng so each frame keeps the channel it was heard on
+PcapngBatchWriter rawWriter;
+PcapngBatchWriter deauthWriter;
+const char *SNIFFER_PCAPNG_APP = "Bruce sniffer";
+
 struct FrameInfo {
     bool valid = false;
     bool isBeacon = false;
@@ -120,17 +140,18 @@ struct FrameInfo {
     int eapolMsgNum = -1;
     uint8_t apAddr[6] = {0};
     uint64_t apKey = 0;
-    String ssid;
+    char ssid[MAX_CAPTURE_SSID_LEN + 1] = {0};
 };
 
 static bool ensureSnifferBackend();
 static void snifferWriterTask(void *param);
-static wifi_promiscuous_pkt_t *duplicatePacket(const wifi_promiscuous_pkt_t *pkt, uint16_t length);
-static void releasePacketCopy(wifi_promiscuous_pkt_t *packet);
+static wifi_promiscuous_pkt_t *slotPacket(uint16_t slot);
+static uint16_t copyPacketToSlot(const wifi_promiscuous_pkt_t *pkt, uint16_t length);
+static size_t filePcapSink(void *ctx, const uint8_t *data, size_t len);
 static uint64_t macToKey(const void *mac); // changed to const void *
 static void copyMac(uint8_t *dest, const uint8_t *src);
-static String extractSsid(const wifi_promiscuous_pkt_t *packet);
-static void copySsidToBuffer(const String &ssid, char *buffer, size_t len);
+static void extractSsid(const wifi_promiscuous_pkt_t *packet, char *buffer, size_t len);
+static void copySsidToBuffer(const char *ssid, char *buffer, size_t len);
 static String sanitizeSsid(const char *ssid);
 static String macToHex(const uint8_t *mac);
 static String buildHandshakePath(const uint8_t *mac, const char *ssid);
@@ -142,6 +163,7 @@ static void registerHandshakeRecord(const String &path);
 static bool handshakeBeaconRecorded(uint64_t key);
 static void registerHandshakeBeacon(uint64_t key);
 static void resetHandshakeBeaconCache();
+static bool ensureBeaconTable();
 static void ensureDirectories(FS &Fs);
 static void openDeauthFile(FS &Fs);
 static void closeRawFile();
@@ -153,13 +175,13 @@ static bool rawCaptureEnabled();
 static bool handshakeCaptureEnabled();
 static bool deauthCaptureEnabled();
 static FrameInfo analyzeFrame(wifi_promiscuous_pkt_t *pkt);
-static String resolveSsidForFrame(FrameInfo &info, const wifi_promiscuous_pkt_t *packet);
-static void registerBeacon(const uint8_t *apAddr);
+static void resolveSsidForFrame(FrameInfo &info, const wifi_promiscuous_pkt_t *packet);
 
 // --- New helper prototypes ---
 static void cleanupStaleBeacons();
 static size_t countActiveBeaconsOnChannel(uint8_t channel);
 static std::vector<String> recentSsidsOnChannel(uint8_t channel, size_t maxItems = 5);
+static size_t collectBeaconsOnChannel(uint8_t channel, uint8_t (*macs)[6], size_t maxItems);
 
 // --Deauth sent clean
 bool deauth_displayed = false;
@@ -352,26 +374,77 @@ static String buildHandshakePath(const uint8_t *mac, const char *ssid) {
     return path;
 }
 
+static bool ensureBeaconTable() {
+    if (beaconTable.ready()) return true;
+    size_t capacity = BEACON_TABLE_INTERNAL;
+    if (psramFound()) {
+        beaconTableStorage = (BeaconEntry *)heap_caps_malloc(
+            BeaconTable::bytesFor(BEACON_TABLE_PSRAM), MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM
+        );
+        if (beaconTableStorage) capacity = BEACON_TABLE_PSRAM;
+    }
+    if (!beaconTableStorage) {
+        beaconTableStorage =
+            (BeaconEntry *)heap_caps_malloc(BeaconTable::bytesFor(capacity), MALLOC_CAP_8BIT);
+    }
+    if (!beaconTableStorage) return false;
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.init(beaconTableStorage, capacity);
+    portEXIT_CRITICAL(&beaconTableMux);
+    return true;
+}
+
+static bool beaconHasFlag(uint64_t key, uint8_t flag) {
+    bool set = false;
+    portENTER_CRITICAL(&beaconTableMux);
+    const BeaconEntry *entry = beaconTable.find(key);
+    set = entry && (entry->flags & flag);
+    portEXIT_CRITICAL(&beaconTableMux);
+    return set;
+}
+
+static void beaconSetFlag(uint64_t key, uint8_t flag) {
+    portENTER_CRITICAL(&beaconTableMux);
+    BeaconEntry *entry = beaconTable.upsert(key, (uint32_t)millis());
+    if (entry) entry->flags |= flag;
+    portEXIT_CRITICAL(&beaconTableMux);
+}
+
 static bool shouldSaveBeaconForHandshake(const uint8_t *mac) {
     if (!mac) return false;
-    uint64_t key = macToKey(mac);
-    bool ready = false;
-    portENTER_CRITICAL(&handshakeReadyMux);
-    ready = handshakeReadyBssids.find(key) != handshakeReadyBssids.end();
-    portEXIT_CRITICAL(&handshakeReadyMux);
-    return ready;
+    return beaconHasFlag(macToKey(mac), BEACON_FLAG_HS_READY);
 }
 
 void markHandshakeReady(uint64_t key) {
-    portENTER_CRITICAL(&handshakeReadyMux);
-    handshakeReadyBssids.insert(key);
-    portEXIT_CRITICAL(&handshakeReadyMux);
+    if (!ensureBeaconTable()) return;
+    beaconSetFlag(key, BEACON_FLAG_HS_READY);
 }
 
 static void resetHandshakeTracking() {
-    portENTER_CRITICAL(&handshakeReadyMux);
-    handshakeReadyBssids.clear();
-    portEXIT_CRITICAL(&handshakeReadyMux);
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.clearFlags(BEACON_FLAG_HS_READY);
+    portEXIT_CRITICAL(&beaconTableMux);
+}
+
+bool sniffer_beacon_seen(const uint8_t *bssid) {
+    if (!bssid) return false;
+    return beaconHasFlag(macToKey(bssid), BEACON_FLAG_SEEN);
+}
+
+size_t sniffer_beacon_count() {
+    size_t count = 0;
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.forEach([&](const BeaconEntry &e) {
+        if (e.flags & BEACON_FLAG_SEEN) count++;
+    });
+    portEXIT_CRITICAL(&beaconTableMux);
+    return count;
+}
+
+void sniffer_reset_beacons() {
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.clear();
+    portEXIT_CRITICAL(&beaconTableMux);
 }
 
 static bool handshakeRecordExists(const String &path) {
@@ -397,61 +470,37 @@ static void registerHandshakeRecord(const String &path) {
     }
 }
 
-static bool handshakeBeaconRecorded(uint64_t key) {
-    if (!handshakeMutex) { return handshakeBeaconLogged.find(key) != handshakeBeaconLogged.end(); }
-    if (xSemaphoreTake(handshakeMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-        bool exists = handshakeBeaconLogged.find(key) != handshakeBeaconLogged.end();
-        xSemaphoreGive(handshakeMutex);
-        return exists;
-    }
-    return handshakeBeaconLogged.find(key) != handshakeBeaconLogged.end();
-}
+static bool handshakeBeaconRecorded(uint64_t key) { return beaconHasFlag(key, BEACON_FLAG_HS_BEACON); }
 
-static void registerHandshakeBeacon(uint64_t key) {
-    if (!handshakeMutex) {
-        handshakeBeaconLogged.insert(key);
-        return;
-    }
-    if (xSemaphoreTake(handshakeMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-        handshakeBeaconLogged.insert(key);
-        xSemaphoreGive(handshakeMutex);
-    } else {
-        handshakeBeaconLogged.insert(key);
-    }
-}
+static void registerHandshakeBeacon(uint64_t key) { beaconSetFlag(key, BEACON_FLAG_HS_BEACON); }
 
 static void resetHandshakeBeaconCache() {
-    if (!handshakeMutex) {
-        handshakeBeaconLogged.clear();
-        return;
-    }
-    if (xSemaphoreTake(handshakeMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        handshakeBeaconLogged.clear();
-        xSemaphoreGive(handshakeMutex);
-    } else {
-        handshakeBeaconLogged.clear();
-    }
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.clearFlags(BEACON_FLAG_HS_BEACON);
+    portEXIT_CRITICAL(&beaconTableMux);
 }
 
-static void registerBeacon(const uint8_t *apAddr) {
-    if (!apAddr) return;
-    BeaconList beacon;
-    memcpy(beacon.MAC, apAddr, sizeof(beacon.MAC));
-    beacon.channel = ch;
-    registeredBeacons.insert(beacon);
-}
-
-static String resolveSsidForFrame(FrameInfo &info, const wifi_promiscuous_pkt_t *packet) {
-    if (!packet) return "";
+// Beacons refresh the table entry (SSID, channel, last seen); other frames borrow the cached SSID
+static void resolveSsidForFrame(FrameInfo &info, const wifi_promiscuous_pkt_t *packet) {
+    if (!packet) return;
     if (info.isBeacon) {
         beacon_frames++;
-        String ssid = extractSsid(packet);
-        beaconSsidCache[info.apKey] = ssid;
-        return ssid;
+        extractSsid(packet, info.ssid, sizeof(info.ssid));
+        portENTER_CRITICAL(&beaconTableMux);
+        BeaconEntry *entry = beaconTable.upsert(info.apKey, (uint32_t)millis());
+        if (entry) {
+            memcpy(entry->ssid, info.ssid, sizeof(entry->ssid));
+            entry->channel = ch;
+            entry->lastSeen = (uint32_t)millis();
+            entry->flags |= BEACON_FLAG_SEEN;
+        }
+        portEXIT_CRITICAL(&beaconTableMux);
+        return;
     }
-    auto it = beaconSsidCache.find(info.apKey);
-    if (it != beaconSsidCache.end()) { return it->second; }
-    return "";
+    portENTER_CRITICAL(&beaconTableMux);
+    const BeaconEntry *entry = beaconTable.find(info.apKey);
+    if (entry) memcpy(info.ssid, entry->ssid, sizeof(info.ssid));
+    portEXIT_CRITICAL(&beaconTableMux);
 }
 
 static FrameInfo analyzeFrame(wifi_promiscuous_pkt_t *pkt) {
@@ -489,71 +538,73 @@ static FrameInfo analyzeFrame(wifi_promiscuous_pkt_t *pkt) {
         }
     }
 
-    info.ssid = resolveSsidForFrame(info, pkt);
-    if (info.isBeacon) {
-        registerBeacon(info.apAddr);
-        // UPDATE last-seen timestamp for this beacon
-        beaconLastSeen[info.apKey] = (uint32_t)millis();
-    }
-
+    resolveSsidForFrame(info, pkt);
     return info;
 }
 
 static uint64_t macToKey(const void *mac) {
-    const uint8_t *u = reinterpret_cast<const uint8_t *>(mac);
-    uint64_t key = 0;
-    for (int i = 0; i < 6; ++i) { key = (key << 8) | (uint64_t)u[i]; }
-    return key;
+    return BeaconTable::macToKey(reinterpret_cast<const uint8_t *>(mac));
 }
 
 static void copyMac(uint8_t *dest, const uint8_t *src) { memcpy(dest, src, 6); }
 
-static void copySsidToBuffer(const String &ssid, char *buffer, size_t len) {
+static void copySsidToBuffer(const char *ssid, char *buffer, size_t len) {
     if (!buffer || len == 0) return;
-    size_t copyLen = std::min<size_t>(ssid.length(), len - 1);
-    memcpy(buffer, ssid.c_str(), copyLen);
+    size_t copyLen = ssid ? std::min<size_t>(strlen(ssid), len - 1) : 0;
+    if (copyLen) memcpy(buffer, ssid, copyLen);
     buffer[copyLen] = '\0';
 }
 
-static String extractSsid(const wifi_promiscuous_pkt_t *packet) {
-    if (!packet) return "";
+static void extractSsid(const wifi_promiscuous_pkt_t *packet, char *buffer, size_t bufLen) {
+    if (!buffer || bufLen == 0) return;
+    buffer[0] = '\0';
+    if (!packet) return;
     const uint8_t *payload = packet->payload;
     int len = packet->rx_ctrl.sig_len;
-    if (len < 36) return "";
+    if (len < 36) return;
     int offset = 36;
     while (offset + 1 < len) {
         uint8_t tagNumber = payload[offset];
         uint8_t tagLength = payload[offset + 1];
         if (offset + 2 + tagLength > len) break;
         if (tagNumber == 0x00) {
-            String ssid = "";
-            for (int i = 0; i < tagLength; ++i) {
+            size_t out = 0;
+            for (int i = 0; i < tagLength && out + 1 < bufLen; ++i) {
                 uint8_t chValue = payload[offset + 2 + i];
-                if (isprint(chValue)) { ssid += (char)chValue; }
+                if (isprint(chValue)) { buffer[out++] = (char)chValue; }
             }
-            return ssid;
+            buffer[out] = '\0';
+            return;
         }
         offset += 2 + tagLength;
     }
-    return "";
 }
 
-static wifi_promiscuous_pkt_t *duplicatePacket(const wifi_promiscuous_pkt_t *pkt, uint16_t length) {
-    size_t total = sizeof(wifi_pkt_rx_ctrl_t) + length;
-    uint8_t *buffer = (uint8_t *)heap_caps_malloc(total, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-    if (!buffer) { buffer = (uint8_t *)heap_caps_malloc(total, MALLOC_CAP_8BIT); }
-    if (!buffer) { buffer = (uint8_t *)malloc(total); }
-    if (!buffer) { return nullptr; }
+static wifi_promiscuous_pkt_t *slotPacket(uint16_t slot) {
+    return reinterpret_cast<wifi_promiscuous_pkt_t *>(packetPool.slot(slot));
+}
+
+// Copies the frame into a free slab; frames longer than the snaplen are truncated
+static uint16_t copyPacketToSlot(const wifi_promiscuous_pkt_t *pkt, uint16_t length) {
+    uint16_t slot = packetPool.acquire();
+    if (slot == PacketSlabPool<SNIFFER_RING_DEPTH>::INVALID_SLOT) { return slot; }
+    if (length > SNIFFER_SLOT_PAYLOAD) { length = SNIFFER_SLOT_PAYLOAD; }
+    uint8_t *buffer = packetPool.slot(slot);
     auto *copy = reinterpret_cast<wifi_promiscuous_pkt_t *>(buffer);
     memcpy(copy, pkt, sizeof(wifi_pkt_rx_ctrl_t));
     memcpy(buffer + sizeof(wifi_pkt_rx_ctrl_t), pkt->payload, length);
     copy->rx_ctrl.sig_len = length;
-    return copy;
+    return slot;
 }
 
-static void releasePacketCopy(wifi_promiscuous_pkt_t *packet) {
-    if (!packet) return;
-    heap_caps_free(packet);
+static size_t filePcapSink(void *ctx, const uint8_t *data, size_t len) {
+    File *file = static_cast<File *>(ctx);
+    if (!file || !*file) return 0;
+    return file->write(data, len);
+}
+
+static size_t snifferStagingSize() {
+    return psramFound() ? SNIFFER_STAGING_PSRAM : SNIFFER_STAGING_INTERNAL;
 }
 
 static bool lockFileMutex(TickType_t ticks) {
@@ -574,14 +625,16 @@ static void ensureDirectories(FS &Fs) {
 static void openDeauthFile(FS &Fs) {
     ensureDirectories(Fs);
     closeDeauthFile();
-    deauthFilename = "/BrucePCAP/deauth_" + String(deauthFileIndex) + ".pcap";
+    deauthFilename = "/BrucePCAP/deauth_" + String(deauthFileIndex) + ".pcapng";
     while (Fs.exists(deauthFilename)) {
         deauthFileIndex++;
-        deauthFilename = "/BrucePCAP/deauth_" + String(deauthFileIndex) + ".pcap";
+        deauthFilename = "/BrucePCAP/deauth_" + String(deauthFileIndex) + ".pcapng";
     }
     if (lockFileMutex(pdMS_TO_TICKS(200))) {
         _deauth_file = Fs.open(deauthFilename, FILE_WRITE);
-        deauthFileOpen = _deauth_file && writeHeader(_deauth_file);
+        deauthFileOpen = _deauth_file &&
+                         deauthWriter.begin(filePcapSink, &_deauth_file, snifferStagingSize()) &&
+                         deauthWriter.writeSectionHeader(SNIFFER_PCAPNG_APP);
         unlockFileMutex();
         if (!deauthFileOpen) { Serial.println("Fail opening deauth capture file"); }
     }
@@ -589,6 +642,7 @@ static void openDeauthFile(FS &Fs) {
 
 static void closeRawFile() {
     if (lockFileMutex(pdMS_TO_TICKS(200))) {
+        rawWriter.end();
         if (_pcap_file) {
             _pcap_file.flush();
             _pcap_file.close();
@@ -600,6 +654,7 @@ static void closeRawFile() {
 
 static void closeDeauthFile() {
     if (lockFileMutex(pdMS_TO_TICKS(200))) {
+        deauthWriter.end();
         if (_deauth_file) {
             _deauth_file.flush();
             _deauth_file.close();
@@ -626,8 +681,20 @@ static String currentModeString() {
 static bool ensureSnifferBackend() {
     if (!fileMutex) { fileMutex = xSemaphoreCreateMutexStatic(&fileMutexBuffer); }
     if (!handshakeMutex) { handshakeMutex = xSemaphoreCreateMutexStatic(&handshakeMutexBuffer); }
-    if (!snifferQueue) { snifferQueue = xQueueCreate(SNIFFER_QUEUE_DEPTH, sizeof(SnifferQueueItem)); }
-    if (!snifferQueue) { return false; }
+    if (!ensureBeaconTable()) { return false; }
+    if (!packetPoolStorage) {
+        size_t slots = psramFound() ? SNIFFER_SLOTS_PSRAM : SNIFFER_SLOTS_INTERNAL;
+        packetPoolStorage =
+            (uint8_t *)heap_caps_malloc(slots * SNIFFER_SLOT_SIZE, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        // Without PSRAM, shrink the pool until it fits next to the WiFi stack
+        for (slots = SNIFFER_SLOTS_INTERNAL; !packetPoolStorage && slots >= 4; slots /= 2) {
+            packetPoolStorage = (uint8_t *)heap_caps_malloc(slots * SNIFFER_SLOT_SIZE, MALLOC_CAP_8BIT);
+            if (packetPoolStorage) break;
+        }
+        if (!packetPoolStorage) { return false; }
+        snifferRing.reset();
+        packetPool.init(packetPoolStorage, SNIFFER_SLOT_SIZE, slots);
+    }
     if (!snifferWriterHandle) {
 #if SOC_CPU_CORES_NUM > 1
         BaseType_t res = xTaskCreatePinnedToCore(
@@ -642,23 +709,32 @@ static bool ensureSnifferBackend() {
     return snifferWriterHandle != nullptr;
 }
 
-static void handleRawWrite(const SnifferQueueItem &item) {
-    if (!rawCaptureEnabled() || !item.packet) { return; }
+static void
+writeCaptureRecord(PcapngBatchWriter &writer, const SnifferQueueItem &item, wifi_promiscuous_pkt_t *packet) {
+    uint32_t incl = std::min<uint32_t>(item.raw_len, packet->rx_ctrl.sig_len);
+    uint64_t ts = (uint64_t)item.ts_sec * 1000000ULL + item.ts_usec;
+    writer.writePacket(
+        ts, packet->rx_ctrl.channel, (int8_t)packet->rx_ctrl.rssi, item.raw_len, packet->payload, incl
+    );
+}
+
+static void handleRawWrite(const SnifferQueueItem &item, wifi_promiscuous_pkt_t *packet) {
+    if (!rawCaptureEnabled() || !packet) { return; }
     if (lockFileMutex(pdMS_TO_TICKS(200))) {
-        newPacketSD(item.ts_sec, item.ts_usec, item.raw_len, item.packet->payload, _pcap_file);
+        writeCaptureRecord(rawWriter, item, packet);
         unlockFileMutex();
     }
 }
 
-static void handleHandshakeWrite(const SnifferQueueItem &item) {
-    if (!handshakeCaptureEnabled() || !item.packet) { return; }
-    saveHandshake(item.packet, item.isBeacon, *activeFs, item.ssid);
+static void handleHandshakeWrite(const SnifferQueueItem &item, wifi_promiscuous_pkt_t *packet) {
+    if (!handshakeCaptureEnabled() || !packet) { return; }
+    saveHandshake(packet, item.isBeacon, *activeFs, item.ssid);
 }
 
-static void handleDeauthWrite(const SnifferQueueItem &item) {
-    if (!deauthCaptureEnabled() || !item.packet) { return; }
+static void handleDeauthWrite(const SnifferQueueItem &item, wifi_promiscuous_pkt_t *packet) {
+    if (!deauthCaptureEnabled() || !packet) { return; }
     if (lockFileMutex(pdMS_TO_TICKS(200))) {
-        newPacketSD(item.ts_sec, item.ts_usec, item.raw_len, item.packet->payload, _deauth_file);
+        writeCaptureRecord(deauthWriter, item, packet);
         unlockFileMutex();
     }
 }
@@ -667,11 +743,14 @@ static void snifferWriterTask(void *param) {
     (void)param;
     SnifferQueueItem item;
     while (true) {
-        if (xQueueReceive(snifferQueue, &item, portMAX_DELAY) == pdTRUE) {
-            if (item.saveRaw) { handleRawWrite(item); }
-            if (item.saveHandshake) { handleHandshakeWrite(item); }
-            if (item.saveDeauth) { handleDeauthWrite(item); }
-            releasePacketCopy(item.packet);
+        // Woken by the callback; the timeout only guards against a missed notification
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        while (snifferRing.pop(item)) {
+            wifi_promiscuous_pkt_t *packet = slotPacket(item.slot);
+            if (item.saveRaw) { handleRawWrite(item, packet); }
+            if (item.saveHandshake) { handleHandshakeWrite(item, packet); }
+            if (item.saveDeauth) { handleDeauthWrite(item, packet); }
+            packetPool.release(item.slot);
         }
     }
 }
@@ -711,10 +790,11 @@ SnifferMode sniffer_get_mode() { return currentMode; }
 bool sniffer_full_mode_available() { return sdDetected; }
 
 void sniffer_wait_for_flush(uint32_t timeoutMs) {
-    if (!snifferQueue) { return; }
+    if (!snifferWriterHandle) { return; }
     TickType_t start = xTaskGetTickCount();
     TickType_t deadline = pdMS_TO_TICKS(timeoutMs);
-    while (uxQueueMessagesWaiting(snifferQueue) > 0) {
+    // Every slot back in the pool means the writer is done with all frames
+    while (!snifferRing.empty() || packetPool.available() < packetPool.slotCount()) {
         vTaskDelay(pdMS_TO_TICKS(10));
         if (timeoutMs == 0) { continue; }
         if ((xTaskGetTickCount() - start) > deadline) { break; }
@@ -743,49 +823,27 @@ void printAddress(const uint8_t *addr) {
 /* write packet to file */
 void newPacketSD(uint32_t ts_sec, uint32_t ts_usec, uint32_t len, uint8_t *buf, File pcap_file) {
     if (pcap_file) {
-
-        uint32_t orig_len = len;
-        uint32_t incl_len = len;
-        // if(incl_len > snaplen) incl_len = snaplen; /* safty check that the packet isn't too big (I ran into
-        // problems here) */
-
-        pcap_file.write((uint8_t *)&ts_sec, sizeof(ts_sec));
-        pcap_file.write((uint8_t *)&ts_usec, sizeof(ts_usec));
-        pcap_file.write((uint8_t *)&incl_len, sizeof(incl_len));
-        pcap_file.write((uint8_t *)&orig_len, sizeof(orig_len));
-
-        pcap_file.write(buf, incl_len);
+        pcaprec_hdr_t hdr;
+        hdr.ts_sec = ts_sec;
+        hdr.ts_usec = ts_usec;
+        hdr.incl_len = len;
+        hdr.orig_len = len;
+        pcap_file.write((const uint8_t *)&hdr, sizeof(hdr));
+        pcap_file.write(buf, len);
     }
 }
 
 bool writeHeader(File file) {
-    uint32_t magic_number = 0xa1b2c3d4;
-    uint16_t version_major = 2;
-    uint16_t version_minor = 4;
-    uint32_t thiszone = 0;
-    uint32_t sigfigs = 0;
-    uint32_t snaplen = 2500;
-    uint32_t network = 105;
-
-    if (file) {
-
-        file.write((uint8_t *)&magic_number, sizeof(magic_number));
-        file.write((uint8_t *)&version_major, sizeof(version_major));
-        file.write((uint8_t *)&version_minor, sizeof(version_minor));
-        file.write((uint8_t *)&thiszone, sizeof(thiszone));
-        file.write((uint8_t *)&sigfigs, sizeof(sigfigs));
-        file.write((uint8_t *)&snaplen, sizeof(snaplen));
-        file.write((uint8_t *)&network, sizeof(network));
-
-        return true;
-    }
-    return false;
+    if (!file) return false;
+    uint8_t header[PCAP_HEADER_SIZE];
+    pcapFillHeader(header);
+    return file.write(header, sizeof(header)) == sizeof(header);
 }
 
 /* will be executed on every packet the ESP32 gets while being in promiscuous mode */
 // Sniffer callback
 void sniffer(void *buf, wifi_promiscuous_pkt_type_t type) {
-    if (!snifferQueue && !ensureSnifferBackend()) { return; }
+    if (!packetPool.ready()) { return; }
     // If using LittleFS to save .pcaps and storage is exhausted, stop promiscuous mode
     if (isLittleFS && !littleFsSpaceAvailable) {
         littleFsWasFull = true; // storage triggered exit
@@ -811,12 +869,16 @@ void sniffer(void *buf, wifi_promiscuous_pkt_type_t type) {
 
     if (!saveRaw && !saveHandshake && !saveDeauth) { return; }
 
-    wifi_promiscuous_pkt_t *copy = duplicatePacket(pkt, ctrl.sig_len);
-    if (!copy) { return; }
+    uint16_t slot = copyPacketToSlot(pkt, ctrl.sig_len);
+    wifi_promiscuous_pkt_t *copy = slotPacket(slot);
+    if (!copy) {
+        sniffer_dropped++;
+        return;
+    }
     if (frameInfo.isBeacon && copy->rx_ctrl.sig_len >= 4) { copy->rx_ctrl.sig_len -= 4; }
 
     SnifferQueueItem item;
-    item.packet = copy;
+    item.slot = slot;
     uint64_t pktTimestamp = copy->rx_ctrl.timestamp;
     item.ts_sec = pktTimestamp / 1000000ULL;
     item.ts_usec = pktTimestamp % 1000000ULL;
@@ -830,15 +892,13 @@ void sniffer(void *buf, wifi_promiscuous_pkt_type_t type) {
     item.saveHandshake = saveHandshake;
     item.saveDeauth = saveDeauth;
     copyMac(item.bssid, frameInfo.apAddr);
-    String ssidLabel = frameInfo.ssid.length() == 0 ? "UNKNOWN" : frameInfo.ssid;
-    copySsidToBuffer(ssidLabel, item.ssid, sizeof(item.ssid));
+    copySsidToBuffer(frameInfo.ssid[0] == '\0' ? "UNKNOWN" : frameInfo.ssid, item.ssid, sizeof(item.ssid));
 
+    // Every queued item owns a slot and the ring is at least as deep as the pool, so this cannot overflow
+    snifferRing.push(item);
     BaseType_t taskWoken = pdFALSE;
-    if (xQueueSendFromISR(snifferQueue, &item, &taskWoken) != pdTRUE) {
-        releasePacketCopy(copy);
-    } else if (taskWoken) {
-        portYIELD_FROM_ISR();
-    }
+    vTaskNotifyGiveFromISR(snifferWriterHandle, &taskWoken);
+    if (taskWoken) { portYIELD_FROM_ISR(); }
 }
 
 // esp_err_t event_handler(void *ctx, system_event_t *event){ return ESP_OK; }
@@ -863,14 +923,15 @@ void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, voi
 void openFile(FS &Fs) {
     ensureDirectories(Fs);
     closeRawFile();
-    filename = "/BrucePCAP/" + (String)FILENAME + String(rawFileIndex) + ".pcap";
+    filename = "/BrucePCAP/" + (String)FILENAME + String(rawFileIndex) + ".pcapng";
     while (Fs.exists(filename)) {
         rawFileIndex++;
-        filename = "/BrucePCAP/" + (String)FILENAME + String(rawFileIndex) + ".pcap";
+        filename = "/BrucePCAP/" + (String)FILENAME + String(rawFileIndex) + ".pcapng";
     }
     if (lockFileMutex(pdMS_TO_TICKS(200))) {
         _pcap_file = Fs.open(filename, FILE_WRITE);
-        rawFileOpen = _pcap_file && writeHeader(_pcap_file);
+        rawFileOpen = _pcap_file && rawWriter.begin(filePcapSink, &_pcap_file, snifferStagingSize()) &&
+                      rawWriter.writeSectionHeader(SNIFFER_PCAPNG_APP);
         unlockFileMutex();
         if (!rawFileOpen) { Serial.println("Fail opening the file"); }
     }
@@ -879,69 +940,61 @@ void openFile(FS &Fs) {
 // --- New helper implementations ---
 
 static void cleanupStaleBeacons() {
-    unsigned long now = millis();
-    std::vector<BeaconList> toRemove;
-    for (auto it = registeredBeacons.begin(); it != registeredBeacons.end(); ++it) {
-        uint64_t key = macToKey(it->MAC);
-        auto lastIt = beaconLastSeen.find(key);
-        if (lastIt == beaconLastSeen.end() || (now - (unsigned long)lastIt->second) > BEACON_TIMEOUT_MS) {
-            toRemove.push_back(*it);
-        }
-    }
-    for (const auto &b : toRemove) {
-        // erase by matching MAC bytes
-        for (auto it = registeredBeacons.begin(); it != registeredBeacons.end();) {
-            if (memcmp(it->MAC, b.MAC, 6) == 0) {
-                it = registeredBeacons.erase(it);
-            } else {
-                ++it;
-            }
-        }
-        uint64_t key = macToKey(b.MAC);
-        beaconSsidCache.erase(key);
-        beaconLastSeen.erase(key);
-    }
+    uint32_t now = millis();
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.expire(now, BEACON_TIMEOUT_MS);
+    portEXIT_CRITICAL(&beaconTableMux);
+}
+
+static bool beaconActiveOn(const BeaconEntry &e, uint8_t channel, uint32_t now) {
+    return (e.flags & BEACON_FLAG_SEEN) && e.channel == channel && (now - e.lastSeen) <= BEACON_TIMEOUT_MS;
 }
 
 static size_t countActiveBeaconsOnChannel(uint8_t channel) {
-    unsigned long now = millis();
+    uint32_t now = millis();
     size_t cnt = 0;
-    for (const auto &b : registeredBeacons) {
-        if (b.channel != channel) continue;
-        uint64_t key = macToKey(b.MAC);
-        auto it = beaconLastSeen.find(key);
-        if (it != beaconLastSeen.end() && (now - (unsigned long)it->second) <= BEACON_TIMEOUT_MS) { ++cnt; }
-    }
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.forEach([&](const BeaconEntry &e) {
+        if (beaconActiveOn(e, channel, now)) ++cnt;
+    });
+    portEXIT_CRITICAL(&beaconTableMux);
     return cnt;
 }
 
 static std::vector<String> recentSsidsOnChannel(uint8_t channel, size_t maxItems) {
-    std::vector<String> out;
-    unsigned long now = millis();
-    for (const auto &b : registeredBeacons) {
-        if (b.channel != channel) continue;
-        uint64_t key = macToKey(b.MAC);
-        auto lastIt = beaconLastSeen.find(key);
-        if (lastIt == beaconLastSeen.end() || (now - (unsigned long)lastIt->second) > BEACON_TIMEOUT_MS)
-            continue;
-        auto ssidIt = beaconSsidCache.find(key);
-        if (ssidIt == beaconSsidCache.end()) continue;
-        String ss = ssidIt->second;
-        if (ss.length() == 0) continue;
-        bool dup = false;
-        for (auto &x : out)
-            if (x == ss) {
-                dup = true;
-                break;
-            }
-        if (!dup) {
-            out.push_back(ss);
-            if (out.size() >= maxItems) break;
+    // Copy out under the lock, build Strings (heap) afterwards
+    const size_t MAX_ITEMS = 8;
+    char ssids[MAX_ITEMS][MAX_CAPTURE_SSID_LEN + 1];
+    size_t found = 0;
+    if (maxItems > MAX_ITEMS) maxItems = MAX_ITEMS;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.forEach([&](const BeaconEntry &e) {
+        if (found >= maxItems || !beaconActiveOn(e, channel, now) || e.ssid[0] == '\0') return;
+        for (size_t i = 0; i < found; ++i) {
+            if (strcmp(ssids[i], e.ssid) == 0) return;
         }
-    }
+        memcpy(ssids[found++], e.ssid, sizeof(e.ssid));
+    });
+    portEXIT_CRITICAL(&beaconTableMux);
+
+    std::vector<String> out;
+    out.reserve(found);
+    for (size_t i = 0; i < found; ++i) out.push_back(String(ssids[i]));
     return out;
 }
 
+static size_t collectBeaconsOnChannel(uint8_t channel, uint8_t (*macs)[6], size_t maxItems) {
+    size_t found = 0;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&beaconTableMux);
+    beaconTable.forEach([&](const BeaconEntry &e) {
+        if (found < maxItems && beaconActiveOn(e, channel, now)) BeaconTable::keyToMac(e.key, macs[found++]);
+    });
+    portEXIT_CRITICAL(&beaconTableMux);
+    return found;
+}
+
 //===== SETUP =====//
 void sniffer_setup() {
     FS *Fs;
@@ -979,9 +1032,7 @@ void sniffer_setup() {
     tft.setCursor(80, 100);
 
     sniffer_reset_handshake_cache(); // Need to clear to restart HS count
-    registeredBeacons.clear();
-    beaconSsidCache.clear();
-    beaconLastSeen.clear(); // ensure starts empty
+    sniffer_reset_beacons();         // ensure starts empty
 
     /* setup wifi */
     ensureWifiPlatform();
@@ -1022,6 +1073,7 @@ void sniffer_setup() {
     num_EAPOL = 0;
     num_HS = 0;
     packet_counter = 0;
+    sniffer_dropped = 0;
     deauth_tmp = millis();
     // Prepare deauth frame for each AP record
     memcpy(deauth_frame, deauth_frame_default, sizeof(deauth_frame_default));
@@ -1079,7 +1131,7 @@ void sniffer_setup() {
             }
             if (millis() - _tmp > 700) { // longpress detected to exit
                 returnToMenu = true;
-                _pcap_file.close();
+                closeRawFile();
                 break;
             }
 #endif
@@ -1101,7 +1153,7 @@ void sniffer_setup() {
         // T-Embed has a different btn for Escape, different from StickCs that uses Previous btn
         if (check(EscPress)) {
             returnToMenu = true;
-            _pcap_file.close();
+            closeRawFile();
             break;
         }
 #endif
@@ -1140,13 +1192,13 @@ void sniffer_setup() {
                 {"Reset Counters",
                  [&]() {
                      packet_counter = 0;
+                     sniffer_dropped = 0;
                      num_EAPOL = 0;
                      num_HS = 0;
                      start_time = millis();
                      beacon_frames = 0;
-                     registeredBeacons.clear();
-                     beaconSsidCache.clear();
                      sniffer_reset_handshake_cache();
+                     sniffer_reset_beacons();
                      deauth_tmp = millis();
                  }                                                                                        },
                 {"Exit Sniffer",                                            [&]() { returnToMenu = true; }},
@@ -1195,14 +1247,14 @@ void sniffer_setup() {
             padprintln("Run time " + String(runtime / 60) + ":" + String(runtime % 60));
 
             // New: show beacon counts and recent SSIDs
-            size_t activeOnChannel = countActiveBeaconsOnChannel(all_wifi_channels[ch]);
+            size_t activeOnChannel = countActiveBeaconsOnChannel(ch);
             padprintln(
-                "Beacons " + String(beacon_frames) + " tot. /" + String(registeredBeacons.size()) +
+                "Beacons " + String(beacon_frames) + " tot. /" + String(sniffer_beacon_count()) +
                 " cached / ch " + String(activeOnChannel) + " active"
             );
 
             // show a short list of recent SSIDs on this channel (comma-separated)
-            std::vector<String> recentSsids = recentSsidsOnChannel(all_wifi_channels[ch], 5);
+            std::vector<String> recentSsids = recentSsidsOnChannel(ch, 5);
             if (!recentSsids.empty()) {
                 String s = "SSIDs: ";
                 for (size_t i = 0; i < recentSsids.size(); ++i) {
@@ -1229,15 +1281,23 @@ void sniffer_setup() {
             tft.drawString(
                 " EAPOL: " + String(num_EAPOL) + " HS: " + String(num_HS) + " ", 10, tftHeight - 18
             );
-            tft.drawCentreString("Packets " + String(packet_counter), tftWidth / 2, tftHeight - 26, 1);
+            String packetLine = "Packets " + String(packet_counter);
+            if (sniffer_dropped) packetLine += " (" + String(sniffer_dropped) + " lost)";
+            tft.drawCentreString(packetLine, tftWidth / 2, tftHeight - 26, 1);
         }
 
         if (currentTime - lastTime > 100) tft.drawPixel(0, 0, 0);
 
         if ((rawCaptureEnabled() || deauthCaptureEnabled()) && currentTime - lastTime > 1000) {
             if (lockFileMutex(pdMS_TO_TICKS(50))) {
-                if (rawCaptureEnabled()) { _pcap_file.flush(); }
-                if (deauthCaptureEnabled()) { _deauth_file.flush(); }
+                if (rawCaptureEnabled()) {
+                    rawWriter.flushAligned();
+                    _pcap_file.flush();
+                }
+                if (deauthCaptureEnabled()) {
+                    deauthWriter.flushAligned();
+                    _deauth_file.flush();
+                }
                 unlockFileMutex();
             }
             lastTime = currentTime; // update time
@@ -1245,21 +1305,17 @@ void sniffer_setup() {
 
         if (deauth && (millis() - deauth_tmp) > DEAUTH_INTERVAL) {
             bool deauth_sent = false;
-            if (registeredBeacons.size() > 40)
-                registeredBeacons.clear(); // Clear registered beacons to restart search and avoid restarts
+            uint8_t targets[40][6];
+            size_t targetCount = collectBeaconsOnChannel(ch, targets, 40);
             Serial.println("<<---- Starting Deauthentication Process ---->>");
-            for (auto registeredBeacon : registeredBeacons) {
-                if (registeredBeacon.channel == ch) {
-                    memcpy(&ap_record.bssid, registeredBeacon.MAC, 6);
-                    wsl_bypasser_send_raw_frame(
-                        &ap_record, registeredBeacon.channel
-                    ); // writes the buffer with the information
-                    // XXX: ap_record reused between this and wifi_atks.h
-                    send_raw_frame(deauth_frame, 26);
-                    deauth_sent = true;
-                    deauth_counter++;
-                    vTaskDelay(2 / portTICK_RATE_MS);
-                }
+            for (size_t i = 0; i < targetCount; ++i) {
+                memcpy(&ap_record.bssid, targets[i], 6);
+                wsl_bypasser_send_raw_frame(&ap_record, ch); // writes the buffer with the information
+                // XXX: ap_record reused between this and wifi_atks.h
+                send_raw_frame(deauth_frame, 26);
+                deauth_sent = true;
+                deauth_counter++;
+                vTaskDelay(2 / portTICK_RATE_MS);
             }
 
             if (deauth_sent) {
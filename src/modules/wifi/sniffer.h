@@ -60,8 +60,11 @@ bool sniffer_prepare_storage(FS *fs, bool sdDetected);
 void sniffer_wait_for_flush(uint32_t timeoutMs = 2000);
 void sniffer_reset_handshake_cache();
 void markHandshakeReady(uint64_t key);
+bool sniffer_beacon_seen(const uint8_t *bssid);
+size_t sniffer_beacon_count();
+void sniffer_reset_beacons();
 
-extern std::set<BeaconList> registeredBeacons;
+extern std::set<BeaconList> registeredBeacons; // filled by the pwngrid callback
 extern std::set<String> SavedHS;
 
 void newPacketSD(uint32_t ts_sec, uint32_t ts_usec, uint32_t len, uint8_t *buf, File pcap_file);
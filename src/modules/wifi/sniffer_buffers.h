@@ -0,0 +1,98 @@
+#pragma once
+// Allocation-free packet plumbing for the promiscuous sniffer.
+// Kept free of Arduino/IDF headers so the ring and pool can be built on the host.
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-producer/single-consumer ring. The producer is the promiscuous
+// callback, the consumer is the sniffer writer task. N must be a power of two.
+template <typename T, size_t N> class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    bool push(const T &item) {
+        const uint32_t head = _head.load(std::memory_order_relaxed);
+        const uint32_t tail = _tail.load(std::memory_order_acquire);
+        if (head - tail >= N) return false;
+        _items[head & (N - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) {
+        const uint32_t tail = _tail.load(std::memory_order_relaxed);
+        const uint32_t head = _head.load(std::memory_order_acquire);
+        if (head == tail) return false;
+        item = _items[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    // Only safe while neither side is running
+    void reset() {
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    T _items[N];
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+};
+
+// Fixed-size slab of packet buffers carved from one allocation.
+// Slots are acquired by the producer and released by the consumer; the free
+// list is itself an SPSC ring running in the opposite direction, so neither
+// side ever takes a lock or touches the heap.
+template <size_t MaxSlots> class PacketSlabPool {
+public:
+    static constexpr uint16_t INVALID_SLOT = 0xFFFF;
+
+    // storage must hold slotSize * slotCount bytes and outlive the pool
+    bool init(uint8_t *storage, size_t slotSize, size_t slotCount) {
+        _free.reset();
+        _storage = storage;
+        _slotSize = slotSize;
+        _slotCount = (slotCount > MaxSlots) ? MaxSlots : slotCount;
+        if (!_storage || _slotSize == 0 || _slotCount == 0) {
+            _storage = nullptr;
+            _slotCount = 0;
+            return false;
+        }
+        for (size_t i = 0; i < _slotCount; ++i) _free.push((uint16_t)i);
+        return true;
+    }
+
+    uint16_t acquire() {
+        uint16_t idx;
+        if (!_free.pop(idx)) return INVALID_SLOT;
+        return idx;
+    }
+
+    void release(uint16_t idx) {
+        if (idx < _slotCount) _free.push(idx);
+    }
+
+    uint8_t *slot(uint16_t idx) const {
+        if (!_storage || idx >= _slotCount) return nullptr;
+        return _storage + (size_t)idx * _slotSize;
+    }
+
+    size_t slotSize() const { return _slotSize; }
+    size_t slotCount() const { return _slotCount; }
+    size_t available() const { return _free.size(); }
+    bool ready() const { return _storage != nullptr; }
+
+private:
+    SpscRing<uint16_t, MaxSlots> _free;
+    uint8_t *_storage = nullptr;
+    size_t _slotSize = 0;
+    size_t _slotCount = 0;
+};
@@ -0,0 +1,236 @@
+// BeaconTable against the containers the sniffer kept before: std::set<BeaconList>, a std::map from
+// the BSSID to its SSID as a string and one to its last-seen time. A beacon stream from 1k, 5k and 20k
+// access points is replayed into both; reports the time per beacon and per frame lookup and the memory
+// each side holds, the table at the device's 4096 entries and sized to fit. Heap figures are the bytes
+// requested plus the block count, on a 64-bit host. Also checks the table against a std::map model.
+
+#include "host_test.h"
+#include "modules/wifi/beacon_table.h"
+#include <chrono>
+#include <map>
+#include <random>
+#include <set>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static std::mt19937 rng(2);
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Counts what the old containers take from the heap
+static size_t heapBytes = 0, heapBlocks = 0;
+
+template <typename T> struct Counted {
+    typedef T value_type;
+    Counted() = default;
+    template <typename U> Counted(const Counted<U> &) {}
+    T *allocate(size_t n) {
+        heapBytes += n * sizeof(T);
+        heapBlocks++;
+        return (T *)::operator new(n * sizeof(T));
+    }
+    void deallocate(T *p, size_t n) {
+        heapBytes -= n * sizeof(T);
+        heapBlocks--;
+        ::operator delete(p);
+    }
+    template <typename U> bool operator==(const Counted<U> &) const { return true; }
+    template <typename U> bool operator!=(const Counted<U> &) const { return false; }
+};
+
+// As in sniffer.h
+struct BeaconList {
+    char MAC[6];
+    uint8_t channel;
+    bool operator<(const BeaconList &other) const {
+        int cmp = memcmp(MAC, other.MAC, sizeof(MAC));
+        if (cmp != 0) return cmp < 0;
+        return channel < other.channel;
+    }
+};
+
+typedef std::basic_string<char, std::char_traits<char>, Counted<char>> Ssid;
+
+struct OldContainers {
+    std::set<BeaconList, std::less<BeaconList>, Counted<BeaconList>> registeredBeacons;
+    std::map<uint64_t, Ssid, std::less<uint64_t>, Counted<std::pair<const uint64_t, Ssid>>> ssidCache;
+    std::map<uint64_t, uint32_t, std::less<uint64_t>, Counted<std::pair<const uint64_t, uint32_t>>> lastSeen;
+};
+
+struct Ap {
+    uint8_t mac[6];
+    uint8_t channel;
+    std::string ssid;
+};
+
+static std::vector<Ap> accessPoints(size_t n) {
+    // a few vendor prefixes, as in a real scan
+    static const uint8_t ouis[][3] = {{0x00, 0x1A, 0x2B}, {0xF4, 0xEC, 0x38}, {0x3C, 0x84, 0x6A}};
+    std::vector<Ap> aps(n);
+    std::set<uint64_t> used;
+    for (Ap &ap : aps) {
+        do {
+            memcpy(ap.mac, ouis[rng() % 3], 3);
+            for (int i = 3; i < 6; i++) ap.mac[i] = rng();
+        } while (!used.insert(BeaconTable::macToKey(ap.mac)).second);
+        ap.channel = 1 + rng() % 13;
+        size_t len = 4 + rng() % 29;
+        for (size_t i = 0; i < len; i++) ap.ssid += 'a' + rng() % 26;
+    }
+    return aps;
+}
+
+struct Timing {
+    double beaconNs, lookupNs;
+    size_t hits;
+};
+
+// What handling a beacon and resolving the SSID of another frame cost in the old sniffer
+static Timing replayOld(OldContainers &old, const std::vector<Ap> &aps, const std::vector<uint32_t> &stream) {
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t now = 0;
+    for (uint32_t i : stream) {
+        const Ap &ap = aps[i];
+        uint64_t key = BeaconTable::macToKey(ap.mac);
+        old.ssidCache[key] = Ssid(ap.ssid.c_str());
+        BeaconList beacon;
+        memcpy(beacon.MAC, ap.mac, 6);
+        beacon.channel = ap.channel;
+        old.registeredBeacons.insert(beacon);
+        old.lastSeen[key] = now++;
+    }
+    double beaconNs = nsSince(t0) / stream.size();
+
+    size_t hits = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (uint32_t i : stream) {
+        auto it = old.ssidCache.find(BeaconTable::macToKey(aps[i].mac));
+        if (it != old.ssidCache.end()) {
+            Ssid ssid = it->second; // resolveSsidForFrame returned a copy
+            hits += ssid.size() > 0;
+        }
+    }
+    return {beaconNs, nsSince(t0) / stream.size(), hits};
+}
+
+static Timing
+replayTable(BeaconTable &table, const std::vector<Ap> &aps, const std::vector<uint32_t> &stream) {
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t now = 0;
+    for (uint32_t i : stream) {
+        const Ap &ap = aps[i];
+        BeaconEntry *e = table.upsert(BeaconTable::macToKey(ap.mac), now);
+        if (!e) continue;
+        e->lastSeen = now++;
+        e->channel = ap.channel;
+        e->flags |= BEACON_FLAG_SEEN;
+        strncpy(e->ssid, ap.ssid.c_str(), BEACON_SSID_MAX);
+        e->ssid[BEACON_SSID_MAX] = '\0';
+    }
+    double beaconNs = nsSince(t0) / stream.size();
+
+    size_t hits = 0;
+    char ssid[BEACON_SSID_MAX + 1];
+    t0 = std::chrono::steady_clock::now();
+    for (uint32_t i : stream) {
+        const BeaconEntry *e = table.find(BeaconTable::macToKey(aps[i].mac));
+        if (e) {
+            memcpy(ssid, e->ssid, sizeof(ssid));
+            hits += ssid[0] != '\0';
+        }
+    }
+    return {beaconNs, nsSince(t0) / stream.size(), hits};
+}
+
+static void testAgainstContainers() {
+    printf("  APs  old: beacon  lookup   heap             table: capacity  beacon  lookup  bytes     hits\n");
+    for (size_t n : {1000, 5000, 20000}) {
+        std::vector<Ap> aps = accessPoints(n);
+        // every AP beacons, then a stream skewed to the strong ones, the way they are heard
+        std::vector<uint32_t> stream;
+        for (uint32_t i = 0; i < n; i++) stream.push_back(i);
+        std::geometric_distribution<uint32_t> skew(3.0 / n);
+        for (size_t i = 0; i < 200000; i++) stream.push_back(std::min<uint32_t>(skew(rng), n - 1));
+
+        heapBytes = heapBlocks = 0;
+        OldContainers *old = new OldContainers;
+        Timing o = replayOld(*old, aps, stream);
+        size_t oldBytes = heapBytes, oldBlocks = heapBlocks;
+        delete old;
+        CHECK_EQ(o.hits, stream.size());
+
+        size_t sized = 1;
+        while (sized - sized / 8 < n) sized <<= 1;
+        for (size_t capacity : {(size_t)4096, sized}) {
+            std::vector<BeaconEntry> storage(capacity);
+            BeaconTable table;
+            CHECK(table.init(storage.data(), capacity));
+            Timing t = replayTable(table, aps, stream);
+            printf(
+                "%5zu      %6.0f  %6.0f  %7zu in %5zu      %8zu  %6.0f  %6.0f  %7zu  %5.1f%%\n", n,
+                o.beaconNs, o.lookupNs, oldBytes, oldBlocks, table.capacity(), t.beaconNs, t.lookupNs,
+                BeaconTable::bytesFor(table.capacity()), 100.0 * t.hits / stream.size()
+            );
+            // every AP is found when the table fits them all
+            if (capacity == sized) CHECK_EQ(t.hits, stream.size());
+            else CHECK(table.size() <= table.capacity());
+        }
+    }
+}
+
+// Random upserts, erases and expiries against a std::map of the same entries
+static void testAgainstModel() {
+    std::vector<BeaconEntry> storage(256);
+    BeaconTable table;
+    CHECK(table.init(storage.data(), storage.size()));
+    std::map<uint64_t, uint32_t> model; // key -> lastSeen
+    int mismatches = 0;
+    uint32_t now = 0;
+    for (int step = 0; step < 200000; step++) {
+        uint64_t key = rng() % 400;
+        int op = rng() % 20;
+        now += rng() % 20;
+        if (op < 12) {
+            // below the load limit nothing is evicted
+            if (table.size() >= 200 && !model.count(key)) continue;
+            BeaconEntry *e = table.upsert(key, now);
+            if (!e) mismatches++;
+            else e->lastSeen = now;
+            model[key] = now;
+        } else if (op < 16) {
+            if (table.erase(key) != (model.erase(key) == 1)) mismatches++;
+        } else if (op < 17) {
+            table.expire(now, 2000);
+            for (auto it = model.begin(); it != model.end();) {
+                if (now - it->second > 2000) it = model.erase(it);
+                else ++it;
+            }
+        } else {
+            const BeaconEntry *e = table.find(key);
+            if ((e != nullptr) != (model.count(key) == 1)) mismatches++;
+            else if (e && e->lastSeen != model[key]) mismatches++;
+        }
+        if (table.size() != model.size()) mismatches++;
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(table.evictions(), 0);
+
+    // full: the least recently seen unpinned entry of the window goes, pinned ones stay
+    table.clear();
+    for (uint64_t key = 0; key < 224; key++)
+        table.upsert(key, 1000 + key)->flags |= BEACON_FLAG_HS_READY;
+    CHECK(table.upsert(999, 5000) == nullptr);
+    table.find(7)->flags &= ~BEACON_FLAG_HS_READY;
+    CHECK(table.upsert(999, 5000) != nullptr);
+    CHECK(table.find(7) == nullptr);
+    CHECK_EQ(table.evictions(), 1);
+}
+
+int main() {
+    testAgainstContainers();
+    testAgainstModel();
+    return HOST_TEST_RESULT();
+}
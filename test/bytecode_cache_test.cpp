@@ -0,0 +1,238 @@
+// The bytecode cache of the interpreter (bytecode_cache.h) against the real mquickjs, with a host
+// build of the stdlib table from mqjs_stdlib.c and the bindings stubbed. Every bundled script in
+// sd_files/interpreter is compiled and stored as a .jsc the way compileToCache() does, then read back,
+// relocated into a fresh context and loaded as loadCachedBytecode() and the interpreter do. Example1.js
+// is run from its cache and must draw what it draws from source. A cache from another stdlib build,
+// for an edited script or cut short is refused. Also checks that the committed mqjs_stdlib.h is what
+// gen_mqjs_headers.py makes of the current sources. Built only when the mquickjs sources are found.
+
+#include "host_test.h"
+#include "modules/bjs_interpreter/bytecode_cache.h"
+#include "stdlib_signature.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "mquickjs.h"
+
+extern const JSSTDLibraryDef js_stdlib;
+}
+
+// the interpreter's context on boards with PSRAM, twice over for the 64 bit values of the host
+#define MEM_SIZE (2 * 65536)
+
+static std::vector<std::string> drawn;
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void logFunc(void *, const void *buf, size_t len) { fwrite(buf, 1, len, stderr); }
+
+// The bindings Example1.js needs to run to its end, every other one is a stub of host_stdlib.c
+extern "C" {
+JSValue native_require(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
+    JSCStringBuf buf;
+    const char *name = argc > 0 ? JS_ToCString(ctx, argv[0], &buf) : NULL;
+    if (!name) return JS_EXCEPTION;
+    return JS_GetPropertyStr(ctx, JS_GetGlobalObject(ctx), name);
+}
+
+JSValue native_width(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
+    return JS_NewInt32(ctx, 240);
+}
+
+JSValue native_height(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
+    return JS_NewInt32(ctx, 135);
+}
+
+// Esc held from the start: the script draws "Exiting" and leaves its loop
+JSValue native_getEscPress(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
+    return JS_NewBool(1);
+}
+
+JSValue native_drawString(JSContext *ctx, JSValue *this_val, int argc, JSValue *argv) {
+    JSCStringBuf buf;
+    const char *s = argc > 0 ? JS_ToCString(ctx, argv[0], &buf) : NULL;
+    drawn.push_back(s ? s : "");
+    return JS_UNDEFINED;
+}
+}
+
+static std::string readFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// What compileToCache() writes: BjsCacheHeader, then JSBytecodeHeader and the data. Empty if the
+// script does not compile.
+static std::vector<uint8_t> compileToCache(uint8_t *mem, const char *name, const std::string &source) {
+    JSContext *ctx = JS_NewContext(mem, MEM_SIZE, &js_stdlib);
+    JS_SetLogFunc(ctx, logFunc);
+    std::vector<uint8_t> file;
+    JSValue code = JS_Parse(ctx, source.data(), source.size(), name, 0);
+    if (!JS_IsException(code)) {
+        JSBytecodeHeader hdr;
+        const uint8_t *data;
+        uint32_t dataLen;
+        JS_PrepareBytecode(ctx, &hdr, &data, &dataLen, code);
+        BjsCacheHeader cacheHdr;
+        uint32_t bytecodeLen = sizeof(hdr) + dataLen;
+        bjsCacheFillHeader(&cacheHdr, MQJS_STDLIB_SIGNATURE, source.data(), source.size(), bytecodeLen);
+        file.insert(file.end(), (uint8_t *)&cacheHdr, (uint8_t *)&cacheHdr + sizeof(cacheHdr));
+        file.insert(file.end(), (uint8_t *)&hdr, (uint8_t *)&hdr + sizeof(hdr));
+        file.insert(file.end(), data, data + dataLen);
+    }
+    JS_FreeContext(ctx);
+    return file;
+}
+
+// What loadCachedBytecode() takes from a .jsc: the bytecode, empty if it does not match the script
+static std::vector<uint8_t> loadCached(const std::vector<uint8_t> &file, const std::string &source) {
+    BjsCacheHeader hdr;
+    if (file.size() < sizeof(hdr)) return {};
+    memcpy(&hdr, file.data(), sizeof(hdr));
+    if (!bjsCacheMatches(&hdr, file.size(), MQJS_STDLIB_SIGNATURE, source.data(), source.size())) return {};
+    std::vector<uint8_t> bytecode(file.begin() + sizeof(hdr), file.end());
+    if (!JS_IsBytecode(bytecode.data(), bytecode.size())) return {};
+    return bytecode;
+}
+
+static void testBundledScripts(uint8_t *mem) {
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(BRUCE_SD_FILES "/interpreter")) {
+        if (entry.is_regular_file() && entry.path().extension() == ".js") paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+    CHECK(!paths.empty());
+
+    size_t compiled = 0, loaded = 0, sourceBytes = 0, bytecodeBytes = 0;
+    double compileMs = 0, loadMs = 0;
+    for (const std::string &path : paths) {
+        std::string source = readFile(path);
+        std::string name = std::filesystem::path(path).filename();
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<uint8_t> file = compileToCache(mem, name.c_str(), source);
+        compileMs += nsSince(t0) / 1e6;
+        if (file.empty()) {
+            // the interpreter runs it from source then, which reports the error
+            printf("%s: does not compile, no cache\n", name.c_str());
+            continue;
+        }
+        compiled++;
+        sourceBytes += source.size();
+        bytecodeBytes += file.size() - sizeof(BjsCacheHeader);
+
+        t0 = std::chrono::steady_clock::now();
+        std::vector<uint8_t> bytecode = loadCached(file, source);
+        JSContext *ctx = JS_NewContext(mem, MEM_SIZE, &js_stdlib);
+        JS_SetLogFunc(ctx, logFunc);
+        if (!bytecode.empty() && JS_RelocateBytecode(ctx, bytecode.data(), bytecode.size()) == 0 &&
+            !JS_IsException(JS_LoadBytecode(ctx, bytecode.data())))
+            loaded++;
+        else
+            printf("%s: cache does not load\n", name.c_str());
+        JS_FreeContext(ctx);
+        loadMs += nsSince(t0) / 1e6;
+    }
+    printf(
+        "%zu of %zu scripts compiled, %zu B of source to %zu B of bytecode: compile %.2f ms, load from the "
+        "cache %.2f ms\n",
+        compiled, paths.size(), sourceBytes, bytecodeBytes, compileMs, loadMs
+    );
+    CHECK(compiled > 0);
+    CHECK_EQ(loaded, compiled);
+}
+
+static void testRunFromCache(uint8_t *mem) {
+    std::string source = readFile(BRUCE_SD_FILES "/interpreter/Example1.js");
+    std::vector<uint8_t> bytecode = loadCached(compileToCache(mem, "Example1.js", source), source);
+    CHECK(!bytecode.empty());
+    if (bytecode.empty()) return;
+
+    // the bytecode runs in place, in a context of its own as in interpreterHandler()
+    drawn.clear();
+    JSContext *ctx = JS_NewContext(mem, MEM_SIZE, &js_stdlib);
+    JS_SetLogFunc(ctx, logFunc);
+    CHECK_EQ(JS_RelocateBytecode(ctx, bytecode.data(), bytecode.size()), 0);
+    CHECK(!JS_IsException(JS_Run(ctx, JS_LoadBytecode(ctx, bytecode.data()))));
+    JS_FreeContext(ctx);
+    std::vector<std::string> fromCache = drawn;
+    CHECK(std::find(fromCache.begin(), fromCache.end(), "Exiting") != fromCache.end());
+
+    drawn.clear();
+    ctx = JS_NewContext(mem, MEM_SIZE, &js_stdlib);
+    JS_SetLogFunc(ctx, logFunc);
+    CHECK(!JS_IsException(JS_Eval(ctx, source.data(), source.size(), "Example1.js", 0)));
+    JS_FreeContext(ctx);
+    CHECK(drawn == fromCache);
+}
+
+static void testStale(uint8_t *mem) {
+    std::string source = "var total = 0;\nfor (var i = 0; i < 10; i++) total += i;\n";
+    std::vector<uint8_t> file = compileToCache(mem, "stale.js", source);
+    CHECK(!loadCached(file, source).empty());
+
+    // written by a build with another stdlib table, whose bytecode refers to other atoms
+    std::vector<uint8_t> stale = file;
+    ((BjsCacheHeader *)stale.data())->buildId = ~(uint32_t)MQJS_STDLIB_SIGNATURE;
+    CHECK(loadCached(stale, source).empty());
+
+    // the script edited since, at the same length
+    std::string edited = source;
+    edited[edited.find("10")] = '9';
+    CHECK(loadCached(file, edited).empty());
+
+    // cut short by a full card, or nothing but the header
+    std::vector<uint8_t> cut(file.begin(), file.end() - 1);
+    CHECK(loadCached(cut, source).empty());
+    cut.resize(sizeof(BjsCacheHeader));
+    CHECK(loadCached(cut, source).empty());
+
+    // mquickjs refuses bytecode that is not its own
+    std::vector<uint8_t> foreign = file;
+    foreign[sizeof(BjsCacheHeader)] ^= 0xFF;
+    CHECK(loadCached(foreign, source).empty());
+}
+
+// mqjs_stdlib.h as committed, what the firmware builds with when the generator does not run, is the
+// generator's output for the current sources: their signature, then their table unchanged
+static void testCommittedHeader() {
+    std::string header = readFile(BRUCE_BJS_DIR "/mqjs_stdlib.h");
+    const char *define = "#define MQJS_STDLIB_SIGNATURE ";
+    size_t at = header.find(define);
+    CHECK(at != std::string::npos);
+    if (at == std::string::npos) return;
+    unsigned long committed = strtoul(header.c_str() + at + strlen(define), NULL, 16);
+    std::string table = readFile(BRUCE_MQJS_GEN_DIR "/firmware_stdlib.h");
+    size_t tableAt = header.find("\n\n", at) + 2;
+    bool sameTable = !table.empty() && header.compare(tableAt, std::string::npos, table) == 0;
+    if (committed != MQJS_STDLIB_SIGNATURE || !sameTable) {
+        printf(
+            "mqjs_stdlib.h is stamped %08lx, the sources give %08x, table %s: build the firmware to "
+            "regenerate it\n",
+            committed, MQJS_STDLIB_SIGNATURE, sameTable ? "the same" : "differs"
+        );
+    }
+    CHECK_EQ(committed, MQJS_STDLIB_SIGNATURE);
+    CHECK(sameTable);
+}
+
+int main() {
+    std::vector<uint8_t> mem(MEM_SIZE);
+    testStale(mem.data());
+    testRunFromCache(mem.data());
+    testBundledScripts(mem.data());
+    testCommittedHeader();
+    return HOST_TEST_RESULT();
+}
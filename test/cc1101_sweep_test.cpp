@@ -0,0 +1,234 @@
+// RfSweepEngine driving a fake CC1101 behind RfSweepRadio. The fake keeps the FREQ, CHANSPC and
+// CHANNR registers, charges SPI time per register access and 721 us per calibration, and returns a
+// stale RSSI when read before the PLL has settled and the RSSI filter has seen two updates. Checks
+// that every tuned frequency matches the plan and its grid, that each hop uses a calibration of its
+// own band and that calibrations are reused across sweeps and re-plans. Reports samples/s against
+// the previous setMHZ() per sample with a fixed 100 us wait.
+
+#include "host_test.h"
+#include "modules/rf/rf_sweep.h"
+#include <math.h>
+#include <set>
+#include <vector>
+
+#define SPI_ACCESS_US 10.0 // one register access or strobe over the Arduino SPI driver
+#define CAL_US 721.0       // FS calibration from IDLE, datasheet
+#define PLL_SETTLE_US 88.4 // IDLE to RX without calibration
+
+class FakeCc1101 : public RfSweepRadio {
+public:
+    FakeCc1101(float kbaud, float bwKhz) : _kbaud(kbaud), _bw(bwKhz) {}
+
+    float dataRateKbaud() override { return _kbaud; }
+    float rxBandwidthKhz() override { return _bw; }
+
+    void setChannelSpacing(uint8_t exponent, uint8_t mantissa) override {
+        _e = exponent;
+        _m = mantissa;
+        spi(2);
+    }
+    void setBase(uint32_t freqWord) override {
+        _freqWord = freqWord;
+        spi(3);
+    }
+    void calibrate(uint8_t channel, RfCalibration &cal) override {
+        _channel = channel;
+        spi(3); // SIDLE, CHANNR, SCAL
+        now += CAL_US;
+        // the values only fit the band they were made in
+        uint32_t band = synthHz() / RF_SWEEP_CAL_BAND_HZ;
+        cal = {(uint8_t)(band >> 8), (uint8_t)band, 0x5A};
+        spi(3);
+        calibrations++;
+    }
+    void tune(uint8_t channel, const RfCalibration &cal, uint32_t hz) override {
+        _channel = channel;
+        spi(6); // SIDLE, CHANNR, FSCAL3..1, SRX
+        uint32_t band = (uint32_t)cal.fscal3 << 8 | cal.fscal2;
+        if (cal.fscal1 != 0x5A || band != synthHz() / RF_SWEEP_CAL_BAND_HZ) wrongCalibrations++;
+        if (hz != synthHz()) wrongFrequencies++;
+        tuned.push_back(synthHz());
+        _rxAt = now + PLL_SETTLE_US;
+    }
+    int readRssi() override {
+        spi(1);
+        // two RSSI filter updates after the PLL has locked (FILTER_LENGTH 1: 8 * 2 / (2 * BW))
+        if (now < _rxAt + 2 * 8000.0 / _bw) stale++;
+        return signalAt(synthHz());
+    }
+    void delayUs(uint32_t us) override { now += us; }
+
+    // The previous path: setMHZ() writes FREQ and recalibrates on the way to RX, then a fixed wait
+    int oldSample(uint32_t hz, uint32_t waitUs) {
+        _freqWord = rfFreqToWord(hz);
+        _channel = 0;
+        spi(1 + 3 + 2 + 1); // SIDLE, FREQ2..0, FSCTRL0 and TEST regs, SRX
+        now += CAL_US;      // FS_AUTOCAL on IDLE -> RX
+        _rxAt = now + PLL_SETTLE_US;
+        delayUs(waitUs);
+        return readRssi();
+    }
+
+    uint32_t synthHz() const {
+        uint64_t offset = ((uint64_t)_channel * ((256u + _m) << _e) * RF_SWEEP_XOSC_HZ) >> 18;
+        return rfWordToHz(_freqWord) + (uint32_t)offset;
+    }
+
+    // one carrier at 433.92 MHz, 100 kHz wide
+    static int signalAt(uint32_t hz) {
+        double off = fabs((double)hz - 433920000.0);
+        return off < 100000 ? -40 - (int)(off / 5000) : -100;
+    }
+
+    double now = 0;
+    int calibrations = 0, wrongCalibrations = 0, wrongFrequencies = 0, stale = 0;
+    std::vector<uint32_t> tuned;
+
+private:
+    void spi(int accesses) { now += accesses * SPI_ACCESS_US; }
+
+    float _kbaud, _bw;
+    uint8_t _e = 2, _m = 248;
+    uint32_t _freqWord = 0;
+    uint8_t _channel = 0;
+    double _rxAt = 0;
+};
+
+static std::set<uint32_t> bands(const RfSweepEngine &sweep) {
+    std::set<uint32_t> out;
+    for (size_t i = 0; i < sweep.points(); i++)
+        out.insert((uint32_t)(sweep.pointMhz(i) * 1e6 + 0.5) / RF_SWEEP_CAL_BAND_HZ);
+    return out;
+}
+
+// Even sweeps: every hop lands on the planned frequency, near its ideal grid point
+static void testPlans() {
+    struct Range {
+        float start, end;
+        size_t points;
+    };
+    static const Range ranges[] = {
+        {433.0f, 435.0f, 240}, // 8.3 kHz steps: finer than CHANSPC, one base per point
+        {300.0f, 348.0f, 240}, // 200 kHz
+        {779.0f, 928.0f, 480}, // 310 kHz
+        {387.0f, 464.0f, 240}, // 321 kHz
+        {433.0f, 433.2f, 240}, // 833 Hz, below the FREQ resolution
+    };
+    for (const Range &r : ranges) {
+        FakeCc1101 radio(38.4f, 270.0f);
+        RfSweepEngine *sweep = new RfSweepEngine;
+        CHECK(sweep->begin(&radio, r.start, r.end, r.points));
+        sweep->sweep(nullptr);
+        double step = (r.end - r.start) * 1e6 / r.points;
+        bool stepping = step >= 25400 && step <= 405000;
+        CHECK_EQ(sweep->channelStepping(), stepping);
+        double worst = 0;
+        for (size_t i = 0; i < r.points; i++) {
+            double ideal = r.start * 1e6 + i * step;
+            worst = fmax(worst, fabs(radio.tuned[i] - ideal));
+            if (fabs(sweep->pointMhz(i) * 1e6 - radio.tuned[i]) > 64) radio.wrongFrequencies++;
+        }
+        printf(
+            "%6.1f-%6.1f MHz, %3zu points, %s: %3u base writes, %3d calibrations, %5.0f Hz off the grid\n",
+            r.start, r.end, r.points, stepping ? "channel stepping" : "base per point  ", sweep->baseWrites(),
+            radio.calibrations, worst
+        );
+        CHECK_EQ(radio.tuned.size(), r.points);
+        CHECK_EQ(radio.wrongFrequencies, 0);
+        CHECK_EQ(radio.wrongCalibrations, 0);
+        // within 1/8 step, or the FREQ resolution when the step is finer than that
+        CHECK(worst <= fmax(step / 8, RF_SWEEP_XOSC_HZ / 65536.0));
+        if (stepping) CHECK(sweep->baseWrites() < r.points / 4);
+        CHECK_EQ(radio.calibrations, bands(*sweep).size());
+        delete sweep;
+    }
+}
+
+// Bands calibrated so far, against what the fake was asked to calibrate
+static size_t newBands(const RfSweepEngine &sweep, std::set<uint32_t> &valid) {
+    size_t fresh = 0;
+    for (uint32_t band : bands(sweep)) fresh += valid.insert(band).second;
+    return fresh;
+}
+
+static void testCalibrationCache() {
+    FakeCc1101 radio(38.4f, 270.0f);
+    RfSweepEngine *sweep = new RfSweepEngine;
+    std::set<uint32_t> valid;
+    CHECK(sweep->begin(&radio, 433.0f, 435.0f, 240));
+    sweep->sweep(nullptr);
+    // 433.0 MHz tunes to 432.99997, in the band below
+    CHECK_EQ(radio.calibrations, newBands(*sweep, valid));
+    CHECK_EQ(radio.calibrations, 3);
+    radio.calibrations = 0;
+    sweep->sweep(nullptr);
+    CHECK_EQ(radio.calibrations, 0);
+
+    // re-planned to an overlapping range: only the new bands are calibrated
+    CHECK(sweep->begin(&radio, 434.0f, 437.0f, 240));
+    sweep->sweep(nullptr);
+    CHECK_EQ(radio.calibrations, newBands(*sweep, valid));
+    CHECK_EQ(radio.calibrations, 2);
+    radio.calibrations = 0;
+    sweep->invalidateCalibration();
+    valid.clear();
+    sweep->sweep(nullptr);
+    CHECK_EQ(radio.calibrations, newBands(*sweep, valid));
+
+    // a frequency list, as in the fast scan: one base per entry, one calibration per band not yet known
+    static const float list[] = {300.0f, 315.0f, 433.92f, 433.42f, 868.35f, 915.0f, 300.0f};
+    radio.calibrations = 0;
+    radio.tuned.clear();
+    CHECK(sweep->begin(&radio, list, 7));
+    sweep->sweep(nullptr);
+    CHECK_EQ(radio.calibrations, newBands(*sweep, valid));
+    CHECK_EQ(sweep->baseWrites(), 7);
+    for (size_t i = 0; i < 7; i++) CHECK(fabs(radio.tuned[i] - list[i] * 1e6) < 400);
+    CHECK_EQ(radio.wrongCalibrations, 0);
+    CHECK_EQ(radio.wrongFrequencies, 0);
+    delete sweep;
+}
+
+// A full waterfall line at several modem settings: samples/s, stale readings, and the carrier found
+static void testRate() {
+    struct Modem {
+        float kbaud, bw;
+    };
+    static const Modem modems[] = {{1.2f, 58.0f}, {4.8f, 135.0f}, {38.4f, 270.0f}, {100.0f, 812.0f}};
+    for (const Modem &m : modems) {
+        FakeCc1101 radio(m.kbaud, m.bw);
+        RfSweepEngine *sweep = new RfSweepEngine;
+        CHECK(sweep->begin(&radio, 433.0f, 435.0f, 240));
+        std::vector<int> rssi(240);
+        sweep->sweep(rssi.data()); // calibrates
+        double t0 = radio.now;
+        for (int pass = 0; pass < 10; pass++) sweep->sweep(rssi.data());
+        double newRate = 2400 / ((radio.now - t0) / 1e6);
+        int newStale = radio.stale;
+        size_t peak = 0;
+        for (size_t i = 0; i < 240; i++)
+            if (rssi[i] > rssi[peak]) peak = i;
+
+        FakeCc1101 old(m.kbaud, m.bw);
+        for (int pass = 0; pass < 10; pass++)
+            for (size_t i = 0; i < 240; i++) old.oldSample((uint32_t)(433e6 + i * (2e6 / 240)), 100);
+        double oldRate = 2400 / (old.now / 1e6);
+        printf(
+            "%5.1f kBaud, %3.0f kHz: %4.0f samples/s, %u us wait, %d stale; setMHZ: %4.0f samples/s, "
+            "%4d stale\n",
+            m.kbaud, m.bw, newRate, sweep->settleUs(), newStale, oldRate, old.stale
+        );
+        CHECK_EQ(newStale, 0);
+        CHECK(fabs(sweep->pointMhz(peak) - 433.92f) < 0.01f);
+        // no calibration per sample: faster unless the RSSI wait itself dominates
+        if (sweep->settleUs() < CAL_US) CHECK(newRate > oldRate);
+        delete sweep;
+    }
+}
+
+int main() {
+    testPlans();
+    testCalibrationCache();
+    testRate();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,279 @@
+// ConfigStore on simulated flash where the power can go at every byte written, rename and remove:
+// whatever the point, the next boot loads the settings before the save or after it, also when the
+// power goes again while load() repairs, and on FAT where a rename can't replace. Also covers
+// ConfigDebounce and reports the bytes a scripted settings session writes.
+
+#include "core/config_store.h"
+#include "host_test.h"
+#include <string>
+#include <vector>
+
+struct PowerLoss {};
+
+// Files in memory; every byte written, rename and remove spends one unit of power
+struct SimStorage : ConfigStorage {
+    std::map<std::string, std::string> files;
+    long budget = -1; // -1: unlimited
+    bool fatRename = false; // rename can't replace: remove, then rename
+    uint64_t bytes = 0;
+    void spend() {
+        if (budget == 0) throw PowerLoss();
+        if (budget > 0) budget--;
+    }
+    bool read(const char *p, std::string &d) override {
+        auto it = files.find(p);
+        if (it == files.end()) return false;
+        d = it->second;
+        return true;
+    }
+    bool write(const char *p, const uint8_t *d, size_t n) override {
+        spend();
+        files[p].clear(); // truncate
+        for (size_t i = 0; i < n; i++) {
+            spend();
+            files[p] += (char)d[i];
+            bytes++;
+        }
+        return true;
+    }
+    bool rename(const char *from, const char *to) override {
+        if (!files.count(from)) return false;
+        if (fatRename && files.count(to)) {
+            spend();
+            files.erase(to);
+        }
+        spend();
+        files[to] = files[from];
+        files.erase(from);
+        return true;
+    }
+    bool remove(const char *p) override {
+        spend();
+        files.erase(p);
+        return true;
+    }
+};
+
+static ConfigRecords makeConfig(int variant) {
+    ConfigRecords r;
+    for (int id = 1; id <= 45; id++) r[id] = std::string(4 + id % 7, (char)('a' + id % 26));
+    r[7] = std::string(1, (char)variant);
+    r[28] = std::string(40 + variant % 50, 'w'); // wifi list grows
+    if (variant % 3 == 0) r[50 + variant % 5] = "x";
+    return r;
+}
+
+// Saves a sequence of configs, cutting the power at every write point of every save
+static void crashTest(bool fat) {
+    long crashes = 0;
+    for (int step = 1; step < 12; step++) {
+        ConfigRecords before = makeConfig(step - 1), after = makeConfig(step);
+        for (long budget = 0;; budget++) {
+            SimStorage fs;
+            fs.fatRename = fat;
+            {
+                ConfigStore s(fs, "/bruce.bin");
+                for (int i = 0; i < step; i++) CHECK(s.save(makeConfig(i)));
+            }
+            ConfigStore s(fs, "/bruce.bin");
+            ConfigRecords loaded;
+            CHECK(s.load(loaded) && loaded == before);
+            fs.budget = budget;
+            bool done = false;
+            try {
+                CHECK(s.save(after));
+                done = true;
+            } catch (PowerLoss &) {}
+            fs.budget = -1;
+
+            // boot after the power came back
+            ConfigStore boot(fs, "/bruce.bin");
+            ConfigRecords got;
+            CHECK(boot.load(got));
+            CHECK(got == before || got == after);
+            if (done) CHECK(got == after);
+            // and it keeps working: a later save, with its own power loss inside the repair
+            ConfigRecords next = makeConfig(step + 100);
+            CHECK(boot.save(next));
+            ConfigStore again(fs, "/bruce.bin");
+            CHECK(again.load(got) && got == next);
+            if (done) break;
+            crashes++;
+        }
+    }
+    printf(
+        "%s rename: %ld power losses, all loaded the old or the new settings\n",
+        fat ? "FAT" : "atomic",
+        crashes
+    );
+}
+
+// Power lost again while load() finishes a rename left by the previous loss
+static void crashDuringRepair() {
+    long checked = 0;
+    for (long first = 0;; first++) {
+        SimStorage fs;
+        fs.fatRename = true;
+        ConfigStore s(fs, "/bruce.bin");
+        s.save(makeConfig(0));
+        fs.budget = first;
+        bool done = false;
+        try {
+            s.save(makeConfig(1));
+            done = true;
+        } catch (PowerLoss &) {}
+        if (done) break;
+        fs.budget = -1;
+        SimStorage ref = fs;
+        ConfigRecords expected;
+        ConfigStore(ref, "/bruce.bin").load(expected);
+        for (long second = 0; second < 4; second++) {
+            SimStorage copy = fs;
+            copy.budget = second;
+            ConfigRecords got;
+            try {
+                ConfigStore b(copy, "/bruce.bin");
+                b.load(got);
+            } catch (PowerLoss &) {}
+            copy.budget = -1;
+            ConfigStore b(copy, "/bruce.bin");
+            CHECK(b.load(got));
+            // what the first boot would have loaded, never the settings before it
+            CHECK(got == expected);
+            checked++;
+        }
+    }
+    printf("power lost during the repair: %ld cases\n", checked);
+}
+
+static void corruptTest() {
+    SimStorage fs;
+    ConfigStore s(fs, "/bruce.bin");
+    ConfigRecords r;
+    CHECK(!s.load(r));
+    CHECK(s.save(makeConfig(1)));
+    std::string &f = fs.files["/bruce.bin"];
+    for (size_t i = 0; i < f.size(); i++) {
+        SimStorage c = fs;
+        c.files["/bruce.bin"][i] ^= 0x10;
+        ConfigStore b(c, "/bruce.bin");
+        CHECK(!b.load(r));
+    }
+    // unknown ids are kept as records, the caller ignores them
+    ConfigStore b(fs, "/bruce.bin");
+    CHECK(b.load(r) && r == makeConfig(1));
+    CHECK(b.changes(makeConfig(1)) == 0);
+    ConfigRecords c = makeConfig(1);
+    c[7] = "z";
+    c.erase(3);
+    CHECK(b.changes(c) == 2);
+    uint64_t before = fs.bytes;
+    CHECK(b.save(makeConfig(1)));
+    CHECK(fs.bytes == before); // nothing changed, nothing written
+}
+
+static void debounceTest() {
+    ConfigDebounce d(1000, 5000);
+    CHECK(!d.pending());
+    d.touch(100);
+    CHECK(d.wait(100) == 1000);
+    CHECK(d.wait(600) == 500);
+    d.touch(900);
+    CHECK(d.wait(1000) == 900);
+    CHECK(d.wait(1900) == 0);
+    d.clear();
+    // a change every 500 ms is written after 5 s at the latest
+    uint32_t t = 10000;
+    d.touch(t);
+    for (; d.wait(t) > 0; t += 500) d.touch(t);
+    CHECK(t - 10000 <= 5000);
+    d.clear();
+    d.touch(0xFFFFFF00u); // across the wrap of millis()
+    CHECK(d.wait(0x100) == 1000 - 0x200);
+}
+
+// Bytes written for a scripted session with an SD card, the old way (pretty JSON to LittleFS, copied
+// to SD, on every saveFile) against coalesced snapshots and JSON on LittleFS, plus the SD copy that
+// saveFile() makes itself whenever a field changed
+static void bytesTest(size_t jsonSize) {
+    struct Event {
+        uint32_t at;
+        int field;
+        int value; // -1: saveFile() without a change
+    };
+    std::vector<Event> script;
+    uint32_t t = 0;
+    // brightness slider, 10 steps
+    for (int i = 0; i < 10; i++) script.push_back({t += 150, 7, 10 * i});
+    t += 3000;
+    // dimmer, sound, clock toggled in the settings menu
+    script.push_back({t += 2000, 6, 30});
+    script.push_back({t += 1500, 12, 0});
+    script.push_back({t += 1200, 11, 1});
+    // color picker scrolled through 8 colors
+    for (int i = 0; i < 8; i++) script.push_back({t += 300, 1, i});
+    t += 10000;
+    // web UI: a request every 2 s validating the same session, already the latest
+    for (int i = 0; i < 20; i++) script.push_back({t += 2000, 24, -1});
+    // wifi connect adds a network, the web UI then logs in
+    script.push_back({t += 5000, 28, 1});
+    script.push_back({t += 400, 24, 2});
+    // startup app and timezone set from the serial CLI
+    script.push_back({t += 8000, 36, 1});
+    script.push_back({t += 3000, 9, 3});
+
+    SimStorage fs;
+    ConfigStore store(fs, "/bruce.bin");
+    ConfigRecords config = makeConfig(0);
+    CHECK(store.save(config));
+    uint64_t start = fs.bytes;
+    ConfigDebounce debounce(1000, 5000);
+    size_t flushes = 0, calls = 0;
+    uint64_t exportBytes = 0;
+    ConfigRecords queued = config;
+    auto flush = [&]() {
+        debounce.clear();
+        if (store.changes(config) == 0) return;
+        exportBytes += jsonSize; // LittleFS
+        config[0] = std::to_string(flushes); // JSON stamp
+        CHECK(store.save(config));
+        flushes++;
+    };
+    size_t next = 0;
+    for (uint32_t now = 0; next < script.size() || debounce.pending(); now += 10) {
+        while (next < script.size() && script[next].at <= now) {
+            const Event &e = script[next++];
+            if (e.value >= 0) config[e.field] = std::string(1, (char)e.value) + config[e.field].substr(1);
+            if (config != queued) exportBytes += jsonSize; // SD
+            queued = config;
+            debounce.touch(now);
+            calls++;
+        }
+        if (debounce.pending() && debounce.wait(now) == 0) flush();
+    }
+    uint64_t snapshotBytes = fs.bytes - start;
+    uint64_t oldBytes = calls * 2 * jsonSize;
+    printf(
+        "scripted session: %zu saveFile calls, %zu flushes\n"
+        "  before: %llu bytes (%zu B of JSON, twice, per call)\n"
+        "  after:  %llu bytes (%llu of snapshots, %llu of JSON), %.1fx less\n",
+        calls,
+        flushes,
+        (unsigned long long)oldBytes,
+        jsonSize,
+        (unsigned long long)(snapshotBytes + exportBytes),
+        (unsigned long long)snapshotBytes,
+        (unsigned long long)exportBytes,
+        (double)oldBytes / (snapshotBytes + exportBytes)
+    );
+}
+
+int main() {
+    crashTest(false);
+    crashTest(true);
+    crashDuringRepair();
+    corruptTest();
+    debounceTest();
+    bytesTest(1630); // the size of a default bruce.conf
+    return HOST_TEST_RESULT();
+}
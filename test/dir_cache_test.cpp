@@ -0,0 +1,299 @@
+// DirCache in front of a fake SD card of 10k entries, listed the way listDirectory() does: find, else
+// read the folder and store it under the generation taken before. The fake charges card time per
+// entry read. Reports a cold listing against a warm one, and checks the sort order, that a warm
+// listing never reaches the card, the entry budget, least recent first eviction against a model,
+// that paths differing in case and slashes share one listing, which changes drop which listings, and
+// the JSON and line output in any chunk size.
+
+#include "core/dir_cache.h"
+#include "host_test.h"
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <list>
+#include <map>
+#include <random>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define CARD_US_PER_ENTRY 150.0 // f_readdir with long names plus the stat, on a 20 MHz SPI card
+
+static std::mt19937 rng(14);
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+struct FakeEntry {
+    std::string name;
+    bool dir;
+    uint64_t size;
+};
+
+class FakeFs {
+public:
+    // folders are keyed as written, FAT would match them ignoring case
+    std::vector<FakeEntry> &folder(const std::string &path) { return folders[path]; }
+
+    bool listDir(const std::string &path, DirListing &out) {
+        auto it = folders.find(path);
+        if (it == folders.end()) return false;
+        lists++;
+        for (const FakeEntry &e : it->second) out.add(e.name.c_str(), e.dir, e.size, 0x5A210000);
+        cardUs += it->second.size() * CARD_US_PER_ENTRY;
+        return true;
+    }
+
+    std::map<std::string, std::vector<FakeEntry>> folders;
+    size_t lists = 0;
+    double cardUs = 0;
+};
+
+static DirListingPtr list(DirCache &cache, FakeFs &fs, const std::string &path) {
+    DirListingPtr cached = cache.find(path);
+    if (cached) return cached;
+    uint32_t generation = cache.generation();
+    DirListing listing;
+    if (!fs.listDir(path, listing)) return nullptr;
+    return cache.store(path, std::move(listing), generation);
+}
+
+static std::string randomName() {
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 _-";
+    std::string name;
+    for (int n = 3 + rng() % 30; n > 0; n--) name += chars[rng() % (sizeof(chars) - 1)];
+    if (rng() % 2) name += rng() % 2 ? ".ir" : ".SUB";
+    return name;
+}
+
+static void fillFolder(FakeFs &fs, const std::string &path, size_t entries) {
+    std::vector<FakeEntry> &f = fs.folder(path);
+    f.clear();
+    for (size_t i = 0; i < entries; i++)
+        f.push_back({randomName() + std::to_string(i), rng() % 10 == 0, rng()});
+}
+
+static std::string upper(const std::string &s) {
+    std::string out = s;
+    for (char &c : out) c = toupper((unsigned char)c);
+    return out;
+}
+
+static bool sortedLikeBrowser(const DirListing &l) {
+    for (size_t i = 1; i < l.size(); i++) {
+        if (l[i - 1].dir != l[i].dir) {
+            if (!l[i - 1].dir) return false;
+            continue;
+        }
+        if (upper(l.name(i - 1)) > upper(l.name(i))) return false;
+    }
+    return true;
+}
+
+static void testColdWarm() {
+    FakeFs fs;
+    fillFolder(fs, "/BruceRF", 10000);
+    DirCache cache;
+    cache.setBudget(DIR_CACHE_PSRAM_BUDGET);
+
+    auto t0 = std::chrono::steady_clock::now();
+    DirListingPtr cold = list(cache, fs, "/BruceRF");
+    double coldHostUs = nsSince(t0) / 1000;
+    CHECK(cold != nullptr);
+    CHECK_EQ(cold->size(), 10000);
+    CHECK(sortedLikeBrowser(*cold));
+    size_t dirs = 0;
+    for (const FakeEntry &e : fs.folder("/BruceRF")) dirs += e.dir;
+    for (size_t i = 0; i < dirs; i++) CHECK_EQ((*cold)[i].size, 0);
+
+    double cardUs = fs.cardUs;
+    const int rounds = 1000;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) CHECK(list(cache, fs, "/BruceRF") == cold);
+    double warmUs = nsSince(t0) / 1000 / rounds;
+    printf(
+        "10000 entries: cold %.0f ms of card time + %.0f us on the host, warm %.2f us, %zu card listings\n",
+        cardUs / 1000, coldHostUs, warmUs, fs.lists
+    );
+    CHECK_EQ(fs.lists, 1);
+    CHECK_EQ(cache.hits(), rounds);
+    CHECK_EQ(cache.misses(), 1);
+
+    // over the heap budget: listed every time, never kept
+    DirCache small;
+    DirListingPtr listed = list(small, fs, "/BruceRF");
+    CHECK_EQ(listed->size(), 10000);
+    CHECK(list(small, fs, "/BruceRF") != listed);
+    CHECK_EQ(fs.lists, 3);
+    CHECK_EQ(small.hits(), 0);
+}
+
+// The cache against a model of least recent first over DIR_CACHE_MAX_DIRS slots and the entry budget
+static void testEviction() {
+    FakeFs fs;
+    std::vector<std::string> paths;
+    std::map<std::string, size_t> sizes;
+    for (int i = 0; i < 40; i++) {
+        std::string path = "/d" + std::to_string(i);
+        size_t n = i % 5 == 0 ? 3000 + rng() % 4000 : 1 + rng() % 200;
+        fillFolder(fs, path, n);
+        paths.push_back(path);
+        sizes[path] = n;
+    }
+    DirCache cache;
+    const size_t budget = 10000;
+    cache.setBudget(budget);
+    std::list<std::string> model; // most recent first
+    int wrong = 0;
+    for (int step = 0; step < 5000; step++) {
+        const std::string &path = paths[rng() % 12 ? rng() % 10 : rng() % paths.size()];
+        bool modelHit = std::find(model.begin(), model.end(), path) != model.end();
+        size_t before = fs.lists;
+        DirListingPtr l = list(cache, fs, path);
+        bool hit = fs.lists == before;
+        if (hit != modelHit || l->size() != sizes[path]) wrong++;
+
+        model.remove(path);
+        if (sizes[path] > budget) continue;
+        size_t total = 0;
+        for (const std::string &p : model) total += sizes[p];
+        while (!model.empty() && (model.size() >= DIR_CACHE_MAX_DIRS || total + sizes[path] > budget)) {
+            total -= sizes[model.back()];
+            model.pop_back();
+        }
+        model.push_front(path);
+    }
+    CHECK_EQ(wrong, 0);
+    printf("eviction: %u hits, %u misses over 40 folders\n", cache.hits(), cache.misses());
+
+    // a smaller budget drops the least recent until the rest fits
+    size_t keep = 0;
+    auto it = model.begin();
+    for (; it != model.end() && keep + sizes[*it] <= 2000; ++it) keep += sizes[*it];
+    cache.setBudget(2000);
+    size_t before = fs.lists;
+    for (auto kept = model.begin(); kept != it; ++kept) list(cache, fs, *kept);
+    CHECK_EQ(fs.lists, before);
+}
+
+// key() folds case and slashes: every spelling of a folder finds one listing
+static void testKeys() {
+    FakeFs fs;
+    fillFolder(fs, "/Music", 50);
+    fillFolder(fs, "/", 20);
+    DirCache cache;
+    DirListingPtr music = list(cache, fs, "/Music");
+    for (const char *same : {"/Music", "/music", "/MUSIC/", "//Music//", "Music", "/mUsIc/"})
+        CHECK(cache.find(same) == music);
+    CHECK(cache.find("/Musi") == nullptr);
+    CHECK(cache.find("/Music/x") == nullptr);
+    DirListingPtr root = list(cache, fs, "/");
+    CHECK(cache.find("") == root);
+    CHECK(cache.find("//") == root);
+
+    // a store under another spelling replaces the listing instead of adding a second one
+    DirListing again;
+    fs.listDir("/Music", again);
+    DirListingPtr replaced = cache.store("/MUSIC/", std::move(again), cache.generation());
+    CHECK(cache.find("/music") == replaced);
+    CHECK(replaced != music);
+}
+
+static void testChanged() {
+    FakeFs fs;
+    const char *folders[] = {"/", "/Music", "/Music/Rock", "/Music/Rock/Old", "/MusicBox", "/ir"};
+    for (const char *f : folders) fillFolder(fs, f, 10);
+    DirCache cache;
+    auto fill = [&]() {
+        for (const char *f : folders) list(cache, fs, f);
+    };
+    auto cached = [&](const char *path) { return cache.find(path) != nullptr; };
+
+    // a file written: only its folder, whatever the case
+    fill();
+    cache.changed("/MUSIC/rock/song.mp3");
+    CHECK(!cached("/Music/Rock"));
+    CHECK(cached("/Music"));
+    CHECK(cached("/Music/Rock/Old"));
+    CHECK(cached("/"));
+
+    // a folder renamed or removed: its parent, itself and everything below, not its namesakes
+    fill();
+    cache.changed("/music/");
+    CHECK(!cached("/"));
+    CHECK(!cached("/Music"));
+    CHECK(!cached("/Music/Rock"));
+    CHECK(!cached("/Music/Rock/Old"));
+    CHECK(cached("/MusicBox"));
+    CHECK(cached("/ir"));
+
+    // the root: everything
+    fill();
+    cache.changed("/");
+    for (const char *f : folders) CHECK(!cached(f));
+
+    // a listing read while a write landed is handed out but not kept
+    uint32_t generation = cache.generation();
+    DirListing listing;
+    fs.listDir("/ir", listing);
+    cache.changed("/ir/new.ir");
+    DirListingPtr stale = cache.store("/ir", std::move(listing), generation);
+    CHECK_EQ(stale->size(), 10);
+    CHECK(!cached("/ir"));
+
+    fill();
+    cache.clear();
+    for (const char *f : folders) CHECK(!cached(f));
+    CHECK(cache.generation() != generation);
+}
+
+static std::string drain(DirListingPtr listing, const std::string &path, bool json, bool randomChunks) {
+    DirListingWriter writer(listing, path, json);
+    std::string out;
+    std::vector<uint8_t> buf(4096);
+    while (true) {
+        size_t n = writer.read(buf.data(), randomChunks ? 1 + rng() % buf.size() : buf.size());
+        if (!n) break;
+        out.append((const char *)buf.data(), n);
+    }
+    return out;
+}
+
+static void testWriter() {
+    FakeFs fs;
+    std::vector<FakeEntry> &f = fs.folder("/x");
+    f.push_back({"b\"q\\uote", false, 1023});
+    f.push_back({"Tab\there", false, 1536});
+    f.push_back({"Sub", true, 99});
+    f.push_back({"big", false, 5ull << 30});
+    DirCache cache;
+    DirListingPtr l = list(cache, fs, "/x");
+    CHECK(
+        drain(l, "/x", true, false) ==
+        "{\"path\":\"/x\",\"entries\":[[\"Fo\",\"Sub\",0],[\"Fi\",\"b\\\"q\\\\uote\",1023],"
+        "[\"Fi\",\"big\",5368709120],[\"Fi\",\"Tab\\u0009here\",1536]]}"
+    );
+    CHECK(
+        drain(l, "/x", false, false) ==
+        "pa:/x:0\nFo:Sub:0\nFi:b\"q\\uote:1023 B\nFi:big:5.00 GB\nFi:Tab\there:1.50 kB\n"
+    );
+    CHECK(drain(nullptr, "/none", true, false) == "{\"path\":\"/none\",\"entries\":[]}");
+
+    fillFolder(fs, "/big", 10000);
+    DirListingPtr big = list(cache, fs, "/big");
+    for (bool json : {true, false}) {
+        std::string whole = drain(big, "/big", json, false);
+        CHECK(whole == drain(big, "/big", json, true));
+        CHECK(whole.size() > 10000 * 10);
+    }
+}
+
+int main() {
+    testColdWarm();
+    testEviction();
+    testKeys();
+    testChanged();
+    testWriter();
+    return HOST_TEST_RESULT();
+}
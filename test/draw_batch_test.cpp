@@ -0,0 +1,305 @@
+// runDrawBatch against a framebuffer: the frames of dino_game.js and space_shooter.js recorded in a batch
+// must come out pixel for pixel as drawn call by call, the dirty rect must cover every pixel a batch
+// changed, clip or not, and bad commands stop the batch. Also reports the time per frame both ways.
+
+#include "host_test.h"
+#include "modules/bjs_interpreter/draw_batch.h"
+#include <algorithm>
+#include <chrono>
+#include <initializer_list>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static const int W = 240, H = 135;
+
+// RGB565 framebuffer with the subset of the display methods the batch uses
+struct Framebuffer {
+    std::vector<uint16_t> px = std::vector<uint16_t>(W * H);
+    uint16_t fg = 0xffff;
+    int size = 1, datum = 0;
+
+    void put(int x, int y, uint32_t c) {
+        if (x >= 0 && y >= 0 && x < W && y < H) px[y * W + x] = c;
+    }
+    void fillScreen(uint32_t c) { std::fill(px.begin(), px.end(), c); }
+    void fillRect(int x, int y, int w, int h, uint32_t c) {
+        for (int j = y; j < y + h; j++)
+            for (int i = x; i < x + w; i++) put(i, j, c);
+    }
+    void drawPixel(int x, int y, uint32_t c) { put(x, y, c); }
+    void drawFastVLine(int x, int y, int h, uint32_t c) { fillRect(x, y, 1, h, c); }
+    void drawLine(int x0, int y0, int x1, int y1, uint32_t c) {
+        int n = std::max(abs(x1 - x0), abs(y1 - y0));
+        for (int k = 0; k <= n; k++)
+            put(x0 + (n ? (x1 - x0) * k / n : 0), y0 + (n ? (y1 - y0) * k / n : 0), c);
+    }
+    void drawRect(int x, int y, int w, int h, uint32_t c) {
+        fillRect(x, y, w, 1, c);
+        fillRect(x, y + h - 1, w, 1, c);
+        fillRect(x, y, 1, h, c);
+        fillRect(x + w - 1, y, 1, h, c);
+    }
+    void drawRoundRect(int x, int y, int w, int h, int, uint32_t c) { drawRect(x, y, w, h, c); }
+    void fillRoundRect(int x, int y, int w, int h, int, uint32_t c) { fillRect(x, y, w, h, c); }
+    void drawCircle(int x, int y, int r, uint32_t c) {
+        for (int a = 0; a < 64; a++) put(x + lround(r * cos(a / 10.0)), y + lround(r * sin(a / 10.0)), c);
+    }
+    void fillCircle(int x, int y, int r, uint32_t c) {
+        for (int j = -r; j <= r; j++)
+            for (int i = -r; i <= r; i++)
+                if (i * i + j * j <= r * r) put(x + i, y + j, c);
+    }
+    void fillTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t c) {
+        drawLine(x0, y0, x1, y1, c);
+        drawLine(x1, y1, x2, y2, c);
+        drawLine(x2, y2, x0, y0, c);
+    }
+    void drawXBitmap(int x, int y, uint8_t *b, int w, int h, uint32_t c) {
+        int bw = (w + 7) / 8;
+        for (int j = 0; j < h; j++)
+            for (int i = 0; i < w; i++)
+                if (b[j * bw + i / 8] & (1 << (i & 7))) put(x + i, y + j, c);
+    }
+    void drawXBitmap(int x, int y, uint8_t *b, int w, int h, uint32_t c, uint32_t bg) {
+        int bw = (w + 7) / 8;
+        for (int j = 0; j < h; j++)
+            for (int i = 0; i < w; i++) put(x + i, y + j, (b[j * bw + i / 8] & (1 << (i & 7))) ? c : bg);
+    }
+    void setTextColor(uint32_t c) { fg = c; }
+    void setTextColor(uint32_t c, uint32_t) { fg = c; }
+    void setTextSize(int s) { size = s; }
+    void setTextDatum(int d) { datum = d; }
+    // A block per string, laid out like the built-in font
+    void drawString(const char *s, int x, int y) {
+        int w = strlen(s) * 6 * size, h = 8 * size, bl = datum / 3 > 2 ? 2 : datum / 3;
+        fillRect(x - w * (datum % 3) / 2, y - h * bl / 2, w, h, fg);
+    }
+};
+
+static std::vector<uint8_t> cloud((46 + 7) / 8 * 13, 0x5a), ground((623 + 7) / 8 * 12, 0x33),
+    dino((44 + 7) / 8 * 47, 0xf0), cactus((25 + 7) / 8 * 50, 0x0f);
+static const char *strings[] = {"00123", "Score: 120", "Lives: 3", "Paused"};
+enum { STRING_BASE = 4, RESOURCE_COUNT = STRING_BASE + 4 };
+
+static bool resource(int32_t i, DrawBatchResource &out) {
+    std::vector<uint8_t> *bitmaps[] = {&cloud, &ground, &dino, &cactus};
+    if (i >= 0 && i < STRING_BASE) {
+        out = {bitmaps[i]->data(), bitmaps[i]->size()};
+        return true;
+    }
+    if (i >= STRING_BASE && i < RESOURCE_COUNT) {
+        const char *s = strings[i - STRING_BASE];
+        out = {(const uint8_t *)s, strlen(s)};
+        return true;
+    }
+    return false;
+}
+
+class Recorder {
+public:
+    void op(std::initializer_list<int32_t> v) { cmds.insert(cmds.end(), v); }
+    DrawBatchResult run(Framebuffer &fb) {
+        return runDrawBatch(fb, W, H, cmds.data(), cmds.size(), resource);
+    }
+    std::vector<int32_t> cmds;
+};
+
+// dino_game.js: background, 3 clouds, 2 ground strips, dino, 2 cactus, score
+static void dinoDirect(Framebuffer &t, int f) {
+    t.fillScreen(0xffff);
+    for (int i = 0; i < 3; i++) t.drawXBitmap((i * 90 - f) % 260, 20 + i * 10, cloud.data(), 46, 13, 0x8410);
+    int gx = -(f * 4 % 623);
+    t.drawXBitmap(gx, 118, ground.data(), 623, 12, 0);
+    t.drawXBitmap(623 + gx, 118, ground.data(), 623, 12, 0);
+    t.drawXBitmap(20, 80, dino.data(), 44, 47, 0);
+    t.drawXBitmap(240 - (f * 4 % 300), 80, cactus.data(), 25, 50, 0);
+    t.drawXBitmap(380 - (f * 4 % 300), 80, cactus.data(), 25, 50, 0);
+    t.setTextColor(0);
+    t.setTextSize(2);
+    t.setTextDatum(2);
+    t.drawString(strings[0], 235, 5);
+}
+
+static void dinoRecord(Recorder &r, int f) {
+    r.op({DRAW_BATCH_FILL, 0xffff});
+    for (int i = 0; i < 3; i++)
+        r.op({DRAW_BATCH_XBITMAP, (i * 90 - f) % 260, 20 + i * 10, 46, 13, 0x8410, -1, 0});
+    int gx = -(f * 4 % 623);
+    r.op({DRAW_BATCH_XBITMAP, gx, 118, 623, 12, 0, -1, 1});
+    r.op({DRAW_BATCH_XBITMAP, 623 + gx, 118, 623, 12, 0, -1, 1});
+    r.op({DRAW_BATCH_XBITMAP, 20, 80, 44, 47, 0, -1, 2});
+    r.op({DRAW_BATCH_XBITMAP, 240 - (f * 4 % 300), 80, 25, 50, 0, -1, 3});
+    r.op({DRAW_BATCH_XBITMAP, 380 - (f * 4 % 300), 80, 25, 50, 0, -1, 3});
+    r.op({DRAW_BATCH_TEXT_COLOR, 0, -1});
+    r.op({DRAW_BATCH_TEXT_SIZE, 2});
+    r.op({DRAW_BATCH_TEXT_ALIGN, 2, 0});
+    r.op({DRAW_BATCH_TEXT, 235, 5, STRING_BASE});
+}
+
+// space_shooter.js: background, 40 stars, player, 12 enemies, 20 bullets, 2 texts
+static void shooterDirect(Framebuffer &t, int f) {
+    t.fillScreen(0);
+    for (int i = 0; i < 40; i++) t.fillRect((i * 37) % 240, (i * 53 + f) % 135, 1, 1, 0xffff);
+    t.fillRect(110, 110, 20, 10, 0x07e0);
+    for (int i = 0; i < 12; i++) t.fillRect(10 + (i % 6) * 38, 10 + (i / 6) * 20 + f % 20, 16, 10, 0xf800);
+    for (int i = 0; i < 20; i++) t.fillRect((i * 29) % 240, (i * 41 - f * 3) % 180 - 20, 2, 5, 0xffe0);
+    t.setTextSize(1);
+    t.drawString(strings[1], 5, 125);
+    t.drawString(strings[2], 180, 125);
+}
+
+static void shooterRecord(Recorder &r, int f) {
+    r.op({DRAW_BATCH_FILL, 0});
+    for (int i = 0; i < 40; i++)
+        r.op({DRAW_BATCH_FILL_RECT, (i * 37) % 240, (i * 53 + f) % 135, 1, 1, 0xffff});
+    r.op({DRAW_BATCH_FILL_RECT, 110, 110, 20, 10, 0x07e0});
+    for (int i = 0; i < 12; i++)
+        r.op({DRAW_BATCH_FILL_RECT, 10 + (i % 6) * 38, 10 + (i / 6) * 20 + f % 20, 16, 10, 0xf800});
+    for (int i = 0; i < 20; i++)
+        r.op({DRAW_BATCH_FILL_RECT, (i * 29) % 240, (i * 41 - f * 3) % 180 - 20, 2, 5, 0xffe0});
+    r.op({DRAW_BATCH_TEXT_SIZE, 1});
+    r.op({DRAW_BATCH_TEXT, 5, 125, STRING_BASE + 1});
+    r.op({DRAW_BATCH_TEXT, 180, 125, STRING_BASE + 2});
+}
+
+struct Game {
+    const char *name;
+    void (*direct)(Framebuffer &, int);
+    void (*record)(Recorder &, int);
+};
+
+static void testFrames(const Game &g) {
+    int mismatches = 0;
+    for (int f = 0; f < 200; f++) {
+        Framebuffer direct, batch;
+        g.direct(direct, f);
+        Recorder r;
+        g.record(r, f);
+        DrawBatchResult res = r.run(batch);
+        CHECK(res.error == nullptr);
+        if (direct.px != batch.px) mismatches++;
+    }
+    CHECK_EQ(mismatches, 0);
+
+    const int frames = 2000;
+    Framebuffer fb;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) g.direct(fb, f);
+    auto t1 = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        Recorder r;
+        g.record(r, f);
+        r.run(fb);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    printf(
+        "%-14s direct %.1f us/frame, recorded and batched %.1f us/frame\n", g.name,
+        std::chrono::duration<double, std::micro>(t1 - t0).count() / frames,
+        std::chrono::duration<double, std::micro>(t2 - t1).count() / frames
+    );
+}
+
+// Every pixel the batch changed lies in the dirty rect
+static void checkDirty(Recorder &r, const char *what) {
+    Framebuffer before, after;
+    DrawBatchResult res = r.run(after);
+    CHECK(res.error == nullptr);
+    int outside = 0;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            bool in = x >= res.dirty.x && y >= res.dirty.y && x < res.dirty.x + res.dirty.w &&
+                      y < res.dirty.y + res.dirty.h;
+            if (before.px[y * W + x] != after.px[y * W + x] && !in) outside++;
+        }
+    }
+    if (outside) printf("%s: %d changed pixels outside the dirty rect\n", what, outside);
+    CHECK_EQ(outside, 0);
+}
+
+static void testClip() {
+    // Fills are cut to the clip, nothing outside it changes
+    Recorder fills;
+    fills.op({DRAW_BATCH_CLIP, 10, 10, 50, 50});
+    fills.op({DRAW_BATCH_FILL, 0x1234});
+    fills.op({DRAW_BATCH_FILL_RECT, 100, 100, 10, 10, 1});
+    fills.op({DRAW_BATCH_HLINE, 0, 20, 240, 2});
+    fills.op({DRAW_BATCH_CLIP, 0, 0, 0, 0});
+    fills.op({DRAW_BATCH_PIXEL, 200, 5, 3});
+    Framebuffer fb;
+    DrawBatchResult res = fills.run(fb);
+    CHECK_EQ(res.drawn, 3);
+    CHECK_EQ(res.culled, 1);
+    CHECK_EQ(fb.px[0], 0);
+    CHECK_EQ(fb.px[10 * W + 10], 0x1234);
+    CHECK_EQ(fb.px[20 * W + 9], 0);
+    CHECK_EQ(fb.px[20 * W + 59], 2);
+    CHECK_EQ(res.dirty.x, 10);
+    CHECK_EQ(res.dirty.y, 5);
+    CHECK_EQ(res.dirty.w, 191);
+    CHECK_EQ(res.dirty.h, 55);
+    checkDirty(fills, "fills");
+
+    // Shapes partly inside the clip are drawn whole, the dirty rect has to cover all of them
+    Recorder shapes;
+    shapes.op({DRAW_BATCH_CLIP, 50, 40, 40, 30});
+    shapes.op({DRAW_BATCH_LINE, 10, 10, 60, 50, 1});
+    shapes.op({DRAW_BATCH_RECT, 80, 60, 50, 40, 2});
+    shapes.op({DRAW_BATCH_CIRCLE, 50, 40, 20, 3});
+    shapes.op({DRAW_BATCH_FILL_CIRCLE, 95, 75, 15, 4});
+    shapes.op({DRAW_BATCH_FILL_TRIANGLE, 30, 60, 70, 50, 60, 110, 5});
+    shapes.op({DRAW_BATCH_XBITMAP, 85, 35, 46, 13, 6, 7, 0});
+    shapes.op({DRAW_BATCH_TEXT_COLOR, 8, -1});
+    shapes.op({DRAW_BATCH_TEXT_SIZE, 2});
+    shapes.op({DRAW_BATCH_TEXT, 40, 65, STRING_BASE + 3});
+    res = shapes.run(fb);
+    CHECK_EQ(res.drawn, 7);
+    CHECK_EQ(res.culled, 0);
+    checkDirty(shapes, "shapes");
+
+    // Entirely outside the clip: skipped
+    Recorder outside;
+    outside.op({DRAW_BATCH_CLIP, 0, 0, 20, 20});
+    outside.op({DRAW_BATCH_CIRCLE, 100, 100, 10, 1});
+    outside.op({DRAW_BATCH_TEXT, 100, 100, STRING_BASE});
+    res = outside.run(fb);
+    CHECK_EQ(res.drawn, 0);
+    CHECK_EQ(res.culled, 2);
+    CHECK(res.dirty.empty());
+}
+
+static void testErrors() {
+    Framebuffer fb;
+    Recorder unknown;
+    unknown.op({DRAW_BATCH_FILL, 1, 99});
+    DrawBatchResult res = unknown.run(fb);
+    CHECK_EQ(res.errorAt, 2);
+    CHECK(res.error && strcmp(res.error, "unknown command") == 0);
+    CHECK_EQ(res.drawn, 1);
+
+    Recorder truncated;
+    truncated.op({DRAW_BATCH_RECT, 1, 2});
+    res = truncated.run(fb);
+    CHECK_EQ(res.errorAt, 0);
+    CHECK(res.error && strcmp(res.error, "truncated command") == 0);
+
+    Recorder bitmap;
+    bitmap.op({DRAW_BATCH_XBITMAP, 0, 0, 50, 13, 1, -1, 0});
+    res = bitmap.run(fb);
+    CHECK(res.error && strcmp(res.error, "bitmap size mismatch") == 0);
+
+    Recorder text;
+    text.op({DRAW_BATCH_TEXT, 0, 0, RESOURCE_COUNT});
+    res = text.run(fb);
+    CHECK(res.error && strcmp(res.error, "text is not a string") == 0);
+}
+
+int main() {
+    testFrames({"dino_game", dinoDirect, dinoRecord});
+    testFrames({"space_shooter", shooterDirect, shooterRecord});
+    testClip();
+    testErrors();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,192 @@
+// EspTransferSender and EspTransferReceiver over simulated ESP-NOW: packets take their airtime at
+// 1 Mbps, are lost at random, arrive after a latency and a full send queue refuses them; arriving
+// packets go through the EspTransferRing as from the Wi-Fi task. A file has to arrive intact at every
+// loss rate, also when the receiver's filesystem is slow to write. Also covers an empty file, whole
+// chunks, abort, reject and the window sizes, and reports the throughput.
+
+#include "core/connect/esp_transfer.h"
+#include "host_test.h"
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string.h>
+#include <vector>
+
+static double nowMs = 0;
+static std::mt19937 rng(5);
+static double writeMsPerByte = 0; // the receiver's filesystem
+static double receiverBusyUntil = 0;
+static long ringDrops = 0;
+
+struct Air {
+    double busyUntil = 0;
+    double loss;
+    double latency;
+    int queueLimit = 8; // packets esp_now_send() takes before it fails
+};
+
+struct Direction {
+    std::deque<std::pair<double, std::vector<uint8_t>>> packets; // arrival time, packet
+    EspTransferRing &ring;
+    uint8_t mac[6];
+};
+
+class AirLink : public EspTransferLink {
+public:
+    AirLink(Air &air, Direction &out, EspTransferRing &in) : _air(air), _out(out), _in(in) {}
+
+    bool send(const uint8_t *data, size_t len) override {
+        int queued = std::count_if(_out.packets.begin(), _out.packets.end(), [](const auto &p) {
+            return p.first > nowMs;
+        });
+        if (queued >= _air.queueLimit) return false;
+        double t = std::max(nowMs, _air.busyUntil) + 0.4 + len * 0.008;
+        _air.busyUntil = t;
+        if (std::uniform_real_distribution<>(0, 1)(rng) < _air.loss) return true;
+        _out.packets.push_back({t + _air.latency, std::vector<uint8_t>(data, data + len)});
+        return true;
+    }
+    size_t receive(uint8_t *buf) override {
+        uint8_t mac[6];
+        return _in.pop(mac, buf);
+    }
+    uint32_t millis() override { return (uint32_t)nowMs; }
+
+private:
+    Air &_air;
+    Direction &_out;
+    EspTransferRing &_in;
+};
+
+// What the Wi-Fi task does with the packets that arrived by now
+static void deliver(Direction &d) {
+    while (!d.packets.empty() && d.packets.front().first <= nowMs) {
+        const std::vector<uint8_t> &packet = d.packets.front().second;
+        if (!d.ring.push(d.mac, packet.data(), packet.size())) ringDrops++;
+        d.packets.pop_front();
+    }
+}
+
+class VectorSource : public TransferSource {
+public:
+    explicit VectorSource(const std::vector<uint8_t> &data) : _data(data) {}
+    size_t readAt(uint32_t offset, uint8_t *buf, size_t len) override {
+        if (offset + len > _data.size()) return 0;
+        memcpy(buf, _data.data() + offset, len);
+        return len;
+    }
+
+private:
+    const std::vector<uint8_t> &_data;
+};
+
+class VectorSink : public TransferSink {
+public:
+    bool append(const uint8_t *p, size_t len) override {
+        data.insert(data.end(), p, p + len);
+        receiverBusyUntil = std::max(nowMs, receiverBusyUntil) + len * writeMsPerByte;
+        return true;
+    }
+    std::vector<uint8_t> data;
+};
+
+struct Outcome {
+    EspTransferState sender, receiver;
+    double ms;
+    EspTransferStats stats;
+    bool intact;
+
+    bool ok() const {
+        return sender == ESP_TRANSFER_SUCCEEDED && receiver == ESP_TRANSFER_SUCCEEDED && intact;
+    }
+};
+
+static bool finished(EspTransferState state) {
+    return state == ESP_TRANSFER_SUCCEEDED || state == ESP_TRANSFER_FAILED;
+}
+
+// abortAfter > 0 aborts the sender at that poll
+static Outcome transfer(
+    const std::vector<uint8_t> &file, double loss, double latency, EspTransferConfig config = {},
+    int abortAfter = 0, bool reject = false
+) {
+    Air air;
+    air.loss = loss;
+    air.latency = latency;
+    // a few KB each, not on the stack
+    auto toReceiver = std::make_unique<EspTransferRing>(), toSender = std::make_unique<EspTransferRing>();
+    Direction forward{{}, *toReceiver, {1}}, back{{}, *toSender, {2}};
+    AirLink senderLink(air, forward, *toSender), receiverLink(air, back, *toReceiver);
+    VectorSource source(file);
+    VectorSink sink;
+    EspTransferSender sender(senderLink, source, file.size(), "a.bin", "/x", 42, config);
+    EspTransferReceiver receiver(receiverLink, config);
+
+    double start = nowMs;
+    receiverBusyUntil = 0;
+    ringDrops = 0;
+    for (int polls = 1; nowMs - start < 600000; polls++) {
+        deliver(forward);
+        deliver(back);
+        sender.poll();
+        // the receiver does not poll while it writes
+        if (nowMs >= receiverBusyUntil && receiver.poll() == ESP_TRANSFER_OFFERED) {
+            if (reject) receiver.reject();
+            else receiver.accept(sink);
+        }
+        if (polls == abortAfter) sender.abort();
+        if (finished(sender.state()) && finished(receiver.state())) break;
+        nowMs += 0.05;
+    }
+    return {sender.state(), receiver.state(), nowMs - start, sender.stats(), sink.data == file};
+}
+
+static void testLoss(const std::vector<uint8_t> &file) {
+    for (double writeMs : {0.0, 0.004, 0.02}) {
+        writeMsPerByte = writeMs;
+        for (double latency : {1.0, 10.0}) {
+            for (double loss : {0.0, 0.01, 0.05, 0.2}) {
+                Outcome res = transfer(file, loss, latency);
+                printf(
+                    "write %2.0f ms/KB, latency %2.0f ms, loss %2.0f%%: %s, %5.1f KB/s, %u sent, %u resent "
+                    "(%u on the timer), %ld ring drops\n",
+                    writeMs * 1000, latency, loss * 100, res.ok() ? "ok" : "FAILED", file.size() / res.ms,
+                    res.stats.packetsSent, res.stats.resent, res.stats.timeouts, ringDrops
+                );
+                CHECK(res.ok());
+            }
+        }
+    }
+    writeMsPerByte = 0;
+}
+
+static void testEdges(const std::vector<uint8_t> &file) {
+    CHECK(transfer({}, 0.1, 1).ok());
+    CHECK(transfer(std::vector<uint8_t>(5 * ESP_TRANSFER_CHUNK), 0, 1).ok());
+
+    Outcome aborted = transfer(file, 0, 1, {}, 2000);
+    CHECK_EQ(aborted.sender, ESP_TRANSFER_FAILED);
+    CHECK_EQ(aborted.receiver, ESP_TRANSFER_FAILED);
+
+    Outcome rejected = transfer(file, 0, 1, {}, 0, true);
+    CHECK_EQ(rejected.sender, ESP_TRANSFER_FAILED);
+
+    for (uint8_t window : {1, 32}) {
+        EspTransferConfig config;
+        config.window = window;
+        Outcome res = transfer(file, 0.05, 1, config);
+        printf(
+            "window %2u, loss 5%%: %s, %5.1f KB/s\n", window, res.ok() ? "ok" : "FAILED", file.size() / res.ms
+        );
+        CHECK(res.ok());
+    }
+}
+
+int main() {
+    std::vector<uint8_t> file(200000);
+    for (auto &b : file) b = rng();
+    testLoss(file);
+    testEdges(file);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,198 @@
+// TransferSender and TransferReceiver talking over a simulated serial line: every byte takes its time
+// on the wire and may get a bit flipped. A 1 MiB file has to arrive intact at every error rate, also
+// when reads return a few bytes at a time as over BLE, after an interruption and a resume, and a
+// damaged resume prefix has to be caught by the end CRC. Reports the throughput against the line rate.
+// Also checks the CRC-32 the frames and the file are checked with.
+
+#include "core/crc32.h"
+#include "core/serial_commands/file_transfer.h"
+#include "host_test.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static double nowMs = 0;
+static std::mt19937 rng(7);
+
+struct Wire {
+    std::deque<std::pair<double, uint8_t>> bytes; // arrival time, byte
+    double busyUntil = 0;
+    double byteMs;
+    double errorRate;
+    bool cut = false;
+};
+
+class WireLink : public TransferLink {
+public:
+    WireLink(Wire &in, Wire &out, size_t maxRead) : _in(in), _out(out), _maxRead(maxRead) {}
+
+    size_t read(uint8_t *buf, size_t len) override {
+        size_t n = 0;
+        len = std::min(len, _maxRead);
+        while (n < len && !_in.bytes.empty() && _in.bytes.front().first <= nowMs) {
+            buf[n++] = _in.bytes.front().second;
+            _in.bytes.pop_front();
+        }
+        return n;
+    }
+    void write(const uint8_t *buf, size_t len) override {
+        if (_out.cut) return;
+        double t = std::max(nowMs, _out.busyUntil);
+        for (size_t i = 0; i < len; i++) {
+            t += _out.byteMs;
+            uint8_t b = buf[i];
+            if (_out.errorRate > 0 && std::uniform_real_distribution<>(0, 1)(rng) < _out.errorRate)
+                b ^= 1 << (rng() % 8);
+            _out.bytes.push_back({t, b});
+        }
+        _out.busyUntil = t;
+    }
+    uint32_t millis() override { return (uint32_t)nowMs; }
+
+private:
+    Wire &_in, &_out;
+    size_t _maxRead;
+};
+
+class VectorSource : public TransferSource {
+public:
+    explicit VectorSource(const std::vector<uint8_t> &data) : _data(data) {}
+    size_t readAt(uint32_t offset, uint8_t *buf, size_t len) override {
+        if (offset + len > _data.size()) return 0;
+        memcpy(buf, _data.data() + offset, len);
+        return len;
+    }
+
+private:
+    const std::vector<uint8_t> &_data;
+};
+
+class VectorSink : public TransferSink {
+public:
+    bool append(const uint8_t *p, size_t len) override {
+        data.insert(data.end(), p, p + len);
+        return true;
+    }
+    std::vector<uint8_t> data;
+};
+
+struct Line {
+    double baud;
+    double errorRate;
+    size_t maxRead; // bytes a read() returns at most
+};
+
+struct Outcome {
+    bool ok;
+    double ms;
+    TransferStats sender;
+};
+
+// Sends file into sink, resuming from what the sink already holds. cutAtMs >= 0 drops the line then.
+static Outcome transfer(const std::vector<uint8_t> &file, VectorSink &sink, Line line, double cutAtMs = -1) {
+    Wire toReceiver{{}, 0, 10000.0 / line.baud, line.errorRate};
+    Wire toSender{{}, 0, 10000.0 / line.baud, line.errorRate};
+    WireLink senderLink(toSender, toReceiver, line.maxRead), receiverLink(toReceiver, toSender, line.maxRead);
+    VectorSource source(file);
+    TransferConfig config;
+    // longer than a window in flight
+    config.retryMs = std::max(200.0, 2.5 * config.window * (TRANSFER_MAX_PAYLOAD + 13) * 10000.0 / line.baud);
+    TransferSender sender(senderLink, source, file.size(), config);
+    uint32_t prefixCrc = crc32Update(0, sink.data.data(), sink.data.size());
+    TransferReceiver receiver(receiverLink, sink, sink.data.size(), prefixCrc, config);
+
+    double start = nowMs;
+    while (true) {
+        if (cutAtMs >= 0 && nowMs - start > cutAtMs) toReceiver.cut = toSender.cut = true;
+        TransferState a = sender.poll(), b = receiver.poll();
+        if (a != TRANSFER_RUNNING && b != TRANSFER_RUNNING) break;
+        nowMs += 0.05;
+    }
+    bool ok = sender.state() == TRANSFER_SUCCEEDED && receiver.state() == TRANSFER_SUCCEEDED;
+    return {ok, nowMs - start, sender.stats()};
+}
+
+static void testErrorRates(const std::vector<uint8_t> &file) {
+    const Line lines[] = {
+        {115200, 0, SIZE_MAX},
+        {115200, 1e-5, SIZE_MAX},
+        {115200, 1e-4, SIZE_MAX},
+        {115200, 1e-3, SIZE_MAX},
+        {921600, 0, SIZE_MAX},
+        {921600, 1e-5, SIZE_MAX},
+        {921600, 1e-4, SIZE_MAX},
+        {921600, 1e-3, SIZE_MAX},
+        {115200, 0, 20},
+        {115200, 1e-4, 20},
+    };
+    for (const Line &line : lines) {
+        VectorSink sink;
+        Outcome res = transfer(file, sink, line);
+        bool ok = res.ok && sink.data == file;
+        double kibs = file.size() / 1024.0 / (res.ms / 1000);
+        printf(
+            "%6.0f baud, byte error %.0e, %s reads: %s, %6.1f KiB/s (%3.0f%% of line), %u resent\n",
+            line.baud, line.errorRate, line.maxRead == SIZE_MAX ? "whole" : "20 B", ok ? "ok" : "FAILED",
+            kibs, 100 * kibs / (line.baud / 10 / 1024), res.sender.resent
+        );
+        CHECK(ok);
+    }
+}
+
+static void testResume(const std::vector<uint8_t> &file) {
+    VectorSink sink;
+    Outcome first = transfer(file, sink, {921600, 0, SIZE_MAX}, 4000);
+    CHECK(!first.ok);
+    CHECK(sink.data.size() > 0 && sink.data.size() < file.size());
+    Outcome second = transfer(file, sink, {921600, 0, SIZE_MAX});
+    CHECK(second.ok);
+    CHECK(sink.data == file);
+
+    // a damaged prefix fails the CRC of the whole file
+    VectorSink damaged;
+    damaged.data.assign(file.begin(), file.begin() + 300000);
+    damaged.data[1234] ^= 1;
+    CHECK(!transfer(file, damaged, {921600, 0, SIZE_MAX}).ok);
+
+    std::vector<uint8_t> empty;
+    VectorSink emptySink;
+    CHECK(transfer(empty, emptySink, {921600, 0, SIZE_MAX}).ok);
+    CHECK(emptySink.data.empty());
+}
+
+static void testDecodeSpeed(const std::vector<uint8_t> &file) {
+    TransferDecoder decoder;
+    uint8_t frame[TRANSFER_MAX_PAYLOAD + TRANSFER_FRAME_OVERHEAD];
+    size_t n = transferEncode(TRANSFER_DATA, 1, file.data(), TRANSFER_MAX_PAYLOAD, frame);
+    int frames = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4096; i++)
+        for (size_t k = 0; k < n; k++) frames += decoder.feed(frame[k]);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    CHECK_EQ(frames, 4096);
+    printf("decoding: %.1f MB/s\n", 4096.0 * n / s / 1e6);
+}
+
+// The standard check value, and a CRC continued over pieces equal to the one of the whole
+static void testCrc32(const std::vector<uint8_t> &file) {
+    CHECK_EQ(crc32Update(0, (const uint8_t *)"123456789", 9), 0xCBF43926);
+    CHECK_EQ(crc32Update(0, nullptr, 0), 0);
+    uint32_t pieces = 0;
+    for (size_t done = 0; done < file.size(); done += 1000)
+        pieces = crc32Update(pieces, file.data() + done, std::min<size_t>(1000, file.size() - done));
+    CHECK_EQ(pieces, crc32Update(0, file.data(), file.size()));
+}
+
+int main() {
+    std::vector<uint8_t> file(1 << 20);
+    for (auto &b : file) b = rng();
+    testCrc32(file);
+    testErrorRates(file);
+    testResume(file);
+    testDecodeSpeed(file);
+    return HOST_TEST_RESULT();
+}
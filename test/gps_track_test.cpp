@@ -0,0 +1,425 @@
+// GpsTrackLog and the GPX export against an hour of synthetic NMEA at 5 Hz (driving, walking and
+// standing still with jitter), parsed the way TinyGPS++ parses it, at three places on either side of
+// the equator and the meridian. The export has to match the GPX the tracker used to write one point at
+// a time, but for the CRs of println(); the simplified exports have to stay within their tolerance of
+// every fix. The log has to read back what complete chunks hold wherever the power is cut, and stop at
+// a damaged chunk. Also reports the bytes and file operations per hour of both ways.
+
+#include "host_test.h"
+#include "modules/gps/gps_track.h"
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <random>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+static std::mt19937 rng(25);
+
+// TinyGPSPlus::parseDegrees(), to billionths of a degree
+static int64_t parseDegrees(const char *term, bool negative) {
+    uint32_t leftOfDecimal = (uint32_t)atol(term);
+    uint16_t minutes = (uint16_t)(leftOfDecimal % 100);
+    uint32_t multiplier = 10000000UL;
+    uint32_t tenMillionthsOfMinutes = minutes * multiplier;
+    while (isdigit(*term)) ++term;
+    if (*term == '.') {
+        while (isdigit(*++term)) {
+            multiplier /= 10;
+            tenMillionthsOfMinutes += (*term - '0') * multiplier;
+        }
+    }
+    int64_t billionths = (int64_t)(leftOfDecimal / 100) * 1000000000 + (5 * tenMillionthsOfMinutes + 1) / 3;
+    return negative ? -billionths : billionths;
+}
+
+// TinyGPSPlus::parseDecimal(), to hundredths
+static int32_t parseDecimal(const char *term) {
+    bool negative = *term == '-';
+    if (negative) ++term;
+    int32_t ret = 100 * (int32_t)atol(term);
+    while (isdigit(*term)) ++term;
+    if (*term == '.' && isdigit(term[1])) {
+        ret += 10 * (term[1] - '0');
+        if (isdigit(term[2])) ret += term[2] - '0';
+    }
+    return negative ? -ret : ret;
+}
+
+static std::string nmeaCoordinate(double degrees, int degreeDigits) {
+    double a = fabs(degrees);
+    int d = (int)a;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%0*d%08.5f", degreeDigits, d, (a - d) * 60);
+    return buf;
+}
+
+// GGA sentences of a drive, a walk, a drive and a stop of two minutes each, over and over
+static std::vector<std::string> generateNmea(int seconds, int hz, double lat, double lng) {
+    std::vector<std::string> sentences;
+    std::normal_distribution<double> noise(0, 1);
+    double alt = 545.4, heading = 0.3, speed = 0;
+    for (int i = 0; i < seconds * hz; i++) {
+        int ms = i * 1000 / hz;
+        int phase = (i / (hz * 120)) % 4;
+        double target = phase == 0 ? 14 : phase == 1 ? 1.4 : phase == 2 ? 25 : 0;
+        speed += (target - speed) * 0.02;
+        heading += noise(rng) * (speed < 3 ? 0.2 : 0.02) + (i % (hz * 40) == 0 ? 1.2 : 0);
+        double step = speed / hz + (speed < 0.5 ? noise(rng) * 0.3 : 0); // jitter standing still
+        lat += step * cos(heading) / 111194.93;
+        lng += step * sin(heading) / (111194.93 * cos(lat * M_PI / 180));
+        alt += noise(rng) * 0.05;
+
+        char body[160];
+        snprintf(
+            body, sizeof(body), "GPGGA,%02d%02d%02d.%02d,%s,%c,%s,%c,1,%02d,%.1f,%.1f,M,46.9,M,,",
+            12 + ms / 3600000, (ms / 60000) % 60, (ms / 1000) % 60, (ms % 1000) / 10,
+            nmeaCoordinate(lat, 2).c_str(), lat < 0 ? 'S' : 'N', nmeaCoordinate(lng, 3).c_str(),
+            lng < 0 ? 'W' : 'E', 7 + (i / 500) % 6, 0.8 + ((i / 300) % 10) * 0.1, alt
+        );
+        sentences.push_back(body);
+    }
+    return sentences;
+}
+
+// A point per GGA, as the tracker adds one per location update, on 2025-06-15
+static std::vector<GpsTrackPoint> parseNmea(const std::vector<std::string> &sentences) {
+    std::vector<GpsTrackPoint> points;
+    for (const std::string &sentence : sentences) {
+        std::vector<std::string> f;
+        for (size_t p = 0, q;; p = q + 1) {
+            q = sentence.find(',', p);
+            f.push_back(sentence.substr(p, q - p));
+            if (q == std::string::npos) break;
+        }
+        GpsTrackPoint point;
+        int32_t t = parseDecimal(f[1].c_str()); // hhmmss in hundredths
+        point.time = gpsTrackTime(2025, 6, 15, t / 1000000, t / 10000 % 100, t / 100 % 100, t % 100);
+        point.lat = parseDegrees(f[2].c_str(), f[3] == "S");
+        point.lng = parseDegrees(f[4].c_str(), f[5] == "W");
+        point.sat = atol(f[7].c_str());
+        point.hdop = parseDecimal(f[8].c_str());
+        point.alt = parseDecimal(f[9].c_str());
+        points.push_back(point);
+    }
+    return points;
+}
+
+// What the tracker used to write: the file opened, a point appended, closed, at every fix
+struct LegacyGpx {
+    std::string data;
+    long opens = 0, writes = 0;
+
+    void println(const char *line) {
+        data += line;
+        data += "\r\n";
+        writes++;
+    }
+    void printf(const char *format, ...) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        data += buf;
+        writes++;
+    }
+};
+
+static LegacyGpx legacyGpx(const std::vector<GpsTrackPoint> &points) {
+    static const char *header[] = {
+        "<?xml version=\"1.0\" encoding=\"ISO-8859-1\" standalone=\"yes\"?>",
+        "<?xml-stylesheet type=\"text/xsl\" href=\"details.xsl\"?>",
+        "<gpx",
+        "  version=\"1.1\"",
+        "  creator=\"Bruce Firmware\"",
+        "  xmlns=\"http://www.topografix.com/GPX/1/1\"",
+        "  xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"",
+        "  xsi:schemaLocation=\"http://www.topografix.com/GPX/1/1 "
+        "http://www.topografix.com/GPX/1/1/gpx.xsd\"",
+        ">",
+        "  <metadata>",
+        "    <name>Bruce GPS Tracker</name>",
+        "    <desc>GPS Tracker using Bruce Firmware</desc>",
+        "    <link href=\"https://bruce.computer\">",
+        "      <text>Bruce Website</text>",
+        "    </link>",
+        "  </metadata>",
+        "  <trk>",
+        "    <name>Bruce Route</name>",
+        "    <desc>GPS route captured by Bruce firmware</desc>",
+        "    <trkseg>",
+    };
+    LegacyGpx gpx;
+    for (const GpsTrackPoint &p : points) {
+        gpx.opens++;
+        if (&p == &points[0])
+            for (const char *line : header) gpx.println(line);
+        gpx.printf("      <trkpt lat=\"%f\" lon=\"%f\">\n", gpsTrackDegrees(p.lat), gpsTrackDegrees(p.lng));
+        gpx.println("        <sym>Waypoint</sym>");
+        gpx.printf("        <ele>%f</ele>\n", p.alt / 100.0);
+        gpx.printf("        <hdop>%f</hdop>\n", p.hdop / 100.0);
+        gpx.printf("        <sat>%ld</sat>\n", (long)p.sat);
+        gpx.println("      </trkpt>");
+    }
+    gpx.opens++;
+    gpx.println("    </trkseg>");
+    gpx.println("  </trk>");
+    gpx.println("</gpx>");
+    return gpx;
+}
+
+class StringSink : public GpsTrackSink {
+public:
+    bool append(const uint8_t *p, size_t len) override {
+        data.append((const char *)p, len);
+        appends++;
+        return true;
+    }
+    std::string data;
+    long appends = 0;
+};
+
+// Hands out a few bytes at a time, as a file read in pieces
+class StringSource : public GpsTrackSource {
+public:
+    explicit StringSource(const std::string &data) : _data(data) {}
+    size_t read(uint8_t *buf, size_t len) override {
+        size_t n = std::min({len, _data.size() - _pos, (size_t)97});
+        memcpy(buf, _data.data() + _pos, n);
+        _pos += n;
+        return n;
+    }
+
+private:
+    const std::string &_data;
+    size_t _pos = 0;
+};
+
+class StringOutput : public GpsTrackOutput {
+public:
+    bool write(const char *p, size_t len) override {
+        data.append(p, len);
+        writes++;
+        return true;
+    }
+    std::string data;
+    long writes = 0;
+};
+
+static bool samePoint(const GpsTrackPoint &a, const GpsTrackPoint &b) {
+    return a.time == b.time && a.lat == b.lat && a.lng == b.lng && a.alt == b.alt && a.hdop == b.hdop &&
+           a.sat == b.sat;
+}
+
+static std::vector<GpsTrackPoint> readAll(const std::string &log, bool *damaged = nullptr) {
+    StringSource source(log);
+    GpsTrackReader reader(source);
+    std::vector<GpsTrackPoint> points;
+    GpsTrackPoint point;
+    while (reader.next(point)) points.push_back(point);
+    if (damaged) *damaged = reader.damaged();
+    return points;
+}
+
+static std::string withoutCr(const std::string &s) {
+    std::string out;
+    for (char c : s)
+        if (c != '\r') out += c;
+    return out;
+}
+
+static std::vector<std::pair<std::string, std::string>> gpxPoints(const std::string &gpx) {
+    std::vector<std::pair<std::string, std::string>> points;
+    for (size_t p = 0; (p = gpx.find("<trkpt lat=\"", p)) != std::string::npos; p++) {
+        char lat[32], lng[32];
+        sscanf(gpx.c_str() + p, "<trkpt lat=\"%31[^\"]\" lon=\"%31[^\"]\"", lat, lng);
+        points.push_back({lat, lng});
+    }
+    return points;
+}
+
+// Meters from p to the segment from a to b, on a local flat projection
+static double segmentDistance(double lat, double lng, double aLat, double aLng, double bLat, double bLng) {
+    double kx = cos(aLat * M_PI / 180) * 111194.93, ky = 111194.93;
+    double bx = (bLng - aLng) * kx, by = (bLat - aLat) * ky, px = (lng - aLng) * kx, py = (lat - aLat) * ky;
+    double len2 = bx * bx + by * by;
+    double t = len2 > 0 ? std::max(0.0, std::min(1.0, (px * bx + py * by) / len2)) : 0;
+    return hypot(px - t * bx, py - t * by);
+}
+
+// Worst distance of a fix from the kept polyline around it, the kept points being fixes printed alike
+static double worstDeviation(const std::vector<GpsTrackPoint> &fixes, const std::string &gpx) {
+    auto kept = gpxPoints(gpx);
+    size_t k = 0;
+    double worst = 0;
+    for (const GpsTrackPoint &fix : fixes) {
+        char lat[32], lng[32];
+        snprintf(lat, sizeof(lat), "%f", gpsTrackDegrees(fix.lat));
+        snprintf(lng, sizeof(lng), "%f", gpsTrackDegrees(fix.lng));
+        if (kept[k].first == lat && kept[k].second == lng) {
+            if (k + 1 < kept.size()) k++;
+            continue;
+        }
+        double d = segmentDistance(
+            atof(lat), atof(lng), atof(kept[k - 1].first.c_str()), atof(kept[k - 1].second.c_str()),
+            atof(kept[k].first.c_str()), atof(kept[k].second.c_str())
+        );
+        worst = std::max(worst, d);
+    }
+    return worst;
+}
+
+// Cut at every chunk boundary and at random bytes: the points of the complete chunks, damaged when
+// the cut tore a chunk
+static void testPowerLoss(const std::string &log) {
+    std::vector<std::pair<size_t, size_t>> chunkEnds; // end, points up to it
+    size_t points = 0;
+    for (size_t pos = 4; pos < log.size();) {
+        points += (uint8_t)log[pos] | (uint8_t)log[pos + 1] << 8;
+        pos += 8 + ((uint8_t)log[pos + 2] | (uint8_t)log[pos + 3] << 8);
+        chunkEnds.push_back({pos, points});
+    }
+    int wrong = 0;
+    for (int i = 0; i < 400; i++) {
+        size_t cut = i < (int)chunkEnds.size() ? chunkEnds[i].first : rng() % log.size();
+        size_t expected = 0;
+        bool torn = cut > 4;
+        for (auto &end : chunkEnds) {
+            if (end.first > cut) break;
+            expected = end.second;
+            torn = end.first != cut;
+        }
+        bool damaged;
+        std::vector<GpsTrackPoint> got = readAll(log.substr(0, cut), &damaged);
+        if (got.size() != expected || damaged != torn) wrong++;
+    }
+    CHECK_EQ(wrong, 0);
+
+    std::string flipped = log;
+    flipped[flipped.size() / 2] ^= 0x10;
+    bool damaged;
+    size_t read = readAll(flipped, &damaged).size();
+    CHECK(damaged && read > 0 && read < points);
+}
+
+static void testTrack(double lat, double lng, const char *place) {
+    const int hz = 5, seconds = 3600;
+    std::vector<std::string> nmea = generateNmea(seconds, hz, lat, lng);
+    std::vector<GpsTrackPoint> fixes = parseNmea(nmea);
+    CHECK_EQ(fixes.size(), seconds * hz);
+
+    StringSink sink;
+    GpsTrackLog log(sink);
+    for (size_t i = 0; i < fixes.size(); i++) CHECK(log.add(fixes[i], (uint32_t)(i * 1000 / hz)));
+    CHECK(log.flush());
+
+    bool damaged;
+    std::vector<GpsTrackPoint> read = readAll(sink.data, &damaged);
+    CHECK(!damaged);
+    CHECK(read.size() == fixes.size() && std::equal(read.begin(), read.end(), fixes.begin(), samePoint));
+
+    LegacyGpx legacy = legacyGpx(fixes);
+    StringSource source(sink.data);
+    GpsTrackReader reader(source);
+    StringOutput gpx;
+    CHECK_EQ(gpsTrackExportGpx(reader, gpx), fixes.size());
+    CHECK(gpx.data == withoutCr(legacy.data));
+
+    printf("%s: %zu fixes\n", place, fixes.size());
+    printf(
+        "  GPX at every fix: %zu B, %ld opens and closes, %ld writes\n", legacy.data.size(), legacy.opens,
+        legacy.writes
+    );
+    printf(
+        "  binary log:       %zu B (%.1f B per fix), %ld appends; exported: %zu B in %ld writes\n",
+        sink.data.size(), (double)sink.data.size() / fixes.size(), sink.appends, gpx.data.size(), gpx.writes
+    );
+
+    for (double tolerance : {1.0, 2.0, 5.0, 10.0}) {
+        StringSource source(sink.data);
+        GpsTrackReader reader(source);
+        StringOutput simplified;
+        long kept = gpsTrackExportGpx(reader, simplified, tolerance);
+        CHECK_EQ(kept, gpxPoints(simplified.data).size());
+        double worst = worstDeviation(fixes, simplified.data);
+        // and the rounding of %f
+        CHECK(worst <= tolerance + 0.2);
+        printf(
+            "  simplified to %4.1f m: %5ld points (%4.1f%%), %7zu B, %.2f m off at most\n", tolerance, kept,
+            100.0 * kept / fixes.size(), simplified.data.size(), worst
+        );
+    }
+
+    testPowerLoss(sink.data);
+}
+
+static void testEdges() {
+    // two sessions in one file read as one track
+    StringSink sink;
+    for (int64_t lat : {1, 2}) {
+        GpsTrackLog log(sink);
+        GpsTrackPoint point;
+        point.lat = lat;
+        log.add(point, 0);
+        log.flush();
+    }
+    bool damaged;
+    std::vector<GpsTrackPoint> points = readAll(sink.data, &damaged);
+    CHECK(points.size() == 2 && points[1].lat == 2 && !damaged);
+
+    CHECK(readAll("", &damaged).empty() && !damaged);
+    std::string empty;
+    StringSource source(empty);
+    GpsTrackReader reader(source);
+    StringOutput out;
+    CHECK_EQ(gpsTrackExportGpx(reader, out, 5), 0);
+
+    // storage gone: what stays buffered is bounded
+    class FailingSink : public GpsTrackSink {
+    public:
+        bool append(const uint8_t *, size_t) override { return false; }
+    } failing;
+    GpsTrackLog log(failing);
+    GpsTrackPoint point;
+    size_t buffered = 0;
+    for (int i = 0; i < 100000; i++) {
+        point.lat += 12345;
+        log.add(point, i * 200);
+        buffered = std::max(buffered, log.buffered());
+    }
+    CHECK(buffered < 2000);
+}
+
+static void testTime() {
+    int wrong = 0;
+    for (int year = 1970; year < 2100; year++) {
+        for (int month = 1; month <= 12; month++) {
+            for (int day = 1; day <= 28; day += 9) {
+                struct tm t = {};
+                t.tm_year = year - 1900;
+                t.tm_mon = month - 1;
+                t.tm_mday = day;
+                t.tm_hour = 13;
+                t.tm_min = 7;
+                t.tm_sec = 59;
+                int64_t expected = (int64_t)timegm(&t) * 1000 + 450;
+                if (gpsTrackTime(year, month, day, 13, 7, 59, 45) != expected) wrong++;
+            }
+        }
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+int main() {
+    testTrack(-23.5505, -46.6333, "Sao Paulo");
+    testTrack(48.8566, 2.3522, "Paris");
+    testTrack(64.1466, -21.9426, "Reykjavik");
+    testEdges();
+    testTime();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,32 @@
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+// Checks for the host tests. Each test is a program of its own that prints what failed and exits
+// non-zero, so ctest needs nothing else.
+
+#include <stdio.h>
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond)                                                                                          \
+    do {                                                                                                     \
+        if (!(cond)) {                                                                                       \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                                  \
+            hostTestFailures++;                                                                              \
+        }                                                                                                    \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                       \
+    do {                                                                                                     \
+        long long _a = (long long)(a), _b = (long long)(b);                                                  \
+        if (_a != _b) {                                                                                      \
+            printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b);    \
+            hostTestFailures++;                                                                              \
+        }                                                                                                    \
+    } while (0)
+
+// Returns from main
+#define HOST_TEST_RESULT()                                                                                   \
+    (printf(hostTestFailures ? "%d failures\n" : "ok\n", hostTestFailures), hostTestFailures ? 1 : 0)
+
+#endif
@@ -0,0 +1,214 @@
+// ImageAtlas eviction policy: least recently drawn first, the byte budget and the slot count, images
+// still being decoded kept, stale stamps dropped and the generation check. Then a theme menu of icons
+// drawn over and over with the card written now and then, as drawPNG does it before (the file opened
+// for its stamp on every draw) and now (opened only when the generation moved): reports the file
+// opens per draw, the card time they cost at SD_OPEN_US each, and the host time of a hit and a miss.
+
+#include "core/image_atlas.h"
+#include "host_test.h"
+#include <chrono>
+#include <random>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define SD_OPEN_US 1500.0 // open, stat and close of an image in a theme folder over SPI
+
+static std::mt19937 rng(9);
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Reserves and completes a w x h image
+static bool add(ImageAtlas &atlas, const char *path, uint16_t w, uint16_t h, uint32_t gen = 1) {
+    uint16_t *px = atlas.reserve(path, w * h, 100, gen, w, h);
+    if (!px) return false;
+    for (size_t i = 0; i < (size_t)w * h; i++) px[i] = i;
+    atlas.commit(px, true);
+    return true;
+}
+
+static bool has(ImageAtlas &atlas, const char *path, uint16_t w, uint16_t h) {
+    return atlas.find(path, w * h, 100, 1) != nullptr;
+}
+
+static void testEviction() {
+    // four 32x32 icons fit, the fifth evicts the least recently drawn
+    ImageAtlas atlas(4 * 32 * 32 * 2);
+    CHECK(add(atlas, "a", 32, 32));
+    CHECK(add(atlas, "b", 32, 32));
+    CHECK(add(atlas, "c", 32, 32));
+    CHECK(add(atlas, "d", 32, 32));
+    CHECK_EQ(atlas.used(), atlas.budget());
+    CHECK(has(atlas, "a", 32, 32)); // a is now newer than b
+    CHECK(add(atlas, "e", 32, 32));
+    CHECK_EQ(atlas.evictions(), 1);
+    CHECK(!has(atlas, "b", 32, 32));
+    CHECK(has(atlas, "a", 32, 32));
+
+    // a big image takes as many of the oldest as it needs
+    CHECK(add(atlas, "big", 64, 32));
+    CHECK_EQ(atlas.evictions(), 3);
+    CHECK(!has(atlas, "c", 32, 32));
+    CHECK(!has(atlas, "d", 32, 32));
+    CHECK(has(atlas, "e", 32, 32));
+    CHECK_EQ(atlas.count(), 3);
+
+    // larger than the whole budget: refused, nothing evicted
+    CHECK(!add(atlas, "huge", 128, 128));
+    CHECK_EQ(atlas.count(), 3);
+
+    // an image still being decoded is never evicted, even when it is the oldest
+    atlas.clear();
+    CHECK_EQ(atlas.used(), 0);
+    uint16_t *pending = atlas.reserve("pending", 1, 100, 1, 32, 32);
+    CHECK(pending != nullptr);
+    CHECK(add(atlas, "x", 32, 32));
+    CHECK(add(atlas, "y", 32, 32));
+    CHECK(add(atlas, "z", 32, 32));
+    CHECK(add(atlas, "w", 32, 32));
+    CHECK(atlas.find("pending", 1, 100, 1) == nullptr);
+    CHECK(!has(atlas, "x", 32, 32));
+    atlas.commit(pending, true);
+    CHECK(atlas.find("pending", 1, 100, 1) != nullptr);
+    // nor when it is the only one and something else wants room
+    atlas.clear();
+    pending = atlas.reserve("pending", 1, 100, 1, 64, 64);
+    CHECK(pending != nullptr);
+    CHECK(!add(atlas, "x", 32, 32));
+    atlas.commit(pending, false); // decoding failed
+    CHECK_EQ(atlas.count(), 0);
+    CHECK_EQ(atlas.used(), 0);
+
+    // the slot count bounds tiny images
+    ImageAtlas slots(1 << 20);
+    for (int i = 0; i <= IMAGE_ATLAS_MAX_ENTRIES; i++) CHECK(add(slots, std::to_string(i).c_str(), 4, 4));
+    CHECK_EQ(slots.count(), IMAGE_ATLAS_MAX_ENTRIES);
+    CHECK(!has(slots, "0", 4, 4));
+    CHECK(has(slots, std::to_string(IMAGE_ATLAS_MAX_ENTRIES).c_str(), 4, 4));
+
+    // against a model: the image dropped is always the least recently drawn one
+    ImageAtlas lru(8 * 16 * 16 * 2);
+    std::vector<std::pair<std::string, uint32_t>> model; // path, last use
+    uint32_t clock = 0;
+    int wrong = 0;
+    for (int step = 0; step < 20000; step++) {
+        std::string path = "icon" + std::to_string(rng() % 16);
+        bool found = has(lru, path.c_str(), 16, 16);
+        auto it = model.begin();
+        while (it != model.end() && it->first != path) ++it;
+        if (found != (it != model.end())) wrong++;
+        if (found) {
+            it->second = ++clock;
+            continue;
+        }
+        if (model.size() == 8) {
+            auto oldest = model.begin();
+            for (auto m = model.begin(); m != model.end(); ++m)
+                if (m->second < oldest->second) oldest = m;
+            model.erase(oldest);
+        }
+        add(lru, path.c_str(), 16, 16);
+        model.push_back({path, ++clock});
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+static void testStamps() {
+    ImageAtlas atlas(64 * 1024);
+    CHECK(add(atlas, "sd:/t/wifi.png", 32, 32, 7));
+    // same generation: found by path alone
+    CHECK(atlas.find("sd:/t/wifi.png", 7) != nullptr);
+    // the card was written: the stamp has to be read, then the path alone is enough again
+    CHECK(atlas.find("sd:/t/wifi.png", 8) == nullptr);
+    CHECK(atlas.find("sd:/t/wifi.png", 32 * 32, 100, 8) != nullptr);
+    CHECK(atlas.find("sd:/t/wifi.png", 8) != nullptr);
+    // an edited image is dropped
+    CHECK(atlas.find("sd:/t/wifi.png", 9) == nullptr);
+    CHECK(atlas.find("sd:/t/wifi.png", 32 * 32, 101, 9) == nullptr);
+    CHECK_EQ(atlas.count(), 0);
+    // a file system without a generation always checks the stamp
+    CHECK(add(atlas, "fs:/t/ir.png", 32, 32, IMAGE_ATLAS_UNTRACKED));
+    CHECK(atlas.find("fs:/t/ir.png", IMAGE_ATLAS_UNTRACKED) == nullptr);
+    CHECK(atlas.find("fs:/t/ir.png", 32 * 32, 100, IMAGE_ATLAS_UNTRACKED) != nullptr);
+    CHECK(atlas.find("fs:/t/ir.png", IMAGE_ATLAS_UNTRACKED) == nullptr);
+}
+
+struct Run {
+    size_t opens, decodes;
+    double findNs;
+};
+
+// A theme of 12 icons, the menu moving across them; the card is written every writeEvery draws
+static Run drawMenu(bool generations, int draws, int writeEvery) {
+    ImageAtlas atlas(IMAGE_ATLAS_PSRAM_BUDGET);
+    std::vector<std::string> icons;
+    for (int i = 0; i < 12; i++) icons.push_back("sd:/BruceTheme/icon" + std::to_string(i) + ".png");
+    uint32_t generation = 0;
+    Run run = {0, 0, 0};
+    auto t0 = std::chrono::steady_clock::now();
+    for (int d = 0; d < draws; d++) {
+        if (writeEvery && d % writeEvery == 0) generation++;
+        const char *path = icons[d % icons.size()].c_str();
+        if (generations && atlas.find(path, generation)) continue;
+        run.opens++;
+        if (atlas.find(path, 64 * 64, 100, generation)) continue;
+        run.decodes++;
+        uint16_t *px = atlas.reserve(path, 64 * 64, 100, generation, 64, 64);
+        memset(px, 0x5A, 64 * 64 * 2);
+        atlas.commit(px, true);
+    }
+    run.findNs = nsSince(t0) / draws;
+    return run;
+}
+
+static void testDraws() {
+    const int draws = 100000;
+    for (int writeEvery : {0, 1000, 50}) {
+        Run old = drawMenu(false, draws, writeEvery);
+        Run now = drawMenu(true, draws, writeEvery);
+        printf(
+            "card written %-11s: stamp every draw %.3f opens/draw (%.0f us); by generation %.3f opens/draw "
+            "(%.0f us), %zu decodes\n",
+            writeEvery ? ("every " + std::to_string(writeEvery)).c_str() : "never", (double)old.opens / draws,
+            SD_OPEN_US * old.opens / draws, (double)now.opens / draws, SD_OPEN_US * now.opens / draws,
+            now.decodes
+        );
+        CHECK_EQ(old.opens, draws);
+        CHECK_EQ(now.decodes, old.decodes);
+        CHECK(now.opens <= (writeEvery ? (size_t)(draws / writeEvery) * 12 : 0) + 12);
+    }
+
+    // host time of a hit by generation, a hit by stamp and a miss that decodes
+    ImageAtlas atlas(IMAGE_ATLAS_PSRAM_BUDGET);
+    for (int i = 0; i < 12; i++)
+        add(atlas, ("sd:/BruceTheme/icon" + std::to_string(i) + ".png").c_str(), 64, 64);
+    const int n = 1000000;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (int i = 0; i < n; i++) found += atlas.find("sd:/BruceTheme/icon11.png", 1) != nullptr;
+    double hitNs = nsSince(t0) / n;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) found += atlas.find("sd:/BruceTheme/icon11.png", 64 * 64, 100, 1) != nullptr;
+    double stampNs = nsSince(t0) / n;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n / 100; i++) {
+        atlas.erase("sd:/new.png");
+        found += atlas.find("sd:/new.png", 64 * 64, 100, 1) != nullptr;
+        add(atlas, "sd:/new.png", 64, 64);
+    }
+    double missNs = nsSince(t0) / (n / 100);
+    printf(
+        "hit by generation %.0f ns, hit by stamp %.0f ns, miss and 64x64 fill %.0f ns\n", hitNs, stampNs,
+        missNs
+    );
+    CHECK_EQ(found, 2 * (size_t)n);
+}
+
+int main() {
+    testEviction();
+    testStamps();
+    testDraws();
+    return HOST_TEST_RESULT();
+}
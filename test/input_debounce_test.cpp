@@ -0,0 +1,223 @@
+// InputDebouncer replaying key traces with contact bounce on every edge, the way the input task runs
+// it: woken by the key interrupt, at the deadline it asks for and by a poll. Every press has to give
+// exactly one press and one release, the press without latency and the release within the bounce
+// window, also for taps shorter than the window and across the wrap of millis(). Also covers the
+// repeat timing of a held key.
+
+#include "core/input_debounce.h"
+#include "host_test.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static std::mt19937 rng(7);
+
+// Starts of the traces, two of them across the wrap of millis()
+static const uint32_t bases[] = {1000u, 0xFFFFFFFFu - 3000u, 0x7FFFFFF0u};
+
+struct Edge {
+    uint32_t time;
+    uint16_t pressed; // raw state of all the keys from then on
+};
+
+struct Press {
+    int key;
+    uint32_t down, up;
+};
+
+static bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+// The raw trace of presses whose contacts bounce for up to bounceMs after each edge
+static std::vector<Edge> bounce(const std::vector<Press> &presses, uint32_t bounceMs) {
+    struct Change {
+        uint32_t time;
+        int key;
+        bool down;
+    };
+    std::vector<Change> changes;
+    for (const Press &p : presses) {
+        for (bool down : {true, false}) {
+            uint32_t at = down ? p.down : p.up;
+            uint32_t t = at;
+            int bounces = rng() % 6;
+            for (int i = 0; i < bounces; i++) {
+                changes.push_back({t, p.key, i % 2 == 0 ? down : !down});
+                t += 1 + rng() % (bounceMs / bounces + 1);
+                if (!before(t, at + bounceMs)) break;
+            }
+            changes.push_back({t, p.key, down});
+        }
+    }
+    std::stable_sort(changes.begin(), changes.end(), [](const Change &a, const Change &b) {
+        return before(a.time, b.time);
+    });
+    std::vector<Edge> trace;
+    uint16_t pressed = 0;
+    for (const Change &c : changes) {
+        if (c.down) pressed |= INPUT_KEY_BIT(c.key);
+        else pressed &= ~INPUT_KEY_BIT(c.key);
+        trace.push_back({c.time, pressed});
+    }
+    return trace;
+}
+
+// The input task from start to end: wakes at an edge after the interrupt latency, at the deadline the
+// debouncer asks for, or after pollMs
+static std::vector<InputEvent>
+replay(const std::vector<Edge> &trace, uint32_t start, uint32_t end, uint32_t pollMs, uint32_t irqLatencyMs) {
+    InputDebouncer debouncer;
+    std::vector<InputEvent> events;
+    InputEvent out[INPUT_KEY_COUNT];
+    size_t next = 0;
+    uint16_t pressed = 0;
+    for (uint32_t now = start; before(now, end);) {
+        uint32_t wait = std::min(pollMs, debouncer.nextDeadline(now));
+        uint32_t wake = now + wait;
+        if (next < trace.size() && before(trace[next].time + irqLatencyMs, wake))
+            wake = trace[next].time + irqLatencyMs;
+        now = wake;
+        while (next < trace.size() && !before(now, trace[next].time)) pressed = trace[next++].pressed;
+        size_t n = debouncer.update(pressed, now, out);
+        events.insert(events.end(), out, out + n);
+        if (wait == 0 && n == 0) now++;
+    }
+    return events;
+}
+
+static int count(const std::vector<InputEvent> &events, InputEventType type) {
+    return std::count_if(events.begin(), events.end(), [type](const InputEvent &e) {
+        return e.type == type;
+    });
+}
+
+// Up to three keys, short presses and holds that repeat, 5 ms of bounce
+static void testPresses() {
+    long presses = 0, lost = 0;
+    uint32_t maxPressLatency = 0, maxReleaseLatency = 0;
+    for (uint32_t base : bases) {
+        for (int trial = 0; trial < 2000; trial++) {
+            std::vector<Press> script;
+            uint32_t t = base + 5;
+            int keys = 1 + rng() % 3;
+            for (int i = 0; i < 20; i++) {
+                uint32_t hold = rng() % 4 == 0 ? 300 + rng() % 900 : 25 + rng() % 120;
+                script.push_back({(int)(rng() % keys), t, t + hold});
+                t += hold + 25 + rng() % 100;
+            }
+            std::vector<InputEvent> events = replay(bounce(script, 5), base, t + 500, 50, 0);
+
+            for (const Press &p : script) {
+                bool pressed = false, released = false;
+                for (const InputEvent &e : events) {
+                    if (e.key != p.key) continue;
+                    bool during = !before(e.time, p.down) && before(e.time, p.up);
+                    if (!pressed && e.type == INPUT_PRESS && during) {
+                        pressed = true;
+                        maxPressLatency = std::max(maxPressLatency, e.time - p.down);
+                    } else if (pressed && e.type == INPUT_RELEASE && !before(e.time, p.up)) {
+                        released = true;
+                        maxReleaseLatency = std::max(maxReleaseLatency, e.time - p.up);
+                        break;
+                    }
+                }
+                if (!pressed || !released) lost++;
+                presses++;
+            }
+            CHECK_EQ(count(events, INPUT_PRESS), script.size());
+            CHECK_EQ(count(events, INPUT_RELEASE), script.size());
+        }
+    }
+    printf(
+        "%ld presses, %ld lost, latency: press %u ms, release %u ms at most\n", presses, lost,
+        maxPressLatency, maxReleaseLatency
+    );
+    CHECK_EQ(lost, 0);
+    CHECK_EQ(maxPressLatency, 0);
+    CHECK(maxReleaseLatency <= InputDebounceConfig().debounceMs);
+}
+
+// Taps of 6 to 20 ms, shorter than the bounce window, 2 ms of bounce and 1 ms of interrupt latency
+static void testFastTaps() {
+    long taps = 0, tracesLosing = 0;
+    uint32_t maxPressLatency = 0, maxReleaseLatency = 0;
+    for (uint32_t base : bases) {
+        for (int trial = 0; trial < 2000; trial++) {
+            std::vector<Press> script;
+            uint32_t t = base + 5;
+            for (int i = 0; i < 20; i++) {
+                uint32_t hold = 6 + rng() % 14;
+                script.push_back({(int)(rng() % 2), t, t + hold});
+                t += hold + 40 + rng() % 40;
+            }
+            std::vector<InputEvent> events = replay(bounce(script, 2), base, t + 500, 50, 1);
+            if (count(events, INPUT_PRESS) != 20 || count(events, INPUT_RELEASE) != 20) tracesLosing++;
+
+            // events of each key in order against its taps
+            for (int key = 0; key < 2; key++) {
+                std::vector<Press> keyTaps;
+                for (const Press &p : script)
+                    if (p.key == key) keyTaps.push_back(p);
+                size_t tap = 0;
+                for (const InputEvent &e : events) {
+                    if (e.key != key) continue;
+                    if (tap >= keyTaps.size()) break;
+                    if (e.type == INPUT_PRESS) {
+                        maxPressLatency = std::max(maxPressLatency, e.time - keyTaps[tap].down);
+                    } else if (e.type == INPUT_RELEASE) {
+                        maxReleaseLatency = std::max(maxReleaseLatency, e.time - keyTaps[tap].up);
+                        tap++;
+                    }
+                }
+            }
+            taps += 20;
+        }
+    }
+    printf(
+        "%ld fast taps, %ld traces losing one, latency: press %u ms, release %u ms at most\n", taps,
+        tracesLosing, maxPressLatency, maxReleaseLatency
+    );
+    CHECK_EQ(tracesLosing, 0);
+    CHECK(maxPressLatency <= 4);
+    CHECK(maxReleaseLatency <= InputDebounceConfig().debounceMs + 1);
+}
+
+static void testTimings() {
+    InputEvent out[INPUT_KEY_COUNT];
+
+    // a tap shorter than the bounce window still gives a press and a release
+    InputDebouncer tap;
+    CHECK(tap.update(1, 100, out) == 1 && out[0].type == INPUT_PRESS);
+    CHECK_EQ(tap.update(0, 105, out), 0);
+    CHECK_EQ(tap.nextDeadline(105), 15);
+    CHECK(tap.update(0, 120, out) == 1 && out[0].type == INPUT_RELEASE && out[0].time == 120);
+
+    // a held key repeats after 200 ms, then every 200 ms
+    InputDebouncer hold;
+    std::vector<uint32_t> repeats;
+    hold.update(1, 0, out);
+    for (uint32_t t = 1; t < 1000; t++) {
+        size_t n = hold.update(1, t, out);
+        for (size_t i = 0; i < n; i++)
+            if (out[i].type == INPUT_REPEAT) repeats.push_back(t);
+    }
+    CHECK(repeats == std::vector<uint32_t>({200, 400, 600, 800}));
+
+    // polled late, once, not a burst
+    InputDebouncer late;
+    late.update(1, 0, out);
+    CHECK_EQ(late.update(1, 1000, out), 1);
+    CHECK_EQ(late.nextDeadline(1000), 200);
+
+    // idle for longer than half the range of millis(), then pressed
+    InputDebouncer idle;
+    uint32_t t = 0;
+    for (int i = 0; i < 60; i++) idle.update(0, t += 24u * 3600 * 1000, out);
+    CHECK_EQ(idle.update(1, t + 1, out), 1);
+}
+
+int main() {
+    testPresses();
+    testFastTaps();
+    testTimings();
+    return HOST_TEST_RESULT();
+}
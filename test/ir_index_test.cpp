@@ -0,0 +1,215 @@
+// IrIndexBuilder over every .ir file in sd_files/infrared, as is and converted to CRLF, fed in random
+// chunk sizes. Each index goes through its stored form (header, records, string pool) and is loaded
+// back; every signal must then match what the old menu parser made of the text: name, type,
+// protocol, address, command, frequency, bits and the data:/value:/state: text, read from the span
+// the index points at. Also checks that a stale header is refused, and reports the build time per MB.
+
+#include "host_test.h"
+#include "modules/ir/ir_index.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static std::mt19937 rng(7);
+
+struct OldCode {
+    std::string name, type, protocol, address, command, data;
+    uint16_t frequency = 0;
+    uint8_t bits = 32;
+};
+
+static std::string trimmed(const std::string &s) {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char)s[b])) b++;
+    while (e > b && isspace((unsigned char)s[e - 1])) e--;
+    return s.substr(b, e - b);
+}
+
+static bool startsWith(const std::string &s, const char *prefix) { return s.rfind(prefix, 0) == 0; }
+
+// chooseCmdIrFile before the index, without its 100 signal cap
+static std::vector<OldCode> oldParse(const std::string &file) {
+    std::vector<OldCode> codes(1);
+    size_t pos = 0;
+    while (pos < file.size()) {
+        size_t nl = file.find('\n', pos);
+        if (nl == std::string::npos) nl = file.size();
+        std::string line = file.substr(pos, nl - pos);
+        pos = nl + 1;
+        size_t colon = line.find(':');
+        std::string txt = trimmed(line.substr(colon == std::string::npos ? 0 : colon + 1));
+        OldCode *code = &codes.back();
+        if (startsWith(line, "name:")) {
+            if (!code->name.empty()) {
+                codes.emplace_back();
+                code = &codes.back();
+            }
+            code->name = txt;
+        }
+        if (startsWith(line, "type:")) code->type = txt;
+        if (startsWith(line, "protocol:")) code->protocol = txt;
+        if (startsWith(line, "address:")) code->address = txt;
+        if (startsWith(line, "frequency:")) code->frequency = atol(txt.c_str());
+        if (startsWith(line, "bits:")) code->bits = atol(txt.c_str());
+        if (startsWith(line, "command:")) code->command = txt;
+        if (startsWith(line, "data:") || startsWith(line, "value:") || startsWith(line, "state:"))
+            code->data = txt;
+        if (startsWith(line, "#") && !code->name.empty()) codes.emplace_back();
+    }
+    // the menu lists named signals only
+    codes.erase(std::remove_if(codes.begin(), codes.end(), [](const OldCode &c) {
+        return c.name.empty();
+    }), codes.end());
+    return codes;
+}
+
+static bool buildIndex(const std::string &file, IrIndex &index) {
+    IrIndexBuilder builder;
+    builder.begin(&index);
+    for (size_t done = 0; done < file.size();) {
+        size_t n = std::min<size_t>(1 + rng() % 512, file.size() - done);
+        builder.feed(file.data() + done, n);
+        done += n;
+    }
+    return builder.finish();
+}
+
+// What loadIrIndex writes and reads back on SD
+static std::string store(const IrIndex &index, uint32_t sourceSize) {
+    IrIndexHeader hdr = index.header(sourceSize, 0);
+    std::string out((const char *)&hdr, sizeof(hdr));
+    out.append((const char *)index.entries(), index.size() * sizeof(IrIndexEntry));
+    out.append(index.pool(), index.poolSize());
+    return out;
+}
+
+static bool load(const std::string &stored, uint32_t sourceSize, uint32_t mtime, IrIndex &index) {
+    if (stored.size() < sizeof(IrIndexHeader)) return false;
+    IrIndexHeader hdr;
+    memcpy(&hdr, stored.data(), sizeof(hdr));
+    if (!index.accept(hdr, sourceSize, mtime)) return false;
+    size_t entries = hdr.entryCount * sizeof(IrIndexEntry);
+    if (stored.size() != sizeof(hdr) + entries + hdr.poolSize) return false;
+    memcpy(index.entryBuffer(), stored.data() + sizeof(hdr), entries);
+    memcpy(index.poolBuffer(), stored.data() + sizeof(hdr) + entries, hdr.poolSize);
+    return index.loaded();
+}
+
+// The index keeps strings up to IR_INDEX_STRING_LEN - 1 bytes
+static std::string cut(const std::string &s) { return s.substr(0, IR_INDEX_STRING_LEN - 1); }
+
+static int compare(const std::string &file, const IrIndex &index, const std::vector<OldCode> &old) {
+    if (index.size() != old.size()) return 1 + (int)std::max(index.size(), old.size());
+    int diffs = 0;
+    for (size_t i = 0; i < old.size(); i++) {
+        const IrIndexEntry &e = index[i];
+        const OldCode &o = old[i];
+        bool same = index.str(e.name) == cut(o.name) && index.str(e.type) == cut(o.type) &&
+                    index.str(e.protocol) == cut(o.protocol) && index.str(e.address) == cut(o.address) &&
+                    index.str(e.command) == cut(o.command) && e.frequency == o.frequency && e.bits == o.bits;
+        same &= file.substr(e.dataOffset, e.dataLength) == o.data;
+        if (!same) diffs++;
+    }
+    return diffs;
+}
+
+static std::vector<std::string> irFiles() {
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(BRUCE_SD_FILES "/infrared")) {
+        if (entry.is_regular_file() && entry.path().extension() == ".ir") paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+static std::string readFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static void testCorpus() {
+    std::vector<std::string> paths = irFiles();
+    CHECK(paths.size() > 100);
+    size_t signals = 0, bytes = 0;
+    int differing = 0, unloadable = 0;
+    double buildMs = 0, oldMs = 0;
+    for (const std::string &path : paths) {
+        std::string lf = readFile(path);
+        std::string crlf;
+        for (char c : lf) {
+            if (c == '\n' && (crlf.empty() || crlf.back() != '\r')) crlf += '\r';
+            crlf += c;
+        }
+        for (const std::string *file : {&lf, &crlf}) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<OldCode> old = oldParse(*file);
+            auto t1 = std::chrono::steady_clock::now();
+            IrIndex built;
+            bool ok = buildIndex(*file, built);
+            auto t2 = std::chrono::steady_clock::now();
+            oldMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            buildMs += std::chrono::duration<double, std::milli>(t2 - t1).count();
+            bytes += file->size();
+
+            IrIndex loaded;
+            if (!ok || !load(store(built, file->size()), file->size(), 1234, loaded)) {
+                unloadable++;
+                continue;
+            }
+            int diffs = compare(*file, loaded, old);
+            if (diffs) {
+                printf("%s%s: %d signals differ\n", path.c_str(), file == &crlf ? " (CRLF)" : "", diffs);
+                differing++;
+            }
+            signals += loaded.size();
+        }
+    }
+    double mb = bytes / 1048576.0;
+    printf(
+        "%zu files, %zu signals in LF and CRLF, %.1f MB: index %.1f ms/MB, old menu parser %.1f ms/MB\n",
+        paths.size(), signals, mb, buildMs / mb, oldMs / mb
+    );
+    CHECK_EQ(differing, 0);
+    CHECK_EQ(unloadable, 0);
+}
+
+// An index is only taken for the file it was built from
+static void testStale() {
+    std::string file = "name: Power\ntype: parsed\nprotocol: NEC\naddress: 04 00 00 00\n"
+                       "command: 08 00 00 00\n#\nname: Raw\ntype: raw\nfrequency: 38000\n"
+                       "duty_cycle: 0.33\ndata: 9000 4500 560\n";
+    IrIndex built, loaded;
+    CHECK(buildIndex(file, built));
+    CHECK_EQ(built.size(), 2);
+    std::string stored = store(built, file.size());
+    CHECK(load(stored, file.size(), 99, loaded));
+    CHECK(!load(stored, file.size() + 1, 99, loaded));
+    CHECK_EQ(loaded.size(), 0);
+
+    IrIndexHeader hdr = built.header(file.size(), 42);
+    std::string dated((const char *)&hdr, sizeof(hdr));
+    dated += stored.substr(sizeof(hdr));
+    CHECK(load(dated, file.size(), 42, loaded));
+    CHECK(!load(dated, file.size(), 43, loaded));
+
+    // a pool that does not end in a terminator is refused
+    std::string broken = stored;
+    broken.back() = 'x';
+    CHECK(!load(broken, file.size(), 99, loaded));
+    CHECK(!load(stored.substr(0, stored.size() - 1), file.size(), 99, loaded));
+}
+
+int main() {
+    testCorpus();
+    testStale();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,281 @@
+// LineReader against the String way of reading a text file, over every .ir file in sd_files/infrared.
+// The String path pulls the file through a per-byte read as Stream::readStringUntil() does, then
+// trims and cuts key and value into new strings; the reader takes the file in blocks and slices it in
+// place. Both must give the same key: value checksum. Reports MB/s and allocations per line, with
+// IrIndexBuilder, the tokenizer the IR menu uses, alongside. Also checks that the pieces of long lines
+// put back together give the file at every buffer size, cut at blanks, and the TextSlice parsing.
+
+#include "core/line_reader.h"
+#include "host_test.h"
+#include "modules/ir/ir_index.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define ROUNDS 10
+
+static size_t allocations = 0;
+
+void *operator new(size_t n) {
+    allocations++;
+    void *p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static std::mt19937 rng(15);
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// An open file: read() hands out up to len bytes from the current position
+struct MemFile {
+    const std::string *text;
+    size_t pos = 0;
+
+    size_t read(uint8_t *buffer, size_t len) {
+        size_t n = std::min(len, text->size() - pos);
+        memcpy(buffer, text->data() + pos, n);
+        pos += n;
+        return n;
+    }
+    // Stream::timedRead(): a virtual read() of one byte
+    int readByte() {
+        uint8_t c;
+        return read(&c, 1) ? c : -1;
+    }
+};
+
+static size_t readMem(void *ctx, uint8_t *buffer, size_t len) {
+    return static_cast<MemFile *>(ctx)->read(buffer, len);
+}
+
+// What the parsers make of a file, order dependent
+struct Sum {
+    uint64_t hash = 1469598103934665603ull;
+    size_t lines = 0, pairs = 0;
+
+    void add(const char *s, size_t len) {
+        for (size_t i = 0; i < len; i++) hash = (hash ^ (uint8_t)s[i]) * 1099511628211ull;
+        hash = (hash ^ 0xFF) * 1099511628211ull;
+    }
+};
+
+static std::string trimmed(const std::string &s) {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char)s[b])) b++;
+    while (e > b && isspace((unsigned char)s[e - 1])) e--;
+    return s.substr(b, e - b);
+}
+
+// while (file.available()) { String line = file.readStringUntil('\n'); line.trim(); ... }
+static void parseString(const std::string &text, Sum &sum) {
+    MemFile file{&text};
+    while (file.pos < text.size()) {
+        std::string line;
+        int c;
+        while ((c = file.readByte()) >= 0 && c != '\n') line += (char)c;
+        line = trimmed(line);
+        sum.lines++;
+        size_t colon = line.find(':');
+        if (line.empty() || line[0] == '#' || colon == std::string::npos) continue;
+        std::string key = trimmed(line.substr(0, colon));
+        std::string value = trimmed(line.substr(colon + 1));
+        sum.add(key.data(), key.size());
+        sum.add(value.data(), value.size());
+        sum.pairs++;
+    }
+}
+
+static void parseReader(const std::string &text, char *buffer, size_t size, Sum &sum) {
+    MemFile file{&text};
+    LineReader reader(readMem, &file, buffer, size);
+    TextSlice line, key, value;
+    while (reader.next(line)) {
+        line = line.trim();
+        sum.lines++;
+        if (line.empty() || line[0] == '#' || !line.split(':', key, value)) continue;
+        sum.add(key.data, key.len);
+        sum.add(value.data, value.len);
+        sum.pairs++;
+    }
+}
+
+static std::vector<std::string> corpus() {
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(BRUCE_SD_FILES "/infrared")) {
+        if (entry.is_regular_file() && entry.path().extension() == ".ir") paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+    std::vector<std::string> files;
+    for (const std::string &path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        files.push_back(ss.str());
+    }
+    return files;
+}
+
+static size_t longestLine(const std::vector<std::string> &files) {
+    size_t longest = 0;
+    for (const std::string &f : files) {
+        for (size_t pos = 0; pos < f.size();) {
+            size_t nl = f.find('\n', pos);
+            if (nl == std::string::npos) nl = f.size();
+            longest = std::max(longest, nl - pos);
+            pos = nl + 1;
+        }
+    }
+    return longest;
+}
+
+static void testCorpus(const std::vector<std::string> &files) {
+    size_t bytes = 0;
+    for (const std::string &f : files) bytes += f.size();
+    double mb = bytes * (double)ROUNDS / 1048576.0;
+    size_t longest = longestLine(files);
+    CHECK(files.size() > 100);
+
+    // the reader gets a buffer past the longest line here, so both see whole lines
+    std::vector<char> buffer(longest + 2);
+    Sum stringSum, readerSum;
+    size_t a0 = allocations;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (const std::string &f : files) parseString(f, stringSum);
+    double stringMs = nsSince(t0) / 1e6;
+    size_t stringAllocs = allocations - a0;
+
+    a0 = allocations;
+    t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (const std::string &f : files) parseReader(f, buffer.data(), buffer.size(), readerSum);
+    double readerMs = nsSince(t0) / 1e6;
+    size_t readerAllocs = allocations - a0;
+
+    // the IR menu's own tokenizer, fed the 512 byte chunks custom_ir.cpp reads
+    size_t signals = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (const std::string &f : files) {
+            IrIndex index;
+            IrIndexBuilder builder;
+            builder.begin(&index);
+            for (size_t done = 0; done < f.size(); done += 512)
+                builder.feed(f.data() + done, std::min<size_t>(512, f.size() - done));
+            CHECK(builder.finish());
+            signals += index.size();
+        }
+    }
+    double indexMs = nsSince(t0) / 1e6;
+
+    double lines = (double)stringSum.lines;
+    printf(
+        "%zu files, %.1f MB, %zu lines, longest %zu B: String %.0f MB/s %.2f allocations/line, "
+        "LineReader %.0f MB/s %.2f allocations/line, IrIndexBuilder %.0f MB/s\n",
+        files.size(), bytes / 1048576.0, stringSum.lines / ROUNDS, longest, mb / (stringMs / 1000),
+        stringAllocs / lines, mb / (readerMs / 1000), readerAllocs / lines, mb / (indexMs / 1000)
+    );
+    CHECK_EQ(readerSum.lines, stringSum.lines);
+    CHECK_EQ(readerSum.pairs, stringSum.pairs);
+    CHECK(readerSum.hash == stringSum.hash);
+    CHECK_EQ(readerAllocs, 0);
+    CHECK(readerMs < stringMs);
+    CHECK(signals > 0);
+}
+
+static bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+// A piece ends after a blank, or goes through a word when the buffer held no blank to cut at
+static bool cutAtBlank(const TextSlice &piece, size_t size) {
+    if (isBlank(piece[piece.len - 1])) return true;
+    return piece.len == size && std::find_if(piece.data + 1, piece.data + size, isBlank) == piece.data + size;
+}
+
+// Pieces of long lines give the lines back when put together, at any buffer size
+static void testPieces(const std::vector<std::string> &files) {
+    std::string all;
+    for (size_t i = 0; i < files.size(); i += 7) all += files[i];
+    all += "no newline at the end";
+    std::vector<std::string> want;
+    for (size_t pos = 0; pos <= all.size();) {
+        size_t nl = all.find('\n', pos);
+        if (nl == std::string::npos) nl = all.size();
+        std::string line = all.substr(pos, nl - pos);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        want.push_back(line);
+        pos = nl + 1;
+    }
+
+    int wrong = 0, badCuts = 0;
+    for (size_t size : {7, 8, 13, 32, 64, 100, 255, 256}) {
+        std::vector<char> buffer(size);
+        MemFile file{&all};
+        LineReader reader(readMem, &file, buffer.data(), size);
+        std::vector<std::string> got;
+        std::string line;
+        TextSlice piece;
+        while (reader.next(piece)) {
+            line.append(piece.data, piece.len);
+            if (reader.partial()) {
+                if (!cutAtBlank(piece, size)) badCuts++;
+                continue;
+            }
+            got.push_back(line);
+            line.clear();
+        }
+        if (got != want) wrong++;
+        CHECK_EQ(reader.lineNumber(), want.size());
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(badCuts, 0);
+}
+
+static void testSlices() {
+    TextSlice key, value;
+    const char *text = "  frequency : 38000 \t";
+    TextSlice line(text, strlen(text));
+    CHECK(line.split(':', key, value));
+    CHECK(key.equals("frequency"));
+    CHECK(key.equalsIgnoreCase("FREQUENCY"));
+    long n = 0;
+    CHECK(value.toLong(n) && n == 38000);
+    CHECK(!TextSlice("abc", 3).split('=', key, value));
+
+    unsigned long u = 0;
+    CHECK(TextSlice("0x1F", 4).toULong(u, 16) && u == 31);
+    CHECK(TextSlice("ff", 2).toULong(u, 16) && u == 255);
+    CHECK(!TextSlice("12a", 3).toULong(u));
+    CHECK(!TextSlice("", 0).toULong(u));
+    CHECK(TextSlice(" -42", 4).toLong(n) && n == -42);
+    float f = 0;
+    CHECK(TextSlice("0.33", 4).toFloat(f) && f > 0.329f && f < 0.331f);
+    CHECK(!TextSlice("0.33x", 5).toFloat(f));
+
+    char out[4];
+    CHECK_EQ(TextSlice("abcdef", 6).copy(out, sizeof(out)), 3);
+    CHECK(!strcmp(out, "abc"));
+    CHECK(TextSlice("abcdef", 6).sub(4, 10).equals("ef"));
+    CHECK(TextSlice("abcdef", 6).sub(9).empty());
+    CHECK_EQ(TextSlice("a:b:c", 5).indexOf(':', 2), 3);
+}
+
+int main() {
+    std::vector<std::string> files = corpus();
+    testCorpus(files);
+    testPieces(files);
+    testSlices();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,159 @@
+// drawOptions' retained rows on a host framebuffer. The HAL display backends all need a panel, so the
+// framebuffer here takes what drawOptions calls (setTextColor, setCursor, print) and paints every glyph
+// cell of LW*FM x 8*FM pixels, counting them. A 30-option menu is walked down, up, with options toggled
+// and a label changed, at two screen sizes; reports the pixels pushed per step against the full repaint
+// drawOptions did before, checks that an in-window move paints two rows, a toggle one and a scroll all,
+// and that the screen always equals a full repaint of the same state.
+
+#include "core/menu_rows.h"
+#include "host_test.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define LW 6
+#define FM 2
+
+class HostFramebuffer {
+public:
+    HostFramebuffer(int w, int h) : width(w), height(h), _px(w * h, 0) {}
+
+    void fillRect(int x, int y, int w, int h, uint16_t color) {
+        for (int j = y; j < y + h; j++)
+            for (int i = x; i < x + w; i++) put(i, j, color);
+    }
+    void setTextColor(uint16_t fg, uint16_t bg) {
+        _fg = fg;
+        _bg = bg;
+    }
+    void setCursor(int x, int y) {
+        _x = x;
+        _y = y;
+    }
+    // Text with a background fills the whole cell of every glyph
+    void print(const std::string &text) {
+        for (char c : text) {
+            for (int j = 0; j < 8 * FM; j++)
+                for (int i = 0; i < LW * FM; i++) {
+                    bool ink = c != ' ' && ((unsigned char)c * 31 + i / FM * 7 + j / FM * 3) % 5 == 0;
+                    put(_x + i, _y + j, ink ? _fg : _bg);
+                }
+            _x += LW * FM;
+        }
+    }
+    bool operator==(const HostFramebuffer &o) const { return _px == o._px; }
+
+    const int width, height;
+    size_t pushed = 0;
+
+private:
+    void put(int x, int y, uint16_t color) {
+        pushed++;
+        if (x >= 0 && y >= 0 && x < width && y < height) _px[y * width + x] = color;
+    }
+
+    std::vector<uint16_t> _px;
+    uint16_t _fg = 0, _bg = 0;
+    int _x = 0, _y = 0;
+};
+
+struct Option {
+    std::string label;
+    bool selected;
+};
+
+static const uint16_t FG = 0xFFFF, SEL = 0x07E0, BG = 0x0000;
+
+// drawOptions' geometry and row loop; rows holds what it retains, nullptr for the old full repaint
+static void drawOptions(
+    HostFramebuffer &tft, MenuRows *rows, int index, const std::vector<Option> &options, bool firstRender
+) {
+    const int maxMenuSize = tft.height / 25;
+    int menuSize = std::min<int>(options.size(), maxMenuSize);
+    int32_t optionsTopY = tft.height / 2 - menuSize * (FM * 8 + 4) / 2 - 5;
+    if (firstRender)
+        tft.fillRect(tft.width * 0.10, optionsTopY, tft.width * 0.8, (FM * 8 + 4) * menuSize + 10, BG);
+    bool all = !rows || rows->begin(menuSize, optionsTopY, FG, SEL, BG, firstRender);
+    const int rowX = tft.width * 0.10 + 5;
+    const int rowChars = (tft.width * 0.8 - 10) / (LW * FM) - 1;
+    int init = index >= maxMenuSize ? index - maxMenuSize + 1 : 0;
+    for (int row = 0; row < menuSize && init + row < (int)options.size(); row++) {
+        const Option &opt = options[init + row];
+        const bool cursor = init + row == index;
+        if (rows && !rows->update(row, opt.label.c_str(), cursor, opt.selected) && !all) continue;
+        tft.setTextColor(opt.selected ? SEL : FG, BG);
+        std::string text = cursor ? ">" : " ";
+        text += opt.label + "              ";
+        tft.setCursor(rowX, optionsTopY + 5 + row * (FM * 8 + 4) + 4);
+        tft.print(text.substr(0, rowChars));
+    }
+}
+
+static void testNavigation(int width, int height) {
+    std::vector<Option> options;
+    for (int i = 0; i < 30; i++) options.push_back({"Option " + std::to_string(i), false});
+    const int menuSize = std::min<int>(options.size(), height / 25);
+    const int rowChars = (width * 0.8 - 10) / (LW * FM) - 1;
+    const size_t rowPixels = (size_t)rowChars * LW * FM * 8 * FM;
+
+    HostFramebuffer screen(width, height), old(width, height);
+    MenuRows rows;
+    int index = 0;
+    drawOptions(screen, &rows, index, options, true);
+    drawOptions(old, nullptr, index, options, true);
+
+    // down to the end, back up, toggling every 7th option and renaming one on the way
+    std::vector<char> steps(29, 'd');
+    steps.insert(steps.end(), 29, 'u');
+    for (size_t i = 3; i < steps.size(); i += 7) steps.insert(steps.begin() + i, 's');
+    steps.insert(steps.begin() + 40, 'r');
+
+    size_t newPixels = 0, oldPixels = 0;
+    int wrongRows = 0, differing = 0;
+    for (char step : steps) {
+        int rowsExpected = 2;
+        int before = index >= menuSize ? index - menuSize + 1 : 0;
+        if (step == 'd') index++;
+        else if (step == 'u') index--;
+        else if (step == 's') options[index].selected = !options[index].selected;
+        else options[index].label += "*";
+        int after = index >= menuSize ? index - menuSize + 1 : 0;
+        if (step == 's' || step == 'r') rowsExpected = 1;
+        else if (before != after) rowsExpected = menuSize;
+
+        screen.pushed = old.pushed = 0;
+        drawOptions(screen, &rows, index, options, false);
+        drawOptions(old, nullptr, index, options, false);
+        newPixels += screen.pushed;
+        oldPixels += old.pushed;
+        if (screen.pushed != rowsExpected * rowPixels) wrongRows++;
+
+        HostFramebuffer full(width, height);
+        drawOptions(full, nullptr, index, options, true);
+        if (!(screen == full)) differing++;
+    }
+    printf(
+        "%dx%d, %d rows of %zu px: %zu steps, full repaint %.0f px/step, retained rows %.0f px/step\n", width,
+        height, menuSize, rowPixels, steps.size(), (double)oldPixels / steps.size(),
+        (double)newPixels / steps.size()
+    );
+    CHECK_EQ(wrongRows, 0);
+    CHECK_EQ(differing, 0);
+    CHECK(newPixels < oldPixels);
+
+    // after invalidate() (something drew over the list) everything is painted again
+    rows.invalidate();
+    screen.pushed = 0;
+    drawOptions(screen, &rows, index, options, false);
+    CHECK_EQ(screen.pushed, menuSize * rowPixels);
+    // as after a change of colors or geometry
+    CHECK(!rows.begin(menuSize, height / 2 - menuSize * (FM * 8 + 4) / 2 - 5, FG, SEL, BG, false));
+    CHECK(rows.begin(menuSize, height / 2 - menuSize * (FM * 8 + 4) / 2 - 5, FG, SEL, 0x1234, false));
+    CHECK(rows.begin(menuSize - 1, height / 2 - menuSize * (FM * 8 + 4) / 2 - 5, FG, SEL, 0x1234, false));
+}
+
+int main() {
+    testNavigation(240, 135);
+    testNavigation(320, 170);
+    return HOST_TEST_RESULT();
+}
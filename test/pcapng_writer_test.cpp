@@ -0,0 +1,225 @@
+// PcapngBatchWriter output read back by a pcapng reader in this file: block lengths at both ends, the
+// section header, one interface description per channel with its linktype and if_name, and every
+// enhanced packet with its interface, timestamp, radiotap channel frequency and flags, RSSI and
+// payload. Also reports the writing throughput and file size against the classic pcap path.
+
+#include "host_test.h"
+#include "modules/wifi/pcap_writer.h"
+#include <chrono>
+#include <map>
+#include <random>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static std::mt19937 rng(3);
+
+static size_t memSink(void *ctx, const uint8_t *p, size_t len) {
+    ((std::string *)ctx)->append((const char *)p, len);
+    return len;
+}
+
+static uint16_t le16(const uint8_t *p) { return p[0] | p[1] << 8; }
+static uint32_t le32(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+
+struct Interface {
+    uint16_t linktype;
+    uint32_t snaplen;
+    std::string name;
+};
+
+struct Packet {
+    uint32_t iface;
+    uint64_t ts;
+    uint16_t freq, chanFlags;
+    int8_t rssi;
+    uint32_t origLen;
+    std::string data;
+};
+
+struct Capture {
+    bool ok = true;
+    std::string application;
+    std::vector<Interface> interfaces;
+    std::vector<Packet> packets;
+};
+
+// Options of an SHB or IDB: code 4 / 2 are shb_userappl / if_name
+static bool readOptions(const uint8_t *p, const uint8_t *end, uint16_t want, std::string &value) {
+    while (p + 4 <= end) {
+        uint16_t code = le16(p), len = le16(p + 2);
+        if (code == 0) return true;
+        if (p + 4 + len > end) return false;
+        if (code == want) value.assign((const char *)p + 4, len);
+        p += 4 + ((len + 3) & ~3);
+    }
+    return false;
+}
+
+static Capture readPcapng(const std::string &file) {
+    Capture cap;
+    const uint8_t *p = (const uint8_t *)file.data(), *end = p + file.size();
+    bool first = true;
+    while (cap.ok && p < end) {
+        if (end - p < 12) {
+            cap.ok = false;
+            break;
+        }
+        uint32_t type = le32(p), total = le32(p + 4);
+        if (total < 12 || total % 4 || total > (size_t)(end - p) || le32(p + total - 4) != total) {
+            cap.ok = false;
+            break;
+        }
+        const uint8_t *body = p + 8, *bodyEnd = p + total - 4;
+        if (first && type != PCAPNG_BLOCK_SHB) cap.ok = false;
+        first = false;
+        if (type == PCAPNG_BLOCK_SHB) {
+            cap.ok &= le32(body) == PCAPNG_BYTE_ORDER_MAGIC && le16(body + 4) == 1 && le16(body + 6) == 0;
+            cap.ok &= readOptions(body + 16, bodyEnd, 4, cap.application);
+        } else if (type == PCAPNG_BLOCK_IDB) {
+            Interface iface{le16(body), le32(body + 4), ""};
+            cap.ok &= readOptions(body + 8, bodyEnd, 2, iface.name);
+            cap.interfaces.push_back(iface);
+        } else if (type == PCAPNG_BLOCK_EPB) {
+            Packet pkt;
+            pkt.iface = le32(body);
+            pkt.ts = (uint64_t)le32(body + 4) << 32 | le32(body + 8);
+            uint32_t capLen = le32(body + 12);
+            pkt.origLen = le32(body + 16);
+            const uint8_t *rt = body + 20;
+            // the interface has to be described before its first packet
+            cap.ok &= pkt.iface < cap.interfaces.size() && rt + capLen <= bodyEnd;
+            if (!cap.ok) break;
+            uint16_t rtLen = le16(rt + 2);
+            cap.ok &= rt[0] == 0 && rtLen == PCAPNG_RADIOTAP_LEN && rtLen <= capLen;
+            // present: flags, channel, dBm antenna signal, laid out with their alignment
+            cap.ok &= le32(rt + 4) == ((1u << 1) | (1u << 3) | (1u << 5));
+            pkt.freq = le16(rt + 10);
+            pkt.chanFlags = le16(rt + 12);
+            pkt.rssi = (int8_t)rt[14];
+            pkt.data.assign((const char *)rt + rtLen, capLen - rtLen);
+            pkt.origLen -= rtLen;
+            cap.packets.push_back(pkt);
+        } else {
+            cap.ok = false;
+        }
+        p += total;
+    }
+    return cap;
+}
+
+static void testRoundTrip() {
+    std::string file;
+    PcapngBatchWriter writer;
+    CHECK(writer.begin(memSink, &file, 4096));
+    CHECK(writer.writeSectionHeader("Bruce sniffer"));
+
+    static const uint8_t channels[] = {1, 6, 11, 13, 14, 36, 149, 165};
+    std::vector<Packet> sent;
+    std::map<uint8_t, uint32_t> ifaceOf;
+    uint64_t ts = 1700000000ull * 1000000;
+    for (int i = 0; i < 3000; i++) {
+        uint8_t channel = channels[rng() % sizeof(channels)];
+        int8_t rssi = -(int8_t)(20 + rng() % 80);
+        uint32_t len = 1 + rng() % 1600;
+        std::string data(len, 0);
+        for (char &c : data) c = rng();
+        uint32_t orig = len + (rng() % 4 == 0 ? rng() % 100 : 0);
+        ts += rng() % 5000;
+        CHECK(writer.writePacket(ts, channel, rssi, orig, (const uint8_t *)data.data(), len));
+        if (!ifaceOf.count(channel)) ifaceOf[channel] = ifaceOf.size();
+        sent.push_back({ifaceOf[channel], ts, wifiChannelToFreq(channel), 0, rssi, orig, data});
+    }
+    writer.end();
+    CHECK_EQ(writer.records(), sent.size());
+    CHECK_EQ(writer.interfaceCount(), ifaceOf.size());
+
+    Capture cap = readPcapng(file);
+    CHECK(cap.ok);
+    CHECK(cap.application == "Bruce sniffer");
+    CHECK_EQ(cap.interfaces.size(), ifaceOf.size());
+    for (const auto &it : ifaceOf) {
+        const Interface &iface = cap.interfaces[it.second];
+        CHECK_EQ(iface.linktype, PCAP_LINKTYPE_RADIOTAP);
+        CHECK_EQ(iface.snaplen, PCAP_DEFAULT_SNAPLEN + PCAPNG_RADIOTAP_LEN);
+        CHECK(iface.name == "wlan-ch" + std::to_string(it.first));
+    }
+    CHECK_EQ(cap.packets.size(), sent.size());
+    int bad = 0;
+    for (size_t i = 0; i < sent.size() && i < cap.packets.size(); i++) {
+        const Packet &a = sent[i], &b = cap.packets[i];
+        uint16_t band = a.freq < 3000 ? 0x0080 : 0x0100;
+        if (a.iface != b.iface || a.ts != b.ts || a.freq != b.freq || b.chanFlags != band ||
+            a.rssi != b.rssi || a.origLen != b.origLen || a.data != b.data)
+            bad++;
+    }
+    CHECK_EQ(bad, 0);
+
+    CHECK_EQ(wifiChannelToFreq(1), 2412);
+    CHECK_EQ(wifiChannelToFreq(13), 2472);
+    CHECK_EQ(wifiChannelToFreq(14), 2484);
+    CHECK_EQ(wifiChannelToFreq(36), 5180);
+    CHECK_EQ(wifiChannelToFreq(165), 5825);
+}
+
+// Past PCAPNG_MAX_INTERFACES channels a packet is refused and the file stays readable
+static void testInterfaceLimit() {
+    std::string file;
+    PcapngBatchWriter writer;
+    CHECK(writer.begin(memSink, &file, 1024));
+    CHECK(writer.writeSectionHeader());
+    uint8_t frame[24] = {0x80};
+    for (int ch = 1; ch <= PCAPNG_MAX_INTERFACES; ch++)
+        CHECK(writer.writePacket(ch, ch, -50, sizeof(frame), frame, sizeof(frame)));
+    CHECK(!writer.writePacket(0, PCAPNG_MAX_INTERFACES + 1, -50, sizeof(frame), frame, sizeof(frame)));
+    CHECK(writer.writePacket(0, 1, -50, sizeof(frame), frame, sizeof(frame)));
+    writer.end();
+    Capture cap = readPcapng(file);
+    CHECK(cap.ok);
+    CHECK(cap.application.empty());
+    CHECK_EQ(cap.interfaces.size(), PCAPNG_MAX_INTERFACES);
+    CHECK_EQ(cap.packets.size(), PCAPNG_MAX_INTERFACES + 1);
+}
+
+static void testThroughput() {
+    const int frames = 200000;
+    std::vector<uint32_t> lens(frames);
+    for (uint32_t &len : lens) len = rng() % 10 < 6 ? 200 + rng() % 120 : 100 + rng() % 1400;
+    std::vector<uint8_t> payload(PCAP_DEFAULT_SNAPLEN, 0x5A);
+
+    std::string pcap, pcapng;
+    pcap.reserve(200 << 20);
+    pcapng.reserve(200 << 20);
+    PcapBatchWriter classic;
+    classic.begin(memSink, &pcap, 32 * 1024);
+    classic.writeHeader();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) classic.writeRecord(i, 0, lens[i], payload.data(), lens[i]);
+    classic.end();
+    double pcapS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    PcapngBatchWriter ng;
+    ng.begin(memSink, &pcapng, 32 * 1024);
+    ng.writeSectionHeader();
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) ng.writePacket(i, 1 + i % 13, -60, lens[i], payload.data(), lens[i]);
+    ng.end();
+    double ngS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    printf(
+        "pcap:   %.0f frames/s, %.0f MB/s, %zu bytes\n"
+        "pcapng: %.0f frames/s, %.0f MB/s, %zu bytes (%+.1f bytes per frame)\n",
+        frames / pcapS, pcap.size() / pcapS / 1e6, pcap.size(), frames / ngS, pcapng.size() / ngS / 1e6,
+        pcapng.size(), (double)((long)pcapng.size() - (long)pcap.size()) / frames
+    );
+    CHECK_EQ(classic.records(), frames);
+    CHECK_EQ(ng.records(), frames);
+    CHECK_EQ(readPcapng(pcapng).packets.size(), frames);
+}
+
+int main() {
+    testRoundTrip();
+    testInterfaceLimit();
+    testThroughput();
+    return HOST_TEST_RESULT();
+}
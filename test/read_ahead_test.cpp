@@ -0,0 +1,212 @@
+// ReadAheadBuffer with its filler on a thread, in front of a fake card: 1 MB/s, held by another task
+// for 350 ms every second, and now and then a read that stalls for up to 150 ms. A player pulls 1 KB
+// at a time on the schedule of the bitrate and counts reads more than 20 ms late, what the I2S DMA
+// buffers cover. Checks that the PSRAM ring plays every target bitrate and the heap ring the MP3 ones
+// with no underrun, every byte as in the file, against reading the card straight from the player.
+// The runs play at once for a few seconds of real time. Also checks seeks, the end of the file and
+// stop() with a reader waiting.
+
+#include "host_test.h"
+#include "modules/others/read_ahead_buffer.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define CARD_BYTES_PER_MS 1024   // 1 MB/s of an SPI card
+#define BUSY_PERIOD_MS 1000      // another task takes the card this often,
+#define BUSY_MS 350              // for this long
+#define SPIKE_PERCENT 5          // reads stalling on top of that,
+#define SPIKE_MAX_MS 150         // for up to this long
+#define PLAY_MS 3000
+#define LATE_MS 20
+#define READ_SIZE 1024           // what the decoders ask for
+#define CHUNK (8 * 1024)         // AUDIO_BUFFER_CHUNK
+#define PSRAM_RING (256 * 1024)  // AUDIO_BUFFER_PSRAM
+#define HEAP_RING (32 * 1024)    // AUDIO_BUFFER_HEAP
+
+typedef std::chrono::steady_clock Clock;
+
+static uint8_t byteAt(uint32_t offset) { return (offset * 2654435761u) >> 24; }
+
+class FakeCard {
+public:
+    FakeCard(uint32_t seed, Clock::time_point start) : _rng(seed), _start(start) {}
+
+    static size_t read(void *ctx, uint32_t offset, uint8_t *buffer, size_t len) {
+        return static_cast<FakeCard *>(ctx)->readAt(offset, buffer, len);
+    }
+
+    size_t readAt(uint32_t offset, uint8_t *buffer, size_t len) {
+        using namespace std::chrono;
+        long long now = duration_cast<milliseconds>(Clock::now() - _start).count();
+        long long phase = now % BUSY_PERIOD_MS;
+        if (phase >= BUSY_PERIOD_MS - BUSY_MS)
+            std::this_thread::sleep_for(milliseconds(BUSY_PERIOD_MS - phase));
+        long long us = len * 1000 / CARD_BYTES_PER_MS;
+        if ((int)(_rng() % 100) < SPIKE_PERCENT) us += (_rng() % SPIKE_MAX_MS) * 1000;
+        std::this_thread::sleep_for(microseconds(us));
+        for (size_t i = 0; i < len; i++) buffer[i] = byteAt(offset + i);
+        return len;
+    }
+
+private:
+    std::mt19937 _rng;
+    Clock::time_point _start;
+};
+
+struct Run {
+    const char *name;
+    uint32_t kbps;
+    size_t ring; // 0 reads the card from the player
+    int late = 0, wrong = 0;
+    uint32_t maxLateMs = 0;
+    ReadAheadBuffer::Stats stats = {};
+};
+
+static void play(Run &run, uint32_t seed) {
+    Clock::time_point start = Clock::now();
+    FakeCard card(seed, start);
+    const uint32_t bytesPerS = run.kbps * 1000 / 8;
+    const uint32_t total = (uint64_t)bytesPerS * PLAY_MS / 1000;
+    std::vector<uint8_t> ring(run.ring);
+    ReadAheadBuffer buffer(FakeCard::read, &card, total, ring.data(), run.ring, CHUNK);
+    std::thread filler;
+    if (run.ring) filler = std::thread([&buffer]() { buffer.runFiller(); });
+
+    uint8_t data[READ_SIZE];
+    for (uint32_t pos = 0; pos < total; pos += READ_SIZE) {
+        Clock::time_point due = start + std::chrono::microseconds((uint64_t)pos * 1000000 / bytesPerS);
+        std::this_thread::sleep_until(due);
+        size_t want = std::min<size_t>(READ_SIZE, total - pos);
+        size_t got = run.ring ? buffer.read(data, want, 2000) : card.readAt(pos, data, want);
+        uint32_t lateMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - due).count();
+        if (lateMs > LATE_MS) run.late++;
+        run.maxLateMs = std::max(run.maxLateMs, lateMs);
+        if (got != want) run.wrong++;
+        for (size_t i = 0; i < got; i++) run.wrong += data[i] != byteAt(pos + i);
+    }
+    if (run.ring) {
+        uint8_t extra;
+        if (buffer.read(&extra, 1, 100)) run.wrong++; // the end of the file
+        buffer.stop();
+        filler.join();
+        run.stats = buffer.stats();
+    }
+}
+
+static void testPlayback() {
+    std::vector<Run> runs = {
+        {"card", 128, 0},
+        {"card", 320, 0},
+        {"card", 1411, 0},
+        {"PSRAM ring", 128, PSRAM_RING},
+        {"PSRAM ring", 320, PSRAM_RING},
+        {"PSRAM ring", 1411, PSRAM_RING},
+        {"heap ring", 128, HEAP_RING},
+        {"heap ring", 320, HEAP_RING},
+        {"heap ring", 1411, HEAP_RING},
+    };
+    std::vector<std::thread> players;
+    for (size_t i = 0; i < runs.size(); i++) players.emplace_back(play, std::ref(runs[i]), 17 + i);
+    for (std::thread &t : players) t.join();
+
+    for (const Run &r : runs) {
+        if (r.ring) {
+            printf(
+                "%4u kbps, %3zu KB %-10s: %3d late reads (worst %4u ms), %2u underruns (%4u ms), %3u card "
+                "reads, lowest %3zu KB\n",
+                r.kbps, r.ring / 1024, r.name, r.late, r.maxLateMs, r.stats.underruns, r.stats.stalledMs,
+                r.stats.fills, r.stats.lowest / 1024
+            );
+        } else {
+            printf("%4u kbps, %-17s: %3d late reads (worst %4u ms)\n", r.kbps, r.name, r.late, r.maxLateMs);
+        }
+        CHECK_EQ(r.wrong, 0);
+        // the targets: the PSRAM ring for all of them, the heap ring for MP3 bitrates
+        if (r.ring == PSRAM_RING || (r.ring == HEAP_RING && r.kbps <= 320)) {
+            CHECK_EQ(r.stats.underruns, 0);
+            CHECK_EQ(r.late, 0);
+        }
+    }
+    // the card alone cannot keep up through the busy spells
+    CHECK(runs[0].late > 0);
+}
+
+static size_t instant(void *, uint32_t offset, uint8_t *buffer, size_t len) {
+    for (size_t i = 0; i < len; i++) buffer[i] = byteAt(offset + i);
+    return len;
+}
+
+// A source that gives nothing past a point, as a card read failing
+static size_t shortFile(void *, uint32_t offset, uint8_t *buffer, size_t len) {
+    if (offset >= 5000) return 0;
+    len = std::min<size_t>(len, 5000 - offset);
+    for (size_t i = 0; i < len; i++) buffer[i] = byteAt(offset + i);
+    return len;
+}
+
+static bool same(const uint8_t *data, size_t len, uint32_t offset) {
+    for (size_t i = 0; i < len; i++)
+        if (data[i] != byteAt(offset + i)) return false;
+    return true;
+}
+
+static void testSeeks() {
+    std::vector<uint8_t> ring(4096);
+    ReadAheadBuffer buffer(instant, nullptr, 100000, ring.data(), ring.size(), 1024);
+    std::thread filler([&buffer]() { buffer.runFiller(); });
+    uint8_t data[512];
+    CHECK_EQ(buffer.read(data, 512, 1000), 512);
+    CHECK(same(data, 512, 0));
+
+    // inside what is buffered: skipped over, nothing read again
+    while (buffer.stats().level < 2048) std::this_thread::yield();
+    uint32_t fills = buffer.stats().fills;
+    CHECK(buffer.seek(1500));
+    CHECK_EQ(buffer.position(), 1500);
+    CHECK_EQ(buffer.read(data, 512, 1000), 512);
+    CHECK(same(data, 512, 1500));
+    CHECK(buffer.stats().fills - fills <= 2);
+
+    // elsewhere, back included: refilled from there
+    for (uint32_t to : {90000u, 10u, 99990u}) {
+        CHECK(buffer.seek(to));
+        size_t got = buffer.read(data, 512, 1000);
+        CHECK_EQ(got, std::min<size_t>(512, 100000 - to));
+        CHECK(same(data, got, to));
+    }
+    CHECK_EQ(buffer.read(data, 512, 100), 0);
+    CHECK(!buffer.seek(100001));
+    buffer.stop();
+    filler.join();
+
+    // the source giving out early ends the file there
+    ReadAheadBuffer cut(shortFile, nullptr, 8000, ring.data(), ring.size(), 1024);
+    std::thread cutFiller([&cut]() { cut.runFiller(); });
+    size_t total = 0, got;
+    while ((got = cut.read(data, sizeof(data), 1000)) > 0) {
+        CHECK(same(data, got, total));
+        total += got;
+    }
+    CHECK_EQ(total, 5000);
+    cut.stop();
+    cutFiller.join();
+
+    // stop() lets go of a reader waiting for data that never comes, no filler runs here
+    ReadAheadBuffer stuck(instant, nullptr, 1000, ring.data(), ring.size(), 1024);
+    std::thread reader([&]() { CHECK_EQ(stuck.read(data, 16, 60000), 0); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto t0 = Clock::now();
+    stuck.stop();
+    reader.join();
+    CHECK(Clock::now() - t0 < std::chrono::seconds(1));
+}
+
+int main() {
+    testSeeks();
+    testPlayback();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,184 @@
+// RfPulseDecoder against frames encoded from the protocol descriptions, as a receiver would see them:
+// consecutive pulses of the same level merged, each remote's clock off by a few percent and every
+// edge jittered. Also reports the cost per pulse with all the default protocols running.
+
+#include "host_test.h"
+#include "modules/rf/protocols/Ansonic.h"
+#include "modules/rf/protocols/Came.h"
+#include "modules/rf/protocols/Chamberlain.h"
+#include "modules/rf/protocols/Holtek.h"
+#include "modules/rf/protocols/Linear.h"
+#include "modules/rf/protocols/NiceFlo.h"
+#include "modules/rf/rf_decoder.h"
+#include <chrono>
+#include <random>
+#include <string.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+static const int FRAMES_PER_PROTOCOL = 200;
+// Worst case on a desktop is a few hundred, far from the few thousand an ESP32 has per pulse
+static const double MAX_CYCLES_PER_PULSE = 2000;
+
+struct Remote {
+    const char *name;
+    c_rf_protocol *proto;
+};
+
+class Capture {
+public:
+    Capture(std::mt19937 &rng, double clock, int jitter) : _rng(rng), _clock(clock), _jitter(jitter) {}
+
+    // Sub-50us placeholders never show up in a capture, pulses of the same level come out as one
+    void push(int duration) {
+        if (duration > -50 && duration < 50) return;
+        int width = (int)((duration < 0 ? -duration : duration) * _clock);
+        width += (int)(_rng() % (2 * _jitter + 1)) - _jitter;
+        int d = duration < 0 ? -width : width;
+        if (!pulses.empty() && (pulses.back() > 0) == (d > 0)) pulses.back() += d;
+        else pulses.push_back(d);
+    }
+
+    void frame(c_rf_protocol &proto, uint32_t code, int bits) {
+        for (int d : proto.pilot_period) push(d);
+        for (int b = bits - 1; b >= 0; b--) {
+            for (int d : proto.transposition_table[(code >> b) & 1 ? '1' : '0']) push(d);
+        }
+        for (int d : proto.stop_bit) push(d);
+    }
+
+    std::vector<int32_t> pulses;
+
+private:
+    std::mt19937 &_rng;
+    double _clock;
+    int _jitter;
+};
+
+static void testRoundTrip(Remote *remotes, size_t count) {
+    std::mt19937 rng(4);
+    RfPulseDecoder decoder;
+    decoder.addDefaultProtocols();
+    CHECK_EQ(decoder.protocolCount(), count);
+
+    for (size_t p = 0; p < count; p++) {
+        int ok = 0;
+        for (int i = 0; i < FRAMES_PER_PROTOCOL; i++) {
+            uint32_t code = rng() & 0xFFF;
+            double clock = 0.92 + (rng() % 161) / 1000.0; // +-8%
+            Capture capture(rng, clock, 40);
+            // silence of any length, or none, before the first frame
+            if (i % 3) capture.push(-(int)(1000 + rng() % 60000));
+            for (int repeat = 0; repeat < 3; repeat++) capture.frame(*remotes[p].proto, code, 12);
+            capture.push(-30000);
+
+            RfDecodeResult result;
+            bool found = decoder.decode(capture.pulses.data(), capture.pulses.size(), result);
+            if (found && strcmp(result.name, remotes[p].name) == 0 && result.code == code &&
+                result.bits == 12) {
+                ok++;
+            } else if (found) {
+                printf(
+                    "  %s %03x decoded as %s %03llx\n",
+                    remotes[p].name,
+                    (unsigned)code,
+                    result.name,
+                    (unsigned long long)result.code
+                );
+            } else {
+                printf("  %s %03x not decoded\n", remotes[p].name, (unsigned)code);
+            }
+        }
+        printf("%-12s %d/%d\n", remotes[p].name, ok, FRAMES_PER_PROTOCOL);
+        CHECK_EQ(ok, FRAMES_PER_PROTOCOL);
+    }
+}
+
+// Noise before a frame must not leave a machine half way through a code
+static void testNoiseThenFrame(Remote *remotes, size_t count) {
+    std::mt19937 rng(5);
+    RfPulseDecoder decoder;
+    decoder.addDefaultProtocols();
+    int wrong = 0;
+    for (size_t p = 0; p < count; p++) {
+        for (int i = 0; i < 50; i++) {
+            uint32_t code = rng() & 0xFFF;
+            Capture capture(rng, 1.0, 30);
+            for (int n = 0; n < 40; n++) capture.push((n & 1 ? 1 : -1) * (int)(100 + rng() % 2000));
+            for (int repeat = 0; repeat < 2; repeat++) capture.frame(*remotes[p].proto, code, 12);
+            capture.push(-30000);
+
+            RfDecodeResult result;
+            decoder.reset();
+            bool right = false;
+            for (int32_t d : capture.pulses) {
+                if (!decoder.feed(d, result)) continue;
+                // a code out of the noise is possible, the frame must still come out right
+                right = strcmp(result.name, remotes[p].name) == 0 && result.code == code;
+                if (right) break;
+            }
+            if (!right) wrong++;
+        }
+    }
+    printf("noise then frame: %d wrong\n", wrong);
+    CHECK_EQ(wrong, 0);
+}
+
+static void testCostPerPulse(Remote *remotes, size_t count) {
+    std::mt19937 rng(6);
+    Capture capture(rng, 1.0, 40);
+    while (capture.pulses.size() < 200000) {
+        Remote &remote = remotes[rng() % count];
+        capture.frame(*remote.proto, rng() & 0xFFF, 12);
+        capture.push(-20000);
+    }
+
+    RfPulseDecoder decoder;
+    decoder.addDefaultProtocols();
+    RfDecodeResult result;
+    size_t decoded = 0;
+    auto start = std::chrono::steady_clock::now();
+#ifdef HAVE_RDTSC
+    uint64_t cycles = __rdtsc();
+#endif
+    for (int32_t d : capture.pulses) decoded += decoder.feed(d, result);
+#ifdef HAVE_RDTSC
+    cycles = __rdtsc() - cycles;
+#endif
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    size_t n = capture.pulses.size();
+    printf("%zu pulses, %zu codes: %.1f ns per pulse", n, decoded, ns / n);
+#ifdef HAVE_RDTSC
+    printf(", %.0f cycles per pulse", (double)cycles / n);
+    CHECK((double)cycles / n < MAX_CYCLES_PER_PULSE);
+#endif
+    printf("\n");
+    CHECK(decoded > 0);
+}
+
+int main() {
+    protocol_came came;
+    protocol_nice_flo niceFlo;
+    protocol_ansonic ansonic;
+    protocol_holtek holtek;
+    protocol_chamberlain chamberlain;
+    protocol_linear linear;
+    Remote remotes[] = {
+        {"Came",        &came       },
+        {"Nice Flo",    &niceFlo    },
+        {"Ansonic",     &ansonic    },
+        {"Holtek",      &holtek     },
+        {"Chamberlain", &chamberlain},
+        {"Linear",      &linear     },
+    };
+    size_t count = sizeof(remotes) / sizeof(remotes[0]);
+
+    testRoundTrip(remotes, count);
+    testNoiseThenFrame(remotes, count);
+    testCostPerPulse(remotes, count);
+    return HOST_TEST_RESULT();
+}
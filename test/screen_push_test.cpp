@@ -0,0 +1,231 @@
+// ScreenPushHub against a fake socket: each viewer has a send queue of SOCKET_QUEUE messages drained at
+// a set byte rate, the log is a trace of menus being browsed (bursts of records, the clock every second,
+// a new screen now and then). Reports per link speed the latency from a record being logged to the
+// viewer having it, and the bytes/s sent, against polling /getscreen for the whole log at the same
+// interval. Checks that bursts are coalesced, nothing is sent into a full queue, a stalled viewer gets
+// one full screen when it drains and catches up, and viewers past SCREEN_PUSH_MAX_CLIENTS are closed.
+
+#include "core/tftLogger/screen_stream.h"
+#include "core/wifi/screen_push.h"
+#include "host_test.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+#define SOCKET_QUEUE 8       // messages the socket queues per client
+#define FRAME_OVERHEAD 6     // WebSocket header of a binary frame
+#define SCREEN_INFO_BYTES 8  // the SCREEN_INFO record a full screen starts with
+#define LOG_RECORDS 64       // what the log holds, MAX_LOG_ENTRIES
+
+static std::mt19937 rng(11);
+
+struct LoggedRecord {
+    uint32_t seq, at;
+    size_t bytes; // encoded
+};
+
+class FakeSocket : public ScreenPushLink {
+public:
+    struct Message {
+        uint32_t seq;
+        size_t bytes, left;
+    };
+    struct Client {
+        bool open = true;
+        std::deque<Message> queue;
+        uint32_t seen = 0; // seq the viewer has drawn up to
+        size_t bytes = 0, messages = 0, fulls = 0;
+    };
+
+    bool connected(uint32_t client) override { return clients.count(client) && clients[client].open; }
+    bool canSend(uint32_t client) override { return clients[client].queue.size() < SOCKET_QUEUE; }
+    void send(uint32_t client, const uint8_t *data, size_t len) override {
+        Client &c = clients[client];
+        if (c.queue.size() >= SOCKET_QUEUE) overflows++;
+        if (data[2] & SCREEN_STREAM_FULL) c.fulls++;
+        c.queue.push_back({screenStreamSeq(data), len + FRAME_OVERHEAD, len + FRAME_OVERHEAD});
+        c.bytes += len + FRAME_OVERHEAD;
+        c.messages++;
+    }
+    void close(uint32_t client) override { clients[client].open = false; }
+    uint32_t logSeq() override { return seq; }
+    size_t logSince(uint32_t since, uint8_t *buf, size_t cap) override {
+        bool full = since == 0 || since < resyncSeq || since < evictedSeq;
+        size_t size = SCREEN_STREAM_HEADER + (full ? SCREEN_INFO_BYTES : 0);
+        for (const LoggedRecord &r : log)
+            if (full || r.seq > since) size += r.bytes;
+        if (size > cap) size = cap; // the trace stays well below
+        screenStreamHeader(buf, full ? SCREEN_STREAM_FULL : 0, seq);
+        return size;
+    }
+    uint32_t millis() override { return now; }
+
+    void record(size_t bytes) {
+        if (log.size() == LOG_RECORDS) {
+            evictedSeq = log.front().seq;
+            log.pop_front();
+        }
+        log.push_back({++seq, now, bytes});
+        all.push_back(log.back());
+    }
+    void clearScreen() {
+        log.clear();
+        resyncSeq = ++seq;
+    }
+
+    // One millisecond of the link: bytesPerMs shared by the viewers, a drained message is drawn
+    void drain(double bytesPerMs, std::vector<double> &latencies) {
+        for (auto &it : clients) {
+            Client &c = it.second;
+            budget[it.first] += bytesPerMs / clients.size();
+            while (!c.queue.empty() && budget[it.first] >= 1) {
+                Message &m = c.queue.front();
+                size_t n = std::min(m.left, (size_t)budget[it.first]);
+                m.left -= n;
+                budget[it.first] -= n;
+                if (m.left) break;
+                for (const LoggedRecord &r : all)
+                    if (r.seq > c.seen && r.seq <= m.seq) latencies.push_back(now - r.at);
+                c.seen = std::max(c.seen, m.seq);
+                c.queue.pop_front();
+            }
+            if (c.queue.empty()) budget[it.first] = std::min(budget[it.first], bytesPerMs);
+        }
+    }
+
+    uint32_t now = 0, seq = 0, resyncSeq = 0, evictedSeq = 0;
+    std::deque<LoggedRecord> log;
+    std::vector<LoggedRecord> all;
+    std::map<uint32_t, Client> clients;
+    std::map<uint32_t, double> budget;
+    int overflows = 0;
+};
+
+// A menu being browsed: a burst of rows on every key press, the clock every second, a new screen
+// every 20 s. stall is a span [from, to) in ms during which the link carries nothing.
+struct Result {
+    double avgMs, maxMs, bytesPerS, pollBytesPerS;
+    size_t messages, records, resyncs, fulls;
+    bool caughtUp;
+};
+
+static Result run(double bytesPerS, uint32_t seconds, uint32_t stallFrom = 0, uint32_t stallTo = 0) {
+    FakeSocket socket;
+    ScreenPushHub hub(socket);
+    std::vector<uint8_t> buf(LOG_RECORDS * 128);
+    std::vector<double> latencies;
+    socket.clients[1];
+    hub.connect(1);
+    uint32_t nextKey = 0, pollBytes = 0;
+    int burst = 0;
+    for (socket.now = 0; socket.now < seconds * 1000; socket.now++) {
+        uint32_t t = socket.now;
+        if (t % 20000 == 0) socket.clearScreen();
+        if (t % 1000 == 0) socket.record(14);
+        if (t >= nextKey) {
+            burst = 5 + rng() % 12;
+            nextKey = t + 200 + rng() % 600;
+        }
+        if (burst > 0 && rng() % 2) {
+            socket.record(12 + rng() % 10);
+            burst--;
+        }
+        if (t % SCREEN_PUSH_TICK_MS == 0) hub.tick(buf.data(), buf.size());
+        // the page polling /getscreen for the whole log at the frame interval instead, 200 B of HTTP
+        if (t % SCREEN_PUSH_FRAME_MS == 0) pollBytes += socket.logSince(0, buf.data(), buf.size()) + 200;
+        bool stalled = t >= stallFrom && t < stallTo;
+        socket.drain(stalled ? 0 : bytesPerS / 1000, latencies);
+    }
+    // settles with the log quiet
+    for (int i = 0; i < 2000; i++, socket.now++) {
+        if (socket.now % SCREEN_PUSH_TICK_MS == 0) hub.tick(buf.data(), buf.size());
+        socket.drain(bytesPerS / 1000, latencies);
+    }
+
+    const FakeSocket::Client &c = socket.clients[1];
+    Result r = {};
+    for (double l : latencies) {
+        r.avgMs += l;
+        r.maxMs = std::max(r.maxMs, l);
+    }
+    r.avgMs /= latencies.size();
+    r.bytesPerS = (double)c.bytes / seconds;
+    r.pollBytesPerS = (double)pollBytes / seconds;
+    r.messages = c.messages;
+    r.records = socket.all.size();
+    r.resyncs = hub.viewer(1)->resyncs();
+    r.fulls = c.fulls;
+    r.caughtUp = c.seen == socket.seq && c.queue.empty();
+    CHECK_EQ(socket.overflows, 0);
+    return r;
+}
+
+static void testLinks() {
+    for (double rate : {4000.0, 16000.0, 100000.0}) {
+        Result r = run(rate, 60);
+        printf(
+            "%6.0f B/s link: latency %4.1f ms avg %4.0f ms max, %4.0f B/s in %4zu messages for %zu records; "
+            "polling %5.0f B/s\n",
+            rate, r.avgMs, r.maxMs, r.bytesPerS, r.messages, r.records, r.pollBytesPerS
+        );
+        CHECK(r.caughtUp);
+        CHECK_EQ(r.resyncs, 0);
+        // one full screen per new screen, the first included
+        CHECK_EQ(r.fulls, 3);
+        // bursts coalesced: far fewer messages than records
+        CHECK(r.messages * 3 < r.records);
+        if (rate >= 16000) {
+            CHECK(r.maxMs <= SCREEN_PUSH_FRAME_MS + SCREEN_PUSH_TICK_MS + 20);
+            CHECK(r.bytesPerS * 5 < r.pollBytesPerS);
+        }
+    }
+}
+
+static void testStall() {
+    Result r = run(16000, 60, 30000, 36000);
+    printf(
+        "6 s stall: latency %4.1f ms avg %4.0f ms max, %zu resync, %zu full screens\n", r.avgMs, r.maxMs,
+        r.resyncs, r.fulls
+    );
+    CHECK_EQ(r.resyncs, 1);
+    CHECK_EQ(r.fulls, 4);
+    CHECK(r.caughtUp);
+    CHECK(r.maxMs < 6000 + 200);
+}
+
+static void testSlots() {
+    FakeSocket socket;
+    ScreenPushHub hub(socket);
+    for (uint32_t id = 1; id <= SCREEN_PUSH_MAX_CLIENTS + 1; id++) {
+        socket.clients[id];
+        hub.connect(id);
+    }
+    CHECK_EQ(hub.viewers(), SCREEN_PUSH_MAX_CLIENTS);
+    CHECK(!socket.clients[SCREEN_PUSH_MAX_CLIENTS + 1].open);
+    // a dropped viewer frees its slot, one whose socket went away too
+    hub.disconnect(2);
+    socket.clients[3].open = false;
+    std::vector<uint8_t> buf(1024);
+    socket.record(20);
+    hub.tick(buf.data(), buf.size());
+    CHECK_EQ(hub.viewers(), SCREEN_PUSH_MAX_CLIENTS - 2);
+    CHECK(hub.viewer(2) == nullptr);
+    // each new viewer is drawn in full right away
+    CHECK_EQ(socket.clients[1].fulls, 1);
+    CHECK_EQ(socket.clients[4].fulls, 1);
+    CHECK_EQ(socket.clients[3].messages, 0);
+    socket.clients[7];
+    hub.connect(7);
+    hub.tick(buf.data(), buf.size());
+    CHECK_EQ(socket.clients[7].fulls, 1);
+    CHECK_EQ(socket.clients[1].messages, 1);
+}
+
+int main() {
+    testSlots();
+    testLinks();
+    testStall();
+    return HOST_TEST_RESULT();
+}
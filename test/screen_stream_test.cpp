@@ -0,0 +1,496 @@
+// The WebUI screen mirror replayed from a draw trace of menus being browsed: status bar, theme icon,
+// option rows, a cursor moving and a new menu every so often. tft_logger derives from the panel driver,
+// so its ring is mirrored here twice around the real screen_stream code: as it was (duplicates found
+// by comparing every entry, /getscreen sending the whole log) and as it is (ScreenLogIndex, seq numbers
+// and /getscreen?since=N). Both rings must keep the same records, and every response, decoded the way
+// index.js does it, must give back the legacy records the client is missing. Reports the bytes sent
+// and the CPU time of logging plus answering, per frame.
+
+#include "core/tftLogger/screen_stream.h"
+#include "host_test.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// As include/tftLogger.h on a board with PSRAM
+#define MAX_LOG_ENTRIES 64
+#define MAX_LOG_SIZE 128
+#define LOG_PACKET_HEADER 0xAA
+#define FILLSCREEN 0
+#define FILLRECT 2
+#define DRAWROUNDRECT 3
+#define DRAWSTRING 16
+#define DRAWIMAGE 18
+#define SCREEN_INFO 99
+#define SCREEN_W 240
+#define SCREEN_H 135
+#define SCREEN_ROT 1
+
+static std::mt19937 rng(10);
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+typedef std::vector<uint8_t> Record;
+
+static void put16(Record &r, int v) {
+    r.push_back((v >> 8) & 0xFF);
+    r.push_back(v & 0xFF);
+}
+
+// checkAndLog()
+static Record shape(uint8_t fn, std::initializer_list<int> args) {
+    Record r = {LOG_PACKET_HEADER, 0, fn};
+    for (int v : args) put16(r, v);
+    r[1] = r.size();
+    return r;
+}
+
+// log_drawString()
+static Record text(uint8_t fn, int x, int y, int size, int fg, int bg, const std::string &s) {
+    Record r = shape(fn, {x, y, size, fg, bg});
+    r.insert(r.end(), s.begin(), s.begin() + std::min(s.size(), MAX_LOG_SIZE - r.size() - 1));
+    r[1] = r.size();
+    return r;
+}
+
+// imageToBin(), the path in images[0]
+static Record image(int x, int y, const std::string &path) {
+    Record r = shape(DRAWIMAGE, {x, y, 0, 0});
+    r.push_back(0); // SD
+    r.push_back(0); // image slot
+    r.insert(r.end(), path.begin(), path.end());
+    r[1] = r.size();
+    return r;
+}
+
+// tft_logger's ring and the two ways it found duplicates and answered /getscreen
+struct Ring {
+    explicit Ring(bool indexed) : indexed(indexed) {}
+
+    void clear() {
+        memset(log, 0, sizeof(log));
+        writeIndex = count = 0;
+        index.clear();
+        memset(seq, 0, sizeof(seq));
+        resyncSeq = ++seqCounter;
+    }
+
+    void push(const Record &r) {
+        if (indexed) {
+            uint32_t hash = screenLogHash(r.data(), r.size());
+            for (uint8_t i = index.first(hash); i != SCREEN_INDEX_NONE; i = index.next(i)) {
+                if (index.hashOf(i) == hash && equal(i, r)) return;
+            }
+        } else {
+            for (int i = 0; i < count; i++)
+                if (equal(i, r)) return;
+        }
+        if (indexed && count == MAX_LOG_ENTRIES) {
+            index.remove(writeIndex);
+            if (log[writeIndex][0] == LOG_PACKET_HEADER) evictedSeq = seq[writeIndex];
+        }
+        memcpy(log[writeIndex], r.data(), r.size());
+        if (indexed) index.insert(writeIndex, screenLogHash(r.data(), r.size()));
+        seq[writeIndex] = ++seqCounter;
+        writeIndex = (writeIndex + 1) % MAX_LOG_ENTRIES;
+        if (count < MAX_LOG_ENTRIES) ++count;
+    }
+
+    // removeLogEntriesInsideRect()
+    void removeInside(int rx, int ry, int rw, int rh) {
+        for (int i = 0; i < count; i++) {
+            uint8_t *d = log[i];
+            if (d[0] != LOG_PACKET_HEADER) continue;
+            int px = d[3] << 8 | d[4], py = d[5] << 8 | d[6];
+            if (px >= rx && px < rx + rw && py >= ry && py < ry + rh) {
+                d[0] = 0;
+                if (indexed) index.remove(i);
+            }
+        }
+    }
+
+    // A legacy record as getBinLog() sends it: images carry the path from images[] after 12 bytes
+    void legacy(int i, std::string &out) const {
+        const uint8_t *e = log[i];
+        if (e[2] == DRAWIMAGE) {
+            size_t at = out.size();
+            out.append((const char *)e, 12);
+            out += imagePath;
+            out[at + 1] = 12 + imagePath.size();
+        } else {
+            out.append((const char *)e, e[1]);
+        }
+    }
+
+    std::string screenInfo() const {
+        Record info = shape(SCREEN_INFO, {SCREEN_W, SCREEN_H});
+        info.push_back(SCREEN_ROT);
+        info[1] = info.size();
+        return std::string(info.begin(), info.end());
+    }
+
+    // getBinLog(): the whole log, every time
+    std::string binLog() const { return screenInfo() + recordsAfter(0); }
+
+    // Legacy records logged after since, in ring order
+    std::string recordsAfter(uint32_t since) const {
+        std::string out;
+        for (int n = 0, i = first(); n < count; n++, i = (i + 1) % MAX_LOG_ENTRIES)
+            if (log[i][0] == LOG_PACKET_HEADER && seq[i] > since) legacy(i, out);
+        return out;
+    }
+
+    // getBinLogSince(), without the screen info change check: the screen does not rotate here
+    std::string binLogSince(uint32_t since, size_t capacity) const {
+        std::string out(capacity, 0);
+        uint8_t *buf = (uint8_t *)&out[0];
+        const bool full = since == 0 || since > seqCounter || since < evictedSeq || since < resyncSeq;
+        uint32_t last = full ? resyncSeq : since;
+        ScreenPalette palette;
+        size_t size = SCREEN_STREAM_HEADER;
+        if (full) {
+            std::string info = screenInfo();
+            size += screenStreamEncode((const uint8_t *)info.data(), palette, buf + size, capacity - size);
+        }
+        bool complete = true;
+        for (int n = 0, i = first(); n < count; n++, i = (i + 1) % MAX_LOG_ENTRIES) {
+            if (seq[i] <= since && !full) continue;
+            const uint8_t *e = log[i];
+            if (e[0] == LOG_PACKET_HEADER) {
+                size_t len;
+                if (e[2] == DRAWIMAGE) {
+                    len = screenStreamEncode(
+                        e, palette, buf + size, capacity - size, imagePath.c_str(), imagePath.size()
+                    );
+                } else {
+                    len = screenStreamEncode(e, palette, buf + size, capacity - size);
+                }
+                if (!len) {
+                    complete = false;
+                    break;
+                }
+                size += len;
+            }
+            if (seq[i] > last) last = seq[i];
+        }
+        if (complete) last = seqCounter;
+        screenStreamHeader(buf, full ? SCREEN_STREAM_FULL : 0, last);
+        out.resize(size);
+        return out;
+    }
+
+    int first() const { return count < MAX_LOG_ENTRIES ? 0 : writeIndex; }
+    bool equal(int i, const Record &r) const {
+        return log[i][1] == r.size() && !memcmp(log[i], r.data(), r.size());
+    }
+
+    bool indexed;
+    uint8_t log[MAX_LOG_ENTRIES][MAX_LOG_SIZE] = {};
+    uint32_t seq[MAX_LOG_ENTRIES] = {};
+    int writeIndex = 0, count = 0;
+    ScreenLogIndex index;
+    uint32_t seqCounter = 0, evictedSeq = 0, resyncSeq = 0;
+    std::string imagePath;
+};
+
+struct Decoded {
+    bool ok = true, full = false;
+    uint32_t seq = 0;
+    std::string records;
+};
+
+// decodeScreenStream() of index.js
+static Decoded decode(const std::string &data) {
+    static const char *layouts[100] = {};
+    if (!layouts[0]) {
+        const char *l[] = {"c",       "iiiic",   "iiiic",  "iiiiic", "iiiiic", "iiic",   "iiic",
+                           "iiiiiic", "iiiiiic", "iiiic",  "iiiic",  "iiiic",  "iiiiiicc", "iiiiicc",
+                           "iiiccs",  "iiiccs",  "iiiccs", "iiiccs", "iiiibxs"};
+        for (int fn = 0; fn <= 18; fn++) layouts[fn] = l[fn];
+        layouts[20] = layouts[21] = "iiic";
+        layouts[99] = "iib";
+    }
+    Decoded d;
+    const uint8_t *p = (const uint8_t *)data.data();
+    size_t pos = SCREEN_STREAM_HEADER;
+    if (data.size() < SCREEN_STREAM_HEADER || p[0] != SCREEN_STREAM_MAGIC) {
+        d.ok = false;
+        return d;
+    }
+    d.full = p[2] & SCREEN_STREAM_FULL;
+    d.seq = screenStreamSeq(p);
+    std::vector<uint16_t> palette;
+    auto varint = [&]() {
+        uint32_t v = 0;
+        for (int shift = 0; pos < data.size(); shift += 7) {
+            uint8_t b = p[pos++];
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        return v;
+    };
+    while (pos < data.size()) {
+        uint8_t fn = p[pos++];
+        if (fn == SCREEN_STREAM_RAW) {
+            uint32_t len = varint();
+            d.records.append((const char *)p + pos, len);
+            pos += len;
+            continue;
+        }
+        const char *layout = fn < 100 ? layouts[fn] : nullptr;
+        if (!layout) {
+            d.ok = false;
+            break;
+        }
+        std::string r = {(char)LOG_PACKET_HEADER, 0, (char)fn};
+        for (const char *f = layout; *f; ++f) {
+            uint16_t v;
+            if (*f == 'i') {
+                uint32_t z = varint();
+                v = (uint16_t)((z >> 1) ^ -(z & 1));
+            } else if (*f == 'c') {
+                uint32_t z = varint();
+                if (z & 1) {
+                    v = z >> 1;
+                    if (palette.size() < SCREEN_PALETTE_SIZE) palette.push_back(v);
+                } else if ((z >> 1) < palette.size()) {
+                    v = palette[z >> 1];
+                } else {
+                    d.ok = false;
+                    v = 0;
+                }
+            } else if (*f == 'b') {
+                r += (char)p[pos++];
+                continue;
+            } else if (*f == 's') {
+                uint32_t len = varint();
+                r.append((const char *)p + pos, len);
+                pos += len;
+                continue;
+            } else {
+                continue;
+            }
+            r += (char)(v >> 8);
+            r += (char)(v & 0xFF);
+        }
+        r[1] = r.size();
+        d.records += r;
+    }
+    if (pos != data.size()) d.ok = false;
+    return d;
+}
+
+// One frame of draw calls: what a menu loop logs on every redraw, most of it unchanged
+struct Screen {
+    std::vector<std::string> options;
+    int cursor = 0;
+    int clock = 0;
+};
+
+static std::vector<Record> frameDraws(Screen &s, int frame, bool &fillScreen) {
+    static const int BG = 0x0000, FG = 0xFFFF, PRI = 0xA80F, SEL = 0x07E0;
+    std::vector<Record> out;
+    fillScreen = frame % 60 == 0;
+    if (fillScreen) {
+        s.options.clear();
+        int n = 5 + rng() % 20;
+        for (int i = 0; i < n; i++) s.options.push_back("Option " + std::to_string(rng() % 1000));
+        s.cursor = 0;
+        out.push_back(shape(FILLSCREEN, {BG}));
+    }
+    if (frame % 10 == 0) s.clock++;
+    // status bar: clock, battery, theme icon
+    out.push_back(shape(FILLRECT, {170, 7, 60, 14, BG}));
+    char clock[8];
+    snprintf(clock, sizeof(clock), "%02d:%02d", s.clock / 60 % 24, s.clock % 60);
+    out.push_back(text(DRAWSTRING, 170, 7, 2, PRI, BG, clock));
+    out.push_back(shape(DRAWROUNDRECT, {200, 7, 30, 14, 2, PRI}));
+    out.push_back(image(8, 4, "/BruceTheme/wifi.png"));
+    // option rows around the cursor, as drawOptions
+    if (rng() % 3 == 0) s.cursor = (s.cursor + 1) % s.options.size();
+    out.push_back(shape(DRAWROUNDRECT, {24, 20, 192, 110, 5, FG}));
+    int top = s.cursor >= 5 ? s.cursor - 4 : 0;
+    for (int row = 0; row < 5 && top + row < (int)s.options.size(); row++) {
+        std::string label = (top + row == s.cursor ? ">" : " ") + s.options[top + row];
+        out.push_back(text(DRAWSTRING, 29, 29 + row * 20, 2, row % 4 ? FG : SEL, BG, label));
+    }
+    return out;
+}
+
+struct Totals {
+    double ns = 0;
+    size_t bytes = 0;
+};
+
+// What fillScreen(), fillRect() and the other draw calls do to the ring
+static void logDraws(Ring &ring, const std::vector<Record> &draws, bool fillScreen) {
+    if (fillScreen) ring.clear();
+    for (const Record &r : draws) {
+        if (r[2] == FILLRECT) {
+            int w = r[7] << 8 | r[8], h = r[9] << 8 | r[10];
+            if (w > 4 && h > 4) ring.removeInside(r[3] << 8 | r[4], r[5] << 8 | r[6], w, h);
+        }
+        ring.push(r);
+    }
+}
+
+// Logs the trace into both rings, the old client fetching the whole log and the new one what it lacks
+static void
+replay(size_t capacity, int frames, Totals &old, Totals &delta, int &mismatches, int &badStreams) {
+    Ring *before = new Ring(false), *after = new Ring(true);
+    before->imagePath = after->imagePath = "/BruceTheme/wifi.png";
+    before->clear();
+    after->clear();
+    Screen screen;
+    uint32_t since = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        bool fill;
+        std::vector<Record> draws = frameDraws(screen, frame, fill);
+
+        auto t0 = std::chrono::steady_clock::now();
+        logDraws(*before, draws, fill);
+        std::string whole = before->binLog();
+        old.ns += nsSince(t0);
+        old.bytes += whole.size();
+
+        t0 = std::chrono::steady_clock::now();
+        logDraws(*after, draws, fill);
+        // a response that ran out of room is followed by another from where it stopped
+        std::vector<std::string> responses;
+        uint32_t from = since;
+        do {
+            responses.push_back(after->binLogSince(from, capacity));
+            from = screenStreamSeq((const uint8_t *)responses.back().data());
+        } while (from != after->seqCounter);
+        delta.ns += nsSince(t0);
+
+        // the hash index drops exactly the duplicates the full comparison dropped
+        if (memcmp(before->log, after->log, sizeof(before->log)) || before->count != after->count)
+            mismatches++;
+
+        std::string got;
+        bool full = false;
+        for (const std::string &resp : responses) {
+            delta.bytes += resp.size();
+            Decoded d = decode(resp);
+            if (!d.ok) badStreams++;
+            if (d.full && got.empty()) full = true;
+            got += d.records;
+        }
+        std::string want = full ? after->binLog() : after->recordsAfter(since);
+        if (got != want || (since == 0 && !full)) badStreams++;
+        since = from;
+    }
+    delete before;
+    delete after;
+}
+
+static void testTrace() {
+    const int frames = 3000;
+    for (size_t capacity : {(size_t)MAX_LOG_SIZE * MAX_LOG_ENTRIES, (size_t)256}) {
+        Totals old, delta;
+        int mismatches = 0, badStreams = 0;
+        replay(capacity, frames, old, delta, mismatches, badStreams);
+        printf(
+            "%4zu byte responses: whole log %6.0f bytes %6.0f ns per frame, since=N %5.0f bytes %6.0f ns per "
+            "frame\n",
+            capacity, (double)old.bytes / frames, old.ns / frames, (double)delta.bytes / frames,
+            delta.ns / frames
+        );
+        CHECK_EQ(mismatches, 0);
+        CHECK_EQ(badStreams, 0);
+        CHECK(delta.bytes * 4 < old.bytes);
+    }
+}
+
+// Every record layout through the encoder and back, with fields at their extremes
+static void testRoundTrip() {
+    static const uint8_t fields[] = {1, 5, 5, 6, 6, 4, 4, 7, 7, 5, 5, 5, 8, 7}; // per layout
+    int bad = 0;
+    for (int trial = 0; trial < 20000; trial++) {
+        uint8_t fn = rng() % 22;
+        Record r;
+        if (fn == 19) {
+            // no layout: copied as is
+            r = shape(fn, {(int)(rng() % 65536), (int)(rng() % 65536), (int)(rng() % 65536)});
+        } else if (fn >= 14 && fn <= 17) {
+            std::string s(rng() % 100, 0);
+            for (char &c : s) c = 32 + rng() % 95;
+            r = text(fn, (int16_t)rng(), (int16_t)rng(), rng() % 8, rng() % 65536, rng() % 65536, s);
+        } else if (fn == 18) {
+            r = image((int16_t)rng(), (int16_t)rng(), "/img" + std::to_string(rng()) + ".png");
+        } else {
+            r = {LOG_PACKET_HEADER, 0, fn};
+            int n = fn < 14 ? fields[fn] : 4;
+            for (int i = 0; i < n; i++) {
+                int v = rng() % 4 ? (int)(rng() % 65536) : (rng() % 2 ? 0x8000 : 0x7FFF);
+                put16(r, v);
+            }
+            r[1] = r.size();
+        }
+
+        ScreenPalette palette;
+        uint8_t out[512];
+        screenStreamHeader(out, 0, trial);
+        size_t len = SCREEN_STREAM_HEADER;
+        std::string want((const char *)r.data(), r.size());
+        if (fn == 18) {
+            // sent with the path of images[], the slot byte dropped
+            std::string path((const char *)r.data() + 13, r.size() - 13);
+            len += screenStreamEncode(
+                r.data(), palette, out + len, sizeof(out) - len, path.c_str(), path.size()
+            );
+            want.erase(12, 1);
+            want[1] = want.size();
+        } else {
+            len += screenStreamEncode(r.data(), palette, out + len, sizeof(out) - len);
+        }
+        Decoded d = decode(std::string((const char *)out, len));
+        if (!d.ok || d.seq != (uint32_t)trial || d.records != want) bad++;
+        // too small a buffer is refused instead of cut
+        ScreenPalette fresh;
+        if (fn != 18 && screenStreamEncode(r.data(), fresh, out, len - SCREEN_STREAM_HEADER - 1) != 0) bad++;
+    }
+    CHECK_EQ(bad, 0);
+}
+
+// Random inserts and removes against the slots the index should list per bucket
+static void testIndex() {
+    ScreenLogIndex index;
+    std::vector<int64_t> model(SCREEN_INDEX_SLOTS, -1);
+    int bad = 0;
+    for (int step = 0; step < 200000; step++) {
+        uint8_t slot = rng() % SCREEN_INDEX_SLOTS;
+        if (rng() % 3) {
+            uint32_t hash = rng() % 1000; // plenty of shared buckets
+            index.insert(slot, hash);
+            model[slot] = hash;
+        } else {
+            index.remove(slot);
+            model[slot] = -1;
+        }
+        uint32_t probe = rng() % 1000;
+        std::vector<bool> listed(SCREEN_INDEX_SLOTS, false);
+        const int64_t bucket = probe % SCREEN_INDEX_BUCKETS;
+        int guard = 0; // a cycle in a chain would never end
+        for (uint8_t i = index.first(probe); i != SCREEN_INDEX_NONE && guard++ < 1000; i = index.next(i)) {
+            if (listed[i] || model[i] < 0 || model[i] % SCREEN_INDEX_BUCKETS != bucket) bad++;
+            listed[i] = true;
+        }
+        for (int i = 0; i < SCREEN_INDEX_SLOTS; i++)
+            if (!listed[i] && model[i] >= 0 && model[i] % SCREEN_INDEX_BUCKETS == bucket) bad++;
+    }
+    CHECK_EQ(bad, 0);
+}
+
+int main() {
+    testIndex();
+    testRoundTrip();
+    testTrace();
+    return HOST_TEST_RESULT();
+}
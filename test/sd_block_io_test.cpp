@@ -0,0 +1,355 @@
+// sd_block_io against a simulated SD card in SPI mode. The card answers byte by byte: a random access
+// delay of 0xFF, the start token, data and CRC for reads; for writes it takes the token, data and CRC,
+// checks the CRC, answers with a data response and holds busy while programming. Transfers may be
+// queued and only run at finish, as with DMA. Checks the data and the tokens both ways, bad CRCs,
+// error tokens, rejected blocks and timeouts, and CRC16 against a bitwise reference, from several
+// threads at once. Reports the throughput on a 20 MHz bus and the host speed of CRC16.
+
+#include "host_test.h"
+#include "sd_block_io.h"
+#include <chrono>
+#include <deque>
+#include <random>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+extern "C" unsigned short CRC16(const char *data, int length);
+
+#define BUS_HZ 20000000.0
+#define PROGRAM_BYTES 1800 // average busy after a written block, bytes clocked (0.7 ms)
+
+static std::mt19937 rng(13);
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static uint16_t crcBitwise(const uint8_t *p, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i] << 8;
+        for (int b = 0; b < 8; b++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+class SimCard {
+public:
+    enum Mode { IDLE, READ, WRITE };
+
+    // CMD17/18 accepted: the card streams blocks of len bytes from block first on
+    void startRead(uint32_t first, size_t len = SD_BLOCK_SIZE) {
+        mode = READ;
+        start = block = first;
+        blockLen = len;
+        out.clear();
+    }
+    // the command ended, or was never answered
+    void idle() {
+        mode = IDLE;
+        out.clear();
+    }
+    // CMD24/25 accepted
+    void startWrite(uint32_t first) {
+        mode = WRITE;
+        start = block = first;
+        out.clear();
+        in.clear();
+        busy = 0;
+    }
+
+    uint8_t exchange(uint8_t tx) {
+        clocked++;
+        if (mode == READ && out.empty()) queueBlock();
+        if (!out.empty()) {
+            uint8_t b = out.front();
+            out.pop_front();
+            return b;
+        }
+        if (mode != WRITE) return 0xFF;
+        if (busy) {
+            busy--;
+            return 0x00;
+        }
+        if (in.empty() && tx == 0xFF) return 0xFF;
+        if (in.empty() && tx != 0xFE && tx != 0xFC) {
+            badTokens++;
+            return 0xFF;
+        }
+        in.push_back(tx);
+        if (in.size() == SD_FRAME_SIZE) takeBlock();
+        return 0xFF;
+    }
+
+    uint32_t millis() const { return (uint32_t)(clocked * 8 / BUS_HZ * 1000); }
+
+    std::vector<uint8_t> storage = std::vector<uint8_t>(512 * SD_BLOCK_SIZE);
+    Mode mode = IDLE;
+    uint64_t clocked = 0;
+    // counted in blocks from the start of the command
+    int crcErrorAt = -1;   // read: block sent with a wrong CRC
+    int errorTokenAt = -1; // read: block answered with an error token instead
+    int rejectAt = -1;     // write: block refused with a write error
+    bool stuckBusy = false;
+    bool checkCrc = true;
+    int badTokens = 0, badCrcs = 0;
+
+private:
+    uint8_t *at(uint32_t n) { return &storage[(n % 512) * SD_BLOCK_SIZE]; }
+
+    void queueBlock() {
+        int n = block - start;
+        for (int i = rng() % 200; i > 0; i--) out.push_back(0xFF); // access time
+        if (n == errorTokenAt) {
+            out.push_back(0x08); // out of range
+            return;
+        }
+        const uint8_t *data = at(block++);
+        uint16_t crc = crcBitwise(data, blockLen) ^ (n == crcErrorAt ? 0x0100 : 0);
+        out.push_back(0xFE);
+        out.insert(out.end(), data, data + blockLen);
+        out.push_back(crc >> 8);
+        out.push_back(crc & 0xFF);
+    }
+
+    void takeBlock() {
+        const uint8_t *data = &in[1];
+        uint16_t crc = in[SD_FRAME_SIZE - 2] << 8 | in[SD_FRAME_SIZE - 1];
+        uint8_t resp = 0x05;
+        if (checkCrc && crc != crcBitwise(data, SD_BLOCK_SIZE)) {
+            resp = 0x0B;
+            badCrcs++;
+        } else if ((int)(block - start) == rejectAt) {
+            resp = 0x0D;
+        } else {
+            memcpy(at(block++), data, SD_BLOCK_SIZE);
+        }
+        out.push_back(0xE0 | resp);
+        busy = stuckBusy ? ~0u : 300 + rng() % (2 * PROGRAM_BYTES - 600);
+        in.clear();
+    }
+
+    uint32_t start = 0, block = 0;
+    size_t blockLen = SD_BLOCK_SIZE;
+    std::deque<uint8_t> out;
+    std::vector<uint8_t> in;
+    uint32_t busy = 0;
+};
+
+static SimCard *card;
+
+// A transfer as the SPI driver queues it
+struct Pending {
+    const uint8_t *tx;
+    uint8_t *rx;
+    size_t len;
+};
+static std::vector<Pending> pending;
+static size_t transfers = 0;
+
+static void run(const Pending &p) {
+    for (size_t i = 0; i < p.len; i++) {
+        uint8_t b = card->exchange(p.tx ? p.tx[i] : 0xFF);
+        if (p.rx) p.rx[i] = b;
+    }
+}
+
+static void busStart(void *, const uint8_t *tx, uint8_t *rx, size_t len) {
+    transfers++;
+    pending.push_back({tx, rx, len});
+}
+static void busFinish(void *) {
+    for (const Pending &p : pending) run(p);
+    pending.clear();
+}
+static void busStartBlocking(void *, const uint8_t *tx, uint8_t *rx, size_t len) {
+    transfers++;
+    run({tx, rx, len});
+}
+static uint32_t busMillis() { return card->millis(); }
+
+static sd_bus_t *newBus(bool queued) {
+    sd_bus_t *bus = new sd_bus_t();
+    bus->start = queued ? busStart : busStartBlocking;
+    bus->finish = queued ? busFinish : nullptr;
+    bus->millis = busMillis;
+    return bus;
+}
+
+static void fill(std::vector<uint8_t> &v) {
+    for (uint8_t &b : v) b = rng();
+}
+
+static void testCrc() {
+    CHECK_EQ(CRC16("123456789", 9), 0x31C3);
+    int bad = 0;
+    for (int i = 0; i < 2000; i++) {
+        std::vector<uint8_t> data(rng() % 1100);
+        fill(data);
+        if (CRC16((const char *)data.data(), data.size()) != crcBitwise(data.data(), data.size())) bad++;
+    }
+    CHECK_EQ(bad, 0);
+
+    // the tables are constant, nothing to race on however many tasks checksum at once
+    std::vector<uint8_t> block(SD_BLOCK_SIZE);
+    fill(block);
+    const uint16_t want = crcBitwise(block.data(), block.size());
+    std::vector<int> wrong(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 20000; i++) {
+                if (CRC16((const char *)block.data(), SD_BLOCK_SIZE) != want) wrong[t]++;
+                if (i % 64 == 0) std::this_thread::yield();
+            }
+        });
+    }
+    for (std::thread &t : threads) t.join();
+    for (int w : wrong) CHECK_EQ(w, 0);
+}
+
+static void testRead(bool queued) {
+    SimCard sim;
+    card = &sim;
+    fill(sim.storage);
+    sd_bus_t *bus = newBus(queued);
+    std::vector<uint8_t> buf(64 * SD_BLOCK_SIZE);
+
+    sim.startRead(10);
+    CHECK_EQ(sd_bus_read_blocks(bus, buf.data(), SD_BLOCK_SIZE, 64, true), 64);
+    CHECK(!memcmp(buf.data(), &sim.storage[10 * SD_BLOCK_SIZE], buf.size()));
+
+    // a partial block, as CMD17 with a shorter block length
+    sim.startRead(3, 64);
+    CHECK_EQ(sd_bus_read_blocks(bus, buf.data(), 64, 1, true), 1);
+    CHECK(!memcmp(buf.data(), &sim.storage[3 * SD_BLOCK_SIZE], 64));
+
+    // a bad CRC stops the read at the block, the ones before it are in
+    sim.crcErrorAt = 5;
+    sim.startRead(20);
+    memset(buf.data(), 0, buf.size());
+    CHECK_EQ(sd_bus_read_blocks(bus, buf.data(), SD_BLOCK_SIZE, 16, true), 5);
+    CHECK(!memcmp(buf.data(), &sim.storage[20 * SD_BLOCK_SIZE], 5 * SD_BLOCK_SIZE));
+    // unless CRCs are off
+    sim.startRead(20);
+    CHECK_EQ(sd_bus_read_blocks(bus, buf.data(), SD_BLOCK_SIZE, 16, false), 16);
+    sim.crcErrorAt = -1;
+
+    // an error token
+    sim.errorTokenAt = 0;
+    sim.startRead(20);
+    CHECK_EQ(sd_bus_read_blocks(bus, buf.data(), SD_BLOCK_SIZE, 16, true), 0);
+    sim.errorTokenAt = 9;
+    sim.startRead(20);
+    CHECK_EQ(sd_bus_read_blocks(bus, buf.data(), SD_BLOCK_SIZE, 16, true), 9);
+    sim.errorTokenAt = -1;
+
+    // no token at all: gives up after the timeout
+    sim.idle();
+    uint32_t t0 = sim.millis();
+    CHECK_EQ(sd_bus_read_blocks(bus, buf.data(), SD_BLOCK_SIZE, 4, true), 0);
+    CHECK(sim.millis() - t0 >= 500);
+    CHECK(pending.empty());
+    delete bus;
+}
+
+static void testWrite(bool queued) {
+    SimCard sim;
+    card = &sim;
+    sd_bus_t *bus = newBus(queued);
+    std::vector<uint8_t> data(32 * SD_BLOCK_SIZE);
+    fill(data);
+    int written = 0;
+
+    sim.startWrite(100);
+    CHECK_EQ(sd_bus_write_blocks(bus, data.data(), 32, 0xFC, true, &written), 0x05);
+    CHECK_EQ(written, 32);
+    CHECK(!memcmp(&sim.storage[100 * SD_BLOCK_SIZE], data.data(), data.size()));
+    CHECK_EQ(sim.badTokens, 0);
+    CHECK_EQ(sim.badCrcs, 0);
+
+    // single block token; without CRCs the card does not check them
+    fill(data);
+    sim.checkCrc = false;
+    sim.startWrite(7);
+    CHECK_EQ(sd_bus_write_blocks(bus, data.data(), 1, 0xFE, false, &written), 0x05);
+    CHECK_EQ(written, 1);
+    CHECK(!memcmp(&sim.storage[7 * SD_BLOCK_SIZE], data.data(), SD_BLOCK_SIZE));
+    sim.checkCrc = true;
+
+    // a block refused: the data response is returned and the blocks before it count
+    sim.rejectAt = 6;
+    sim.startWrite(200);
+    CHECK_EQ(sd_bus_write_blocks(bus, data.data(), 16, 0xFC, true, &written), 0x0D);
+    CHECK_EQ(written, 6);
+    sim.rejectAt = -1;
+
+    // the card never leaves busy
+    sim.startWrite(300);
+    sim.stuckBusy = true;
+    CHECK_EQ(sd_bus_write_blocks(bus, data.data(), 4, 0xFC, true, &written), 0);
+    CHECK_EQ(written, 1);
+    CHECK(pending.empty());
+    delete bus;
+}
+
+// Simulated bus time for 4 MB each way, and what CRC16 costs the host per MB
+static void testThroughput() {
+    SimCard sim;
+    card = &sim;
+    sd_bus_t *bus = newBus(true);
+    std::vector<uint8_t> buf(64 * SD_BLOCK_SIZE);
+    fill(buf);
+    const int rounds = 128; // 4 MB
+    for (bool crc : {false, true}) {
+        uint64_t c0 = sim.clocked;
+        size_t t0 = transfers;
+        for (int r = 0; r < rounds; r++) {
+            sim.startRead(0);
+            CHECK_EQ(sd_bus_read_blocks(bus, buf.data(), SD_BLOCK_SIZE, 64, crc), 64);
+        }
+        double readS = (sim.clocked - c0) * 8 / BUS_HZ;
+        size_t readTransfers = transfers - t0;
+        c0 = sim.clocked;
+        sim.checkCrc = crc;
+        for (int r = 0; r < rounds; r++) {
+            int written;
+            sim.startWrite(0);
+            CHECK_EQ(sd_bus_write_blocks(bus, buf.data(), 64, 0xFC, crc, &written), 0x05);
+        }
+        double writeS = (sim.clocked - c0) * 8 / BUS_HZ;
+        double mb = rounds * buf.size() / 1048576.0, busMbs = BUS_HZ / 8 / 1048576.0;
+        printf(
+            "CRC %-3s: read %.2f MB/s in %.1f transfers/block, write %.2f MB/s, %.0f MHz bus: %.2f MB/s\n",
+            crc ? "on" : "off", mb / readS, (double)readTransfers / (rounds * 64), mb / writeS, BUS_HZ / 1e6,
+            busMbs
+        );
+        // the card sets the pace: reads lose the access time, writes the programming
+        CHECK(mb / readS > 0.7 * busMbs);
+        CHECK(mb / writeS > 0.8 * busMbs * SD_BLOCK_SIZE / (SD_FRAME_SIZE + 1 + PROGRAM_BYTES));
+    }
+    delete bus;
+
+    std::vector<uint8_t> big(1 << 20);
+    fill(big);
+    unsigned sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 20; i++) sum += CRC16((const char *)big.data(), big.size());
+    double sliced = nsSince(t0) / 20 / 1e6;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 2; i++) sum += crcBitwise(big.data(), big.size());
+    double bitwise = nsSince(t0) / 2 / 1e6;
+    printf("CRC16 on the host: slice-by-8 %.2f ms/MB, bitwise %.2f ms/MB (%u)\n", sliced, bitwise, sum & 1);
+    CHECK(sliced < bitwise);
+}
+
+int main() {
+    testCrc();
+    testRead(false);
+    testRead(true);
+    testWrite(false);
+    testWrite(true);
+    testThroughput();
+    return HOST_TEST_RESULT();
+}
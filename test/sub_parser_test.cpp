@@ -0,0 +1,303 @@
+// SubParser against the line parser txSubFile used before (readStringUntil, substring after the colon,
+// trim, startsWith, toInt and hexStringToDecimal, RAW_Data split on spaces) over a corpus of generated
+// Flipper .sub files: Key, multi-line RAW and BinRAW, LF and CRLF, fed in random chunk sizes. The
+// repo ships no .sub files, so the corpus is made here. Also replays each indexed code from its file
+// span the way an index hit does, and reports the parse time per MB for both parsers.
+
+#include "host_test.h"
+#include "modules/rf/sub_parser.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static std::mt19937 rng(5);
+
+static const char *presets[] = {
+    "FuriHalSubGhzPresetOok270Async", "FuriHalSubGhzPresetOok650Async", "FuriHalSubGhzPreset2FSKDev476Async"
+};
+static const uint32_t frequencies[] = {315000000, 433920000, 868350000};
+
+static std::string hexKey(uint64_t key) {
+    char buf[32];
+    std::string s;
+    for (int i = 7; i >= 0; i--) {
+        snprintf(buf, sizeof(buf), i ? "%02X " : "%02X", (unsigned)(key >> (i * 8)) & 0xFF);
+        s += buf;
+    }
+    return s;
+}
+
+// One header and its codes, the way the Flipper saves a capture
+static std::string subFile(int kind, bool crlf) {
+    const char *eol = crlf ? "\r\n" : "\n";
+    std::string s = std::string("Filetype: Flipper SubGhz ") + (kind == 1 ? "RAW" : "Key") + " File" + eol;
+    s += std::string("Version: 1") + eol;
+    s += "Frequency: " + std::to_string(frequencies[rng() % 3]) + eol;
+    s += std::string("Preset: ") + presets[rng() % 3] + eol;
+    if (kind == 0) {
+        s += std::string("Protocol: Princeton") + eol;
+        int codes = 1 + rng() % 4;
+        for (int i = 0; i < codes; i++) {
+            s += "Bit: " + std::to_string(12 + rng() % 53) + eol;
+            s += "Key: " + hexKey((uint64_t)rng() << 32 | rng()) + eol;
+            s += "TE: " + std::to_string(100 + rng() % 600) + eol;
+        }
+    } else if (kind == 1) {
+        s += std::string("Protocol: RAW") + eol;
+        int lines = 1 + rng() % 24;
+        for (int l = 0; l < lines; l++) {
+            s += "RAW_Data:";
+            int n = 1 + rng() % 512;
+            for (int i = 0; i < n; i++) {
+                int v = 50 + rng() % 20000;
+                s += " " + std::to_string(i % 2 ? -v : v);
+            }
+            s += eol;
+        }
+    } else {
+        s += std::string("Protocol: BinRAW") + eol;
+        s += std::string("TE: ") + std::to_string(200 + rng() % 300) + eol;
+        s += std::string("Bit: 64") + eol;
+        int codes = 1 + rng() % 3;
+        for (int i = 0; i < codes; i++) {
+            s += "Bit_RAW: " + std::to_string(8 + rng() % 200) + eol;
+            int lines = 1 + rng() % 3;
+            for (int l = 0; l < lines; l++) s += "Data_RAW: " + hexKey((uint64_t)rng() << 32 | rng()) + eol;
+        }
+    }
+    return s;
+}
+
+/* ---------- the previous parser, String semantics on std::string ---------- */
+
+static void trim(std::string &s) {
+    size_t b = s.find_first_not_of(" \t\r\n"), e = s.find_last_not_of(" \t\r\n");
+    s = b == std::string::npos ? "" : s.substr(b, e - b + 1);
+}
+
+static bool startsWith(const std::string &s, const char *prefix) { return s.rfind(prefix, 0) == 0; }
+
+static uint8_t hexCharToDecimal(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return 0;
+}
+
+// As in type_convertion.cpp
+static uint32_t hexStringToDecimal(const char *hexString) {
+    uint32_t decimal = 0;
+    int length = strlen(hexString);
+    for (int i = 0; i < length; i += 3) {
+        decimal <<= 8;
+        decimal |= (hexCharToDecimal(hexString[i]) << 4) | hexCharToDecimal(hexString[i + 1]);
+    }
+    return decimal;
+}
+
+struct OldResult {
+    std::string protocol, preset;
+    long frequency = 0, te = 0;
+    std::vector<int> bitList, bitRawList;
+    std::vector<uint32_t> keyList;
+    std::vector<std::string> rawDataList;
+};
+
+static OldResult oldParse(const std::string &file) {
+    OldResult r;
+    size_t pos = 0;
+    while (pos < file.size()) {
+        size_t nl = file.find('\n', pos);
+        if (nl == std::string::npos) nl = file.size();
+        std::string line = file.substr(pos, nl - pos);
+        pos = nl + 1;
+        size_t colon = line.find(':');
+        std::string txt = line.substr(colon == std::string::npos ? 0 : colon + 1);
+        if (!txt.empty() && txt.back() == '\r') txt.pop_back();
+        trim(txt);
+        if (startsWith(line, "Protocol:")) r.protocol = txt;
+        if (startsWith(line, "Preset:")) r.preset = txt;
+        if (startsWith(line, "Frequency:")) r.frequency = atol(txt.c_str());
+        if (startsWith(line, "TE:")) r.te = atol(txt.c_str());
+        if (startsWith(line, "Bit:")) r.bitList.push_back(atol(txt.c_str()));
+        if (startsWith(line, "Bit_RAW:")) r.bitRawList.push_back(atol(txt.c_str()));
+        if (startsWith(line, "Key:")) r.keyList.push_back(hexStringToDecimal(txt.c_str()));
+        if (startsWith(line, "RAW_Data:") || startsWith(line, "Data_RAW:")) r.rawDataList.push_back(txt);
+    }
+    return r;
+}
+
+// sendRfCommand's split of one RAW_Data value into timings
+static std::vector<int> oldSplit(const std::string &data) {
+    std::vector<int> out;
+    size_t start = 0;
+    while (true) {
+        size_t index = data.find(' ', start);
+        size_t len = index == std::string::npos ? std::string::npos : index - start;
+        out.push_back(atoi(data.substr(start, len).c_str()));
+        if (index == std::string::npos) break;
+        start = index + 1;
+    }
+    return out;
+}
+
+/* ---------- the streaming parser ---------- */
+
+struct NewCode {
+    SubCode code;
+    std::vector<int> timings;
+};
+
+struct Collector {
+    std::vector<NewCode> codes;
+    bool inPartial = false;
+};
+
+static void onCode(void *ctx, const SubCode &code, int *timings, size_t count, bool partial) {
+    Collector &c = *(Collector *)ctx;
+    if (!c.inPartial) c.codes.push_back({code, {}});
+    c.codes.back().timings.insert(c.codes.back().timings.end(), timings, timings + count);
+    c.inPartial = partial;
+    if (!partial) c.codes.back().code = code;
+}
+
+static void feedChunks(SubParser &parser, const std::string &data, size_t from, size_t len) {
+    for (size_t done = 0; done < len;) {
+        size_t n = std::min<size_t>(1 + rng() % 700, len - done);
+        parser.feed(data.data() + from + done, n);
+        done += n;
+    }
+}
+
+static void testAgainstOldParser() {
+    int files = 0, mismatches = 0, spanMismatches = 0;
+    static int timings[1024];
+    for (int i = 0; i < 600; i++) {
+        int kind = i % 3;
+        std::string file = subFile(kind, rng() % 2);
+        OldResult old = oldParse(file);
+
+        Collector got;
+        SubParser parser;
+        parser.begin(onCode, &got, timings, sizeof(timings) / sizeof(timings[0]));
+        feedChunks(parser, file, 0, file.size());
+        parser.finish();
+        files++;
+
+        bool same = !got.codes.empty();
+        for (const NewCode &c : got.codes) {
+            same &= (long)c.code.frequency == old.frequency && parser.string(c.code.preset) == old.preset &&
+                    parser.string(c.code.protocol) == old.protocol;
+        }
+        if (kind == 0) {
+            same &= got.codes.size() == old.keyList.size() && old.bitList.size() == old.keyList.size();
+            for (size_t k = 0; same && k < got.codes.size(); k++) {
+                const SubCode &c = got.codes[k].code;
+                // the old path kept the low 32 bits of the key and the last TE of the file
+                same &= c.type == SUB_CODE_KEY && (uint32_t)c.key == old.keyList[k];
+                same &= c.bits == old.bitList[k];
+            }
+            same &= got.codes.back().code.te == old.te;
+        } else if (kind == 1) {
+            // the old path sent each line on its own, consecutive lines are now one signal
+            std::vector<int> oldTimings;
+            for (const std::string &line : old.rawDataList) {
+                std::vector<int> t = oldSplit(line);
+                oldTimings.insert(oldTimings.end(), t.begin(), t.end());
+                std::vector<int> fast(t.size() + 1);
+                if (subParseTimings(line.data(), line.size(), fast.data(), fast.size()) != t.size() ||
+                    !std::equal(t.begin(), t.end(), fast.begin()))
+                    same = false;
+            }
+            same &= got.codes.size() == 1 && got.codes[0].code.type == SUB_CODE_RAW;
+            same &= same && got.codes[0].timings == oldTimings;
+            same &= same && got.codes[0].code.pulses == oldTimings.size();
+        } else {
+            same &= got.codes.size() == old.bitRawList.size();
+            for (size_t k = 0; same && k < got.codes.size(); k++) {
+                const SubCode &c = got.codes[k].code;
+                same &= c.type == SUB_CODE_BINRAW && c.bits == old.bitRawList[k];
+            }
+        }
+        if (!same) mismatches++;
+
+        // index pass without a timing buffer, then each code replayed from its span
+        Collector indexed;
+        SubParser indexer;
+        indexer.begin(onCode, &indexed);
+        feedChunks(indexer, file, 0, file.size());
+        indexer.finish();
+        if (indexed.codes.size() != got.codes.size()) {
+            spanMismatches++;
+            continue;
+        }
+        for (size_t k = 0; k < indexed.codes.size(); k++) {
+            const SubCode &c = indexed.codes[k].code;
+            bool ok = memcmp(&c, &got.codes[k].code, sizeof(SubCode)) == 0;
+            static const char *prefix[] = {"Key:", "RAW_Data:", "Data_RAW:"};
+            ok &= file.compare(c.offset, strlen(prefix[c.type]), prefix[c.type]) == 0;
+            ok &= c.offset + c.length <= file.size() && file[c.offset + c.length - 1] == '\n';
+            if (c.type == SUB_CODE_RAW) {
+                Collector replay;
+                SubParser replayer;
+                replayer.begin(onCode, &replay, timings, sizeof(timings) / sizeof(timings[0]));
+                replayer.seek(c.offset);
+                feedChunks(replayer, file, c.offset, c.length);
+                replayer.finish();
+                ok &= replay.codes.size() == 1 && replay.codes[0].timings == got.codes[k].timings;
+            }
+            if (!ok) spanMismatches++;
+        }
+    }
+    printf(
+        "%d files, %d differ from the old parser, %d indexed spans differ\n", files, mismatches,
+        spanMismatches
+    );
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(spanMismatches, 0);
+}
+
+static void testParseTime() {
+    std::string corpus;
+    std::vector<std::string> files;
+    while (corpus.size() < (4 << 20)) {
+        files.push_back(subFile(rng() % 3, rng() % 2));
+        corpus += files.back();
+    }
+    static int timings[4096];
+    // both including the conversion of RAW values to timings
+    auto t0 = std::chrono::steady_clock::now();
+    size_t oldTimings = 0;
+    for (const std::string &f : files) {
+        OldResult old = oldParse(f);
+        for (const std::string &line : old.rawDataList) oldTimings += oldSplit(line).size();
+    }
+    double oldMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    t0 = std::chrono::steady_clock::now();
+    size_t codes = 0;
+    for (const std::string &f : files) {
+        SubParser parser;
+        parser.begin(nullptr, nullptr, timings, sizeof(timings) / sizeof(timings[0]));
+        for (size_t off = 0; off < f.size(); off += 512)
+            parser.feed(f.data() + off, std::min<size_t>(512, f.size() - off));
+        parser.finish();
+        codes += parser.codeCount();
+    }
+    double newMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    double mb = corpus.size() / 1048576.0;
+    printf(
+        "%zu files, %.1f MB, %zu codes: old parser %.1f ms/MB (%zu RAW values), SubParser %.1f ms/MB\n",
+        files.size(), mb, codes, oldMs / mb, oldTimings, newMs / mb
+    );
+}
+
+int main() {
+    testAgainstOldParser();
+    testParseTime();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,249 @@
+// TextPager over generated text files of 1 to 8 MB: log lines of any length, LF and CRLF, stray '\r'.
+// Every row, read in order and jumping about, must match the file wrapped whole the way addLine()
+// did, with and without the indent of continuation rows. Reports the time and the bytes read to the
+// first screen, and the peak of live heap while a file is scrolled end to end, against loading and
+// wrapping the whole file. Also covers rows, line breaks and CRLF pairs falling on the edges of the
+// read blocks and of the row window, and files long enough for the checkpoint stride to double.
+
+#include "core/text_pager.h"
+#include "host_test.h"
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define SCREEN_ROWS 12 // visible rows of ScrollableTextArea on a 240x135 display
+#define WINDOW_ROWS (4 * SCREEN_ROWS)
+
+static size_t liveBytes = 0, peakBytes = 0;
+
+// Every allocation carries its size in front, to follow the live heap
+void *operator new(size_t n) {
+    size_t *p = (size_t *)malloc(n + 16);
+    if (!p) throw std::bad_alloc();
+    *p = n;
+    liveBytes += n;
+    peakBytes = std::max(peakBytes, liveBytes);
+    return (char *)p + 16;
+}
+void operator delete(void *p) noexcept {
+    if (!p) return;
+    size_t *base = (size_t *)((char *)p - 16);
+    liveBytes -= *base;
+    free(base);
+}
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+static std::mt19937 rng(16);
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+struct Source {
+    const std::string *text;
+    size_t reads = 0, bytes = 0;
+};
+
+static size_t readText(void *ctx, uint32_t offset, uint8_t *buffer, size_t len) {
+    Source *src = static_cast<Source *>(ctx);
+    if (offset >= src->text->size()) return 0;
+    size_t n = std::min(len, src->text->size() - offset);
+    memcpy(buffer, src->text->data() + offset, n);
+    src->reads++;
+    src->bytes += n;
+    return n;
+}
+
+// The whole file through addLine(): lines split at '\n' with their "\r" ending dropped, then cut
+// every maxChars, continuation rows indented by a space
+static std::vector<std::string> wrapWhole(const std::string &text, size_t maxChars, bool indent) {
+    std::vector<std::string> rows;
+    for (size_t pos = 0; pos < text.size();) {
+        size_t nl = text.find('\n', pos);
+        if (nl == std::string::npos) nl = text.size();
+        size_t end = nl > pos && text[nl - 1] == '\r' ? nl - 1 : nl;
+        if (end == pos) rows.emplace_back();
+        for (size_t start = pos; start < end;) {
+            bool cont = start != pos && indent;
+            size_t len = std::min(cont ? maxChars - 1 : maxChars, end - start);
+            rows.push_back((cont ? " " : "") + text.substr(start, len));
+            start += len;
+        }
+        pos = nl + 1;
+    }
+    return rows;
+}
+
+static std::string generate(size_t bytes, bool crlf) {
+    static const char *words[] = {"rx", "tx", "0x3F", "wlan0", "deauth", "ssid=Bruce", "-72dBm", "ch 11",
+                                  "ok", "frame", "AA:BB:CC:DD:EE:FF", "retry", "[I]", "handshake"};
+    std::string text;
+    text.reserve(bytes + 4096);
+    while (text.size() < bytes) {
+        size_t len = rng() % 20 == 0 ? rng() % 2000 : rng() % 120;
+        size_t start = text.size();
+        while (text.size() - start < len) {
+            text += words[rng() % (sizeof(words) / sizeof(words[0]))];
+            text += rng() % 50 ? ' ' : '\r'; // a stray '\r' stays in the row
+        }
+        text += crlf ? "\r\n" : "\n";
+    }
+    return text;
+}
+
+static int compareAll(TextPager &pager, const std::vector<std::string> &want) {
+    int wrong = 0;
+    for (size_t r = 0; r < want.size(); r++) {
+        const char *row = pager.row(r);
+        if (!row || want[r] != row) wrong++;
+    }
+    if (pager.row(want.size()) || pager.hasRow(want.size())) wrong++;
+    return wrong;
+}
+
+static void testLargeFiles() {
+    for (size_t mb : {1, 8}) {
+        for (bool crlf : {false, true}) {
+            std::string text = generate(mb << 20, crlf);
+            std::vector<std::string> want = wrapWhole(text, 40, crlf);
+            Source src{&text};
+            TextPager pager;
+
+            // time to the first screen
+            size_t live0 = liveBytes;
+            peakBytes = liveBytes;
+            auto t0 = std::chrono::steady_clock::now();
+            pager.begin(readText, &src, text.size(), 40, crlf, WINDOW_ROWS);
+            for (size_t r = 0; r < SCREEN_ROWS; r++) CHECK(pager.row(r) != nullptr);
+            double firstUs = nsSince(t0) / 1000;
+            size_t firstBytes = src.bytes;
+
+            // scrolled to the end a screen at a time, then counted
+            for (size_t r = 0; pager.hasRow(r); r += SCREEN_ROWS) CHECK(pager.row(r) != nullptr);
+            CHECK_EQ(pager.rowCount(), want.size());
+            size_t pagerPeak = peakBytes - live0;
+            size_t used = pager.memoryUsed();
+            uint32_t stride = pager.stride();
+            CHECK_EQ(compareAll(pager, want), 0);
+            pager.end();
+
+            // jumping about, backwards included
+            int wrong = 0;
+            pager.begin(readText, &src, text.size(), 40, crlf, WINDOW_ROWS);
+            for (int i = 0; i < 3000; i++) {
+                size_t r = rng() % (want.size() + 10);
+                const char *row = pager.row(r);
+                if (r < want.size() ? !row || want[r] != row : row != nullptr) wrong++;
+            }
+            CHECK_EQ(wrong, 0);
+            pager.end();
+
+            // the old way: the file read into a String and every row kept
+            peakBytes = liveBytes;
+            t0 = std::chrono::steady_clock::now();
+            std::string *whole = new std::string(text);
+            std::vector<std::string> rows = wrapWhole(*whole, 40, crlf);
+            delete whole;
+            double oldUs = nsSince(t0) / 1000;
+            size_t oldPeak = peakBytes - live0;
+            rows.clear();
+
+            printf(
+                "%zu MB %s, %zu rows: first screen %.0f us %zu B read, peak %zu B (memoryUsed %zu, stride "
+                "%u); whole file %.0f us, peak %zu B\n",
+                mb, crlf ? "CRLF, indented" : "LF           ", want.size(), firstUs, firstBytes, pagerPeak,
+                used, stride, oldUs, oldPeak
+            );
+            // the window of rows only, whole blocks of it
+            CHECK(firstBytes <= WINDOW_ROWS * (40 + 2) + TEXT_PAGER_BLOCK);
+            // bounded whatever the file size: the window, the block, and the capped checkpoint table
+            CHECK(used < 24 * 1024);
+            CHECK(pagerPeak < 32 * 1024);
+            CHECK(pagerPeak * 100 < oldPeak);
+        }
+    }
+}
+
+// A row or line break on every offset around a block boundary, and around the edges of the window
+static void testBoundaries() {
+    int wrong = 0;
+    for (size_t maxChars : {1, 2, 7, 16, 40}) {
+        for (bool indent : {false, true}) {
+            for (size_t shift = 0; shift < 24; shift++) {
+                // the line ends "\r\n" so that '\r', '\n' or the last row land on TEXT_PAGER_BLOCK
+                std::string text(TEXT_PAGER_BLOCK - 12 + shift, 'a');
+                for (size_t i = 0; i < text.size(); i += 13) text[i] = 'b';
+                text += "\r\nnext\r\n\r\n";
+                text += std::string(2 * TEXT_PAGER_BLOCK - 3, 'c');
+                text += shift % 2 ? "\r" : "\r\n";
+                Source src{&text};
+                // the pager keeps room for a character behind the indent
+                size_t room = std::max<size_t>(maxChars, indent + 1);
+                std::vector<std::string> want = wrapWhole(text, room, indent);
+                TextPager pager;
+                pager.begin(readText, &src, text.size(), maxChars, indent, 5);
+                wrong += compareAll(pager, want);
+                CHECK_EQ(pager.rowCount(), want.size());
+                // backwards across each window edge
+                for (size_t r = want.size(); r-- > 0;) {
+                    const char *row = pager.row(r);
+                    if (!row || want[r] != row) wrong++;
+                }
+                pager.end();
+            }
+        }
+    }
+    CHECK_EQ(wrong, 0);
+
+    // nothing, a lone break, a file without one at the end
+    for (const char *text : {"", "\n", "\r\n", "\r", "x", "x\r", "\n\n"}) {
+        std::string s = text;
+        Source src{&s};
+        TextPager pager;
+        pager.begin(readText, &src, s.size(), 10, false, 4);
+        std::vector<std::string> want = wrapWhole(s, 10, false);
+        CHECK_EQ(compareAll(pager, want), 0);
+        CHECK_EQ(pager.rowCount(), want.size());
+    }
+}
+
+// Rows past TEXT_PAGER_MAX_CHECKPOINTS * stride: the table halves and the stride doubles, any row is
+// still found by wrapping at most one stride of rows
+static void testStride() {
+    std::string text;
+    for (int i = 0; i < 100000; i++) text += "line " + std::to_string(i) + (i % 3 ? "\n" : " wraps here\n");
+    std::vector<std::string> want = wrapWhole(text, 12, true);
+    Source src{&text};
+    TextPager pager;
+    pager.begin(readText, &src, text.size(), 12, true, WINDOW_ROWS);
+    CHECK_EQ(pager.rowCount(), want.size());
+    CHECK(pager.stride() > TEXT_PAGER_FIRST_STRIDE);
+    CHECK(want.size() <= (size_t)TEXT_PAGER_MAX_CHECKPOINTS * pager.stride());
+
+    int wrong = 0;
+    size_t worst = 0;
+    for (int i = 0; i < 2000; i++) {
+        size_t r = rng() % want.size();
+        size_t before = src.bytes;
+        const char *row = pager.row(r);
+        if (!row || want[r] != row) wrong++;
+        worst = std::max(worst, src.bytes - before);
+    }
+    CHECK_EQ(wrong, 0);
+    // a jump reads the window plus at most a stride of rows before it, a block at a time
+    size_t rowBytes = 12 + 2;
+    CHECK(worst <= (pager.stride() + WINDOW_ROWS) * rowBytes + 2 * TEXT_PAGER_BLOCK);
+    printf("%zu rows: stride %u, a jump reads at most %zu B\n", want.size(), pager.stride(), worst);
+}
+
+int main() {
+    testBoundaries();
+    testStride();
+    testLargeFiles();
+    return HOST_TEST_RESULT();
+}
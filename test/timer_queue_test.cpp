@@ -0,0 +1,157 @@
+// TimerQueue against a linear scan over a plain table, the way the interpreter found the next timer
+// before: random adds, removes and dispatches must pick the same timer, hand out the same ids and
+// reschedule intervals the same way. An interval woken late has to keep its phase, and the dispatch
+// cost is reported for both with a few to thousands of timers.
+
+#include "host_test.h"
+#include "modules/bjs_interpreter/timer_queue.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+static std::mt19937 rng(1);
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+struct RefTimer {
+    bool active;
+    int64_t due;
+    int32_t interval;
+    bool repeat;
+    uint32_t seq;
+};
+
+static void testAgainstLinearScan() {
+    int mismatches = 0;
+    for (int round = 0; round < 20; round++) {
+        TimerQueue queue;
+        std::vector<RefTimer> ref;
+        uint32_t seq = 0;
+        int64_t now = 0;
+        for (int step = 0; step < 20000; step++) {
+            int op = rng() % 10;
+            if (op < 4) {
+                int32_t delay = rng() % 500;
+                bool repeat = rng() % 3 == 0;
+                int id = queue.add(now + delay, delay, repeat);
+                // the lowest free id
+                size_t refId = 0;
+                while (refId < ref.size() && ref[refId].active) refId++;
+                if (refId == ref.size()) ref.push_back({});
+                ref[refId] = {true, now + delay, delay, repeat, seq++};
+                if (id != (int)refId) mismatches++;
+            } else if (op < 6 && !ref.empty()) {
+                int id = rng() % ref.size();
+                if (queue.remove(id) != ref[id].active) mismatches++;
+                ref[id].active = false;
+            } else {
+                now += rng() % 50;
+                bool freed = false;
+                int id = queue.takeDue(now, freed);
+                int best = -1;
+                for (size_t i = 0; i < ref.size(); i++) {
+                    if (!ref[i].active || ref[i].due > now) continue;
+                    if (best < 0 || ref[i].due < ref[best].due ||
+                        (ref[i].due == ref[best].due && ref[i].seq < ref[best].seq))
+                        best = i;
+                }
+                if (id != best) {
+                    mismatches++;
+                    continue;
+                }
+                if (best < 0) continue;
+                RefTimer &timer = ref[best];
+                if (freed != !timer.repeat) mismatches++;
+                if (!timer.repeat) {
+                    timer.active = false;
+                    continue;
+                }
+                int64_t next = timer.due + timer.interval;
+                if (timer.interval > 0)
+                    while (next <= now) next += timer.interval;
+                if (queue.due(id) != next) mismatches++;
+                timer.due = next;
+                timer.seq = seq++;
+            }
+            for (size_t i = 0; i < ref.size(); i++) {
+                if (queue.active(i) != ref[i].active) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+    }
+    printf("mismatches against the linear scan: %d\n", mismatches);
+    CHECK_EQ(mismatches, 0);
+}
+
+// 100 ms interval, every dispatch up to 30 ms late: still due on the 100 ms grid after 1000 periods
+static void testPhase() {
+    TimerQueue queue;
+    int id = queue.add(100, 100, true);
+    int fired = 0;
+    while (fired < 1000) {
+        int64_t now = queue.due(queue.next()) + rng() % 30;
+        bool freed;
+        if (queue.takeDue(now, freed) == id) fired++;
+    }
+    CHECK_EQ(queue.due(id), 1001 * 100);
+}
+
+static void testMainTimers() {
+    TimerQueue queue;
+    int timeout = queue.add(10, 0, false);
+    int main = queue.add(0, 0, false, true);
+    CHECK_EQ(queue.count(), 2);
+    CHECK(queue.mains().size() == 1 && queue.mains()[0] == main);
+    bool freed = false;
+    CHECK_EQ(queue.takeDue(5, freed), -1);
+    CHECK_EQ(queue.takeDue(10, freed), timeout);
+    CHECK(freed);
+    // mains never come due
+    CHECK_EQ(queue.takeDue(1000000, freed), -1);
+    CHECK(queue.remove(main));
+    CHECK(!queue.remove(main));
+    CHECK_EQ(queue.count(), 0);
+}
+
+static void testDispatchCost() {
+    for (int n : {16, 1000, 5000}) {
+        TimerQueue queue;
+        std::vector<RefTimer> ref;
+        for (int i = 0; i < n; i++) {
+            int32_t delay = 1 + rng() % 10000;
+            queue.add(delay, delay, true);
+            ref.push_back({true, delay, delay, true, 0});
+        }
+        const int heapRuns = 200000;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int k = 0; k < heapRuns; k++) {
+            bool freed;
+            queue.takeDue(queue.due(queue.next()), freed);
+        }
+        double heapNs = nsSince(t0) / heapRuns;
+
+        const int linearRuns = n > 1000 ? 20000 : heapRuns;
+        t0 = std::chrono::steady_clock::now();
+        for (int k = 0; k < linearRuns; k++) {
+            int best = 0;
+            for (int i = 1; i < n; i++)
+                if (ref[i].due < ref[best].due) best = i;
+            ref[best].due += ref[best].interval;
+        }
+        double linearNs = nsSince(t0) / linearRuns;
+        printf("%5d timers: heap %.0f ns per dispatch, linear scan %.0f ns\n", n, heapNs, linearNs);
+    }
+}
+
+int main() {
+    testAgainstLinearScan();
+    testPhase();
+    testMainTimers();
+    testDispatchCost();
+    return HOST_TEST_RESULT();
+}
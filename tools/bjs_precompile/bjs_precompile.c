@@ -0,0 +1,155 @@
+/*
+ * Host build of the script compiler of the interpreter, see precompile.py.
+ * Writes the bytecode cache of each script beside it (bytecode_cache.h) and times a cold compile,
+ * what the firmware does on every run without a cache, against loading that cache.
+ * Built 32 bit against the same generated stdlib as the firmware, so the bytecode is the one the
+ * device would produce.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bytecode_cache.h"
+#include "mquickjs.h"
+
+extern const JSSTDLibraryDef js_stdlib;
+
+#define MEM_SIZE 65536 /* context of the interpreter on boards with PSRAM */
+
+static void log_func(void *opaque, const void *buf, size_t len) {
+    (void)opaque;
+    fwrite(buf, 1, len, stderr);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc(size + 1);
+    if (buf && fread(buf, 1, size, f) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    if (buf) {
+        buf[size] = '\0';
+        *len = size;
+    }
+    return buf;
+}
+
+/* Bytecode as the firmware stores it: JSBytecodeHeader then the data. NULL if it does not compile. */
+static uint8_t *compile(uint8_t *mem, const char *name, const char *source, size_t len, uint32_t *out_len) {
+    JSContext *ctx = JS_NewContext(mem, MEM_SIZE, &js_stdlib);
+    JS_SetLogFunc(ctx, log_func);
+    uint8_t *bytecode = NULL;
+    JSValue code = JS_Parse(ctx, source, len, name, 0);
+    if (!JS_IsException(code)) {
+        JSBytecodeHeader hdr;
+        const uint8_t *data;
+        uint32_t data_len;
+        JS_PrepareBytecode(ctx, &hdr, &data, &data_len, code);
+        *out_len = sizeof(hdr) + data_len;
+        bytecode = malloc(*out_len);
+        memcpy(bytecode, &hdr, sizeof(hdr));
+        memcpy(bytecode + sizeof(hdr), data, data_len);
+    }
+    JS_FreeContext(ctx);
+    return bytecode;
+}
+
+int main(int argc, char **argv) {
+    int runs = 20;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        runs = atoi(argv[2]);
+        first = 3;
+    }
+    if (first >= argc || runs < 1) {
+        fprintf(stderr, "usage: %s [-n runs] script.js...\n", argv[0]);
+        return 1;
+    }
+
+    uint8_t *mem = malloc(MEM_SIZE);
+    int failed = 0;
+    double total_compile = 0, total_load = 0;
+    printf("%-40s %8s %9s %11s %9s\n", "script", "source", "bytecode", "compile ms", "load ms");
+
+    for (int i = first; i < argc; i++) {
+        size_t len;
+        char *source = read_file(argv[i], &len);
+        if (!source) {
+            fprintf(stderr, "%s: cannot read\n", argv[i]);
+            failed++;
+            continue;
+        }
+        const char *name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+
+        uint32_t bytecode_len;
+        uint8_t *bytecode = compile(mem, name, source, len, &bytecode_len);
+        if (!bytecode) {
+            fprintf(stderr, "%s: does not compile, no cache written\n", argv[i]);
+            free(source);
+            failed++;
+            continue;
+        }
+
+        double t0 = now_ms();
+        for (int r = 0; r < runs; r++) {
+            JSContext *ctx = JS_NewContext(mem, MEM_SIZE, &js_stdlib);
+            JS_Parse(ctx, source, len, name, 0);
+            JS_FreeContext(ctx);
+        }
+        double compile_ms = (now_ms() - t0) / runs;
+
+        /* relocation patches the buffer, every load starts from a fresh copy like a file read */
+        uint8_t *copy = malloc(bytecode_len);
+        double load_ms = 0;
+        for (int r = 0; r < runs; r++) {
+            memcpy(copy, bytecode, bytecode_len);
+            t0 = now_ms();
+            JSContext *ctx = JS_NewContext(mem, MEM_SIZE, &js_stdlib);
+            if (JS_RelocateBytecode(ctx, copy, bytecode_len) != 0) {
+                fprintf(stderr, "%s: cached bytecode does not load\n", argv[i]);
+                failed++;
+            } else {
+                JS_LoadBytecode(ctx, copy);
+            }
+            JS_FreeContext(ctx);
+            load_ms += now_ms() - t0;
+        }
+        load_ms /= runs;
+
+        BjsCacheHeader hdr;
+        bjsCacheFillHeader(&hdr, MQJS_STDLIB_SIGNATURE, source, len, bytecode_len);
+        char path[1024];
+        snprintf(path, sizeof(path), "%s%s", argv[i], BJS_CACHE_SUFFIX);
+        FILE *f = fopen(path, "wb");
+        if (!f || fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+            fwrite(bytecode, 1, bytecode_len, f) != bytecode_len) {
+            fprintf(stderr, "%s: cannot write\n", path);
+            failed++;
+        }
+        if (f) fclose(f);
+
+        printf("%-40s %8zu %9u %11.3f %9.3f\n", name, len, bytecode_len, compile_ms, load_ms);
+        total_compile += compile_ms;
+        total_load += load_ms;
+        free(copy);
+        free(bytecode);
+        free(source);
+    }
+
+    printf("%-40s %8s %9s %11.3f %9.3f\n", "total", "", "", total_compile, total_load);
+    free(mem);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Precompiles interpreter scripts to the bytecode cache the firmware loads instead of parsing them,
+and benchmarks a cold compile against loading the cache.
+
+Builds a 32 bit host version of the compiler from the mquickjs sources PlatformIO downloaded and
+the same stdlib table as the firmware; the native bindings are stubbed out, scripts are only
+compiled, never run. Needs a GCC with 32 bit support (gcc-multilib on Linux).
+
+    python tools/bjs_precompile/precompile.py                  # sd_files/interpreter
+    python tools/bjs_precompile/precompile.py -n 50 game.js    # given scripts, 50 runs each
+
+Each script gets "<name>c" beside it ("game.js" -> "game.jsc"), copy it along with the script.
+
+--host-stdlib <dir> only writes a native build of the table, with weak binding stubs a test can
+override, for test/bytecode_cache_test.cpp.
+"""
+import argparse
+import glob
+import hashlib
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+BJS_INTERPRETER_PATH = os.path.join(ROOT, "src", "modules", "bjs_interpreter")
+TOOL_PATH = os.path.dirname(os.path.abspath(__file__))
+BUILD_DIR = os.path.join(ROOT, ".pio", "bjs_precompile")
+MQJS_SOURCES = ["mquickjs.c", "dtoa.c", "libm.c", "cutils.c"]
+
+
+def sha256_file(path):
+    h = hashlib.sha256()
+    with open(path, "rb") as f:
+        h.update(f.read().replace(b"\r\n", b"\n"))
+    return h.hexdigest()
+
+
+def stdlib_signature(mqjs_path):
+    # Same as compute_signature() in gen_mqjs_headers.py, the build ID of the cache
+    parts = [
+        "v=3",
+        f"watch_sha256={sha256_file(os.path.join(BJS_INTERPRETER_PATH, 'mqjs_stdlib.c'))}",
+        f"mquickjs_build_sha256={sha256_file(os.path.join(mqjs_path, 'mquickjs_build.c'))}",
+        f"mquickjs_build_sha256={sha256_file(os.path.join(mqjs_path, 'mquickjs_build.h'))}",
+    ]
+    return hashlib.sha256("\n".join(parts).encode("utf-8")).hexdigest()[:8]
+
+
+def find_mquickjs(given):
+    candidates = [given] if given else glob.glob(os.path.join(ROOT, ".pio", "libdeps", "*", "mquickjs"))
+    for path in candidates:
+        if path and os.path.exists(os.path.join(path, "mquickjs.c")):
+            return path
+    sys.exit("mquickjs sources not found, build the firmware once or pass --mqjs")
+
+
+def run(cmd, **kwargs):
+    result = subprocess.run(cmd, capture_output=True, text=True, **kwargs)
+    if result.returncode != 0:
+        sys.exit(f"{' '.join(cmd)} failed:\n{result.stdout}{result.stderr}")
+    return result.stdout
+
+
+def binding_stubs(table, weak=False):
+    # Every native function of the bindings the table refers to, declared one per line in *_js.h
+    decl = re.compile(r"^\s*(JSValue|void)\s+(\w+)\s*\(([^)]*)\)\s*;", re.M)
+    used = set(re.findall(r"\b\w+\b", table))
+    stubs = {}
+    for header in sorted(glob.glob(os.path.join(BJS_INTERPRETER_PATH, "*_js.h"))):
+        with open(header) as f:
+            for ret, name, params in decl.findall(f.read()):
+                if name in used and name not in stubs and "JSContext" in params:
+                    body = "return JS_UNDEFINED;" if ret == "JSValue" else ""
+                    attr = "__attribute__((weak)) " if weak else ""
+                    stubs[name] = f"{attr}{ret} {name}({params}) {{ {body} }}"
+    return "\n".join(stubs[name] for name in sorted(stubs))
+
+
+def write_stdlib(mqjs_path, cc, build_dir, flags, weak=False):
+    # host_stdlib.c and mquickjs_atom.h in build_dir, flags are ["-m32"] for the firmware layout
+    os.makedirs(build_dir, exist_ok=True)
+    generator = os.path.join(build_dir, "mqjs_stdlib_generator")
+    run([cc, "-Wall", "-O2", *flags, "-I" + mqjs_path, "-o", generator,
+         os.path.join(BJS_INTERPRETER_PATH, "mqjs_stdlib.c"), os.path.join(mqjs_path, "mquickjs_build.c")])
+
+    table = run([generator, *flags])
+    with open(os.path.join(build_dir, "mquickjs_atom.h"), "w") as f:
+        f.write(run([generator, "-a", *flags]))
+    with open(os.path.join(build_dir, "host_stdlib.c"), "w") as f:
+        f.write('#include "mquickjs.h"\n\n')
+        f.write(binding_stubs(table, weak) + "\n\n")
+        f.write(table)
+
+
+def write_host_stdlib(mqjs_path, cc, build_dir):
+    write_stdlib(mqjs_path, cc, build_dir, [], weak=True)
+    # the firmware's table as gen_mqjs_headers.py writes it below its includes, to check mqjs_stdlib.h
+    with open(os.path.join(build_dir, "firmware_stdlib.h"), "w") as f:
+        f.write(run([os.path.join(build_dir, "mqjs_stdlib_generator"), "-m32"]))
+    with open(os.path.join(build_dir, "stdlib_signature.h"), "w") as f:
+        f.write(f"#define MQJS_STDLIB_SIGNATURE 0x{stdlib_signature(mqjs_path)}u\n")
+
+
+def build(mqjs_path, cc):
+    write_stdlib(mqjs_path, cc, BUILD_DIR, ["-m32"])
+    tool = os.path.join(BUILD_DIR, "bjs_precompile")
+    run([cc, "-O2", "-m32", "-w",
+         f"-DMQJS_STDLIB_SIGNATURE=0x{stdlib_signature(mqjs_path)}u",
+         "-I" + BUILD_DIR, "-I" + mqjs_path, "-I" + BJS_INTERPRETER_PATH,
+         "-o", tool, os.path.join(TOOL_PATH, "bjs_precompile.c"), os.path.join(BUILD_DIR, "host_stdlib.c"),
+         *[os.path.join(mqjs_path, src) for src in MQJS_SOURCES], "-lm"])
+    return tool
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("scripts", nargs="*", help="scripts or folders, sd_files/interpreter by default")
+    parser.add_argument("--mqjs", help="mquickjs sources, .pio/libdeps/<env>/mquickjs by default")
+    parser.add_argument("--cc", default=os.environ.get("MQJS_HOST_CC", "gcc"))
+    parser.add_argument("-n", type=int, default=20, help="timed runs per script")
+    parser.add_argument("--host-stdlib", metavar="DIR", help="native table for the host tests, then exit")
+    args = parser.parse_args()
+
+    if args.host_stdlib:
+        write_host_stdlib(find_mquickjs(args.mqjs), args.cc, args.host_stdlib)
+        return
+
+    scripts = []
+    for path in args.scripts or [os.path.join(ROOT, "sd_files", "interpreter")]:
+        if os.path.isdir(path):
+            for ext in ("js", "bjs"):
+                scripts += glob.glob(os.path.join(path, "**", "*." + ext), recursive=True)
+        else:
+            scripts.append(path)
+    if not scripts:
+        sys.exit("no scripts")
+
+    tool = build(find_mquickjs(args.mqjs), args.cc)
+    sys.exit(subprocess.call([tool, "-n", str(args.n), *sorted(scripts)]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+"""Uploads files to and downloads files from the device over the serial CLI, with the binary protocol
+of src/core/serial_commands/file_transfer.h (storage upload / storage download).
+
+Frames are CRC checked and resent when lost, an interrupted transfer resumes where it stopped when
+the same command is run again: the device keeps "<file>.part" for uploads, this script keeps
+"<local>.part" for downloads. Needs pyserial.
+
+    python tools/serial_transfer/serial_transfer.py -p /dev/ttyACM0 upload game.js /scripts/game.js
+    python tools/serial_transfer/serial_transfer.py -p COM5 download /BruceRF/capture.sub .
+
+On a noisy link a smaller chunk (--chunk 256) loses less to each corrupt frame.
+"""
+import argparse
+import os
+import struct
+import sys
+import time
+import zlib
+
+SYNC = b"B\xf7"
+READY, DATA, ACK, NAK, END, DONE, ABORT = range(1, 8)
+MAX_PAYLOAD = 1024
+WINDOW = 8
+
+
+class TransferError(Exception):
+    pass
+
+
+class Endpoint:
+    def __init__(self, port, retry=1.0, timeout=10.0):
+        self.port = port
+        self.retry = retry
+        self.timeout = timeout
+        self.rx = bytearray()
+        self.last_byte = self.last_heard = time.monotonic()
+        self.resent = 0
+        self.crc_errors = 0
+
+    def send(self, ftype, seq, payload=b""):
+        body = struct.pack("<BIH", ftype, seq, len(payload)) + payload
+        self.port.write(SYNC + body + struct.pack("<I", zlib.crc32(body)))
+
+    def frames(self):
+        """Valid frames that arrived, never waits."""
+        data = self.port.read(4096)
+        now = time.monotonic()
+        if data:
+            self.rx += data
+            self.last_byte = now
+        elif self.rx and now - self.last_byte > self.retry / 4:
+            # a corrupt length waits for bytes that never come
+            del self.rx[:2]
+        while True:
+            start = self.rx.find(SYNC)
+            if start < 0:
+                del self.rx[:-1]
+                return
+            del self.rx[:start]
+            if len(self.rx) < 9:
+                return
+            ftype, seq, length = struct.unpack_from("<BIH", self.rx, 2)
+            if not READY <= ftype <= ABORT or length > MAX_PAYLOAD:
+                del self.rx[:2]
+                continue
+            if len(self.rx) < 13 + length:
+                return
+            body = bytes(self.rx[2 : 9 + length])
+            (crc,) = struct.unpack_from("<I", self.rx, 9 + length)
+            if crc != zlib.crc32(body):
+                self.crc_errors += 1
+                del self.rx[:2]
+                continue
+            del self.rx[: 13 + length]
+            self.last_heard = now
+            yield ftype, seq, body[7:]
+
+    def check_peer(self):
+        if time.monotonic() - self.last_heard > self.timeout:
+            raise TransferError("device stopped answering")
+
+
+def send_file(ep, data, progress):
+    """Go-back-N sender, the device asks for the offset, chunk and window with READY."""
+    ready = False
+    base = nxt = frames = offset = chunk = window = 0
+    last_progress = time.monotonic()
+    while True:
+        now = time.monotonic()
+        for ftype, seq, payload in ep.frames():
+            if ftype == READY and len(payload) >= 7:
+                o, c, w = struct.unpack_from("<IHB", payload)
+                if o > len(data) or not 0 < c <= MAX_PAYLOAD or w == 0:
+                    ep.send(ABORT, 0)
+                    raise TransferError("bad resume offset")
+                offset, chunk, window = o, c, w
+                frames = (len(data) - offset + chunk - 1) // chunk
+                ep.resent += nxt
+                ready = True
+                base = nxt = 0
+                last_progress = now
+            elif ftype == ACK and ready and base < seq <= frames + 1:
+                base = seq
+                nxt = max(nxt, base)
+                last_progress = now
+                progress(offset + min(base * chunk, len(data) - offset), len(data))
+            elif ftype == NAK and ready and base <= seq < nxt:
+                ep.resent += nxt - seq
+                base = nxt = seq
+                last_progress = now
+            elif ftype == DONE and ready and nxt > frames:
+                if payload[:1] != b"\0":
+                    raise TransferError("device rejected the file")
+                return offset
+            elif ftype == ABORT:
+                raise TransferError("aborted by the device")
+
+        sent = False
+        if ready:
+            if now - last_progress > ep.retry:
+                ep.resent += nxt - base
+                nxt = base
+                last_progress = now
+            while nxt <= frames and nxt < base + window:
+                if nxt == frames:
+                    ep.send(END, nxt, struct.pack("<II", len(data), zlib.crc32(data)))
+                else:
+                    pos = offset + nxt * chunk
+                    ep.send(DATA, nxt, data[pos : pos + chunk])
+                nxt += 1
+                sent = True
+        ep.check_peer()
+        if not sent:
+            time.sleep(0.001)
+
+
+def receive_file(ep, out, offset, crc, chunk, window, progress):
+    """Receives into out, which already holds offset bytes whose CRC32 is crc; returns the file size."""
+    received = offset
+    expected = since_ack = 0
+    last_sent = 0.0
+    announced = nak_sent = got_data = False
+    while True:
+        now = time.monotonic()
+        for ftype, seq, payload in ep.frames():
+            if ftype == DATA:
+                got_data = True
+                if seq == expected and 0 < len(payload) <= chunk:
+                    out.write(payload)
+                    crc = zlib.crc32(payload, crc)
+                    received += len(payload)
+                    expected += 1
+                    nak_sent = False
+                    since_ack += 1
+                    if since_ack >= (window + 1) // 2:
+                        ep.send(ACK, expected)
+                        since_ack = 0
+                        last_sent = now
+                        progress(received, None)
+                elif seq > expected:
+                    if not nak_sent:
+                        ep.send(NAK, expected)
+                        nak_sent = True
+                        last_sent = now
+                elif now - last_sent > ep.retry / 4:
+                    ep.send(ACK, expected)
+                    since_ack = 0
+                    last_sent = now
+            elif ftype == END and len(payload) >= 8:
+                if seq != expected:
+                    if seq > expected and not nak_sent:
+                        ep.send(NAK, expected)
+                        nak_sent = True
+                        last_sent = now
+                    continue
+                size, file_crc = struct.unpack_from("<II", payload)
+                if size != received or file_crc != crc:
+                    ep.send(DONE, seq, b"\1")
+                    raise TransferError("CRC mismatch")
+                ep.send(DONE, seq, b"\0")
+                out.flush()
+                linger(ep, seq)
+                return received
+            elif ftype == ABORT:
+                raise TransferError("aborted by the device")
+
+        if not announced or now - last_sent > ep.retry:
+            if got_data:
+                ep.send(NAK, expected)
+            else:
+                ep.send(READY, 0, struct.pack("<IHB", received, chunk, window))
+            announced = True
+            last_sent = now
+        ep.check_peer()
+        time.sleep(0.001)
+
+
+def linger(ep, end_seq, seconds=0.5):
+    # answers a repeated END in case DONE was lost
+    until = time.monotonic() + seconds
+    while time.monotonic() < until:
+        for ftype, seq, _ in ep.frames():
+            if ftype == END:
+                ep.send(DONE, end_seq, b"\0")
+        time.sleep(0.001)
+
+
+def command(port, line):
+    port.reset_input_buffer()
+    port.write(line.encode() + b"\n")
+
+
+def print_result(port):
+    # the device ends with a line saying how it went
+    until = time.monotonic() + 1
+    text = b""
+    while time.monotonic() < until:
+        text += port.read(256)
+    for line in text.decode(errors="replace").splitlines():
+        if line.startswith(("File ", "Upload failed", "Download failed")):
+            print(line)
+
+
+def progress_printer(start_time):
+    def progress(done, total):
+        rate = done / max(time.monotonic() - start_time, 1e-3) / 1024
+        total_text = f"/{total}" if total else ""
+        print(f"\r{done}{total_text} bytes, {rate:.1f} KiB/s", end="", flush=True)
+
+    return progress
+
+
+def main():
+    import serial
+
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-p", "--port", required=True)
+    parser.add_argument("-b", "--baud", type=int, default=115200)
+    parser.add_argument("--chunk", type=int, default=MAX_PAYLOAD, help="bytes per frame, up to 1024")
+    parser.add_argument("--retry", type=float, default=1.0, help="seconds without progress before a resend")
+    parser.add_argument("action", choices=["upload", "download"])
+    parser.add_argument("source")
+    parser.add_argument("target")
+    args = parser.parse_args()
+    if not 0 < args.chunk <= MAX_PAYLOAD:
+        parser.error("--chunk must be 1 to 1024")
+
+    port = serial.Serial(args.port, args.baud, timeout=0)
+    ep = Endpoint(port, retry=args.retry)
+    start = time.monotonic()
+    try:
+        if args.action == "upload":
+            with open(args.source, "rb") as f:
+                data = f.read()
+            command(port, f"storage upload {args.target} {args.chunk}")
+            offset = send_file(ep, data, progress_printer(start))
+            size = len(data) - offset
+        else:
+            target = args.target
+            if os.path.isdir(target):
+                target = os.path.join(target, os.path.basename(args.source))
+            part = target + ".part"
+            crc = offset = 0
+            if os.path.exists(part):
+                with open(part, "rb") as f:
+                    prefix = f.read()
+                crc, offset = zlib.crc32(prefix), len(prefix)
+            command(port, f"storage download {args.source}")
+            try:
+                with open(part, "ab") as out:
+                    size = receive_file(ep, out, offset, crc, args.chunk, WINDOW, progress_printer(start))
+            except TransferError as e:
+                if str(e) == "CRC mismatch":
+                    os.remove(part)
+                raise
+            os.replace(part, target)
+            size -= offset
+    except TransferError as e:
+        print(f"\n{e}", file=sys.stderr)
+        print_result(port)
+        return 1
+    except KeyboardInterrupt:
+        ep.send(ABORT, 0)
+        return 1
+
+    elapsed = time.monotonic() - start
+    print(f"\n{size} bytes in {elapsed:.1f} s, {size / elapsed / 1024:.1f} KiB/s, {ep.resent} frames resent")
+    print_result(port)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())